@@ -0,0 +1,83 @@
+// One record at a time (set_param + run per record) versus one run_batch()
+// over the whole column, on the same small per-record graph.
+
+#include "suite.hpp"
+
+#include "rebelflow/compiled_plan.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t records = 100'000;
+
+struct Fixture {
+    std::shared_ptr<CompiledPlan> plan;
+    NodeId input = invalid_node;
+    Buffer column;
+};
+
+/// max((x * 1.5) + 0.25, 0) per record.
+Fixture make_fixture() {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+
+    Graph g;
+    const NodeId x = g.add_node(registry, "Constant");
+    const NodeId mul = g.add_node(registry, "Multiply");
+    const NodeId add = g.add_node(registry, "Add");
+    const NodeId clamp = g.add_node(registry, "Max");
+    g.connect(x, "value", mul, "a");
+    g.set_param(x, "value", 0.0);
+    const NodeId factor = g.add_node(registry, "Constant");
+    g.set_param(factor, "value", 1.5);
+    g.connect(factor, "value", mul, "b");
+    const NodeId offset = g.add_node(registry, "Constant");
+    g.set_param(offset, "value", 0.25);
+    g.connect(mul, "result", add, "a");
+    g.connect(offset, "value", add, "b");
+    g.connect(add, "result", clamp, "a");
+
+    std::vector<double> xs(records);
+    for (std::size_t i = 0; i < records; ++i) {
+        xs[i] = static_cast<double>(i % 1000) - 500.0;
+    }
+    // x is bound to a column, so it must not be folded into the expression.
+    PlanOptions options;
+    options.fuse_expressions = false;
+    return {std::make_shared<CompiledPlan>(CompiledPlan::compile(g, options)), x,
+            Buffer::adopt(std::move(xs))};
+}
+
+} // namespace
+
+void register_batch_benchmarks(Suite& suite) {
+    suite.add(
+        "batch/per-record",
+        [f = make_fixture()](std::size_t n) {
+            const std::span<const double> xs = f.column.view<double>();
+            for (std::size_t i = 0; i < n; ++i) {
+                for (double x : xs) {
+                    f.plan->set_param(f.input, 0, x);
+                    f.plan->run();
+                }
+            }
+        },
+        records);
+
+    suite.add(
+        "batch/columns",
+        [f = make_fixture()](std::size_t n) {
+            const ColumnBinding binding{{f.input, 0}, f.column};
+            for (std::size_t i = 0; i < n; ++i) {
+                f.plan->run_batch(records, {&binding, 1});
+            }
+        },
+        records);
+}
+
+} // namespace rebelflow::bench
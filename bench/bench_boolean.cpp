@@ -0,0 +1,68 @@
+// Mesh booleans of two overlapping icospheres of about 330k triangles each,
+// on the whole pool: their union, intersection and difference. The spheres
+// are offset along all three axes, so the cut curve crosses triangles at
+// arbitrary angles. Per-item figures are per input triangle, of both meshes.
+
+#include "suite.hpp"
+
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/mesh_boolean.hpp"
+
+#include <array>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t levels = 7; // 20 x 4^7 ~ 330k triangles
+
+/// A unit icosahedron subdivided `levels` times, pushed out to the sphere
+/// and moved to `center`.
+Mesh make_sphere(const std::array<double, 3>& center) {
+    const double g = (1 + std::sqrt(5.0)) / 2;
+    std::vector<double> p = {-1, g, 0,  1, g, 0,  -1, -g, 0,  1, -g, 0,
+                             0, -1, g,  0, 1, g,  0, -1, -g,  0, 1, -g,
+                             g, 0, -1,  g, 0, 1,  -g, 0, -1,  -g, 0, 1};
+    std::vector<std::uint32_t> t = {0, 11, 5, 0, 5, 1,  0, 1, 7,   0, 7, 10, 0, 10, 11,
+                                    1, 5, 9,  5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+                                    3, 9, 4,  3, 4, 2,  3, 2, 6,   3, 6, 8,  3, 8, 9,
+                                    4, 9, 5,  2, 4, 11, 6, 2, 10,  8, 6, 7,  9, 8, 1};
+    const Mesh mesh = subdivide(
+        Mesh::from_triangles(Buffer::adopt(std::move(p), 3), Buffer::adopt(std::move(t), 3)),
+        levels);
+    std::vector<double> q(mesh.positions().begin(), mesh.positions().end());
+    for (std::size_t i = 0; i < q.size(); i += 3) {
+        const double length = std::sqrt(q[i] * q[i] + q[i + 1] * q[i + 1] + q[i + 2] * q[i + 2]);
+        for (std::size_t k = 0; k < 3; ++k) {
+            q[i + k] = q[i + k] / length + center[k];
+        }
+    }
+    return mesh.with_positions(Buffer::adopt(std::move(q), 3));
+}
+
+} // namespace
+
+void register_boolean_benchmarks(Suite& suite) {
+    auto a = lazy([] { return make_sphere({0.0, 0.0, 0.0}); });
+    auto b = lazy([] { return make_sphere({0.5, 0.3, 0.2}); });
+    const std::size_t triangles = 2 * 20 * (std::size_t{1} << 2 * levels);
+
+    for (const BooleanOperation operation :
+         {BooleanOperation::Union, BooleanOperation::Intersection, BooleanOperation::Difference}) {
+        suite.add(
+            std::string("boolean/") + to_string(operation),
+            [a, b, operation, &suite](std::size_t n) {
+                const Mesh& first = a->get();
+                const Mesh& second = b->get();
+                for (std::size_t i = 0; i < n; ++i) {
+                    mesh_boolean(first, second, operation, suite.pool());
+                }
+            },
+            triangles);
+    }
+}
+
+} // namespace rebelflow::bench
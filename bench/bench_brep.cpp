@@ -0,0 +1,261 @@
+// STEP import and tessellation of a synthetic assembly, on the whole pool: 250
+// plates with a hole, each a different size, placed 8 times by mapped items
+// for 2000 bodies. The cases read the file; tessellate one body of a model
+// that has none cached, then the same body again from the cache; and read
+// the file and tessellate 5 bodies, against reading it and tessellating
+// them all, the eager import lazy tessellation replaces. Per-item figures
+// are per body for the file cases, per tessellated body otherwise.
+
+#include "suite.hpp"
+
+#include "rebelflow/brep.hpp"
+#include "rebelflow/step.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <unistd.h>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr int parts = 250;
+constexpr int instances = 8;
+constexpr double tolerance = 0.01;
+
+/// Numbers entities as they are added.
+class StepWriter {
+public:
+    int add(const std::string& entity) {
+        text_ += ref(++last_);
+        text_ += "=" + entity + ";\n";
+        return last_;
+    }
+    std::string ref(int id) const {
+        std::string out = "#";
+        out += std::to_string(id);
+        return out;
+    }
+
+    int point(double x, double y, double z) {
+        char buf[96];
+        std::snprintf(buf, sizeof buf, "CARTESIAN_POINT('',(%.6g,%.6g,%.6g))", x, y, z);
+        return add(buf);
+    }
+    int direction(double x, double y, double z) {
+        char buf[96];
+        std::snprintf(buf, sizeof buf, "DIRECTION('',(%.6g,%.6g,%.6g))", x, y, z);
+        return add(buf);
+    }
+    int axis(double x, double y, double z, int normal = 2, int reference = 0) {
+        const double n[3] = {normal == 0 ? 1.0 : 0.0, normal == 1 ? 1.0 : 0.0,
+                             normal == 2 ? 1.0 : 0.0};
+        const double r[3] = {reference == 0 ? 1.0 : 0.0, reference == 1 ? 1.0 : 0.0,
+                             reference == 2 ? 1.0 : 0.0};
+        const int o = point(x, y, z);
+        const int d = direction(n[0], n[1], n[2]);
+        const int a = direction(r[0], r[1], r[2]);
+        return add("AXIS2_PLACEMENT_3D(''," + ref(o) + "," + ref(d) + "," + ref(a) + ")");
+    }
+
+    std::string text() const {
+        return "ISO-10303-21;\nHEADER;\nFILE_DESCRIPTION((''),'2;1');\n"
+               "FILE_NAME('','',(''),(''),'','','');\nFILE_SCHEMA(('AUTOMOTIVE_DESIGN'));\n"
+               "ENDSEC;\nDATA;\n" +
+               text_ + "ENDSEC;\nEND-ISO-10303-21;\n";
+    }
+
+private:
+    std::string text_;
+    int last_ = 0;
+};
+
+/// A `size` x `size` x 1 plate with a hole of `radius` through its middle;
+/// returns its MANIFOLD_SOLID_BREP.
+int add_plate(StepWriter& w, double size, double radius) {
+    double p[8][3];
+    int v[8];
+    for (int i = 0; i < 8; ++i) {
+        p[i][0] = size * (i & 1);
+        p[i][1] = size * (i >> 1 & 1);
+        p[i][2] = i >> 2 & 1;
+        v[i] = w.add("VERTEX_POINT(''," + w.ref(w.point(p[i][0], p[i][1], p[i][2])) + ")");
+    }
+    int edge[8][8] = {};
+    const auto use = [&](int a, int b) {
+        if (edge[b][a] != 0) {
+            return w.add("ORIENTED_EDGE('',*,*," + w.ref(edge[b][a]) + ",.F.)");
+        }
+        const double d[3] = {p[b][0] - p[a][0], p[b][1] - p[a][1], p[b][2] - p[a][2]};
+        const double length = std::abs(d[0]) + std::abs(d[1]) + std::abs(d[2]);
+        const int direction = w.direction(d[0] / length, d[1] / length, d[2] / length);
+        const int vector = w.add("VECTOR(''," + w.ref(direction) + "," + std::to_string(length) +
+                                 ")");
+        const int line = w.add("LINE(''," + w.ref(w.point(p[a][0], p[a][1], p[a][2])) + "," +
+                               w.ref(vector) + ")");
+        edge[a][b] = w.add("EDGE_CURVE(''," + w.ref(v[a]) + "," + w.ref(v[b]) + "," +
+                           w.ref(line) + ",.T.)");
+        return w.add("ORIENTED_EDGE('',*,*," + w.ref(edge[a][b]) + ",.T.)");
+    };
+    const double c = size / 2;
+    int hole[2];
+    for (int z = 0; z < 2; ++z) {
+        const int vertex = w.add("VERTEX_POINT(''," + w.ref(w.point(c + radius, c, z)) + ")");
+        const int circle = w.add("CIRCLE(''," + w.ref(w.axis(c, c, z)) + "," +
+                                 std::to_string(radius) + ")");
+        hole[z] = w.add("EDGE_CURVE(''," + w.ref(vertex) + "," + w.ref(vertex) + "," +
+                        w.ref(circle) + ",.T.)");
+    }
+    // Corners counterclockwise seen from outside, the outward axis, and the
+    // axis the first side runs along.
+    struct Side {
+        int corners[4];
+        int normal;
+        double sign;
+        int reference;
+    };
+    const Side sides[6] = {{{0, 2, 3, 1}, 2, -1, 1}, {{4, 5, 7, 6}, 2, 1, 0},
+                           {{0, 1, 5, 4}, 1, -1, 0}, {{2, 6, 7, 3}, 1, 1, 2},
+                           {{0, 4, 6, 2}, 0, -1, 2}, {{1, 3, 7, 5}, 0, 1, 1}};
+    std::string faces;
+    for (const Side& s : sides) {
+        std::string uses;
+        for (int k = 0; k < 4; ++k) {
+            uses += k > 0 ? "," : "";
+            uses += w.ref(use(s.corners[k], s.corners[(k + 1) % 4]));
+        }
+        std::string bounds =
+            w.ref(w.add("FACE_OUTER_BOUND(''," + w.ref(w.add("EDGE_LOOP('',(" + uses + "))")) +
+                        ",.T.)"));
+        if (s.normal == 2) {
+            const int z = s.sign > 0 ? 1 : 0;
+            const int hole_use = w.add("ORIENTED_EDGE('',*,*," + w.ref(hole[z]) + "," +
+                                       (z == 0 ? ".T." : ".F.") + ")");
+            bounds += "," + w.ref(w.add("FACE_BOUND(''," +
+                                        w.ref(w.add("EDGE_LOOP('',(" + w.ref(hole_use) + "))")) +
+                                        ",.T.)"));
+        }
+        const double* o = p[s.corners[0]];
+        const int plane = w.add("PLANE(''," + w.ref(w.axis(o[0], o[1], o[2], s.normal,
+                                                             s.reference)) +
+                                ")");
+        faces += faces.empty() ? "" : ",";
+        faces += w.ref(w.add("ADVANCED_FACE('',(" + bounds + ")," + w.ref(plane) + "," +
+                             (s.sign > 0 ? ".T." : ".F.") + ")"));
+    }
+    const int down = w.add("ORIENTED_EDGE('',*,*," + w.ref(hole[0]) + ",.F.)");
+    const int up = w.add("ORIENTED_EDGE('',*,*," + w.ref(hole[1]) + ",.T.)");
+    const int cylinder = w.add("CYLINDRICAL_SURFACE(''," + w.ref(w.axis(c, c, 0)) + "," +
+                               std::to_string(radius) + ")");
+    const int bottom = w.add("FACE_BOUND(''," + w.ref(w.add("EDGE_LOOP('',(" + w.ref(down) +
+                                                            "))")) +
+                             ",.T.)");
+    const int top = w.add("FACE_BOUND(''," + w.ref(w.add("EDGE_LOOP('',(" + w.ref(up) + "))")) +
+                          ",.T.)");
+    faces += "," + w.ref(w.add("ADVANCED_FACE('',(" + w.ref(bottom) + "," + w.ref(top) + ")," +
+                               w.ref(cylinder) + ",.F.)"));
+    const int shell = w.add("CLOSED_SHELL('',(" + faces + "))");
+    return w.add("MANIFOLD_SOLID_BREP('plate'," + w.ref(shell) + ")");
+}
+
+/// The assembly as STEP text: each part in its own representation, named
+/// by its product, and mapped into the root one on a grid.
+std::string make_assembly() {
+    StepWriter w;
+    const int context = w.add("GEOMETRIC_REPRESENTATION_CONTEXT('','',3)");
+    std::string items;
+    for (int i = 0; i < parts; ++i) {
+        const double size = 10 + 0.02 * i;
+        const int solid = add_plate(w, size, size / 4);
+        const int origin = w.axis(0, 0, 0);
+        const int part = w.add("ADVANCED_BREP_SHAPE_REPRESENTATION('',(" + w.ref(solid) + "," +
+                               w.ref(origin) + ")," + w.ref(context) + ")");
+        const int product = w.add("PRODUCT('part-" + std::to_string(i) + "','part-" +
+                                  std::to_string(i) + "','',())");
+        const int formation = w.add("PRODUCT_DEFINITION_FORMATION('',''," + w.ref(product) + ")");
+        const int definition = w.add("PRODUCT_DEFINITION('design',''," + w.ref(formation) +
+                                     ",$)");
+        const int shape = w.add("PRODUCT_DEFINITION_SHAPE('',''," + w.ref(definition) + ")");
+        w.add("SHAPE_DEFINITION_REPRESENTATION(" + w.ref(shape) + "," + w.ref(part) + ")");
+        const int map = w.add("REPRESENTATION_MAP(" + w.ref(origin) + "," + w.ref(part) + ")");
+        for (int k = 0; k < instances; ++k) {
+            const int target = w.axis(20.0 * k, 20.0 * i, 0, 2, k % 2);
+            items += items.empty() ? "" : ",";
+            items += w.ref(w.add("MAPPED_ITEM(''," + w.ref(map) + "," + w.ref(target) + ")"));
+        }
+    }
+    w.add("SHAPE_REPRESENTATION('',(" + items + ")," + w.ref(context) + ")");
+    return w.text();
+}
+
+} // namespace
+
+void register_brep_benchmarks(Suite& suite) {
+    // The file is written, and read once, by the first case that needs it.
+    auto path = lazy([] {
+        const std::filesystem::path file = std::filesystem::temp_directory_path() /
+                                           ("rebelflow-bench-" + std::to_string(::getpid()) +
+                                            "-assembly.step");
+        auto named = std::shared_ptr<const std::string>(new std::string(file.string()),
+                                                        [](const std::string* p) {
+                                                            std::filesystem::remove(*p);
+                                                            delete p;
+                                                        });
+        std::ofstream(*named, std::ios::binary) << make_assembly();
+        return named;
+    });
+    auto brep = lazy([path, &suite] { return read_step(*path->get(), suite.pool()); });
+    const std::size_t bodies = parts * instances;
+
+    suite.add(
+        "brep/read-step",
+        [path, &suite](std::size_t n) {
+            const std::string& file = *path->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                read_step(file, suite.pool());
+            }
+        },
+        bodies);
+    suite.add("brep/tessellate-first", [brep, &suite](std::size_t n) {
+        const Brep& model = brep->get();
+        for (std::size_t i = 0; i < n; ++i) {
+            // A model over the same arrays starts with an empty cache.
+            const Brep fresh = Brep::from_arrays(model.arrays());
+            fresh.tessellate(i % fresh.body_count(), tolerance, suite.pool());
+        }
+    });
+    suite.add("brep/tessellate-cached", [brep, &suite](std::size_t n) {
+        const Brep& model = brep->get();
+        for (std::size_t i = 0; i < n; ++i) {
+            model.tessellate(0, tolerance, suite.pool());
+        }
+    });
+    suite.add(
+        "brep/read-tessellate-5",
+        [path, &suite](std::size_t n) {
+            const std::string& file = *path->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                const Brep model = read_step(file, suite.pool());
+                for (std::size_t body = 0; body < 5; ++body) {
+                    model.tessellate(body * 397 % model.body_count(), tolerance, suite.pool());
+                }
+            }
+        },
+        bodies);
+    suite.add(
+        "brep/read-tessellate-all",
+        [path, &suite](std::size_t n) {
+            const std::string& file = *path->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                read_step(file, suite.pool()).tessellate_all(tolerance, suite.pool());
+            }
+        },
+        bodies);
+}
+
+} // namespace rebelflow::bench
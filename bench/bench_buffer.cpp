@@ -0,0 +1,73 @@
+// Large-buffer handoff: a buffer forwarded along a chain of nodes. Sharing
+// makes the cost per hop independent of the buffer size; the COW case shows
+// what one real copy costs for comparison.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <memory>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t hops = 64;
+
+struct Fixture {
+    NodeRegistry registry;
+    Graph graph;
+    Executor executor{1u};
+    NodeId source = invalid_node;
+};
+
+/// Constant(buffer of `elements` f64) -> `hops` x Forward.
+std::shared_ptr<Fixture> make_fixture(std::size_t elements, const char* hop_type) {
+    auto f = std::make_shared<Fixture>();
+    register_builtin_nodes(f->registry);
+    NodeType forward;
+    forward.name = "Forward";
+    forward.inputs = {{"values", DataType::Buffer}};
+    forward.outputs = {{"values", DataType::Buffer}};
+    forward.kernel = [](NodeContext& ctx) { ctx.set_output(0, ctx.input(0)); };
+    f->registry.add(std::move(forward));
+
+    Buffer data = Buffer::allocate(ElementType::F64, elements);
+    for (double& v : data.mutate<double>()) {
+        v = 1.0;
+    }
+    f->source = f->graph.add_node(f->registry, "Constant");
+    f->graph.set_param(f->source, "value", std::move(data));
+    NodeId prev = f->source;
+    for (std::size_t i = 0; i < hops; ++i) {
+        const NodeId hop = f->graph.add_node(f->registry, hop_type);
+        f->graph.connect({prev, 0}, {hop, 0});
+        prev = hop;
+    }
+    return f;
+}
+
+void add_handoff_case(Suite& suite, const std::string& name, std::size_t elements,
+                      const char* hop_type) {
+    suite.add(
+        name,
+        [f = make_fixture(elements, hop_type)](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                f->executor.invalidate_all();
+                f->executor.run(f->graph);
+            }
+        },
+        hops);
+}
+
+} // namespace
+
+void register_buffer_benchmarks(Suite& suite) {
+    add_handoff_case(suite, "buffer/handoff/8KiB", 1024, "Forward");
+    add_handoff_case(suite, "buffer/handoff/64MiB", 8u << 20, "Forward");
+    // Scale copies once per hop: the source keeps its reference.
+    add_handoff_case(suite, "buffer/cow-copy/8KiB", 1024, "Scale");
+}
+
+} // namespace rebelflow::bench
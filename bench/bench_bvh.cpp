@@ -0,0 +1,181 @@
+// Bvh builds and queries on a wavy grid of about a million triangles, on the
+// whole pool: the build, a batch of rays, a batch of closest points, and the
+// intersecting pairs with a second grid waving the other way. The last case
+// casts the same rays by testing every triangle of a 20k-triangle grid, for
+// the scale of the linear scans the hierarchy replaces. Per-item figures are
+// per triangle for the build and overlaps, per query otherwise.
+
+#include "suite.hpp"
+
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/nodes/mesh.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::int64_t divisions = 708; // 2 x 708 x 708 ~ 1M triangles
+constexpr std::int64_t brute_divisions = 100;
+constexpr std::size_t queries = 100'000;
+
+/// A unit grid with z = sign * 0.05 sin(20x) cos(20y).
+Mesh make_wavy(std::int64_t cells, double sign) {
+    NodeRegistry registry;
+    register_mesh_nodes(registry);
+    Graph g;
+    const NodeId grid = g.add_node(registry, "Grid");
+    g.set_param(grid, "divisions_x", cells);
+    g.set_param(grid, "divisions_y", cells);
+    Executor executor;
+    executor.run(g);
+    const Mesh flat = executor.output(grid).as_mesh();
+    std::vector<double> p(flat.positions().begin(), flat.positions().end());
+    for (std::size_t i = 0; i < p.size(); i += 3) {
+        p[i + 2] = sign * 0.05 * std::sin(20 * p[i]) * std::cos(20 * p[i + 1]);
+    }
+    return flat.with_positions(Buffer::adopt(std::move(p), 3));
+}
+
+/// Points scattered over the grid's box and a bit beyond, `z` up to 0.5
+/// above and below.
+std::vector<Bvh::Point> make_points(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> xy(-0.6, 0.6);
+    std::uniform_real_distribution<double> z(-0.5, 0.5);
+    std::vector<Bvh::Point> points(queries);
+    for (Bvh::Point& p : points) {
+        p = {xy(rng), xy(rng), z(rng)};
+    }
+    return points;
+}
+
+/// Downward directions up to 45 degrees off vertical.
+std::vector<Bvh::Point> make_directions(unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> tilt(-1.0, 1.0);
+    std::vector<Bvh::Point> directions(queries);
+    for (Bvh::Point& d : directions) {
+        d = {tilt(rng), tilt(rng), -1.0};
+    }
+    return directions;
+}
+
+/// Nearest hit by testing every triangle (Moller-Trumbore).
+double brute_raycast(const Mesh& mesh, const Bvh::Point& o, const Bvh::Point& d) {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> corners = mesh.corners();
+    double best = std::numeric_limits<double>::infinity();
+    for (std::size_t h = 0; h < corners.size(); h += 3) {
+        const double* a = p.data() + 3 * corners[h];
+        const double* b = p.data() + 3 * corners[h + 1];
+        const double* c = p.data() + 3 * corners[h + 2];
+        const double e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const double e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        const double s[3] = {o[0] - a[0], o[1] - a[1], o[2] - a[2]};
+        const double pv[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2],
+                              d[0] * e2[1] - d[1] * e2[0]};
+        const double det = e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2];
+        if (det == 0) {
+            continue;
+        }
+        const double u = (s[0] * pv[0] + s[1] * pv[1] + s[2] * pv[2]) / det;
+        const double q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2],
+                             s[0] * e1[1] - s[1] * e1[0]};
+        const double v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) / det;
+        const double t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) / det;
+        if (u >= 0 && v >= 0 && u + v <= 1 && t >= 0 && t < best) {
+            best = t;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+void register_bvh_benchmarks(Suite& suite) {
+    auto mesh = lazy([] { return make_wavy(divisions, 1.0); });
+    auto bvh = lazy([mesh, &suite] { return Bvh::build(mesh->get(), suite.pool()); });
+    auto other = lazy([&suite] { return Bvh::build(make_wavy(divisions, -1.0), suite.pool()); });
+    auto small = lazy([] { return make_wavy(brute_divisions, 1.0); });
+    auto origins = lazy([] { return make_points(1); });
+    auto directions = lazy([] { return make_directions(2); });
+    auto hits = std::make_shared<std::vector<double>>(queries);
+    const std::size_t triangles = 2 * divisions * divisions;
+    // The brute-force scan is slow enough that a fraction of the rays does.
+    constexpr std::size_t brute_rays = 1000;
+
+    suite.add(
+        "bvh/build",
+        [mesh, &suite](std::size_t n) {
+            const Mesh& m = mesh->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                Bvh::build(m, suite.pool());
+            }
+        },
+        triangles);
+    suite.add(
+        "bvh/raycast",
+        [bvh, origins, directions, hits, &suite](std::size_t n) {
+            const Bvh& b = bvh->get();
+            const std::vector<Bvh::Point>& o = origins->get();
+            const std::vector<Bvh::Point>& d = directions->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                parallel_for(suite.pool(), queries, 1024, [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t q = begin; q < end; ++q) {
+                        (*hits)[q] = b.raycast(o[q], d[q]).distance;
+                    }
+                });
+            }
+        },
+        queries);
+    suite.add(
+        "bvh/closest-point",
+        [bvh, origins, hits, &suite](std::size_t n) {
+            const Bvh& b = bvh->get();
+            const std::vector<Bvh::Point>& o = origins->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                parallel_for(suite.pool(), queries, 1024, [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t q = begin; q < end; ++q) {
+                        (*hits)[q] = b.closest_point(o[q]).distance;
+                    }
+                });
+            }
+        },
+        queries);
+    suite.add(
+        "bvh/overlaps",
+        [bvh, other, &suite](std::size_t n) {
+            const Bvh& b = bvh->get();
+            const Bvh& c = other->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                b.overlaps(c, 0.0, suite.pool());
+            }
+        },
+        triangles);
+    suite.add(
+        "bvh/raycast-brute-force-20k",
+        [small, origins, directions, hits, &suite](std::size_t n) {
+            const Mesh& m = small->get();
+            const std::vector<Bvh::Point>& o = origins->get();
+            const std::vector<Bvh::Point>& d = directions->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                parallel_for(suite.pool(), brute_rays, 16, [&](std::size_t begin, std::size_t end) {
+                    for (std::size_t q = begin; q < end; ++q) {
+                        (*hits)[q] = brute_raycast(m, o[q], d[q]);
+                    }
+                });
+            }
+        },
+        brute_rays);
+}
+
+} // namespace rebelflow::bench
@@ -0,0 +1,93 @@
+// Result-cache hit paths: raw lookups, and whole runs served from the cache.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/result_cache.hpp"
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t cache_nodes = 1'000;
+constexpr std::uint64_t cache_capacity = 64ull << 20;
+
+/// A cache file private to this process, removed when the last user goes.
+std::shared_ptr<ResultCache> make_cache(const std::string& tag) {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() /
+                                       ("rebelflow-bench-" + tag + "-" +
+                                        std::to_string(::getpid()) + ".cache");
+    auto* cache = new ResultCache(path.string(), cache_capacity);
+    return std::shared_ptr<ResultCache>(cache, [path](ResultCache* c) {
+        delete c;
+        std::filesystem::remove(path);
+    });
+}
+
+} // namespace
+
+void register_cache_benchmarks(Suite& suite) {
+    {
+        auto cache = make_cache("get");
+        auto keys = std::make_shared<std::vector<Digest>>();
+        const std::vector<std::byte> payload(64, std::byte{1});
+        for (std::uint64_t k = 0; k < cache_nodes; ++k) {
+            keys->push_back(Hasher().update(k).digest());
+            cache->put(keys->back(), payload);
+        }
+        suite.add(
+            "cache/get-hit",
+            [cache, keys](std::size_t n) {
+                std::vector<std::byte> out;
+                for (std::size_t i = 0; i < n; ++i) {
+                    for (const Digest& key : *keys) {
+                        cache->get(key, out);
+                    }
+                }
+            },
+            cache_nodes);
+    }
+
+    // Every iteration drops the executor's in-memory outputs, so each node is
+    // keyed, looked up and deserialized from the cache instead of computed.
+    {
+        struct Fixture {
+            std::shared_ptr<ResultCache> cache = make_cache("run");
+            NodeRegistry registry;
+            Graph graph;
+            Executor executor{1u};
+        };
+        auto f = std::make_shared<Fixture>();
+        register_builtin_nodes(f->registry);
+        const NodeId one = f->graph.add_node(f->registry, "Constant");
+        f->graph.set_param(one, "value", 1.0);
+        NodeId prev = one;
+        for (std::size_t i = 1; i < cache_nodes; ++i) {
+            const NodeId add = f->graph.add_node(f->registry, "Add");
+            f->graph.connect(prev, i == 1 ? "value" : "result", add, "a");
+            f->graph.connect(one, "value", add, "b");
+            prev = add;
+        }
+        f->executor.set_result_cache(f->cache.get());
+        f->executor.run(f->graph);
+        suite.add(
+            "cache/run-all-hits",
+            [f](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    f->executor.invalidate_all();
+                    f->executor.run(f->graph);
+                }
+            },
+            cache_nodes);
+    }
+}
+
+} // namespace rebelflow::bench
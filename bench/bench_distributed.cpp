@@ -0,0 +1,100 @@
+// Distributed evaluation: two workers serving on threads of this process over
+// UNIX sockets, so the figures are protocol and copy costs without a network.
+// Per-item figures are per buffer element.
+
+#include "suite.hpp"
+
+#include "rebelflow/distributed.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::int64_t elements = 1'000'000;
+
+/// Two workers and a coordinator connected to them, torn down in order.
+struct Cluster {
+    NodeRegistry registry;
+    std::vector<std::unique_ptr<DistributedWorker>> workers;
+    std::vector<Listener> listeners;
+    std::vector<std::thread> threads;
+    std::unique_ptr<DistributedExecutor> executor;
+
+    Cluster() {
+        register_builtin_nodes(registry);
+        std::vector<std::string> addresses;
+        for (int i = 0; i < 2; ++i) {
+            // Small stores, so edited runs keep evicting their old results.
+            workers.push_back(std::make_unique<DistributedWorker>(registry, 64 << 20));
+            listeners.push_back(Listener::bind("unix:/tmp/rebelflow-bench-" +
+                                               std::to_string(::getpid()) + "-" +
+                                               std::to_string(i) + ".sock"));
+            addresses.push_back(listeners.back().address());
+        }
+        for (std::size_t i = 0; i < workers.size(); ++i) {
+            threads.emplace_back([this, i] { workers[i]->serve(listeners[i]); });
+        }
+        executor = std::make_unique<DistributedExecutor>(addresses);
+    }
+
+    ~Cluster() {
+        executor.reset();
+        for (Listener& listener : listeners) {
+            listener.shutdown();
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+    }
+};
+
+} // namespace
+
+void register_distributed_benchmarks(Suite& suite) {
+    auto cluster = std::make_shared<Cluster>();
+
+    // Range -> Scale on the first worker, Scale -> Sum on the second: one
+    // buffer crosses between them whenever the range changes.
+    auto graph = std::make_shared<Graph>();
+    const NodeId range = graph->add_node(cluster->registry, "Range");
+    graph->set_param(range, "count", elements);
+    const NodeId a = graph->add_node(cluster->registry, "Scale");
+    graph->connect(range, "values", a, "values");
+    const NodeId b = graph->add_node(cluster->registry, "Scale");
+    graph->connect(a, "values", b, "values");
+    const NodeId sum = graph->add_node(cluster->registry, "Sum");
+    graph->connect(b, "values", sum, "values");
+    auto assignment = std::make_shared<std::vector<std::uint32_t>>(graph->id_bound(), 0);
+    (*assignment)[b] = 1;
+    (*assignment)[sum] = 1;
+
+    suite.add(
+        "distributed/scale-chain/reused",
+        [cluster, graph, assignment](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                cluster->executor->run(*graph, *assignment);
+            }
+        },
+        static_cast<std::size_t>(elements));
+    suite.add(
+        "distributed/scale-chain/edited",
+        [cluster, graph, assignment, range, edits = std::make_shared<std::int64_t>(0)](
+            std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                // A range never seen before, so every node runs.
+                graph->set_param(range, "count", elements - ++*edits % 1000);
+                cluster->executor->run(*graph, *assignment);
+            }
+        },
+        static_cast<std::size_t>(elements));
+}
+
+} // namespace rebelflow::bench
@@ -0,0 +1,113 @@
+// Graph construction and executor scheduling overhead. The nodes do almost
+// no work, so the figures are the engine's per-node cost.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <memory>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t graph_nodes = 10'000;
+
+const NodeRegistry& registry() {
+    static const NodeRegistry r = [] {
+        NodeRegistry reg;
+        register_builtin_nodes(reg);
+        return reg;
+    }();
+    return r;
+}
+
+/// Constant -> Add -> Add -> ... with `nodes` nodes in total.
+Graph make_chain(std::size_t nodes) {
+    Graph g;
+    const NodeId one = g.add_node(registry(), "Constant");
+    g.set_param(one, "value", 1.0);
+    NodeId prev = one;
+    for (std::size_t i = 1; i < nodes; ++i) {
+        const NodeId add = g.add_node(registry(), "Add");
+        g.connect(prev, i == 1 ? "value" : "result", add, "a");
+        g.connect(one, "value", add, "b");
+        prev = add;
+    }
+    return g;
+}
+
+/// One constant fanning out to `nodes` - 1 independent Add nodes.
+Graph make_wide(std::size_t nodes) {
+    Graph g;
+    const NodeId one = g.add_node(registry(), "Constant");
+    for (std::size_t i = 1; i < nodes; ++i) {
+        const NodeId add = g.add_node(registry(), "Add");
+        g.connect(one, "value", add, "a");
+        g.connect(one, "value", add, "b");
+    }
+    return g;
+}
+
+void add_schedule_case(Suite& suite, const std::string& name, Graph (*make)(std::size_t),
+                       unsigned threads) {
+    suite.add(
+        name,
+        [graph = std::make_shared<Graph>(make(graph_nodes)),
+         executor = std::make_shared<Executor>(threads)](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                executor->invalidate_all();
+                executor->run(*graph);
+            }
+        },
+        graph_nodes);
+}
+
+} // namespace
+
+void register_graph_benchmarks(Suite& suite) {
+    suite.add(
+        "graph/construct-chain",
+        [](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                Graph g = make_chain(graph_nodes);
+                g.validate();
+            }
+        },
+        graph_nodes);
+
+    add_schedule_case(suite, "executor/chain/1-thread", make_chain, 1);
+    add_schedule_case(suite, "executor/chain/pool", make_chain, 0);
+    add_schedule_case(suite, "executor/wide/1-thread", make_wide, 1);
+    add_schedule_case(suite, "executor/wide/pool", make_wide, 0);
+
+    // A template with many optional branches of which one is wanted: pull()
+    // evaluates that branch only, where run() would evaluate all of them.
+    suite.add(
+        "executor/wide/pull-one",
+        [graph = std::make_shared<Graph>(make_wide(graph_nodes)),
+         executor = std::make_shared<Executor>(1u)](std::size_t n) {
+            const PortRef wanted[] = {{static_cast<NodeId>(graph_nodes - 1), 0}};
+            for (std::size_t i = 0; i < n; ++i) {
+                executor->invalidate_all();
+                executor->pull(*graph, wanted);
+            }
+        },
+        graph_nodes);
+
+    // A run with nothing dirty: only the revision scan.
+    auto graph = std::make_shared<Graph>(make_wide(graph_nodes));
+    auto executor = std::make_shared<Executor>(0u);
+    executor->run(*graph);
+    suite.add(
+        "executor/up-to-date",
+        [graph, executor](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                executor->run(*graph);
+            }
+        },
+        graph_nodes);
+}
+
+} // namespace rebelflow::bench
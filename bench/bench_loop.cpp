@@ -0,0 +1,53 @@
+// Collection nodes: Map and Reduce over a large buffer, on one thread and on
+// the whole pool. Per-item figures are per collection item.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/loop.hpp"
+
+#include <memory>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t items = 200'000;
+
+/// Range -> Map(x * 0.5 + i) -> Reduce(a + b).
+std::shared_ptr<Graph> make_pipeline(const NodeRegistry& registry) {
+    auto g = std::make_shared<Graph>();
+    const NodeId range = g->add_node(registry, "Range");
+    g->set_param(range, "count", static_cast<std::int64_t>(items));
+    const NodeId map = g->add_node(registry, "Map");
+    g->set_param(map, "code", std::string("x * 0.5 + i"));
+    g->connect(range, "values", map, "items");
+    const NodeId reduce = g->add_node(registry, "Reduce");
+    g->connect(map, "result", reduce, "items");
+    return g;
+}
+
+} // namespace
+
+void register_loop_benchmarks(Suite& suite) {
+    auto registry = std::make_shared<NodeRegistry>();
+    register_builtin_nodes(*registry);
+    register_loop_nodes(*registry);
+
+    for (const auto& [name, threads] : {std::pair{"loop/map-reduce/1-thread", 1u},
+                                        std::pair{"loop/map-reduce/pool", 0u}}) {
+        suite.add(
+            name,
+            [graph = make_pipeline(*registry),
+             executor = std::make_shared<Executor>(threads)](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    executor->invalidate_all();
+                    executor->run(*graph);
+                }
+            },
+            items);
+    }
+}
+
+} // namespace rebelflow::bench
@@ -0,0 +1,104 @@
+// Mesh kernels on a grid of about a million triangles, on the whole pool:
+// building the half-edge links, welding a triangle soup of the same grid,
+// one smoothing pass, vertex normals, and one subdivision level of a quarter
+// of the grid (so the result is the same size). Per-item figures are per
+// input triangle.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/nodes/mesh.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <vector>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::int64_t divisions = 708; // 2 x 708 x 708 ~ 1M triangles
+
+Mesh make_grid(std::int64_t cells) {
+    NodeRegistry registry;
+    register_mesh_nodes(registry);
+    Graph g;
+    const NodeId grid = g.add_node(registry, "Grid");
+    g.set_param(grid, "divisions_x", cells);
+    g.set_param(grid, "divisions_y", cells);
+    Executor executor;
+    executor.run(g);
+    return executor.output(grid).as_mesh();
+}
+
+/// Every triangle with vertices of its own, as read from an STL file.
+Mesh make_soup(const Mesh& mesh) {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> corners = mesh.corners();
+    std::vector<double> positions(corners.size() * 3);
+    std::vector<std::uint32_t> triangles(corners.size());
+    for (std::size_t h = 0; h < corners.size(); ++h) {
+        std::copy_n(p.data() + 3 * corners[h], 3, positions.data() + 3 * h);
+        triangles[h] = static_cast<std::uint32_t>(h);
+    }
+    return Mesh::from_triangles(Buffer::adopt(std::move(positions), 3),
+                                Buffer::adopt(std::move(triangles), 3));
+}
+
+} // namespace
+
+void register_mesh_benchmarks(Suite& suite) {
+    auto grid = lazy([] { return make_grid(divisions); });
+    auto soup = lazy([grid] { return make_soup(grid->get()); });
+    auto quarter = lazy([] { return make_grid(divisions / 2); });
+    const std::size_t triangles = 2 * divisions * divisions;
+    const std::size_t quarter_triangles = 2 * (divisions / 2) * (divisions / 2);
+
+    suite.add(
+        "mesh/link-half-edges",
+        [grid, &suite](std::size_t n) {
+            const Mesh::Arrays& m = grid->get().arrays();
+            for (std::size_t i = 0; i < n; ++i) {
+                Mesh::from_triangles(m.positions, m.corners, suite.pool());
+            }
+        },
+        triangles);
+    suite.add(
+        "mesh/weld",
+        [soup, &suite](std::size_t n) {
+            const Mesh& mesh = soup->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                weld(mesh, 1e-9, suite.pool());
+            }
+        },
+        triangles);
+    suite.add(
+        "mesh/smooth",
+        [grid, &suite](std::size_t n) {
+            const Mesh& mesh = grid->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                smooth(mesh, 1, 0.5, true, suite.pool());
+            }
+        },
+        triangles);
+    suite.add(
+        "mesh/normals",
+        [grid, &suite](std::size_t n) {
+            const Mesh& mesh = grid->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                vertex_normals(mesh, suite.pool());
+            }
+        },
+        triangles);
+    suite.add(
+        "mesh/subdivide",
+        [quarter, &suite](std::size_t n) {
+            const Mesh& mesh = quarter->get();
+            for (std::size_t i = 0; i < n; ++i) {
+                subdivide(mesh, 1, suite.pool());
+            }
+        },
+        quarter_triangles);
+}
+
+} // namespace rebelflow::bench
@@ -0,0 +1,129 @@
+// Mesh files of a grid of about a million triangles, on the whole pool:
+// writing and reading back OBJ, ASCII and binary PLY, and binary STL. The
+// files go to the temporary directory, whose page cache serves the reads.
+// The last case reads the OBJ file a line at a time through an ifstream,
+// for the scale of the sequential parser the mapped, parallel one replaces.
+// Per-item figures are per triangle.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/mesh_io.hpp"
+#include "rebelflow/nodes/mesh.hpp"
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::int64_t divisions = 708; // 2 x 708 x 708 ~ 1M triangles
+
+Mesh make_grid(std::int64_t cells) {
+    NodeRegistry registry;
+    register_mesh_nodes(registry);
+    Graph g;
+    const NodeId grid = g.add_node(registry, "Grid");
+    g.set_param(grid, "divisions_x", cells);
+    g.set_param(grid, "divisions_y", cells);
+    Executor executor;
+    executor.run(g);
+    return executor.output(grid).as_mesh();
+}
+
+/// A file name private to this process, removed when the last user goes.
+std::shared_ptr<const std::string> make_path(const std::string& tag) {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() /
+                                       ("rebelflow-bench-" + std::to_string(::getpid()) + "-" +
+                                        tag);
+    return std::shared_ptr<const std::string>(new std::string(path.string()),
+                                              [](const std::string* p) {
+                                                  std::filesystem::remove(*p);
+                                                  delete p;
+                                              });
+}
+
+/// Counts the vertices and faces of an OBJ file with getline and strtod.
+std::size_t getline_obj(const std::string& path) {
+    std::ifstream in(path);
+    std::vector<double> positions;
+    std::vector<std::uint32_t> triangles;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string keyword;
+        fields >> keyword;
+        if (keyword == "v") {
+            double x = 0, y = 0, z = 0;
+            fields >> x >> y >> z;
+            positions.insert(positions.end(), {x, y, z});
+        } else if (keyword == "f") {
+            std::uint32_t a = 0, b = 0, c = 0;
+            fields >> a >> b >> c;
+            triangles.insert(triangles.end(), {a - 1, b - 1, c - 1});
+        }
+    }
+    return triangles.size() / 3;
+}
+
+} // namespace
+
+void register_mesh_io_benchmarks(Suite& suite) {
+    auto mesh = lazy([] { return make_grid(divisions); });
+    const std::size_t triangles = 2 * divisions * divisions;
+
+    struct Case {
+        const char* name;
+        const char* extension;
+        bool binary;
+    };
+    for (const Case& c : {Case{"obj", "obj", false}, Case{"ply-ascii", "ply", false},
+                          Case{"ply-binary", "ply", true}, Case{"stl-binary", "stl", true}}) {
+        // Written once before the first case that reads it.
+        auto file = lazy([mesh, c, &suite] {
+            auto path = make_path(std::string(c.name) + "." + c.extension);
+            write_mesh(mesh->get(), *path, c.binary, suite.pool());
+            return path;
+        });
+        suite.add(
+            std::string("mesh-io/write-") + c.name,
+            [mesh, file, binary = c.binary, &suite](std::size_t n) {
+                const std::string& path = *file->get();
+                for (std::size_t i = 0; i < n; ++i) {
+                    write_mesh(mesh->get(), path, binary, suite.pool());
+                }
+            },
+            triangles);
+        suite.add(
+            std::string("mesh-io/read-") + c.name,
+            [file, &suite](std::size_t n) {
+                const std::string& path = *file->get();
+                for (std::size_t i = 0; i < n; ++i) {
+                    read_mesh(path, suite.pool());
+                }
+            },
+            triangles);
+        if (c.extension == std::string("obj")) {
+            suite.add(
+                "mesh-io/read-obj-getline",
+                [file](std::size_t n) {
+                    const std::string& path = *file->get();
+                    for (std::size_t i = 0; i < n; ++i) {
+                        getline_obj(path);
+                    }
+                },
+                triangles);
+        }
+    }
+}
+
+} // namespace rebelflow::bench
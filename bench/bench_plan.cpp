@@ -0,0 +1,91 @@
+// Interpreted (Executor) versus compiled (CompiledPlan) evaluation of the same
+// graphs. Every iteration recomputes every node, so the difference is the
+// per-node overhead of each mode. The fused case lets the plan merge the
+// arithmetic nodes into scripts and fold the constants.
+
+#include "suite.hpp"
+
+#include "rebelflow/compiled_plan.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <memory>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t graph_nodes = 1000;
+
+const NodeRegistry& registry() {
+    static const NodeRegistry r = [] {
+        NodeRegistry reg;
+        register_builtin_nodes(reg);
+        return reg;
+    }();
+    return r;
+}
+
+/// Constant -> Add -> Add -> ... : one long dependency chain.
+std::shared_ptr<Graph> make_chain() {
+    auto g = std::make_shared<Graph>();
+    const NodeId one = g->add_node(registry(), "Constant");
+    g->set_param(one, "value", 1.0);
+    NodeId prev = one;
+    for (std::size_t i = 1; i < graph_nodes; ++i) {
+        const NodeId add = g->add_node(registry(), "Add");
+        g->connect(prev, i == 1 ? "value" : "result", add, "a");
+        g->connect(one, "value", add, "b");
+        prev = add;
+    }
+    return g;
+}
+
+/// Two constants feeding many independent Add nodes.
+std::shared_ptr<Graph> make_wide() {
+    auto g = std::make_shared<Graph>();
+    const NodeId a = g->add_node(registry(), "Constant");
+    const NodeId b = g->add_node(registry(), "Constant");
+    for (std::size_t i = 2; i < graph_nodes; ++i) {
+        const NodeId add = g->add_node(registry(), "Add");
+        g->connect(a, "value", add, "a");
+        g->connect(b, "value", add, "b");
+    }
+    return g;
+}
+
+void add_pair(Suite& suite, const std::string& shape, std::shared_ptr<Graph> (*make)()) {
+    suite.add(
+        "plan/" + shape + "/interpreted",
+        [graph = make(), executor = std::make_shared<Executor>(1u)](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                executor->invalidate_all();
+                executor->run(*graph);
+            }
+        },
+        graph_nodes);
+
+    auto graph = make();
+    for (const bool fuse : {false, true}) {
+        PlanOptions options;
+        options.fuse_expressions = fuse;
+        auto plan = std::make_shared<CompiledPlan>(CompiledPlan::compile(*graph, options));
+        suite.add(
+            "plan/" + shape + (fuse ? "/fused" : "/compiled"),
+            [plan](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    plan->run();
+                }
+            },
+            graph_nodes);
+    }
+}
+
+} // namespace
+
+void register_plan_benchmarks(Suite& suite) {
+    add_pair(suite, "chain", make_chain);
+    add_pair(suite, "wide", make_wide);
+}
+
+} // namespace rebelflow::bench
@@ -0,0 +1,62 @@
+// Out-of-process evaluation: a buffer node run in the executor's own process
+// and in a worker process, with buffers exchanged through shared memory.
+// Per-item figures are per buffer element.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/process_pool.hpp"
+
+#include <memory>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::int64_t elements = 1'000'000;
+
+/// Range -> Scale -> Scale -> Sum, with the Scale nodes of type `scale`.
+std::shared_ptr<Graph> make_chain(const NodeRegistry& registry, const char* scale) {
+    auto g = std::make_shared<Graph>();
+    const NodeId range = g->add_node(registry, "Range");
+    g->set_param(range, "count", elements);
+    const NodeId a = g->add_node(registry, scale);
+    g->connect(range, "values", a, "values");
+    const NodeId b = g->add_node(registry, scale);
+    g->connect(a, "values", b, "values");
+    const NodeId sum = g->add_node(registry, "Sum");
+    g->connect(b, "values", sum, "values");
+    return g;
+}
+
+} // namespace
+
+void register_process_benchmarks(Suite& suite) {
+    auto registry = std::make_shared<NodeRegistry>();
+    register_builtin_nodes(*registry);
+    NodeType isolated = *registry->get("Scale");
+    isolated.name = "IsolatedScale";
+    isolated.isolated = true;
+    registry->add(std::move(isolated));
+    // Workers fork from a launcher started here, while the suite is still
+    // being assembled and no benchmark is running.
+    auto processes = std::make_shared<ProcessPool>(*registry, 2);
+
+    for (const auto& [name, scale] : {std::pair{"process/scale-chain/in-process", "Scale"},
+                                      std::pair{"process/scale-chain/isolated", "IsolatedScale"}}) {
+        auto executor = std::make_shared<Executor>(1);
+        executor->set_process_pool(processes.get());
+        suite.add(
+            name,
+            [graph = make_chain(*registry, scale), executor, processes](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    executor->invalidate_all();
+                    executor->run(*graph);
+                }
+            },
+            static_cast<std::size_t>(elements));
+    }
+}
+
+} // namespace rebelflow::bench
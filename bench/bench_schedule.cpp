@@ -0,0 +1,79 @@
+// Scheduling order: one long chain of costly nodes next to many cheap
+// independent ones, on a four-thread pool, taken in release order and by
+// critical path from a trained cost model. Nodes busy-wait, so the figures
+// show ordering, not compute; the gap only appears with several cores.
+// Per-item figures are per node.
+
+#include "suite.hpp"
+
+#include "rebelflow/cost_model.hpp"
+#include "rebelflow/executor.hpp"
+
+#include <chrono>
+#include <memory>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr int cheap_nodes = 48;
+constexpr int chain_nodes = 8;
+
+NodeType spin_type(const char* name, std::chrono::microseconds cost) {
+    NodeType type;
+    type.name = name;
+    type.inputs = {{"x", DataType::Float, 0.0}};
+    type.outputs = {{"y", DataType::Float}};
+    type.compute = [cost](NodeContext& ctx) {
+        const auto end = std::chrono::steady_clock::now() + cost;
+        while (std::chrono::steady_clock::now() < end) {
+        }
+        ctx.set_output(0, ctx.input(0).as_float() + 1.0);
+    };
+    return type;
+}
+
+/// The cheap nodes come first, so release order starts with them.
+std::shared_ptr<Graph> make_graph(const NodeRegistry& registry) {
+    auto g = std::make_shared<Graph>();
+    for (int i = 0; i < cheap_nodes; ++i) {
+        g->add_node(registry, "CheapSpin");
+    }
+    NodeId prev = g->add_node(registry, "CostlySpin");
+    for (int i = 1; i < chain_nodes; ++i) {
+        const NodeId next = g->add_node(registry, "CostlySpin");
+        g->connect(prev, "y", next, "x");
+        prev = next;
+    }
+    return g;
+}
+
+} // namespace
+
+void register_schedule_benchmarks(Suite& suite) {
+    auto registry = std::make_shared<NodeRegistry>();
+    registry->add(spin_type("CheapSpin", std::chrono::microseconds(20)));
+    registry->add(spin_type("CostlySpin", std::chrono::microseconds(100)));
+    auto graph = make_graph(*registry);
+    auto costs = std::make_shared<CostModel>();
+
+    for (const auto& [name, ranked] : {std::pair{"schedule/critical-path/release-order", false},
+                                       std::pair{"schedule/critical-path/cost-model", true}}) {
+        auto executor = std::make_shared<Executor>(4);
+        if (ranked) {
+            // Trained by its first run, like any other.
+            executor->set_cost_model(costs.get());
+        }
+        suite.add(
+            name,
+            [graph, executor, costs, registry](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    executor->invalidate_all();
+                    executor->run(*graph);
+                }
+            },
+            cheap_nodes + chain_nodes);
+    }
+}
+
+} // namespace rebelflow::bench
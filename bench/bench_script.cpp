@@ -0,0 +1,99 @@
+// Call overhead of scripted nodes. Host callbacks are what script bindings
+// register: a std::function carrying captured state, called through
+// NodeType::compute rather than a plain kernel pointer. Script nodes run
+// compiled bytecode in the VM.
+
+#include "suite.hpp"
+
+#include "rebelflow/compiled_plan.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/script.hpp"
+#include "rebelflow/script.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t calls = 1'000;
+
+std::shared_ptr<CompiledPlan> make_chain(const NodeRegistry& registry, const char* type,
+                                         bool fuse = false) {
+    Graph g;
+    const NodeId one = g.add_node(registry, "Constant");
+    g.set_param(one, "value", 1.0);
+    NodeId prev = one;
+    for (std::size_t i = 0; i < calls; ++i) {
+        const NodeId node = g.add_node(registry, type);
+        if (g.type(node).name == "Script") {
+            g.set_param(node, "code", std::string("a + 1"));
+        }
+        g.connect({prev, 0}, {node, 0});
+        prev = node;
+    }
+    PlanOptions options;
+    options.fuse_expressions = fuse;
+    return std::make_shared<CompiledPlan>(CompiledPlan::compile(g, options));
+}
+
+} // namespace
+
+void register_script_benchmarks(Suite& suite) {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    register_script_nodes(registry);
+
+    NodeType callback;
+    callback.name = "HostCallback";
+    callback.inputs = {{"x", DataType::Float, 0.0}};
+    callback.outputs = {{"y", DataType::Float}};
+    callback.compute = [scale = 1.0](NodeContext& ctx) {
+        ctx.set_output(0, ctx.input(0).as_float() * scale + 1.0);
+    };
+    registry.add(std::move(callback));
+
+    NodeType kernel;
+    kernel.name = "Kernel";
+    kernel.inputs = {{"x", DataType::Float, 0.0}};
+    kernel.outputs = {{"y", DataType::Float}};
+    kernel.kernel = [](NodeContext& ctx) { ctx.set_output(0, ctx.input(0).as_float() + 1.0); };
+    registry.add(std::move(kernel));
+
+    for (const char* type : {"HostCallback", "Kernel", "Script"}) {
+        suite.add(
+            std::string("script/call/") + type,
+            [plan = make_chain(registry, type)](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    plan->run();
+                }
+            },
+            calls);
+    }
+
+    // The Script chain fused by the plan: one script, folded to constants.
+    suite.add(
+        "script/call/Script-fused",
+        [plan = make_chain(registry, "Script", true)](std::size_t n) {
+            for (std::size_t i = 0; i < n; ++i) {
+                plan->run();
+            }
+        },
+        calls);
+
+    // One VM call on vector inputs, without a graph around it.
+    auto script = std::make_shared<Script>(Script::compile(
+        "let d = b - a\nlet r = c * 0.5\ndot(d, d) < r * r ? length(normalize(d)) : 0"));
+    auto values = std::make_shared<std::vector<Value>>(std::vector<Value>{
+        Buffer::copy_of<double>(std::vector<double>{0.0, 0.0, 0.0}, 3),
+        Buffer::copy_of<double>(std::vector<double>{1.0, 2.0, 2.0}, 3), Value(8.0), Value(0.0)});
+    suite.add("script/vm/vector", [script, values](std::size_t n) {
+        const Value* inputs[] = {&(*values)[0], &(*values)[1], &(*values)[2], &(*values)[3]};
+        for (std::size_t i = 0; i < n; ++i) {
+            script->run(inputs);
+        }
+    });
+}
+
+} // namespace rebelflow::bench
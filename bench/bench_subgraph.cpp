@@ -0,0 +1,88 @@
+// Macro instancing: many instances of one sub-graph type, each evaluating the
+// shared plan of a small body. Per-item figures are per instance.
+
+#include "suite.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/subgraph.hpp"
+
+#include <memory>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr std::size_t instances = 2'000;
+
+/// Instances of a "hole pattern" body: (count * spacing) + offset and
+/// max(count, 1). `distinct` input values spread over the instances.
+std::shared_ptr<Graph> make_instances(NodeRegistry& registry, const SubgraphOptions& options,
+                                      const char* type_name, std::size_t distinct) {
+    auto body = std::make_shared<Graph>();
+    const NodeId count = body->add_node(registry, "SubgraphInput");
+    body->set_param(count, "name", std::string("count"));
+    const NodeId spacing = body->add_node(registry, "SubgraphInput");
+    body->set_param(spacing, "name", std::string("spacing"));
+    const NodeId offset = body->add_node(registry, "Constant");
+    body->set_param(offset, "value", 0.5);
+    const NodeId length = body->add_node(registry, "Multiply");
+    body->connect(count, "value", length, "a");
+    body->connect(spacing, "value", length, "b");
+    const NodeId total = body->add_node(registry, "Add");
+    body->connect(length, "result", total, "a");
+    body->connect(offset, "value", total, "b");
+    const NodeId holes = body->add_node(registry, "Max");
+    body->connect(count, "value", holes, "a");
+    const NodeId one = body->add_node(registry, "Constant");
+    body->set_param(one, "value", 1.0);
+    body->connect(one, "value", holes, "b");
+    const NodeId out_length = body->add_node(registry, "SubgraphOutput");
+    body->set_param(out_length, "name", std::string("length"));
+    body->connect(total, "result", out_length, "value");
+    const NodeId out_holes = body->add_node(registry, "SubgraphOutput");
+    body->set_param(out_holes, "name", std::string("holes"));
+    body->connect(holes, "result", out_holes, "value");
+
+    const auto type = registry.add(subgraph_type(type_name, body, options));
+    auto g = std::make_shared<Graph>();
+    const NodeId spacing_value = g->add_node(registry, "Constant");
+    g->set_param(spacing_value, "value", 2.5);
+    for (std::size_t i = 0; i < instances; ++i) {
+        const NodeId c = g->add_node(registry, "Constant");
+        g->set_param(c, "value", static_cast<double>(i % distinct));
+        const NodeId instance = g->add_node(type);
+        g->connect(c, "value", instance, "count");
+        g->connect(spacing_value, "value", instance, "spacing");
+    }
+    return g;
+}
+
+} // namespace
+
+void register_subgraph_benchmarks(Suite& suite) {
+    auto registry = std::make_shared<NodeRegistry>();
+    register_builtin_nodes(*registry);
+    register_subgraph_nodes(*registry);
+
+    SubgraphOptions plain;
+    plain.memo_entries = 0;
+    SubgraphOptions memo;
+    const std::pair<const char*, std::shared_ptr<Graph>> cases[] = {
+        {"subgraph/instances", make_instances(*registry, plain, "Pattern", instances)},
+        {"subgraph/instances-memo", make_instances(*registry, memo, "MemoPattern", 10)},
+    };
+    for (const auto& [name, graph] : cases) {
+        suite.add(
+            name,
+            [registry, graph, executor = std::make_shared<Executor>(1u)](std::size_t n) {
+                for (std::size_t i = 0; i < n; ++i) {
+                    executor->invalidate_all();
+                    executor->run(*graph);
+                }
+            },
+            instances);
+    }
+}
+
+} // namespace rebelflow::bench
@@ -0,0 +1,80 @@
+// rebelflow-bench [--output FILE] [FILTER]
+//
+// Runs every case whose name contains FILTER and prints a table, a line as
+// each case finishes. Results are also written to FILE (default
+// bench_output.txt), line by line, in a stable, tab-separated form meant for
+// diffing between releases:
+//
+//     # rebelflow-bench format 1
+//     # version <library version>
+//     # threads <hardware threads>
+//     name<TAB>iterations<TAB>ns_per_iteration<TAB>ns_per_item
+//
+// One line per case, in registration order. Case names are never reused for
+// a different measurement.
+
+#include "suite.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#ifndef REBELFLOW_VERSION
+#define REBELFLOW_VERSION "unknown"
+#endif
+
+int main(int argc, char** argv) {
+    std::string output = "bench_output.txt";
+    std::string filter;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            output = argv[++i];
+        } else if (std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0) {
+            std::printf("usage: %s [--output FILE] [FILTER]\n", argv[0]);
+            return 0;
+        } else {
+            filter = argv[i];
+        }
+    }
+
+    rebelflow::bench::Suite suite;
+    rebelflow::bench::register_graph_benchmarks(suite);
+    rebelflow::bench::register_plan_benchmarks(suite);
+    rebelflow::bench::register_batch_benchmarks(suite);
+    rebelflow::bench::register_cache_benchmarks(suite);
+    rebelflow::bench::register_buffer_benchmarks(suite);
+    rebelflow::bench::register_script_benchmarks(suite);
+    rebelflow::bench::register_subgraph_benchmarks(suite);
+    rebelflow::bench::register_loop_benchmarks(suite);
+    rebelflow::bench::register_process_benchmarks(suite);
+    rebelflow::bench::register_distributed_benchmarks(suite);
+    rebelflow::bench::register_schedule_benchmarks(suite);
+    rebelflow::bench::register_mesh_benchmarks(suite);
+    rebelflow::bench::register_bvh_benchmarks(suite);
+    rebelflow::bench::register_boolean_benchmarks(suite);
+    rebelflow::bench::register_mesh_io_benchmarks(suite);
+    rebelflow::bench::register_brep_benchmarks(suite);
+
+    std::FILE* out = std::fopen(output.c_str(), "w");
+    if (out == nullptr) {
+        std::fprintf(stderr, "cannot write %s: %s\n", output.c_str(), std::strerror(errno));
+        return 1;
+    }
+    std::fprintf(out, "# rebelflow-bench format 1\n# version %s\n# threads %u\n",
+                 REBELFLOW_VERSION, std::thread::hardware_concurrency());
+
+    // Each line goes out as its case finishes, so a long run shows progress
+    // and an interrupted one keeps what it measured.
+    suite.run(filter, [out](const rebelflow::bench::Result& r) {
+        std::printf("%-40s %12.1f ns/iter %10.2f ns/item  (%zu iterations)\n", r.name.c_str(),
+                    r.ns_per_iteration, r.ns_per_item, r.iterations);
+        std::fflush(stdout);
+        std::fprintf(out, "%s\t%zu\t%.1f\t%.3f\n", r.name.c_str(), r.iterations,
+                     r.ns_per_iteration, r.ns_per_item);
+        std::fflush(out);
+    });
+    std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,73 @@
+#include "suite.hpp"
+
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace rebelflow::bench {
+
+namespace {
+
+constexpr auto min_sample_time = std::chrono::milliseconds(100);
+constexpr int samples = 5;
+
+double time_ns(const Body& body, std::size_t iterations) {
+    const auto start = std::chrono::steady_clock::now();
+    body(iterations);
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+} // namespace
+
+Suite::Suite() = default;
+Suite::~Suite() = default;
+
+ThreadPool* Suite::pool() {
+    std::call_once(pool_once_, [this] { pool_ = std::make_unique<ThreadPool>(); });
+    return pool_.get();
+}
+
+void Suite::add(std::string name, Body body, std::size_t items) {
+    cases_.push_back({std::move(name), std::move(body), std::max<std::size_t>(items, 1)});
+}
+
+std::vector<Result> Suite::run(const std::string& filter, const Report& report) const {
+    std::vector<Result> results;
+    for (const Case& c : cases_) {
+        if (!filter.empty() && c.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        c.body(0);
+
+        // Calibrate: grow the iteration count until a sample is long enough.
+        std::size_t iterations = 1;
+        double elapsed = time_ns(c.body, iterations);
+        while (elapsed < std::chrono::duration<double, std::nano>(min_sample_time).count()) {
+            const double scale = elapsed > 0 ? 1.5 * min_sample_time.count() * 1e6 / elapsed : 10;
+            iterations = std::max(iterations + 1,
+                                  static_cast<std::size_t>(iterations * std::min(scale, 10.0)));
+            elapsed = time_ns(c.body, iterations);
+        }
+
+        std::vector<double> per_iteration;
+        for (int s = 0; s < samples; ++s) {
+            per_iteration.push_back(time_ns(c.body, iterations) / iterations);
+        }
+        std::sort(per_iteration.begin(), per_iteration.end());
+
+        Result r;
+        r.name = c.name;
+        r.iterations = iterations;
+        r.ns_per_iteration = per_iteration[samples / 2];
+        r.ns_per_item = r.ns_per_iteration / static_cast<double>(c.items);
+        results.push_back(std::move(r));
+        if (report) {
+            report(results.back());
+        }
+    }
+    return results;
+}
+
+} // namespace rebelflow::bench
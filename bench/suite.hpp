@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace rebelflow {
+class ThreadPool;
+}
+
+namespace rebelflow::bench {
+
+/// Runs the operation under test `iterations` times. Each case is first run
+/// for 0 iterations, untimed, so a body can build its data on first use.
+using Body = std::function<void(std::size_t iterations)>;
+
+/// Case data built the first time it is asked for, so cases the filter
+/// leaves out cost nothing to register. Shared by the cases that use it.
+template <typename T>
+class Lazy {
+public:
+    explicit Lazy(std::function<T()> make) : make_(std::move(make)) {}
+
+    const T& get() {
+        std::call_once(once_, [this] { value_.emplace(make_()); });
+        return *value_;
+    }
+
+private:
+    std::function<T()> make_;
+    std::once_flag once_;
+    std::optional<T> value_;
+};
+
+template <typename Make>
+auto lazy(Make make) {
+    return std::make_shared<Lazy<std::invoke_result_t<Make>>>(std::move(make));
+}
+
+struct Case {
+    std::string name;
+    Body body;
+    /// Work items (nodes, elements) processed per iteration, for per-item
+    /// figures.
+    std::size_t items = 1;
+};
+
+struct Result {
+    std::string name;
+    std::size_t iterations = 0;
+    double ns_per_iteration = 0.0;
+    double ns_per_item = 0.0;
+};
+
+/// Called with each result as soon as its case has finished.
+using Report = std::function<void(const Result&)>;
+
+/// A list of benchmark cases. Each case is calibrated until one sample takes
+/// long enough to time reliably, then sampled several times; the median is
+/// reported.
+class Suite {
+public:
+    Suite();
+    ~Suite();
+
+    void add(std::string name, Body body, std::size_t items = 1);
+
+    /// A pool of one worker per hardware thread for the cases that run on
+    /// the whole machine, started the first time a case asks for it.
+    ThreadPool* pool();
+
+    /// Runs the cases whose name contains `filter` (all when empty), in
+    /// registration order, passing each result to `report` as it is made.
+    std::vector<Result> run(const std::string& filter = {}, const Report& report = {}) const;
+
+private:
+    std::vector<Case> cases_;
+    std::once_flag pool_once_;
+    std::unique_ptr<ThreadPool> pool_;
+};
+
+void register_graph_benchmarks(Suite& suite);
+void register_plan_benchmarks(Suite& suite);
+void register_batch_benchmarks(Suite& suite);
+void register_cache_benchmarks(Suite& suite);
+void register_buffer_benchmarks(Suite& suite);
+void register_script_benchmarks(Suite& suite);
+void register_subgraph_benchmarks(Suite& suite);
+void register_loop_benchmarks(Suite& suite);
+void register_process_benchmarks(Suite& suite);
+void register_distributed_benchmarks(Suite& suite);
+void register_schedule_benchmarks(Suite& suite);
+void register_mesh_benchmarks(Suite& suite);
+void register_bvh_benchmarks(Suite& suite);
+void register_boolean_benchmarks(Suite& suite);
+void register_mesh_io_benchmarks(Suite& suite);
+void register_brep_benchmarks(Suite& suite);
+
+} // namespace rebelflow::bench
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+namespace rebelflow {
+
+/// Bump allocator for transient scratch data.
+///
+/// Allocation is a pointer increment inside the current chunk; deallocation
+/// is a no-op; reset() releases everything at once. After a reset the chunks
+/// are coalesced into one block as large as the previous high-water mark, so
+/// a steady workload stops touching the system allocator entirely.
+///
+/// Arena is a std::pmr::memory_resource, so pmr containers can live in it:
+///
+///     std::pmr::vector<int> scratch(&ctx.arena());
+///
+/// Not thread-safe: the executor gives every worker thread its own arena.
+/// Objects created with make() must not need their destructor run.
+class Arena final : public std::pmr::memory_resource {
+public:
+    explicit Arena(std::size_t initial_capacity = 64 * 1024);
+    ~Arena() override;
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "arena objects are never destroyed individually");
+        return ::new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /// Uninitialized storage for `count` objects of T.
+    template <typename T>
+    std::span<T> allocate_array(std::size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "arena objects are never destroyed individually");
+        return {static_cast<T*>(allocate(count * sizeof(T), alignof(T))), count};
+    }
+
+    /// Frees every allocation made since the last reset.
+    void reset() noexcept;
+
+    /// Bytes handed out since the last reset (including alignment padding).
+    std::size_t bytes_allocated() const noexcept { return allocated_; }
+    /// Bytes currently held from the system allocator.
+    std::size_t bytes_reserved() const noexcept { return reserved_; }
+
+private:
+    struct Chunk {
+        Chunk* next;
+        std::size_t size; // usable bytes after the header
+    };
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) noexcept override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void add_chunk(std::size_t min_size);
+    void free_chunks() noexcept;
+
+    Chunk* head_ = nullptr;
+    std::byte* cursor_ = nullptr;
+    std::byte* end_ = nullptr;
+    std::size_t allocated_ = 0;
+    std::size_t reserved_ = 0;
+    std::size_t next_chunk_size_;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "rebelflow/buffer.hpp"
+#include "rebelflow/hash.hpp"
+#include "rebelflow/mesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace rebelflow {
+
+class ThreadPool;
+
+/// A boundary representation: solids and sheets whose faces lie on planes,
+/// quadrics, tori or B-spline surfaces, trimmed by loops of edges along
+/// lines, conics or B-spline curves. read_step() makes one from a STEP file.
+///
+/// A model has shapes and bodies. A shape is the faces of one part, in the
+/// part's own coordinates; a body places a shape in the model by a rigid
+/// transform, so a part used a hundred times in an assembly is stored, and
+/// tessellated, once.
+///
+/// Triangles are made only on request, a body at a time (tessellate()),
+/// and kept per shape and tolerance in a cache that the value's copies
+/// share. Tolerances are snapped down to steps about 9% apart, so nearby
+/// ones share a mesh, and each shape keeps its four most recently used. The
+/// cache is not part of the value: it does not count towards size, digest
+/// or equality, and a Brep read back from bytes starts without one.
+///
+/// Like Mesh, a Brep is an immutable value made of Buffers. Topology links
+/// are 32-bit indices; geometry is f64, each surface and curve a kind and
+/// an offset into one parameter array.
+class Brep {
+public:
+    static constexpr std::uint32_t invalid = ~std::uint32_t{0};
+
+    /// Parameters, from the surface's offset in `parameters`. A frame is an
+    /// origin and unit x, y and z axes, 12 values.
+    enum class SurfaceKind : std::uint8_t {
+        /// frame; S(u, v) = o + u x + v y.
+        Plane,
+        /// frame, radius; u is the angle about z, v the height along it.
+        Cylinder,
+        /// frame, radius at v = 0, semi-angle.
+        Cone,
+        /// frame, radius; u is the longitude, v the latitude.
+        Sphere,
+        /// frame, major radius, minor radius; v is the angle about the tube.
+        Torus,
+        /// u degree, v degree, u count, v count, the u and v knot vectors
+        /// in full, then the control points as x, y, z, weight, v fastest.
+        BSpline,
+        /// Geometry the tessellator does not handle: faces on it are left
+        /// out.
+        Unsupported,
+    };
+
+    enum class CurveKind : std::uint8_t {
+        /// origin, unit direction.
+        Line,
+        /// frame, radius.
+        Circle,
+        /// frame, x semi-axis, y semi-axis.
+        Ellipse,
+        /// degree, count, the knot vector in full, then the control points
+        /// as x, y, z, weight.
+        BSpline,
+        /// Taken as the straight line between the edge's ends.
+        Unsupported,
+    };
+
+    /// The stored arrays.
+    struct Arrays {
+        /// u32, 3 components: the shape of each body, and where its name
+        /// starts in `names` and how long it is.
+        Buffer bodies;
+        /// f64, 12 components: each body's transform to model coordinates,
+        /// a 3 x 4 matrix row by row.
+        Buffer transforms;
+        /// u8: body names, UTF-8, back to back.
+        Buffer names;
+        /// u32, 2 components: the first face of each shape and how many.
+        Buffer shapes;
+        /// u32, 4 components: the surface of each face, its first loop and
+        /// how many, and 1 if its outward normal is the surface's normal
+        /// (Su x Sv), 0 if it is the opposite.
+        Buffer faces;
+        /// u32, 3 components: the first edge use of each loop, how many,
+        /// and 1 for the outer loop of its face. Loops run with the face on
+        /// their left, seen from outside.
+        Buffer loops;
+        /// u32: an edge index times two, plus one if the loop runs it from
+        /// end to start.
+        Buffer edge_uses;
+        /// u32, 4 components: the curve of each edge, its start and end
+        /// vertex, and 1 if it runs along the curve's direction, 0 against.
+        Buffer edges;
+        /// f64, 3 components: vertex positions.
+        Buffer vertices;
+        /// u32, 2 components: each surface's kind and first parameter.
+        Buffer surfaces;
+        /// u32, 2 components: each curve's kind and first parameter.
+        Buffer curves;
+        /// f64: surface and curve parameters.
+        Buffer parameters;
+    };
+
+    /// An empty model.
+    Brep();
+
+    /// Adopts arrays, checking their shapes, index ranges and parameter
+    /// counts. Throws FormatError if they are inconsistent.
+    static Brep from_arrays(Arrays arrays);
+
+    const Arrays& arrays() const noexcept;
+
+    std::size_t body_count() const noexcept;
+    std::size_t shape_count() const noexcept;
+    std::size_t face_count() const noexcept;
+    std::string_view body_name(std::size_t body) const;
+    std::uint32_t body_shape(std::size_t body) const;
+
+    /// The first body called `name`, or `invalid`.
+    std::uint32_t find_body(std::string_view name) const noexcept;
+
+    /// Triangles of `body` in model coordinates, no further than about
+    /// `tolerance` from its faces. Edges are split by their curvature and
+    /// shared by the faces on either side, which are triangulated in their
+    /// surfaces' parameter planes in parallel, so the mesh of a closed
+    /// shell is closed. The first call for a shape and tolerance
+    /// tessellates; later ones, for any body of that shape, only place the
+    /// cached triangles.
+    Mesh tessellate(std::size_t body, double tolerance, ThreadPool* pool = nullptr) const;
+
+    /// Every body in one mesh, shapes tessellated in parallel.
+    Mesh tessellate_all(double tolerance, ThreadPool* pool = nullptr) const;
+
+    /// Whether the shape of `body` is cached at `tolerance`'s step.
+    bool is_tessellated(std::size_t body, double tolerance) const;
+
+    std::size_t size_bytes() const noexcept;
+    Digest content_digest() const;
+
+    friend bool operator==(const Brep& a, const Brep& b);
+
+private:
+    struct Data;
+
+    explicit Brep(std::shared_ptr<const Data> data) noexcept;
+
+    Mesh shape_mesh(std::uint32_t shape, int step, ThreadPool* pool) const;
+
+    std::shared_ptr<const Data> data_;
+};
+
+} // namespace rebelflow
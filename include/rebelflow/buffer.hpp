@@ -0,0 +1,201 @@
+#pragma once
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/hash.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace rebelflow {
+
+/// Scalar type of the elements of a Buffer.
+enum class ElementType : std::uint8_t {
+    U8,
+    I32,
+    U32,
+    I64,
+    F32,
+    F64,
+};
+
+const char* to_string(ElementType type) noexcept;
+std::size_t element_size(ElementType type) noexcept;
+
+template <typename T>
+struct element_type_of;
+template <>
+struct element_type_of<std::uint8_t> {
+    static constexpr ElementType value = ElementType::U8;
+};
+template <>
+struct element_type_of<std::int32_t> {
+    static constexpr ElementType value = ElementType::I32;
+};
+template <>
+struct element_type_of<std::uint32_t> {
+    static constexpr ElementType value = ElementType::U32;
+};
+template <>
+struct element_type_of<std::int64_t> {
+    static constexpr ElementType value = ElementType::I64;
+};
+template <>
+struct element_type_of<float> {
+    static constexpr ElementType value = ElementType::F32;
+};
+template <>
+struct element_type_of<double> {
+    static constexpr ElementType value = ElementType::F64;
+};
+
+template <typename T>
+inline constexpr ElementType element_type_v = element_type_of<std::remove_cv_t<T>>::value;
+
+/// Storage source for Buffer::allocate(), installed per thread with
+/// ScopedBufferAllocator; without one, buffers live on the aligned heap.
+class BufferAllocator {
+public:
+    virtual ~BufferAllocator() = default;
+
+    /// At least `bytes` (> 0) bytes, 64-byte aligned, kept alive by the
+    /// returned pointer.
+    virtual std::shared_ptr<std::byte> allocate(std::size_t bytes) = 0;
+};
+
+/// Routes Buffer::allocate() on the calling thread to `allocator` while it
+/// lives. Scopes nest; the allocator must outlive the scope.
+class ScopedBufferAllocator {
+public:
+    explicit ScopedBufferAllocator(BufferAllocator& allocator) noexcept;
+    ~ScopedBufferAllocator();
+
+    ScopedBufferAllocator(const ScopedBufferAllocator&) = delete;
+    ScopedBufferAllocator& operator=(const ScopedBufferAllocator&) = delete;
+
+private:
+    BufferAllocator* previous_;
+};
+
+/// Bytes Buffer::allocate() has handed out on the calling thread so far,
+/// through any allocator. Profilers take differences of it.
+std::uint64_t buffer_bytes_allocated() noexcept;
+
+/// An immutable, reference-counted typed array: the currency for large data
+/// (meshes, point clouds, textures, columns) flowing along edges.
+///
+/// Copying a Buffer copies a pointer; fan-out edges share one allocation.
+/// Writers go through mutate(), which copies the elements only when the
+/// storage is shared with another Buffer (copy-on-write), so a node that owns
+/// the last reference edits in place. Slices share the parent's storage.
+///
+/// `components` groups consecutive elements into tuples (3 for xyz points,
+/// 4 for rgba texels); size() counts elements, tuples() counts tuples.
+class Buffer {
+public:
+    Buffer() noexcept = default;
+
+    /// Uninitialized storage for `count` elements, 64-byte aligned, from the
+    /// thread's BufferAllocator if one is installed.
+    static Buffer allocate(ElementType type, std::size_t count, std::uint32_t components = 1);
+
+    /// Copies `data` into a new buffer.
+    template <typename T>
+    static Buffer copy_of(std::span<const T> data, std::uint32_t components = 1) {
+        Buffer b = allocate(element_type_v<T>, data.size(), components);
+        if (!data.empty()) {
+            std::memcpy(b.storage_->data, data.data(), data.size_bytes());
+        }
+        return b;
+    }
+
+    /// Adopts a vector without copying its elements.
+    template <typename T>
+    static Buffer adopt(std::vector<T>&& data, std::uint32_t components = 1) {
+        auto owner = std::make_shared<std::vector<T>>(std::move(data));
+        auto* p = owner->data();
+        const std::size_t n = owner->size();
+        return make(element_type_v<T>, p, n, components, std::move(owner), true);
+    }
+
+    /// Wraps memory owned by someone else (a mapped file, shared memory).
+    /// `owner` keeps it alive; the buffer is read-only and mutate() copies.
+    static Buffer wrap(ElementType type, const void* data, std::size_t count,
+                       std::shared_ptr<const void> owner, std::uint32_t components = 1);
+
+    bool empty() const noexcept { return count_ == 0; }
+    ElementType element_type() const noexcept { return type_; }
+    std::uint32_t components() const noexcept { return components_; }
+    std::size_t size() const noexcept { return count_; }
+    std::size_t tuples() const noexcept { return count_ / components_; }
+    std::size_t size_bytes() const noexcept { return count_ * element_size(type_); }
+
+    const std::byte* bytes() const noexcept;
+
+    template <typename T>
+    std::span<const T> view() const {
+        check_type(element_type_v<T>);
+        return {reinterpret_cast<const T*>(bytes()), count_};
+    }
+
+    /// Writable elements, copying first unless this is the sole reference to
+    /// owned storage.
+    template <typename T>
+    std::span<T> mutate() {
+        check_type(element_type_v<T>);
+        return {reinterpret_cast<T*>(mutable_bytes()), count_};
+    }
+    /// Untyped form of mutate(), for filling a buffer from raw bytes.
+    std::span<std::byte> mutate_bytes() { return {mutable_bytes(), size_bytes()}; }
+
+    /// Zero-copy view of elements [offset, offset + count).
+    Buffer slice(std::size_t offset, std::size_t count) const;
+
+    /// Joins buffers of one element type and tuple size, in order. A single
+    /// part is returned as is, without copying. Throws TypeError on mismatch.
+    static Buffer concat(std::span<const Buffer> parts);
+
+    /// True if no other Buffer shares the storage.
+    bool unique() const noexcept { return storage_ && storage_.use_count() == 1; }
+    bool shares_storage_with(const Buffer& other) const noexcept {
+        return storage_ && storage_ == other.storage_;
+    }
+
+    /// Digest of type, shape and contents. For whole-storage buffers it is
+    /// computed once and memoized, so re-hashing a shared buffer is free.
+    Digest content_digest() const;
+
+    /// Same type, shape and contents.
+    friend bool operator==(const Buffer& a, const Buffer& b);
+
+private:
+    struct Storage {
+        std::byte* data = nullptr;
+        std::size_t bytes = 0;
+        std::shared_ptr<const void> owner; // keeps data alive
+        bool writable = false;
+        mutable std::mutex digest_mutex;
+        mutable std::atomic<bool> digest_ready{false};
+        mutable Digest digest; // of the whole storage
+    };
+
+    static Buffer make(ElementType type, void* data, std::size_t count, std::uint32_t components,
+                       std::shared_ptr<const void> owner, bool writable);
+    void check_type(ElementType want) const;
+    std::byte* mutable_bytes();
+
+    std::shared_ptr<Storage> storage_;
+    std::size_t offset_ = 0; // in elements
+    std::size_t count_ = 0;
+    ElementType type_ = ElementType::U8;
+    std::uint32_t components_ = 1;
+};
+
+} // namespace rebelflow
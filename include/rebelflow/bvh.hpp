@@ -0,0 +1,129 @@
+#pragma once
+
+#include "rebelflow/buffer.hpp"
+#include "rebelflow/hash.hpp"
+#include "rebelflow/mesh.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+namespace rebelflow {
+
+class ThreadPool;
+
+/// A bounding volume hierarchy over the triangles of a mesh: ray, closest
+/// point and proximity queries in logarithmic rather than linear time.
+///
+/// Built top-down by the surface area heuristic, evaluated over centroid
+/// bins. Large nodes are binned in parallel and subtrees are built as
+/// separate tasks. Nodes are then laid out depth-first, so the result does
+/// not depend on the number of threads.
+///
+/// Like Mesh, a Bvh is an immutable value made of Buffers. Node boxes are
+/// f32, rounded outward so that they still contain their triangles, which
+/// halves the memory traversals touch. The mesh is part of the value: the
+/// queries need only the Bvh.
+class Bvh {
+public:
+    using Point = std::array<double, 3>;
+
+    /// The stored arrays.
+    struct Arrays {
+        Mesh mesh;
+        /// f32, 6 components: min xyz and max xyz of each node. Node 0 is
+        /// the root.
+        Buffer bounds;
+        /// u32, 2 components: for a leaf, where its triangles start in
+        /// `triangles` and how many there are; for an inner node, the first
+        /// of its two adjacent children and 0.
+        Buffer links;
+        /// u32: triangle indices, grouped by leaf.
+        Buffer triangles;
+    };
+
+    /// An empty hierarchy over an empty mesh.
+    Bvh();
+
+    /// Builds the hierarchy of `mesh`, with at most `max_leaf_size`
+    /// triangles per leaf.
+    static Bvh build(const Mesh& mesh, ThreadPool* pool = nullptr, std::size_t max_leaf_size = 4);
+
+    /// Adopts previously built arrays, checking their shapes and index
+    /// ranges. Throws FormatError if they are inconsistent.
+    static Bvh from_arrays(Arrays arrays);
+
+    const Arrays& arrays() const noexcept { return *data_; }
+    const Mesh& mesh() const noexcept { return data_->mesh; }
+    std::size_t node_count() const noexcept { return data_->links.tuples(); }
+
+    struct RayHit {
+        /// Along the ray, in units of the direction's length; infinite on a
+        /// miss.
+        double distance = std::numeric_limits<double>::infinity();
+        /// The triangle hit, Mesh::invalid on a miss.
+        std::uint32_t triangle = Mesh::invalid;
+        /// Barycentric coordinates of the hit point in the triangle.
+        double u = 0;
+        double v = 0;
+
+        bool hit() const noexcept { return triangle != Mesh::invalid; }
+    };
+
+    /// The nearest hit, from either side, of the ray from `origin` along
+    /// `direction` within `max_distance`.
+    RayHit raycast(const Point& origin, const Point& direction,
+                   double max_distance = std::numeric_limits<double>::infinity()) const;
+
+    /// How many triangles the ray from `origin` along `direction` crosses.
+    /// For a closed mesh an odd count puts `origin` inside, unless the ray
+    /// grazes an edge or a vertex, whose triangles all count.
+    std::size_t crossings(const Point& origin, const Point& direction) const;
+
+    struct Nearest {
+        Point point{};
+        /// Infinite if no triangle is within the search distance.
+        double distance = std::numeric_limits<double>::infinity();
+        std::uint32_t triangle = Mesh::invalid;
+    };
+
+    /// The point of the mesh nearest to `query`, within `max_distance`.
+    Nearest closest_point(const Point& query,
+                          double max_distance = std::numeric_limits<double>::infinity()) const;
+
+    struct Overlap {
+        std::uint32_t first = 0;
+        std::uint32_t second = 0;
+        double distance = 0;
+    };
+
+    /// Pairs of a triangle of this mesh and one of `other` at most
+    /// `tolerance` apart (0 for intersecting or touching), sorted.
+    std::vector<Overlap> overlaps(const Bvh& other, double tolerance,
+                                  ThreadPool* pool = nullptr) const;
+    /// Pairs of triangles of this mesh at most `tolerance` apart, first <
+    /// second, leaving out neighbours that share a vertex.
+    std::vector<Overlap> self_overlaps(double tolerance, ThreadPool* pool = nullptr) const;
+
+    std::size_t size_bytes() const noexcept;
+    Digest content_digest() const;
+
+    friend bool operator==(const Bvh& a, const Bvh& b);
+
+private:
+    explicit Bvh(std::shared_ptr<const Arrays> data) noexcept;
+
+    std::vector<Overlap> pairs(const Bvh& other, double tolerance, bool self,
+                               ThreadPool* pool) const;
+
+    std::shared_ptr<const Arrays> data_;
+    // Cached from data_.
+    const float* bounds_ = nullptr;
+    const std::uint32_t* links_ = nullptr;
+    const std::uint32_t* triangles_ = nullptr;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "rebelflow/arena.hpp"
+#include "rebelflow/graph.hpp"
+#include "rebelflow/node.hpp"
+#include "rebelflow/script.hpp"
+#include "rebelflow/value.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rebelflow {
+
+/// Feeds one column into CompiledPlan::run_batch(): output `port` takes the
+/// value `column[row]` for each row.
+struct ColumnBinding {
+    PortRef port;
+    Buffer column;
+};
+
+/// Options for CompiledPlan::compile().
+struct PlanOptions {
+    /// Fuse clusters of connected expression nodes (NodeType::expression)
+    /// into one script each. Outputs of constant nodes feeding a cluster --
+    /// pure nodes with no connected inputs and no prepare function -- are
+    /// folded into its code. run_batch() cannot bind outputs of fused or
+    /// folded nodes; turn this off to bind them.
+    bool fuse_expressions = true;
+    /// The outputs the plan is run for. When set, only the nodes they depend
+    /// on are compiled; the rest of the graph costs nothing and output()
+    /// rejects it. Empty means every node.
+    std::vector<PortRef> outputs;
+};
+
+/// A graph flattened into a linear instruction list for repeated execution.
+///
+/// compile() walks the topological order once and lays every node's outputs,
+/// parameters and unconnected-input defaults out in flat arrays. Each
+/// instruction holds the kernel to call and the offsets of its slots; input
+/// pointers are resolved to the producers' output slots ahead of time. run()
+/// is then a single loop over instructions: no graph lookups, dirty checks,
+/// scheduling or task dispatch, and stateless node types (NodeType::kernel)
+/// are called through a plain function pointer.
+///
+/// Plans run sequentially on the calling thread and always evaluate every
+/// instruction. They suit small-to-medium graphs executed many times (per
+/// frame, per part); large graphs with parallel branches or incremental edits
+/// belong on the Executor. A plan is a snapshot: later edits to the graph are
+/// not seen, except parameters patched through set_param().
+///
+/// run_batch() evaluates the plan over many records in one pass, with the data
+/// laid out as columns (structure of arrays) rather than one run() per record.
+///
+/// Expression nodes are fused: a cluster of connected ones becomes a single
+/// instruction running one Script::fuse() program. Constants fold through the
+/// whole cluster and a subexpression that several nodes compute -- common in
+/// generated parameter graphs -- is evaluated once. Every node's output stays
+/// readable through output().
+class CompiledPlan {
+public:
+    /// Throws GraphError if the graph is invalid or a requested output does
+    /// not exist, and ExecutionError if a node type's prepare or expression
+    /// function fails.
+    static CompiledPlan compile(const Graph& graph, const PlanOptions& options = {});
+
+    CompiledPlan(CompiledPlan&&) noexcept = default;
+    CompiledPlan& operator=(CompiledPlan&&) noexcept = default;
+    CompiledPlan(const CompiledPlan&) = delete;
+    CompiledPlan& operator=(const CompiledPlan&) = delete;
+
+    /// Executes every instruction in order. Throws ExecutionError on failure.
+    void run();
+
+    /// Evaluates the plan for `rows` records at once. Each binding replaces a
+    /// node output with a column of `rows` elements; bound nodes are not run.
+    /// Instructions downstream of a column run once for the whole batch --
+    /// through NodeType::batch_kernel when the type has one, otherwise row by
+    /// row -- and produce columns. Everything else runs once and keeps scalar
+    /// outputs. Row-by-row outputs must be bool, int or float.
+    ///
+    /// Throws TypeError for a column of the wrong length and ExecutionError
+    /// when a node fails.
+    void run_batch(std::size_t rows, std::span<const ColumnBinding> columns);
+
+    /// Output of the most recent run. After run_batch() it is either a column
+    /// Buffer or a scalar shared by every row; is_column() tells which.
+    const Value& output(PortRef port) const;
+    const Value& output(NodeId node, std::uint32_t port = 0) const { return output({node, port}); }
+    bool is_column(PortRef port) const;
+
+    /// Patches a baked-in parameter without recompiling. Node types with a
+    /// prepare function are re-prepared, and fused clusters the node belongs to
+    /// or is folded into are rebuilt; if that fails the old value is kept and
+    /// the error is thrown as an ExecutionError.
+    void set_param(NodeId node, std::size_t index, Value value);
+    void set_param(NodeId node, std::string_view name, Value value);
+
+    /// A copy that shares the compiled code, prepared states and fused
+    /// scripts but has its own value slots and parameters, for running the
+    /// same plan on another thread. Far cheaper than compiling again.
+    CompiledPlan fork() const;
+
+    std::size_t instruction_count() const noexcept { return code_.size(); }
+    /// Number of fused expression clusters.
+    std::size_t fusion_count() const noexcept { return fusions_.size(); }
+
+private:
+    CompiledPlan() = default;
+
+    struct Instruction {
+        KernelFn kernel;          // preferred when set
+        const ComputeFn* compute; // fallback for stateful node types
+        std::uint32_t in_begin, in_count;
+        std::uint32_t out_begin, out_count;
+        std::uint32_t param_begin, param_count;
+        const void* state; // NodeType::prepare result, owned by states_
+        NodeId node;
+    };
+
+    struct NodeEntry {
+        std::shared_ptr<const NodeType> type;
+        std::uint32_t instruction;
+        std::uint32_t out_begin, out_count;
+        std::uint32_t param_begin, param_count;
+        std::int32_t fusion; // cluster the node is a member of, or -1
+    };
+
+    /// A constant node output folded into a cluster member's input.
+    struct FoldedInput {
+        std::uint32_t member, input;
+        PortRef port;
+    };
+
+    /// A cluster of expression nodes run as one fused script.
+    struct Fusion {
+        std::vector<NodeId> members; // in topological order
+        std::vector<std::vector<ScriptSource>> sources; // per member input
+        std::vector<FoldedInput> folded;
+        std::uint32_t instruction;
+    };
+
+    const NodeEntry& entry(NodeId node) const;
+    std::uint32_t slot_of(PortRef port) const;
+    void run_rows(const Instruction& instr, std::size_t rows, Arena& arena);
+    /// State for a fusion's instruction, from the current parameters.
+    std::shared_ptr<const void> build_fusion(const Fusion& fusion);
+
+    std::vector<Instruction> code_;
+    std::vector<Value> values_;        // all output slots, then input defaults
+    std::vector<Value> params_;
+    std::vector<const Value*> inputs_; // pre-resolved, per instruction input
+    std::vector<std::shared_ptr<const NodeType>> types_; // per instruction
+    std::vector<std::shared_ptr<const void>> states_;    // per instruction
+    std::unordered_map<NodeId, NodeEntry> nodes_;
+    std::vector<Fusion> fusions_;
+    std::unordered_multimap<NodeId, std::uint32_t> folded_into_; // constant node -> fusion
+    std::unique_ptr<Arena> arena_;
+
+    // run_batch() state: which value slots hold columns, and the same flag
+    // gathered per instruction input.
+    std::vector<std::uint8_t> column_;
+    std::vector<std::uint8_t> input_column_;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "rebelflow/node.hpp"
+#include "rebelflow/profiler.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace rebelflow {
+
+/// Expected execution time of each node type, learned from past executions.
+///
+/// Executors it is attached to (see Executor::set_cost_model()) feed it the
+/// wall time of every node they compute and use the estimates to run the
+/// critical path first. Profiles can be folded in too, and the model saved
+/// and loaded so that estimates carry over between sessions.
+///
+/// Estimates are an exponential moving average per type name, so they follow
+/// drifting costs while smoothing out noise; the first sample is taken as is.
+/// Types never seen cost `default_cost`. Safe to share between threads.
+class CostModel {
+public:
+    explicit CostModel(std::chrono::nanoseconds default_cost = std::chrono::microseconds(10))
+        : default_cost_(default_cost) {}
+
+    CostModel(const CostModel&) = delete;
+    CostModel& operator=(const CostModel&) = delete;
+
+    /// Folds one measured execution of `type` into its estimate.
+    void record(std::string_view type, std::chrono::nanoseconds wall);
+    /// Folds in profiled executions; cache hits say nothing about cost and
+    /// are skipped.
+    void record(std::span<const NodeProfile> nodes);
+
+    std::chrono::nanoseconds estimate(std::string_view type) const;
+    std::chrono::nanoseconds default_cost() const noexcept { return default_cost_; }
+
+    /// Types with an estimate.
+    std::size_t size() const;
+    void clear();
+
+    /// Text format, one type per line: name, estimate in ns and sample count,
+    /// tab-separated, with backslash, tab, newline and carriage return in
+    /// names escaped as `\\`, `\t`, `\n` and `\r`. save() writes a temporary
+    /// file and renames it over `path`. load() adds to the current estimates,
+    /// replacing those of types in the file. Throws IoError, or FormatError
+    /// for malformed lines.
+    void save(const std::string& path) const;
+    void load(const std::string& path);
+
+private:
+    struct Entry {
+        double ns = 0;
+        std::uint64_t samples = 0;
+    };
+    struct Hash {
+        using is_transparent = void;
+        std::size_t operator()(std::string_view s) const noexcept {
+            return std::hash<std::string_view>{}(s);
+        }
+    };
+
+    void record_locked(std::string_view type, std::chrono::nanoseconds wall);
+
+    const std::chrono::nanoseconds default_cost_;
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Entry, Hash, std::equal_to<>> entries_;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "rebelflow/graph.hpp"
+#include "rebelflow/node.hpp"
+#include "rebelflow/transport.hpp"
+#include "rebelflow/value.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace rebelflow {
+
+/// Splits the nodes of `graph` into `parts` groups of similar size for
+/// distributed evaluation, keeping producers and consumers together where
+/// possible: in topological order, each node joins the group most of its
+/// producers are in unless that group is full, else the smallest group.
+/// Returns the group of every node id (entries of removed ids are 0).
+std::vector<std::uint32_t> partition_graph(const Graph& graph, std::size_t parts);
+
+/// Evaluates nodes on behalf of DistributedExecutors, in this process.
+///
+/// Values live in a store keyed by digest and bounded in bytes (least
+/// recently used values go first). A node's outputs are stored under digests
+/// derived from its type, parameters and input digests, so a node whose
+/// outputs are already in the store is not run again, and inputs already in
+/// the store are never sent. The store is shared by all connections.
+///
+/// Node types are looked up by name in `registry`, which must outlive the
+/// worker. Coordinators are not authenticated and may run any type in it, so
+/// a worker reachable by others should get a registry without the types
+/// that touch files. See tools/worker.cpp for a stand-alone worker process.
+class DistributedWorker {
+public:
+    explicit DistributedWorker(const NodeRegistry& registry,
+                               std::size_t store_bytes = std::size_t{1} << 30);
+    ~DistributedWorker();
+
+    DistributedWorker(const DistributedWorker&) = delete;
+    DistributedWorker& operator=(const DistributedWorker&) = delete;
+
+    /// Serves one coordinator until it disconnects.
+    void serve(Connection connection);
+    /// Accepts coordinators, serving each on a thread of its own, until
+    /// Listener::shutdown(); then waits for the open connections to close.
+    /// Threads of finished sessions are joined as new ones are accepted.
+    void serve(Listener& listener);
+
+    struct Stats {
+        /// Nodes computed here.
+        std::size_t computed = 0;
+        /// Nodes answered from the store without running them.
+        std::size_t reused = 0;
+        /// Input values that had to be sent because the store lacked them.
+        std::size_t values_received = 0;
+        std::size_t stored_bytes = 0;
+    };
+    Stats stats() const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+struct DistributedStats {
+    /// Nodes evaluated, including those a worker already had results for.
+    std::size_t nodes = 0;
+    /// Nodes whose outputs a worker already held.
+    std::size_t worker_hits = 0;
+    /// Values shipped to a worker that did not hold them.
+    std::size_t values_sent = 0;
+    /// Values fetched from the worker holding them.
+    std::size_t values_fetched = 0;
+    /// Traffic on all connections, framing included.
+    std::size_t bytes_sent = 0;
+    std::size_t bytes_received = 0;
+    std::chrono::nanoseconds wall_time{0};
+};
+
+/// Evaluates a graph across DistributedWorkers, on this machine or others.
+///
+/// Every node goes to one worker (partition_graph() by default). Requests
+/// carry digests, not values: those of the node's inputs and, for pure
+/// nodes, of its outputs, keyed like the Executor's result cache by
+/// everything that produced them. A worker that already holds a node's
+/// outputs answers at once; otherwise it asks only for the inputs it lacks,
+/// which the coordinator fetches from the worker that produced them. Values
+/// therefore cross the network only when an edge crosses partitions, and
+/// only once per receiving worker. Impure nodes run every time and name
+/// their outputs by content, so an unchanged result still spares the nodes
+/// downstream.
+///
+/// Independent nodes run concurrently on their workers; each worker handles
+/// one node of a run at a time. Node failures are rethrown as
+/// ExecutionError; lost connections throw IoError wrapped the same way.
+class DistributedExecutor {
+public:
+    /// Connects to the workers at `addresses` (see Connection::connect()).
+    explicit DistributedExecutor(const std::vector<std::string>& addresses);
+    ~DistributedExecutor();
+
+    DistributedExecutor(const DistributedExecutor&) = delete;
+    DistributedExecutor& operator=(const DistributedExecutor&) = delete;
+
+    std::size_t worker_count() const noexcept;
+
+    DistributedStats run(const Graph& graph);
+    /// Runs with `assignment[id]` the worker of node `id`.
+    DistributedStats run(const Graph& graph, std::span<const std::uint32_t> assignment);
+
+    /// An output of the last run, fetched from its worker on first use.
+    /// Throws GraphError for ports the last run did not produce.
+    Value output(PortRef port);
+    Value output(NodeId node, std::uint32_t port = 0) { return output({node, port}); }
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+} // namespace rebelflow
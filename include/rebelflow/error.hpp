@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+namespace rebelflow {
+
+using NodeId = std::uint32_t;
+
+/// Sentinel for "no node".
+inline constexpr NodeId invalid_node = ~NodeId{0};
+
+/// Base class of every exception thrown by the library.
+class Error : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+/// Structural problem in a graph: bad port, type mismatch, cycle, unknown node.
+class GraphError : public Error {
+public:
+    using Error::Error;
+};
+
+/// A value was read as a type it does not hold.
+class TypeError : public Error {
+public:
+    using Error::Error;
+};
+
+/// Serialized data (cache entry, graph file, message) is malformed.
+class FormatError : public Error {
+public:
+    using Error::Error;
+};
+
+/// An operating-system call on a file, mapping or socket failed.
+class IoError : public Error {
+public:
+    using Error::Error;
+};
+
+/// Script source does not compile, or its operations do not fit the types of
+/// the values it was run with.
+class ScriptError : public Error {
+public:
+    explicit ScriptError(const std::string& what, std::size_t part = 0)
+        : Error(what), part_(part) {}
+
+    /// For scripts built by Script::fuse(), the index of the part at fault.
+    std::size_t part() const noexcept { return part_; }
+
+private:
+    std::size_t part_;
+};
+
+/// A node's compute function failed while a graph was being evaluated.
+class ExecutionError : public Error {
+public:
+    ExecutionError(NodeId node, const std::string& node_type, const std::string& what);
+
+    NodeId node() const noexcept { return node_; }
+    const std::string& node_type() const noexcept { return node_type_; }
+
+private:
+    NodeId node_;
+    std::string node_type_;
+};
+
+/// The library error classes, for carrying errors between processes.
+enum class ErrorKind : std::uint8_t { Error, Graph, Type, Script, Format, Io };
+
+/// The most derived class of `e` among the library's errors; Error for
+/// other exceptions.
+ErrorKind error_kind(const std::exception& e) noexcept;
+/// Throws an exception of class `kind` with message `what`.
+[[noreturn]] void throw_error(ErrorKind kind, const std::string& what);
+
+/// Rethrows the exception currently being handled as an ExecutionError for
+/// `node`; ExecutionErrors pass through unchanged. Only valid inside a catch
+/// block.
+[[noreturn]] void rethrow_as_execution_error(NodeId node, const std::string& node_type);
+
+} // namespace rebelflow
@@ -0,0 +1,196 @@
+#pragma once
+
+#include "rebelflow/arena.hpp"
+#include "rebelflow/cost_model.hpp"
+#include "rebelflow/graph.hpp"
+#include "rebelflow/hash.hpp"
+#include "rebelflow/process_pool.hpp"
+#include "rebelflow/profiler.hpp"
+#include "rebelflow/result_cache.hpp"
+#include "rebelflow/thread_pool.hpp"
+#include "rebelflow/value.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace rebelflow {
+
+struct RunStats {
+    /// Nodes that were brought up to date by the run, in topological order.
+    /// Includes nodes whose outputs were loaded from the result cache.
+    std::vector<NodeId> executed;
+    /// Executed nodes served from the result cache instead of computed.
+    std::size_t cache_hits = 0;
+    /// Scratch bytes node computations took from the evaluation arenas.
+    std::size_t arena_bytes = 0;
+    /// Nodes whose cached outputs were still valid and were not recomputed.
+    std::size_t nodes_reused = 0;
+    /// Nodes left alone because no requested output depends on them (pull()).
+    std::size_t nodes_skipped = 0;
+    std::chrono::nanoseconds wall_time{0};
+};
+
+/// Evaluates graphs on a work-stealing thread pool.
+///
+/// The executor derives a schedule (topological order and distinct successor
+/// lists) once per structural version of a graph and reuses it
+/// for every run. During a run each node is released to the pool as soon as
+/// its last producer finishes, so independent branches execute concurrently.
+/// When a node completes, one newly ready successor is run inline on the same
+/// worker and the rest are pushed to its deque where idle workers steal them.
+///
+/// Evaluation is incremental. Node outputs are cached in the executor together
+/// with the graph revision they were computed from (see Graph::revision()).
+/// A run first marks dirty every node that was never evaluated, whose
+/// revision changed, or that consumes a dirty node, then schedules only that
+/// downstream cone; everything else keeps its cached outputs. Editing one
+/// parameter therefore recomputes exactly the nodes that depend on it.
+///
+/// Optionally a persistent ResultCache can be attached. Every pure node then
+/// gets a content key: a digest of its type name and version, its parameters
+/// and the digests of its inputs. An input's digest is derived from the key of
+/// the node producing it (or from its content, for impure producers), so keys
+/// form a Merkle chain and identical sub-graphs map to identical keys across
+/// runs and processes without hashing large values. Dirty nodes whose key is
+/// present are loaded instead of computed; computed results are stored.
+///
+/// Each worker thread gets its own Arena for node scratch data
+/// (NodeContext::arena()). All arenas are reset when the run ends, so
+/// transient allocations cost a pointer bump and are freed in one shot.
+///
+/// With a ProcessPool attached, nodes of `isolated` types run in worker
+/// processes, exchanging buffers through shared memory. Nodes feeding them
+/// allocate their buffers in shared memory to begin with.
+///
+/// With a Profiler attached, every node execution is timed (wall, thread CPU,
+/// queue wait, arena bytes, cache outcome) for export as a Chrome trace.
+///
+/// With a CostModel attached, ready nodes are no longer taken in release
+/// order: each dirty node is ranked by the estimated time from its start to
+/// the end of the run (its own cost plus that of its costliest chain of
+/// dirty consumers), and the highest-ranked ready node always runs next.
+/// Long chains therefore start as early as possible, with cheap side work
+/// filling the remaining threads. The wall time of every computed node is
+/// fed back into the model when the run ends.
+///
+/// run() pushes every change through the whole graph. pull() evaluates from
+/// the requested outputs instead: only the nodes those outputs depend on are
+/// brought up to date, so branches nothing asks for cost nothing.
+///
+/// Cached outputs can be read with output(). An executor evaluates one graph
+/// at a time; handing it a different graph simply invalidates everything.
+class Executor {
+public:
+    /// Creates a private pool; `threads == 0` means hardware concurrency.
+    explicit Executor(unsigned threads = 0);
+    /// Runs on a pool shared with other executors or subsystems.
+    explicit Executor(ThreadPool& pool);
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /// Brings every node of `graph` up to date, recomputing only dirty nodes.
+    /// Throws GraphError if the graph is invalid and ExecutionError if a node
+    /// fails; remaining work is cancelled and the nodes that did not complete
+    /// stay dirty for the next run.
+    RunStats run(const Graph& graph);
+
+    /// Brings only `outputs` up to date: the dirty nodes they depend on run,
+    /// no others. Nodes downstream of a recomputed node but outside the
+    /// requested cone lose their cached outputs and are recomputed by the
+    /// next run() or pull() that needs them; untouched ones keep theirs.
+    /// Errors as for run(); throws GraphError for unknown nodes.
+    RunStats pull(const Graph& graph, std::span<const PortRef> outputs);
+
+    /// Drops the cached outputs of one node (and so its downstream cone) or of
+    /// every node, forcing recomputation on the next run.
+    void invalidate(NodeId node);
+    void invalidate_all();
+
+    /// Attaches (or with nullptr detaches) a persistent result cache. The
+    /// cache is not owned and must outlive its use by the executor.
+    void set_result_cache(ResultCache* cache);
+    ResultCache* result_cache() const noexcept { return cache_; }
+
+    /// Attaches (or with nullptr detaches) a profiler that records every
+    /// subsequent run. Not owned; it must outlive its use by the executor.
+    void set_profiler(Profiler* profiler) noexcept { profiler_ = profiler; }
+    Profiler* profiler() const noexcept { return profiler_; }
+
+    /// Attaches (or with nullptr detaches) worker processes that evaluate
+    /// every node whose type is `isolated`. Not owned; it must outlive its use
+    /// by the executor.
+    void set_process_pool(ProcessPool* processes) noexcept { processes_ = processes; }
+    ProcessPool* process_pool() const noexcept { return processes_; }
+
+    /// Attaches (or with nullptr detaches) a cost model that orders ready
+    /// nodes by critical path and learns from every subsequent run. Not
+    /// owned; it must outlive its use by the executor.
+    void set_cost_model(CostModel* costs) noexcept { costs_ = costs; }
+    CostModel* cost_model() const noexcept { return costs_; }
+
+    /// Cached output value. Throws GraphError if the node has no valid outputs.
+    const Value& output(PortRef port) const;
+    const Value& output(NodeId node, std::uint32_t port = 0) const { return output({node, port}); }
+
+    ThreadPool& pool() const noexcept { return *pool_; }
+
+private:
+    struct Schedule {
+        const Graph* graph = nullptr;
+        std::uint64_t version = ~std::uint64_t{0};
+        std::vector<std::uint32_t> succ_offset; // CSR offsets, per node id + 1
+        std::vector<NodeId> succ;               // distinct consumers
+    };
+
+    struct RunState;
+
+    void prepare(const Graph& graph);
+    /// `live`, per node id, restricts the run to some nodes; null means all.
+    RunStats evaluate(const Graph& graph, const std::vector<std::uint8_t>* live);
+    void mark_dirty(RunState& state, const std::vector<std::uint8_t>* live);
+    void run_chain(RunState& state, NodeId id);
+    /// Runs the highest-ranked ready node, then keeps taking the highest one
+    /// while its own completions release work (cost model scheduling).
+    void run_ranked(RunState& state);
+    /// Ranks dirty nodes by estimated time to the end of the run.
+    void rank_nodes(RunState& state) const;
+    /// Executes `id` with whatever profiling and timing is attached.
+    void execute(RunState& state, NodeId id);
+    CacheOutcome execute_node(RunState& state, NodeId id);
+    /// True if an isolated node consumes an output of `id`.
+    bool feeds_process_pool(const Graph& graph, NodeId id) const;
+    CacheOutcome execute_profiled(RunState& state, NodeId id);
+    void record_profile(RunState& state, std::chrono::nanoseconds start, bool failed);
+    /// Arena (and profile buffer) index of the calling thread: its worker
+    /// index, or the pool size for any other thread.
+    unsigned current_slot() const noexcept;
+    Arena& current_arena() const noexcept { return *arenas_[current_slot()]; }
+    /// Resets every arena; returns the bytes they had handed out.
+    std::size_t reset_arenas() noexcept;
+    Digest cache_key(const Graph& graph, NodeId id) const;
+    bool load_cached(const Digest& key, std::vector<Value>& outputs) const;
+    void store_cached(const Digest& key, const std::vector<Value>& outputs) const;
+
+    std::unique_ptr<ThreadPool> owned_pool_;
+    ThreadPool* pool_;
+    Schedule schedule_;
+    std::vector<std::vector<Value>> outputs_;  // per node id, per output port
+    std::vector<std::uint8_t> evaluated_;      // per node id: outputs valid
+    std::vector<std::uint64_t> seen_revision_; // per node id: revision of outputs
+    std::vector<std::shared_ptr<const void>> states_; // per node id: NodeType::prepare result
+    std::vector<std::uint64_t> state_revision_;       // per node id: revision it was built for
+    std::vector<std::unique_ptr<Arena>> arenas_; // per pool worker, then the caller
+    ResultCache* cache_ = nullptr;
+    Profiler* profiler_ = nullptr;
+    ProcessPool* processes_ = nullptr;
+    CostModel* costs_ = nullptr;
+    std::vector<std::vector<Digest>> output_digests_; // per node id, with a cache
+};
+
+} // namespace rebelflow
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/node.hpp"
+#include "rebelflow/value.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string_view>
+#include <vector>
+
+namespace rebelflow {
+
+/// One port of one node.
+struct PortRef {
+    NodeId node = invalid_node;
+    std::uint32_t port = 0;
+
+    bool valid() const noexcept { return node != invalid_node; }
+    friend bool operator==(const PortRef&, const PortRef&) = default;
+};
+
+/// A connection from an output port to an input port.
+struct Edge {
+    PortRef from;
+    PortRef to;
+};
+
+/// A directed acyclic graph of node instances.
+///
+/// Node ids are stable for the lifetime of the graph and never reused, so
+/// executors may key per-node state by id. Every input port has at most one
+/// incoming edge; output ports fan out freely. Cycles are detected lazily by
+/// topological_order() so that large graphs can be assembled edge by edge in
+/// linear time.
+///
+/// A Graph is not thread-safe and must not be modified while it is being
+/// evaluated.
+class Graph {
+public:
+    NodeId add_node(std::shared_ptr<const NodeType> type);
+    NodeId add_node(const NodeRegistry& registry, std::string_view type_name);
+
+    /// Removes the node and every edge touching it.
+    void remove_node(NodeId id);
+
+    bool contains(NodeId id) const noexcept;
+    /// Number of live nodes.
+    std::size_t node_count() const noexcept { return live_count_; }
+    /// One past the largest id ever handed out; size per-node tables with this.
+    NodeId id_bound() const noexcept { return static_cast<NodeId>(nodes_.size()); }
+    /// Live node ids in ascending order.
+    std::vector<NodeId> nodes() const;
+
+    const NodeType& type(NodeId id) const { return *record(id).type; }
+    const std::shared_ptr<const NodeType>& type_ptr(NodeId id) const { return record(id).type; }
+
+    /// Connects an output to an input, replacing any edge already driving the
+    /// input. Throws GraphError on bad ports or incompatible port types.
+    void connect(PortRef from, PortRef to);
+    void connect(NodeId src, std::string_view output, NodeId dst, std::string_view input);
+    /// Removes the edge driving `to`, if any.
+    void disconnect(PortRef to);
+
+    /// The output driving input `to`, or an invalid ref when unconnected.
+    PortRef source(PortRef to) const;
+    /// Sources of every input of `id`, indexed by input port.
+    std::span<const PortRef> input_sources(NodeId id) const { return record(id).sources; }
+    /// Inputs fed by any output of `id`.
+    std::span<const PortRef> consumers(NodeId id) const { return record(id).consumers; }
+    std::vector<Edge> edges() const;
+
+    /// Parameter edits bump the node's revision.
+    void set_param(NodeId id, std::string_view name, Value value);
+    void set_param(NodeId id, std::size_t index, Value value);
+    const Value& param(NodeId id, std::string_view name) const;
+    std::span<const Value> params(NodeId id) const { return record(id).params; }
+
+    /// Changes whenever the node's own inputs are re-wired, a parameter is set
+    /// or touch() is called. Executors compare it against the revision they
+    /// last evaluated to decide what is dirty. Values are unique across all
+    /// graphs in the process.
+    std::uint64_t revision(NodeId id) const { return record(id).revision; }
+    /// Marks a node as changed without editing it, e.g. when a file it reads
+    /// was modified externally.
+    void touch(NodeId id);
+
+    /// Live nodes ordered so that every node follows all of its producers.
+    /// Computed once per structural change; throws GraphError on a cycle.
+    const std::vector<NodeId>& topological_order() const;
+
+    /// `targets` and every node they depend on, directly or through other
+    /// nodes, in topological order: the part of the graph that must run to
+    /// compute the targets. Throws GraphError for unknown ids or a cycle.
+    std::vector<NodeId> upstream(std::span<const NodeId> targets) const;
+
+    /// Throws GraphError if the graph cannot be evaluated.
+    void validate() const { topological_order(); }
+
+    /// Changes with every edit to nodes or edges (not parameter edits). Values
+    /// are unique across all graphs in the process.
+    std::uint64_t structure_version() const noexcept { return structure_version_; }
+
+private:
+    struct NodeRecord {
+        std::shared_ptr<const NodeType> type; // null once removed
+        std::vector<Value> params;
+        std::vector<PortRef> sources;   // per input port
+        std::vector<PortRef> consumers; // inputs fed by this node
+        std::uint64_t revision = 0;
+    };
+
+    const NodeRecord& record(NodeId id) const;
+    NodeRecord& record(NodeId id);
+    void structure_changed() noexcept;
+
+    std::vector<NodeRecord> nodes_;
+    std::size_t live_count_ = 0;
+    std::uint64_t structure_version_ = 0;
+
+    mutable std::vector<NodeId> topo_order_;
+    mutable std::uint64_t topo_version_ = ~std::uint64_t{0};
+};
+
+} // namespace rebelflow
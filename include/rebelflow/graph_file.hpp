@@ -0,0 +1,101 @@
+#pragma once
+
+#include "rebelflow/graph.hpp"
+#include "rebelflow/node.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebelflow {
+
+class MappedFile;
+
+/// Name under which save_graph() and load_graph() store a single graph.
+inline constexpr std::string_view main_graph_name = "main";
+
+/// Encodes graphs into the binary graph file format read by GraphFile.
+///
+/// Layout, all little-endian and addressed by absolute offsets:
+///
+///     header      magic "RFGRAPH1", format, graph count, region offsets
+///     strings     pool of every name (types, ports, params, graphs), deduplicated
+///     values      parameter values, 8-byte aligned; buffers are stored raw
+///     per graph   node table, edge table, parameter table (fixed-size records)
+///     directory   one record per graph, sorted by name
+///
+/// Nodes are renumbered densely in id order. Edges and parameters refer to
+/// ports and parameters by name, so files stay loadable when node types gain
+/// ports or parameters.
+class GraphFileWriter {
+public:
+    GraphFileWriter();
+    ~GraphFileWriter();
+
+    GraphFileWriter(const GraphFileWriter&) = delete;
+    GraphFileWriter& operator=(const GraphFileWriter&) = delete;
+
+    /// Encodes `graph` under `name`. Throws GraphError if the name is taken.
+    void add(std::string_view name, const Graph& graph);
+
+    /// Writes the file. The data goes to a temporary file that is then renamed
+    /// over `path`, so readers that still map the old file are unaffected.
+    /// Throws IoError.
+    void save(const std::string& path) const;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+/// A graph file opened for reading.
+///
+/// open() maps the file and checks only the header and the directory, so it
+/// costs the same for ten nodes as for a hundred thousand. Each graph is
+/// decoded the first time graph() asks for it and then kept, so sub-graphs
+/// that are never evaluated are never decoded. Buffer parameters are views
+/// into the mapping, not copies; they keep the mapping alive on their own.
+///
+/// Node types are resolved by name through `registry`, which must outlive
+/// the GraphFile.
+class GraphFile {
+public:
+    /// Throws IoError if the file cannot be mapped and FormatError if it is
+    /// not a graph file.
+    static GraphFile open(const std::string& path, const NodeRegistry& registry);
+
+    GraphFile(GraphFile&&) noexcept;
+    GraphFile& operator=(GraphFile&&) noexcept;
+    ~GraphFile();
+
+    std::size_t graph_count() const noexcept;
+    /// Graph names in sorted order.
+    std::vector<std::string> names() const;
+    bool contains(std::string_view name) const noexcept;
+
+    /// Node count of graph `name`, read from the directory without loading it.
+    std::size_t node_count(std::string_view name) const;
+
+    /// Graph `name`, decoded on first use. Safe to call from several threads.
+    /// Throws GraphError for unknown names or node types and FormatError for
+    /// corrupt tables.
+    std::shared_ptr<const Graph> graph(std::string_view name) const;
+    bool is_loaded(std::string_view name) const;
+
+private:
+    friend Graph load_graph(const std::string& path, const NodeRegistry& registry);
+
+    struct State;
+    explicit GraphFile(std::unique_ptr<State> state) noexcept;
+
+    std::unique_ptr<State> state_;
+};
+
+/// Saves `graph` as the only graph of a file, under main_graph_name.
+void save_graph(const std::string& path, const Graph& graph);
+/// Loads the main graph of a file without keeping the GraphFile open.
+Graph load_graph(const std::string& path, const NodeRegistry& registry);
+
+} // namespace rebelflow
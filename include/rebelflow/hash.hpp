@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace rebelflow {
+
+/// 128-bit content digest.
+struct Digest {
+    std::uint64_t lo = 0;
+    std::uint64_t hi = 0;
+
+    bool empty() const noexcept { return lo == 0 && hi == 0; }
+    std::string to_hex() const;
+
+    friend bool operator==(const Digest&, const Digest&) = default;
+    friend auto operator<=>(const Digest&, const Digest&) = default;
+};
+
+/// Streaming MurmurHash3 (x64, 128-bit). Not cryptographic, but wide enough
+/// that accidental collisions between cache keys are not a practical concern.
+class Hasher {
+public:
+    explicit Hasher(std::uint64_t seed = 0) noexcept : h1_(seed), h2_(seed) {}
+
+    Hasher& update(const void* data, std::size_t size) noexcept;
+    Hasher& update(std::string_view text) noexcept;
+    Hasher& update(std::uint64_t v) noexcept { return update(&v, sizeof v); }
+    Hasher& update(const Digest& d) noexcept { return update(d.lo).update(d.hi); }
+
+    /// Digest of everything fed so far. Does not reset the hasher.
+    Digest digest() const noexcept;
+
+private:
+    void block(const unsigned char* p) noexcept;
+
+    std::uint64_t h1_;
+    std::uint64_t h2_;
+    std::uint64_t length_ = 0;
+    unsigned char tail_[16] = {};
+    std::size_t tail_size_ = 0;
+};
+
+} // namespace rebelflow
+
+template <>
+struct std::hash<rebelflow::Digest> {
+    std::size_t operator()(const rebelflow::Digest& d) const noexcept {
+        return static_cast<std::size_t>(d.lo ^ (d.hi * 0x9e3779b97f4a7c15ull));
+    }
+};
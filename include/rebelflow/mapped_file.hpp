@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace rebelflow {
+
+/// A file mapped into memory with mmap. Move-only; unmaps and closes on
+/// destruction. Errors throw IoError.
+class MappedFile {
+public:
+    enum class Mode { ReadOnly, ReadWrite };
+
+    MappedFile() noexcept = default;
+    ~MappedFile();
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /// Maps an existing file in full.
+    static MappedFile open(const std::string& path, Mode mode = Mode::ReadOnly);
+    /// Creates (or truncates) a file of `size` bytes and maps it read-write.
+    static MappedFile create(const std::string& path, std::uint64_t size);
+    /// Opens or creates `path` read-write without truncating it, takes an
+    /// exclusive lock on it (held until the file is closed) and only then
+    /// resizes it to `size` bytes if it differs. Throws IoError if another
+    /// process holds the lock. `resized` tells whether the size changed.
+    static MappedFile open_locked(const std::string& path, std::uint64_t size, bool& resized);
+
+    bool is_open() const noexcept { return fd_ >= 0; }
+    std::byte* data() noexcept { return data_; }
+    const std::byte* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+    std::span<const std::byte> bytes() const noexcept { return {data_, size_}; }
+    int fd() const noexcept { return fd_; }
+    const std::string& path() const noexcept { return path_; }
+
+    /// Schedules dirty pages for write-back (`wait` blocks until done).
+    void sync(bool wait = false);
+
+    /// Hints that the whole mapping will be read front to back.
+    void advise_sequential() noexcept;
+
+private:
+    void close() noexcept;
+
+    std::string path_;
+    int fd_ = -1;
+    std::byte* data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "rebelflow/buffer.hpp"
+#include "rebelflow/hash.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebelflow {
+
+class ThreadPool;
+
+/// The elements a mesh attribute holds one tuple per.
+enum class MeshDomain : std::uint8_t {
+    Vertex,
+    Face,
+    Corner,
+};
+
+const char* to_string(MeshDomain domain) noexcept;
+
+/// A named array carried along with a mesh: normals, texture coordinates,
+/// colors, material ids.
+struct MeshAttribute {
+    std::string name;
+    MeshDomain domain = MeshDomain::Vertex;
+    Buffer data;
+
+    friend bool operator==(const MeshAttribute&, const MeshAttribute&) = default;
+};
+
+/// A triangle mesh as a half-edge structure stored as structure-of-arrays.
+///
+/// Triangle f owns half-edges 3f, 3f + 1 and 3f + 2, in order around it, so
+/// the face, next and previous half-edge of any half-edge are arithmetic and
+/// take no storage. What is stored are flat arrays indexed by element:
+///
+/// - per vertex, its position (f64, xyz tuples) and one outgoing half-edge,
+///   a boundary one where there is one, so that for_each_outgoing() sweeps a
+///   whole fan;
+/// - per half-edge, the vertex it starts at (read three at a time, the
+///   corners are an ordinary triangle index list) and its twin, the opposite
+///   half-edge in the neighbouring triangle, or `invalid` on the boundary.
+///
+/// Links are 32-bit indices rather than pointers, so the arrays are compact,
+/// trivially copyable and position independent: they travel through shared
+/// memory and files as they are, and loops over them vectorize.
+///
+/// A Mesh is an immutable value like Buffer: copies share the arrays, and
+/// the with_*() edits copy only what they replace. Each array is a Buffer,
+/// so a mesh built from wrapped or mapped buffers is not copied either.
+class Mesh {
+public:
+    static constexpr std::uint32_t invalid = ~std::uint32_t{0};
+
+    /// The stored arrays.
+    struct Arrays {
+        /// f64, 3 components: one xyz tuple per vertex.
+        Buffer positions;
+        /// u32, 3 components: the vertices of each triangle, counterclockwise.
+        Buffer corners;
+        /// u32, 3 components: the twin of each half-edge, or `invalid`.
+        Buffer twins;
+        /// u32: an outgoing half-edge of each vertex, `invalid` if unused.
+        Buffer vertex_halfedges;
+        std::vector<MeshAttribute> attributes;
+    };
+
+    /// An empty mesh.
+    Mesh();
+
+    /// Builds the half-edge structure of an indexed triangle list.
+    /// `positions` holds f32 or f64 elements, three per vertex; `triangles`
+    /// integer vertex indices, three per triangle. Buffers already in the
+    /// stored layout are shared, not copied. Edges used by more than two
+    /// triangles, or twice in the same direction, are left unlinked, as are
+    /// degenerate edges. Throws TypeError for other buffer types and Error for
+    /// indices out of range.
+    static Mesh from_triangles(const Buffer& positions, const Buffer& triangles,
+                               ThreadPool* pool = nullptr);
+
+    /// Adopts previously built arrays (as read back from a file or another
+    /// process), checking their shapes and index ranges. Throws FormatError
+    /// if they are inconsistent.
+    static Mesh from_arrays(Arrays arrays);
+
+    const Arrays& arrays() const noexcept { return *data_; }
+
+    std::size_t vertex_count() const noexcept { return vertex_count_; }
+    std::size_t face_count() const noexcept { return face_count_; }
+    std::size_t halfedge_count() const noexcept { return face_count_ * 3; }
+    bool empty() const noexcept { return face_count_ == 0 && vertex_count_ == 0; }
+
+    /// x, y, z of vertex 0, then vertex 1, ...
+    std::span<const double> positions() const noexcept { return {positions_, vertex_count_ * 3}; }
+    std::span<const std::uint32_t> corners() const noexcept { return {corners_, halfedge_count()}; }
+    std::span<const std::uint32_t> twins() const noexcept { return {twins_, halfedge_count()}; }
+    std::span<const std::uint32_t> vertex_halfedges() const noexcept {
+        return {vertex_halfedges_, vertex_count_};
+    }
+
+    static constexpr std::uint32_t face(std::uint32_t h) noexcept { return h / 3; }
+    static constexpr std::uint32_t next(std::uint32_t h) noexcept {
+        return h % 3 == 2 ? h - 2 : h + 1;
+    }
+    static constexpr std::uint32_t prev(std::uint32_t h) noexcept {
+        return h % 3 == 0 ? h + 2 : h - 1;
+    }
+    std::uint32_t twin(std::uint32_t h) const noexcept { return twins_[h]; }
+    std::uint32_t origin(std::uint32_t h) const noexcept { return corners_[h]; }
+    std::uint32_t target(std::uint32_t h) const noexcept { return corners_[next(h)]; }
+    bool is_boundary(std::uint32_t h) const noexcept { return twins_[h] == invalid; }
+
+    /// Calls `f(h)` for the outgoing half-edges of vertex `v` in one fan,
+    /// counterclockwise, starting at the boundary if the fan is open.
+    /// Vertices where several fans meet are only partly visited.
+    template <typename F>
+    void for_each_outgoing(std::uint32_t v, F&& f) const {
+        const std::uint32_t start = vertex_halfedges_[v];
+        if (start == invalid) {
+            return;
+        }
+        std::uint32_t h = start;
+        do {
+            f(h);
+            h = twins_[prev(h)];
+        } while (h != invalid && h != start);
+    }
+
+    std::span<const MeshAttribute> attributes() const noexcept { return data_->attributes; }
+    /// The attribute called `name`, or null.
+    const MeshAttribute* attribute(std::string_view name) const noexcept;
+
+    /// A copy with `attribute` added, replacing one of the same name. Throws
+    /// TypeError unless it holds one tuple per element of its domain.
+    Mesh with_attribute(MeshAttribute attribute) const;
+    Mesh without_attribute(std::string_view name) const;
+    /// A copy with the same connectivity and attributes and new positions,
+    /// f64 xyz tuples for the same number of vertices (else TypeError).
+    Mesh with_positions(Buffer positions) const;
+
+    std::size_t size_bytes() const noexcept;
+
+    /// Digest of positions, triangles and attributes; twins and vertex
+    /// half-edges follow from the triangles and are not hashed.
+    Digest content_digest() const;
+
+    /// Same positions, triangles and attributes.
+    friend bool operator==(const Mesh& a, const Mesh& b);
+
+private:
+    explicit Mesh(std::shared_ptr<const Arrays> data) noexcept;
+
+    std::shared_ptr<const Arrays> data_;
+    // Cached from data_ for the accessors above.
+    const double* positions_ = nullptr;
+    const std::uint32_t* corners_ = nullptr;
+    const std::uint32_t* twins_ = nullptr;
+    const std::uint32_t* vertex_halfedges_ = nullptr;
+    std::size_t vertex_count_ = 0;
+    std::size_t face_count_ = 0;
+};
+
+/// Merges vertices closer than `tolerance` (0 merges only equal positions)
+/// and drops the triangles that collapse. Each merged vertex takes the
+/// position and vertex attributes of the lowest-numbered vertex of its group.
+/// Any positions and any non-negative tolerance, however large or small, are
+/// handled; throws Error if `tolerance` is negative or NaN.
+Mesh weld(const Mesh& mesh, double tolerance, ThreadPool* pool = nullptr);
+
+/// Laplacian smoothing: each pass moves every vertex `factor` of the way to
+/// the average of its neighbours. Boundary vertices stay put if
+/// `keep_boundary`.
+Mesh smooth(const Mesh& mesh, std::size_t iterations, double factor, bool keep_boundary,
+            ThreadPool* pool = nullptr);
+
+/// Unit vertex normals (f64 xyz tuples), averaging the normals of the
+/// surrounding triangles weighted by their area.
+Buffer vertex_normals(const Mesh& mesh, ThreadPool* pool = nullptr);
+
+/// Splits every triangle into four at its edge midpoints, `levels` times.
+/// Vertex and corner attributes are interpolated at the new vertices (float
+/// types; others take the value of the edge's first end); face attributes
+/// carry over to the four parts.
+Mesh subdivide(const Mesh& mesh, std::size_t levels = 1, ThreadPool* pool = nullptr);
+
+} // namespace rebelflow
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "rebelflow/mesh.hpp"
+
+#include <cstdint>
+
+namespace rebelflow {
+
+class ThreadPool;
+
+enum class BooleanOperation : std::uint8_t {
+    Union,
+    Intersection,
+    /// a minus b.
+    Difference,
+};
+
+const char* to_string(BooleanOperation operation) noexcept;
+
+/// The union, intersection or difference of the solids bounded by two
+/// closed meshes. Both must be welded, consistently oriented with normals
+/// pointing out, and free of self-intersections; degenerate triangles are
+/// taken not to cut anything.
+///
+/// Candidate triangle pairs come from a dual traversal of the two meshes'
+/// Bvhs, and each pair is then decided in parallel by orientation tests
+/// that are exact: evaluated in floating point and redone in exact
+/// arithmetic when within rounding error of zero. Exact ties, where the
+/// meshes touch or share a plane, are broken by symbolic perturbation, as
+/// if b were moved by an infinitesimal translation, so all decisions agree
+/// with one another and the cuts form closed curves. Only the cut points
+/// themselves are rounded to doubles, and a cut point the perturbation puts
+/// at a vertex, or where an edge meets an edge, is given that exact
+/// position, so edges lying in the other mesh's faces and vertices on them
+/// are cut consistently.
+///
+/// The cut triangles are re-triangulated in parallel, each in its own
+/// plane, and the pieces of either mesh kept or dropped by which side of
+/// the other they are on: next to a cut by the direction of the cut, away
+/// from the cuts by flooding across uncut edges, and for parts no cut
+/// reaches by ray parity. Pieces of both meshes share the vertices along
+/// the cuts, so the result is closed too. Vertices of b at the position of
+/// a vertex of a are merged into it; where the meshes then coincide, pieces
+/// of the two on the same vertices facing opposite ways, the sides of a
+/// sheet of no volume, are left out. Coincident faces triangulated
+/// differently keep their sheet, which is closed but has no volume. The
+/// result carries no attributes.
+Mesh mesh_boolean(const Mesh& a, const Mesh& b, BooleanOperation operation,
+                  ThreadPool* pool = nullptr);
+
+} // namespace rebelflow
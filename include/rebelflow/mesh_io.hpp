@@ -0,0 +1,76 @@
+#pragma once
+
+#include "rebelflow/mesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace rebelflow {
+
+class ThreadPool;
+
+/// Mesh file formats, told apart by file extension.
+enum class MeshFormat : std::uint8_t {
+    /// Binary or ASCII STL: a triangle soup, whose equal vertices are merged
+    /// on reading.
+    Stl,
+    /// Wavefront OBJ: `v` and `f` records; polygons are fanned into
+    /// triangles and everything else is skipped.
+    Obj,
+    /// PLY, ASCII or binary of either byte order: the x, y and z of the
+    /// `vertex` element and the `vertex_indices` (or `vertex_index`) lists
+    /// of the `face` element, fanned into triangles.
+    Ply,
+};
+
+const char* to_string(MeshFormat format) noexcept;
+
+/// The format of `path` by its extension, in any case. Throws Error for
+/// other extensions.
+MeshFormat mesh_format_of(const std::string& path);
+
+/// Reads the mesh in `path`. The file is mapped rather than read, and its
+/// records are parsed in parallel: text formats in blocks of whole lines,
+/// each block counted on a first pass and decoded into place on a second,
+/// and binary ones straight out of the mapping at their fixed stride. The
+/// mesh carries no attributes. Throws IoError if the file cannot be read
+/// and FormatError if it is malformed, with the line for text formats.
+Mesh read_mesh(const std::string& path, ThreadPool* pool = nullptr);
+
+/// Writes `mesh` to `path`, in the format of its extension and binary where
+/// the format has one and `binary` is set (OBJ is always text). Blocks of
+/// records are formatted in parallel and handed to the kernel together with
+/// writev, the binary PLY vertex block straight from the mesh's positions.
+/// The file is written under a fresh temporary name in the same directory
+/// and renamed into place.
+/// Attributes are not written. Returns the size of the file; throws IoError.
+std::uint64_t write_mesh(const Mesh& mesh, const std::string& path, bool binary = true,
+                         ThreadPool* pool = nullptr);
+
+/// Reads the points of a mesh file a chunk at a time, for data sets too large
+/// to hold at once. The file is mapped and each chunk is decoded from where
+/// its records lie, front to back, so memory use is one chunk whatever the
+/// file size. The points are the vertices of OBJ and PLY files and the
+/// triangle corners of STL ones, in file order and not merged; faces are
+/// skipped. Throws like read_mesh(), from the constructor for bad headers
+/// and from next() for bad records.
+class PointReader {
+public:
+    explicit PointReader(const std::string& path);
+    ~PointReader();
+
+    PointReader(PointReader&&) noexcept;
+    PointReader& operator=(PointReader&&) noexcept;
+
+    /// Stores up to `max_points` further points in `points`, an f64 buffer
+    /// of xyz triples. Returns false once every point has been read.
+    bool next(std::size_t max_points, Buffer& points);
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+} // namespace rebelflow
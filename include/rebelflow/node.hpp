@@ -0,0 +1,282 @@
+#pragma once
+
+#include "rebelflow/arena.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace rebelflow {
+
+class Script;
+class ThreadPool;
+
+/// Declaration of one input or output port.
+struct PortSpec {
+    std::string name;
+    DataType type = DataType::Any;
+    /// Used for inputs that have no incoming edge.
+    Value default_value{};
+};
+
+/// Declaration of one node parameter. Parameters are constants set on the
+/// node instance, addressed by index inside compute functions.
+struct ParamSpec {
+    std::string name;
+    Value default_value{};
+};
+
+/// Everything a compute function may touch while it runs. Inputs are borrowed
+/// from the producing node's output slots; nothing is copied on the way in.
+class NodeContext {
+public:
+    NodeContext(NodeId node,
+                std::span<const Value* const> inputs,
+                std::span<const Value> params,
+                std::span<Value> outputs,
+                Arena& arena,
+                const void* state = nullptr,
+                ThreadPool* pool = nullptr) noexcept
+        : node_(node), inputs_(inputs), params_(params), outputs_(outputs), arena_(&arena),
+          state_(state), pool_(pool) {}
+
+    NodeId node() const noexcept { return node_; }
+
+    std::size_t input_count() const noexcept { return inputs_.size(); }
+    const Value& input(std::size_t i) const { return *inputs_[i]; }
+    std::span<const Value* const> inputs() const noexcept { return inputs_; }
+
+    std::size_t param_count() const noexcept { return params_.size(); }
+    const Value& param(std::size_t i) const { return params_[i]; }
+
+    std::size_t output_count() const noexcept { return outputs_.size(); }
+    void set_output(std::size_t i, Value v) { outputs_[i] = std::move(v); }
+    std::span<Value> outputs() const noexcept { return outputs_; }
+
+    /// Scratch memory for this evaluation, released in one shot when the
+    /// evaluation ends. Never let outputs point into it.
+    Arena& arena() const noexcept { return *arena_; }
+
+    /// This node with other inputs, outputs and scratch arena but the same
+    /// parameters, state and pool: for evaluating the node's type on one part
+    /// of its data at a time.
+    NodeContext with(std::span<const Value* const> inputs,
+                     std::span<Value> outputs,
+                     Arena& arena) const noexcept {
+        return {node_, inputs, params_, outputs, arena, state_, pool_};
+    }
+
+    /// The pool the node runs on, for nodes that split their own work into
+    /// parallel tasks (see parallel_for()). Null when the executor has none;
+    /// the work then runs inline.
+    ThreadPool* pool() const noexcept { return pool_; }
+
+    /// The state NodeType::prepare built for this node instance, as the type
+    /// it really is. Only valid for types that have a prepare function.
+    template <typename T>
+    const T& state() const noexcept {
+        return *static_cast<const T*>(state_);
+    }
+
+private:
+    NodeId node_;
+    std::span<const Value* const> inputs_;
+    std::span<const Value> params_;
+    std::span<Value> outputs_;
+    Arena* arena_;
+    const void* state_;
+    ThreadPool* pool_;
+};
+
+/// Column-at-a-time counterpart of NodeContext, handed to batch kernels.
+///
+/// A batch covers rows() records. Each input is either a column -- a Buffer
+/// holding one element per row -- or a scalar that applies to every row.
+/// floats()/ints() hide the difference: they return one contiguous value per
+/// row, viewing the column directly when it already has the requested type
+/// and otherwise converting or broadcasting into the arena. Outputs are always
+/// columns.
+class BatchContext {
+public:
+    BatchContext(NodeId node,
+                 std::size_t rows,
+                 std::span<const Value* const> inputs,
+                 std::span<const std::uint8_t> input_is_column,
+                 std::span<const Value> params,
+                 std::span<Value> outputs,
+                 Arena& arena) noexcept
+        : node_(node), rows_(rows), inputs_(inputs), input_is_column_(input_is_column),
+          params_(params), outputs_(outputs), arena_(&arena) {}
+
+    NodeId node() const noexcept { return node_; }
+    std::size_t rows() const noexcept { return rows_; }
+
+    std::size_t input_count() const noexcept { return inputs_.size(); }
+    bool is_column(std::size_t i) const noexcept { return input_is_column_[i] != 0; }
+    /// The raw input: a column Buffer or a scalar, see is_column().
+    const Value& input(std::size_t i) const { return *inputs_[i]; }
+    /// Input `i` as one f64 / i64 per row. Throws TypeError for non-numeric
+    /// inputs.
+    std::span<const double> floats(std::size_t i) const;
+    std::span<const std::int64_t> ints(std::size_t i) const;
+
+    std::size_t param_count() const noexcept { return params_.size(); }
+    const Value& param(std::size_t i) const { return params_[i]; }
+
+    std::size_t output_count() const noexcept { return outputs_.size(); }
+    /// Allocates output column `i` and returns its rows for writing.
+    std::span<double> output_floats(std::size_t i);
+    std::span<std::int64_t> output_ints(std::size_t i);
+    /// Sets output `i` to a column built by the kernel; it must hold rows()
+    /// elements.
+    void set_output(std::size_t i, Buffer column) { outputs_[i] = std::move(column); }
+
+    Arena& arena() const noexcept { return *arena_; }
+
+private:
+    NodeId node_;
+    std::size_t rows_;
+    std::span<const Value* const> inputs_;
+    std::span<const std::uint8_t> input_is_column_;
+    std::span<const Value> params_;
+    std::span<Value> outputs_;
+    Arena* arena_;
+};
+
+/// Producer side of a streaming source node: yields a data set one chunk at
+/// a time, so the whole set never has to be in memory.
+class ChunkSource {
+public:
+    virtual ~ChunkSource() = default;
+    /// Stores the next chunk in `chunk`; returns false once exhausted.
+    virtual bool next(Value& chunk) = 0;
+};
+
+/// Consumer side of a streaming sink node: folds chunks into a result.
+class ChunkSink {
+public:
+    virtual ~ChunkSink() = default;
+    /// Called once per chunk, in stream order.
+    virtual void consume(const Value& chunk) = 0;
+    /// Called after the last chunk; sets the node's outputs.
+    virtual void finish(NodeContext& ctx) = 0;
+};
+
+using ComputeFn = std::function<void(NodeContext&)>;
+/// Builds per-instance state from a node's parameters; see NodeType::prepare.
+using PrepareFn = std::function<std::shared_ptr<const void>(std::span<const Value> params)>;
+/// Describes a node's computation as a Script; see NodeType::expression.
+using ExpressionFn =
+    std::function<std::shared_ptr<const Script>(std::span<const Value> params)>;
+using KernelFn = void (*)(NodeContext&);
+using BatchKernelFn = void (*)(BatchContext&);
+/// Open a source or sink for one streamed run. The context carries the
+/// node's parameters and its non-streamed inputs.
+using OpenSourceFn = std::function<std::unique_ptr<ChunkSource>(NodeContext&)>;
+using OpenSinkFn = std::function<std::unique_ptr<ChunkSink>(NodeContext&)>;
+
+/// A kind of node: its ports, parameters and behaviour. Types are immutable
+/// once registered and shared between every node instance of that kind.
+struct NodeType {
+    std::string name;
+    std::vector<PortSpec> inputs;
+    std::vector<PortSpec> outputs;
+    std::vector<ParamSpec> params;
+    ComputeFn compute;
+    /// Optional plain-function form of `compute` for stateless node types.
+    /// Compiled plans call it directly instead of through std::function. When
+    /// only `kernel` is set, registration fills `compute` from it.
+    KernelFn kernel = nullptr;
+    /// Optional column-at-a-time form used by CompiledPlan::run_batch(). It
+    /// must compute, row by row, exactly what `compute` would. Types without
+    /// one are evaluated once per row in batch mode.
+    BatchKernelFn batch_kernel = nullptr;
+    /// Optional per-instance set-up, e.g. compiling a script held in a
+    /// parameter. Executors call it before a node's first evaluation and again
+    /// after its parameters change, never per evaluation, and hand the result
+    /// to compute through NodeContext::state(). The state is shared between
+    /// threads and must not be modified.
+    PrepareFn prepare;
+    /// Optional: output 0 as a Script over the inputs in port order, for
+    /// types with a single output. CompiledPlan fuses neighbouring expression
+    /// nodes into one script, folding in constant inputs and evaluating shared
+    /// subexpressions once; other executors ignore it. For number and vector
+    /// inputs the script must compute what `compute` does.
+    ExpressionFn expression;
+    /// Streaming roles, used by StreamExecutor. A source emits its first
+    /// output as a sequence of chunks; a sink takes its streamed input chunk
+    /// by chunk. Without an explicit `compute`, registration derives one that
+    /// treats the whole data set as a single chunk: a source concatenates its
+    /// chunks, a sink consumes its first input in one go.
+    OpenSourceFn open_source;
+    OpenSinkFn open_sink;
+
+    /// Outputs depend only on inputs and parameters. Pure nodes may be served
+    /// from a ResultCache; impure ones (file readers, clocks) are computed
+    /// whenever they are dirty, never loaded, and are not constant-folded.
+    bool pure = true;
+    /// Evaluate in a worker process when the executor has a ProcessPool:
+    /// for crash-prone or allocation-heavy nodes. Ignored otherwise.
+    bool isolated = false;
+    /// Part of every cache key for this type. Bump it when the compute
+    /// function changes meaning so persisted results from older builds stop
+    /// matching.
+    std::uint32_t version = 1;
+
+    /// Index lookups by name; return -1 when absent.
+    int input_index(std::string_view port) const noexcept;
+    int output_index(std::string_view port) const noexcept;
+    int param_index(std::string_view param) const noexcept;
+};
+
+/// Name -> node type table used when building graphs by type name.
+///
+/// Lookups are safe from several threads once registration is done. Moving a
+/// registry is not synchronized.
+class NodeRegistry {
+public:
+    NodeRegistry() = default;
+    NodeRegistry(NodeRegistry&& other) noexcept;
+    NodeRegistry& operator=(NodeRegistry&& other) noexcept;
+    ~NodeRegistry();
+
+    /// Registers `type`; throws GraphError if the name is already taken.
+    std::shared_ptr<const NodeType> add(NodeType type);
+
+    /// Registers `name` now but builds its type with `make` only when find()
+    /// first asks for it, e.g. to decode a sub-graph body on first use. A
+    /// `make` that throws is retried on the next lookup, and the lookup
+    /// rethrows; a type whose `make` looks itself up throws GraphError.
+    /// Throws GraphError if the name is already taken.
+    void add_deferred(std::string name, std::function<NodeType()> make);
+
+    /// Returns nullptr when no such type is registered. Builds deferred
+    /// types.
+    std::shared_ptr<const NodeType> find(std::string_view name) const;
+
+    /// Like find() but throws GraphError when the type is unknown.
+    std::shared_ptr<const NodeType> get(std::string_view name) const;
+
+    /// Whether `name` is registered, without building a deferred type.
+    bool contains(std::string_view name) const;
+
+    std::vector<std::string> names() const;
+
+private:
+    struct Deferred;
+
+    mutable std::mutex mutex_;
+    mutable std::unordered_map<std::string, std::shared_ptr<const NodeType>> types_;
+    std::unordered_map<std::string, std::shared_ptr<Deferred>> deferred_;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "rebelflow/node.hpp"
+
+namespace rebelflow {
+
+/// Registers the core node library:
+///
+/// - `Constant`: emits its `value` parameter.
+/// - `Add`, `Subtract`, `Multiply`, `Divide`: float arithmetic on `a`, `b`.
+/// - `Min`, `Max`: float comparison on `a`, `b`.
+/// - `Range`: f64 buffer holding 0 .. `count` - 1. When streamed it is a
+///   source emitting `chunk_size` elements at a time.
+/// - `Scale`: multiplies a float buffer by `factor` (copy-on-write).
+/// - `Sum`: adds up a float buffer. When streamed it is a sink.
+///
+/// The arithmetic and comparison nodes also have batch kernels and are
+/// expression nodes (NodeType::expression) that compiled plans can fuse.
+void register_builtin_nodes(NodeRegistry& registry);
+
+} // namespace rebelflow
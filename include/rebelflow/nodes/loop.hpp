@@ -0,0 +1,39 @@
+#pragma once
+
+#include "rebelflow/node.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace rebelflow {
+
+/// Registers the collection node library. A collection is a Buffer whose
+/// items are its tuples: numbers for 1-component buffers, otherwise one tuple
+/// each (a 3-component buffer is a list of 3-vectors). Items are independent,
+/// so they are spread over the executor's pool (NodeContext::pool()) in
+/// ranges of at least `grain` items.
+///
+/// - `Map`: evaluates the Script in `code` per item, with the item as `x`,
+///   its index as `i` and the node's `a` and `b` inputs as `a`, `b`. Emits an
+///   f64 buffer of the results, numbers or 3-vectors, in item order.
+/// - `Reduce`: folds the items with the Script in `code`, a combiner of `a`
+///   and `b` (default `a + b`). When `associative` is set the items are
+///   reduced as a parallel tree: per-range partial results, then pairwise
+///   combination level by level; otherwise strictly left to right. The
+///   `initial` input, when connected or set, is combined in front:
+///   `code(initial, reduction)`. An empty collection yields `initial`.
+void register_loop_nodes(NodeRegistry& registry);
+
+/// A for-each node over `body`: a node type (typically a sub-graph, see
+/// subgraph_type()) evaluated once per item. The body's first input becomes
+/// the `items` collection input; its other inputs and its parameters carry
+/// over unchanged and apply to every item. Each output collects the per-item
+/// values, which must be numbers or 3-vectors, into an f64 buffer. Items run
+/// in parallel in ranges of at least `grain`. An error names the item that
+/// failed. Throws GraphError if `body` has no inputs or no outputs.
+NodeType for_each_type(std::string name,
+                       std::shared_ptr<const NodeType> body,
+                       std::size_t grain = 1);
+
+} // namespace rebelflow
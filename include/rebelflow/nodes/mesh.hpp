@@ -0,0 +1,76 @@
+#pragma once
+
+#include "rebelflow/node.hpp"
+
+namespace rebelflow {
+
+/// Registers the mesh node library (see Mesh). The nodes spread their
+/// per-element and per-query loops over the executor's pool
+/// (NodeContext::pool()).
+///
+/// - `MeshFromArrays`: builds a mesh from `positions`, xyz per vertex, and
+///   `triangles`, three vertex indices each (Mesh::from_triangles()).
+/// - `MeshArrays`: the `positions` (f64) and `triangles` (u32) of a mesh,
+///   sharing its storage.
+/// - `Grid`: a `size_x` by `size_y` rectangle in the xy plane, centered on
+///   the origin, split into `divisions_x` by `divisions_y` cells of two
+///   triangles each.
+/// - `Weld`: merges vertices within `tolerance` of each other (weld()).
+/// - `Smooth`: `iterations` passes of Laplacian smoothing by `factor`,
+///   optionally keeping the boundary fixed (smooth()).
+/// - `Normals`: stores area-weighted unit vertex normals as the vertex
+///   attribute called `name` (vertex_normals()).
+/// - `Subdivide`: splits each triangle into four, `levels` times
+///   (subdivide()).
+/// - `Bounds`: the `min` and `max` corners of the box around `points` and
+///   their `count`. It is also a streaming sink, so it can take the points
+///   of `ReadPoints` a chunk at a time (StreamExecutor).
+///
+/// Queries go through a Bvh built once by `BuildBvh`. It is a pure node like
+/// the others, so editing the query inputs reuses the hierarchy from the
+/// executor's and the result cache. Misses give triangle -1 and NaN points.
+///
+/// - `BuildBvh`: the hierarchy of a mesh, `max_leaf_size` triangles per
+///   leaf (Bvh::build()).
+/// - `Raycast`: the nearest hit within `max_distance` of a ray from each of
+///   `origins` along `directions` (one per origin, or one for all): the
+///   `distance` along it, the `triangle` and the `point` hit.
+/// - `ClosestPoint`: for each of `points`, the nearest `point` of the mesh
+///   within `max_distance`, its `distance` and `triangle`.
+/// - `Overlaps`: the `pairs` of triangles of `a` and `b` at most `tolerance`
+///   apart, with their `distance`; with `b` unconnected, the pairs within
+///   `a` that do not share a vertex.
+///
+/// A Brep is tessellated only where a graph asks for it, and each shape's
+/// triangles are kept with the value, so tessellating a few bodies of a large
+/// assembly is cheap and doing it again cheaper still.
+///
+/// - `Tessellate`: the `mesh` of the body called `name` or, if it is empty,
+///   of body number `body`, within `tolerance`; of every body if `body` is
+///   -1 (Brep::tessellate(), Brep::tessellate_all()).
+///
+/// The boolean nodes combine the solids bounded by closed meshes `a` and
+/// `b` exactly (mesh_boolean()). The resulting `mesh` has no attributes.
+///
+/// - `Union`: the space inside either.
+/// - `Intersection`: the space inside both.
+/// - `Difference`: the space inside `a` and outside `b`.
+///
+/// File nodes are impure: a ResultCache never serves them and their outputs
+/// are keyed by content, since the file may change between runs. The
+/// executor still reuses their outputs until their parameters or inputs
+/// change; Graph::touch() makes one read or write again. The mesh format
+/// follows the extension of `path`: .stl, .obj or .ply (read_mesh(),
+/// write_mesh()).
+///
+/// - `ReadMesh`: the `mesh` in the file at `path`.
+/// - `WriteMesh`: writes `mesh` to `path`, `binary` unless the format is
+///   text only, and outputs the number of `bytes` written.
+/// - `ReadPoints`: the `points` of the mesh file at `path`, vertices or STL
+///   triangle corners. It is also a streaming source of `chunk_size` points
+///   at a time, decoded as they are needed (PointReader).
+/// - `ReadStep`: the solids and sheets of the STEP file at `path` as a
+///   `brep`, not yet tessellated (read_step()).
+void register_mesh_nodes(NodeRegistry& registry);
+
+} // namespace rebelflow
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "rebelflow/node.hpp"
+
+namespace rebelflow {
+
+/// Registers the scripting node library:
+///
+/// - `Script`: evaluates the Script held in its `code` parameter over inputs
+///   `a` .. `d` (numbers or 3-element float buffers, default 0) and emits the
+///   result as a float or a 3-element f64 buffer. The code is compiled when
+///   the parameter is set, not per evaluation; compile errors surface as an
+///   ExecutionError on the node. Script nodes are expression nodes
+///   (NodeType::expression): compiled plans fuse connected ones.
+void register_script_nodes(NodeRegistry& registry);
+
+} // namespace rebelflow
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "rebelflow/node.hpp"
+#include "rebelflow/value.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace rebelflow {
+
+/// Worker processes on this machine that evaluate nodes out of process.
+///
+/// Executors with a pool attached (Executor::set_process_pool()) hand every
+/// node whose type is `isolated` to a worker. A node that crashes takes down
+/// only its worker: the evaluation fails with the signal that killed it and
+/// the next isolated node gets a fresh process. Workers also have heaps of
+/// their own, so allocation-heavy nodes do not contend with the executor's
+/// threads.
+///
+/// Buffers travel through shared memory (SharedSegment), not serialization.
+/// A worker allocates its output buffers straight in shared segments, which
+/// the caller maps and wraps without copying; buffers that already live in
+/// shared memory, such as the outputs of another isolated node, are passed
+/// back the same way. Other input buffers are copied once into a segment.
+/// Everything else (numbers, strings, parameters) is encoded in the message.
+///
+/// Workers are forked from a helper process that is forked when the pool is
+/// created. They run node types found by name in `registry` as it was at
+/// that point, so register every node type first. The helper is also what
+/// restarts crashed workers, which is why forking must happen while the
+/// process is quiet: create the pool before starting threads, executors in
+/// particular. Linux and other POSIX systems only.
+class ProcessPool {
+public:
+    /// Starts `processes` workers; 0 means one per hardware thread. Throws
+    /// IoError if the processes cannot be started.
+    explicit ProcessPool(const NodeRegistry& registry, unsigned processes = 0);
+    ~ProcessPool();
+
+    ProcessPool(const ProcessPool&) = delete;
+    ProcessPool& operator=(const ProcessPool&) = delete;
+
+    unsigned size() const noexcept { return static_cast<unsigned>(workers_.size()); }
+
+    /// Evaluates one node of `type` in a worker, waiting for a free one, and
+    /// stores its outputs. The worker prepares the node's state itself.
+    /// Failures are rethrown as the library error they were in the worker;
+    /// a worker that dies throws Error naming the signal or exit status.
+    void run(const NodeType& type,
+             NodeId node,
+             std::span<const Value* const> inputs,
+             std::span<const Value> params,
+             std::span<Value> outputs);
+
+    /// Workers replaced after dying.
+    std::size_t restarts() const noexcept { return restarts_.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker {
+        int socket = -1;
+        pid_t pid = -1;
+    };
+
+    Worker spawn();
+    void shutdown() noexcept;
+    std::size_t acquire();
+    void release(std::size_t index, bool dead);
+
+    int zygote_socket_ = -1;
+    pid_t zygote_pid_ = -1;
+    std::mutex spawn_mutex_;
+
+    std::vector<Worker> workers_;
+    std::vector<std::size_t> idle_;
+    std::mutex mutex_;
+    std::condition_variable available_;
+    std::atomic<std::size_t> restarts_{0};
+};
+
+} // namespace rebelflow
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/node.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace rebelflow {
+
+/// What the result cache contributed to one node execution.
+enum class CacheOutcome : std::uint8_t {
+    None, // no cache attached, or the node is impure
+    Hit,
+    Miss,
+};
+
+const char* to_string(CacheOutcome outcome) noexcept;
+
+/// One node execution. Times are measured from the profiler's creation.
+struct NodeProfile {
+    NodeId node = invalid_node;
+    std::shared_ptr<const NodeType> type;
+    /// Pool worker index; the pool size stands for the thread that called run().
+    std::uint32_t thread = 0;
+    std::chrono::nanoseconds start{0};
+    std::chrono::nanoseconds wall{0};
+    /// CPU time of the executing thread while the node ran.
+    std::chrono::nanoseconds cpu{0};
+    /// From the moment the node's last input became available to its start.
+    std::chrono::nanoseconds queue_wait{0};
+    /// Bytes the node allocated on its thread: scratch from its arena plus
+    /// Buffer storage (buffer_bytes_allocated()). Buffers that pool workers
+    /// allocate for it inside parallel loops are not counted.
+    std::size_t bytes_allocated = 0;
+    CacheOutcome cache = CacheOutcome::None;
+    /// The node threw. Its times run up to the failure.
+    bool failed = false;
+};
+
+/// One Executor::run() call.
+struct RunProfile {
+    std::chrono::nanoseconds start{0};
+    std::chrono::nanoseconds wall{0};
+    std::size_t nodes = 0;
+    /// Thread index used for the calling thread (the pool size).
+    std::uint32_t caller_thread = 0;
+    bool failed = false;
+};
+
+/// Collects per-node timings from executors it is attached to (see
+/// Executor::set_profiler()) and exports them as a Chrome trace.
+///
+/// Workers record into per-thread buffers during a run; the executor hands
+/// them over in one batch when the run ends, so profiling adds two clock
+/// reads per node and no shared writes. Records accumulate across runs until
+/// clear().
+///
+/// The trace is the Trace Event JSON format understood by chrome://tracing
+/// and Perfetto: one track per thread, one slice per node execution, named by
+/// node type, with the node id, CPU time, queue wait, bytes allocated, cache
+/// outcome and failure as arguments.
+class Profiler {
+public:
+    Profiler();
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    void clear();
+
+    /// Recorded node executions, ordered by start time.
+    std::vector<NodeProfile> nodes() const;
+    std::vector<RunProfile> runs() const;
+
+    void write_chrome_trace(std::ostream& out) const;
+    /// Throws IoError if the file cannot be written.
+    void save_chrome_trace(const std::string& path) const;
+
+    /// Time since the profiler was created; the clock for every record.
+    std::chrono::nanoseconds now() const noexcept;
+    /// Adds the records of one run. Called by executors.
+    void record_run(const RunProfile& run, std::vector<NodeProfile> nodes);
+
+private:
+    const std::chrono::steady_clock::time_point epoch_;
+    mutable std::mutex mutex_;
+    std::vector<NodeProfile> nodes_;
+    std::vector<RunProfile> runs_;
+};
+
+/// CPU time consumed so far by the calling thread.
+std::chrono::nanoseconds thread_cpu_time() noexcept;
+
+} // namespace rebelflow
@@ -0,0 +1,37 @@
+#pragma once
+
+/// Umbrella header for the RebelFLOW engine.
+
+#include "rebelflow/arena.hpp"
+#include "rebelflow/bounded_queue.hpp"
+#include "rebelflow/brep.hpp"
+#include "rebelflow/buffer.hpp"
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/compiled_plan.hpp"
+#include "rebelflow/cost_model.hpp"
+#include "rebelflow/distributed.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/graph.hpp"
+#include "rebelflow/graph_file.hpp"
+#include "rebelflow/hash.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/mesh_boolean.hpp"
+#include "rebelflow/mesh_io.hpp"
+#include "rebelflow/node.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/loop.hpp"
+#include "rebelflow/nodes/mesh.hpp"
+#include "rebelflow/nodes/script.hpp"
+#include "rebelflow/process_pool.hpp"
+#include "rebelflow/profiler.hpp"
+#include "rebelflow/result_cache.hpp"
+#include "rebelflow/script.hpp"
+#include "rebelflow/serialize.hpp"
+#include "rebelflow/shared_memory.hpp"
+#include "rebelflow/step.hpp"
+#include "rebelflow/stream.hpp"
+#include "rebelflow/subgraph.hpp"
+#include "rebelflow/thread_pool.hpp"
+#include "rebelflow/transport.hpp"
+#include "rebelflow/value.hpp"
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "rebelflow/hash.hpp"
+#include "rebelflow/mapped_file.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rebelflow {
+
+struct ResultCacheStats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t insertions = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t entries = 0;
+    std::uint64_t bytes_used = 0;
+};
+
+/// Content-addressed store of serialized node results, persisted in a single
+/// memory-mapped file of fixed size.
+///
+/// Layout: a header, a fixed table of entry slots (digest, offset, size, last
+/// use) and a data region. Lookups go through an in-memory index rebuilt from
+/// the slot table when the file is opened. When the data region or the slot
+/// table is full, least recently used entries are evicted; if the remaining
+/// free space is fragmented, live entries are slid together first.
+///
+/// Safe to share between threads. The file is locked for exclusive use by
+/// one process. A missing, foreign or differently-sized file is reinitialized:
+/// the cache is disposable by design.
+class ResultCache {
+public:
+    ResultCache(const std::string& path, std::uint64_t capacity_bytes);
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    /// Copies the entry for `key` into `out` and marks it most recently used.
+    bool get(const Digest& key, std::vector<std::byte>& out);
+    bool contains(const Digest& key) const;
+    /// Stores `data` under `key`. Empty entries and entries larger than half
+    /// the data region are not cached. Re-inserting an existing key only
+    /// refreshes it.
+    void put(const Digest& key, std::span<const std::byte> data);
+    void clear();
+    /// Writes dirty pages back to disk.
+    void flush();
+
+    ResultCacheStats stats() const;
+    std::uint64_t capacity() const noexcept { return file_.size(); }
+
+private:
+    struct Header;
+    struct Slot;
+
+    Header& header() noexcept;
+    Slot* slots() noexcept;
+    void initialize();
+    void load_index();
+    void touch(std::uint32_t slot);
+    void evict_lru();
+    void release(std::uint32_t slot);
+    bool find_gap(std::uint64_t size, std::uint64_t& offset) const;
+    void compact();
+
+    MappedFile file_;
+    mutable std::mutex mutex_;
+    std::unordered_map<Digest, std::uint32_t> index_;
+    std::map<std::uint64_t, std::uint32_t> extents_;          // offset -> slot
+    std::set<std::pair<std::uint64_t, std::uint32_t>> lru_;   // (last use, slot)
+    std::vector<std::uint32_t> free_slots_;
+    std::uint64_t data_begin_ = 0;
+    std::uint64_t bytes_used_ = 0;
+    ResultCacheStats stats_;
+};
+
+} // namespace rebelflow
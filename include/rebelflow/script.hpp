@@ -0,0 +1,106 @@
+#pragma once
+
+#include "rebelflow/value.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace rebelflow {
+
+/// What one input of a part is bound to in Script::fuse().
+struct ScriptSource {
+    enum class Kind : std::uint8_t {
+        Input,    // input `index` of the fused script
+        Result,   // result of part `index`, which must come earlier
+        Constant, // `constant`, folded into the code
+    };
+
+    Kind kind = Kind::Input;
+    std::uint32_t index = 0;
+    /// A bool, int or float, or a 3-element float Buffer.
+    Value constant;
+
+    static ScriptSource input(std::uint32_t i) { return {Kind::Input, i, {}}; }
+    static ScriptSource result(std::uint32_t part) { return {Kind::Result, part, {}}; }
+    static ScriptSource constant_value(Value v) { return {Kind::Constant, 0, std::move(v)}; }
+};
+
+/// A small expression language compiled to register-based bytecode.
+///
+/// A script is a list of statements separated by newlines or `;`. Each is an
+/// expression or an assignment `[let] name = expression`; the value of the
+/// last statement is the result:
+///
+///     let d = b - a
+///     length(d) < radius ? 1 : 0
+///
+/// Values are numbers (double) or 3-vectors. Inputs are bound by name and
+/// take a bool, int or float, or a 3-element f32/f64 Buffer as a vector.
+/// Operators: `?:`, `||`, `&&`, comparisons, `+ - * / %`, unary `-` and `!`,
+/// `^` (power) and `.x .y .z`. Functions: abs, sqrt, exp, log, sin, cos,
+/// tan, asin, acos, atan, atan2, floor, ceil, round, pow, min, max, clamp,
+/// lerp, vec, dot, cross, length, normalize. Constants: pi, true, false.
+/// There are no loops; both branches of `?:` are evaluated.
+///
+/// compile() parses the source once into an IR in which operations on
+/// constants are folded and equal subexpressions are a single node. The
+/// bytecode is typed: run() picks the specialization for the number/vector
+/// mix of its inputs, generating it on first use, so the VM loop works on
+/// unboxed doubles and vectors with no type tests or parsing per call.
+/// Assigned names are evaluated once however often they are used; statements
+/// the result does not depend on are dropped.
+class Script {
+public:
+    static constexpr std::size_t max_inputs = 8;
+
+    /// Throws ScriptError with the line and column of the first problem.
+    static Script compile(std::string_view source,
+                          std::vector<std::string> input_names = {"a", "b", "c", "d"});
+
+    Script(Script&&) noexcept;
+    Script& operator=(Script&&) noexcept;
+    ~Script();
+
+    /// Combines several scripts into one program with a result per part,
+    /// each part's first result. Part inputs are bound to inputs of the new
+    /// script, to results of earlier parts or to constants. The parts' IR is
+    /// merged, so constants fold through part boundaries and a subexpression
+    /// that several parts compute is evaluated once. Problems in the result
+    /// are reported as a ScriptError whose part() names the part at fault.
+    /// Throws TypeError for constants that are not numbers or vectors.
+    static Script fuse(std::span<const Script* const> parts,
+                       std::span<const std::vector<ScriptSource>> sources,
+                       std::vector<std::string> input_names);
+
+    const std::vector<std::string>& input_names() const noexcept;
+    /// False for inputs the result does not depend on.
+    bool uses_input(std::size_t index) const noexcept;
+
+    /// Evaluates the script's first result; `inputs` follow input_names().
+    /// Numbers come back as a float Value, vectors as a 3-element f64 Buffer
+    /// with 3 components. Safe to call from several threads. Throws TypeError for unsupported
+    /// input values and ScriptError when an operation does not fit the input
+    /// types (e.g. `dot` of two numbers).
+    Value run(std::span<const Value* const> inputs) const;
+    /// Like run(), for scripts with several results: fills the first
+    /// min(results.size(), result_count()) of `results`.
+    void run_all(std::span<const Value* const> inputs, std::span<Value> results) const;
+    std::size_t result_count() const noexcept;
+
+    /// Bytecode of the specialization for the given input kinds (bit i set:
+    /// input i is a vector), one instruction per line. For debugging.
+    std::string disassemble(unsigned vector_inputs = 0) const;
+
+private:
+    struct State;
+    explicit Script(std::unique_ptr<State> state) noexcept;
+
+    std::unique_ptr<State> state_;
+};
+
+} // namespace rebelflow
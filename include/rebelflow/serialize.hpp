@@ -0,0 +1,111 @@
+#pragma once
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/hash.hpp"
+#include "rebelflow/value.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace rebelflow {
+
+static_assert(std::endian::native == std::endian::little,
+              "serialized formats are little-endian and written with memcpy");
+
+/// Append-only little-endian byte sink.
+class ByteWriter {
+public:
+    void write(const void* data, std::size_t size) {
+        const std::size_t at = bytes_.size();
+        bytes_.resize(at + size);
+        if (size > 0) {
+            std::memcpy(bytes_.data() + at, data, size);
+        }
+    }
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    void write_pod(const T& v) {
+        write(&v, sizeof v);
+    }
+
+    void write_u8(std::uint8_t v) { write_pod(v); }
+    void write_u32(std::uint32_t v) { write_pod(v); }
+    void write_u64(std::uint64_t v) { write_pod(v); }
+    void write_f64(double v) { write_pod(v); }
+    /// u32 length followed by the bytes.
+    void write_string(std::string_view s);
+    /// Zero padding up to the next multiple of `alignment` from the start.
+    void align(std::size_t alignment);
+
+    std::size_t size() const noexcept { return bytes_.size(); }
+    const std::vector<std::byte>& bytes() const noexcept { return bytes_; }
+    std::vector<std::byte> take() noexcept { return std::move(bytes_); }
+
+private:
+    std::vector<std::byte> bytes_;
+};
+
+/// Bounds-checked reader over a byte span. Throws FormatError on overrun.
+///
+/// When constructed with an `owner` that keeps the bytes alive (a mapped
+/// file, a shared-memory segment), buffers are read as zero-copy views into
+/// the span instead of being copied out.
+class ByteReader {
+public:
+    explicit ByteReader(std::span<const std::byte> bytes,
+                        std::shared_ptr<const void> owner = nullptr) noexcept
+        : bytes_(bytes), owner_(std::move(owner)) {}
+
+    void read(void* out, std::size_t size);
+    /// Returns the next `size` bytes without copying them.
+    std::span<const std::byte> read_span(std::size_t size);
+
+    template <typename T>
+        requires std::is_trivially_copyable_v<T>
+    T read_pod() {
+        T v;
+        read(&v, sizeof v);
+        return v;
+    }
+
+    std::uint8_t read_u8() { return read_pod<std::uint8_t>(); }
+    std::uint32_t read_u32() { return read_pod<std::uint32_t>(); }
+    std::uint64_t read_u64() { return read_pod<std::uint64_t>(); }
+    double read_f64() { return read_pod<double>(); }
+    std::string read_string();
+
+    /// Skips padding up to the next multiple of `alignment` from the start.
+    void align(std::size_t alignment);
+
+    std::size_t position() const noexcept { return pos_; }
+    std::size_t remaining() const noexcept { return bytes_.size() - pos_; }
+    bool at_end() const noexcept { return pos_ == bytes_.size(); }
+    const std::shared_ptr<const void>& owner() const noexcept { return owner_; }
+
+private:
+    std::span<const std::byte> bytes_;
+    std::shared_ptr<const void> owner_;
+    std::size_t pos_ = 0;
+};
+
+/// Values serialize as a type tag followed by the payload; a mesh, bvh or brep
+/// as its arrays in turn (a brep without its tessellations). Buffer payloads are 8-byte aligned relative to the
+/// start of the stream so that readers over suitably aligned memory can wrap
+/// them in place.
+void write_value(ByteWriter& out, const Value& value);
+Value read_value(ByteReader& in);
+
+/// Feeds the type and content of `value` into `hasher`. Equal values hash
+/// equally; an int and a float with the same numeric value do not.
+void hash_value(Hasher& hasher, const Value& value);
+
+} // namespace rebelflow
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "rebelflow/buffer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace rebelflow {
+
+/// An anonymous shared-memory segment (a memfd on Linux), mapped read-write.
+///
+/// The descriptor can be handed to another process, which maps the same
+/// pages with attach(); nothing is copied. Every live segment is indexed by
+/// address, so find() tells whether some memory, a Buffer's elements for
+/// instance, can be shared by reference. The segment is unmapped and its
+/// descriptor closed when the last reference goes. Errors throw IoError.
+class SharedSegment {
+public:
+    /// A new zero-filled segment of `size` bytes. Pages cost memory only
+    /// once written.
+    static std::shared_ptr<SharedSegment> create(std::size_t size);
+    /// Maps the whole of a segment received from another process, taking
+    /// ownership of `fd`.
+    static std::shared_ptr<SharedSegment> attach(int fd);
+
+    ~SharedSegment();
+
+    SharedSegment(const SharedSegment&) = delete;
+    SharedSegment& operator=(const SharedSegment&) = delete;
+
+    std::byte* data() const noexcept { return data_; }
+    /// Size of the segment; truncate() may lower it below the mapping.
+    std::size_t size() const noexcept { return size_; }
+    int fd() const noexcept { return fd_; }
+
+    /// Shrinks the segment to `size` bytes, returning the pages past it.
+    /// The mapping stays; nothing past `size` may be touched afterwards.
+    void truncate(std::size_t size);
+
+    /// The live segment holding [data, data + bytes), with the offset of
+    /// `data` in it, or a null segment.
+    struct Location {
+        std::shared_ptr<const SharedSegment> segment;
+        std::size_t offset = 0;
+    };
+    static Location find(const void* data, std::size_t bytes);
+
+private:
+    SharedSegment(int fd, std::byte* data, std::size_t size) noexcept;
+
+    int fd_;
+    std::byte* data_;
+    std::size_t mapped_;
+    std::size_t size_;
+};
+
+/// A BufferAllocator that bump-allocates from shared segments, so buffers
+/// it backs can be passed to another process by reference.
+///
+/// Each segment reserves `reserve` bytes of address space (more for larger
+/// requests) but only the pages written are backed. seal() gives back the
+/// unused tail of the current segment; later allocations open a new one.
+/// The destructor seals too. Buffers keep their segment alive on their own,
+/// so an arena can be dropped while its buffers are still in use.
+class SharedArena final : public BufferAllocator {
+public:
+    explicit SharedArena(std::size_t reserve = std::size_t{1} << 30) noexcept
+        : reserve_(reserve) {}
+    ~SharedArena() override;
+
+    std::shared_ptr<std::byte> allocate(std::size_t bytes) override;
+    void seal();
+
+private:
+    std::size_t reserve_;
+    std::shared_ptr<SharedSegment> current_;
+    std::size_t used_ = 0;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "rebelflow/brep.hpp"
+
+#include <string>
+
+namespace rebelflow {
+
+class ThreadPool;
+
+/// Reads the solids and sheets of a STEP file (ISO 10303-21; AP203, AP214
+/// or AP242 B-rep geometry) into a Brep, without tessellating anything.
+///
+/// Every MANIFOLD_SOLID_BREP, FACETED_BREP, BREP_WITH_VOIDS and
+/// SHELL_BASED_SURFACE_MODEL is a shape, and each place the assembly
+/// structure puts it a body: representation relationships with an item
+/// defined transformation and mapped items place a representation in its
+/// parent's, and the paths from a shape up to the roots give its bodies'
+/// transforms. A body is named after the product of its representation, or
+/// failing that after its own entity. Surfaces and curves of kinds Brep
+/// does not evaluate are kept as unsupported; coordinates are in the file's
+/// length unit, and plane angles in degrees are converted to radians.
+///
+/// The file is mapped and split into records in one pass; the records are
+/// then parsed, and the shapes decoded, in parallel. Throws IoError if the
+/// file cannot be read and FormatError, with the line, if it is malformed.
+Brep read_step(const std::string& path, ThreadPool* pool = nullptr);
+
+} // namespace rebelflow
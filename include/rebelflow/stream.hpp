@@ -0,0 +1,68 @@
+#pragma once
+
+#include "rebelflow/graph.hpp"
+#include "rebelflow/value.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace rebelflow {
+
+struct StreamOptions {
+    /// Chunks allowed between the source and the sinks at any moment. The
+    /// source blocks once this many are outstanding, so peak memory is about
+    /// `max_in_flight` chunks no matter how large the data set is.
+    std::size_t max_in_flight = 8;
+    /// Threads evaluating per-chunk nodes; 0 means hardware concurrency.
+    unsigned workers = 0;
+};
+
+struct StreamStats {
+    std::size_t chunks = 0;
+    /// Largest number of chunks that were outstanding at once.
+    std::size_t peak_in_flight = 0;
+    std::chrono::nanoseconds wall_time{0};
+};
+
+/// Evaluates a graph as a pipeline over a chunked data set.
+///
+/// The graph must contain exactly one node whose type has a source role
+/// (NodeType::open_source). Every node is placed in one of four phases:
+///
+/// - before: not downstream of the source; evaluated once, up front.
+/// - per chunk: downstream of the source and not a sink; evaluated once for
+///   every chunk, with the chunk flowing in place of the source's output.
+/// - sink: a node with a sink role (NodeType::open_sink) that has exactly one
+///   streamed input; it consumes the per-chunk values in stream order and
+///   produces its outputs when the stream ends.
+/// - after: downstream of a sink; evaluated once, after the stream.
+///
+/// The source runs on its own thread and hands chunks through bounded queues
+/// to `workers` threads that evaluate the per-chunk nodes, chunks in
+/// parallel. The calling thread feeds the sinks, restoring stream order.
+/// Backpressure is end to end: at most `max_in_flight` chunks exist between
+/// the source and the sinks, so a slow sink stalls the source instead of
+/// buffering without bound.
+///
+/// Outputs of before, sink and after nodes can be read with output() once
+/// run() returns; per-chunk values are not kept.
+class StreamExecutor {
+public:
+    explicit StreamExecutor(StreamOptions options = {});
+
+    /// Streams the source through the graph. Throws GraphError for graphs that
+    /// cannot be streamed and ExecutionError if a node fails; the pipeline is
+    /// then shut down and no outputs are valid.
+    StreamStats run(const Graph& graph);
+
+    const Value& output(PortRef port) const;
+    const Value& output(NodeId node, std::uint32_t port = 0) const { return output({node, port}); }
+
+private:
+    StreamOptions options_;
+    std::vector<std::vector<Value>> outputs_; // by node id; empty when not kept
+};
+
+} // namespace rebelflow
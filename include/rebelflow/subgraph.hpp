@@ -0,0 +1,79 @@
+#pragma once
+
+#include "rebelflow/compiled_plan.hpp"
+#include "rebelflow/graph.hpp"
+#include "rebelflow/node.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+
+namespace rebelflow {
+
+/// Registers the placeholder nodes that mark a sub-graph's interface:
+///
+/// - `SubgraphInput`: emits its `value` parameter. Inside a sub-graph body it
+///   stands for the input port called `name`, with `value` as the port's
+///   default; each evaluation sets `value` to what the instance receives.
+/// - `SubgraphOutput`: passes `value` through. Inside a body it is the output
+///   port called `name`.
+///
+/// Both are ordinary nodes outside a body. Required by collapse() and by
+/// graph files holding sub-graph bodies.
+void register_subgraph_nodes(NodeRegistry& registry);
+
+struct SubgraphOptions {
+    /// Plan options for the body. Its `outputs` are set to the body's
+    /// SubgraphOutput nodes, so nodes that feed no output are never compiled.
+    PlanOptions plan;
+    /// Results remembered per distinct set of input values, across all
+    /// instances; 0 disables it. Only used when every body node is pure.
+    std::size_t memo_entries = 1024;
+};
+
+/// A node type that evaluates `body`: a macro node.
+///
+/// The type's ports are the body's SubgraphInput and SubgraphOutput nodes in
+/// id order. Every instance of the type shares the body graph and one
+/// CompiledPlan of it, compiled on the first evaluation; concurrent
+/// evaluations run forks of that plan, so instancing a macro a thousand
+/// times costs a thousand nodes, not a thousand graphs or plans.
+///
+/// Instances also share one result namespace. The type is pure when every
+/// body node is, and its `version` is derived from the body's contents, so
+/// instances with equal inputs share ResultCache entries, and an edited
+/// body never matches results of the old one. On top of that, results are
+/// memoized in memory by a digest of the input values (see
+/// SubgraphOptions::memo_entries).
+///
+/// Register the result with NodeRegistry::add(). Bodies can come straight
+/// from GraphFile::graph(). Throws GraphError if the body is invalid, has no
+/// SubgraphOutput, or repeats a port name.
+NodeType subgraph_type(std::string name,
+                       std::shared_ptr<const Graph> body,
+                       const SubgraphOptions& options = {});
+
+struct CollapseResult {
+    /// The node that replaced the collapsed ones.
+    NodeId node = invalid_node;
+    std::shared_ptr<const NodeType> type;
+};
+
+/// Replaces `nodes` in `graph` by one instance of a new sub-graph type named
+/// `type_name`, registered in `registry`.
+///
+/// The body holds copies of the nodes and the edges between them. Each
+/// distinct outside output feeding the group becomes a SubgraphInput and each
+/// group output read outside it a SubgraphOutput, named after the port it
+/// replaces. The instance is wired in place of the group. Requires
+/// register_subgraph_nodes(). Throws GraphError, leaving the graph unchanged,
+/// for unknown or repeated nodes or when collapsing would create a cycle
+/// (a path leaves the group and comes back into it).
+CollapseResult collapse(Graph& graph,
+                        std::span<const NodeId> nodes,
+                        NodeRegistry& registry,
+                        std::string type_name,
+                        const SubgraphOptions& options = {});
+
+} // namespace rebelflow
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rebelflow {
+
+using Task = std::function<void()>;
+
+/// Fixed-size work-stealing thread pool.
+///
+/// Each worker owns a deque: tasks submitted from a worker go to the back of
+/// its own deque and are popped LIFO (hot caches, depth-first descent), while
+/// idle workers steal FIFO from the front of other deques (oldest, usually
+/// largest, pieces of work). Tasks submitted from outside the pool go to a
+/// shared injection queue.
+class ThreadPool {
+public:
+    /// `threads == 0` means one worker per hardware thread.
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const noexcept { return static_cast<unsigned>(workers_.size()); }
+
+    void submit(Task task);
+
+    /// Runs one queued task on the calling thread if any is available.
+    /// Lets threads that wait on pool work help instead of blocking.
+    bool run_one();
+
+    /// Index of the calling worker in this pool, or -1 from any other thread.
+    int current_worker() const noexcept;
+
+private:
+    struct alignas(64) WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void worker_loop(unsigned index);
+    bool pop_task(int self, Task& out);
+    bool steal_task(unsigned start, Task& out);
+
+    std::vector<std::unique_ptr<WorkQueue>> queues_;
+    WorkQueue injector_;
+    std::vector<std::thread> workers_;
+
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<unsigned> sleepers_{0};
+    std::atomic<bool> stopping_{false};
+    std::mutex sleep_mutex_;
+    std::condition_variable wake_;
+};
+
+/// A set of tasks that can be waited on as a unit. The first exception thrown
+/// by any task is captured and rethrown from wait().
+///
+/// wait() called from a pool worker keeps executing queued tasks, so nested
+/// parallelism (a node that itself fans out onto the pool) cannot deadlock.
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) noexcept : pool_(pool) {}
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(Task task);
+    void wait();
+
+    ThreadPool& pool() const noexcept { return pool_; }
+
+private:
+    void finish_one() noexcept;
+
+    ThreadPool& pool_;
+    std::atomic<std::size_t> outstanding_{0};
+    std::mutex mutex_;
+    std::condition_variable done_;
+    std::exception_ptr error_;
+};
+
+/// Calls `body(begin, end)` for consecutive ranges covering 0 .. count - 1,
+/// as tasks of one TaskGroup on `pool`. Ranges hold at least `grain` indices
+/// (except the last) and are few enough to keep task overhead small. Runs
+/// inline when `pool` is null or one range covers everything. Rethrows the
+/// first exception a range throws.
+void parallel_for(ThreadPool* pool,
+                  std::size_t count,
+                  std::size_t grain,
+                  const std::function<void(std::size_t begin, std::size_t end)>& body);
+
+} // namespace rebelflow
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace rebelflow {
+
+/// A connected stream socket carrying length-prefixed messages.
+///
+/// Addresses are `unix:PATH` for a UNIX-domain socket or `tcp:HOST:PORT` for
+/// TCP (port 0 on a Listener picks a free one). An empty HOST means loopback;
+/// listening on other interfaces takes an explicit host such as `0.0.0.0`.
+/// Messages are limited to 1 GiB. Move-only; closes on destruction. Errors
+/// throw IoError.
+class Connection {
+public:
+    Connection() noexcept = default;
+    explicit Connection(int fd) noexcept : fd_(fd) {}
+    ~Connection();
+
+    Connection(Connection&& other) noexcept;
+    Connection& operator=(Connection&& other) noexcept;
+    Connection(const Connection&) = delete;
+    Connection& operator=(const Connection&) = delete;
+
+    static Connection connect(const std::string& address);
+
+    bool is_open() const noexcept { return fd_ >= 0; }
+
+    /// Sends one message.
+    void send(std::span<const std::byte> message);
+    /// Receives one message into `message`. Returns false if the peer closed
+    /// the connection between messages.
+    bool receive(std::vector<std::byte>& message);
+
+    /// Bytes sent and received so far, framing included.
+    std::size_t bytes_sent() const noexcept { return sent_; }
+    std::size_t bytes_received() const noexcept { return received_; }
+
+    void close() noexcept;
+
+private:
+    int fd_ = -1;
+    std::size_t sent_ = 0;
+    std::size_t received_ = 0;
+};
+
+/// A listening socket; see Connection for addresses.
+class Listener {
+public:
+    Listener() noexcept = default;
+    ~Listener();
+
+    Listener(Listener&& other) noexcept;
+    Listener& operator=(Listener&& other) noexcept;
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    /// Binds and listens. A stale UNIX socket at the path is replaced; one
+    /// that another process still listens on, or any other file, is an
+    /// error.
+    static Listener bind(const std::string& address);
+
+    /// The address to connect to, with the port filled in for `tcp:HOST:0`.
+    const std::string& address() const noexcept { return address_; }
+
+    /// Waits for the next connection. Returns a closed Connection once the
+    /// listener has been shut down.
+    Connection accept();
+
+    /// Makes pending and future accept() calls return; callable from any
+    /// thread.
+    void shutdown() noexcept;
+
+private:
+    void close() noexcept;
+
+    int fd_ = -1;
+    std::string address_;
+    std::string unix_path_;
+};
+
+} // namespace rebelflow
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "rebelflow/buffer.hpp"
+
+#include <concepts>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <variant>
+
+namespace rebelflow {
+
+class Brep;
+class Bvh;
+class Mesh;
+
+/// Type tag shared by values and ports. `Any` is only meaningful on ports.
+enum class DataType : std::uint8_t {
+    Any,
+    None,
+    Bool,
+    Int,
+    Float,
+    String,
+    Buffer,
+    Mesh,
+    Bvh,
+    Brep,
+};
+
+const char* to_string(DataType type) noexcept;
+
+/// True if a value of type `from` may flow into a port of type `to`.
+/// Ints widen to floats; `Any` on either side accepts everything.
+bool is_convertible(DataType from, DataType to) noexcept;
+
+/// A dynamically typed value carried on edges and stored in parameters.
+/// Large data travels as a Buffer, Mesh, Bvh or Brep, so copying a Value never
+/// deep-copies it. Geometry is held by shared handle, so that this header
+/// does not pull in the geometry headers.
+class Value {
+public:
+    Value() noexcept = default;
+    Value(bool v) noexcept : data_(v) {}
+    template <std::integral T>
+        requires(!std::same_as<T, bool>)
+    Value(T v) noexcept : data_(static_cast<std::int64_t>(v)) {}
+    template <std::floating_point T>
+    Value(T v) noexcept : data_(static_cast<double>(v)) {}
+    Value(std::string v) noexcept : data_(std::move(v)) {}
+    Value(const char* v) : data_(std::string(v)) {}
+    Value(Buffer v) noexcept : data_(std::move(v)) {}
+    Value(Mesh v);
+    Value(Bvh v);
+    Value(Brep v);
+
+    DataType type() const noexcept;
+    bool is_null() const noexcept { return data_.index() == 0; }
+
+    /// Accessors throw TypeError on mismatch. `as_float` also accepts ints.
+    bool as_bool() const;
+    std::int64_t as_int() const;
+    double as_float() const;
+    const std::string& as_string() const;
+    const Buffer& as_buffer() const;
+    const Mesh& as_mesh() const;
+    const Bvh& as_bvh() const;
+    const Brep& as_brep() const;
+
+    /// Human-readable rendering, used in diagnostics and the CLI.
+    std::string to_string() const;
+
+    /// Geometry compares by content, like buffers.
+    friend bool operator==(const Value& a, const Value& b);
+
+private:
+    std::variant<std::monostate, bool, std::int64_t, double, std::string, Buffer,
+                 std::shared_ptr<const Mesh>, std::shared_ptr<const Bvh>,
+                 std::shared_ptr<const Brep>>
+        data_;
+};
+
+} // namespace rebelflow
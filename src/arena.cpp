@@ -0,0 +1,83 @@
+#include "rebelflow/arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace rebelflow {
+
+namespace {
+
+constexpr std::size_t chunk_alignment = alignof(std::max_align_t);
+
+std::byte* align_up(std::byte* p, std::size_t alignment) noexcept {
+    const auto v = reinterpret_cast<std::uintptr_t>(p);
+    return p + ((alignment - v % alignment) % alignment);
+}
+
+} // namespace
+
+Arena::Arena(std::size_t initial_capacity)
+    : next_chunk_size_(std::max<std::size_t>(initial_capacity, 256)) {}
+
+Arena::~Arena() {
+    free_chunks();
+}
+
+void Arena::free_chunks() noexcept {
+    while (head_ != nullptr) {
+        Chunk* next = head_->next;
+        ::operator delete(head_, std::align_val_t{chunk_alignment});
+        head_ = next;
+    }
+    cursor_ = end_ = nullptr;
+    reserved_ = 0;
+}
+
+void Arena::add_chunk(std::size_t min_size) {
+    const std::size_t size = std::max(min_size, next_chunk_size_);
+    void* raw = ::operator new(sizeof(Chunk) + size, std::align_val_t{chunk_alignment});
+    auto* chunk = static_cast<Chunk*>(raw);
+    chunk->next = head_;
+    chunk->size = size;
+    head_ = chunk;
+    cursor_ = reinterpret_cast<std::byte*>(chunk + 1);
+    end_ = cursor_ + size;
+    reserved_ += size;
+    next_chunk_size_ = size * 2;
+}
+
+void* Arena::do_allocate(std::size_t bytes, std::size_t alignment) {
+    std::byte* p = cursor_ != nullptr ? align_up(cursor_, alignment) : nullptr;
+    if (p == nullptr || p + bytes > end_) {
+        add_chunk(bytes + alignment);
+        p = align_up(cursor_, alignment);
+    }
+    allocated_ += static_cast<std::size_t>(p + bytes - cursor_);
+    cursor_ = p + bytes;
+    return p;
+}
+
+void Arena::reset() noexcept {
+    if (head_ != nullptr && head_->next == nullptr) {
+        // Single chunk: just rewind.
+        cursor_ = reinterpret_cast<std::byte*>(head_ + 1);
+        end_ = cursor_ + head_->size;
+        allocated_ = 0;
+        return;
+    }
+    // Several chunks: replace them with one block covering the whole
+    // footprint so the next round fits without growing.
+    const std::size_t footprint = reserved_;
+    free_chunks();
+    allocated_ = 0;
+    if (footprint > 0) {
+        next_chunk_size_ = footprint;
+        try {
+            add_chunk(footprint);
+        } catch (const std::bad_alloc&) {
+            // Stay empty; the next allocation grows from scratch.
+        }
+    }
+}
+
+} // namespace rebelflow
@@ -0,0 +1,2119 @@
+#include "rebelflow/brep.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numbers>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rebelflow {
+
+namespace {
+
+using Vec2 = std::array<double, 2>;
+using Vec3 = std::array<double, 3>;
+using SurfaceKind = Brep::SurfaceKind;
+using CurveKind = Brep::CurveKind;
+
+constexpr std::uint32_t invalid = Brep::invalid;
+constexpr double pi = std::numbers::pi;
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+/// B-spline degrees above this are rejected, which bounds the basis arrays.
+constexpr std::size_t max_degree = 15;
+/// Control points in either direction of a B-spline.
+constexpr double max_control_points = 1 << 20;
+/// Arcs are cut into steps of at most this angle however large the
+/// tolerance, and at least this one however small.
+constexpr double max_angle_step = pi / 4;
+constexpr double min_angle_step = 2 * pi / 4096;
+/// Pieces a B-spline span or a seam is cut into at most.
+constexpr double max_pieces = 4096;
+/// Points put inside a face at most; beyond it they are spread thinner.
+constexpr double max_interior_points = 1 << 18;
+/// Triangulations name face-local vertices (interior points, poles, seam
+/// points) with this bit set, shape vertices without.
+constexpr std::uint32_t local_vertex = std::uint32_t{1} << 31;
+
+Vec3 sub(const Vec3& a, const Vec3& b) noexcept {
+    return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+Vec3 add_scaled(const Vec3& a, const Vec3& d, double t) noexcept {
+    return {a[0] + d[0] * t, a[1] + d[1] * t, a[2] + d[2] * t};
+}
+double dot(const Vec3& a, const Vec3& b) noexcept {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+double norm(const Vec3& a) noexcept {
+    return std::sqrt(dot(a, a));
+}
+double distance(const Vec3& a, const Vec3& b) noexcept {
+    return norm(sub(a, b));
+}
+Vec3 load3(const double* p) noexcept {
+    return {p[0], p[1], p[2]};
+}
+
+/// Twice the signed area of triangle abc, positive if counterclockwise.
+double orient(const Vec2& a, const Vec2& b, const Vec2& c) noexcept {
+    return (b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]);
+}
+
+/// The parameter step that keeps the chords of a circle of `radius` within
+/// `tolerance` of it.
+double angle_step(double radius, double tolerance) noexcept {
+    if (!(radius > tolerance)) {
+        return max_angle_step;
+    }
+    return std::clamp(2 * std::acos(1 - tolerance / radius), min_angle_step, max_angle_step);
+}
+
+/// `a` moved by whole periods to within half a period of `near`.
+double unwrap(double a, double near, double period) noexcept {
+    return period > 0 ? a + std::round((near - a) / period) * period : a;
+}
+
+bool whole(double d, double low, double high) noexcept {
+    return d >= low && d <= high && d == std::floor(d);
+}
+
+// ---- parameter layouts ----------------------------------------------------
+
+/// Checks a knot vector of `count` + `degree` + 1 entries.
+bool knots_ok(const double* knots, std::size_t degree, std::size_t count) noexcept {
+    for (std::size_t i = 0; i < count + degree + 1; ++i) {
+        if (!std::isfinite(knots[i]) || (i > 0 && knots[i] < knots[i - 1])) {
+            return false;
+        }
+    }
+    return knots[degree] < knots[count];
+}
+
+/// How many parameters a surface of `kind` takes from `p`, of which
+/// `available` are left; 0 if they do not fit or its B-spline header is out
+/// of range.
+std::size_t surface_size(SurfaceKind kind, const double* p, std::size_t available) noexcept {
+    std::size_t size = 0;
+    switch (kind) {
+    case SurfaceKind::Plane: size = 12; break;
+    case SurfaceKind::Cylinder: size = 13; break;
+    case SurfaceKind::Cone: size = 14; break;
+    case SurfaceKind::Sphere: size = 13; break;
+    case SurfaceKind::Torus: size = 14; break;
+    case SurfaceKind::Unsupported: return 0;
+    case SurfaceKind::BSpline: {
+        if (available < 4 || !whole(p[0], 1, max_degree) || !whole(p[1], 1, max_degree) ||
+            !whole(p[2], p[0] + 1, max_control_points) ||
+            !whole(p[3], p[1] + 1, max_control_points)) {
+            return 0;
+        }
+        const auto du = static_cast<std::size_t>(p[0]);
+        const auto dv = static_cast<std::size_t>(p[1]);
+        const auto nu = static_cast<std::size_t>(p[2]);
+        const auto nv = static_cast<std::size_t>(p[3]);
+        size = 4 + (nu + du + 1) + (nv + dv + 1) + 4 * nu * nv;
+        if (size > available || !knots_ok(p + 4, du, nu) || !knots_ok(p + 5 + nu + du, dv, nv)) {
+            return 0;
+        }
+        return size;
+    }
+    }
+    return size <= available ? size : 0;
+}
+
+std::size_t curve_size(CurveKind kind, const double* p, std::size_t available) noexcept {
+    std::size_t size = 0;
+    switch (kind) {
+    case CurveKind::Line: size = 6; break;
+    case CurveKind::Circle: size = 13; break;
+    case CurveKind::Ellipse: size = 14; break;
+    case CurveKind::Unsupported: return 0;
+    case CurveKind::BSpline: {
+        if (available < 2 || !whole(p[0], 1, max_degree) ||
+            !whole(p[1], p[0] + 1, max_control_points)) {
+            return 0;
+        }
+        const auto d = static_cast<std::size_t>(p[0]);
+        const auto n = static_cast<std::size_t>(p[1]);
+        size = 2 + (n + d + 1) + 4 * n;
+        return size <= available && knots_ok(p + 2, d, n) ? size : 0;
+    }
+    }
+    return size <= available ? size : 0;
+}
+
+// ---- evaluation -------------------------------------------------------------
+
+struct Frame {
+    Vec3 origin;
+    Vec3 x;
+    Vec3 y;
+    Vec3 z;
+
+    explicit Frame(const double* p) noexcept
+        : origin(load3(p)), x(load3(p + 3)), y(load3(p + 6)), z(load3(p + 9)) {}
+
+    Vec3 at(double a, double b, double c) const noexcept {
+        Vec3 p = add_scaled(origin, x, a);
+        p = add_scaled(p, y, b);
+        return add_scaled(p, z, c);
+    }
+    Vec3 local(const Vec3& p) const noexcept {
+        const Vec3 d = sub(p, origin);
+        return {dot(d, x), dot(d, y), dot(d, z)};
+    }
+};
+
+/// The basis functions of one B-spline direction.
+struct Basis {
+    std::size_t degree = 0;
+    std::size_t count = 0;
+    const double* knots = nullptr;
+
+    Basis() = default;
+    Basis(const double* header_degree, const double* header_count, const double* k) noexcept
+        : degree(static_cast<std::size_t>(*header_degree)),
+          count(static_cast<std::size_t>(*header_count)), knots(k) {}
+
+    double first() const noexcept { return knots[degree]; }
+    double last() const noexcept { return knots[count]; }
+
+    /// The span of `t`, clamped to the domain, with the degree + 1 nonzero
+    /// basis values there (The NURBS Book, A2.2). Control point
+    /// span - degree + i goes with values[i].
+    std::size_t evaluate(double t, double* values) const noexcept {
+        t = std::clamp(t, first(), last());
+        const double* it = std::upper_bound(knots + degree, knots + count, t);
+        const std::size_t span = static_cast<std::size_t>(it - knots) - 1;
+        std::array<double, max_degree + 1> left{};
+        std::array<double, max_degree + 1> right{};
+        values[0] = 1;
+        for (std::size_t j = 1; j <= degree; ++j) {
+            left[j] = t - knots[span + 1 - j];
+            right[j] = knots[span + j] - t;
+            double saved = 0;
+            for (std::size_t r = 0; r < j; ++r) {
+                const double denominator = right[r + 1] + left[j - r];
+                const double temp = denominator != 0 ? values[r] / denominator : 0;
+                values[r] = saved + right[r + 1] * temp;
+                saved = left[j - r] * temp;
+            }
+            values[j] = saved;
+        }
+        return span;
+    }
+};
+
+class Curve {
+public:
+    Curve(CurveKind kind, const double* p) noexcept : kind_(kind), p_(p) {
+        if (kind == CurveKind::BSpline) {
+            basis_ = Basis(p, p + 1, p + 2);
+            points_ = p + 2 + basis_.count + basis_.degree + 1;
+        }
+    }
+
+    CurveKind kind() const noexcept { return kind_; }
+
+    Vec3 at(double t) const noexcept {
+        switch (kind_) {
+        case CurveKind::Line: return add_scaled(load3(p_), load3(p_ + 3), t);
+        case CurveKind::Circle: return Frame(p_).at(p_[12] * std::cos(t), p_[12] * std::sin(t), 0);
+        case CurveKind::Ellipse:
+            return Frame(p_).at(p_[12] * std::cos(t), p_[13] * std::sin(t), 0);
+        case CurveKind::BSpline: {
+            std::array<double, max_degree + 1> n{};
+            const std::size_t span = basis_.evaluate(t, n.data());
+            Vec3 sum{0, 0, 0};
+            double weight = 0;
+            for (std::size_t i = 0; i <= basis_.degree; ++i) {
+                const double* q = points_ + 4 * (span - basis_.degree + i);
+                const double w = n[i] * q[3];
+                sum = add_scaled(sum, load3(q), w);
+                weight += w;
+            }
+            return {sum[0] / weight, sum[1] / weight, sum[2] / weight};
+        }
+        case CurveKind::Unsupported: break;
+        }
+        return {0, 0, 0};
+    }
+
+    /// The parameter of a point on the curve.
+    double parameter(const Vec3& x) const noexcept {
+        switch (kind_) {
+        case CurveKind::Line: return dot(sub(x, load3(p_)), load3(p_ + 3));
+        case CurveKind::Circle:
+        case CurveKind::Ellipse: {
+            const Vec3 l = Frame(p_).local(x);
+            const double b = kind_ == CurveKind::Circle ? p_[12] : p_[13];
+            return std::atan2(l[1] / b, l[0] / p_[12]);
+        }
+        case CurveKind::BSpline: return spline_parameter(x);
+        case CurveKind::Unsupported: break;
+        }
+        return 0;
+    }
+
+    /// Points strictly between `start` and `end` along the curve, `forward`
+    /// along its direction or against it, within `tolerance` of it.
+    /// `closed` if the edge goes all the way round.
+    std::vector<Vec3> sample(const Vec3& start, const Vec3& end, bool closed, bool forward,
+                             double tolerance) const {
+        std::vector<Vec3> points;
+        switch (kind_) {
+        case CurveKind::Line:
+        case CurveKind::Unsupported: break;
+        case CurveKind::Circle:
+        case CurveKind::Ellipse: {
+            const double t0 = parameter(start);
+            double sweep = 2 * pi;
+            if (!closed) {
+                sweep = std::fmod(forward ? parameter(end) - t0 : t0 - parameter(end), 2 * pi);
+                sweep += sweep < 0 ? 2 * pi : 0;
+                // An arc that ends where it starts only by rounding.
+                if (sweep < 1e-12 || sweep > 2 * pi - 1e-12) {
+                    break;
+                }
+            }
+            // The tightest bend of an ellipse has radius b^2 / a.
+            const double a = p_[12];
+            const double b = kind_ == CurveKind::Circle ? a : p_[13];
+            const double radius = std::min(a, b) * std::min(a, b) / std::max(a, b);
+            const double step = angle_step(radius, tolerance);
+            const auto pieces = static_cast<std::size_t>(std::ceil(sweep / step));
+            const double delta = (forward ? sweep : -sweep) / static_cast<double>(pieces);
+            for (std::size_t i = 1; i < pieces; ++i) {
+                points.push_back(at(t0 + delta * static_cast<double>(i)));
+            }
+            break;
+        }
+        case CurveKind::BSpline: {
+            double t0 = closed ? basis_.first() : parameter(start);
+            double t1 = closed ? basis_.last() : parameter(end);
+            if (closed && !forward) {
+                std::swap(t0, t1);
+            }
+            // Each knot span is cut by the largest second difference
+            // found across it: a parabola bent that much strays
+            // h^2 M / 8 from its chord.
+            std::vector<double> breaks = {t0};
+            const auto [low, high] = std::minmax(t0, t1);
+            for (std::size_t k = basis_.degree + 1; k < basis_.count; ++k) {
+                if (basis_.knots[k] > low && basis_.knots[k] < high &&
+                    basis_.knots[k] != basis_.knots[k - 1]) {
+                    breaks.push_back(basis_.knots[k]);
+                }
+            }
+            if (t1 < t0) {
+                std::reverse(breaks.begin() + 1, breaks.end());
+            }
+            breaks.push_back(t1);
+            for (std::size_t s = 0; s + 1 < breaks.size(); ++s) {
+                const double a = breaks[s];
+                const double h = (breaks[s + 1] - a) / 4;
+                double bend = 0;
+                for (int i = 1; i < 4; ++i) {
+                    const Vec3 before = at(a + h * (i - 1));
+                    const Vec3 here = at(a + h * i);
+                    const Vec3 after = at(a + h * (i + 1));
+                    const Vec3 second = {before[0] - 2 * here[0] + after[0],
+                                         before[1] - 2 * here[1] + after[1],
+                                         before[2] - 2 * here[2] + after[2]};
+                    bend = std::max(bend, norm(second) / (h * h));
+                }
+                const double pieces = std::clamp(
+                    std::ceil(std::abs(4 * h) * std::sqrt(bend / (8 * tolerance))), 1.0,
+                    max_pieces);
+                if (s > 0) {
+                    points.push_back(at(a));
+                }
+                for (double i = 1; i < pieces; ++i) {
+                    points.push_back(at(a + 4 * h * i / pieces));
+                }
+            }
+            break;
+        }
+        }
+        return points;
+    }
+
+private:
+    double spline_parameter(const Vec3& x) const noexcept {
+        // The closest of a few samples per span, then Newton steps on
+        // (C(t) - x) . C'(t).
+        const double first = basis_.first();
+        const double last = basis_.last();
+        const std::size_t samples = 8 * (basis_.count - basis_.degree) + 1;
+        double best = first;
+        double best_distance = infinity;
+        for (std::size_t i = 0; i < samples; ++i) {
+            const double t = first + (last - first) * static_cast<double>(i) /
+                                         static_cast<double>(samples - 1);
+            const double d = distance(at(t), x);
+            if (d < best_distance) {
+                best = t;
+                best_distance = d;
+            }
+        }
+        const double h = (last - first) * 1e-7;
+        double t = best;
+        for (int iteration = 0; iteration < 16; ++iteration) {
+            const Vec3 c = at(t);
+            const Vec3 d1 = sub(at(std::min(t + h, last)), at(std::max(t - h, first)));
+            const double h1 = std::min(t + h, last) - std::max(t - h, first);
+            const Vec3 tangent = {d1[0] / h1, d1[1] / h1, d1[2] / h1};
+            const double length2 = dot(tangent, tangent);
+            if (!(length2 > 0)) {
+                break;
+            }
+            const double step = -dot(sub(c, x), tangent) / length2;
+            t = std::clamp(t + step, first, last);
+            if (std::abs(step) < (last - first) * 1e-14) {
+                break;
+            }
+        }
+        return t;
+    }
+
+    CurveKind kind_;
+    const double* p_;
+    Basis basis_;
+    const double* points_ = nullptr;
+};
+
+class Surface {
+public:
+    Surface(SurfaceKind kind, const double* p, double tolerance)
+        : kind_(kind), p_(p), tolerance_(tolerance) {
+        switch (kind) {
+        case SurfaceKind::Plane:
+        case SurfaceKind::Unsupported: break;
+        case SurfaceKind::Cylinder:
+            period_[0] = 2 * pi;
+            scale_ = {p[12], 1};
+            step_[0] = angle_step(p[12], tolerance);
+            break;
+        case SurfaceKind::Cone:
+            period_[0] = 2 * pi;
+            fit(0, 0);
+            break;
+        case SurfaceKind::Sphere:
+            period_[0] = 2 * pi;
+            scale_ = {p[12], p[12]};
+            step_[0] = step_[1] = angle_step(p[12], tolerance);
+            break;
+        case SurfaceKind::Torus:
+            period_ = {2 * pi, 2 * pi};
+            scale_ = {p[12] + p[13], p[13]};
+            step_ = {angle_step(p[12] + p[13], tolerance), angle_step(p[13], tolerance)};
+            break;
+        case SurfaceKind::BSpline: prepare_spline(); break;
+        }
+    }
+
+    bool supported() const noexcept { return kind_ != SurfaceKind::Unsupported; }
+    /// The period of u (v), or 0.
+    double period(int axis) const noexcept { return period_[axis]; }
+    /// About the length on the surface of a unit step of u (v).
+    double scale(int axis) const noexcept { return scale_[axis]; }
+    /// The parameter step along u (v) that keeps within tolerance, infinite
+    /// where the surface is straight.
+    double step(int axis) const noexcept { return step_[axis]; }
+
+    Vec3 at(const Vec2& uv) const noexcept {
+        const double u = uv[0];
+        const double v = uv[1];
+        switch (kind_) {
+        case SurfaceKind::Plane: return Frame(p_).at(u, v, 0);
+        case SurfaceKind::Cylinder:
+            return Frame(p_).at(p_[12] * std::cos(u), p_[12] * std::sin(u), v);
+        case SurfaceKind::Cone: {
+            const double r = p_[12] + v * std::tan(p_[13]);
+            return Frame(p_).at(r * std::cos(u), r * std::sin(u), v);
+        }
+        case SurfaceKind::Sphere: {
+            const double r = p_[12] * std::cos(v);
+            return Frame(p_).at(r * std::cos(u), r * std::sin(u), p_[12] * std::sin(v));
+        }
+        case SurfaceKind::Torus: {
+            const double r = p_[12] + p_[13] * std::cos(v);
+            return Frame(p_).at(r * std::cos(u), r * std::sin(u), p_[13] * std::sin(v));
+        }
+        case SurfaceKind::BSpline: {
+            std::array<double, max_degree + 1> nu{};
+            std::array<double, max_degree + 1> nv{};
+            const std::size_t su = u_.evaluate(u, nu.data()) - u_.degree;
+            const std::size_t sv = v_.evaluate(v, nv.data()) - v_.degree;
+            Vec3 sum{0, 0, 0};
+            double weight = 0;
+            for (std::size_t i = 0; i <= u_.degree; ++i) {
+                const double* row = points_ + 4 * (su + i) * v_.count;
+                for (std::size_t j = 0; j <= v_.degree; ++j) {
+                    const double* q = row + 4 * (sv + j);
+                    const double w = nu[i] * nv[j] * q[3];
+                    sum = add_scaled(sum, load3(q), w);
+                    weight += w;
+                }
+            }
+            return {sum[0] / weight, sum[1] / weight, sum[2] / weight};
+        }
+        case SurfaceKind::Unsupported: break;
+        }
+        return {0, 0, 0};
+    }
+
+    /// The parameters of a point on the surface; for B-splines, searched
+    /// from `hint` first if given.
+    Vec2 parameters(const Vec3& x, const Vec2* hint) const noexcept {
+        if (kind_ == SurfaceKind::BSpline) {
+            return spline_parameters(x, hint);
+        }
+        const Vec3 l = Frame(p_).local(x);
+        const double u = std::atan2(l[1], l[0]);
+        switch (kind_) {
+        case SurfaceKind::Plane: return {l[0], l[1]};
+        case SurfaceKind::Cylinder:
+        case SurfaceKind::Cone: return {u, l[2]};
+        case SurfaceKind::Sphere: return {u, std::atan2(l[2], std::hypot(l[0], l[1]))};
+        case SurfaceKind::Torus:
+            return {u, std::atan2(l[2], std::hypot(l[0], l[1]) - p_[12])};
+        default: break;
+        }
+        return {0, 0};
+    }
+
+    /// Whether u is undefined at `x`, a pole of a sphere or the apex of a
+    /// cone; `v` is set to its v if so.
+    bool singular(const Vec3& x, double& v) const noexcept {
+        if (kind_ != SurfaceKind::Sphere && kind_ != SurfaceKind::Cone) {
+            return false;
+        }
+        const Vec3 l = Frame(p_).local(x);
+        const double size = kind_ == SurfaceKind::Sphere ? p_[12] : p_[12] + std::abs(l[2]);
+        if (std::hypot(l[0], l[1]) > 1e-7 * size) {
+            return false;
+        }
+        v = kind_ == SurfaceKind::Sphere ? std::copysign(pi / 2, l[2]) : l[2];
+        return true;
+    }
+
+    /// The v of the pole (apex) closing a face that goes all the way round
+    /// in u, on its high side if `high`.
+    bool pole(bool high, double& v) const noexcept {
+        if (kind_ == SurfaceKind::Sphere) {
+            v = high ? pi / 2 : -pi / 2;
+            return true;
+        }
+        if (kind_ == SurfaceKind::Cone && std::tan(p_[13]) != 0) {
+            v = -p_[12] / std::tan(p_[13]);
+            return true;
+        }
+        return false;
+    }
+
+    /// Sets the scale and step of a cone to its widest over [v_low, v_high].
+    void fit(double v_low, double v_high) noexcept {
+        if (kind_ != SurfaceKind::Cone) {
+            return;
+        }
+        const double slope = std::tan(p_[13]);
+        const double radius = std::max({std::abs(p_[12] + v_low * slope),
+                                        std::abs(p_[12] + v_high * slope), tolerance_});
+        scale_ = {radius, std::sqrt(1 + slope * slope)};
+        step_[0] = angle_step(radius, tolerance_);
+    }
+
+private:
+    void prepare_spline() {
+        u_ = Basis(p_, p_ + 2, p_ + 4);
+        v_ = Basis(p_ + 1, p_ + 3, p_ + 5 + u_.count + u_.degree);
+        points_ = v_.knots + v_.count + v_.degree + 1;
+
+        // A grid of samples, a few per span, to start searches from and to
+        // estimate the scale, bend and closure of the surface.
+        for (int axis = 0; axis < 2; ++axis) {
+            const Basis& b = axis == 0 ? u_ : v_;
+            grid_size_[axis] =
+                std::clamp<std::size_t>(4 * (b.count - b.degree) + 1, 9, 65);
+        }
+        const std::size_t nu = grid_size_[0];
+        const std::size_t nv = grid_size_[1];
+        grid_.resize(nu * nv);
+        for (std::size_t i = 0; i < nu; ++i) {
+            for (std::size_t j = 0; j < nv; ++j) {
+                grid_[i * nv + j] = at(grid_parameters(i, j));
+            }
+        }
+        Vec3 low{infinity, infinity, infinity};
+        Vec3 high{-infinity, -infinity, -infinity};
+        for (const Vec3& q : grid_) {
+            for (int a = 0; a < 3; ++a) {
+                low[a] = std::min(low[a], q[a]);
+                high[a] = std::max(high[a], q[a]);
+            }
+        }
+        size_ = std::max(distance(low, high), tolerance_);
+
+        const double du = (u_.last() - u_.first()) / static_cast<double>(nu - 1);
+        const double dv = (v_.last() - v_.first()) / static_cast<double>(nv - 1);
+        double length[2] = {0, 0};
+        double bend[2] = {0, 0};
+        double gap[2] = {0, 0};
+        for (std::size_t i = 0; i < nu; ++i) {
+            for (std::size_t j = 0; j < nv; ++j) {
+                const Vec3& q = grid_[i * nv + j];
+                if (i + 1 < nu) {
+                    length[0] += distance(q, grid_[(i + 1) * nv + j]);
+                }
+                if (j + 1 < nv) {
+                    length[1] += distance(q, grid_[i * nv + j + 1]);
+                }
+                if (i > 0 && i + 1 < nu) {
+                    const Vec3& a = grid_[(i - 1) * nv + j];
+                    const Vec3& b = grid_[(i + 1) * nv + j];
+                    const Vec3 second = {a[0] - 2 * q[0] + b[0], a[1] - 2 * q[1] + b[1],
+                                         a[2] - 2 * q[2] + b[2]};
+                    bend[0] = std::max(bend[0], norm(second) / (du * du));
+                }
+                if (j > 0 && j + 1 < nv) {
+                    const Vec3& a = grid_[i * nv + j - 1];
+                    const Vec3& b = grid_[i * nv + j + 1];
+                    const Vec3 second = {a[0] - 2 * q[0] + b[0], a[1] - 2 * q[1] + b[1],
+                                         a[2] - 2 * q[2] + b[2]};
+                    bend[1] = std::max(bend[1], norm(second) / (dv * dv));
+                }
+            }
+        }
+        for (std::size_t i = 0; i < nu; ++i) {
+            gap[1] = std::max(gap[1], distance(grid_[i * nv], grid_[i * nv + nv - 1]));
+        }
+        for (std::size_t j = 0; j < nv; ++j) {
+            gap[0] = std::max(gap[0], distance(grid_[j], grid_[(nu - 1) * nv + j]));
+        }
+        const double ranges[2] = {u_.last() - u_.first(), v_.last() - v_.first()};
+        const double lines[2] = {static_cast<double>(nv), static_cast<double>(nu)};
+        for (int axis = 0; axis < 2; ++axis) {
+            scale_[axis] = std::max(length[axis] / (lines[axis] * ranges[axis]), 1e-300);
+            if (bend[axis] > 1e-12 * size_) {
+                step_[axis] = std::sqrt(8 * tolerance_ / bend[axis]);
+            }
+            if (gap[axis] <= 1e-7 * size_) {
+                period_[axis] = ranges[axis];
+            }
+        }
+    }
+
+    Vec2 grid_parameters(std::size_t i, std::size_t j) const noexcept {
+        return {u_.first() + (u_.last() - u_.first()) * static_cast<double>(i) /
+                                 static_cast<double>(grid_size_[0] - 1),
+                v_.first() + (v_.last() - v_.first()) * static_cast<double>(j) /
+                                 static_cast<double>(grid_size_[1] - 1)};
+    }
+
+    /// Gauss-Newton steps towards the foot of `x` from `uv`.
+    Vec2 newton(const Vec3& x, Vec2 uv) const noexcept {
+        const Vec2 low = {u_.first(), v_.first()};
+        const Vec2 high = {u_.last(), v_.last()};
+        const Vec2 h = {(high[0] - low[0]) * 1e-7, (high[1] - low[1]) * 1e-7};
+        for (int iteration = 0; iteration < 24; ++iteration) {
+            Vec3 d[2];
+            for (int a = 0; a < 2; ++a) {
+                Vec2 lo = uv;
+                Vec2 hi = uv;
+                lo[a] = std::max(uv[a] - h[a], low[a]);
+                hi[a] = std::min(uv[a] + h[a], high[a]);
+                const Vec3 diff = sub(at(hi), at(lo));
+                const double span = hi[a] - lo[a];
+                d[a] = {diff[0] / span, diff[1] / span, diff[2] / span};
+            }
+            const Vec3 r = sub(at(uv), x);
+            const double a = dot(d[0], d[0]);
+            const double b = dot(d[0], d[1]);
+            const double c = dot(d[1], d[1]);
+            const double det = a * c - b * b;
+            if (!(det > 1e-300)) {
+                break;
+            }
+            const double ru = dot(d[0], r);
+            const double rv = dot(d[1], r);
+            const Vec2 step = {-(c * ru - b * rv) / det, -(a * rv - b * ru) / det};
+            uv = {std::clamp(uv[0] + step[0], low[0], high[0]),
+                  std::clamp(uv[1] + step[1], low[1], high[1])};
+            if (std::abs(step[0]) < h[0] * 1e-6 && std::abs(step[1]) < h[1] * 1e-6) {
+                break;
+            }
+        }
+        return uv;
+    }
+
+    Vec2 spline_parameters(const Vec3& x, const Vec2* hint) const noexcept {
+        const double accept = std::max(1e-6 * size_, tolerance_);
+        Vec2 best{0, 0};
+        double best_distance = infinity;
+        if (hint != nullptr) {
+            best = newton(x, *hint);
+            best_distance = distance(at(best), x);
+            if (best_distance <= accept) {
+                return best;
+            }
+        }
+        std::size_t nearest = 0;
+        double nearest_distance = infinity;
+        for (std::size_t k = 0; k < grid_.size(); ++k) {
+            const double d = distance(grid_[k], x);
+            if (d < nearest_distance) {
+                nearest = k;
+                nearest_distance = d;
+            }
+        }
+        const Vec2 start = grid_parameters(nearest / grid_size_[1], nearest % grid_size_[1]);
+        const Vec2 uv = newton(x, start);
+        return distance(at(uv), x) < best_distance ? uv : best;
+    }
+
+    SurfaceKind kind_;
+    const double* p_;
+    double tolerance_;
+    Vec2 period_{0, 0};
+    Vec2 scale_{1, 1};
+    Vec2 step_{infinity, infinity};
+
+    Basis u_;
+    Basis v_;
+    const double* points_ = nullptr;
+    std::array<std::size_t, 2> grid_size_{0, 0};
+    std::vector<Vec3> grid_;
+    double size_ = 0;
+};
+
+// ---- triangulation ----------------------------------------------------------
+
+/// A point of a boundary loop: the vertex it is and where.
+struct Corner {
+    std::uint32_t vertex;
+    Vec3 at;
+};
+
+/// One edge use of a loop: its corners but the last, which starts the next
+/// use, and whether the face uses the edge both ways (a seam).
+struct Use {
+    std::vector<Corner> corners;
+    bool seam = false;
+};
+
+/// A polygon in the parameter plane: points and the vertices they become.
+struct Ring {
+    std::vector<Vec2> at;
+    std::vector<std::uint32_t> vertex;
+    /// Whole periods the ring advances by in u (v) going round once.
+    Vec2 net{0, 0};
+
+    void push(const Vec2& uv, std::uint32_t v) {
+        at.push_back(uv);
+        vertex.push_back(v);
+    }
+    double area() const noexcept {
+        double sum = 0;
+        for (std::size_t i = 0, j = at.size() - 1; i < at.size(); j = i++) {
+            sum += at[j][0] * at[i][1] - at[i][0] * at[j][1];
+        }
+        return sum / 2;
+    }
+};
+
+/// The triangles of one face: vertex numbers, face-local ones tagged with
+/// `local_vertex`, and the positions of the local ones.
+struct Piece {
+    std::vector<Vec3> points;
+    std::vector<std::uint32_t> triangles;
+};
+
+/// Triangulates one face of a surface in its parameter plane.
+class FaceTriangulator {
+public:
+    FaceTriangulator(Surface& surface, bool sense, Piece& piece)
+        : surface_(surface), sense_(sense), piece_(piece) {}
+
+    void run(const std::vector<std::vector<Use>>& loops) {
+        std::vector<Ring> closed;
+        std::vector<Ring> open;
+        for (const std::vector<Use>& loop : loops) {
+            Ring ring = map_loop(loop);
+            if (ring.at.size() < 3 && ring.net == Vec2{0, 0}) {
+                continue;
+            }
+            (ring.net == Vec2{0, 0} ? closed : open).push_back(std::move(ring));
+        }
+        if (open.size() == 2 && (open[0].net[0] + open[1].net[0] == 0) &&
+            (open[0].net[1] + open[1].net[1] == 0)) {
+            closed.push_back(join(open[0], open[1]));
+        } else if (open.size() == 1 && open[0].net[1] == 0) {
+            if (!close_at_pole(open[0])) {
+                return;
+            }
+            closed.push_back(std::move(open[0]));
+        } else if (!open.empty()) {
+            return; // Not a topology the parameter plane can hold.
+        }
+        if (closed.empty()) {
+            return;
+        }
+        double v_low = infinity;
+        double v_high = -infinity;
+        for (const Ring& ring : closed) {
+            for (const Vec2& uv : ring.at) {
+                v_low = std::min(v_low, uv[1]);
+                v_high = std::max(v_high, uv[1]);
+            }
+        }
+        surface_.fit(v_low, v_high);
+        triangulate(closed);
+    }
+
+private:
+    /// The parameters of a loop's corners, continuous across the periods of
+    /// the surface. A seam's two uses are put a period apart, each on the
+    /// side of the face it bounds; the face lies left of its loops when
+    /// `sense_` is set, right when not.
+    Ring map_loop(const std::vector<Use>& loop) {
+        struct Point {
+            std::uint32_t vertex;
+            Vec2 uv;
+            bool singular;
+            std::array<bool, 2> fixed;
+        };
+        std::vector<Point> points;
+        for (const Use& use : loop) {
+            const std::size_t begin = points.size();
+            for (const Corner& c : use.corners) {
+                Point p{c.vertex, {0, 0}, false, {false, false}};
+                double v = 0;
+                if (surface_.singular(c.at, v)) {
+                    p.singular = true;
+                    p.uv = {0, v};
+                } else {
+                    p.uv = surface_.parameters(c.at, hint_ ? &last_ : nullptr);
+                    last_ = p.uv;
+                    hint_ = true;
+                }
+                points.push_back(p);
+            }
+            if (use.seam) {
+                anchor(std::span<Point>(points).subspan(begin));
+            }
+        }
+        // Repeated corners come from edges too short to sample.
+        std::vector<Point> kept;
+        for (const Point& p : points) {
+            if (kept.empty() || kept.back().vertex != p.vertex) {
+                kept.push_back(p);
+            }
+        }
+        while (kept.size() > 1 && kept.front().vertex == kept.back().vertex) {
+            kept.pop_back();
+        }
+        Ring ring;
+        const std::size_t n = kept.size();
+        std::size_t first = n;
+        for (std::size_t i = 0; i < n && first == n; ++i) {
+            if (kept[i].fixed[0] || kept[i].fixed[1]) {
+                first = i;
+            }
+        }
+        for (std::size_t i = 0; i < n && first == n; ++i) {
+            if (!kept[i].singular) {
+                first = i;
+            }
+        }
+        if (first == n) {
+            return ring;
+        }
+        // Unwrapped in order from the first point; each singular run takes
+        // the u of its neighbours on either side.
+        std::vector<Point> order;
+        for (std::size_t k = 0; k < n; ++k) {
+            order.push_back(kept[(first + k) % n]);
+        }
+        Vec2 last = order[0].uv;
+        for (Point& p : order) {
+            if (p.singular) {
+                continue;
+            }
+            for (int a = 0; a < 2; ++a) {
+                if (!p.fixed[a]) {
+                    p.uv[a] = unwrap(p.uv[a], last[a], surface_.period(a));
+                }
+            }
+            last = p.uv;
+        }
+        Vec2 close = order[0].uv;
+        for (int a = 0; a < 2; ++a) {
+            if (!order[0].fixed[a]) {
+                close[a] = unwrap(close[a], last[a], surface_.period(a));
+            }
+        }
+        ring.net = {close[0] - order[0].uv[0], close[1] - order[0].uv[1]};
+        for (std::size_t k = 0; k < n; ++k) {
+            const Point& p = order[k];
+            if (!p.singular) {
+                ring.push(p.uv, p.vertex);
+                continue;
+            }
+            const double from = ring.at.back()[0];
+            std::size_t next = k;
+            while (next < n && order[next].singular) {
+                ++next;
+            }
+            const double to = next < n ? order[next].uv[0] : close[0];
+            pole_line(ring, from, to, p.uv[1], p.vertex);
+            k = next - 1;
+        }
+        return ring;
+    }
+
+    /// Fixes the periodic parameter of a seam use to one side of the seam.
+    template <typename Point>
+    void anchor(std::span<Point> use) const {
+        const Point* first = nullptr;
+        const Point* last = nullptr;
+        for (const Point& p : use) {
+            if (!p.singular) {
+                first = first == nullptr ? &p : first;
+                last = &p;
+            }
+        }
+        if (first == last) {
+            return;
+        }
+        for (int a = 0; a < 2; ++a) {
+            const double period = surface_.period(a);
+            if (period == 0) {
+                continue;
+            }
+            // The seam runs along the other parameter, a constant here.
+            bool constant = true;
+            for (const Point& p : use) {
+                constant = constant && (p.singular || std::abs(unwrap(p.uv[a], first->uv[a],
+                                                                      period) -
+                                                               first->uv[a]) < 1e-6 * period);
+            }
+            if (!constant) {
+                continue;
+            }
+            // Step by step, as a closed edge goes nearly a period round.
+            const int b = 1 - a;
+            double along = 0;
+            const Point* previous = nullptr;
+            for (const Point& p : use) {
+                if (!p.singular) {
+                    if (previous != nullptr) {
+                        along += unwrap(p.uv[b], previous->uv[b], surface_.period(b)) -
+                                 previous->uv[b];
+                    }
+                    previous = &p;
+                }
+            }
+            // Moving up v with the face on the left puts it at lower u;
+            // moving up u with the face on the left puts it at higher v.
+            const bool high = a == 0 ? (along > 0) == sense_ : (along < 0) == sense_;
+            const double base = first->uv[a] + (high ? period : 0);
+            for (Point& p : use) {
+                if (!p.singular) {
+                    p.uv[a] = base;
+                    p.fixed[a] = true;
+                }
+            }
+        }
+    }
+
+    /// Appends points from u = `from` to `to` at v, all of them `vertex`:
+    /// a pole or apex opened into a line.
+    void pole_line(Ring& ring, double from, double to, double v, std::uint32_t vertex) const {
+        const double pieces =
+            std::clamp(std::ceil(std::abs(to - from) / surface_.step(0)), 1.0, max_pieces);
+        for (double i = 0; i <= pieces; ++i) {
+            ring.push({from + (to - from) * i / pieces, v}, vertex);
+        }
+    }
+
+    /// New vertices along a straight seam from `from` to `to`, not counting
+    /// its ends, spaced to stay within tolerance. Both copies of the seam,
+    /// a period apart, use them.
+    std::vector<std::uint32_t> seam(const Vec2& from, const Vec2& to) {
+        double pieces = 1;
+        for (int a = 0; a < 2; ++a) {
+            pieces = std::max(pieces, std::ceil(std::abs(to[a] - from[a]) / surface_.step(a)));
+        }
+        pieces = std::min(pieces, max_pieces);
+        std::vector<std::uint32_t> vertices;
+        for (double i = 1; i < pieces; ++i) {
+            const double t = i / pieces;
+            vertices.push_back(
+                add_point({from[0] + (to[0] - from[0]) * t, from[1] + (to[1] - from[1]) * t}));
+        }
+        return vertices;
+    }
+
+    std::uint32_t add_point(const Vec2& uv) {
+        piece_.points.push_back(surface_.at(uv));
+        return local_vertex | static_cast<std::uint32_t>(piece_.points.size() - 1);
+    }
+
+    /// Two loops round a periodic surface the opposite way, such as the
+    /// ends of a tube without a seam edge, joined by a seam into one.
+    Ring join(const Ring& a, const Ring& b) {
+        const int axis = a.net[0] != 0 ? 0 : 1;
+        const double period = std::abs(a.net[axis]);
+        // The seam runs from a's first point to the point of b nearest it
+        // along the period.
+        const Vec2 start = a.at[0];
+        std::size_t s = 0;
+        double best = infinity;
+        for (std::size_t i = 0; i < b.at.size(); ++i) {
+            const double d = std::abs(unwrap(b.at[i][axis], start[axis], period) - start[axis]);
+            if (d < best) {
+                best = d;
+                s = i;
+            }
+        }
+        Vec2 end = b.at[s];
+        end[axis] = unwrap(end[axis], start[axis], period);
+        const std::vector<std::uint32_t> inner = seam(start, end);
+        const Vec2 shift = a.net;
+
+        Ring ring;
+        for (std::size_t i = 0; i < a.at.size(); ++i) {
+            ring.push(a.at[i], a.vertex[i]);
+        }
+        // Up the seam shifted by a's turn, round b, and back down.
+        const auto seam_points = [&](const Vec2& offset, bool forward) {
+            const double pieces = static_cast<double>(inner.size() + 1);
+            for (std::size_t k = 0; k < inner.size(); ++k) {
+                const std::size_t i = forward ? k : inner.size() - 1 - k;
+                const double t = static_cast<double>(i + 1) / pieces;
+                ring.push({start[0] + (end[0] - start[0]) * t + offset[0],
+                           start[1] + (end[1] - start[1]) * t + offset[1]},
+                          inner[i]);
+            }
+        };
+        ring.push({start[0] + shift[0], start[1] + shift[1]}, a.vertex[0]);
+        seam_points(shift, true);
+        const double offset = end[axis] - b.at[s][axis] + shift[axis];
+        for (std::size_t k = 0; k <= b.at.size(); ++k) {
+            const std::size_t i = (s + k) % b.at.size();
+            Vec2 uv = b.at[i];
+            if (s + k >= b.at.size()) {
+                uv = {uv[0] + b.net[0], uv[1] + b.net[1]};
+            }
+            uv[axis] += offset;
+            ring.push(uv, b.vertex[i]);
+        }
+        seam_points({0, 0}, false);
+        return ring;
+    }
+
+    /// A single loop round a sphere or cone, closed over the pole (apex) on
+    /// the side the face lies.
+    bool close_at_pole(Ring& ring) {
+        const bool up = ring.net[0] > 0;
+        double v = 0;
+        if (!surface_.pole(up == sense_, v)) {
+            return false;
+        }
+        const Vec2 start = ring.at[0];
+        const Vec2 turned = {start[0] + ring.net[0], start[1]};
+        const Vec2 top = {start[0], v};
+        const std::vector<std::uint32_t> inner = seam(start, top);
+        const std::uint32_t apex = add_point(top);
+        ring.push(turned, ring.vertex[0]);
+        const double pieces = static_cast<double>(inner.size() + 1);
+        for (std::size_t i = 0; i < inner.size(); ++i) {
+            const double t = static_cast<double>(i + 1) / pieces;
+            ring.push({turned[0], start[1] + (v - start[1]) * t}, inner[i]);
+        }
+        pole_line(ring, turned[0], start[0], v, apex);
+        for (std::size_t i = inner.size(); i-- > 0;) {
+            const double t = static_cast<double>(i + 1) / pieces;
+            ring.push({start[0], start[1] + (v - start[1]) * t}, inner[i]);
+        }
+        ring.net = {0, 0};
+        return true;
+    }
+
+    void triangulate(std::vector<Ring>& rings);
+
+    Surface& surface_;
+    bool sense_;
+    Piece& piece_;
+    /// The last parameters found, where B-spline searches start.
+    Vec2 last_{0, 0};
+    bool hint_ = false;
+};
+
+/// A triangulation of points in the plane, with each half-edge's twin across
+/// its edge: half-edge 3t + i runs from corner i of triangle t to corner
+/// i + 1. Half-edges without a twin are the polygon's boundary and are never
+/// flipped.
+class Triangulation {
+public:
+    using Triangle = std::array<std::uint32_t, 3>;
+
+    explicit Triangulation(const std::vector<Vec2>& points) : points_(points) {}
+
+    std::vector<Triangle>& triangles() noexcept { return triangles_; }
+
+    /// Links twins, after triangles were added, and flips every edge to
+    /// Delaunay.
+    void link() {
+        twins_.assign(triangles_.size() * 3, invalid);
+        std::vector<std::pair<std::uint64_t, std::uint32_t>> edges;
+        edges.reserve(twins_.size());
+        for (std::uint32_t h = 0; h < twins_.size(); ++h) {
+            edges.emplace_back(key(from(h), to(h)), h);
+        }
+        std::sort(edges.begin(), edges.end());
+        for (std::uint32_t h = 0; h < twins_.size(); ++h) {
+            if (twins_[h] != invalid) {
+                continue;
+            }
+            const std::uint64_t k = key(to(h), from(h));
+            const auto it = std::lower_bound(edges.begin(), edges.end(),
+                                             std::pair<std::uint64_t, std::uint32_t>{k, 0});
+            for (auto j = it; j != edges.end() && j->first == k; ++j) {
+                if (twins_[j->second] == invalid && j->second != h) {
+                    twins_[h] = j->second;
+                    twins_[j->second] = h;
+                    break;
+                }
+            }
+        }
+        std::vector<std::uint32_t> stack;
+        for (std::uint32_t h = 0; h < twins_.size(); ++h) {
+            stack.push_back(h);
+        }
+        legalize(stack);
+    }
+
+    /// Inserts a point strictly inside the triangulation and restores the
+    /// Delaunay property around it. Points on an edge or outside are left
+    /// out.
+    void insert(std::uint32_t point) {
+        const Vec2& p = points_[point];
+        const std::uint32_t t = locate(p);
+        if (t == invalid) {
+            return;
+        }
+        const Triangle corners = triangles_[t];
+        for (int i = 0; i < 3; ++i) {
+            const Vec2& a = points_[corners[i]];
+            const Vec2& b = points_[corners[(i + 1) % 3]];
+            const double length = std::hypot(b[0] - a[0], b[1] - a[1]);
+            if (orient(a, b, p) <= 1e-9 * length * length) {
+                return;
+            }
+        }
+        const std::uint32_t n1 = static_cast<std::uint32_t>(triangles_.size());
+        const std::uint32_t n2 = n1 + 1;
+        const std::uint32_t ab = twins_[3 * t];
+        const std::uint32_t bc = twins_[3 * t + 1];
+        const std::uint32_t ca = twins_[3 * t + 2];
+        triangles_[t] = {corners[0], corners[1], point};
+        triangles_.push_back({corners[1], corners[2], point});
+        triangles_.push_back({corners[2], corners[0], point});
+        twins_.resize(triangles_.size() * 3);
+        set_twin(3 * t, ab);
+        set_twin(3 * t + 1, 3 * n1 + 2);
+        set_twin(3 * t + 2, 3 * n2 + 1);
+        set_twin(3 * n1, bc);
+        set_twin(3 * n1 + 1, 3 * n2 + 2);
+        set_twin(3 * n2, ca);
+        last_ = t;
+        std::vector<std::uint32_t> stack = {3 * t, 3 * n1, 3 * n2};
+        legalize(stack);
+    }
+
+private:
+    static std::uint64_t key(std::uint32_t a, std::uint32_t b) noexcept {
+        return std::uint64_t{a} << 32 | b;
+    }
+    std::uint32_t from(std::uint32_t h) const noexcept { return triangles_[h / 3][h % 3]; }
+    std::uint32_t to(std::uint32_t h) const noexcept { return triangles_[h / 3][(h % 3 + 1) % 3]; }
+
+    void set_twin(std::uint32_t h, std::uint32_t twin) noexcept {
+        twins_[h] = twin;
+        if (twin != invalid) {
+            twins_[twin] = h;
+        }
+    }
+
+    /// Whether d is inside the circle through counterclockwise a, b, c, by
+    /// more than rounding.
+    static bool in_circle(const Vec2& a, const Vec2& b, const Vec2& c, const Vec2& d) noexcept {
+        const double adx = a[0] - d[0], ady = a[1] - d[1];
+        const double bdx = b[0] - d[0], bdy = b[1] - d[1];
+        const double cdx = c[0] - d[0], cdy = c[1] - d[1];
+        const double al = adx * adx + ady * ady;
+        const double bl = bdx * bdx + bdy * bdy;
+        const double cl = cdx * cdx + cdy * cdy;
+        const double det = al * (bdx * cdy - cdx * bdy) + bl * (cdx * ady - adx * cdy) +
+                           cl * (adx * bdy - bdx * ady);
+        const double bound = al * std::abs(bdx * cdy - cdx * bdy) +
+                             bl * std::abs(cdx * ady - adx * cdy) +
+                             cl * std::abs(adx * bdy - bdx * ady);
+        return det > 1e-10 * bound;
+    }
+
+    /// Lawson flips from the half-edges on `stack` until none is illegal.
+    void legalize(std::vector<std::uint32_t>& stack) {
+        // Rounding can make flips cycle; the cap ends it.
+        std::size_t budget = 64 * triangles_.size() + 64;
+        while (!stack.empty() && budget > 0) {
+            const std::uint32_t h = stack.back();
+            stack.pop_back();
+            const std::uint32_t g = twins_[h];
+            if (g == invalid) {
+                continue;
+            }
+            const std::uint32_t t = h / 3;
+            const std::uint32_t u = g / 3;
+            const std::uint32_t i = h % 3;
+            const std::uint32_t j = g % 3;
+            const std::uint32_t a = triangles_[t][i];
+            const std::uint32_t b = triangles_[t][(i + 1) % 3];
+            const std::uint32_t c = triangles_[t][(i + 2) % 3];
+            const std::uint32_t d = triangles_[u][(j + 2) % 3];
+            const Vec2& pa = points_[a];
+            const Vec2& pb = points_[b];
+            const Vec2& pc = points_[c];
+            const Vec2& pd = points_[d];
+            if (c == d || !in_circle(pa, pb, pc, pd) || orient(pc, pa, pd) <= 0 ||
+                orient(pd, pb, pc) <= 0) {
+                continue;
+            }
+            --budget;
+            const std::uint32_t bc = twins_[3 * t + (i + 1) % 3];
+            const std::uint32_t ca = twins_[3 * t + (i + 2) % 3];
+            const std::uint32_t ad = twins_[3 * u + (j + 1) % 3];
+            const std::uint32_t db = twins_[3 * u + (j + 2) % 3];
+            triangles_[t] = {c, a, d};
+            triangles_[u] = {d, b, c};
+            set_twin(3 * t, ca);
+            set_twin(3 * t + 1, ad);
+            set_twin(3 * t + 2, 3 * u + 2);
+            set_twin(3 * u, db);
+            set_twin(3 * u + 1, bc);
+            stack.insert(stack.end(), {3 * t, 3 * t + 1, 3 * u, 3 * u + 1});
+        }
+    }
+
+    /// The triangle holding `p`, walking from the last one touched and
+    /// scanning them all if the walk leaves the triangulation.
+    std::uint32_t locate(const Vec2& p) const {
+        const auto inside = [&](std::uint32_t t) {
+            for (int i = 0; i < 3; ++i) {
+                if (orient(points_[triangles_[t][i]], points_[triangles_[t][(i + 1) % 3]], p) < 0) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        std::uint32_t t = last_ < triangles_.size() ? last_ : 0;
+        for (std::size_t steps = 0; steps < triangles_.size(); ++steps) {
+            std::uint32_t next = t;
+            for (std::uint32_t k = 0; k < 3; ++k) {
+                const std::uint32_t i = (k + static_cast<std::uint32_t>(steps)) % 3;
+                if (orient(points_[triangles_[t][i]], points_[triangles_[t][(i + 1) % 3]], p) < 0) {
+                    next = twins_[3 * t + i] == invalid ? invalid : twins_[3 * t + i] / 3;
+                    break;
+                }
+            }
+            if (next == t) {
+                return t;
+            }
+            if (next == invalid) {
+                break;
+            }
+            t = next;
+        }
+        for (std::uint32_t s = 0; s < triangles_.size(); ++s) {
+            if (inside(s)) {
+                return s;
+            }
+        }
+        return invalid;
+    }
+
+    const std::vector<Vec2>& points_;
+    std::vector<Triangle> triangles_;
+    std::vector<std::uint32_t> twins_;
+    std::uint32_t last_ = 0;
+};
+
+/// Ear clipping of a polygon with holes, the holes first bridged into the
+/// outer ring as in earcut: each to the outer ring's vertex it can see
+/// nearest to the left of its leftmost point.
+class EarClipper {
+public:
+    EarClipper(const std::vector<Vec2>& points, std::vector<Triangulation::Triangle>& out)
+        : points_(points), out_(out) {}
+
+    /// Adds a ring of point indices; the first is the outer one and
+    /// counterclockwise, the rest holes and clockwise.
+    void add(std::uint32_t first, std::uint32_t count) {
+        const std::uint32_t start = static_cast<std::uint32_t>(point_.size());
+        for (std::uint32_t i = 0; i < count; ++i) {
+            point_.push_back(first + i);
+            prev_.push_back(start + (i + count - 1) % count);
+            next_.push_back(start + (i + 1) % count);
+        }
+        starts_.push_back(start);
+    }
+
+    void run() {
+        if (starts_.empty()) {
+            return;
+        }
+        std::vector<std::uint32_t> holes;
+        for (std::size_t i = 1; i < starts_.size(); ++i) {
+            std::uint32_t left = starts_[i];
+            for (std::uint32_t n = next_[left]; n != starts_[i]; n = next_[n]) {
+                const Vec2& p = at(n);
+                const Vec2& q = at(left);
+                if (p[0] < q[0] || (p[0] == q[0] && p[1] < q[1])) {
+                    left = n;
+                }
+            }
+            holes.push_back(left);
+        }
+        std::sort(holes.begin(), holes.end(),
+                  [&](std::uint32_t a, std::uint32_t b) { return at(a)[0] < at(b)[0]; });
+        const std::uint32_t outer = starts_[0];
+        for (const std::uint32_t hole : holes) {
+            const std::uint32_t bridge = find_bridge(hole, outer);
+            if (bridge != invalid) {
+                split(bridge, hole);
+            }
+        }
+        clip(outer);
+    }
+
+private:
+    const Vec2& at(std::uint32_t node) const noexcept { return points_[point_[node]]; }
+
+    std::uint32_t copy(std::uint32_t node) {
+        point_.push_back(point_[node]);
+        prev_.push_back(invalid);
+        next_.push_back(invalid);
+        return static_cast<std::uint32_t>(point_.size() - 1);
+    }
+
+    /// Whether the diagonal from node `a` to point `b` starts into the
+    /// polygon's inside.
+    bool locally_inside(std::uint32_t a, const Vec2& b) const noexcept {
+        const Vec2& p = at(prev_[a]);
+        const Vec2& q = at(a);
+        const Vec2& r = at(next_[a]);
+        const bool left_of_next = orient(q, r, b) >= 0;
+        const bool right_of_prev = orient(q, b, p) >= 0;
+        return orient(p, q, r) >= 0 ? left_of_next && right_of_prev
+                                    : left_of_next || right_of_prev;
+    }
+
+    static bool in_triangle(const Vec2& a, const Vec2& b, const Vec2& c, const Vec2& p) noexcept {
+        const double d1 = orient(a, b, p);
+        const double d2 = orient(b, c, p);
+        const double d3 = orient(c, a, p);
+        return !((d1 < 0 || d2 < 0 || d3 < 0) && (d1 > 0 || d2 > 0 || d3 > 0));
+    }
+
+    std::uint32_t find_bridge(std::uint32_t hole, std::uint32_t outer) const {
+        const Vec2& h = at(hole);
+        double qx = -infinity;
+        std::uint32_t m = invalid;
+        std::uint32_t p = outer;
+        do {
+            const Vec2& a = at(p);
+            const Vec2& b = at(next_[p]);
+            if (a[1] != b[1] && h[1] <= std::max(a[1], b[1]) && h[1] >= std::min(a[1], b[1])) {
+                const double x = a[0] + (h[1] - a[1]) * (b[0] - a[0]) / (b[1] - a[1]);
+                if (x <= h[0] && x > qx) {
+                    qx = x;
+                    m = a[0] < b[0] ? p : next_[p];
+                    if (x == h[0]) {
+                        return h[1] == a[1] ? p : next_[p];
+                    }
+                }
+            }
+            p = next_[p];
+        } while (p != outer);
+        if (m == invalid) {
+            return invalid;
+        }
+        // A vertex inside the triangle from the hole to the hit and to m
+        // would block the view; the one at the smallest angle does not.
+        const std::uint32_t stop = m;
+        const Vec2 mp = at(m);
+        double best = infinity;
+        p = m;
+        do {
+            const Vec2& q = at(p);
+            if (h[0] >= q[0] && q[0] >= mp[0] && h[0] != q[0] &&
+                in_triangle(h, {qx, h[1]}, mp, q)) {
+                const double tangent = std::abs(h[1] - q[1]) / (h[0] - q[0]);
+                if (locally_inside(p, h) &&
+                    (tangent < best || (tangent == best && q[0] > at(m)[0]))) {
+                    m = p;
+                    best = tangent;
+                }
+            }
+            p = next_[p];
+        } while (p != stop);
+        return m;
+    }
+
+    /// Links node a to node b by two copies of the diagonal between them.
+    void split(std::uint32_t a, std::uint32_t b) {
+        const std::uint32_t a2 = copy(a);
+        const std::uint32_t b2 = copy(b);
+        const std::uint32_t an = next_[a];
+        const std::uint32_t bp = prev_[b];
+        next_[a] = b;
+        prev_[b] = a;
+        next_[a2] = an;
+        prev_[an] = a2;
+        next_[b2] = a2;
+        prev_[a2] = b2;
+        next_[bp] = b2;
+        prev_[b2] = bp;
+    }
+
+    bool is_ear(std::uint32_t ear, bool check_inside) const {
+        const Vec2& a = at(prev_[ear]);
+        const Vec2& b = at(ear);
+        const Vec2& c = at(next_[ear]);
+        if (orient(a, b, c) <= 0) {
+            return false;
+        }
+        if (!check_inside) {
+            return true;
+        }
+        const std::uint32_t corners[3] = {point_[prev_[ear]], point_[ear], point_[next_[ear]]};
+        for (std::uint32_t p = next_[next_[ear]]; p != prev_[ear]; p = next_[p]) {
+            const std::uint32_t point = point_[p];
+            if (point == corners[0] || point == corners[1] || point == corners[2]) {
+                continue;
+            }
+            const Vec2& q = at(p);
+            if (q == a || q == b || q == c) {
+                continue;
+            }
+            if (in_triangle(a, b, c, q) && orient(at(prev_[p]), q, at(next_[p])) <= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /// Clips ears until three corners are left. A pass round the ring that
+    /// finds none relaxes the test: first convex corners with others inside
+    /// are taken, then any corner, so degenerate input still ends.
+    void clip(std::uint32_t ear) {
+        int pass = 0;
+        std::uint32_t stop = ear;
+        while (prev_[ear] != next_[ear]) {
+            const std::uint32_t p = prev_[ear];
+            const std::uint32_t n = next_[ear];
+            if (pass == 2 || is_ear(ear, pass == 0)) {
+                out_.push_back({point_[p], point_[ear], point_[n]});
+                next_[p] = n;
+                prev_[n] = p;
+                ear = next_[n];
+                stop = ear;
+                pass = 0;
+                continue;
+            }
+            ear = n;
+            if (ear == stop) {
+                ++pass;
+            }
+        }
+    }
+
+    const std::vector<Vec2>& points_;
+    std::vector<Triangulation::Triangle>& out_;
+    std::vector<std::uint32_t> point_;
+    std::vector<std::uint32_t> prev_;
+    std::vector<std::uint32_t> next_;
+    std::vector<std::uint32_t> starts_;
+};
+
+void FaceTriangulator::triangulate(std::vector<Ring>& rings) {
+    // In scaled parameters, where lengths are roughly those on the surface
+    // and so the triangles' shapes are.
+    const Vec2 scale = {surface_.scale(0), surface_.scale(1)};
+    for (Ring& ring : rings) {
+        for (Vec2& uv : ring.at) {
+            uv = {uv[0] * scale[0], uv[1] * scale[1]};
+        }
+    }
+    std::size_t outer = 0;
+    for (std::size_t i = 1; i < rings.size(); ++i) {
+        if (std::abs(rings[i].area()) > std::abs(rings[outer].area())) {
+            outer = i;
+        }
+    }
+    std::swap(rings[0], rings[outer]);
+    Vec2 low{infinity, infinity};
+    Vec2 high{-infinity, -infinity};
+    for (const Vec2& p : rings[0].at) {
+        for (int a = 0; a < 2; ++a) {
+            low[a] = std::min(low[a], p[a]);
+            high[a] = std::max(high[a], p[a]);
+        }
+    }
+    for (std::size_t i = 0; i < rings.size(); ++i) {
+        Ring& ring = rings[i];
+        // Holes go into the same period as the outer ring.
+        for (int a = 0; a < 2 && i > 0; ++a) {
+            const double period = surface_.period(a) * scale[a];
+            if (period > 0) {
+                double mean = 0;
+                for (const Vec2& p : ring.at) {
+                    mean += p[a];
+                }
+                mean /= static_cast<double>(ring.at.size());
+                const double shift = unwrap(mean, (low[a] + high[a]) / 2, period) - mean;
+                for (Vec2& p : ring.at) {
+                    p[a] += shift;
+                }
+            }
+        }
+        if ((ring.area() > 0) != (i == 0)) {
+            std::reverse(ring.at.begin(), ring.at.end());
+            std::reverse(ring.vertex.begin(), ring.vertex.end());
+        }
+    }
+
+    std::vector<Vec2> points;
+    std::vector<std::uint32_t> vertices;
+    Triangulation triangulation(points);
+    EarClipper clipper(points, triangulation.triangles());
+    for (const Ring& ring : rings) {
+        clipper.add(static_cast<std::uint32_t>(points.size()),
+                    static_cast<std::uint32_t>(ring.at.size()));
+        points.insert(points.end(), ring.at.begin(), ring.at.end());
+        vertices.insert(vertices.end(), ring.vertex.begin(), ring.vertex.end());
+    }
+    const std::size_t boundary = points.size();
+    clipper.run();
+    triangulation.link();
+
+    // Inside points on a grid staggered row by row, spaced to keep curved
+    // surfaces within tolerance and clear of the boundary by half a space.
+    double spacing = infinity;
+    for (int a = 0; a < 2; ++a) {
+        spacing = std::min(spacing, surface_.step(a) * scale[a]);
+    }
+    if (std::isfinite(spacing) && high[0] > low[0] && high[1] > low[1]) {
+        const double cells = (high[0] - low[0]) * (high[1] - low[1]) / (spacing * spacing);
+        if (cells > max_interior_points) {
+            spacing *= std::sqrt(cells / max_interior_points);
+        }
+        const double margin = spacing / 2;
+        struct Segment {
+            Vec2 a;
+            Vec2 b;
+        };
+        std::vector<Segment> segments;
+        for (const Ring& ring : rings) {
+            for (std::size_t i = 0, j = ring.at.size() - 1; i < ring.at.size(); j = i++) {
+                segments.push_back({ring.at[j], ring.at[i]});
+            }
+        }
+        std::vector<const Segment*> band;
+        std::vector<double> crossings;
+        std::size_t row = 0;
+        for (double y = low[1] + spacing / 2; y < high[1]; y += spacing, ++row) {
+            band.clear();
+            crossings.clear();
+            for (const Segment& s : segments) {
+                if (std::min(s.a[1], s.b[1]) <= y + margin &&
+                    std::max(s.a[1], s.b[1]) >= y - margin) {
+                    band.push_back(&s);
+                }
+                if ((s.a[1] <= y) != (s.b[1] <= y)) {
+                    const double t = (y - s.a[1]) / (s.b[1] - s.a[1]);
+                    crossings.push_back(s.a[0] + t * (s.b[0] - s.a[0]));
+                }
+            }
+            std::sort(crossings.begin(), crossings.end());
+            const double start = low[0] + spacing * (row % 2 == 0 ? 0.5 : 1.0);
+            std::size_t crossed = 0;
+            for (double x = start; x < high[0]; x += spacing) {
+                while (crossed < crossings.size() && crossings[crossed] < x) {
+                    ++crossed;
+                }
+                if (crossed % 2 == 0) {
+                    continue;
+                }
+                const Vec2 p = {x, y};
+                bool clear = true;
+                for (const Segment* s : band) {
+                    const double dx = s->b[0] - s->a[0];
+                    const double dy = s->b[1] - s->a[1];
+                    const double length2 = dx * dx + dy * dy;
+                    const double along = (x - s->a[0]) * dx + (y - s->a[1]) * dy;
+                    const double t = length2 > 0 ? std::clamp(along / length2, 0.0, 1.0) : 0.0;
+                    if (std::hypot(s->a[0] + t * dx - x, s->a[1] + t * dy - y) < margin) {
+                        clear = false;
+                        break;
+                    }
+                }
+                if (clear) {
+                    points.push_back(p);
+                    vertices.push_back(invalid);
+                }
+            }
+        }
+        for (std::size_t i = boundary; i < points.size(); ++i) {
+            triangulation.insert(static_cast<std::uint32_t>(i));
+        }
+    }
+
+    // Inside points that made it into the triangulation become vertices.
+    for (const Triangulation::Triangle& t : triangulation.triangles()) {
+        std::uint32_t corners[3];
+        for (int k = 0; k < 3; ++k) {
+            std::uint32_t& v = vertices[t[k]];
+            if (v == invalid) {
+                v = add_point({points[t[k]][0] / scale[0], points[t[k]][1] / scale[1]});
+            }
+            corners[k] = v;
+        }
+        if (corners[0] == corners[1] || corners[1] == corners[2] || corners[2] == corners[0]) {
+            continue;
+        }
+        if (!sense_) {
+            std::swap(corners[1], corners[2]);
+        }
+        piece_.triangles.insert(piece_.triangles.end(), corners, corners + 3);
+    }
+}
+
+/// Tolerances are snapped down to steps of 2^(1/8), about 9% apart, so that
+/// nearby tolerances share a cached mesh, which is only ever finer than asked.
+constexpr int steps_per_octave = 8;
+/// Meshes kept per shape; the least recently used goes first.
+constexpr std::size_t tessellations_per_shape = 4;
+
+int tolerance_step(double tolerance) {
+    // Kept to normal numbers, whose powers of two are exact.
+    constexpr int lowest = std::numeric_limits<double>::min_exponent * steps_per_octave;
+    int step = std::max(static_cast<int>(std::floor(std::log2(tolerance) * steps_per_octave)),
+                        lowest);
+    if (step > lowest && std::exp2(static_cast<double>(step) / steps_per_octave) > tolerance) {
+        --step;
+    }
+    return step;
+}
+
+double step_tolerance(int step) {
+    return std::exp2(static_cast<double>(step) / steps_per_octave);
+}
+
+} // namespace
+
+struct Brep::Data {
+    struct Tessellation {
+        Mesh mesh;
+        std::uint64_t used = 0;
+    };
+
+    Arrays arrays;
+    /// Shape meshes by shape and tolerance step, shared by copies of the
+    /// value; at most tessellations_per_shape for each shape.
+    mutable std::mutex mutex;
+    mutable std::uint64_t clock = 0;
+    mutable std::map<std::pair<std::uint32_t, int>, Tessellation> tessellations;
+};
+
+Brep::Brep() : Brep([] {
+    static const std::shared_ptr<const Data> empty = [] {
+        auto data = std::make_shared<Data>();
+        Arrays& a = data->arrays;
+        a.bodies = Buffer::allocate(ElementType::U32, 0, 3);
+        a.transforms = Buffer::allocate(ElementType::F64, 0, 12);
+        a.names = Buffer::allocate(ElementType::U8, 0);
+        a.shapes = Buffer::allocate(ElementType::U32, 0, 2);
+        a.faces = Buffer::allocate(ElementType::U32, 0, 4);
+        a.loops = Buffer::allocate(ElementType::U32, 0, 3);
+        a.edge_uses = Buffer::allocate(ElementType::U32, 0);
+        a.edges = Buffer::allocate(ElementType::U32, 0, 4);
+        a.vertices = Buffer::allocate(ElementType::F64, 0, 3);
+        a.surfaces = Buffer::allocate(ElementType::U32, 0, 2);
+        a.curves = Buffer::allocate(ElementType::U32, 0, 2);
+        a.parameters = Buffer::allocate(ElementType::F64, 0);
+        return std::shared_ptr<const Data>(std::move(data));
+    }();
+    return empty;
+}()) {}
+
+Brep::Brep(std::shared_ptr<const Data> data) noexcept : data_(std::move(data)) {}
+
+Brep Brep::from_arrays(Arrays arrays) {
+    const auto check = [](bool ok, const char* what) {
+        if (!ok) {
+            throw FormatError(std::string("inconsistent brep: ") + what);
+        }
+    };
+    const auto is = [](const Buffer& b, ElementType type, std::uint32_t components) {
+        return b.element_type() == type && b.components() == components &&
+               b.size() % components == 0;
+    };
+    check(is(arrays.bodies, ElementType::U32, 3), "bodies are not u32 x 3");
+    check(is(arrays.transforms, ElementType::F64, 12), "transforms are not f64 x 12");
+    check(is(arrays.names, ElementType::U8, 1), "names are not u8");
+    check(is(arrays.shapes, ElementType::U32, 2), "shapes are not u32 pairs");
+    check(is(arrays.faces, ElementType::U32, 4), "faces are not u32 x 4");
+    check(is(arrays.loops, ElementType::U32, 3), "loops are not u32 x 3");
+    check(is(arrays.edge_uses, ElementType::U32, 1), "edge uses are not u32");
+    check(is(arrays.edges, ElementType::U32, 4), "edges are not u32 x 4");
+    check(is(arrays.vertices, ElementType::F64, 3), "vertices are not f64 triples");
+    check(is(arrays.surfaces, ElementType::U32, 2), "surfaces are not u32 pairs");
+    check(is(arrays.curves, ElementType::U32, 2), "curves are not u32 pairs");
+    check(is(arrays.parameters, ElementType::F64, 1), "parameters are not f64");
+    check(arrays.transforms.tuples() == arrays.bodies.tuples(), "one transform per body");
+    for (const Buffer* b : {&arrays.bodies, &arrays.shapes, &arrays.faces, &arrays.loops,
+                            &arrays.edge_uses, &arrays.edges, &arrays.vertices, &arrays.surfaces,
+                            &arrays.curves}) {
+        check(b->tuples() < invalid, "too many elements");
+    }
+    check(arrays.vertices.tuples() < local_vertex, "too many vertices");
+
+    // Ranges [first, first + count) within `size`.
+    const auto within = [](std::uint64_t first, std::uint64_t count, std::uint64_t size) {
+        return first + count <= size;
+    };
+    const std::span<const std::uint32_t> bodies = arrays.bodies.view<std::uint32_t>();
+    for (std::size_t i = 0; i < bodies.size(); i += 3) {
+        check(bodies[i] < arrays.shapes.tuples(), "body shape out of range");
+        check(within(bodies[i + 1], bodies[i + 2], arrays.names.size()), "body name out of range");
+    }
+    for (const double t : arrays.transforms.view<double>()) {
+        check(std::isfinite(t), "transform not finite");
+    }
+    const std::span<const std::uint32_t> shapes = arrays.shapes.view<std::uint32_t>();
+    for (std::size_t i = 0; i < shapes.size(); i += 2) {
+        check(within(shapes[i], shapes[i + 1], arrays.faces.tuples()), "shape faces out of range");
+    }
+    const std::span<const std::uint32_t> faces = arrays.faces.view<std::uint32_t>();
+    for (std::size_t i = 0; i < faces.size(); i += 4) {
+        check(faces[i] < arrays.surfaces.tuples(), "face surface out of range");
+        check(within(faces[i + 1], faces[i + 2], arrays.loops.tuples()), "face loops out of range");
+        check(faces[i + 3] <= 1, "face sense not 0 or 1");
+    }
+    const std::span<const std::uint32_t> loops = arrays.loops.view<std::uint32_t>();
+    for (std::size_t i = 0; i < loops.size(); i += 3) {
+        check(within(loops[i], loops[i + 1], arrays.edge_uses.size()), "loop edges out of range");
+        check(loops[i + 2] <= 1, "loop outer flag not 0 or 1");
+    }
+    for (const std::uint32_t use : arrays.edge_uses.view<std::uint32_t>()) {
+        check((use >> 1) < arrays.edges.tuples(), "edge use out of range");
+    }
+    const std::span<const std::uint32_t> edges = arrays.edges.view<std::uint32_t>();
+    for (std::size_t i = 0; i < edges.size(); i += 4) {
+        check(edges[i] < arrays.curves.tuples(), "edge curve out of range");
+        check(edges[i + 1] < arrays.vertices.tuples() && edges[i + 2] < arrays.vertices.tuples(),
+              "edge vertex out of range");
+        check(edges[i + 3] <= 1, "edge sense not 0 or 1");
+    }
+    const std::span<const double> parameters = arrays.parameters.view<double>();
+    const std::span<const std::uint32_t> surfaces = arrays.surfaces.view<std::uint32_t>();
+    for (std::size_t i = 0; i < surfaces.size(); i += 2) {
+        check(surfaces[i] <= static_cast<std::uint32_t>(SurfaceKind::Unsupported),
+              "unknown surface kind");
+        check(surfaces[i + 1] <= parameters.size(), "surface parameters out of range");
+        const auto kind = static_cast<SurfaceKind>(surfaces[i]);
+        const std::size_t available = parameters.size() - surfaces[i + 1];
+        check(kind == SurfaceKind::Unsupported ||
+                  surface_size(kind, parameters.data() + surfaces[i + 1], available) != 0,
+              "surface parameters out of range");
+    }
+    const std::span<const std::uint32_t> curves = arrays.curves.view<std::uint32_t>();
+    for (std::size_t i = 0; i < curves.size(); i += 2) {
+        check(curves[i] <= static_cast<std::uint32_t>(CurveKind::Unsupported),
+              "unknown curve kind");
+        check(curves[i + 1] <= parameters.size(), "curve parameters out of range");
+        const auto kind = static_cast<CurveKind>(curves[i]);
+        const std::size_t available = parameters.size() - curves[i + 1];
+        check(kind == CurveKind::Unsupported ||
+                  curve_size(kind, parameters.data() + curves[i + 1], available) != 0,
+              "curve parameters out of range");
+    }
+    auto data = std::make_shared<Data>();
+    data->arrays = std::move(arrays);
+    return Brep(std::move(data));
+}
+
+const Brep::Arrays& Brep::arrays() const noexcept {
+    return data_->arrays;
+}
+
+std::size_t Brep::body_count() const noexcept {
+    return data_->arrays.bodies.tuples();
+}
+
+std::size_t Brep::shape_count() const noexcept {
+    return data_->arrays.shapes.tuples();
+}
+
+std::size_t Brep::face_count() const noexcept {
+    return data_->arrays.faces.tuples();
+}
+
+std::string_view Brep::body_name(std::size_t body) const {
+    if (body >= body_count()) {
+        throw Error("body " + std::to_string(body) + " out of range, the model has " +
+                    std::to_string(body_count()));
+    }
+    const std::span<const std::uint32_t> bodies = data_->arrays.bodies.view<std::uint32_t>();
+    const std::span<const std::uint8_t> names = data_->arrays.names.view<std::uint8_t>();
+    return {reinterpret_cast<const char*>(names.data()) + bodies[3 * body + 1],
+            bodies[3 * body + 2]};
+}
+
+std::uint32_t Brep::body_shape(std::size_t body) const {
+    if (body >= body_count()) {
+        throw Error("body " + std::to_string(body) + " out of range, the model has " +
+                    std::to_string(body_count()));
+    }
+    return data_->arrays.bodies.view<std::uint32_t>()[3 * body];
+}
+
+std::uint32_t Brep::find_body(std::string_view name) const noexcept {
+    for (std::size_t b = 0; b < body_count(); ++b) {
+        if (body_name(b) == name) {
+            return static_cast<std::uint32_t>(b);
+        }
+    }
+    return invalid;
+}
+
+Mesh Brep::shape_mesh(std::uint32_t shape, int step, ThreadPool* pool) const {
+    const auto key = std::pair(shape, step);
+    {
+        const std::lock_guard lock(data_->mutex);
+        const auto it = data_->tessellations.find(key);
+        if (it != data_->tessellations.end()) {
+            it->second.used = ++data_->clock;
+            return it->second.mesh;
+        }
+    }
+    const double tolerance = step_tolerance(step);
+    // Tessellated outside the lock; if two callers race for a shape, the
+    // first to finish is kept.
+    const Arrays& a = data_->arrays;
+    const std::span<const std::uint32_t> shapes = a.shapes.view<std::uint32_t>();
+    const std::span<const std::uint32_t> faces = a.faces.view<std::uint32_t>();
+    const std::span<const std::uint32_t> loops = a.loops.view<std::uint32_t>();
+    const std::span<const std::uint32_t> uses = a.edge_uses.view<std::uint32_t>();
+    const std::span<const std::uint32_t> edges = a.edges.view<std::uint32_t>();
+    const std::span<const std::uint32_t> curves = a.curves.view<std::uint32_t>();
+    const std::span<const std::uint32_t> surfaces = a.surfaces.view<std::uint32_t>();
+    const std::span<const double> vertices = a.vertices.view<double>();
+    const double* parameters = a.parameters.view<double>().data();
+    const std::uint32_t first_face = shapes[2 * shape];
+    const std::uint32_t face_total = shapes[2 * shape + 1];
+
+    // The shape's vertices come first in the mesh, then the inner points of
+    // its edges, so faces on either side of an edge share all its points.
+    std::vector<std::uint32_t> shape_edges;
+    for (std::uint32_t f = first_face; f < first_face + face_total; ++f) {
+        for (std::uint32_t l = faces[4 * f + 1]; l < faces[4 * f + 1] + faces[4 * f + 2]; ++l) {
+            for (std::uint32_t u = loops[3 * l]; u < loops[3 * l] + loops[3 * l + 1]; ++u) {
+                shape_edges.push_back(uses[u] >> 1);
+            }
+        }
+    }
+    std::sort(shape_edges.begin(), shape_edges.end());
+    shape_edges.erase(std::unique(shape_edges.begin(), shape_edges.end()), shape_edges.end());
+    std::vector<std::uint32_t> shape_vertices;
+    for (const std::uint32_t e : shape_edges) {
+        shape_vertices.push_back(edges[4 * e + 1]);
+        shape_vertices.push_back(edges[4 * e + 2]);
+    }
+    std::sort(shape_vertices.begin(), shape_vertices.end());
+    shape_vertices.erase(std::unique(shape_vertices.begin(), shape_vertices.end()),
+                         shape_vertices.end());
+    const auto vertex_index = [&](std::uint32_t v) {
+        return static_cast<std::uint32_t>(
+            std::lower_bound(shape_vertices.begin(), shape_vertices.end(), v) -
+            shape_vertices.begin());
+    };
+    const auto edge_index = [&](std::uint32_t e) {
+        return static_cast<std::size_t>(
+            std::lower_bound(shape_edges.begin(), shape_edges.end(), e) - shape_edges.begin());
+    };
+
+    std::vector<std::vector<Vec3>> samples(shape_edges.size());
+    parallel_for(pool, shape_edges.size(), 16, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const std::uint32_t e = shape_edges[i];
+            const std::uint32_t c = edges[4 * e];
+            const Curve curve(static_cast<CurveKind>(curves[2 * c]),
+                              parameters + curves[2 * c + 1]);
+            const std::uint32_t v0 = edges[4 * e + 1];
+            const std::uint32_t v1 = edges[4 * e + 2];
+            samples[i] = curve.sample(load3(&vertices[3 * v0]), load3(&vertices[3 * v1]), v0 == v1,
+                                      edges[4 * e + 3] != 0, tolerance);
+        }
+    });
+    std::vector<std::uint32_t> sample_base(shape_edges.size() + 1);
+    sample_base[0] = static_cast<std::uint32_t>(shape_vertices.size());
+    for (std::size_t i = 0; i < samples.size(); ++i) {
+        sample_base[i + 1] = sample_base[i] + static_cast<std::uint32_t>(samples[i].size());
+    }
+    if (sample_base.back() >= local_vertex) {
+        throw Error("tessellation too large");
+    }
+
+    std::vector<Piece> pieces(face_total);
+    parallel_for(pool, face_total, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const std::uint32_t f = first_face + static_cast<std::uint32_t>(i);
+            const std::uint32_t s = faces[4 * f];
+            Surface surface(static_cast<SurfaceKind>(surfaces[2 * s]),
+                            parameters + surfaces[2 * s + 1], tolerance);
+            if (!surface.supported()) {
+                continue;
+            }
+            const std::uint32_t loop_begin = faces[4 * f + 1];
+            const std::uint32_t loop_end = loop_begin + faces[4 * f + 2];
+            std::vector<std::uint32_t> face_edges;
+            for (std::uint32_t l = loop_begin; l < loop_end; ++l) {
+                for (std::uint32_t u = loops[3 * l]; u < loops[3 * l] + loops[3 * l + 1]; ++u) {
+                    face_edges.push_back(uses[u] >> 1);
+                }
+            }
+            std::sort(face_edges.begin(), face_edges.end());
+            std::vector<std::vector<Use>> face_loops;
+            for (std::uint32_t l = loop_begin; l < loop_end; ++l) {
+                std::vector<Use>& loop = face_loops.emplace_back();
+                for (std::uint32_t u = loops[3 * l]; u < loops[3 * l] + loops[3 * l + 1]; ++u) {
+                    const std::uint32_t e = uses[u] >> 1;
+                    const bool reversed = (uses[u] & 1) != 0;
+                    const std::size_t k = edge_index(e);
+                    const std::vector<Vec3>& inner = samples[k];
+                    Use& use = loop.emplace_back();
+                    use.seam = std::upper_bound(face_edges.begin(), face_edges.end(), e) -
+                                   std::lower_bound(face_edges.begin(), face_edges.end(), e) >
+                               1;
+                    const std::uint32_t start = edges[4 * e + (reversed ? 2 : 1)];
+                    use.corners.push_back({vertex_index(start), load3(&vertices[3 * start])});
+                    for (std::size_t j = 0; j < inner.size(); ++j) {
+                        const std::size_t at = reversed ? inner.size() - 1 - j : j;
+                        use.corners.push_back(
+                            {sample_base[k] + static_cast<std::uint32_t>(at), inner[at]});
+                    }
+                }
+            }
+            FaceTriangulator(surface, faces[4 * f + 3] != 0, pieces[i]).run(face_loops);
+        }
+    });
+
+    std::vector<double> positions;
+    positions.reserve(3 * sample_base.back());
+    for (const std::uint32_t v : shape_vertices) {
+        positions.insert(positions.end(), &vertices[3 * v], &vertices[3 * v] + 3);
+    }
+    for (const std::vector<Vec3>& inner : samples) {
+        for (const Vec3& p : inner) {
+            positions.insert(positions.end(), p.begin(), p.end());
+        }
+    }
+    std::vector<std::uint32_t> triangles;
+    for (const Piece& piece : pieces) {
+        const auto base = static_cast<std::uint32_t>(positions.size() / 3);
+        for (const Vec3& p : piece.points) {
+            positions.insert(positions.end(), p.begin(), p.end());
+        }
+        for (const std::uint32_t v : piece.triangles) {
+            triangles.push_back((v & local_vertex) != 0 ? base + (v & ~local_vertex) : v);
+        }
+    }
+    if (positions.size() / 3 >= invalid) {
+        throw Error("tessellation too large");
+    }
+    Mesh mesh = Mesh::from_triangles(Buffer::adopt(std::move(positions), 3),
+                                     Buffer::adopt(std::move(triangles), 3), pool);
+    const std::lock_guard lock(data_->mutex);
+    auto& cache = data_->tessellations;
+    if (const auto it = cache.find(key); it != cache.end()) {
+        return it->second.mesh;
+    }
+    // Makes room among the shape's meshes, which are adjacent in the map.
+    const auto first = cache.lower_bound(std::pair(shape, std::numeric_limits<int>::min()));
+    const auto last = cache.upper_bound(std::pair(shape, std::numeric_limits<int>::max()));
+    if (static_cast<std::size_t>(std::distance(first, last)) >= tessellations_per_shape) {
+        cache.erase(std::min_element(first, last, [](const auto& a, const auto& b) {
+            return a.second.used < b.second.used;
+        }));
+    }
+    return cache.emplace(key, Data::Tessellation{std::move(mesh), ++data_->clock})
+        .first->second.mesh;
+}
+
+namespace {
+
+/// `mesh`'s positions under a 3 x 4 row-major transform.
+Buffer placed(const Mesh& mesh, const double* m, ThreadPool* pool) {
+    const std::span<const double> p = mesh.positions();
+    Buffer out = Buffer::allocate(ElementType::F64, p.size(), 3);
+    const std::span<double> q = out.mutate<double>();
+    parallel_for(pool, p.size() / 3, 1 << 14, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            for (int r = 0; r < 3; ++r) {
+                q[3 * v + r] = m[4 * r] * p[3 * v] + m[4 * r + 1] * p[3 * v + 1] +
+                               m[4 * r + 2] * p[3 * v + 2] + m[4 * r + 3];
+            }
+        }
+    });
+    return out;
+}
+
+void check_tolerance(double tolerance) {
+    if (!(tolerance > 0) || !std::isfinite(tolerance)) {
+        throw Error("tessellation tolerance must be positive");
+    }
+}
+
+} // namespace
+
+Mesh Brep::tessellate(std::size_t body, double tolerance, ThreadPool* pool) const {
+    check_tolerance(tolerance);
+    const Mesh mesh = shape_mesh(body_shape(body), tolerance_step(tolerance), pool);
+    const double* m = data_->arrays.transforms.view<double>().data() + 12 * body;
+    return mesh.with_positions(placed(mesh, m, pool));
+}
+
+Mesh Brep::tessellate_all(double tolerance, ThreadPool* pool) const {
+    check_tolerance(tolerance);
+    const int step = tolerance_step(tolerance);
+    const std::size_t count = body_count();
+    std::vector<std::uint32_t> shapes;
+    for (std::size_t b = 0; b < count; ++b) {
+        shapes.push_back(body_shape(b));
+    }
+    std::sort(shapes.begin(), shapes.end());
+    shapes.erase(std::unique(shapes.begin(), shapes.end()), shapes.end());
+    std::vector<Mesh> meshes(shapes.size());
+    parallel_for(pool, shapes.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            meshes[i] = shape_mesh(shapes[i], step, pool);
+        }
+    });
+
+    // Bodies side by side: their half-edge structures only shift.
+    std::vector<std::size_t> vertex_base(count + 1, 0);
+    std::vector<std::size_t> halfedge_base(count + 1, 0);
+    const auto mesh_of = [&](std::size_t b) -> const Mesh& {
+        return meshes[std::lower_bound(shapes.begin(), shapes.end(), body_shape(b)) -
+                      shapes.begin()];
+    };
+    for (std::size_t b = 0; b < count; ++b) {
+        vertex_base[b + 1] = vertex_base[b] + mesh_of(b).vertex_count();
+        halfedge_base[b + 1] = halfedge_base[b] + mesh_of(b).halfedge_count();
+    }
+    if (vertex_base[count] >= invalid || halfedge_base[count] >= invalid) {
+        throw Error("tessellation too large");
+    }
+    Mesh::Arrays arrays;
+    arrays.positions = Buffer::allocate(ElementType::F64, 3 * vertex_base[count], 3);
+    arrays.corners = Buffer::allocate(ElementType::U32, halfedge_base[count], 3);
+    arrays.twins = Buffer::allocate(ElementType::U32, halfedge_base[count], 3);
+    arrays.vertex_halfedges = Buffer::allocate(ElementType::U32, vertex_base[count]);
+    const std::span<double> positions = arrays.positions.mutate<double>();
+    const std::span<std::uint32_t> corners = arrays.corners.mutate<std::uint32_t>();
+    const std::span<std::uint32_t> twins = arrays.twins.mutate<std::uint32_t>();
+    const std::span<std::uint32_t> outgoing = arrays.vertex_halfedges.mutate<std::uint32_t>();
+    const double* transforms = data_->arrays.transforms.view<double>().data();
+    parallel_for(pool, count, 1, [&](std::size_t begin, std::size_t end) {
+        const auto shift = [](std::uint32_t i, std::size_t base) {
+            return i == Mesh::invalid ? i : static_cast<std::uint32_t>(i + base);
+        };
+        for (std::size_t b = begin; b < end; ++b) {
+            const Mesh& mesh = mesh_of(b);
+            const double* m = transforms + 12 * b;
+            const std::span<const double> p = mesh.positions();
+            for (std::size_t v = 0; v < mesh.vertex_count(); ++v) {
+                for (int r = 0; r < 3; ++r) {
+                    positions[3 * (vertex_base[b] + v) + r] =
+                        m[4 * r] * p[3 * v] + m[4 * r + 1] * p[3 * v + 1] +
+                        m[4 * r + 2] * p[3 * v + 2] + m[4 * r + 3];
+                }
+                outgoing[vertex_base[b] + v] =
+                    shift(mesh.vertex_halfedges()[v], halfedge_base[b]);
+            }
+            for (std::size_t h = 0; h < mesh.halfedge_count(); ++h) {
+                corners[halfedge_base[b] + h] = shift(mesh.corners()[h], vertex_base[b]);
+                twins[halfedge_base[b] + h] = shift(mesh.twins()[h], halfedge_base[b]);
+            }
+        }
+    });
+    return Mesh::from_arrays(std::move(arrays));
+}
+
+bool Brep::is_tessellated(std::size_t body, double tolerance) const {
+    if (!(tolerance > 0) || !std::isfinite(tolerance)) {
+        return false;
+    }
+    const std::uint32_t shape = body_shape(body);
+    const std::lock_guard lock(data_->mutex);
+    return data_->tessellations.contains(std::pair(shape, tolerance_step(tolerance)));
+}
+
+std::size_t Brep::size_bytes() const noexcept {
+    const Arrays& a = data_->arrays;
+    std::size_t bytes = 0;
+    for (const Buffer* b : {&a.bodies, &a.transforms, &a.names, &a.shapes, &a.faces, &a.loops,
+                            &a.edge_uses, &a.edges, &a.vertices, &a.surfaces, &a.curves,
+                            &a.parameters}) {
+        bytes += b->size_bytes();
+    }
+    return bytes;
+}
+
+Digest Brep::content_digest() const {
+    const Arrays& a = data_->arrays;
+    Hasher hasher;
+    for (const Buffer* b : {&a.bodies, &a.transforms, &a.names, &a.shapes, &a.faces, &a.loops,
+                            &a.edge_uses, &a.edges, &a.vertices, &a.surfaces, &a.curves,
+                            &a.parameters}) {
+        hasher.update(b->content_digest());
+    }
+    return hasher.digest();
+}
+
+bool operator==(const Brep& a, const Brep& b) {
+    if (a.data_ == b.data_) {
+        return true;
+    }
+    const Brep::Arrays& x = a.data_->arrays;
+    const Brep::Arrays& y = b.data_->arrays;
+    return x.bodies == y.bodies && x.transforms == y.transforms && x.names == y.names &&
+           x.shapes == y.shapes && x.faces == y.faces && x.loops == y.loops &&
+           x.edge_uses == y.edge_uses && x.edges == y.edges && x.vertices == y.vertices &&
+           x.surfaces == y.surfaces && x.curves == y.curves && x.parameters == y.parameters;
+}
+
+} // namespace rebelflow
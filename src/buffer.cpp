@@ -0,0 +1,193 @@
+#include "rebelflow/buffer.hpp"
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+constexpr std::align_val_t buffer_alignment{64};
+
+struct AlignedDelete {
+    void operator()(std::byte* p) const noexcept { ::operator delete(p, buffer_alignment); }
+};
+
+thread_local BufferAllocator* current_allocator = nullptr;
+thread_local std::uint64_t bytes_allocated = 0;
+
+} // namespace
+
+ScopedBufferAllocator::ScopedBufferAllocator(BufferAllocator& allocator) noexcept
+    : previous_(std::exchange(current_allocator, &allocator)) {}
+
+ScopedBufferAllocator::~ScopedBufferAllocator() {
+    current_allocator = previous_;
+}
+
+const char* to_string(ElementType type) noexcept {
+    switch (type) {
+    case ElementType::U8: return "u8";
+    case ElementType::I32: return "i32";
+    case ElementType::U32: return "u32";
+    case ElementType::I64: return "i64";
+    case ElementType::F32: return "f32";
+    case ElementType::F64: return "f64";
+    }
+    return "?";
+}
+
+std::size_t element_size(ElementType type) noexcept {
+    switch (type) {
+    case ElementType::U8: return 1;
+    case ElementType::I32:
+    case ElementType::U32:
+    case ElementType::F32: return 4;
+    case ElementType::I64:
+    case ElementType::F64: return 8;
+    }
+    return 1;
+}
+
+Buffer Buffer::make(ElementType type, void* data, std::size_t count, std::uint32_t components,
+                    std::shared_ptr<const void> owner, bool writable) {
+    if (components == 0 || count % components != 0) {
+        throw Error("buffer of " + std::to_string(count) + " elements cannot hold tuples of " +
+                    std::to_string(components));
+    }
+    Buffer b;
+    b.storage_ = std::make_shared<Storage>();
+    b.storage_->data = static_cast<std::byte*>(data);
+    b.storage_->bytes = count * element_size(type);
+    b.storage_->owner = std::move(owner);
+    b.storage_->writable = writable;
+    b.count_ = count;
+    b.type_ = type;
+    b.components_ = components;
+    return b;
+}
+
+std::uint64_t buffer_bytes_allocated() noexcept {
+    return bytes_allocated;
+}
+
+Buffer Buffer::allocate(ElementType type, std::size_t count, std::uint32_t components) {
+    const std::size_t bytes = std::max<std::size_t>(count * element_size(type), 1);
+    bytes_allocated += bytes;
+    if (current_allocator != nullptr) {
+        std::shared_ptr<std::byte> owner = current_allocator->allocate(bytes);
+        std::byte* data = owner.get();
+        return make(type, data, count, components, std::move(owner), true);
+    }
+    std::shared_ptr<std::byte> owner(
+        static_cast<std::byte*>(::operator new(bytes, buffer_alignment)), AlignedDelete{});
+    std::byte* data = owner.get();
+    return make(type, data, count, components, std::move(owner), true);
+}
+
+Buffer Buffer::wrap(ElementType type, const void* data, std::size_t count,
+                    std::shared_ptr<const void> owner, std::uint32_t components) {
+    return make(type, const_cast<void*>(data), count, components, std::move(owner), false);
+}
+
+const std::byte* Buffer::bytes() const noexcept {
+    return storage_ ? storage_->data + offset_ * element_size(type_) : nullptr;
+}
+
+void Buffer::check_type(ElementType want) const {
+    if (want != type_) {
+        throw TypeError(std::string("buffer holds ") + to_string(type_) + ", not " +
+                        to_string(want));
+    }
+}
+
+std::byte* Buffer::mutable_bytes() {
+    if (!storage_) {
+        return nullptr;
+    }
+    if (!storage_->writable || storage_.use_count() != 1) {
+        Buffer copy = allocate(type_, count_, components_);
+        std::memcpy(copy.storage_->data, bytes(), size_bytes());
+        *this = std::move(copy);
+    } else {
+        // Sole owner: edit in place, but the memoized digest goes stale.
+        storage_->digest_ready.store(false, std::memory_order_relaxed);
+    }
+    return storage_->data + offset_ * element_size(type_);
+}
+
+Buffer Buffer::slice(std::size_t offset, std::size_t count) const {
+    if (offset > count_ || count > count_ - offset) {
+        throw Error("buffer slice [" + std::to_string(offset) + ", " +
+                    std::to_string(offset + count) + ") out of range of " +
+                    std::to_string(count_) + " elements");
+    }
+    if (offset % components_ != 0 || count % components_ != 0) {
+        throw Error("buffer slice must cover whole tuples");
+    }
+    Buffer b = *this;
+    b.offset_ = offset_ + offset;
+    b.count_ = count;
+    return b;
+}
+
+Buffer Buffer::concat(std::span<const Buffer> parts) {
+    if (parts.empty()) {
+        return {};
+    }
+    if (parts.size() == 1) {
+        return parts[0];
+    }
+    std::size_t count = 0;
+    for (const Buffer& part : parts) {
+        if (part.type_ != parts[0].type_ || part.components_ != parts[0].components_) {
+            throw TypeError("cannot concatenate buffers of different element types or shapes");
+        }
+        count += part.count_;
+    }
+    Buffer out = allocate(parts[0].type_, count, parts[0].components_);
+    std::byte* dst = out.mutable_bytes();
+    for (const Buffer& part : parts) {
+        if (part.count_ > 0) {
+            std::memcpy(dst, part.bytes(), part.size_bytes());
+            dst += part.size_bytes();
+        }
+    }
+    return out;
+}
+
+Digest Buffer::content_digest() const {
+    auto compute = [this] {
+        Hasher h;
+        h.update(std::uint64_t{static_cast<std::uint8_t>(type_)})
+            .update(std::uint64_t{components_})
+            .update(std::uint64_t{count_});
+        h.update(bytes(), size_bytes());
+        return h.digest();
+    };
+    const bool whole = storage_ && offset_ == 0 && size_bytes() == storage_->bytes;
+    if (!whole) {
+        return compute();
+    }
+    if (!storage_->digest_ready.load(std::memory_order_acquire)) {
+        std::lock_guard lock(storage_->digest_mutex);
+        if (!storage_->digest_ready.load(std::memory_order_relaxed)) {
+            storage_->digest = compute();
+            storage_->digest_ready.store(true, std::memory_order_release);
+        }
+    }
+    return storage_->digest;
+}
+
+bool operator==(const Buffer& a, const Buffer& b) {
+    if (a.type_ != b.type_ || a.components_ != b.components_ || a.count_ != b.count_) {
+        return false;
+    }
+    if (a.bytes() == b.bytes()) {
+        return true;
+    }
+    return std::memcmp(a.bytes(), b.bytes(), a.size_bytes()) == 0;
+}
+
+} // namespace rebelflow
@@ -0,0 +1,894 @@
+#include "rebelflow/bvh.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <mutex>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+using Point = Bvh::Point;
+
+constexpr double infinity = std::numeric_limits<double>::infinity();
+
+/// Centroid bins per axis when evaluating split candidates.
+constexpr std::size_t bin_count = 16;
+/// Ranges at least this large are binned in parallel ...
+constexpr std::size_t parallel_binning = std::size_t{1} << 16;
+/// ... and split into subtrees built as separate tasks.
+constexpr std::size_t parallel_subtree = std::size_t{1} << 12;
+/// From this depth on, nodes split at the median, which bounds the depth of
+/// the tree and so the traversal stacks.
+constexpr std::size_t median_depth = 48;
+constexpr std::size_t stack_capacity = 128;
+
+Point sub(const Point& a, const Point& b) noexcept {
+    return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+Point add_scaled(const Point& a, const Point& d, double t) noexcept {
+    return {a[0] + d[0] * t, a[1] + d[1] * t, a[2] + d[2] * t};
+}
+double dot(const Point& a, const Point& b) noexcept {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+Point cross(const Point& a, const Point& b) noexcept {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+double distance2(const Point& a, const Point& b) noexcept {
+    const Point d = sub(a, b);
+    return dot(d, d);
+}
+
+struct Box {
+    Point lo{infinity, infinity, infinity};
+    Point hi{-infinity, -infinity, -infinity};
+
+    void grow(const Point& p) noexcept {
+        for (int i = 0; i < 3; ++i) {
+            lo[i] = std::min(lo[i], p[i]);
+            hi[i] = std::max(hi[i], p[i]);
+        }
+    }
+    void grow(const Box& b) noexcept {
+        for (int i = 0; i < 3; ++i) {
+            lo[i] = std::min(lo[i], b.lo[i]);
+            hi[i] = std::max(hi[i], b.hi[i]);
+        }
+    }
+    /// Half the surface area; all the heuristic needs are ratios.
+    double area() const noexcept {
+        if (lo[0] > hi[0]) {
+            return 0;
+        }
+        const Point d = sub(hi, lo);
+        return d[0] * d[1] + d[1] * d[2] + d[2] * d[0];
+    }
+};
+
+struct Triangle {
+    Point a;
+    Point b;
+    Point c;
+};
+
+Triangle triangle_of(const Mesh& mesh, std::uint32_t t) noexcept {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> corners = mesh.corners();
+    const auto at = [&](std::uint32_t v) { return Point{p[3 * v], p[3 * v + 1], p[3 * v + 2]}; };
+    return {at(corners[3 * t]), at(corners[3 * t + 1]), at(corners[3 * t + 2])};
+}
+
+float round_down(double x) noexcept {
+    const auto f = static_cast<float>(x);
+    return static_cast<double>(f) > x ? std::nextafter(f, -std::numeric_limits<float>::infinity())
+                                      : f;
+}
+
+float round_up(double x) noexcept {
+    const auto f = static_cast<float>(x);
+    return static_cast<double>(f) < x ? std::nextafter(f, std::numeric_limits<float>::infinity())
+                                       : f;
+}
+
+/// Top-down binned SAH build into a temporary tree, children anywhere.
+class Builder {
+public:
+    struct Node {
+        Box box;
+        std::uint32_t left = Mesh::invalid; // right child is left + 1
+        std::uint32_t begin = 0;
+        std::uint32_t count = 0;
+    };
+
+    Builder(const Mesh& mesh, ThreadPool* pool, std::size_t max_leaf_size)
+        : pool_(pool), max_leaf_(std::max<std::size_t>(max_leaf_size, 1)) {
+        const std::size_t n = mesh.face_count();
+        boxes_.resize(n);
+        centroids_.resize(n);
+        order_.resize(n);
+        nodes_.resize(std::max<std::size_t>(2 * n, 1));
+        parallel_for(pool, n, parallel_binning / 4, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t t = begin; t < end; ++t) {
+                const Triangle tri = triangle_of(mesh, static_cast<std::uint32_t>(t));
+                Box box;
+                box.grow(tri.a);
+                box.grow(tri.b);
+                box.grow(tri.c);
+                boxes_[t] = box;
+                for (int i = 0; i < 3; ++i) {
+                    centroids_[t][i] = (box.lo[i] + box.hi[i]) * 0.5;
+                }
+                order_[t] = static_cast<std::uint32_t>(t);
+            }
+        });
+    }
+
+    void run() {
+        next_ = 1;
+        build(0, 0, static_cast<std::uint32_t>(order_.size()), 0);
+    }
+
+    const std::vector<Node>& nodes() const noexcept { return nodes_; }
+    std::vector<std::uint32_t>& order() noexcept { return order_; }
+
+private:
+    struct Bin {
+        Box box;
+        std::uint32_t count = 0;
+    };
+    using Bins = std::array<std::array<Bin, bin_count>, 3>;
+
+    struct Bounds {
+        Box box;
+        Box centroids;
+    };
+
+    Bounds bounds(std::uint32_t begin, std::uint32_t end) const {
+        const auto scan = [&](std::size_t b, std::size_t e) {
+            Bounds out;
+            for (std::size_t i = b; i < e; ++i) {
+                out.box.grow(boxes_[order_[i]]);
+                out.centroids.grow(centroids_[order_[i]]);
+            }
+            return out;
+        };
+        if (pool_ == nullptr || end - begin < parallel_binning) {
+            return scan(begin, end);
+        }
+        Bounds total;
+        std::mutex mutex;
+        parallel_for(pool_, end - begin, parallel_binning / 4, [&](std::size_t b, std::size_t e) {
+            const Bounds part = scan(begin + b, begin + e);
+            const std::lock_guard lock(mutex);
+            total.box.grow(part.box);
+            total.centroids.grow(part.centroids);
+        });
+        return total;
+    }
+
+    Bins bin(std::uint32_t begin, std::uint32_t end, const Point& origin,
+             const Point& scale) const {
+        const auto scan = [&](std::size_t b, std::size_t e) {
+            Bins out{};
+            for (std::size_t i = b; i < e; ++i) {
+                const std::uint32_t t = order_[i];
+                for (int axis = 0; axis < 3; ++axis) {
+                    Bin& slot = out[axis][bin_index(centroids_[t], axis, origin, scale)];
+                    slot.box.grow(boxes_[t]);
+                    ++slot.count;
+                }
+            }
+            return out;
+        };
+        if (pool_ == nullptr || end - begin < parallel_binning) {
+            return scan(begin, end);
+        }
+        Bins total{};
+        std::mutex mutex;
+        parallel_for(pool_, end - begin, parallel_binning / 4, [&](std::size_t b, std::size_t e) {
+            const Bins part = scan(begin + b, begin + e);
+            const std::lock_guard lock(mutex);
+            for (int axis = 0; axis < 3; ++axis) {
+                for (std::size_t k = 0; k < bin_count; ++k) {
+                    total[axis][k].box.grow(part[axis][k].box);
+                    total[axis][k].count += part[axis][k].count;
+                }
+            }
+        });
+        return total;
+    }
+
+    static std::size_t bin_index(const Point& c, int axis, const Point& origin,
+                                 const Point& scale) noexcept {
+        const double x = (c[axis] - origin[axis]) * scale[axis];
+        return std::min(static_cast<std::size_t>(std::max(x, 0.0)), bin_count - 1);
+    }
+
+    void leaf(std::uint32_t node, std::uint32_t begin, std::uint32_t end) {
+        nodes_[node].begin = begin;
+        nodes_[node].count = end - begin;
+    }
+
+    void build(std::uint32_t node, std::uint32_t begin, std::uint32_t end, std::size_t depth) {
+        const std::uint32_t count = end - begin;
+        const Bounds b = bounds(begin, end);
+        nodes_[node].box = b.box;
+        if (count <= 1) {
+            leaf(node, begin, end);
+            return;
+        }
+
+        std::uint32_t mid = begin + count / 2;
+        const Point extent = sub(b.centroids.hi, b.centroids.lo);
+        const int widest = extent[0] >= extent[1] && extent[0] >= extent[2] ? 0
+                           : extent[1] >= extent[2]                         ? 1
+                                                                            : 2;
+        if (!(extent[widest] > 0)) {
+            // All centroids coincide: no split separates anything.
+            if (count <= max_leaf_) {
+                leaf(node, begin, end);
+                return;
+            }
+        } else if (depth >= median_depth) {
+            const auto by_axis = [&](std::uint32_t x, std::uint32_t y) {
+                return centroids_[x][widest] < centroids_[y][widest];
+            };
+            std::nth_element(order_.begin() + begin, order_.begin() + mid, order_.begin() + end,
+                             by_axis);
+        } else {
+            Point scale;
+            for (int axis = 0; axis < 3; ++axis) {
+                scale[axis] = extent[axis] > 0 ? bin_count / extent[axis] : 0.0;
+            }
+            const Bins bins = bin(begin, end, b.centroids.lo, scale);
+
+            // Cost of splitting after bin k: left area x count + right area x
+            // count, in units of one triangle test per unit of parent area.
+            double best_cost = infinity;
+            int best_axis = 0;
+            std::size_t best_split = 0;
+            for (int axis = 0; axis < 3; ++axis) {
+                if (!(extent[axis] > 0)) {
+                    continue;
+                }
+                std::array<double, bin_count> right_cost{};
+                Box right;
+                std::uint32_t right_count = 0;
+                for (std::size_t k = bin_count - 1; k > 0; --k) {
+                    right.grow(bins[axis][k].box);
+                    right_count += bins[axis][k].count;
+                    right_cost[k - 1] = right.area() * right_count;
+                }
+                Box left;
+                std::uint32_t left_count = 0;
+                for (std::size_t k = 0; k + 1 < bin_count; ++k) {
+                    left.grow(bins[axis][k].box);
+                    left_count += bins[axis][k].count;
+                    if (left_count == 0 || left_count == count) {
+                        continue;
+                    }
+                    const double cost = left.area() * left_count + right_cost[k];
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_axis = axis;
+                        best_split = k;
+                    }
+                }
+            }
+            // A leaf costs one test per triangle; a split one traversal step
+            // plus the tests weighted by the odds of entering each child.
+            const double area = b.box.area();
+            const double split_cost = 1.0 + (area > 0 ? best_cost / area : 0.0);
+            if (count <= max_leaf_ && split_cost >= count) {
+                leaf(node, begin, end);
+                return;
+            }
+            if (best_cost < infinity) {
+                const auto it = std::partition(
+                    order_.begin() + begin, order_.begin() + end, [&](std::uint32_t t) {
+                        return bin_index(centroids_[t], best_axis, b.centroids.lo, scale) <=
+                               best_split;
+                    });
+                mid = static_cast<std::uint32_t>(it - order_.begin());
+            }
+        }
+
+        const std::uint32_t left = next_.fetch_add(2, std::memory_order_relaxed);
+        nodes_[node].left = left;
+        if (pool_ != nullptr && count >= parallel_subtree) {
+            TaskGroup group(*pool_);
+            group.run([=, this] { build(left, begin, mid, depth + 1); });
+            build(left + 1, mid, end, depth + 1);
+            group.wait();
+        } else {
+            build(left, begin, mid, depth + 1);
+            build(left + 1, mid, end, depth + 1);
+        }
+    }
+
+    ThreadPool* pool_;
+    std::size_t max_leaf_;
+    std::vector<Box> boxes_;
+    std::vector<Point> centroids_;
+    std::vector<std::uint32_t> order_;
+    std::vector<Node> nodes_;
+    std::atomic<std::uint32_t> next_{0};
+};
+
+// ---------------------------------------------------------------------------
+// Geometric primitives
+
+/// Möller-Trumbore, from either side. Returns t along the ray, or infinity.
+double ray_triangle(const Point& origin, const Point& direction, const Triangle& tri,
+                    double& u, double& v) noexcept {
+    const Point e1 = sub(tri.b, tri.a);
+    const Point e2 = sub(tri.c, tri.a);
+    const Point p = cross(direction, e2);
+    const double det = dot(e1, p);
+    if (det == 0) {
+        return infinity;
+    }
+    const double inverse = 1.0 / det;
+    const Point s = sub(origin, tri.a);
+    u = dot(s, p) * inverse;
+    if (u < 0 || u > 1) {
+        return infinity;
+    }
+    const Point q = cross(s, e1);
+    v = dot(direction, q) * inverse;
+    if (v < 0 || u + v > 1) {
+        return infinity;
+    }
+    const double t = dot(e2, q) * inverse;
+    return t >= 0 ? t : infinity;
+}
+
+/// The point of `tri` nearest to `p` (Ericson, Real-Time Collision
+/// Detection, 5.1.5).
+Point closest_on_triangle(const Point& p, const Triangle& tri) noexcept {
+    const Point ab = sub(tri.b, tri.a);
+    const Point ac = sub(tri.c, tri.a);
+    const Point ap = sub(p, tri.a);
+    const double d1 = dot(ab, ap);
+    const double d2 = dot(ac, ap);
+    if (d1 <= 0 && d2 <= 0) {
+        return tri.a;
+    }
+    const Point bp = sub(p, tri.b);
+    const double d3 = dot(ab, bp);
+    const double d4 = dot(ac, bp);
+    if (d3 >= 0 && d4 <= d3) {
+        return tri.b;
+    }
+    const double vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+        return add_scaled(tri.a, ab, d1 / (d1 - d3));
+    }
+    const Point cp = sub(p, tri.c);
+    const double d5 = dot(ab, cp);
+    const double d6 = dot(ac, cp);
+    if (d6 >= 0 && d5 <= d6) {
+        return tri.c;
+    }
+    const double vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+        return add_scaled(tri.a, ac, d2 / (d2 - d6));
+    }
+    const double va = d3 * d6 - d5 * d4;
+    if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+        return add_scaled(tri.b, sub(tri.c, tri.b), (d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const double denom = 1.0 / (va + vb + vc);
+    const double v = vb * denom;
+    const double w = vc * denom;
+    return add_scaled(add_scaled(tri.a, ab, v), ac, w);
+}
+
+/// Squared distance between segments p1q1 and p2q2 (Ericson, 5.1.9).
+double segment_distance2(const Point& p1, const Point& q1, const Point& p2,
+                         const Point& q2) noexcept {
+    const Point d1 = sub(q1, p1);
+    const Point d2 = sub(q2, p2);
+    const Point r = sub(p1, p2);
+    const double a = dot(d1, d1);
+    const double e = dot(d2, d2);
+    const double f = dot(d2, r);
+    double s = 0;
+    double t = 0;
+    if (a <= 0 && e <= 0) {
+        return dot(r, r);
+    }
+    if (a <= 0) {
+        t = std::clamp(f / e, 0.0, 1.0);
+    } else {
+        const double c = dot(d1, r);
+        if (e <= 0) {
+            s = std::clamp(-c / a, 0.0, 1.0);
+        } else {
+            const double b = dot(d1, d2);
+            const double denom = a * e - b * b;
+            s = denom > 0 ? std::clamp((b * f - c * e) / denom, 0.0, 1.0) : 0.0;
+            t = (b * s + f) / e;
+            if (t < 0) {
+                t = 0;
+                s = std::clamp(-c / a, 0.0, 1.0);
+            } else if (t > 1) {
+                t = 1;
+                s = std::clamp((b - c) / a, 0.0, 1.0);
+            }
+        }
+    }
+    return distance2(add_scaled(p1, d1, s), add_scaled(p2, d2, t));
+}
+
+bool segment_crosses(const Point& p, const Point& q, const Triangle& tri) noexcept {
+    double u = 0;
+    double v = 0;
+    return ray_triangle(p, sub(q, p), tri, u, v) <= 1.0;
+}
+
+/// Distance between two triangles: zero if an edge of one passes through
+/// the other, else the least of the edge-edge and vertex-triangle
+/// distances.
+double triangle_distance(const Triangle& a, const Triangle& b) noexcept {
+    const Point pa[3] = {a.a, a.b, a.c};
+    const Point pb[3] = {b.a, b.b, b.c};
+    for (int i = 0; i < 3; ++i) {
+        if (segment_crosses(pa[i], pa[(i + 1) % 3], b) ||
+            segment_crosses(pb[i], pb[(i + 1) % 3], a)) {
+            return 0;
+        }
+    }
+    double best = infinity;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            best = std::min(best,
+                            segment_distance2(pa[i], pa[(i + 1) % 3], pb[j], pb[(j + 1) % 3]));
+        }
+        best = std::min(best, distance2(pa[i], closest_on_triangle(pa[i], b)));
+        best = std::min(best, distance2(pb[i], closest_on_triangle(pb[i], a)));
+    }
+    return std::sqrt(best);
+}
+
+bool shares_vertex(const Mesh& mesh, std::uint32_t s, std::uint32_t t) noexcept {
+    const std::span<const std::uint32_t> c = mesh.corners();
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 3; ++j) {
+            if (c[3 * s + i] == c[3 * t + j]) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/// A fixed-capacity traversal stack; build() keeps trees shallower.
+class NodeStack {
+public:
+    bool empty() const noexcept { return size_ == 0; }
+    void push(std::uint32_t node) noexcept { nodes_[size_++] = node; }
+    std::uint32_t pop() noexcept { return nodes_[--size_]; }
+
+private:
+    std::array<std::uint32_t, stack_capacity> nodes_;
+    std::size_t size_ = 0;
+};
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Bvh
+
+Bvh::Bvh() : Bvh([] {
+    static const std::shared_ptr<const Arrays> empty = std::make_shared<const Arrays>(
+        Arrays{Mesh(), Buffer::allocate(ElementType::F32, 0, 6),
+               Buffer::allocate(ElementType::U32, 0, 2), Buffer::allocate(ElementType::U32, 0)});
+    return empty;
+}()) {}
+
+Bvh::Bvh(std::shared_ptr<const Arrays> data) noexcept
+    : data_(std::move(data)),
+      bounds_(reinterpret_cast<const float*>(data_->bounds.bytes())),
+      links_(reinterpret_cast<const std::uint32_t*>(data_->links.bytes())),
+      triangles_(reinterpret_cast<const std::uint32_t*>(data_->triangles.bytes())) {}
+
+Bvh Bvh::build(const Mesh& mesh, ThreadPool* pool, std::size_t max_leaf_size) {
+    Arrays arrays;
+    arrays.mesh = mesh;
+    if (mesh.face_count() == 0) {
+        arrays.bounds = Buffer::allocate(ElementType::F32, 0, 6);
+        arrays.links = Buffer::allocate(ElementType::U32, 0, 2);
+        arrays.triangles = Buffer::allocate(ElementType::U32, 0);
+        return Bvh(std::make_shared<const Arrays>(std::move(arrays)));
+    }
+    Builder builder(mesh, pool, max_leaf_size);
+    builder.run();
+
+    // Depth first, children side by side.
+    const std::vector<Builder::Node>& nodes = builder.nodes();
+    std::vector<float> bounds;
+    std::vector<std::uint32_t> links;
+    std::vector<std::pair<std::uint32_t, std::uint32_t>> stack = {{0, 0}}; // built, laid out
+    std::uint32_t next = 1;
+    while (!stack.empty()) {
+        const auto [from, to] = stack.back();
+        stack.pop_back();
+        const Builder::Node& node = nodes[from];
+        if (bounds.size() < 6 * (to + 1)) {
+            bounds.resize(6 * (to + 1));
+            links.resize(2 * (to + 1));
+        }
+        for (int i = 0; i < 3; ++i) {
+            bounds[6 * to + i] = round_down(node.box.lo[i]);
+            bounds[6 * to + 3 + i] = round_up(node.box.hi[i]);
+        }
+        if (node.left == Mesh::invalid) {
+            links[2 * to] = node.begin;
+            links[2 * to + 1] = node.count;
+            continue;
+        }
+        links[2 * to] = next;
+        links[2 * to + 1] = 0;
+        stack.emplace_back(node.left + 1, next + 1);
+        stack.emplace_back(node.left, next);
+        next += 2;
+    }
+    arrays.bounds = Buffer::adopt(std::move(bounds), 6);
+    arrays.links = Buffer::adopt(std::move(links), 2);
+    arrays.triangles = Buffer::adopt(std::move(builder.order()));
+    return Bvh(std::make_shared<const Arrays>(std::move(arrays)));
+}
+
+Bvh Bvh::from_arrays(Arrays arrays) {
+    const auto check = [](bool ok, const char* what) {
+        if (!ok) {
+            throw FormatError(std::string("inconsistent bvh: ") + what);
+        }
+    };
+    check(arrays.bounds.element_type() == ElementType::F32 && arrays.bounds.components() == 6,
+          "bounds are not f32 x 6");
+    check(arrays.links.element_type() == ElementType::U32 && arrays.links.components() == 2,
+          "links are not u32 pairs");
+    check(arrays.triangles.element_type() == ElementType::U32, "triangles are not u32");
+    const std::size_t nodes = arrays.links.tuples();
+    check(arrays.bounds.tuples() == nodes && arrays.bounds.size() == 6 * nodes &&
+              arrays.links.size() == 2 * nodes,
+          "one box and one link per node");
+    check(arrays.triangles.size() == arrays.mesh.face_count(), "one entry per triangle");
+    check((nodes == 0) == (arrays.mesh.face_count() == 0), "empty tree for a non-empty mesh");
+    const std::span<const std::uint32_t> links = arrays.links.view<std::uint32_t>();
+    for (std::size_t i = 0; i < nodes; ++i) {
+        const std::uint64_t first = links[2 * i];
+        const std::uint64_t count = links[2 * i + 1];
+        // Children come after their parent, so there are no cycles.
+        check(count != 0 ? first + count <= arrays.triangles.size()
+                         : first > i && first + 1 < nodes,
+              "link out of range");
+    }
+    for (const std::uint32_t t : arrays.triangles.view<std::uint32_t>()) {
+        check(t < arrays.mesh.face_count(), "triangle out of range");
+    }
+    return Bvh(std::make_shared<const Arrays>(std::move(arrays)));
+}
+
+Bvh::RayHit Bvh::raycast(const Point& origin, const Point& direction, double max_distance) const {
+    RayHit best;
+    if (node_count() == 0) {
+        return best;
+    }
+    const Point inverse = {1.0 / direction[0], 1.0 / direction[1], 1.0 / direction[2]};
+    double limit = max_distance;
+    // Entry distance of the ray into a node's box, or infinity.
+    const auto enter = [&](std::uint32_t node) {
+        const float* b = bounds_ + 6 * node;
+        double near = 0;
+        double far = limit;
+        for (int i = 0; i < 3; ++i) {
+            const double t1 = (b[i] - origin[i]) * inverse[i];
+            const double t2 = (b[3 + i] - origin[i]) * inverse[i];
+            near = std::max(near, std::min(t1, t2));
+            far = std::min(far, std::max(t1, t2));
+        }
+        return near <= far ? near : infinity;
+    };
+
+    NodeStack stack;
+    if (enter(0) < infinity) {
+        stack.push(0);
+    }
+    while (!stack.empty()) {
+        const std::uint32_t node = stack.pop();
+        if (node != 0 && enter(node) == infinity) {
+            continue; // beyond a hit found since it was queued
+        }
+        const std::uint32_t first = links_[2 * node];
+        const std::uint32_t count = links_[2 * node + 1];
+        if (count != 0) {
+            for (std::uint32_t i = first; i < first + count; ++i) {
+                double u = 0;
+                double v = 0;
+                const double t =
+                    ray_triangle(origin, direction, triangle_of(mesh(), triangles_[i]), u, v);
+                if (t < best.distance && t <= limit) {
+                    limit = t;
+                    best = {t, triangles_[i], u, v};
+                }
+            }
+            continue;
+        }
+        // Nearer child on top.
+        const double left = enter(first);
+        const double right = enter(first + 1);
+        if (left <= right) {
+            if (right < infinity) {
+                stack.push(first + 1);
+            }
+            if (left < infinity) {
+                stack.push(first);
+            }
+        } else {
+            if (left < infinity) {
+                stack.push(first);
+            }
+            stack.push(first + 1);
+        }
+    }
+    return best;
+}
+
+std::size_t Bvh::crossings(const Point& origin, const Point& direction) const {
+    std::size_t hits = 0;
+    if (node_count() == 0) {
+        return hits;
+    }
+    const Point inverse = {1.0 / direction[0], 1.0 / direction[1], 1.0 / direction[2]};
+    const auto enters = [&](std::uint32_t node) {
+        const float* b = bounds_ + 6 * node;
+        double near = 0;
+        double far = infinity;
+        for (int i = 0; i < 3; ++i) {
+            const double t1 = (b[i] - origin[i]) * inverse[i];
+            const double t2 = (b[3 + i] - origin[i]) * inverse[i];
+            near = std::max(near, std::min(t1, t2));
+            far = std::min(far, std::max(t1, t2));
+        }
+        return near <= far;
+    };
+
+    NodeStack stack;
+    stack.push(0);
+    while (!stack.empty()) {
+        const std::uint32_t node = stack.pop();
+        if (!enters(node)) {
+            continue;
+        }
+        const std::uint32_t first = links_[2 * node];
+        const std::uint32_t count = links_[2 * node + 1];
+        if (count == 0) {
+            stack.push(first + 1);
+            stack.push(first);
+            continue;
+        }
+        for (std::uint32_t i = first; i < first + count; ++i) {
+            double u = 0;
+            double v = 0;
+            if (ray_triangle(origin, direction, triangle_of(mesh(), triangles_[i]), u, v) <
+                infinity) {
+                ++hits;
+            }
+        }
+    }
+    return hits;
+}
+
+Bvh::Nearest Bvh::closest_point(const Point& query, double max_distance) const {
+    Nearest best;
+    if (node_count() == 0) {
+        return best;
+    }
+    double limit2 = max_distance * max_distance;
+    const auto box_distance2 = [&](std::uint32_t node) {
+        const float* b = bounds_ + 6 * node;
+        double d2 = 0;
+        for (int i = 0; i < 3; ++i) {
+            const double d = std::max({b[i] - query[i], query[i] - b[3 + i], 0.0});
+            d2 += d * d;
+        }
+        return d2;
+    };
+
+    NodeStack stack;
+    stack.push(0);
+    while (!stack.empty()) {
+        const std::uint32_t node = stack.pop();
+        if (box_distance2(node) > limit2) {
+            continue;
+        }
+        const std::uint32_t first = links_[2 * node];
+        const std::uint32_t count = links_[2 * node + 1];
+        if (count != 0) {
+            for (std::uint32_t i = first; i < first + count; ++i) {
+                const Point p = closest_on_triangle(query, triangle_of(mesh(), triangles_[i]));
+                const double d2 = distance2(p, query);
+                if (d2 <= limit2) {
+                    limit2 = d2;
+                    best = {p, d2, triangles_[i]};
+                }
+            }
+            continue;
+        }
+        const double left = box_distance2(first);
+        const double right = box_distance2(first + 1);
+        const std::uint32_t near = left <= right ? first : first + 1;
+        const std::uint32_t far = left <= right ? first + 1 : first;
+        if (std::max(left, right) <= limit2) {
+            stack.push(far);
+        }
+        if (std::min(left, right) <= limit2) {
+            stack.push(near);
+        }
+    }
+    best.distance = std::sqrt(best.distance);
+    return best;
+}
+
+std::vector<Bvh::Overlap> Bvh::overlaps(const Bvh& other, double tolerance,
+                                        ThreadPool* pool) const {
+    return pairs(other, tolerance, false, pool);
+}
+
+std::vector<Bvh::Overlap> Bvh::self_overlaps(double tolerance, ThreadPool* pool) const {
+    return pairs(*this, tolerance, true, pool);
+}
+
+std::vector<Bvh::Overlap> Bvh::pairs(const Bvh& other, double tolerance, bool self,
+                                     ThreadPool* pool) const {
+    if (node_count() == 0 || other.node_count() == 0 || !(tolerance >= 0)) {
+        return {};
+    }
+    using Pair = std::pair<std::uint32_t, std::uint32_t>;
+    const double tolerance2 = tolerance * tolerance;
+    const auto box_distance2 = [&](std::uint32_t a, std::uint32_t b) {
+        const float* x = bounds_ + 6 * a;
+        const float* y = other.bounds_ + 6 * b;
+        double d2 = 0;
+        for (int i = 0; i < 3; ++i) {
+            const double d = std::max({static_cast<double>(x[i]) - y[3 + i],
+                                       static_cast<double>(y[i]) - x[3 + i], 0.0});
+            d2 += d * d;
+        }
+        return d2;
+    };
+    const auto area = [](const float* b) {
+        const double dx = b[3] - b[0];
+        const double dy = b[4] - b[1];
+        const double dz = b[5] - b[2];
+        return dx * dy + dy * dz + dz * dx;
+    };
+
+    // One step of the simultaneous descent: tests a pair of leaves, or
+    // queues the pairs of children that may hold close triangles. In self
+    // mode a node paired with itself stands for the pairs within it.
+    const auto step = [&](const Pair& p, std::vector<Pair>& queue, std::vector<Overlap>& found) {
+        const auto [a, b] = p;
+        const bool same = self && a == b;
+        if (!same && box_distance2(a, b) > tolerance2) {
+            return;
+        }
+        const std::uint32_t a_first = links_[2 * a];
+        const std::uint32_t a_count = links_[2 * a + 1];
+        const std::uint32_t b_first = other.links_[2 * b];
+        const std::uint32_t b_count = other.links_[2 * b + 1];
+        if (same) {
+            if (a_count != 0) {
+                for (std::uint32_t i = a_first; i < a_first + a_count; ++i) {
+                    for (std::uint32_t j = i + 1; j < a_first + a_count; ++j) {
+                        const std::uint32_t s = std::min(triangles_[i], triangles_[j]);
+                        const std::uint32_t t = std::max(triangles_[i], triangles_[j]);
+                        if (shares_vertex(mesh(), s, t)) {
+                            continue;
+                        }
+                        const double d = triangle_distance(triangle_of(mesh(), s),
+                                                           triangle_of(mesh(), t));
+                        if (d <= tolerance) {
+                            found.push_back({s, t, d});
+                        }
+                    }
+                }
+            } else {
+                queue.emplace_back(a_first, a_first);
+                queue.emplace_back(a_first + 1, a_first + 1);
+                queue.emplace_back(a_first, a_first + 1);
+            }
+            return;
+        }
+        if (a_count != 0 && b_count != 0) {
+            for (std::uint32_t i = a_first; i < a_first + a_count; ++i) {
+                for (std::uint32_t j = b_first; j < b_first + b_count; ++j) {
+                    std::uint32_t s = triangles_[i];
+                    std::uint32_t t = other.triangles_[j];
+                    if (self) {
+                        if (s > t) {
+                            std::swap(s, t);
+                        }
+                        if (shares_vertex(mesh(), s, t)) {
+                            continue;
+                        }
+                    }
+                    const double d = triangle_distance(triangle_of(mesh(), s),
+                                                       triangle_of(other.mesh(), t));
+                    if (d <= tolerance) {
+                        found.push_back({s, t, d});
+                    }
+                }
+            }
+            return;
+        }
+        // Descend into the larger of the two.
+        if (b_count != 0 || (a_count == 0 && area(bounds_ + 6 * a) >= area(other.bounds_ + 6 * b))) {
+            queue.emplace_back(a_first, b);
+            queue.emplace_back(a_first + 1, b);
+        } else {
+            queue.emplace_back(a, b_first);
+            queue.emplace_back(a, b_first + 1);
+        }
+    };
+
+    // Breadth first until there are enough pairs to share out, then depth
+    // first per range of them.
+    std::vector<Overlap> found;
+    std::vector<Pair> frontier = {{0, 0}};
+    const std::size_t target = pool != nullptr ? std::size_t{64} * pool->size() : 0;
+    while (!frontier.empty() && frontier.size() < target) {
+        std::vector<Pair> next;
+        for (const Pair& p : frontier) {
+            step(p, next, found);
+        }
+        frontier = std::move(next);
+    }
+    std::mutex mutex;
+    parallel_for(pool, frontier.size(), 1, [&](std::size_t begin, std::size_t end) {
+        std::vector<Pair> stack(frontier.begin() + static_cast<std::ptrdiff_t>(begin),
+                                frontier.begin() + static_cast<std::ptrdiff_t>(end));
+        std::vector<Overlap> local;
+        while (!stack.empty()) {
+            const Pair p = stack.back();
+            stack.pop_back();
+            step(p, stack, local);
+        }
+        const std::lock_guard lock(mutex);
+        found.insert(found.end(), local.begin(), local.end());
+    });
+    std::sort(found.begin(), found.end(), [](const Overlap& x, const Overlap& y) {
+        return std::pair(x.first, x.second) < std::pair(y.first, y.second);
+    });
+    return found;
+}
+
+std::size_t Bvh::size_bytes() const noexcept {
+    return data_->mesh.size_bytes() + data_->bounds.size_bytes() + data_->links.size_bytes() +
+           data_->triangles.size_bytes();
+}
+
+Digest Bvh::content_digest() const {
+    Hasher hasher;
+    hasher.update(data_->mesh.content_digest());
+    hasher.update(data_->bounds.content_digest()).update(data_->links.content_digest());
+    hasher.update(data_->triangles.content_digest());
+    return hasher.digest();
+}
+
+bool operator==(const Bvh& a, const Bvh& b) {
+    return a.data_ == b.data_ ||
+           (a.data_->mesh == b.data_->mesh && a.data_->bounds == b.data_->bounds &&
+            a.data_->links == b.data_->links && a.data_->triangles == b.data_->triangles);
+}
+
+} // namespace rebelflow
@@ -0,0 +1,836 @@
+#include "rebelflow/compiled_plan.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+/// Row `row` of a column as a scalar. U8 columns hold bools.
+Value element_of(const Buffer& column, std::size_t row) {
+    switch (column.element_type()) {
+    case ElementType::U8: return column.view<std::uint8_t>()[row] != 0;
+    case ElementType::I32: return column.view<std::int32_t>()[row];
+    case ElementType::U32: return column.view<std::uint32_t>()[row];
+    case ElementType::I64: return column.view<std::int64_t>()[row];
+    case ElementType::F32: return column.view<float>()[row];
+    case ElementType::F64: return column.view<double>()[row];
+    }
+    return {};
+}
+
+/// Packs per-row scalars into the narrowest column that holds them all:
+/// U8 for bools, I64 for ints, F64 once any float appears.
+Buffer to_column(const std::vector<Value>& values) {
+    bool bools = false;
+    bool ints = false;
+    bool floats = false;
+    for (const Value& v : values) {
+        const DataType t = v.type();
+        if (t != DataType::Bool && t != DataType::Int && t != DataType::Float) {
+            throw TypeError(std::string("batch outputs must be bool, int or float, got ") +
+                            to_string(t));
+        }
+        bools |= t == DataType::Bool;
+        ints |= t == DataType::Int;
+        floats |= t == DataType::Float;
+    }
+    if (bools && (ints || floats)) {
+        throw TypeError("batch output mixes bool and numeric rows");
+    }
+    const DataType kind = bools ? DataType::Bool : ints && !floats ? DataType::Int
+                                                                   : DataType::Float;
+    if (kind == DataType::Bool) {
+        Buffer column = Buffer::allocate(ElementType::U8, values.size());
+        std::span<std::uint8_t> out = column.mutate<std::uint8_t>();
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            out[i] = values[i].as_bool() ? 1 : 0;
+        }
+        return column;
+    }
+    if (kind == DataType::Int) {
+        Buffer column = Buffer::allocate(ElementType::I64, values.size());
+        std::span<std::int64_t> out = column.mutate<std::int64_t>();
+        for (std::size_t i = 0; i < values.size(); ++i) {
+            out[i] = values[i].as_int();
+        }
+        return column;
+    }
+    Buffer column = Buffer::allocate(ElementType::F64, values.size());
+    std::span<double> out = column.mutate<double>();
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        out[i] = values[i].as_float();
+    }
+    return column;
+}
+
+/// Output values a fused script can take as constants.
+bool is_foldable(const Value& v) {
+    switch (v.type()) {
+    case DataType::Bool:
+    case DataType::Int:
+    case DataType::Float: return true;
+    case DataType::Buffer: {
+        const Buffer& b = v.as_buffer();
+        return b.size() == 3 &&
+               (b.element_type() == ElementType::F32 || b.element_type() == ElementType::F64);
+    }
+    default: return false;
+    }
+}
+
+/// Output port types whose values can be folded. Buffer ports are left out:
+/// their values may be of any size, and a generator such as `Range` is not
+/// worth running at compile time for the rare 3-vector. Vector constants
+/// come from `Any` ports, like `Constant`'s.
+bool is_foldable_type(DataType type) {
+    switch (type) {
+    case DataType::Any:
+    case DataType::Bool:
+    case DataType::Int:
+    case DataType::Float: return true;
+    default: return false;
+    }
+}
+
+bool is_expression(const NodeType& type) {
+    return type.expression && type.outputs.size() == 1 &&
+           type.inputs.size() <= Script::max_inputs;
+}
+
+/// Evaluates a node whose inputs are all unconnected, outside any run.
+std::vector<Value> run_alone(const NodeType& type, NodeId node, std::span<const Value> params,
+                             Arena& arena) {
+    std::vector<const Value*> inputs;
+    for (const PortSpec& port : type.inputs) {
+        inputs.push_back(&port.default_value);
+    }
+    std::vector<Value> outputs(type.outputs.size());
+    NodeContext ctx(node, inputs, params, outputs, arena);
+    try {
+        type.compute(ctx);
+    } catch (...) {
+        arena.reset();
+        throw;
+    }
+    arena.reset();
+    return outputs;
+}
+
+struct FusedState {
+    Script script;
+    std::vector<NodeId> members;
+    std::vector<std::string> types;
+    /// Results evaluated in advance, for scripts without inputs.
+    std::vector<Value> results;
+    bool folded = false;
+};
+
+void run_fused(NodeContext& ctx) {
+    const FusedState& fused = ctx.state<FusedState>();
+    if (fused.folded) {
+        std::copy(fused.results.begin(), fused.results.end(), ctx.outputs().begin());
+        return;
+    }
+    try {
+        fused.script.run_all(ctx.inputs(), ctx.outputs());
+    } catch (const ScriptError& e) {
+        throw ExecutionError(fused.members[e.part()], fused.types[e.part()], e.what());
+    } catch (const std::exception& e) {
+        throw ExecutionError(fused.members.front(), fused.types.front(), e.what());
+    }
+}
+
+/// Instruction type of a fused cluster.
+const std::shared_ptr<const NodeType>& fused_type() {
+    static const std::shared_ptr<const NodeType> type = [] {
+        auto t = std::make_shared<NodeType>();
+        t->name = "FusedExpressions";
+        t->compute = run_fused;
+        return t;
+    }();
+    return type;
+}
+
+/// A set of expression nodes to run as one script.
+struct Cluster {
+    std::vector<NodeId> members;
+    std::vector<PortRef> externals; // distinct inputs from outside, in first-use order
+};
+
+/// Groups expression nodes into clusters, in topological order. A node joins
+/// the clusters of its expression producers, merging them, when everything
+/// else the result reads is a constant or is computed before its first
+/// member: the cluster runs in that member's place.
+class ClusterFinder {
+public:
+    ClusterFinder(const Graph& graph, Arena& arena)
+        : graph_(graph),
+          arena_(arena),
+          position_(graph.id_bound(), 0),
+          cluster_of_(graph.id_bound(), -1),
+          evaluated_(graph.id_bound(), 0),
+          outputs_(graph.id_bound()) {}
+
+    void run(const std::vector<NodeId>& order) {
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            position_[order[i]] = i;
+        }
+        for (NodeId id : order) {
+            if (is_expression(graph_.type(id))) {
+                place(id);
+            }
+        }
+        // A lone node with a kernel is faster unfused, even with constants
+        // folded in.
+        std::vector<Cluster> kept;
+        for (Cluster& c : clusters_) {
+            if (c.members.empty()) {
+                continue; // merged into another
+            }
+            const NodeId only = c.members.front();
+            if (c.members.size() == 1 && graph_.type(only).kernel) {
+                cluster_of_[only] = -1;
+                continue;
+            }
+            for (NodeId m : c.members) {
+                cluster_of_[m] = static_cast<std::int32_t>(kept.size());
+            }
+            kept.push_back(std::move(c));
+        }
+        clusters_ = std::move(kept);
+    }
+
+    /// Pure node without prepare, connected inputs or expression, whose
+    /// output `port` is a number or a vector. The port types are checked
+    /// before the node is run, so mesh generators never run at compile time.
+    bool is_constant(PortRef port) {
+        const NodeType& type = graph_.type(port.node);
+        if (!type.pure || type.prepare || type.expression ||
+            std::any_of(type.outputs.begin(), type.outputs.end(),
+                        [](const PortSpec& o) { return !is_foldable_type(o.type); })) {
+            return false;
+        }
+        if (!evaluated_[port.node]) {
+            evaluated_[port.node] = 1;
+            const std::span<const PortRef> sources = graph_.input_sources(port.node);
+            if (std::none_of(sources.begin(), sources.end(),
+                             [](const PortRef& s) { return s.valid(); })) {
+                try {
+                    outputs_[port.node] =
+                        run_alone(type, port.node, graph_.params(port.node), arena_);
+                } catch (const std::exception&) {
+                    // Not folded; the failure surfaces when the plan runs.
+                }
+            }
+        }
+        return port.port < outputs_[port.node].size() &&
+               is_foldable(outputs_[port.node][port.port]);
+    }
+
+    std::vector<std::int32_t>& cluster_of() { return cluster_of_; }
+    std::vector<Cluster>& clusters() { return clusters_; }
+
+private:
+    void place(NodeId id) {
+        const NodeType& type = graph_.type(id);
+        const std::span<const PortRef> sources = graph_.input_sources(id);
+        std::vector<std::int32_t> targets;
+        for (std::size_t i = 0; i < sources.size(); ++i) {
+            if (!sources[i].valid()) {
+                if (!is_foldable(type.inputs[i].default_value)) {
+                    return; // runs unfused
+                }
+                continue;
+            }
+            const std::int32_t c = cluster_of_[sources[i].node];
+            if (c >= 0 && std::find(targets.begin(), targets.end(), c) == targets.end()) {
+                targets.push_back(c);
+            }
+        }
+        if (!targets.empty() && try_merge(id, targets)) {
+            return;
+        }
+
+        Cluster cluster;
+        for (const PortRef& src : sources) {
+            if (!src.valid()) {
+                continue;
+            }
+            if ((cluster_of_[src.node] >= 0 || !is_constant(src)) &&
+                std::find(cluster.externals.begin(), cluster.externals.end(), src) ==
+                    cluster.externals.end()) {
+                cluster.externals.push_back(src);
+            }
+        }
+        if (cluster.externals.size() > Script::max_inputs) {
+            return;
+        }
+        cluster.members.push_back(id);
+        cluster_of_[id] = static_cast<std::int32_t>(clusters_.size());
+        clusters_.push_back(std::move(cluster));
+    }
+
+    /// Merges `id` and the clusters of its producers into the first of
+    /// `targets`. The merged cluster runs where its earliest member was, so
+    /// everything it reads from outside must be computed before that.
+    bool try_merge(NodeId id, const std::vector<std::int32_t>& targets) {
+        auto inside = [&](NodeId n) {
+            return std::find(targets.begin(), targets.end(), cluster_of_[n]) != targets.end();
+        };
+        Cluster merged;
+        std::size_t first = position_[id];
+        for (std::int32_t t : targets) {
+            const Cluster& c = clusters_[static_cast<std::size_t>(t)];
+            merged.members.insert(merged.members.end(), c.members.begin(), c.members.end());
+            first = std::min(first, position_[c.members.front()]);
+        }
+        auto add_external = [&](const PortRef& src) {
+            if (position_[src.node] >= first) {
+                return false;
+            }
+            if (std::find(merged.externals.begin(), merged.externals.end(), src) ==
+                merged.externals.end()) {
+                merged.externals.push_back(src);
+            }
+            return true;
+        };
+        for (std::int32_t t : targets) {
+            for (const PortRef& src : clusters_[static_cast<std::size_t>(t)].externals) {
+                if (!inside(src.node) && !add_external(src)) {
+                    return false;
+                }
+            }
+        }
+        for (const PortRef& src : graph_.input_sources(id)) {
+            if (!src.valid() || inside(src.node)) {
+                continue;
+            }
+            if (!is_constant(src) && !add_external(src)) {
+                return false;
+            }
+        }
+        if (merged.externals.size() > Script::max_inputs) {
+            return false;
+        }
+
+        merged.members.push_back(id);
+        std::sort(merged.members.begin(), merged.members.end(),
+                  [&](NodeId a, NodeId b) { return position_[a] < position_[b]; });
+        const std::int32_t target = targets.front();
+        for (NodeId m : merged.members) {
+            cluster_of_[m] = target;
+        }
+        for (std::size_t i = 1; i < targets.size(); ++i) {
+            clusters_[static_cast<std::size_t>(targets[i])] = {};
+        }
+        clusters_[static_cast<std::size_t>(target)] = std::move(merged);
+        return true;
+    }
+
+    const Graph& graph_;
+    Arena& arena_;
+    std::vector<std::size_t> position_;
+    std::vector<std::int32_t> cluster_of_;
+    std::vector<std::uint8_t> evaluated_;
+    std::vector<std::vector<Value>> outputs_;
+    std::vector<Cluster> clusters_;
+};
+
+} // namespace
+
+CompiledPlan CompiledPlan::compile(const Graph& graph, const PlanOptions& options) {
+    // Dead-node elimination: with requested outputs, only their cone.
+    std::vector<NodeId> live;
+    if (!options.outputs.empty()) {
+        std::vector<NodeId> targets;
+        for (const PortRef& port : options.outputs) {
+            if (port.port >= graph.type(port.node).outputs.size()) {
+                throw GraphError("node " + std::to_string(port.node) + " has no output port " +
+                                 std::to_string(port.port));
+            }
+            targets.push_back(port.node);
+        }
+        live = graph.upstream(targets);
+    }
+    const std::vector<NodeId>& order =
+        options.outputs.empty() ? graph.topological_order() : live;
+
+    CompiledPlan plan;
+    plan.arena_ = std::make_unique<Arena>();
+    plan.code_.reserve(order.size());
+    plan.types_.reserve(order.size());
+    plan.states_.reserve(order.size());
+
+    ClusterFinder finder(graph, *plan.arena_);
+    if (options.fuse_expressions) {
+        finder.run(order);
+    }
+    std::vector<std::int32_t>& cluster_of = finder.cluster_of();
+    std::vector<Cluster>& clusters = finder.clusters();
+    auto leads = [&](NodeId id) {
+        return clusters[static_cast<std::size_t>(cluster_of[id])].members.front() == id;
+    };
+
+    // First pass: slot offsets. Every slot exists before any pointer into
+    // values_ is taken, so the pointers stay valid. A cluster's members get
+    // consecutive slots, which its instruction fills in one go.
+    std::vector<std::uint32_t> out_begin(graph.id_bound(), 0);
+    std::uint32_t outputs = 0;
+    std::uint32_t defaults = 0;
+    std::uint32_t inputs = 0;
+    std::uint32_t params = 0;
+    for (NodeId id : order) {
+        params += static_cast<std::uint32_t>(graph.params(id).size());
+        if (cluster_of[id] >= 0) {
+            if (leads(id)) {
+                const Cluster& cluster = clusters[static_cast<std::size_t>(cluster_of[id])];
+                for (NodeId member : cluster.members) {
+                    out_begin[member] = outputs++;
+                }
+                inputs += static_cast<std::uint32_t>(cluster.externals.size());
+            }
+            continue;
+        }
+        out_begin[id] = outputs;
+        outputs += static_cast<std::uint32_t>(graph.type(id).outputs.size());
+        for (const PortRef& src : graph.input_sources(id)) {
+            defaults += src.valid() ? 0 : 1;
+        }
+        inputs += static_cast<std::uint32_t>(graph.input_sources(id).size());
+    }
+    plan.values_.resize(outputs + defaults);
+    plan.inputs_.reserve(inputs);
+    plan.params_.reserve(params);
+
+    std::uint32_t next_default = outputs;
+    for (NodeId id : order) {
+        const std::shared_ptr<const NodeType>& type = graph.type_ptr(id);
+        NodeEntry entry{type,
+                        static_cast<std::uint32_t>(plan.code_.size()),
+                        out_begin[id],
+                        static_cast<std::uint32_t>(type->outputs.size()),
+                        static_cast<std::uint32_t>(plan.params_.size()),
+                        static_cast<std::uint32_t>(graph.params(id).size()),
+                        cluster_of[id]};
+        for (const Value& p : graph.params(id)) {
+            plan.params_.push_back(p);
+        }
+        if (entry.fusion >= 0 && !leads(id)) {
+            const Cluster& cluster = clusters[static_cast<std::size_t>(entry.fusion)];
+            entry.instruction = plan.nodes_.at(cluster.members.front()).instruction;
+            plan.nodes_.emplace(id, std::move(entry));
+            continue;
+        }
+
+        Instruction instr{};
+        instr.node = id;
+        instr.param_begin = entry.param_begin;
+        instr.out_begin = out_begin[id];
+        instr.in_begin = static_cast<std::uint32_t>(plan.inputs_.size());
+
+        if (entry.fusion >= 0) {
+            // The cluster's instruction: its inputs are the cluster's external
+            // inputs, its outputs the members' slots. The script is built once
+            // every member's parameters are in place, below.
+            const Cluster& cluster = clusters[static_cast<std::size_t>(entry.fusion)];
+            for (const PortRef& src : cluster.externals) {
+                plan.inputs_.push_back(&plan.values_[out_begin[src.node] + src.port]);
+            }
+            instr.in_count = static_cast<std::uint32_t>(cluster.externals.size());
+            instr.out_count = static_cast<std::uint32_t>(cluster.members.size());
+            instr.param_count = 0;
+            instr.kernel = nullptr;
+            instr.compute = &fused_type()->compute;
+            instr.state = nullptr;
+            plan.nodes_.emplace(id, std::move(entry));
+            plan.code_.push_back(instr);
+            plan.types_.push_back(fused_type());
+            plan.states_.emplace_back();
+            continue;
+        }
+
+        instr.kernel = type->kernel;
+        instr.compute = &type->compute;
+        const std::span<const PortRef> sources = graph.input_sources(id);
+        for (std::size_t i = 0; i < sources.size(); ++i) {
+            const PortRef& src = sources[i];
+            if (src.valid()) {
+                plan.inputs_.push_back(&plan.values_[out_begin[src.node] + src.port]);
+            } else {
+                plan.values_[next_default] = type->inputs[i].default_value;
+                plan.inputs_.push_back(&plan.values_[next_default++]);
+            }
+        }
+        instr.in_count = static_cast<std::uint32_t>(sources.size());
+        instr.out_count = entry.out_count;
+        instr.param_count = entry.param_count;
+
+        std::shared_ptr<const void> state;
+        if (type->prepare) {
+            try {
+                state = type->prepare(graph.params(id));
+            } catch (...) {
+                rethrow_as_execution_error(id, type->name);
+            }
+        }
+        instr.state = state.get();
+
+        plan.nodes_.emplace(id, std::move(entry));
+        plan.code_.push_back(instr);
+        plan.types_.push_back(type);
+        plan.states_.push_back(std::move(state));
+    }
+
+    // Bind every member input: to a member, an external input or a constant.
+    for (std::size_t c = 0; c < clusters.size(); ++c) {
+        const Cluster& cluster = clusters[c];
+        Fusion fusion;
+        fusion.members = cluster.members;
+        fusion.instruction = plan.nodes_.at(cluster.members.front()).instruction;
+        for (std::uint32_t m = 0; m < cluster.members.size(); ++m) {
+            const NodeId member = cluster.members[m];
+            const NodeType& type = graph.type(member);
+            const std::span<const PortRef> sources = graph.input_sources(member);
+            std::vector<ScriptSource>& bound = fusion.sources.emplace_back();
+            for (std::uint32_t i = 0; i < sources.size(); ++i) {
+                const PortRef& src = sources[i];
+                if (!src.valid()) {
+                    bound.push_back(ScriptSource::constant_value(type.inputs[i].default_value));
+                } else if (cluster_of[src.node] == static_cast<std::int32_t>(c)) {
+                    const auto at = std::find(cluster.members.begin(), cluster.members.end(),
+                                              src.node);
+                    bound.push_back(ScriptSource::result(
+                        static_cast<std::uint32_t>(at - cluster.members.begin())));
+                } else if (auto at = std::find(cluster.externals.begin(),
+                                               cluster.externals.end(), src);
+                           at != cluster.externals.end()) {
+                    bound.push_back(ScriptSource::input(
+                        static_cast<std::uint32_t>(at - cluster.externals.begin())));
+                } else {
+                    bound.push_back(ScriptSource::constant_value({}));
+                    fusion.folded.push_back({m, i, src});
+                    const auto [begin, end] = plan.folded_into_.equal_range(src.node);
+                    if (std::none_of(begin, end, [&](const auto& f) { return f.second == c; })) {
+                        plan.folded_into_.emplace(src.node, static_cast<std::uint32_t>(c));
+                    }
+                }
+            }
+        }
+        plan.fusions_.push_back(std::move(fusion));
+    }
+    for (const Fusion& fusion : plan.fusions_) {
+        plan.states_[fusion.instruction] = plan.build_fusion(fusion);
+        plan.code_[fusion.instruction].state = plan.states_[fusion.instruction].get();
+    }
+    return plan;
+}
+
+CompiledPlan CompiledPlan::fork() const {
+    CompiledPlan plan;
+    plan.code_ = code_;
+    plan.values_ = values_;
+    plan.params_ = params_;
+    plan.inputs_.reserve(inputs_.size());
+    for (const Value* input : inputs_) {
+        plan.inputs_.push_back(plan.values_.data() + (input - values_.data()));
+    }
+    // Instructions point at states owned by states_; sharing the owners keeps
+    // those pointers valid.
+    plan.types_ = types_;
+    plan.states_ = states_;
+    plan.nodes_ = nodes_;
+    plan.fusions_ = fusions_;
+    plan.folded_into_ = folded_into_;
+    plan.arena_ = std::make_unique<Arena>();
+    return plan;
+}
+
+std::shared_ptr<const void> CompiledPlan::build_fusion(const Fusion& fusion) {
+    std::vector<std::shared_ptr<const Script>> scripts;
+    std::vector<const Script*> parts;
+    std::vector<std::string> types;
+    for (NodeId member : fusion.members) {
+        const NodeEntry& e = entry(member);
+        try {
+            scripts.push_back(e.type->expression({params_.data() + e.param_begin, e.param_count}));
+        } catch (...) {
+            rethrow_as_execution_error(member, e.type->name);
+        }
+        parts.push_back(scripts.back().get());
+        types.push_back(e.type->name);
+    }
+
+    std::vector<std::vector<ScriptSource>> sources = fusion.sources;
+    for (const FoldedInput& folded : fusion.folded) {
+        const NodeEntry& producer = entry(folded.port.node);
+        try {
+            sources[folded.member][folded.input].constant =
+                run_alone(*producer.type, folded.port.node,
+                          {params_.data() + producer.param_begin, producer.param_count},
+                          *arena_)[folded.port.port];
+        } catch (...) {
+            rethrow_as_execution_error(folded.port.node, producer.type->name);
+        }
+    }
+
+    std::vector<std::string> names;
+    for (std::uint32_t i = 0; i < code_[fusion.instruction].in_count; ++i) {
+        names.push_back("in" + std::to_string(i));
+    }
+    std::shared_ptr<FusedState> state;
+    try {
+        state = std::make_shared<FusedState>(
+            FusedState{Script::fuse(parts, sources, std::move(names)), fusion.members, types, {}});
+    } catch (const ScriptError& e) {
+        throw ExecutionError(fusion.members[e.part()], types[e.part()], e.what());
+    } catch (...) {
+        rethrow_as_execution_error(fusion.members.front(), types.front());
+    }
+    if (state->script.input_names().empty()) {
+        // Everything folded: evaluate now. A script that fails is left to
+        // fail when the plan runs.
+        state->results.resize(fusion.members.size());
+        try {
+            state->script.run_all({}, state->results);
+            state->folded = true;
+        } catch (const std::exception&) {
+            state->results.clear();
+        }
+    }
+    return state;
+}
+
+void CompiledPlan::run() {
+    column_.clear();
+    Arena& arena = *arena_;
+    const Instruction* const begin = code_.data();
+    const Instruction* const end = begin + code_.size();
+    const Instruction* pc = begin;
+    try {
+        for (; pc != end; ++pc) {
+            Value* out = values_.data() + pc->out_begin;
+            std::fill(out, out + pc->out_count, Value{});
+            NodeContext ctx(pc->node,
+                            {inputs_.data() + pc->in_begin, pc->in_count},
+                            {params_.data() + pc->param_begin, pc->param_count},
+                            {out, pc->out_count},
+                            arena,
+                            pc->state);
+            if (pc->kernel != nullptr) {
+                pc->kernel(ctx);
+            } else {
+                (*pc->compute)(ctx);
+            }
+        }
+    } catch (...) {
+        arena.reset();
+        rethrow_as_execution_error(pc->node, types_[pc - begin]->name);
+    }
+    arena.reset();
+}
+
+void CompiledPlan::run_batch(std::size_t rows, std::span<const ColumnBinding> columns) {
+    column_.assign(values_.size(), 0);
+    std::vector<std::uint8_t> bound(code_.size(), 0);
+    for (const ColumnBinding& binding : columns) {
+        const std::uint32_t slot = slot_of(binding.port);
+        if (binding.column.size() != rows) {
+            throw TypeError("column for node " + std::to_string(binding.port.node) + " has " +
+                            std::to_string(binding.column.size()) + " elements, expected " +
+                            std::to_string(rows));
+        }
+        const NodeEntry& e = entry(binding.port.node);
+        if (e.fusion >= 0 || folded_into_.count(binding.port.node) != 0) {
+            throw GraphError("node " + std::to_string(binding.port.node) +
+                             " is fused into an expression; compile the plan with "
+                             "fuse_expressions off to bind it");
+        }
+        const std::uint32_t at = e.instruction;
+        if (!bound[at]) {
+            // Outputs of a bound node that are not themselves bound stay empty.
+            Value* out = values_.data() + code_[at].out_begin;
+            std::fill(out, out + code_[at].out_count, Value{});
+            bound[at] = 1;
+        }
+        values_[slot] = binding.column;
+        column_[slot] = 1;
+    }
+    input_column_.resize(inputs_.size());
+
+    Arena& arena = *arena_;
+    const Instruction* const begin = code_.data();
+    const Instruction* const end = begin + code_.size();
+    const Instruction* pc = begin;
+    try {
+        for (; pc != end; ++pc) {
+            if (bound[pc - begin]) {
+                continue;
+            }
+            bool any_column = false;
+            for (std::uint32_t i = pc->in_begin; i < pc->in_begin + pc->in_count; ++i) {
+                input_column_[i] = column_[static_cast<std::size_t>(inputs_[i] - values_.data())];
+                any_column |= input_column_[i] != 0;
+            }
+            Value* out = values_.data() + pc->out_begin;
+            std::fill(out, out + pc->out_count, Value{});
+            if (!any_column) {
+                NodeContext ctx(pc->node,
+                                {inputs_.data() + pc->in_begin, pc->in_count},
+                                {params_.data() + pc->param_begin, pc->param_count},
+                                {out, pc->out_count},
+                                arena,
+                                pc->state);
+                if (pc->kernel != nullptr) {
+                    pc->kernel(ctx);
+                } else {
+                    (*pc->compute)(ctx);
+                }
+                continue;
+            }
+
+            if (BatchKernelFn batch = types_[pc - begin]->batch_kernel; batch != nullptr) {
+                BatchContext ctx(pc->node,
+                                 rows,
+                                 {inputs_.data() + pc->in_begin, pc->in_count},
+                                 {input_column_.data() + pc->in_begin, pc->in_count},
+                                 {params_.data() + pc->param_begin, pc->param_count},
+                                 {out, pc->out_count},
+                                 arena);
+                batch(ctx);
+                for (std::uint32_t i = 0; i < pc->out_count; ++i) {
+                    if (out[i].type() != DataType::Buffer || out[i].as_buffer().size() != rows) {
+                        throw TypeError("batch kernel did not produce a column for output " +
+                                        std::to_string(i));
+                    }
+                }
+            } else {
+                run_rows(*pc, rows, arena);
+            }
+            std::fill(column_.begin() + pc->out_begin,
+                      column_.begin() + pc->out_begin + pc->out_count,
+                      std::uint8_t{1});
+        }
+    } catch (...) {
+        arena.reset();
+        rethrow_as_execution_error(pc->node, types_[pc - begin]->name);
+    }
+    arena.reset();
+}
+
+void CompiledPlan::run_rows(const Instruction& instr, std::size_t rows, Arena& arena) {
+    std::vector<Value> row_inputs(instr.in_count);
+    std::vector<const Value*> row_pointers(instr.in_count);
+    std::vector<Value> row_outputs(instr.out_count);
+    std::vector<std::vector<Value>> results(instr.out_count, std::vector<Value>(rows));
+    for (std::uint32_t i = 0; i < instr.in_count; ++i) {
+        row_pointers[i] = input_column_[instr.in_begin + i] ? &row_inputs[i]
+                                                            : inputs_[instr.in_begin + i];
+    }
+    for (std::size_t row = 0; row < rows; ++row) {
+        for (std::uint32_t i = 0; i < instr.in_count; ++i) {
+            if (input_column_[instr.in_begin + i]) {
+                row_inputs[i] = element_of(inputs_[instr.in_begin + i]->as_buffer(), row);
+            }
+        }
+        std::fill(row_outputs.begin(), row_outputs.end(), Value{});
+        NodeContext ctx(instr.node,
+                        row_pointers,
+                        {params_.data() + instr.param_begin, instr.param_count},
+                        row_outputs,
+                        arena,
+                        instr.state);
+        if (instr.kernel != nullptr) {
+            instr.kernel(ctx);
+        } else {
+            (*instr.compute)(ctx);
+        }
+        for (std::uint32_t i = 0; i < instr.out_count; ++i) {
+            results[i][row] = std::move(row_outputs[i]);
+        }
+    }
+    for (std::uint32_t i = 0; i < instr.out_count; ++i) {
+        values_[instr.out_begin + i] = to_column(results[i]);
+    }
+}
+
+const CompiledPlan::NodeEntry& CompiledPlan::entry(NodeId node) const {
+    auto it = nodes_.find(node);
+    if (it == nodes_.end()) {
+        throw GraphError("node " + std::to_string(node) + " is not part of the plan");
+    }
+    return it->second;
+}
+
+std::uint32_t CompiledPlan::slot_of(PortRef port) const {
+    const NodeEntry& e = entry(port.node);
+    if (port.port >= e.out_count) {
+        throw GraphError("node " + std::to_string(port.node) + " has no output port " +
+                         std::to_string(port.port));
+    }
+    return e.out_begin + port.port;
+}
+
+const Value& CompiledPlan::output(PortRef port) const {
+    return values_[slot_of(port)];
+}
+
+bool CompiledPlan::is_column(PortRef port) const {
+    const std::uint32_t slot = slot_of(port);
+    return !column_.empty() && column_[slot] != 0;
+}
+
+void CompiledPlan::set_param(NodeId node, std::size_t index, Value value) {
+    const NodeEntry& e = entry(node);
+    if (index >= e.param_count) {
+        throw GraphError("node " + std::to_string(node) + " has no parameter " +
+                         std::to_string(index));
+    }
+    Value& slot = params_[e.param_begin + index];
+    const bool prepared = e.fusion < 0 && e.type->prepare;
+    const auto [folded_begin, folded_end] = folded_into_.equal_range(node);
+    if (!prepared && e.fusion < 0 && folded_begin == folded_end) {
+        slot = std::move(value);
+        return;
+    }
+
+    // Build every new state before installing any, so a failure changes
+    // nothing.
+    Value previous = std::exchange(slot, std::move(value));
+    std::vector<std::pair<std::uint32_t, std::shared_ptr<const void>>> rebuilt;
+    try {
+        if (prepared) {
+            rebuilt.emplace_back(e.instruction,
+                                 e.type->prepare({params_.data() + e.param_begin, e.param_count}));
+        }
+        if (e.fusion >= 0) {
+            const Fusion& fusion = fusions_[static_cast<std::size_t>(e.fusion)];
+            rebuilt.emplace_back(fusion.instruction, build_fusion(fusion));
+        }
+        for (auto it = folded_begin; it != folded_end; ++it) {
+            const Fusion& fusion = fusions_[it->second];
+            rebuilt.emplace_back(fusion.instruction, build_fusion(fusion));
+        }
+    } catch (...) {
+        slot = std::move(previous);
+        rethrow_as_execution_error(node, e.type->name);
+    }
+    for (auto& [instruction, state] : rebuilt) {
+        states_[instruction] = std::move(state);
+        code_[instruction].state = states_[instruction].get();
+    }
+}
+
+void CompiledPlan::set_param(NodeId node, std::string_view name, Value value) {
+    const NodeEntry& e = entry(node);
+    const int index = e.type->param_index(name);
+    if (index < 0) {
+        throw GraphError(e.type->name + " has no parameter '" + std::string(name) + "'");
+    }
+    set_param(node, static_cast<std::size_t>(index), std::move(value));
+}
+
+} // namespace rebelflow
@@ -0,0 +1,200 @@
+#include "rebelflow/cost_model.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rebelflow {
+
+namespace {
+
+/// Weight of a new sample once the estimate has settled.
+constexpr double settled_weight = 1.0 / 8.0;
+
+template <typename T>
+bool parse_number(std::string_view text, T& out) {
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+    return ec == std::errc{} && end == text.data() + text.size();
+}
+
+/// `name` with backslash, tab, newline and carriage return written as `\\`,
+/// `\t`, `\n` and `\r`, so that it stays one field of one line.
+void append_escaped(std::string& out, std::string_view name) {
+    for (const char c : name) {
+        switch (c) {
+        case '\\': out += "\\\\"; break;
+        case '\t': out += "\\t"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        default: out += c;
+        }
+    }
+}
+
+/// Undoes append_escaped(). Returns false for an unknown or cut-off escape.
+bool unescape(std::string_view field, std::string& name) {
+    name.clear();
+    for (std::size_t i = 0; i < field.size(); ++i) {
+        if (field[i] != '\\') {
+            name += field[i];
+            continue;
+        }
+        if (++i == field.size()) {
+            return false;
+        }
+        switch (field[i]) {
+        case '\\': name += '\\'; break;
+        case 't': name += '\t'; break;
+        case 'n': name += '\n'; break;
+        case 'r': name += '\r'; break;
+        default: return false;
+        }
+    }
+    return true;
+}
+
+/// Writes `text` to a fresh temporary next to `path` and renames it into
+/// place, so that a failed or concurrent save never leaves a partial file.
+void replace_file(const std::string& path, std::string_view text) {
+    std::string temp = path + ".XXXXXX";
+    const int fd = ::mkostemp(temp.data(), O_CLOEXEC);
+    if (fd < 0) {
+        throw IoError("cannot create a temporary file for '" + path + "': " +
+                      std::strerror(errno));
+    }
+    const auto fail = [&](const char* what) {
+        const int error = errno;
+        ::close(fd);
+        std::remove(temp.c_str());
+        throw IoError(what + (" '" + path + "': ") + std::strerror(error));
+    };
+    while (!text.empty()) {
+        const ssize_t written = ::write(fd, text.data(), text.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("cannot write");
+        }
+        text.remove_prefix(static_cast<std::size_t>(written));
+    }
+    // mkostemp creates the file private to its owner.
+    if (::fchmod(fd, 0644) != 0) {
+        fail("cannot set the mode of");
+    }
+    if (::fsync(fd) != 0) {
+        fail("cannot sync");
+    }
+    if (::close(fd) != 0) {
+        std::remove(temp.c_str());
+        throw IoError("cannot write '" + path + "': " + std::strerror(errno));
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        const int error = errno;
+        std::remove(temp.c_str());
+        throw IoError("cannot replace '" + path + "': " + std::strerror(error));
+    }
+}
+
+} // namespace
+
+void CostModel::record_locked(std::string_view type, std::chrono::nanoseconds wall) {
+    auto it = entries_.find(type);
+    if (it == entries_.end()) {
+        it = entries_.emplace(std::string(type), Entry{}).first;
+    }
+    Entry& e = it->second;
+    ++e.samples;
+    // A plain mean over the first samples, then a moving average.
+    const double weight = std::max(1.0 / static_cast<double>(e.samples), settled_weight);
+    e.ns += (static_cast<double>(wall.count()) - e.ns) * weight;
+}
+
+void CostModel::record(std::string_view type, std::chrono::nanoseconds wall) {
+    const std::lock_guard lock(mutex_);
+    record_locked(type, wall);
+}
+
+void CostModel::record(std::span<const NodeProfile> nodes) {
+    const std::lock_guard lock(mutex_);
+    for (const NodeProfile& node : nodes) {
+        if (node.type && node.cache != CacheOutcome::Hit && !node.failed) {
+            record_locked(node.type->name, node.wall);
+        }
+    }
+}
+
+std::chrono::nanoseconds CostModel::estimate(std::string_view type) const {
+    const std::lock_guard lock(mutex_);
+    const auto it = entries_.find(type);
+    if (it == entries_.end()) {
+        return default_cost_;
+    }
+    return std::chrono::nanoseconds(std::llround(it->second.ns));
+}
+
+std::size_t CostModel::size() const {
+    const std::lock_guard lock(mutex_);
+    return entries_.size();
+}
+
+void CostModel::clear() {
+    const std::lock_guard lock(mutex_);
+    entries_.clear();
+}
+
+void CostModel::save(const std::string& path) const {
+    std::string text;
+    {
+        const std::lock_guard lock(mutex_);
+        for (const auto& [name, e] : entries_) {
+            append_escaped(text, name);
+            text += '\t' + std::to_string(std::llround(e.ns)) + '\t' +
+                    std::to_string(e.samples) + '\n';
+        }
+    }
+    replace_file(path, text);
+}
+
+void CostModel::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw IoError("cannot read '" + path + "': " + std::strerror(errno));
+    }
+    // Parse everything before touching the estimates.
+    std::vector<std::pair<std::string, Entry>> loaded;
+    std::string line;
+    for (std::size_t number = 1; std::getline(in, line); ++number) {
+        if (line.empty()) {
+            continue;
+        }
+        const std::size_t a = line.find('\t');
+        const std::size_t b = a == std::string::npos ? a : line.find('\t', a + 1);
+        std::int64_t ns = 0;
+        Entry e;
+        std::string name;
+        if (b == std::string::npos || a == 0 ||
+            !unescape(std::string_view(line).substr(0, a), name) ||
+            !parse_number(std::string_view(line).substr(a + 1, b - a - 1), ns) ||
+            !parse_number(std::string_view(line).substr(b + 1), e.samples) || ns < 0) {
+            throw FormatError(path + ":" + std::to_string(number) + ": malformed cost entry");
+        }
+        e.ns = static_cast<double>(ns);
+        loaded.emplace_back(std::move(name), e);
+    }
+    const std::lock_guard lock(mutex_);
+    for (auto& [name, e] : loaded) {
+        entries_.insert_or_assign(std::move(name), e);
+    }
+}
+
+} // namespace rebelflow
@@ -0,0 +1,740 @@
+#include "rebelflow/distributed.hpp"
+
+#include "rebelflow/arena.hpp"
+#include "rebelflow/brep.hpp"
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/hash.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/serialize.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+// Coordinator to worker:
+//   Run     u32 node, type name, params, input digests, u32 output count,
+//           u8 keyed, [output digests]
+//   Provide u32 count, (u32 input index, value) ... for the pending Run
+//   Fetch   digest
+// Worker to coordinator:
+//   Done    u8 reused, per output: digest, u8 inline, [value]
+//   Need    u32 count, u32 input index ...
+//   Failed  u8 ErrorKind, message
+//   Found   value
+//   Missing
+enum class Request : std::uint8_t { Run = 1, Provide, Fetch };
+enum class Reply : std::uint8_t { Done = 1, Need, Failed, Found, Missing };
+
+/// Outputs up to this size travel with the Done reply instead of waiting to
+/// be fetched: they are cheap to send and often needed by another worker.
+constexpr std::size_t inline_bytes = 4096;
+
+void write_digest(ByteWriter& out, const Digest& d) {
+    out.write_u64(d.lo);
+    out.write_u64(d.hi);
+}
+
+Digest read_digest(ByteReader& in) {
+    Digest d;
+    d.lo = in.read_u64();
+    d.hi = in.read_u64();
+    return d;
+}
+
+std::size_t payload_bytes(const Value& v) {
+    switch (v.type()) {
+    case DataType::Buffer: return v.as_buffer().size_bytes();
+    case DataType::Mesh: return v.as_mesh().size_bytes();
+    case DataType::Bvh: return v.as_bvh().size_bytes();
+    case DataType::Brep: return v.as_brep().size_bytes();
+    case DataType::String: return v.as_string().size();
+    default: return 0;
+    }
+}
+
+/// A received message. Buffers read from it are views that keep it alive.
+struct Message {
+    std::shared_ptr<std::vector<std::byte>> bytes = std::make_shared<std::vector<std::byte>>();
+
+    ByteReader reader() const { return ByteReader(*bytes, bytes); }
+};
+
+Message call(Connection& connection, const ByteWriter& request) {
+    connection.send(request.bytes());
+    Message reply;
+    if (!connection.receive(*reply.bytes)) {
+        throw IoError("worker closed the connection");
+    }
+    return reply;
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------------
+// Partitioning
+
+std::vector<std::uint32_t> partition_graph(const Graph& graph, std::size_t parts) {
+    std::vector<std::uint32_t> assignment(graph.id_bound(), 0);
+    if (parts <= 1) {
+        return assignment;
+    }
+    // A little slack keeps chains together when the sizes do not divide.
+    const std::size_t full = (graph.node_count() + parts - 1) / parts * 5 / 4 + 1;
+    std::vector<std::size_t> load(parts, 0);
+    std::vector<std::size_t> votes(parts, 0);
+    for (const NodeId id : graph.topological_order()) {
+        std::fill(votes.begin(), votes.end(), 0);
+        for (const PortRef& src : graph.input_sources(id)) {
+            if (src.valid()) {
+                ++votes[assignment[src.node]];
+            }
+        }
+        std::size_t best = parts;
+        for (std::size_t p = 0; p < parts; ++p) {
+            if (votes[p] == 0 || load[p] >= full) {
+                continue;
+            }
+            if (best == parts || votes[p] > votes[best] ||
+                (votes[p] == votes[best] && load[p] < load[best])) {
+                best = p;
+            }
+        }
+        if (best == parts) {
+            best = static_cast<std::size_t>(std::min_element(load.begin(), load.end()) -
+                                            load.begin());
+        }
+        assignment[id] = static_cast<std::uint32_t>(best);
+        ++load[best];
+    }
+    return assignment;
+}
+
+// ---------------------------------------------------------------------------
+// Worker
+
+struct DistributedWorker::State {
+    const NodeRegistry& registry;
+    std::size_t capacity;
+
+    struct Entry {
+        Value value;
+        std::size_t bytes;
+        std::list<Digest>::iterator use;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<Digest, Entry> store;
+    std::list<Digest> uses; // most recently used first
+    std::size_t stored = 0;
+    Stats stats;
+
+    State(const NodeRegistry& r, std::size_t c) : registry(r), capacity(c) {}
+
+    /// Looks `digest` up, marking it recently used. Caller holds the mutex.
+    const Value* find(const Digest& digest) {
+        const auto it = store.find(digest);
+        if (it == store.end()) {
+            return nullptr;
+        }
+        uses.splice(uses.begin(), uses, it->second.use);
+        return &it->second.value;
+    }
+
+    /// Caller holds the mutex.
+    void put(const Digest& digest, Value value) {
+        if (find(digest) != nullptr) {
+            return;
+        }
+        const std::size_t bytes = payload_bytes(value) + 64;
+        uses.push_front(digest);
+        store.emplace(digest, Entry{std::move(value), bytes, uses.begin()});
+        stored += bytes;
+        while (stored > capacity && uses.size() > 1) {
+            const auto victim = store.find(uses.back());
+            stored -= victim->second.bytes;
+            store.erase(victim);
+            uses.pop_back();
+        }
+    }
+};
+
+namespace {
+
+/// A node whose Run waits for the inputs the worker lacked.
+struct Pending {
+    std::shared_ptr<const NodeType> type;
+    NodeId node = invalid_node;
+    std::vector<Value> params;
+    std::vector<Digest> inputs;
+    /// Output digests; named by their content after computing unless keyed.
+    std::vector<Digest> outputs;
+    bool keyed = false;
+    std::vector<Value> values;
+    std::vector<std::uint8_t> present;
+};
+
+} // namespace
+
+DistributedWorker::DistributedWorker(const NodeRegistry& registry, std::size_t store_bytes)
+    : state_(std::make_unique<State>(registry, store_bytes)) {}
+
+DistributedWorker::~DistributedWorker() = default;
+
+DistributedWorker::Stats DistributedWorker::stats() const {
+    const std::lock_guard lock(state_->mutex);
+    Stats stats = state_->stats;
+    stats.stored_bytes = state_->stored;
+    return stats;
+}
+
+void DistributedWorker::serve(Connection connection) {
+    State& s = *state_;
+    std::optional<Pending> pending;
+    Arena arena(64 * 1024);
+    std::unordered_map<Digest, std::shared_ptr<const void>> states;
+
+    // Replies Done for `p`, computing its outputs first unless reused.
+    auto finish = [&](Pending& p, std::vector<Value> outputs, bool reused, ByteWriter& reply) {
+        if (!reused) {
+            // Prepared states are kept per distinct parameter set, as in
+            // worker processes.
+            std::shared_ptr<const void> state;
+            if (p.type->prepare) {
+                Hasher h;
+                h.update(p.type->name);
+                for (const Value& param : p.params) {
+                    hash_value(h, param);
+                }
+                const Digest key = h.digest();
+                if (states.size() >= 256 && !states.contains(key)) {
+                    states.clear();
+                }
+                std::shared_ptr<const void>& slot = states[key];
+                if (!slot) {
+                    slot = p.type->prepare(p.params);
+                }
+                state = slot;
+            }
+            std::vector<const Value*> inputs;
+            for (const Value& v : p.values) {
+                inputs.push_back(&v);
+            }
+            NodeContext ctx(p.node, inputs, p.params, outputs, arena, state.get());
+            try {
+                p.type->compute(ctx);
+            } catch (...) {
+                arena.reset();
+                throw;
+            }
+            arena.reset();
+            if (!p.keyed) {
+                for (std::size_t i = 0; i < outputs.size(); ++i) {
+                    Hasher h;
+                    hash_value(h, outputs[i]);
+                    p.outputs[i] = h.digest();
+                }
+            }
+            const std::lock_guard lock(s.mutex);
+            for (std::size_t i = 0; i < outputs.size(); ++i) {
+                s.put(p.outputs[i], outputs[i]);
+            }
+            ++s.stats.computed;
+        }
+        reply.write_u8(static_cast<std::uint8_t>(Reply::Done));
+        reply.write_u8(reused ? 1 : 0);
+        for (std::size_t i = 0; i < outputs.size(); ++i) {
+            const Value& output = outputs[i];
+            write_digest(reply, p.outputs[i]);
+            const bool inline_value = payload_bytes(output) <= inline_bytes;
+            reply.write_u8(inline_value ? 1 : 0);
+            if (inline_value) {
+                write_value(reply, output);
+            }
+        }
+    };
+
+    auto run = [&](ByteReader& in, ByteWriter& reply) {
+        Pending p;
+        p.node = in.read_u32();
+        p.type = s.registry.get(in.read_string());
+        // Counts come off the wire: they are checked against the type before
+        // anything is sized by them.
+        const auto read_count = [&](std::size_t expected) {
+            if (in.read_u32() != expected) {
+                throw GraphError("worker's " + p.type->name +
+                                 " has different ports or parameters");
+            }
+            return expected;
+        };
+        p.params.resize(read_count(p.type->params.size()));
+        for (Value& param : p.params) {
+            param = read_value(in);
+        }
+        p.inputs.resize(read_count(p.type->inputs.size()));
+        for (Digest& d : p.inputs) {
+            d = read_digest(in);
+        }
+        p.outputs.resize(read_count(p.type->outputs.size()));
+        p.keyed = in.read_u8() != 0;
+        for (Digest& d : p.outputs) {
+            d = p.keyed ? read_digest(in) : Digest{};
+        }
+
+        p.values.resize(p.inputs.size());
+        p.present.assign(p.inputs.size(), 0);
+        std::vector<Value> outputs(p.outputs.size());
+        bool reused = p.keyed;
+        std::vector<std::uint32_t> missing;
+        {
+            const std::lock_guard lock(s.mutex);
+            for (std::size_t i = 0; reused && i < p.outputs.size(); ++i) {
+                const Value* v = s.find(p.outputs[i]);
+                reused = v != nullptr;
+                outputs[i] = reused ? *v : Value{};
+            }
+            s.stats.reused += reused ? 1 : 0;
+            for (std::size_t i = 0; !reused && i < p.inputs.size(); ++i) {
+                if (const Value* v = s.find(p.inputs[i])) {
+                    p.values[i] = *v;
+                    p.present[i] = 1;
+                } else {
+                    missing.push_back(static_cast<std::uint32_t>(i));
+                }
+            }
+        }
+        if (reused || missing.empty()) {
+            finish(p, std::move(outputs), reused, reply);
+            return;
+        }
+        reply.write_u8(static_cast<std::uint8_t>(Reply::Need));
+        reply.write_u32(static_cast<std::uint32_t>(missing.size()));
+        for (const std::uint32_t i : missing) {
+            reply.write_u32(i);
+        }
+        pending = std::move(p);
+    };
+
+    auto provide = [&](ByteReader& in, ByteWriter& reply) {
+        if (!pending) {
+            throw FormatError("values provided without a pending node");
+        }
+        Pending p = std::move(*pending);
+        pending.reset();
+        const std::uint32_t count = in.read_u32();
+        for (std::uint32_t k = 0; k < count; ++k) {
+            const std::uint32_t i = in.read_u32();
+            if (i >= p.values.size()) {
+                throw FormatError("provided value for a nonexistent input");
+            }
+            p.values[i] = read_value(in);
+            p.present[i] = 1;
+            const std::lock_guard lock(s.mutex);
+            s.put(p.inputs[i], p.values[i]);
+            ++s.stats.values_received;
+        }
+        if (std::find(p.present.begin(), p.present.end(), 0) != p.present.end()) {
+            throw FormatError("not all missing inputs were provided");
+        }
+        finish(p, std::vector<Value>(p.outputs.size()), false, reply);
+    };
+
+    auto fetch = [&](ByteReader& in, ByteWriter& reply) {
+        const Digest d = read_digest(in);
+        std::optional<Value> value;
+        {
+            const std::lock_guard lock(s.mutex);
+            if (const Value* v = s.find(d)) {
+                value = *v;
+            }
+        }
+        if (value) {
+            reply.write_u8(static_cast<std::uint8_t>(Reply::Found));
+            write_value(reply, *value);
+        } else {
+            reply.write_u8(static_cast<std::uint8_t>(Reply::Missing));
+        }
+    };
+
+    for (;;) {
+        Message request;
+        if (!connection.receive(*request.bytes)) {
+            return;
+        }
+        ByteWriter reply;
+        try {
+            ByteReader in = request.reader();
+            switch (static_cast<Request>(in.read_u8())) {
+            case Request::Run: run(in, reply); break;
+            case Request::Provide: provide(in, reply); break;
+            case Request::Fetch: fetch(in, reply); break;
+            default: throw FormatError("unknown request");
+            }
+        } catch (const std::exception& e) {
+            reply = ByteWriter{};
+            reply.write_u8(static_cast<std::uint8_t>(Reply::Failed));
+            reply.write_u8(static_cast<std::uint8_t>(error_kind(e)));
+            reply.write_string(e.what());
+        }
+        connection.send(reply.bytes());
+    }
+}
+
+void DistributedWorker::serve(Listener& listener) {
+    struct Session {
+        std::thread thread;
+        std::shared_ptr<std::atomic<bool>> done;
+    };
+    std::list<Session> sessions;
+    for (;;) {
+        Connection connection = listener.accept();
+        if (!connection.is_open()) {
+            break;
+        }
+        // Join sessions that have ended, so a long-running worker holds
+        // threads only for its open connections.
+        for (auto it = sessions.begin(); it != sessions.end();) {
+            if (it->done->load(std::memory_order_acquire)) {
+                it->thread.join();
+                it = sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        sessions.push_back({std::thread([this, done, c = std::move(connection)]() mutable {
+                                try {
+                                    serve(std::move(c));
+                                } catch (const std::exception&) {
+                                    // A broken connection only ends its own session.
+                                }
+                                done->store(true, std::memory_order_release);
+                            }),
+                            done});
+    }
+    for (Session& session : sessions) {
+        session.thread.join();
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Coordinator
+
+namespace {
+
+/// Two connections per worker, so fetching a value a worker holds never
+/// waits for the node it is computing.
+struct Link {
+    Connection runs;
+    Connection fetches;
+    std::mutex fetch_mutex;
+};
+
+} // namespace
+
+struct DistributedExecutor::State {
+    std::vector<std::unique_ptr<Link>> links;
+
+    std::mutex mutex;
+    /// Values the coordinator holds: defaults, inline outputs, fetches.
+    std::unordered_map<Digest, Value> values;
+    /// The worker that produced each output of the last run.
+    std::unordered_map<Digest, std::uint32_t> holders;
+    /// Output digests of the last run, by node id.
+    std::vector<std::vector<Digest>> outputs;
+    DistributedStats stats;
+
+    Value value_of(const Digest& d) {
+        std::uint32_t holder = 0;
+        {
+            const std::lock_guard lock(mutex);
+            if (const auto it = values.find(d); it != values.end()) {
+                return it->second;
+            }
+            const auto it = holders.find(d);
+            if (it == holders.end()) {
+                throw Error("no worker holds value " + d.to_hex());
+            }
+            holder = it->second;
+        }
+        ByteWriter request;
+        request.write_u8(static_cast<std::uint8_t>(Request::Fetch));
+        write_digest(request, d);
+        Link& link = *links[holder];
+        Message reply;
+        {
+            const std::lock_guard lock(link.fetch_mutex);
+            reply = call(link.fetches, request);
+        }
+        ByteReader in = reply.reader();
+        if (static_cast<Reply>(in.read_u8()) != Reply::Found) {
+            throw IoError("worker " + std::to_string(holder) + " no longer holds value " +
+                          d.to_hex());
+        }
+        Value v = read_value(in);
+        const std::lock_guard lock(mutex);
+        ++stats.values_fetched;
+        return values.emplace(d, std::move(v)).first->second;
+    }
+};
+
+DistributedExecutor::DistributedExecutor(const std::vector<std::string>& addresses)
+    : state_(std::make_unique<State>()) {
+    if (addresses.empty()) {
+        throw Error("distributed execution needs at least one worker");
+    }
+    for (const std::string& address : addresses) {
+        auto link = std::make_unique<Link>();
+        link->runs = Connection::connect(address);
+        link->fetches = Connection::connect(address);
+        state_->links.push_back(std::move(link));
+    }
+}
+
+DistributedExecutor::~DistributedExecutor() = default;
+
+std::size_t DistributedExecutor::worker_count() const noexcept {
+    return state_->links.size();
+}
+
+DistributedStats DistributedExecutor::run(const Graph& graph) {
+    const std::vector<std::uint32_t> assignment = partition_graph(graph, worker_count());
+    return run(graph, assignment);
+}
+
+DistributedStats DistributedExecutor::run(const Graph& graph,
+                                          std::span<const std::uint32_t> assignment) {
+    const auto start = std::chrono::steady_clock::now();
+    State& s = *state_;
+    const std::vector<NodeId>& order = graph.topological_order();
+    if (assignment.size() < graph.id_bound()) {
+        throw GraphError("assignment does not cover every node");
+    }
+    for (const NodeId id : order) {
+        if (assignment[id] >= s.links.size()) {
+            throw GraphError("node " + std::to_string(id) + " assigned to nonexistent worker " +
+                             std::to_string(assignment[id]));
+        }
+    }
+
+    s.values.clear();
+    s.holders.clear();
+    s.stats = {};
+    std::size_t sent_before = 0;
+    std::size_t received_before = 0;
+    for (const auto& link : s.links) {
+        sent_before += link->runs.bytes_sent() + link->fetches.bytes_sent();
+        received_before += link->runs.bytes_received() + link->fetches.bytes_received();
+    }
+
+    // Output digests are keyed like the Executor's cache: pure nodes' by
+    // everything that produced them, known before they run; impure nodes'
+    // by content, which only their worker can tell.
+    s.outputs.assign(graph.id_bound(), {});
+    std::vector<std::vector<Digest>> inputs(graph.id_bound());
+    for (const NodeId id : order) {
+        const NodeType& type = graph.type(id);
+        inputs[id].resize(type.inputs.size());
+        s.outputs[id].resize(type.outputs.size());
+        const std::span<const PortRef> sources = graph.input_sources(id);
+        for (std::size_t i = 0; i < sources.size(); ++i) {
+            if (!sources[i].valid()) {
+                Hasher h;
+                hash_value(h, type.inputs[i].default_value);
+                inputs[id][i] = h.digest();
+                s.values.emplace(h.digest(), type.inputs[i].default_value);
+            }
+        }
+    }
+
+    // Runs one node on its worker, supplying the inputs it lacks.
+    auto run_node = [&](NodeId id) {
+        const std::uint32_t w = assignment[id];
+        const NodeType& type = graph.type(id);
+        Connection& connection = s.links[w]->runs;
+        try {
+            // Producers have finished: their output digests are final.
+            const std::span<const PortRef> sources = graph.input_sources(id);
+            for (std::size_t i = 0; i < sources.size(); ++i) {
+                if (sources[i].valid()) {
+                    inputs[id][i] = s.outputs[sources[i].node][sources[i].port];
+                }
+            }
+            std::vector<Digest>& outputs = s.outputs[id];
+            if (type.pure) {
+                Hasher h;
+                h.update(type.name).update(std::uint64_t{type.version});
+                for (const Value& param : graph.params(id)) {
+                    hash_value(h, param);
+                }
+                for (const Digest& d : inputs[id]) {
+                    h.update(d);
+                }
+                const Digest key = h.digest();
+                for (std::size_t port = 0; port < outputs.size(); ++port) {
+                    outputs[port] = Hasher().update(key).update(std::uint64_t{port}).digest();
+                }
+            }
+
+            ByteWriter request;
+            request.write_u8(static_cast<std::uint8_t>(Request::Run));
+            request.write_u32(id);
+            request.write_string(type.name);
+            request.write_u32(static_cast<std::uint32_t>(graph.params(id).size()));
+            for (const Value& param : graph.params(id)) {
+                write_value(request, param);
+            }
+            request.write_u32(static_cast<std::uint32_t>(inputs[id].size()));
+            for (const Digest& d : inputs[id]) {
+                write_digest(request, d);
+            }
+            request.write_u32(static_cast<std::uint32_t>(outputs.size()));
+            request.write_u8(type.pure ? 1 : 0);
+            if (type.pure) {
+                for (const Digest& d : outputs) {
+                    write_digest(request, d);
+                }
+            }
+            Message reply = call(connection, request);
+            for (;;) {
+                ByteReader in = reply.reader();
+                const auto kind = static_cast<Reply>(in.read_u8());
+                if (kind == Reply::Need) {
+                    ByteWriter provide;
+                    provide.write_u8(static_cast<std::uint8_t>(Request::Provide));
+                    const std::uint32_t count = in.read_u32();
+                    provide.write_u32(count);
+                    for (std::uint32_t k = 0; k < count; ++k) {
+                        const std::uint32_t i = in.read_u32();
+                        if (i >= inputs[id].size()) {
+                            throw FormatError("worker needs a nonexistent input");
+                        }
+                        provide.write_u32(i);
+                        write_value(provide, s.value_of(inputs[id][i]));
+                    }
+                    {
+                        const std::lock_guard lock(s.mutex);
+                        s.stats.values_sent += count;
+                    }
+                    reply = call(connection, provide);
+                    continue;
+                }
+                if (kind == Reply::Failed) {
+                    const auto error = static_cast<ErrorKind>(in.read_u8());
+                    throw_error(error, in.read_string());
+                }
+                if (kind != Reply::Done) {
+                    throw FormatError("unexpected reply from worker " + std::to_string(w));
+                }
+                const bool reused = in.read_u8() != 0;
+                const std::lock_guard lock(s.mutex);
+                for (Digest& d : outputs) {
+                    d = read_digest(in);
+                    if (in.read_u8() != 0) {
+                        s.values.emplace(d, read_value(in));
+                    }
+                    s.holders[d] = w;
+                }
+                ++s.stats.nodes;
+                s.stats.worker_hits += reused ? 1 : 0;
+                return;
+            }
+        } catch (...) {
+            rethrow_as_execution_error(id, type.name);
+        }
+    };
+
+    // One dispatcher thread per worker takes that worker's ready nodes in
+    // turn; finishing a node readies its consumers on their own workers.
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<std::deque<NodeId>> ready(s.links.size());
+    std::vector<std::uint32_t> pending(graph.id_bound(), 0);
+    std::size_t remaining = order.size();
+    std::exception_ptr error;
+    for (const NodeId id : order) {
+        for (const PortRef& src : graph.input_sources(id)) {
+            pending[id] += src.valid() ? 1 : 0;
+        }
+        if (pending[id] == 0) {
+            ready[assignment[id]].push_back(id);
+        }
+    }
+
+    auto dispatch = [&](std::size_t w) {
+        for (;;) {
+            NodeId id = invalid_node;
+            {
+                std::unique_lock lock(mutex);
+                changed.wait(lock, [&] { return !ready[w].empty() || remaining == 0 || error; });
+                if (remaining == 0 || error) {
+                    return;
+                }
+                id = ready[w].front();
+                ready[w].pop_front();
+            }
+            try {
+                run_node(id);
+            } catch (...) {
+                const std::lock_guard lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                changed.notify_all();
+                return;
+            }
+            const std::lock_guard lock(mutex);
+            --remaining;
+            for (const PortRef& consumer : graph.consumers(id)) {
+                if (--pending[consumer.node] == 0) {
+                    ready[assignment[consumer.node]].push_back(consumer.node);
+                }
+            }
+            changed.notify_all();
+        }
+    };
+
+    {
+        std::vector<std::jthread> dispatchers;
+        for (std::size_t w = 1; w < s.links.size(); ++w) {
+            dispatchers.emplace_back(dispatch, w);
+        }
+        dispatch(0);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    DistributedStats stats = s.stats;
+    for (const auto& link : s.links) {
+        stats.bytes_sent += link->runs.bytes_sent() + link->fetches.bytes_sent();
+        stats.bytes_received += link->runs.bytes_received() + link->fetches.bytes_received();
+    }
+    stats.bytes_sent -= sent_before;
+    stats.bytes_received -= received_before;
+    stats.wall_time = std::chrono::steady_clock::now() - start;
+    return stats;
+}
+
+Value DistributedExecutor::output(PortRef port) {
+    State& s = *state_;
+    if (port.node >= s.outputs.size() || port.port >= s.outputs[port.node].size()) {
+        throw GraphError("the last run produced no output " + std::to_string(port.node) + ":" +
+                         std::to_string(port.port));
+    }
+    return s.value_of(s.outputs[port.node][port.port]);
+}
+
+} // namespace rebelflow
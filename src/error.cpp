@@ -0,0 +1,53 @@
+#include "rebelflow/error.hpp"
+
+namespace rebelflow {
+
+ExecutionError::ExecutionError(NodeId node, const std::string& node_type, const std::string& what)
+    : Error("node " + std::to_string(node) + " (" + node_type + "): " + what),
+      node_(node),
+      node_type_(node_type) {}
+
+void rethrow_as_execution_error(NodeId node, const std::string& node_type) {
+    try {
+        throw;
+    } catch (const ExecutionError&) {
+        throw;
+    } catch (const std::exception& e) {
+        throw ExecutionError(node, node_type, e.what());
+    } catch (...) {
+        throw ExecutionError(node, node_type, "unknown exception");
+    }
+}
+
+ErrorKind error_kind(const std::exception& e) noexcept {
+    if (dynamic_cast<const GraphError*>(&e) != nullptr) {
+        return ErrorKind::Graph;
+    }
+    if (dynamic_cast<const TypeError*>(&e) != nullptr) {
+        return ErrorKind::Type;
+    }
+    if (dynamic_cast<const ScriptError*>(&e) != nullptr) {
+        return ErrorKind::Script;
+    }
+    if (dynamic_cast<const FormatError*>(&e) != nullptr) {
+        return ErrorKind::Format;
+    }
+    if (dynamic_cast<const IoError*>(&e) != nullptr) {
+        return ErrorKind::Io;
+    }
+    return ErrorKind::Error;
+}
+
+void throw_error(ErrorKind kind, const std::string& what) {
+    switch (kind) {
+    case ErrorKind::Graph: throw GraphError(what);
+    case ErrorKind::Type: throw TypeError(what);
+    case ErrorKind::Script: throw ScriptError(what);
+    case ErrorKind::Format: throw FormatError(what);
+    case ErrorKind::Io: throw IoError(what);
+    case ErrorKind::Error: break;
+    }
+    throw Error(what);
+}
+
+} // namespace rebelflow
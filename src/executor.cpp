@@ -0,0 +1,639 @@
+#include "rebelflow/executor.hpp"
+
+#include "rebelflow/serialize.hpp"
+#include "rebelflow/shared_memory.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace rebelflow {
+
+struct Executor::RunState {
+    const Graph& graph;
+    TaskGroup group;
+    std::vector<std::uint8_t> dirty;   // per node id; read-only once scheduling starts
+    std::vector<NodeId> dirty_order;   // dirty nodes in topological order
+    std::unique_ptr<std::atomic<std::uint32_t>[]> pending;
+    std::atomic<std::size_t> cache_hits{0};
+    std::atomic<bool> cancelled{false};
+
+    // Profiling only: per-slot records, and when each node became ready
+    // (profiler clock, in ns).
+    Profiler* profiler = nullptr;
+    std::vector<std::vector<NodeProfile>> profiles;
+    std::unique_ptr<std::atomic<std::int64_t>[]> ready_at;
+
+    // Cost model only: estimated ns from each dirty node's start to the end
+    // of the run, the ready nodes as a max-heap on it, and per-slot wall
+    // times of computed nodes to feed back.
+    CostModel* costs = nullptr;
+    std::vector<std::int64_t> rank;
+    std::mutex ready_mutex;
+    std::vector<NodeId> ready;
+    std::vector<std::vector<std::pair<const NodeType*, std::chrono::nanoseconds>>> timings;
+
+    bool ranks_below(NodeId a, NodeId b) const noexcept { return rank[a] < rank[b]; }
+    /// Caller holds `ready_mutex`.
+    void push_ready(NodeId id) {
+        ready.push_back(id);
+        std::push_heap(ready.begin(), ready.end(),
+                       [this](NodeId a, NodeId b) { return ranks_below(a, b); });
+    }
+    NodeId pop_ready() {
+        const std::lock_guard lock(ready_mutex);
+        std::pop_heap(ready.begin(), ready.end(),
+                      [this](NodeId a, NodeId b) { return ranks_below(a, b); });
+        const NodeId id = ready.back();
+        ready.pop_back();
+        return id;
+    }
+    void feed_costs() {
+        for (const auto& slot : timings) {
+            for (const auto& [type, wall] : slot) {
+                costs->record(type->name, wall);
+            }
+        }
+    }
+
+    RunState(const Graph& g, ThreadPool& pool) : graph(g), group(pool) {}
+};
+
+Executor::Executor(unsigned threads)
+    : owned_pool_(std::make_unique<ThreadPool>(threads)), pool_(owned_pool_.get()) {
+    for (unsigned i = 0; i <= pool_->size(); ++i) {
+        arenas_.push_back(std::make_unique<Arena>());
+    }
+}
+
+Executor::Executor(ThreadPool& pool) : pool_(&pool) {
+    for (unsigned i = 0; i <= pool_->size(); ++i) {
+        arenas_.push_back(std::make_unique<Arena>());
+    }
+}
+
+Executor::~Executor() = default;
+
+void Executor::prepare(const Graph& graph) {
+    // Throws on cycles before any per-run state is touched.
+    const std::vector<NodeId>& order = graph.topological_order();
+    const NodeId bound = graph.id_bound();
+
+    if (schedule_.graph != &graph || schedule_.version != graph.structure_version()) {
+        Schedule s;
+        s.graph = &graph;
+        s.version = graph.structure_version();
+        s.succ_offset.assign(bound + 1, 0);
+
+        // Distinct successors: several edges between the same two nodes must
+        // release the consumer once, not once per edge.
+        std::vector<NodeId> seen_by(bound, invalid_node);
+        for (NodeId id = 0; id < bound; ++id) {
+            s.succ_offset[id] = static_cast<std::uint32_t>(s.succ.size());
+            if (!graph.contains(id)) {
+                continue;
+            }
+            for (const PortRef& to : graph.consumers(id)) {
+                if (seen_by[to.node] != id) {
+                    seen_by[to.node] = id;
+                    s.succ.push_back(to.node);
+                }
+            }
+        }
+        s.succ_offset[bound] = static_cast<std::uint32_t>(s.succ.size());
+        schedule_ = std::move(s);
+    }
+
+    outputs_.resize(bound);
+    evaluated_.resize(bound, 0);
+    seen_revision_.resize(bound, 0);
+    states_.resize(bound);
+    state_revision_.resize(bound, 0);
+    if (cache_) {
+        output_digests_.resize(bound);
+    }
+    for (NodeId id = 0; id < bound; ++id) {
+        if (!graph.contains(id)) {
+            // Removed nodes release their cached values.
+            outputs_[id].clear();
+            evaluated_[id] = 0;
+            states_[id].reset();
+        }
+    }
+    for (NodeId id : order) {
+        const std::size_t ports = graph.type(id).outputs.size();
+        outputs_[id].resize(ports);
+        if (cache_) {
+            output_digests_[id].resize(ports);
+        }
+    }
+}
+
+void Executor::mark_dirty(RunState& state, const std::vector<std::uint8_t>* live) {
+    const Graph& graph = state.graph;
+    const NodeId bound = graph.id_bound();
+    state.dirty.assign(bound, 0);
+    // Dirty whether scheduled or not: nodes outside `live` still have to lose
+    // outputs computed from inputs that are about to change.
+    std::vector<std::uint8_t> stale(bound, 0);
+
+    for (NodeId id : graph.topological_order()) {
+        bool dirty = !evaluated_[id] || seen_revision_[id] != graph.revision(id);
+        if (!dirty) {
+            for (const PortRef& src : graph.input_sources(id)) {
+                if (src.valid() && stale[src.node]) {
+                    dirty = true;
+                    break;
+                }
+            }
+        }
+        if (dirty) {
+            stale[id] = 1;
+            // Until it completes again, a dirty node has no valid outputs;
+            // a failed run leaves it (and its cone) dirty.
+            evaluated_[id] = 0;
+            if (live == nullptr || (*live)[id]) {
+                state.dirty[id] = 1;
+                state.dirty_order.push_back(id);
+            }
+        }
+    }
+
+    state.pending = std::make_unique<std::atomic<std::uint32_t>[]>(bound);
+    for (NodeId id : state.dirty_order) {
+        const std::uint32_t end = schedule_.succ_offset[id + 1];
+        for (std::uint32_t k = schedule_.succ_offset[id]; k < end; ++k) {
+            const NodeId s = schedule_.succ[k];
+            if (state.dirty[s]) {
+                state.pending[s].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+RunStats Executor::run(const Graph& graph) {
+    return evaluate(graph, nullptr);
+}
+
+RunStats Executor::pull(const Graph& graph, std::span<const PortRef> outputs) {
+    std::vector<NodeId> targets;
+    targets.reserve(outputs.size());
+    for (const PortRef& port : outputs) {
+        targets.push_back(port.node);
+    }
+    std::vector<std::uint8_t> live(graph.id_bound(), 0);
+    for (NodeId id : graph.upstream(targets)) {
+        live[id] = 1;
+    }
+    for (const PortRef& port : outputs) {
+        if (port.port >= graph.type(port.node).outputs.size()) {
+            throw GraphError("node " + std::to_string(port.node) + " has no output port " +
+                             std::to_string(port.port));
+        }
+    }
+    return evaluate(graph, &live);
+}
+
+RunStats Executor::evaluate(const Graph& graph, const std::vector<std::uint8_t>* live) {
+    const auto start = std::chrono::steady_clock::now();
+    prepare(graph);
+
+    RunState state(graph, *pool_);
+    mark_dirty(state, live);
+
+    std::chrono::nanoseconds profile_start{0};
+    if (profiler_ != nullptr) {
+        state.profiler = profiler_;
+        state.profiles.resize(arenas_.size());
+        state.ready_at = std::make_unique<std::atomic<std::int64_t>[]>(graph.id_bound());
+        profile_start = profiler_->now();
+    }
+    if (costs_ != nullptr) {
+        state.costs = costs_;
+        state.timings.resize(arenas_.size());
+        rank_nodes(state);
+    }
+
+    // Collect roots before launching any: running tasks decrement pending
+    // counts and would otherwise make later nodes look like extra roots.
+    std::vector<NodeId> roots;
+    for (NodeId id : state.dirty_order) {
+        if (state.pending[id].load(std::memory_order_relaxed) == 0) {
+            roots.push_back(id);
+        }
+    }
+    for (NodeId id : roots) {
+        if (state.profiler != nullptr) {
+            state.ready_at[id].store(profile_start.count(), std::memory_order_relaxed);
+        }
+    }
+    if (state.costs != nullptr) {
+        // All roots are ready before the first task picks the best of them.
+        {
+            const std::lock_guard lock(state.ready_mutex);
+            for (NodeId id : roots) {
+                state.push_ready(id);
+            }
+        }
+        for (std::size_t i = 0; i < roots.size(); ++i) {
+            state.group.run([this, &state] { run_ranked(state); });
+        }
+    } else {
+        for (NodeId id : roots) {
+            state.group.run([this, &state, id] { run_chain(state, id); });
+        }
+    }
+    try {
+        state.group.wait();
+    } catch (...) {
+        if (state.profiler != nullptr) {
+            record_profile(state, profile_start, true);
+        }
+        if (state.costs != nullptr) {
+            state.feed_costs();
+        }
+        reset_arenas();
+        throw;
+    }
+    if (state.profiler != nullptr) {
+        record_profile(state, profile_start, false);
+    }
+    if (state.costs != nullptr) {
+        state.feed_costs();
+    }
+
+    RunStats stats;
+    stats.arena_bytes = reset_arenas();
+    stats.cache_hits = state.cache_hits.load();
+    const std::size_t considered =
+        live == nullptr ? graph.node_count()
+                        : static_cast<std::size_t>(std::count(live->begin(), live->end(), 1));
+    stats.nodes_reused = considered - state.dirty_order.size();
+    stats.nodes_skipped = graph.node_count() - considered;
+    stats.executed = std::move(state.dirty_order);
+    stats.wall_time = std::chrono::steady_clock::now() - start;
+    return stats;
+}
+
+void Executor::run_chain(RunState& state, NodeId id) {
+    while (id != invalid_node) {
+        if (state.cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        try {
+            execute(state, id);
+        } catch (...) {
+            state.cancelled.store(true);
+            throw;
+        }
+
+        NodeId next = invalid_node;
+        const std::uint32_t end = schedule_.succ_offset[id + 1];
+        for (std::uint32_t k = schedule_.succ_offset[id]; k < end; ++k) {
+            const NodeId s = schedule_.succ[k];
+            if (!state.dirty[s] || state.pending[s].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                continue;
+            }
+            if (state.profiler != nullptr) {
+                state.ready_at[s].store(state.profiler->now().count(), std::memory_order_relaxed);
+            }
+            if (next == invalid_node) {
+                next = s;
+            } else {
+                state.group.run([this, &state, s] { run_chain(state, s); });
+            }
+        }
+        id = next;
+    }
+}
+
+void Executor::run_ranked(RunState& state) {
+    NodeId id = state.pop_ready();
+    for (;;) {
+        if (state.cancelled.load(std::memory_order_relaxed)) {
+            return;
+        }
+        try {
+            execute(state, id);
+        } catch (...) {
+            state.cancelled.store(true);
+            throw;
+        }
+
+        std::size_t released = 0;
+        {
+            const std::lock_guard lock(state.ready_mutex);
+            const std::uint32_t end = schedule_.succ_offset[id + 1];
+            for (std::uint32_t k = schedule_.succ_offset[id]; k < end; ++k) {
+                const NodeId s = schedule_.succ[k];
+                if (!state.dirty[s] ||
+                    state.pending[s].fetch_sub(1, std::memory_order_acq_rel) != 1) {
+                    continue;
+                }
+                if (state.profiler != nullptr) {
+                    state.ready_at[s].store(state.profiler->now().count(),
+                                            std::memory_order_relaxed);
+                }
+                state.push_ready(s);
+                ++released;
+            }
+        }
+        if (released == 0) {
+            return;
+        }
+        // One task per released node keeps tasks and ready nodes in step;
+        // this thread continues with the best of them.
+        for (std::size_t i = 1; i < released; ++i) {
+            state.group.run([this, &state] { run_ranked(state); });
+        }
+        id = state.pop_ready();
+    }
+}
+
+void Executor::rank_nodes(RunState& state) const {
+    const Graph& graph = state.graph;
+    state.rank.assign(graph.id_bound(), 0);
+    std::unordered_map<const NodeType*, std::int64_t> estimates;
+    // Consumers come after their producers: walk the order backwards.
+    for (auto it = state.dirty_order.rbegin(); it != state.dirty_order.rend(); ++it) {
+        const NodeId id = *it;
+        std::int64_t longest = 0;
+        const std::uint32_t end = schedule_.succ_offset[id + 1];
+        for (std::uint32_t k = schedule_.succ_offset[id]; k < end; ++k) {
+            const NodeId s = schedule_.succ[k];
+            if (state.dirty[s]) {
+                longest = std::max(longest, state.rank[s]);
+            }
+        }
+        const NodeType* type = graph.type_ptr(id).get();
+        const auto [estimate, inserted] = estimates.try_emplace(type, 0);
+        if (inserted) {
+            estimate->second = costs_->estimate(type->name).count();
+        }
+        state.rank[id] = estimate->second + longest;
+    }
+}
+
+void Executor::execute(RunState& state, NodeId id) {
+    if (state.costs == nullptr) {
+        if (state.profiler != nullptr) {
+            execute_profiled(state, id);
+        } else {
+            execute_node(state, id);
+        }
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const CacheOutcome outcome =
+        state.profiler != nullptr ? execute_profiled(state, id) : execute_node(state, id);
+    if (outcome != CacheOutcome::Hit) {
+        state.timings[current_slot()].emplace_back(state.graph.type_ptr(id).get(),
+                                                   std::chrono::steady_clock::now() - start);
+    }
+}
+
+CacheOutcome Executor::execute_profiled(RunState& state, NodeId id) {
+    const Profiler& profiler = *state.profiler;
+    const unsigned slot = current_slot();
+    const Arena& arena = *arenas_[slot];
+
+    NodeProfile record;
+    record.node = id;
+    record.type = state.graph.type_ptr(id);
+    record.thread = slot;
+    const std::size_t arena_before = arena.bytes_allocated();
+    const std::uint64_t buffers_before = buffer_bytes_allocated();
+    const std::chrono::nanoseconds cpu_before = thread_cpu_time();
+    record.start = profiler.now();
+
+    // A failing node is recorded too, flagged, before the error moves on.
+    const auto finish = [&] {
+        record.wall = profiler.now() - record.start;
+        record.cpu = thread_cpu_time() - cpu_before;
+        const std::chrono::nanoseconds ready(state.ready_at[id].load(std::memory_order_relaxed));
+        record.queue_wait = std::max(record.start - ready, std::chrono::nanoseconds{0});
+        record.bytes_allocated = arena.bytes_allocated() - arena_before +
+                                 static_cast<std::size_t>(buffer_bytes_allocated() - buffers_before);
+        state.profiles[slot].push_back(std::move(record));
+    };
+    try {
+        record.cache = execute_node(state, id);
+    } catch (...) {
+        record.failed = true;
+        finish();
+        throw;
+    }
+    const CacheOutcome outcome = record.cache;
+    finish();
+    return outcome;
+}
+
+void Executor::record_profile(RunState& state, std::chrono::nanoseconds start, bool failed) {
+    std::vector<NodeProfile> nodes;
+    for (std::vector<NodeProfile>& slot : state.profiles) {
+        nodes.insert(nodes.end(), std::make_move_iterator(slot.begin()),
+                     std::make_move_iterator(slot.end()));
+    }
+    RunProfile run;
+    run.start = start;
+    run.wall = state.profiler->now() - start;
+    run.nodes = nodes.size();
+    run.caller_thread = pool_->size();
+    run.failed = failed;
+    state.profiler->record_run(run, std::move(nodes));
+}
+
+bool Executor::feeds_process_pool(const Graph& graph, NodeId id) const {
+    if (processes_ == nullptr) {
+        return false;
+    }
+    const std::span<const PortRef> consumers = graph.consumers(id);
+    return std::any_of(consumers.begin(), consumers.end(),
+                       [&](const PortRef& to) { return graph.type(to.node).isolated; });
+}
+
+CacheOutcome Executor::execute_node(RunState& state, NodeId id) {
+    const Graph& graph = state.graph;
+    const NodeType& type = graph.type(id);
+    const std::span<const PortRef> sources = graph.input_sources(id);
+
+    // Inputs point straight at the producers' output slots (or the port
+    // default); small fan-ins stay on the stack.
+    std::array<const Value*, 8> inline_inputs;
+    std::vector<const Value*> heap_inputs;
+    std::span<const Value*> inputs;
+    if (sources.size() <= inline_inputs.size()) {
+        inputs = std::span(inline_inputs.data(), sources.size());
+    } else {
+        heap_inputs.resize(sources.size());
+        inputs = heap_inputs;
+    }
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        const PortRef& src = sources[i];
+        inputs[i] = src.valid() ? &outputs_[src.node][src.port] : &type.inputs[i].default_value;
+    }
+
+    std::vector<Value>& outputs = outputs_[id];
+    std::fill(outputs.begin(), outputs.end(), Value{});
+
+    Digest key;
+    bool hit = false;
+    if (cache_ && type.pure) {
+        key = cache_key(graph, id);
+        hit = load_cached(key, outputs);
+    }
+
+    if (hit) {
+        state.cache_hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        try {
+            if (processes_ != nullptr && type.isolated) {
+                // The worker prepares its own state.
+                processes_->run(type, id, inputs, graph.params(id), outputs);
+            } else {
+                // Revisions also change on re-wiring, which rebuilds the state
+                // needlessly but rarely; parameter edits must never be missed.
+                if (type.prepare && state_revision_[id] != graph.revision(id)) {
+                    states_[id] = type.prepare(graph.params(id));
+                    state_revision_[id] = graph.revision(id);
+                }
+                NodeContext ctx(id, inputs, graph.params(id), outputs, current_arena(),
+                                states_[id].get(), pool_);
+                if (feeds_process_pool(graph, id)) {
+                    // Buffers bound for a worker process go to shared memory
+                    // right away, so handing them over copies nothing.
+                    SharedArena shared;
+                    const ScopedBufferAllocator scope(shared);
+                    type.compute(ctx);
+                } else {
+                    type.compute(ctx);
+                }
+            }
+        } catch (...) {
+            rethrow_as_execution_error(id, type.name);
+        }
+        if (cache_ && type.pure) {
+            store_cached(key, outputs);
+        }
+    }
+
+    if (cache_) {
+        std::vector<Digest>& digests = output_digests_[id];
+        for (std::size_t port = 0; port < outputs.size(); ++port) {
+            Hasher h;
+            if (type.pure) {
+                h.update(key).update(std::uint64_t{port});
+            } else {
+                hash_value(h, outputs[port]);
+            }
+            digests[port] = h.digest();
+        }
+    }
+    seen_revision_[id] = graph.revision(id);
+    evaluated_[id] = 1;
+    if (!cache_ || !type.pure) {
+        return CacheOutcome::None;
+    }
+    return hit ? CacheOutcome::Hit : CacheOutcome::Miss;
+}
+
+std::size_t Executor::reset_arenas() noexcept {
+    std::size_t bytes = 0;
+    for (auto& arena : arenas_) {
+        bytes += arena->bytes_allocated();
+        arena->reset();
+    }
+    return bytes;
+}
+
+unsigned Executor::current_slot() const noexcept {
+    const int worker = pool_->current_worker();
+    return worker >= 0 ? static_cast<unsigned>(worker) : pool_->size();
+}
+
+Digest Executor::cache_key(const Graph& graph, NodeId id) const {
+    const NodeType& type = graph.type(id);
+    Hasher h;
+    h.update(type.name).update(std::uint64_t{type.version});
+    for (const Value& param : graph.params(id)) {
+        hash_value(h, param);
+    }
+    const std::span<const PortRef> sources = graph.input_sources(id);
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        const PortRef& src = sources[i];
+        if (src.valid()) {
+            h.update(output_digests_[src.node][src.port]);
+        } else {
+            hash_value(h, type.inputs[i].default_value);
+        }
+    }
+    return h.digest();
+}
+
+bool Executor::load_cached(const Digest& key, std::vector<Value>& outputs) const {
+    std::vector<std::byte> bytes;
+    if (!cache_->get(key, bytes)) {
+        return false;
+    }
+    try {
+        ByteReader in(bytes);
+        if (in.read_u32() != outputs.size()) {
+            return false;
+        }
+        for (Value& v : outputs) {
+            v = read_value(in);
+        }
+        if (in.at_end()) {
+            return true;
+        }
+    } catch (const FormatError&) {
+    }
+    // A damaged entry is just a miss.
+    std::fill(outputs.begin(), outputs.end(), Value{});
+    return false;
+}
+
+void Executor::store_cached(const Digest& key, const std::vector<Value>& outputs) const {
+    ByteWriter out;
+    out.write_u32(static_cast<std::uint32_t>(outputs.size()));
+    for (const Value& v : outputs) {
+        write_value(out, v);
+    }
+    cache_->put(key, out.bytes());
+}
+
+void Executor::invalidate(NodeId node) {
+    if (node < evaluated_.size()) {
+        evaluated_[node] = 0;
+    }
+}
+
+void Executor::invalidate_all() {
+    std::fill(evaluated_.begin(), evaluated_.end(), 0);
+}
+
+void Executor::set_result_cache(ResultCache* cache) {
+    cache_ = cache;
+    // Nodes evaluated without a cache have no digests to chain from.
+    output_digests_.clear();
+    invalidate_all();
+}
+
+const Value& Executor::output(PortRef port) const {
+    if (port.node >= evaluated_.size() || !evaluated_[port.node]) {
+        throw GraphError("node " + std::to_string(port.node) + " has no evaluated outputs");
+    }
+    const std::vector<Value>& outs = outputs_[port.node];
+    if (port.port >= outs.size()) {
+        throw GraphError("node " + std::to_string(port.node) + " has no output port " +
+                         std::to_string(port.port));
+    }
+    return outs[port.port];
+}
+
+} // namespace rebelflow
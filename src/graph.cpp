@@ -0,0 +1,270 @@
+#include "rebelflow/graph.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+namespace rebelflow {
+
+namespace {
+
+// Structure versions and node revisions are drawn from one process-wide
+// counter so that a (graph, version) pair never repeats, even when a new graph
+// reuses a dead one's address.
+std::uint64_t next_version() noexcept {
+    static std::atomic<std::uint64_t> counter{0};
+    return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+} // namespace
+
+const Graph::NodeRecord& Graph::record(NodeId id) const {
+    if (id >= nodes_.size() || !nodes_[id].type) {
+        throw GraphError("no node with id " + std::to_string(id));
+    }
+    return nodes_[id];
+}
+
+Graph::NodeRecord& Graph::record(NodeId id) {
+    return const_cast<NodeRecord&>(static_cast<const Graph&>(*this).record(id));
+}
+
+void Graph::structure_changed() noexcept {
+    structure_version_ = next_version();
+}
+
+NodeId Graph::add_node(std::shared_ptr<const NodeType> type) {
+    if (!type) {
+        throw GraphError("cannot add a node without a type");
+    }
+    NodeRecord rec;
+    rec.params.reserve(type->params.size());
+    for (const ParamSpec& p : type->params) {
+        rec.params.push_back(p.default_value);
+    }
+    rec.sources.resize(type->inputs.size());
+    rec.type = std::move(type);
+    rec.revision = next_version();
+
+    const auto id = static_cast<NodeId>(nodes_.size());
+    nodes_.push_back(std::move(rec));
+    ++live_count_;
+    structure_changed();
+    return id;
+}
+
+NodeId Graph::add_node(const NodeRegistry& registry, std::string_view type_name) {
+    return add_node(registry.get(type_name));
+}
+
+void Graph::remove_node(NodeId id) {
+    NodeRecord& rec = record(id);
+    for (std::uint32_t port = 0; port < rec.sources.size(); ++port) {
+        disconnect({id, port});
+    }
+    // Copy: disconnect() edits the consumer list we would be iterating.
+    const std::vector<PortRef> consumers = rec.consumers;
+    for (const PortRef& to : consumers) {
+        disconnect(to);
+    }
+    nodes_[id] = NodeRecord{};
+    --live_count_;
+    structure_changed();
+}
+
+bool Graph::contains(NodeId id) const noexcept {
+    return id < nodes_.size() && nodes_[id].type != nullptr;
+}
+
+std::vector<NodeId> Graph::nodes() const {
+    std::vector<NodeId> out;
+    out.reserve(live_count_);
+    for (NodeId id = 0; id < nodes_.size(); ++id) {
+        if (nodes_[id].type) {
+            out.push_back(id);
+        }
+    }
+    return out;
+}
+
+void Graph::connect(PortRef from, PortRef to) {
+    const NodeRecord& src = record(from.node);
+    const NodeRecord& dst = record(to.node);
+    if (from.port >= src.type->outputs.size()) {
+        throw GraphError("node " + std::to_string(from.node) + " (" + src.type->name +
+                         ") has no output port " + std::to_string(from.port));
+    }
+    if (to.port >= dst.type->inputs.size()) {
+        throw GraphError("node " + std::to_string(to.node) + " (" + dst.type->name +
+                         ") has no input port " + std::to_string(to.port));
+    }
+    const PortSpec& out = src.type->outputs[from.port];
+    const PortSpec& in = dst.type->inputs[to.port];
+    if (!is_convertible(out.type, in.type)) {
+        throw GraphError("cannot connect " + src.type->name + "." + out.name + " (" +
+                         to_string(out.type) + ") to " + dst.type->name + "." + in.name +
+                         " (" + to_string(in.type) + ")");
+    }
+    if (from.node == to.node) {
+        throw GraphError("node " + std::to_string(from.node) + " cannot feed itself");
+    }
+
+    disconnect(to);
+    NodeRecord& consumer = record(to.node);
+    consumer.sources[to.port] = from;
+    consumer.revision = next_version();
+    record(from.node).consumers.push_back(to);
+    structure_changed();
+}
+
+void Graph::connect(NodeId src, std::string_view output, NodeId dst, std::string_view input) {
+    const int out = type(src).output_index(output);
+    if (out < 0) {
+        throw GraphError(type(src).name + " has no output '" + std::string(output) + "'");
+    }
+    const int in = type(dst).input_index(input);
+    if (in < 0) {
+        throw GraphError(type(dst).name + " has no input '" + std::string(input) + "'");
+    }
+    connect({src, static_cast<std::uint32_t>(out)}, {dst, static_cast<std::uint32_t>(in)});
+}
+
+void Graph::disconnect(PortRef to) {
+    NodeRecord& dst = record(to.node);
+    if (to.port >= dst.sources.size()) {
+        throw GraphError("node " + std::to_string(to.node) + " has no input port " +
+                         std::to_string(to.port));
+    }
+    PortRef& from = dst.sources[to.port];
+    if (!from.valid()) {
+        return;
+    }
+    auto& consumers = nodes_[from.node].consumers;
+    consumers.erase(std::find(consumers.begin(), consumers.end(), to));
+    from = PortRef{};
+    dst.revision = next_version();
+    structure_changed();
+}
+
+PortRef Graph::source(PortRef to) const {
+    const NodeRecord& rec = record(to.node);
+    return to.port < rec.sources.size() ? rec.sources[to.port] : PortRef{};
+}
+
+std::vector<Edge> Graph::edges() const {
+    std::vector<Edge> out;
+    for (NodeId id = 0; id < nodes_.size(); ++id) {
+        const auto& sources = nodes_[id].sources;
+        for (std::uint32_t port = 0; port < sources.size(); ++port) {
+            if (sources[port].valid()) {
+                out.push_back({sources[port], {id, port}});
+            }
+        }
+    }
+    return out;
+}
+
+void Graph::set_param(NodeId id, std::string_view name, Value value) {
+    const int index = type(id).param_index(name);
+    if (index < 0) {
+        throw GraphError(type(id).name + " has no parameter '" + std::string(name) + "'");
+    }
+    set_param(id, static_cast<std::size_t>(index), std::move(value));
+}
+
+void Graph::set_param(NodeId id, std::size_t index, Value value) {
+    NodeRecord& rec = record(id);
+    if (index >= rec.params.size()) {
+        throw GraphError(rec.type->name + " has no parameter " + std::to_string(index));
+    }
+    rec.params[index] = std::move(value);
+    rec.revision = next_version();
+}
+
+void Graph::touch(NodeId id) {
+    record(id).revision = next_version();
+}
+
+const Value& Graph::param(NodeId id, std::string_view name) const {
+    const int index = type(id).param_index(name);
+    if (index < 0) {
+        throw GraphError(type(id).name + " has no parameter '" + std::string(name) + "'");
+    }
+    return record(id).params[static_cast<std::size_t>(index)];
+}
+
+const std::vector<NodeId>& Graph::topological_order() const {
+    if (topo_version_ == structure_version_) {
+        return topo_order_;
+    }
+
+    // Kahn's algorithm with one pending count per incoming edge. Seeding
+    // in id order keeps the result deterministic.
+    std::vector<std::uint32_t> pending(nodes_.size(), 0);
+    for (const NodeRecord& rec : nodes_) {
+        for (const PortRef& to : rec.consumers) {
+            ++pending[to.node];
+        }
+    }
+
+    std::vector<NodeId> order;
+    order.reserve(live_count_);
+    for (NodeId id = 0; id < nodes_.size(); ++id) {
+        if (nodes_[id].type && pending[id] == 0) {
+            order.push_back(id);
+        }
+    }
+    for (std::size_t head = 0; head < order.size(); ++head) {
+        for (const PortRef& to : nodes_[order[head]].consumers) {
+            if (--pending[to.node] == 0) {
+                order.push_back(to.node);
+            }
+        }
+    }
+
+    if (order.size() != live_count_) {
+        for (NodeId id = 0; id < nodes_.size(); ++id) {
+            if (nodes_[id].type && pending[id] != 0) {
+                throw GraphError("graph contains a cycle through node " + std::to_string(id) +
+                                 " (" + nodes_[id].type->name + ")");
+            }
+        }
+    }
+
+    topo_order_ = std::move(order);
+    topo_version_ = structure_version_;
+    return topo_order_;
+}
+
+std::vector<NodeId> Graph::upstream(std::span<const NodeId> targets) const {
+    const std::vector<NodeId>& order = topological_order();
+    std::vector<std::uint8_t> needed(nodes_.size(), 0);
+    std::vector<NodeId> stack;
+    for (NodeId id : targets) {
+        record(id);
+        if (!needed[id]) {
+            needed[id] = 1;
+            stack.push_back(id);
+        }
+    }
+    while (!stack.empty()) {
+        const NodeId id = stack.back();
+        stack.pop_back();
+        for (const PortRef& src : nodes_[id].sources) {
+            if (src.valid() && !needed[src.node]) {
+                needed[src.node] = 1;
+                stack.push_back(src.node);
+            }
+        }
+    }
+
+    std::vector<NodeId> result;
+    for (NodeId id : order) {
+        if (needed[id]) {
+            result.push_back(id);
+        }
+    }
+    return result;
+}
+
+} // namespace rebelflow
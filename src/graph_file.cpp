@@ -0,0 +1,428 @@
+#include "rebelflow/graph_file.hpp"
+
+#include "rebelflow/mapped_file.hpp"
+#include "rebelflow/serialize.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+namespace rebelflow {
+
+namespace {
+
+constexpr char graph_magic[8] = {'R', 'F', 'G', 'R', 'A', 'P', 'H', '1'};
+constexpr std::uint32_t graph_format = 1;
+
+struct StrRef {
+    std::uint32_t offset;
+    std::uint32_t size;
+};
+
+struct FileHeader {
+    char magic[8];
+    std::uint32_t format;
+    std::uint32_t graph_count;
+    std::uint64_t directory_offset;
+    std::uint64_t strings_offset;
+    std::uint64_t strings_size;
+    std::uint64_t file_size;
+    std::uint64_t reserved[2];
+};
+
+struct DirEntry {
+    StrRef name;
+    std::uint64_t nodes_offset;
+    std::uint64_t edges_offset;
+    std::uint64_t params_offset;
+    std::uint32_t node_count;
+    std::uint32_t edge_count;
+    std::uint32_t param_count;
+    std::uint32_t reserved;
+};
+
+struct NodeEntry {
+    StrRef type;
+    std::uint32_t param_begin;
+    std::uint32_t param_count;
+};
+
+struct EdgeEntry {
+    std::uint32_t from_node;
+    std::uint32_t to_node;
+    StrRef from_port;
+    StrRef to_port;
+};
+
+struct ParamEntry {
+    StrRef name;
+    std::uint64_t value_offset;
+};
+
+static_assert(sizeof(FileHeader) == 64);
+static_assert(sizeof(DirEntry) == 48);
+static_assert(sizeof(NodeEntry) == 16);
+static_assert(sizeof(EdgeEntry) == 24);
+static_assert(sizeof(ParamEntry) == 16);
+
+/// The tables of one encoded graph, before file offsets are known.
+struct EncodedGraph {
+    StrRef name;
+    std::vector<NodeEntry> nodes;
+    std::vector<EdgeEntry> edges;
+    std::vector<ParamEntry> params; // value_offset relative to the values region
+};
+
+template <typename T>
+void write_table(ByteWriter& out, const std::vector<T>& table) {
+    out.align(8);
+    out.write(table.data(), table.size() * sizeof(T));
+}
+
+} // namespace
+
+struct GraphFileWriter::State {
+    std::string strings;
+    std::unordered_map<std::string, StrRef> string_index;
+    ByteWriter values;
+    std::vector<EncodedGraph> graphs;
+
+    StrRef intern(std::string_view s) {
+        auto [it, inserted] = string_index.try_emplace(std::string(s));
+        if (inserted) {
+            it->second = {static_cast<std::uint32_t>(strings.size()),
+                          static_cast<std::uint32_t>(s.size())};
+            strings.append(s);
+        }
+        return it->second;
+    }
+};
+
+GraphFileWriter::GraphFileWriter() : state_(std::make_unique<State>()) {}
+
+GraphFileWriter::~GraphFileWriter() = default;
+
+void GraphFileWriter::add(std::string_view name, const Graph& graph) {
+    State& s = *state_;
+    for (const EncodedGraph& g : s.graphs) {
+        if (std::string_view(s.strings).substr(g.name.offset, g.name.size) == name) {
+            throw GraphError("graph file already has a graph named '" + std::string(name) + "'");
+        }
+    }
+
+    EncodedGraph encoded;
+    encoded.name = s.intern(name);
+    const std::vector<NodeId> ids = graph.nodes();
+    std::vector<std::uint32_t> index(graph.id_bound(), 0);
+    for (std::size_t i = 0; i < ids.size(); ++i) {
+        index[ids[i]] = static_cast<std::uint32_t>(i);
+    }
+
+    encoded.nodes.reserve(ids.size());
+    for (NodeId id : ids) {
+        const NodeType& type = graph.type(id);
+        const std::span<const Value> params = graph.params(id);
+        NodeEntry node{s.intern(type.name), static_cast<std::uint32_t>(encoded.params.size()),
+                       static_cast<std::uint32_t>(params.size())};
+        for (std::size_t p = 0; p < params.size(); ++p) {
+            s.values.align(8);
+            encoded.params.push_back({s.intern(type.params[p].name), s.values.size()});
+            write_value(s.values, params[p]);
+        }
+        encoded.nodes.push_back(node);
+    }
+
+    for (const Edge& e : graph.edges()) {
+        encoded.edges.push_back({index[e.from.node], index[e.to.node],
+                                 s.intern(graph.type(e.from.node).outputs[e.from.port].name),
+                                 s.intern(graph.type(e.to.node).inputs[e.to.port].name)});
+    }
+    s.graphs.push_back(std::move(encoded));
+}
+
+void GraphFileWriter::save(const std::string& path) const {
+    const State& s = *state_;
+    ByteWriter out;
+    out.write_pod(FileHeader{}); // patched once the offsets are known
+
+    const std::uint64_t strings_offset = out.size();
+    out.write(s.strings.data(), s.strings.size());
+
+    // The values region starts 64-byte aligned, so buffer payloads aligned
+    // within it are aligned in the mapped file too.
+    out.align(64);
+    const std::uint64_t values_offset = out.size();
+    out.write(s.values.bytes().data(), s.values.size());
+
+    std::vector<std::size_t> order(s.graphs.size());
+    for (std::size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    auto name_of = [&](std::size_t i) {
+        return std::string_view(s.strings).substr(s.graphs[i].name.offset, s.graphs[i].name.size);
+    };
+    std::sort(order.begin(), order.end(),
+              [&](std::size_t a, std::size_t b) { return name_of(a) < name_of(b); });
+
+    std::vector<DirEntry> directory;
+    for (std::size_t i : order) {
+        const EncodedGraph& g = s.graphs[i];
+        DirEntry entry{};
+        entry.name = g.name;
+        entry.node_count = static_cast<std::uint32_t>(g.nodes.size());
+        entry.edge_count = static_cast<std::uint32_t>(g.edges.size());
+        entry.param_count = static_cast<std::uint32_t>(g.params.size());
+
+        write_table(out, g.nodes);
+        entry.nodes_offset = out.size() - g.nodes.size() * sizeof(NodeEntry);
+        write_table(out, g.edges);
+        entry.edges_offset = out.size() - g.edges.size() * sizeof(EdgeEntry);
+        std::vector<ParamEntry> params = g.params;
+        for (ParamEntry& p : params) {
+            p.value_offset += values_offset;
+        }
+        write_table(out, params);
+        entry.params_offset = out.size() - params.size() * sizeof(ParamEntry);
+        directory.push_back(entry);
+    }
+    write_table(out, directory);
+
+    FileHeader header{};
+    std::memcpy(header.magic, graph_magic, sizeof graph_magic);
+    header.format = graph_format;
+    header.graph_count = static_cast<std::uint32_t>(directory.size());
+    header.directory_offset = out.size() - directory.size() * sizeof(DirEntry);
+    header.strings_offset = strings_offset;
+    header.strings_size = s.strings.size();
+    header.file_size = out.size();
+
+    const std::string temp = path + ".tmp";
+    {
+        MappedFile file = MappedFile::create(temp, out.size());
+        std::memcpy(file.data(), out.bytes().data(), out.size());
+        std::memcpy(file.data(), &header, sizeof header);
+        file.sync(true);
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        const int error = errno;
+        std::remove(temp.c_str());
+        throw IoError("cannot replace '" + path + "': " + std::strerror(error));
+    }
+}
+
+struct GraphFile::State {
+    std::shared_ptr<const MappedFile> file;
+    const NodeRegistry* registry = nullptr;
+    FileHeader header{};
+    std::span<const std::byte> bytes;
+    std::string_view strings;
+
+    // One slot per directory entry, filled on first use. call_once publishes
+    // `graphs[i]` to every caller; `loaded` only serves is_loaded().
+    std::unique_ptr<std::once_flag[]> once;
+    std::unique_ptr<std::shared_ptr<const Graph>[]> graphs;
+    std::unique_ptr<std::atomic<bool>[]> loaded;
+
+    DirEntry entry(std::size_t i) const {
+        DirEntry e;
+        std::memcpy(&e, bytes.data() + header.directory_offset + i * sizeof(DirEntry), sizeof e);
+        return e;
+    }
+
+    std::string_view string(StrRef ref) const {
+        if (std::uint64_t{ref.offset} + ref.size > strings.size()) {
+            throw FormatError("graph file string reference out of range");
+        }
+        return strings.substr(ref.offset, ref.size);
+    }
+
+    /// Directory index of `name`, or -1. The directory is sorted by name.
+    std::ptrdiff_t find(std::string_view name) const {
+        std::size_t lo = 0;
+        std::size_t hi = header.graph_count;
+        while (lo < hi) {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            const std::string_view at = string(entry(mid).name);
+            if (at == name) {
+                return static_cast<std::ptrdiff_t>(mid);
+            }
+            if (at < name) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return -1;
+    }
+
+    std::size_t index_of(std::string_view name) const {
+        const std::ptrdiff_t i = find(name);
+        if (i < 0) {
+            throw GraphError("graph file '" + file->path() + "' has no graph named '" +
+                             std::string(name) + "'");
+        }
+        return static_cast<std::size_t>(i);
+    }
+
+    template <typename T>
+    T record(std::uint64_t table, std::uint32_t count, std::uint32_t i) const {
+        if (i >= count) {
+            throw FormatError("graph file record index out of range");
+        }
+        T r;
+        std::memcpy(&r, bytes.data() + table + std::uint64_t{i} * sizeof(T), sizeof r);
+        return r;
+    }
+
+    void check_table(std::uint64_t offset, std::uint64_t count, std::size_t record_size) const {
+        if (offset > bytes.size() || count > (bytes.size() - offset) / record_size) {
+            throw FormatError("graph file table out of range");
+        }
+    }
+
+    Graph decode(std::size_t index) const;
+};
+
+Graph GraphFile::State::decode(std::size_t index) const {
+    const DirEntry dir = entry(index);
+    check_table(dir.nodes_offset, dir.node_count, sizeof(NodeEntry));
+    check_table(dir.edges_offset, dir.edge_count, sizeof(EdgeEntry));
+    check_table(dir.params_offset, dir.param_count, sizeof(ParamEntry));
+
+    Graph graph;
+    // Type names are interned, so the string offset identifies the type.
+    std::unordered_map<std::uint32_t, std::shared_ptr<const NodeType>> types;
+    for (std::uint32_t i = 0; i < dir.node_count; ++i) {
+        const NodeEntry node = record<NodeEntry>(dir.nodes_offset, dir.node_count, i);
+        std::shared_ptr<const NodeType>& type = types[node.type.offset];
+        if (!type) {
+            type = registry->get(string(node.type));
+        }
+        const NodeId id = graph.add_node(type);
+        if (std::uint64_t{node.param_begin} + node.param_count > dir.param_count) {
+            throw FormatError("graph file parameter range out of range");
+        }
+        for (std::uint32_t p = 0; p < node.param_count; ++p) {
+            const ParamEntry param =
+                record<ParamEntry>(dir.params_offset, dir.param_count, node.param_begin + p);
+            const int slot = type->param_index(string(param.name));
+            if (slot < 0) {
+                continue; // parameter dropped from the type since the file was written
+            }
+            if (param.value_offset >= bytes.size() || param.value_offset % 8 != 0) {
+                throw FormatError("graph file value offset out of range");
+            }
+            ByteReader in(bytes.subspan(param.value_offset), file);
+            graph.set_param(id, static_cast<std::size_t>(slot), read_value(in));
+        }
+    }
+
+    for (std::uint32_t i = 0; i < dir.edge_count; ++i) {
+        const EdgeEntry edge = record<EdgeEntry>(dir.edges_offset, dir.edge_count, i);
+        if (edge.from_node >= dir.node_count || edge.to_node >= dir.node_count) {
+            throw FormatError("graph file edge refers to a missing node");
+        }
+        graph.connect(edge.from_node, string(edge.from_port), edge.to_node, string(edge.to_port));
+    }
+    return graph;
+}
+
+GraphFile::GraphFile(std::unique_ptr<State> state) noexcept : state_(std::move(state)) {}
+
+GraphFile::GraphFile(GraphFile&&) noexcept = default;
+
+GraphFile& GraphFile::operator=(GraphFile&&) noexcept = default;
+
+GraphFile::~GraphFile() = default;
+
+GraphFile GraphFile::open(const std::string& path, const NodeRegistry& registry) {
+    auto state = std::make_unique<State>();
+    state->file = std::make_shared<const MappedFile>(MappedFile::open(path));
+    state->registry = &registry;
+    state->bytes = state->file->bytes();
+
+    const std::span<const std::byte> bytes = state->bytes;
+    if (bytes.size() < sizeof(FileHeader)) {
+        throw FormatError("'" + path + "' is too small to be a graph file");
+    }
+    FileHeader& header = state->header;
+    std::memcpy(&header, bytes.data(), sizeof header);
+    if (std::memcmp(header.magic, graph_magic, sizeof graph_magic) != 0) {
+        throw FormatError("'" + path + "' is not a graph file");
+    }
+    if (header.format != graph_format) {
+        throw FormatError("'" + path + "' has unsupported graph file format " +
+                          std::to_string(header.format));
+    }
+    if (header.file_size != bytes.size()) {
+        throw FormatError("'" + path + "' is truncated");
+    }
+    if (header.strings_offset > bytes.size() ||
+        header.strings_size > bytes.size() - header.strings_offset) {
+        throw FormatError("'" + path + "' has a corrupt string pool");
+    }
+    state->check_table(header.directory_offset, header.graph_count, sizeof(DirEntry));
+    state->strings = {reinterpret_cast<const char*>(bytes.data() + header.strings_offset),
+                      static_cast<std::size_t>(header.strings_size)};
+
+    state->once = std::make_unique<std::once_flag[]>(header.graph_count);
+    state->graphs = std::make_unique<std::shared_ptr<const Graph>[]>(header.graph_count);
+    state->loaded = std::make_unique<std::atomic<bool>[]>(header.graph_count);
+    return GraphFile(std::move(state));
+}
+
+std::size_t GraphFile::graph_count() const noexcept {
+    return state_->header.graph_count;
+}
+
+std::vector<std::string> GraphFile::names() const {
+    std::vector<std::string> out;
+    out.reserve(graph_count());
+    for (std::size_t i = 0; i < graph_count(); ++i) {
+        out.emplace_back(state_->string(state_->entry(i).name));
+    }
+    return out;
+}
+
+bool GraphFile::contains(std::string_view name) const noexcept {
+    try {
+        return state_->find(name) >= 0;
+    } catch (const FormatError&) {
+        return false;
+    }
+}
+
+std::size_t GraphFile::node_count(std::string_view name) const {
+    return state_->entry(state_->index_of(name)).node_count;
+}
+
+std::shared_ptr<const Graph> GraphFile::graph(std::string_view name) const {
+    const std::size_t i = state_->index_of(name);
+    // A decode that throws leaves the flag unset, so the next call retries.
+    std::call_once(state_->once[i], [&] {
+        state_->graphs[i] = std::make_shared<const Graph>(state_->decode(i));
+        state_->loaded[i].store(true, std::memory_order_release);
+    });
+    return state_->graphs[i];
+}
+
+bool GraphFile::is_loaded(std::string_view name) const {
+    return state_->loaded[state_->index_of(name)].load(std::memory_order_acquire);
+}
+
+void save_graph(const std::string& path, const Graph& graph) {
+    GraphFileWriter writer;
+    writer.add(main_graph_name, graph);
+    writer.save(path);
+}
+
+Graph load_graph(const std::string& path, const NodeRegistry& registry) {
+    const GraphFile file = GraphFile::open(path, registry);
+    return file.state_->decode(file.state_->index_of(main_graph_name));
+}
+
+} // namespace rebelflow
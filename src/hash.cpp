@@ -0,0 +1,131 @@
+#include "rebelflow/hash.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rebelflow {
+
+namespace {
+
+constexpr std::uint64_t c1 = 0x87c37b91114253d5ull;
+constexpr std::uint64_t c2 = 0x4cf5ad432745937full;
+
+constexpr std::uint64_t rotl(std::uint64_t x, int r) noexcept {
+    return (x << r) | (x >> (64 - r));
+}
+
+constexpr std::uint64_t fmix(std::uint64_t k) noexcept {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdull;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ull;
+    k ^= k >> 33;
+    return k;
+}
+
+std::uint64_t load64(const unsigned char* p) noexcept {
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+} // namespace
+
+std::string Digest::to_hex() const {
+    static constexpr char digits[] = "0123456789abcdef";
+    std::string out(32, '0');
+    for (int i = 0; i < 16; ++i) {
+        out[15 - i] = digits[(hi >> (4 * i)) & 0xf];
+        out[31 - i] = digits[(lo >> (4 * i)) & 0xf];
+    }
+    return out;
+}
+
+void Hasher::block(const unsigned char* p) noexcept {
+    std::uint64_t k1 = load64(p);
+    std::uint64_t k2 = load64(p + 8);
+
+    k1 *= c1;
+    k1 = rotl(k1, 31);
+    k1 *= c2;
+    h1_ ^= k1;
+    h1_ = rotl(h1_, 27);
+    h1_ += h2_;
+    h1_ = h1_ * 5 + 0x52dce729;
+
+    k2 *= c2;
+    k2 = rotl(k2, 33);
+    k2 *= c1;
+    h2_ ^= k2;
+    h2_ = rotl(h2_, 31);
+    h2_ += h1_;
+    h2_ = h2_ * 5 + 0x38495ab5;
+}
+
+Hasher& Hasher::update(const void* data, std::size_t size) noexcept {
+    const auto* p = static_cast<const unsigned char*>(data);
+    length_ += size;
+
+    if (tail_size_ > 0) {
+        const std::size_t take = std::min(size, sizeof tail_ - tail_size_);
+        std::memcpy(tail_ + tail_size_, p, take);
+        tail_size_ += take;
+        p += take;
+        size -= take;
+        if (tail_size_ < sizeof tail_) {
+            return *this;
+        }
+        block(tail_);
+        tail_size_ = 0;
+    }
+    for (; size >= 16; p += 16, size -= 16) {
+        block(p);
+    }
+    std::memcpy(tail_, p, size);
+    tail_size_ = size;
+    return *this;
+}
+
+Hasher& Hasher::update(std::string_view text) noexcept {
+    // Length prefix keeps ("ab", "c") and ("a", "bc") apart.
+    update(static_cast<std::uint64_t>(text.size()));
+    return update(text.data(), text.size());
+}
+
+Digest Hasher::digest() const noexcept {
+    std::uint64_t h1 = h1_;
+    std::uint64_t h2 = h2_;
+    std::uint64_t k1 = 0;
+    std::uint64_t k2 = 0;
+
+    for (std::size_t i = tail_size_; i > 8; --i) {
+        k2 ^= static_cast<std::uint64_t>(tail_[i - 1]) << (8 * (i - 9));
+    }
+    if (tail_size_ > 8) {
+        k2 *= c2;
+        k2 = rotl(k2, 33);
+        k2 *= c1;
+        h2 ^= k2;
+    }
+    for (std::size_t i = std::min<std::size_t>(tail_size_, 8); i > 0; --i) {
+        k1 ^= static_cast<std::uint64_t>(tail_[i - 1]) << (8 * (i - 1));
+    }
+    if (tail_size_ > 0) {
+        k1 *= c1;
+        k1 = rotl(k1, 31);
+        k1 *= c2;
+        h1 ^= k1;
+    }
+
+    h1 ^= length_;
+    h2 ^= length_;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix(h1);
+    h2 = fmix(h2);
+    h1 += h2;
+    h2 += h1;
+    return {h1, h2};
+}
+
+} // namespace rebelflow
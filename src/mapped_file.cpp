@@ -0,0 +1,148 @@
+#include "rebelflow/mapped_file.hpp"
+
+#include "rebelflow/error.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rebelflow {
+
+namespace {
+
+[[noreturn]] void fail(const std::string& what, const std::string& path) {
+    throw IoError(what + " '" + path + "': " + std::strerror(errno));
+}
+
+} // namespace
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : path_(std::move(other.path_)),
+      fd_(std::exchange(other.fd_, -1)),
+      data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        path_ = std::move(other.path_);
+        fd_ = std::exchange(other.fd_, -1);
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+    }
+    return *this;
+}
+
+void MappedFile::close() noexcept {
+    if (data_ != nullptr) {
+        ::munmap(data_, size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+MappedFile MappedFile::open(const std::string& path, Mode mode) {
+    const bool writable = mode == Mode::ReadWrite;
+    MappedFile file;
+    file.path_ = path;
+    file.fd_ = ::open(path.c_str(), (writable ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    if (file.fd_ < 0) {
+        fail("cannot open", path);
+    }
+    struct stat st {};
+    if (::fstat(file.fd_, &st) != 0) {
+        fail("cannot stat", path);
+    }
+    file.size_ = static_cast<std::size_t>(st.st_size);
+    if (file.size_ > 0) {
+        void* p = ::mmap(nullptr, file.size_, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+                         MAP_SHARED, file.fd_, 0);
+        if (p == MAP_FAILED) {
+            fail("cannot map", path);
+        }
+        file.data_ = static_cast<std::byte*>(p);
+    }
+    return file;
+}
+
+MappedFile MappedFile::create(const std::string& path, std::uint64_t size) {
+    MappedFile file;
+    file.path_ = path;
+    file.fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file.fd_ < 0) {
+        fail("cannot create", path);
+    }
+    if (::ftruncate(file.fd_, static_cast<off_t>(size)) != 0) {
+        fail("cannot size", path);
+    }
+    file.size_ = static_cast<std::size_t>(size);
+    if (size > 0) {
+        void* p = ::mmap(nullptr, file.size_, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd_, 0);
+        if (p == MAP_FAILED) {
+            fail("cannot map", path);
+        }
+        file.data_ = static_cast<std::byte*>(p);
+    }
+    return file;
+}
+
+MappedFile MappedFile::open_locked(const std::string& path, std::uint64_t size,
+                                   bool& resized) {
+    MappedFile file;
+    file.path_ = path;
+    file.fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file.fd_ < 0) {
+        fail("cannot open", path);
+    }
+    if (::flock(file.fd_, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) {
+            throw IoError("'" + path + "' is in use by another process");
+        }
+        fail("cannot lock", path);
+    }
+    struct stat st {};
+    if (::fstat(file.fd_, &st) != 0) {
+        fail("cannot stat", path);
+    }
+    resized = static_cast<std::uint64_t>(st.st_size) != size;
+    if (resized && ::ftruncate(file.fd_, static_cast<off_t>(size)) != 0) {
+        fail("cannot size", path);
+    }
+    file.size_ = static_cast<std::size_t>(size);
+    if (size > 0) {
+        void* p = ::mmap(nullptr, file.size_, PROT_READ | PROT_WRITE, MAP_SHARED, file.fd_, 0);
+        if (p == MAP_FAILED) {
+            fail("cannot map", path);
+        }
+        file.data_ = static_cast<std::byte*>(p);
+    }
+    return file;
+}
+
+void MappedFile::sync(bool wait) {
+    if (data_ != nullptr && ::msync(data_, size_, wait ? MS_SYNC : MS_ASYNC) != 0) {
+        fail("cannot sync", path_);
+    }
+}
+
+void MappedFile::advise_sequential() noexcept {
+    if (data_ != nullptr) {
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+}
+
+} // namespace rebelflow
@@ -0,0 +1,813 @@
+#include "rebelflow/mesh.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+/// Indices per parallel_for range in the per-element loops below.
+constexpr std::size_t grain = 16384;
+
+/// Half-edges grouped by the vertex they start at, in compressed rows:
+/// those of vertex v are halfedges[offsets[v] .. offsets[v + 1]).
+struct Star {
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> halfedges;
+
+    std::span<const std::uint32_t> row(std::size_t v) const noexcept {
+        return std::span(halfedges).subspan(offsets[v], offsets[v + 1] - offsets[v]);
+    }
+};
+
+/// A counting sort of the half-edges by origin.
+Star build_star(std::span<const std::uint32_t> corners, std::size_t vertex_count) {
+    Star star;
+    star.offsets.assign(vertex_count + 1, 0);
+    for (const std::uint32_t v : corners) {
+        ++star.offsets[v + 1];
+    }
+    for (std::size_t v = 0; v < vertex_count; ++v) {
+        star.offsets[v + 1] += star.offsets[v];
+    }
+    star.halfedges.resize(corners.size());
+    std::vector<std::uint32_t> fill(star.offsets.begin(), star.offsets.end() - 1);
+    for (std::size_t h = 0; h < corners.size(); ++h) {
+        star.halfedges[fill[corners[h]]++] = static_cast<std::uint32_t>(h);
+    }
+    return star;
+}
+
+/// Pairs each half-edge a -> b with the only half-edge b -> a, provided
+/// a -> b is the only one of its direction too.
+void link_twins(std::span<const std::uint32_t> corners, const Star& star,
+                std::span<std::uint32_t> twins, ThreadPool* pool) {
+    parallel_for(pool, corners.size(), grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const auto h = static_cast<std::uint32_t>(i);
+            const std::uint32_t a = corners[h];
+            const std::uint32_t b = corners[Mesh::next(h)];
+            std::uint32_t twin = Mesh::invalid;
+            if (a != b) {
+                std::size_t opposite = 0;
+                for (const std::uint32_t g : star.row(b)) {
+                    if (corners[Mesh::next(g)] == a) {
+                        ++opposite;
+                        twin = g;
+                    }
+                }
+                std::size_t same = 0;
+                for (const std::uint32_t g : star.row(a)) {
+                    same += corners[Mesh::next(g)] == b ? 1 : 0;
+                }
+                if (opposite != 1 || same != 1) {
+                    twin = Mesh::invalid;
+                }
+            }
+            twins[h] = twin;
+        }
+    });
+}
+
+/// An outgoing half-edge of every vertex, a boundary one if there is one.
+void pick_vertex_halfedges(const Star& star, std::span<const std::uint32_t> twins,
+                           std::span<std::uint32_t> out, ThreadPool* pool) {
+    parallel_for(pool, out.size(), grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            const std::span<const std::uint32_t> row = star.row(v);
+            std::uint32_t pick = row.empty() ? Mesh::invalid : row.front();
+            for (const std::uint32_t h : row) {
+                if (twins[h] == Mesh::invalid) {
+                    pick = h;
+                    break;
+                }
+            }
+            out[v] = pick;
+        }
+    });
+}
+
+template <typename T>
+void convert_indices(const Buffer& in, std::span<std::uint32_t> out, std::size_t vertex_count) {
+    const std::span<const T> src = in.view<T>();
+    for (std::size_t i = 0; i < src.size(); ++i) {
+        if (std::cmp_less(src[i], 0) || !std::cmp_less(src[i], vertex_count)) {
+            throw Error("triangle vertex index " + std::to_string(src[i]) + " out of range (" +
+                        std::to_string(vertex_count) + " vertices)");
+        }
+        out[i] = static_cast<std::uint32_t>(src[i]);
+    }
+}
+
+/// Triangle vertex indices as u32 triples, sharing `triangles` if it already
+/// is that, after checking the indices against `vertex_count`.
+Buffer triangle_corners(const Buffer& triangles, std::size_t vertex_count) {
+    if (triangles.size() % 3 != 0) {
+        throw TypeError("triangle indices come in threes, got " +
+                        std::to_string(triangles.size()));
+    }
+    if (triangles.size() >= Mesh::invalid) {
+        throw Error("too many triangles for 32-bit half-edge indices");
+    }
+    if (triangles.element_type() == ElementType::U32) {
+        for (const std::uint32_t v : triangles.view<std::uint32_t>()) {
+            if (v >= vertex_count) {
+                throw Error("triangle vertex index " + std::to_string(v) + " out of range (" +
+                            std::to_string(vertex_count) + " vertices)");
+            }
+        }
+        if (triangles.components() == 3) {
+            return triangles;
+        }
+        return Buffer::copy_of(triangles.view<std::uint32_t>(), 3);
+    }
+    Buffer corners = Buffer::allocate(ElementType::U32, triangles.size(), 3);
+    const std::span<std::uint32_t> out = corners.mutate<std::uint32_t>();
+    switch (triangles.element_type()) {
+    case ElementType::U8: convert_indices<std::uint8_t>(triangles, out, vertex_count); break;
+    case ElementType::I32: convert_indices<std::int32_t>(triangles, out, vertex_count); break;
+    case ElementType::I64: convert_indices<std::int64_t>(triangles, out, vertex_count); break;
+    default:
+        throw TypeError(std::string("triangle indices must be integers, got ") +
+                        to_string(triangles.element_type()));
+    }
+    return corners;
+}
+
+/// Vertex positions as f64 triples, sharing `positions` if it already is.
+Buffer vertex_positions(const Buffer& positions) {
+    if (positions.size() % 3 != 0) {
+        throw TypeError("positions come in xyz triples, got " +
+                        std::to_string(positions.size()) + " elements");
+    }
+    if (positions.size() / 3 >= Mesh::invalid) {
+        throw Error("too many vertices for 32-bit indices");
+    }
+    if (positions.element_type() == ElementType::F64) {
+        if (positions.components() == 3) {
+            return positions;
+        }
+        return Buffer::copy_of(positions.view<double>(), 3);
+    }
+    if (positions.element_type() == ElementType::F32) {
+        const std::span<const float> in = positions.view<float>();
+        std::vector<double> out(in.begin(), in.end());
+        return Buffer::adopt(std::move(out), 3);
+    }
+    throw TypeError(std::string("positions must be f32 or f64, got ") +
+                    to_string(positions.element_type()));
+}
+
+std::size_t domain_size(const Mesh& mesh, MeshDomain domain) noexcept {
+    switch (domain) {
+    case MeshDomain::Vertex: return mesh.vertex_count();
+    case MeshDomain::Face: return mesh.face_count();
+    case MeshDomain::Corner: return mesh.halfedge_count();
+    }
+    return 0;
+}
+
+template <typename T>
+void interpolate_as(const Buffer& src, Buffer& dst, std::span<const std::uint32_t> first,
+                    std::span<const std::uint32_t> second, ThreadPool* pool) {
+    const std::size_t n = src.components();
+    const T* in = src.view<T>().data();
+    T* out = dst.mutate<T>().data();
+    parallel_for(pool, first.size(), grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const T* a = in + first[i] * n;
+            T* y = out + i * n;
+            if constexpr (std::is_floating_point_v<T>) {
+                if (!second.empty()) {
+                    const T* b = in + second[i] * n;
+                    for (std::size_t c = 0; c < n; ++c) {
+                        y[c] = (a[c] + b[c]) * T(0.5);
+                    }
+                    continue;
+                }
+            }
+            std::copy(a, a + n, y);
+        }
+    });
+}
+
+/// Tuple i of the result is the average of tuples first[i] and second[i]
+/// of `src`, or just tuple first[i] if `second` is empty or `src` holds
+/// integers.
+Buffer interpolate(const Buffer& src, std::span<const std::uint32_t> first,
+                   std::span<const std::uint32_t> second, ThreadPool* pool) {
+    Buffer dst = Buffer::allocate(src.element_type(), first.size() * src.components(),
+                                  src.components());
+    switch (src.element_type()) {
+    case ElementType::U8: interpolate_as<std::uint8_t>(src, dst, first, second, pool); break;
+    case ElementType::I32: interpolate_as<std::int32_t>(src, dst, first, second, pool); break;
+    case ElementType::U32: interpolate_as<std::uint32_t>(src, dst, first, second, pool); break;
+    case ElementType::I64: interpolate_as<std::int64_t>(src, dst, first, second, pool); break;
+    case ElementType::F32: interpolate_as<float>(src, dst, first, second, pool); break;
+    case ElementType::F64: interpolate_as<double>(src, dst, first, second, pool); break;
+    }
+    return dst;
+}
+
+/// Carries the attributes of `from` over to `to`, which was derived from it:
+/// element i of domain d in `to` interpolates elements first[d][i] and
+/// second[d][i] of `from` (see interpolate()).
+Mesh carry_attributes(const Mesh& from, Mesh to,
+                      const std::array<std::span<const std::uint32_t>, 3>& first,
+                      const std::array<std::span<const std::uint32_t>, 3>& second,
+                      ThreadPool* pool) {
+    for (const MeshAttribute& a : from.attributes()) {
+        const auto d = static_cast<std::size_t>(a.domain);
+        to = to.with_attribute({a.name, a.domain, interpolate(a.data, first[d], second[d], pool)});
+    }
+    return to;
+}
+
+using Vec3 = std::array<double, 3>;
+
+Vec3 load(std::span<const double> xyz, std::size_t v) noexcept {
+    return {xyz[3 * v], xyz[3 * v + 1], xyz[3 * v + 2]};
+}
+
+Vec3 cross(const Vec3& a, const Vec3& b) noexcept {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+/// Open-addressing map from grid cells to chains of the vertices in them,
+/// growing to stay at most half full. Cells are told apart by a 64-bit hash
+/// only, which keeps slots small; cells whose hashes collide just share a
+/// chain, and the distance test on its vertices keeps results exact.
+class CellTable {
+public:
+    using Cell = std::array<std::int64_t, 3>;
+
+    static std::uint64_t key(const Cell& cell) noexcept {
+        std::uint64_t h = static_cast<std::uint64_t>(cell[0]) * 0x9e3779b97f4a7c15ull;
+        h = (h ^ static_cast<std::uint64_t>(cell[1])) * 0xc2b2ae3d27d4eb4full;
+        h = (h ^ static_cast<std::uint64_t>(cell[2])) * 0x165667b19e3779f9ull;
+        return h ^ (h >> 32);
+    }
+
+    /// Head of the chain of the cell with `key`, `Mesh::invalid` if empty.
+    std::uint32_t find(std::uint64_t key) const noexcept {
+        return slots_.empty() ? Mesh::invalid : slots_[probe(slots_, key)].head;
+    }
+    /// Starts loading the slot of `key` into cache.
+    void prefetch(std::uint64_t key) const noexcept {
+        if (!slots_.empty()) {
+            __builtin_prefetch(&slots_[key & (slots_.size() - 1)]);
+        }
+    }
+    /// Pushes `v` on the chain of the cell with `key`, returning the
+    /// previous head.
+    std::uint32_t push(std::uint64_t key, std::uint32_t v) {
+        if (2 * (used_ + 1) > slots_.size()) {
+            grow();
+        }
+        Slot& slot = slots_[probe(slots_, key)];
+        used_ += slot.head == Mesh::invalid ? 1 : 0;
+        slot.key = key;
+        return std::exchange(slot.head, v);
+    }
+
+private:
+    struct Slot {
+        std::uint64_t key = 0;
+        std::uint32_t head = Mesh::invalid;
+    };
+
+    static std::size_t probe(const std::vector<Slot>& slots, std::uint64_t key) noexcept {
+        const std::size_t mask = slots.size() - 1;
+        for (std::size_t i = key & mask;; i = (i + 1) & mask) {
+            if (slots[i].head == Mesh::invalid || slots[i].key == key) {
+                return i;
+            }
+        }
+    }
+
+    void grow() {
+        std::vector<Slot> bigger(std::max<std::size_t>(slots_.size() * 2, 1024));
+        for (const Slot& slot : slots_) {
+            if (slot.head != Mesh::invalid) {
+                bigger[probe(bigger, slot.key)] = slot;
+            }
+        }
+        slots_ = std::move(bigger);
+    }
+
+    std::vector<Slot> slots_;
+    std::size_t used_ = 0;
+};
+
+/// Neighbouring vertices of every vertex, in compressed rows like Star, and
+/// which vertices lie on the boundary.
+struct Neighbours {
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> vertices;
+    std::vector<std::uint8_t> boundary;
+};
+
+Neighbours build_neighbours(const Mesh& mesh, const Star& star, ThreadPool* pool) {
+    const std::size_t n = mesh.vertex_count();
+    Neighbours out;
+    out.offsets.assign(n + 1, 0);
+    out.boundary.assign(n, 0);
+    // Targets of the outgoing half-edges, plus the origin of an incoming
+    // boundary half-edge, which has no outgoing twin.
+    parallel_for(pool, n, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            std::uint32_t count = 0;
+            for (const std::uint32_t h : star.row(v)) {
+                const bool open = mesh.is_boundary(Mesh::prev(h));
+                count += open ? 2 : 1;
+                if (open || mesh.is_boundary(h)) {
+                    out.boundary[v] = 1;
+                }
+            }
+            out.offsets[v + 1] = count;
+        }
+    });
+    for (std::size_t v = 0; v < n; ++v) {
+        out.offsets[v + 1] += out.offsets[v];
+    }
+    out.vertices.resize(out.offsets[n]);
+    parallel_for(pool, n, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            std::uint32_t* p = out.vertices.data() + out.offsets[v];
+            for (const std::uint32_t h : star.row(v)) {
+                *p++ = mesh.target(h);
+                if (mesh.is_boundary(Mesh::prev(h))) {
+                    *p++ = mesh.origin(Mesh::prev(h));
+                }
+            }
+        }
+    });
+    return out;
+}
+
+Mesh subdivide_once(const Mesh& mesh, ThreadPool* pool) {
+    const std::size_t vertices = mesh.vertex_count();
+    const std::size_t faces = mesh.face_count();
+    const std::size_t halfedges = mesh.halfedge_count();
+    if (vertices + halfedges >= Mesh::invalid || faces * 12 >= Mesh::invalid) {
+        throw Error("subdivided mesh would exceed 32-bit indices");
+    }
+
+    // One new vertex per edge, numbered after the old ones. An edge is named
+    // by its lower half-edge.
+    std::vector<std::uint32_t> edge_of(halfedges);
+    std::vector<std::uint32_t> first(vertices);
+    std::vector<std::uint32_t> second(vertices);
+    for (std::size_t v = 0; v < vertices; ++v) {
+        first[v] = second[v] = static_cast<std::uint32_t>(v);
+    }
+    for (std::uint32_t h = 0; h < halfedges; ++h) {
+        const std::uint32_t t = mesh.twin(h);
+        if (t == Mesh::invalid || h < t) {
+            edge_of[h] = static_cast<std::uint32_t>(first.size());
+            first.push_back(mesh.origin(h));
+            second.push_back(mesh.target(h));
+        }
+    }
+    parallel_for(pool, halfedges, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t h = begin; h < end; ++h) {
+            const std::uint32_t t = mesh.twin(static_cast<std::uint32_t>(h));
+            if (t != Mesh::invalid && t < h) {
+                edge_of[h] = edge_of[t];
+            }
+        }
+    });
+    Buffer positions = interpolate(mesh.arrays().positions, first, second, pool);
+
+    // Triangle (a, b, c) becomes the corner triangles (a, ab, ca), (ab, b, bc),
+    // (ca, bc, c) and the middle one (ab, bc, ca). The corners of the new
+    // triangles interpolate these pairs of the old triangle's corners.
+    static constexpr std::uint8_t corner_pairs[12][2] = {
+        {0, 0}, {0, 1}, {2, 0}, {0, 1}, {1, 1}, {1, 2},
+        {2, 0}, {1, 2}, {2, 2}, {0, 1}, {1, 2}, {2, 0},
+    };
+    const std::span<const std::uint32_t> corners = mesh.corners();
+    Buffer triangles = Buffer::allocate(ElementType::U32, faces * 12, 3);
+    const std::span<std::uint32_t> out = triangles.mutate<std::uint32_t>();
+    std::vector<std::uint32_t> corner_first(faces * 12);
+    std::vector<std::uint32_t> corner_second(faces * 12);
+    std::vector<std::uint32_t> face_first(faces * 4);
+    parallel_for(pool, faces, grain / 4, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t f = begin; f < end; ++f) {
+            const std::size_t h = 3 * f;
+            // Old vertices at 0..2 and edge vertices at 3..5, edge i running
+            // from corner i to corner i + 1.
+            const std::uint32_t v[6] = {corners[h], corners[h + 1], corners[h + 2],
+                                        edge_of[h], edge_of[h + 1], edge_of[h + 2]};
+            for (std::size_t k = 0; k < 12; ++k) {
+                const std::uint8_t a = corner_pairs[k][0];
+                const std::uint8_t b = corner_pairs[k][1];
+                out[12 * f + k] = a == b ? v[a] : v[3 + a];
+                corner_first[12 * f + k] = static_cast<std::uint32_t>(h + a);
+                corner_second[12 * f + k] = static_cast<std::uint32_t>(h + b);
+            }
+            for (std::size_t k = 0; k < 4; ++k) {
+                face_first[4 * f + k] = static_cast<std::uint32_t>(f);
+            }
+        }
+    });
+
+    Mesh result = Mesh::from_triangles(positions, triangles, pool);
+    return carry_attributes(mesh, std::move(result), {first, face_first, corner_first},
+                            {second, {}, corner_second}, pool);
+}
+
+} // namespace
+
+const char* to_string(MeshDomain domain) noexcept {
+    switch (domain) {
+    case MeshDomain::Vertex: return "vertex";
+    case MeshDomain::Face: return "face";
+    case MeshDomain::Corner: return "corner";
+    }
+    return "?";
+}
+
+Mesh::Mesh() : Mesh([] {
+    static const std::shared_ptr<const Arrays> empty = std::make_shared<const Arrays>(Arrays{
+        Buffer::allocate(ElementType::F64, 0, 3), Buffer::allocate(ElementType::U32, 0, 3),
+        Buffer::allocate(ElementType::U32, 0, 3), Buffer::allocate(ElementType::U32, 0), {}});
+    return empty;
+}()) {}
+
+Mesh::Mesh(std::shared_ptr<const Arrays> data) noexcept
+    : data_(std::move(data)),
+      positions_(reinterpret_cast<const double*>(data_->positions.bytes())),
+      corners_(reinterpret_cast<const std::uint32_t*>(data_->corners.bytes())),
+      twins_(reinterpret_cast<const std::uint32_t*>(data_->twins.bytes())),
+      vertex_halfedges_(reinterpret_cast<const std::uint32_t*>(data_->vertex_halfedges.bytes())),
+      vertex_count_(data_->positions.tuples()),
+      face_count_(data_->corners.tuples()) {}
+
+Mesh Mesh::from_triangles(const Buffer& positions, const Buffer& triangles, ThreadPool* pool) {
+    Arrays arrays;
+    arrays.positions = vertex_positions(positions);
+    const std::size_t vertices = arrays.positions.tuples();
+    arrays.corners = triangle_corners(triangles, vertices);
+
+    const std::span<const std::uint32_t> corners = arrays.corners.view<std::uint32_t>();
+    const Star star = build_star(corners, vertices);
+    arrays.twins = Buffer::allocate(ElementType::U32, corners.size(), 3);
+    link_twins(corners, star, arrays.twins.mutate<std::uint32_t>(), pool);
+    arrays.vertex_halfedges = Buffer::allocate(ElementType::U32, vertices);
+    pick_vertex_halfedges(star, arrays.twins.view<std::uint32_t>(),
+                          arrays.vertex_halfedges.mutate<std::uint32_t>(), pool);
+    return Mesh(std::make_shared<const Arrays>(std::move(arrays)));
+}
+
+Mesh Mesh::from_arrays(Arrays arrays) {
+    const auto check = [](bool ok, const char* what) {
+        if (!ok) {
+            throw FormatError(std::string("inconsistent mesh: ") + what);
+        }
+    };
+    const auto is = [](const Buffer& b, ElementType type, std::uint32_t components) {
+        return b.element_type() == type && b.components() == components &&
+               b.size() % components == 0;
+    };
+    check(is(arrays.positions, ElementType::F64, 3), "positions are not f64 triples");
+    check(is(arrays.corners, ElementType::U32, 3), "corners are not u32 triples");
+    check(is(arrays.twins, ElementType::U32, 3), "twins are not u32 triples");
+    check(is(arrays.vertex_halfedges, ElementType::U32, 1), "vertex half-edges are not u32");
+    const std::size_t vertices = arrays.positions.tuples();
+    const std::size_t halfedges = arrays.corners.size();
+    check(vertices < invalid && halfedges < invalid, "too many elements");
+    check(arrays.twins.size() == halfedges, "one twin per half-edge");
+    check(arrays.vertex_halfedges.size() == vertices, "one half-edge per vertex");
+    for (const std::uint32_t v : arrays.corners.view<std::uint32_t>()) {
+        check(v < vertices, "corner vertex out of range");
+    }
+    const std::span<const std::uint32_t> twins = arrays.twins.view<std::uint32_t>();
+    for (std::size_t h = 0; h < twins.size(); ++h) {
+        check(twins[h] == invalid || (twins[h] < halfedges && twins[twins[h]] == h),
+              "twins not paired");
+    }
+    for (const std::uint32_t h : arrays.vertex_halfedges.view<std::uint32_t>()) {
+        check(h == invalid || h < halfedges, "vertex half-edge out of range");
+    }
+    const std::size_t sizes[] = {vertices, halfedges / 3, halfedges};
+    for (const MeshAttribute& a : arrays.attributes) {
+        check(static_cast<std::size_t>(a.domain) < 3 &&
+                  a.data.tuples() == sizes[static_cast<std::size_t>(a.domain)],
+              "attribute size does not match its domain");
+    }
+    return Mesh(std::make_shared<const Arrays>(std::move(arrays)));
+}
+
+const MeshAttribute* Mesh::attribute(std::string_view name) const noexcept {
+    for (const MeshAttribute& a : data_->attributes) {
+        if (a.name == name) {
+            return &a;
+        }
+    }
+    return nullptr;
+}
+
+Mesh Mesh::with_attribute(MeshAttribute attribute) const {
+    const std::size_t want = domain_size(*this, attribute.domain);
+    if (attribute.data.tuples() != want) {
+        throw TypeError("attribute '" + attribute.name + "' has " +
+                        std::to_string(attribute.data.tuples()) + " tuples, the mesh has " +
+                        std::to_string(want) + " " + to_string(attribute.domain) + " elements");
+    }
+    Arrays arrays = *data_;
+    const auto it = std::find_if(arrays.attributes.begin(), arrays.attributes.end(),
+                                 [&](const MeshAttribute& a) { return a.name == attribute.name; });
+    if (it != arrays.attributes.end()) {
+        *it = std::move(attribute);
+    } else {
+        arrays.attributes.push_back(std::move(attribute));
+    }
+    return Mesh(std::make_shared<const Arrays>(std::move(arrays)));
+}
+
+Mesh Mesh::without_attribute(std::string_view name) const {
+    if (attribute(name) == nullptr) {
+        return *this;
+    }
+    Arrays arrays = *data_;
+    std::erase_if(arrays.attributes, [&](const MeshAttribute& a) { return a.name == name; });
+    return Mesh(std::make_shared<const Arrays>(std::move(arrays)));
+}
+
+Mesh Mesh::with_positions(Buffer positions) const {
+    if (positions.element_type() != ElementType::F64 || positions.components() != 3 ||
+        positions.size() != vertex_count_ * 3) {
+        throw TypeError("positions must be " + std::to_string(vertex_count_) +
+                        " f64 xyz triples");
+    }
+    Arrays arrays = *data_;
+    arrays.positions = std::move(positions);
+    return Mesh(std::make_shared<const Arrays>(std::move(arrays)));
+}
+
+std::size_t Mesh::size_bytes() const noexcept {
+    std::size_t bytes = data_->positions.size_bytes() + data_->corners.size_bytes() +
+                        data_->twins.size_bytes() + data_->vertex_halfedges.size_bytes();
+    for (const MeshAttribute& a : data_->attributes) {
+        bytes += a.data.size_bytes();
+    }
+    return bytes;
+}
+
+Digest Mesh::content_digest() const {
+    Hasher hasher;
+    hasher.update(data_->positions.content_digest()).update(data_->corners.content_digest());
+    for (const MeshAttribute& a : data_->attributes) {
+        hasher.update(a.name.size()).update(a.name).update(static_cast<std::uint64_t>(a.domain));
+        hasher.update(a.data.content_digest());
+    }
+    return hasher.digest();
+}
+
+bool operator==(const Mesh& a, const Mesh& b) {
+    return a.data_ == b.data_ ||
+           (a.data_->positions == b.data_->positions && a.data_->corners == b.data_->corners &&
+            a.data_->attributes == b.data_->attributes);
+}
+
+Mesh weld(const Mesh& mesh, double tolerance, ThreadPool* pool) {
+    if (!(tolerance >= 0)) {
+        throw Error("weld tolerance must be non-negative");
+    }
+    const std::size_t vertices = mesh.vertex_count();
+    const std::span<const double> p = mesh.positions();
+
+    // Kept vertices are filed in grid cells eight times the tolerance wide.
+    // A vertex's matches lie in its own cell, and in a neighbouring one only
+    // if it is within tolerance of their common side, so most vertices probe
+    // one cell and few more than two. Equal positions share a cell of any
+    // size. Cells further than 2^62 from the origin on an axis, which only
+    // extreme positions or tiny tolerances reach, are merged into the
+    // outermost one, so that a cell and its neighbours always fit in an
+    // int64; vertices in it are still compared exactly, only more of them.
+    constexpr double cell_tolerances = 8.0;
+    constexpr double cell_limit = 0x1p62;
+    const double inverse_size =
+        tolerance > 0 ? std::min(1.0 / (cell_tolerances * tolerance),
+                                 std::numeric_limits<double>::max())
+                      : 1.0;
+    const double edge = tolerance > 0 ? 1.0 / cell_tolerances : -1.0;
+    const double tolerance2 = tolerance * tolerance;
+
+    // The cell of each vertex, as a table key, and in `sides` bit 2a (2a + 1)
+    // if it is near the low (high) side on axis a; 0xff if not finite.
+    std::vector<std::uint64_t> keys(vertices);
+    std::vector<std::uint8_t> sides(vertices);
+    const auto locate = [&](const Vec3& x, CellTable::Cell& cell) {
+        std::uint8_t near = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            const double scaled = x[axis] * inverse_size;
+            const double floor = std::floor(scaled);
+            cell[axis] = static_cast<std::int64_t>(std::clamp(floor, -cell_limit, cell_limit));
+            near |= static_cast<std::uint8_t>((scaled - floor <= edge ? 1 : 0) << 2 * axis);
+            near |= static_cast<std::uint8_t>((scaled - floor >= 1.0 - edge ? 2 : 0) << 2 * axis);
+        }
+        return near;
+    };
+    parallel_for(pool, vertices, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            const Vec3 x = load(p, v);
+            if (!std::isfinite(x[0]) || !std::isfinite(x[1]) || !std::isfinite(x[2])) {
+                sides[v] = 0xff;
+                continue;
+            }
+            CellTable::Cell cell;
+            sides[v] = locate(x, cell);
+            keys[v] = CellTable::key(cell);
+        }
+    });
+
+    // In vertex order, each vertex joins a kept vertex within tolerance or
+    // is kept itself. This part is sequential and bound by table lookups,
+    // which are prefetched a few vertices ahead.
+    constexpr std::size_t lookahead = 16;
+    CellTable table;
+    std::vector<std::uint32_t> chain(vertices, Mesh::invalid); // by kept vertex
+    std::vector<std::uint32_t> remap(vertices);
+    std::vector<std::uint32_t> kept; // new vertex -> old
+    for (std::size_t v = 0; v < vertices; ++v) {
+        if (v + lookahead < vertices) {
+            table.prefetch(keys[v + lookahead]);
+        }
+        const Vec3 x = load(p, v);
+        std::uint32_t match = Mesh::invalid;
+        const auto search = [&](std::uint64_t key) {
+            for (std::uint32_t k = table.find(key); k != Mesh::invalid; k = chain[k]) {
+                const Vec3 y = load(p, k);
+                const double d0 = x[0] - y[0];
+                const double d1 = x[1] - y[1];
+                const double d2 = x[2] - y[2];
+                if (d0 * d0 + d1 * d1 + d2 * d2 <= tolerance2) {
+                    match = k;
+                    return;
+                }
+            }
+        };
+        const bool finite = sides[v] != 0xff;
+        if (finite) {
+            search(keys[v]);
+        }
+        if (finite && sides[v] != 0 && match == Mesh::invalid) {
+            CellTable::Cell cell;
+            locate(x, cell);
+            std::int64_t low[3];
+            std::int64_t high[3];
+            for (int axis = 0; axis < 3; ++axis) {
+                low[axis] = (sides[v] >> 2 * axis & 1) != 0 ? -1 : 0;
+                high[axis] = (sides[v] >> 2 * axis & 2) != 0 ? 1 : 0;
+            }
+            for (std::int64_t dx = low[0]; dx <= high[0] && match == Mesh::invalid; ++dx) {
+                for (std::int64_t dy = low[1]; dy <= high[1] && match == Mesh::invalid; ++dy) {
+                    for (std::int64_t dz = low[2]; dz <= high[2] && match == Mesh::invalid;
+                         ++dz) {
+                        if (dx != 0 || dy != 0 || dz != 0) {
+                            search(CellTable::key({cell[0] + dx, cell[1] + dy, cell[2] + dz}));
+                        }
+                    }
+                }
+            }
+        }
+        if (match != Mesh::invalid) {
+            remap[v] = remap[match];
+            continue;
+        }
+        remap[v] = static_cast<std::uint32_t>(kept.size());
+        kept.push_back(static_cast<std::uint32_t>(v));
+        if (finite) {
+            chain[v] = table.push(keys[v], static_cast<std::uint32_t>(v));
+        }
+    }
+
+    // Triangles with two corners merged collapse.
+    const std::span<const std::uint32_t> corners = mesh.corners();
+    std::vector<std::uint32_t> triangles;
+    std::vector<std::uint32_t> kept_faces;
+    std::vector<std::uint32_t> kept_corners;
+    triangles.reserve(corners.size());
+    for (std::uint32_t f = 0; f < mesh.face_count(); ++f) {
+        const std::uint32_t a = remap[corners[3 * f]];
+        const std::uint32_t b = remap[corners[3 * f + 1]];
+        const std::uint32_t c = remap[corners[3 * f + 2]];
+        if (a == b || b == c || c == a) {
+            continue;
+        }
+        triangles.insert(triangles.end(), {a, b, c});
+        kept_faces.push_back(f);
+        kept_corners.insert(kept_corners.end(), {3 * f, 3 * f + 1, 3 * f + 2});
+    }
+
+    Buffer positions = interpolate(mesh.arrays().positions, kept, {}, pool);
+    Mesh result = Mesh::from_triangles(positions, Buffer::adopt(std::move(triangles), 3), pool);
+    return carry_attributes(mesh, std::move(result), {kept, kept_faces, kept_corners}, {},
+                            pool);
+}
+
+Mesh smooth(const Mesh& mesh, std::size_t iterations, double factor, bool keep_boundary,
+            ThreadPool* pool) {
+    if (iterations == 0 || mesh.vertex_count() == 0) {
+        return mesh;
+    }
+    const std::size_t n = mesh.vertex_count();
+    const Star star = build_star(mesh.corners(), n);
+    const Neighbours neighbours = build_neighbours(mesh, star, pool);
+
+    const std::span<const double> original = mesh.positions();
+    std::vector<double> current(original.begin(), original.end());
+    std::vector<double> next(current.size());
+    for (std::size_t pass = 0; pass < iterations; ++pass) {
+        parallel_for(pool, n, grain, [&](std::size_t begin, std::size_t end) {
+            const double* in = current.data();
+            double* out = next.data();
+            for (std::size_t v = begin; v < end; ++v) {
+                const std::uint32_t row = neighbours.offsets[v];
+                const std::uint32_t count = neighbours.offsets[v + 1] - row;
+                if (count == 0 || (keep_boundary && neighbours.boundary[v])) {
+                    out[3 * v] = in[3 * v];
+                    out[3 * v + 1] = in[3 * v + 1];
+                    out[3 * v + 2] = in[3 * v + 2];
+                    continue;
+                }
+                double sx = 0;
+                double sy = 0;
+                double sz = 0;
+                for (std::uint32_t i = 0; i < count; ++i) {
+                    const std::uint32_t u = neighbours.vertices[row + i];
+                    sx += in[3 * u];
+                    sy += in[3 * u + 1];
+                    sz += in[3 * u + 2];
+                }
+                const double w = factor / count;
+                out[3 * v] = in[3 * v] + (sx * w - in[3 * v] * factor);
+                out[3 * v + 1] = in[3 * v + 1] + (sy * w - in[3 * v + 1] * factor);
+                out[3 * v + 2] = in[3 * v + 2] + (sz * w - in[3 * v + 2] * factor);
+            }
+        });
+        current.swap(next);
+    }
+    return mesh.with_positions(Buffer::adopt(std::move(current), 3));
+}
+
+Buffer vertex_normals(const Mesh& mesh, ThreadPool* pool) {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> corners = mesh.corners();
+
+    // Unnormalized face normals: their length is twice the triangle's area.
+    std::vector<double> face_normals(mesh.face_count() * 3);
+    parallel_for(pool, mesh.face_count(), grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t f = begin; f < end; ++f) {
+            const Vec3 a = load(p, corners[3 * f]);
+            const Vec3 b = load(p, corners[3 * f + 1]);
+            const Vec3 c = load(p, corners[3 * f + 2]);
+            const Vec3 n = cross({b[0] - a[0], b[1] - a[1], b[2] - a[2]},
+                                 {c[0] - a[0], c[1] - a[1], c[2] - a[2]});
+            std::copy(n.begin(), n.end(), face_normals.begin() + 3 * f);
+        }
+    });
+
+    // Gathered per vertex rather than scattered per face, so that vertices
+    // are written by one thread each.
+    const Star star = build_star(corners, mesh.vertex_count());
+    Buffer normals = Buffer::allocate(ElementType::F64, mesh.vertex_count() * 3, 3);
+    const std::span<double> out = normals.mutate<double>();
+    parallel_for(pool, mesh.vertex_count(), grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            double n[3] = {0, 0, 0};
+            for (const std::uint32_t h : star.row(v)) {
+                const double* fn = face_normals.data() + 3 * Mesh::face(h);
+                n[0] += fn[0];
+                n[1] += fn[1];
+                n[2] += fn[2];
+            }
+            const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            const double scale = length > 0 ? 1.0 / length : 0.0;
+            out[3 * v] = n[0] * scale;
+            out[3 * v + 1] = n[1] * scale;
+            out[3 * v + 2] = n[2] * scale;
+        }
+    });
+    return normals;
+}
+
+Mesh subdivide(const Mesh& mesh, std::size_t levels, ThreadPool* pool) {
+    Mesh result = mesh;
+    for (std::size_t level = 0; level < levels; ++level) {
+        result = subdivide_once(result, pool);
+    }
+    return result;
+}
+
+} // namespace rebelflow
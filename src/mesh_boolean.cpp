@@ -0,0 +1,1143 @@
+#include "rebelflow/mesh_boolean.hpp"
+
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace rebelflow {
+
+namespace {
+
+using Point = Bvh::Point;
+using Xy = std::array<double, 2>;
+
+/// Pairs, cut triangles and regions per parallel_for range.
+constexpr std::size_t grain = 256;
+
+Point sub(const Point& a, const Point& b) noexcept {
+    return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+double dot(const Point& a, const Point& b) noexcept {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+Point cross(const Point& a, const Point& b) noexcept {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+int sign(double x) noexcept {
+    return (x > 0) - (x < 0);
+}
+
+// ---------------------------------------------------------------------------
+// Exact predicates
+//
+// Each test is evaluated in floating point first and trusted when the result
+// is farther from zero than its worst-case rounding error; otherwise it is
+// redone exactly (Shewchuk, Adaptive Precision Floating-Point Arithmetic and
+// Fast Robust Geometric Predicates, 1997). Cuts are decided almost always by
+// the first evaluation.
+
+/// Half an ulp of 1.
+constexpr double epsilon = 0x1p-53;
+constexpr double orient2d_bound = (3.0 + 16.0 * epsilon) * epsilon;
+constexpr double orient3d_bound = (7.0 + 56.0 * epsilon) * epsilon;
+
+void two_sum(double a, double b, double& sum, double& error) noexcept {
+    sum = a + b;
+    const double b_virtual = sum - a;
+    const double a_virtual = sum - b_virtual;
+    error = (a - a_virtual) + (b - b_virtual);
+}
+
+void two_product(double a, double b, double& product, double& error) noexcept {
+    product = a * b;
+    error = std::fma(a, b, -product);
+}
+
+/// A real number held exactly as a sum of doubles that do not overlap bit
+/// for bit, in order of increasing magnitude, so that its sign is that of
+/// the last. Sums and products of doubles are always representable.
+class Exact {
+public:
+    Exact() = default;
+    Exact(double x) {
+        if (x != 0) {
+            terms_.push_back(x);
+        }
+    }
+
+    int sign() const noexcept { return terms_.empty() ? 0 : rebelflow::sign(terms_.back()); }
+
+    friend Exact operator+(Exact a, const Exact& b) {
+        for (const double t : b.terms_) {
+            a.grow(t);
+        }
+        return a;
+    }
+    friend Exact operator-(Exact a) {
+        for (double& t : a.terms_) {
+            t = -t;
+        }
+        return a;
+    }
+    friend Exact operator-(const Exact& a, const Exact& b) { return a + -b; }
+    friend Exact operator*(const Exact& a, const Exact& b) {
+        Exact product;
+        for (const double t : b.terms_) {
+            product = product + a.scaled(t);
+        }
+        return product;
+    }
+
+private:
+    /// Adds `b` in place (Grow-Expansion), dropping zero terms.
+    void grow(double b) {
+        std::size_t kept = 0;
+        double q = b;
+        for (std::size_t i = 0; i < terms_.size(); ++i) {
+            double error = 0;
+            two_sum(q, terms_[i], q, error);
+            if (error != 0) {
+                terms_[kept++] = error;
+            }
+        }
+        terms_.resize(kept);
+        if (q != 0) {
+            terms_.push_back(q);
+        }
+    }
+
+    /// This times `b` (Scale-Expansion), dropping zero terms.
+    Exact scaled(double b) const {
+        Exact out;
+        if (terms_.empty() || b == 0) {
+            return out;
+        }
+        double q = 0;
+        double error = 0;
+        two_product(terms_[0], b, q, error);
+        out.push(error);
+        for (std::size_t i = 1; i < terms_.size(); ++i) {
+            double high = 0;
+            double low = 0;
+            two_product(terms_[i], b, high, low);
+            two_sum(q, low, q, error);
+            out.push(error);
+            two_sum(high, q, q, error);
+            out.push(error);
+        }
+        out.push(q);
+        return out;
+    }
+
+    void push(double t) {
+        if (t != 0) {
+            terms_.push_back(t);
+        }
+    }
+
+    std::vector<double> terms_;
+};
+
+using ExactPoint = std::array<Exact, 3>;
+
+ExactPoint exact_sub(const Point& a, const Point& b) {
+    return {Exact(a[0]) - Exact(b[0]), Exact(a[1]) - Exact(b[1]), Exact(a[2]) - Exact(b[2])};
+}
+ExactPoint exact_cross(const ExactPoint& a, const ExactPoint& b) {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+/// Sign of (b - a) x (c - a): positive if a, b, c turn counterclockwise.
+int orient2d(const Xy& a, const Xy& b, const Xy& c) {
+    const double left = (b[0] - a[0]) * (c[1] - a[1]);
+    const double right = (b[1] - a[1]) * (c[0] - a[0]);
+    const double det = left - right;
+    const double bound = orient2d_bound * (std::abs(left) + std::abs(right));
+    if (det > bound || -det > bound) {
+        return sign(det);
+    }
+    const Exact exact = (Exact(b[0]) - Exact(a[0])) * (Exact(c[1]) - Exact(a[1])) -
+                        (Exact(b[1]) - Exact(a[1])) * (Exact(c[0]) - Exact(a[0]));
+    return exact.sign();
+}
+
+/// Sign of (b - a) . ((c - a) x (d - a)): positive if d is on the side the
+/// counterclockwise triangle a, b, c faces.
+int orient3d(const Point& a, const Point& b, const Point& c, const Point& d) {
+    const Point u = sub(b, a);
+    const Point v = sub(c, a);
+    const Point w = sub(d, a);
+    const double m0 = v[1] * w[2];
+    const double m1 = v[2] * w[1];
+    const double m2 = v[2] * w[0];
+    const double m3 = v[0] * w[2];
+    const double m4 = v[0] * w[1];
+    const double m5 = v[1] * w[0];
+    const double det = u[0] * (m0 - m1) + u[1] * (m2 - m3) + u[2] * (m4 - m5);
+    const double permanent = std::abs(u[0]) * (std::abs(m0) + std::abs(m1)) +
+                             std::abs(u[1]) * (std::abs(m2) + std::abs(m3)) +
+                             std::abs(u[2]) * (std::abs(m4) + std::abs(m5));
+    const double bound = orient3d_bound * permanent;
+    if (det > bound || -det > bound) {
+        return sign(det);
+    }
+    const ExactPoint eu = exact_sub(b, a);
+    const ExactPoint n = exact_cross(exact_sub(c, a), exact_sub(d, a));
+    return (eu[0] * n[0] + eu[1] * n[1] + eu[2] * n[2]).sign();
+}
+
+// Ties are broken by symbolic perturbation: every point of b is taken to be
+// moved by e (1, h, h^2) for infinitesimals 0 < h << e. A translation of one
+// mesh keeps it intact, so the perturbed decisions describe a real
+// arrangement, in which no vertex lies on a plane of the other mesh and no
+// edge meets an edge. Expanding the determinant in e, the first order term is
+// the sum of the gradients with respect to the moved points, dotted with
+// (1, h, h^2); higher orders vanish because the same vector is added to each.
+
+/// Bits of the points of orient3d_moved() that belong to b.
+constexpr unsigned moved_a = 1;
+constexpr unsigned moved_b = 2;
+constexpr unsigned moved_c = 4;
+constexpr unsigned moved_d = 8;
+
+/// orient3d() with the points in `moved` perturbed. Zero only for degenerate
+/// configurations, such as a collinear triangle.
+int orient3d_moved(const Point& a, const Point& b, const Point& c, const Point& d,
+                   unsigned moved) {
+    if (const int s = orient3d(a, b, c, d)) {
+        return s;
+    }
+    const ExactPoint u = exact_sub(b, a);
+    const ExactPoint v = exact_sub(c, a);
+    const ExactPoint w = exact_sub(d, a);
+    // Gradients of the determinant with respect to b, c and d; that with
+    // respect to a is minus their sum.
+    const std::array<ExactPoint, 3> gradient = {exact_cross(v, w), exact_cross(w, u),
+                                                exact_cross(u, v)};
+    for (int k = 0; k < 3; ++k) {
+        Exact g;
+        for (int i = 0; i < 3; ++i) {
+            const bool by_point = (moved & (moved_b << i)) != 0;
+            if (by_point != ((moved & moved_a) != 0)) {
+                g = by_point ? g + gradient[i][k] : g - gradient[i][k];
+            }
+        }
+        if (const int s = g.sign()) {
+            return s;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Cutting
+
+struct Triangle {
+    std::array<std::uint32_t, 3> corners;
+    std::array<Point, 3> points;
+};
+
+Point position(const Mesh& mesh, std::uint32_t v) noexcept {
+    const std::span<const double> p = mesh.positions();
+    return {p[3 * v], p[3 * v + 1], p[3 * v + 2]};
+}
+
+Triangle triangle_of(const Mesh& mesh, std::uint32_t f) noexcept {
+    Triangle t;
+    for (int k = 0; k < 3; ++k) {
+        t.corners[k] = mesh.corners()[3 * f + k];
+        t.points[k] = position(mesh, t.corners[k]);
+    }
+    return t;
+}
+
+bool degenerate(const Triangle& t) noexcept {
+    const Point n = cross(sub(t.points[1], t.points[0]), sub(t.points[2], t.points[0]));
+    return n[0] == 0 && n[1] == 0 && n[2] == 0;
+}
+
+std::uint64_t edge_key(std::uint32_t u, std::uint32_t v) noexcept {
+    return std::uint64_t{std::min(u, v)} << 32 | std::max(u, v);
+}
+
+std::uint64_t directed_key(std::uint32_t from, std::uint32_t to) noexcept {
+    return std::uint64_t{from} << 32 | to;
+}
+
+/// Where an edge of one mesh passes through a triangle of the other.
+struct Crossing {
+    /// 0 if the edge is a's, 1 if it is b's.
+    std::uint32_t side = 0;
+    /// edge_key() of the edge's vertices, in its own mesh.
+    std::uint64_t edge = 0;
+    /// The triangle of the other mesh.
+    std::uint32_t triangle = 0;
+    Point point{};
+
+    auto key() const noexcept { return std::tie(side, edge, triangle); }
+};
+
+/// The cut of triangle `a` of a by triangle `b` of b, directed along
+/// n_a x n_b, so that a lies inside b to the left of it and b inside a to
+/// the right.
+struct Segment {
+    std::uint32_t a = 0;
+    std::uint32_t b = 0;
+    std::array<Crossing, 2> ends;
+    /// Filled in once crossings are numbered.
+    std::array<std::uint32_t, 2> ids{};
+};
+
+/// Where the edges a0-a1 of a and b0-b1 of b, which meet, meet. The ends go
+/// in edge_key() order and a's edge first, so that every crossing at the
+/// point computes it the same way.
+Point meet(const Point& a0, const Point& a1, const Point& b0, const Point& b1) {
+    const Point da = sub(a1, a0);
+    const Point db = sub(b1, b0);
+    const Point n = cross(da, db);
+    const double nn = dot(n, n);
+    const double f = nn > 0 ? std::clamp(dot(cross(sub(b0, a0), db), n) / nn, 0.0, 1.0) : 0.5;
+    return {a0[0] + da[0] * f, a0[1] + da[1] * f, a0[2] + da[2] * f};
+}
+
+/// Whether edge u-v crosses triangle `t` of the other mesh, and where. The
+/// ends are passed in edge_key() order, so both triangles on the edge
+/// compute the same point.
+///
+/// The point is where the crossing tends as the perturbation vanishes. Where
+/// that is a vertex of either mesh, the vertex's own position is returned,
+/// and where the edge passes through an edge of `t`, the point where the two
+/// meet is; so the crossings that coincide without the perturbation share a
+/// position and are merged, however they were found.
+bool edge_crosses(const Point& u, const Point& v, const Triangle& t, bool edge_of_b, Point& at) {
+    const std::array<Point, 3>& p = t.points;
+    const unsigned plane_moved = edge_of_b ? moved_d : moved_a | moved_b | moved_c;
+    const int ru = orient3d(p[0], p[1], p[2], u);
+    const int rv = orient3d(p[0], p[1], p[2], v);
+    const int su = ru != 0 ? ru : orient3d_moved(p[0], p[1], p[2], u, plane_moved);
+    const int sv = rv != 0 ? rv : orient3d_moved(p[0], p[1], p[2], v, plane_moved);
+    if (su == 0 || sv == 0 || su == sv) {
+        return false;
+    }
+    // Through the triangle if the edge passes each side of it the same way.
+    const unsigned line_moved = edge_of_b ? moved_a | moved_b : moved_c | moved_d;
+    std::array<int, 3> through{};
+    int s = 0;
+    for (int k = 0; k < 3; ++k) {
+        through[k] = orient3d(u, v, p[k], p[(k + 1) % 3]);
+        const int sk =
+            through[k] != 0 ? through[k] : orient3d_moved(u, v, p[k], p[(k + 1) % 3], line_moved);
+        if (sk == 0 || (k > 0 && sk != s)) {
+            return false;
+        }
+        s = sk;
+    }
+    if (ru == 0) {
+        at = u;
+        return true;
+    }
+    if (rv == 0) {
+        at = v;
+        return true;
+    }
+    for (int k = 0; k < 3; ++k) {
+        const int before = (k + 2) % 3;
+        if (through[k] == 0 && through[before] == 0) {
+            at = p[k]; // through the corner the two sides share
+            return true;
+        }
+    }
+    for (int k = 0; k < 3; ++k) {
+        if (through[k] == 0) {
+            const bool ordered = t.corners[k] < t.corners[(k + 1) % 3];
+            const Point& w0 = ordered ? p[k] : p[(k + 1) % 3];
+            const Point& w1 = ordered ? p[(k + 1) % 3] : p[k];
+            at = edge_of_b ? meet(w0, w1, u, v) : meet(u, v, w0, w1);
+            return true;
+        }
+    }
+    // Where the edge meets the plane, from the distances of its ends.
+    const Point n = cross(sub(p[1], p[0]), sub(p[2], p[0]));
+    const double du = dot(n, sub(u, p[0]));
+    const double dv = dot(n, sub(v, p[0]));
+    const double f = du != dv ? std::clamp(du / (du - dv), 0.0, 1.0) : 0.5;
+    for (int i = 0; i < 3; ++i) {
+        at[i] = u[i] + (v[i] - u[i]) * f;
+    }
+    return true;
+}
+
+/// The cut of a pair of triangles, if they cross: two of the crossings of
+/// an edge of either with the other.
+bool cut(const Mesh& a, std::uint32_t fa, const Mesh& b, std::uint32_t fb, Segment& out) {
+    const Triangle ta = triangle_of(a, fa);
+    const Triangle tb = triangle_of(b, fb);
+    if (degenerate(ta) || degenerate(tb)) {
+        return false;
+    }
+    std::size_t found = 0;
+    const auto edges = [&](const Mesh& mesh, const Triangle& own, const Triangle& other,
+                           std::uint32_t side, std::uint32_t other_face) {
+        for (int k = 0; k < 3; ++k) {
+            const std::uint32_t u = std::min(own.corners[k], own.corners[(k + 1) % 3]);
+            const std::uint32_t v = std::max(own.corners[k], own.corners[(k + 1) % 3]);
+            Point at;
+            if (edge_crosses(position(mesh, u), position(mesh, v), other, side == 1, at)) {
+                if (found < 2) {
+                    out.ends[found] = {side, edge_key(u, v), other_face, at};
+                }
+                ++found;
+            }
+        }
+    };
+    edges(a, ta, tb, 0, fb);
+    edges(b, tb, ta, 1, fa);
+    if (found != 2) {
+        return false; // 0 unless a triangle is nearly degenerate
+    }
+    out.a = fa;
+    out.b = fb;
+    const Point na = cross(sub(ta.points[1], ta.points[0]), sub(ta.points[2], ta.points[0]));
+    const Point nb = cross(sub(tb.points[1], tb.points[0]), sub(tb.points[2], tb.points[0]));
+    if (dot(sub(out.ends[1].point, out.ends[0].point), cross(na, nb)) < 0) {
+        std::swap(out.ends[0], out.ends[1]);
+    }
+    return true;
+}
+
+/// A triangle re-triangulated around the segments cutting it, in its plane
+/// projected along the dominant axis of its normal. Triangles are cut a few
+/// times at most, so plain scans over the pieces do.
+class Retriangulation {
+public:
+    explicit Retriangulation(const Triangle& t) {
+        const Point n = cross(sub(t.points[1], t.points[0]), sub(t.points[2], t.points[0]));
+        const int k = std::abs(n[0]) >= std::abs(n[1]) && std::abs(n[0]) >= std::abs(n[2]) ? 0
+                      : std::abs(n[1]) >= std::abs(n[2])                                 ? 1
+                                                                                          : 2;
+        x_ = (k + 1) % 3;
+        y_ = (k + 2) % 3;
+        if (n[k] < 0) {
+            std::swap(x_, y_); // keep the corners counterclockwise
+        }
+        for (int i = 0; i < 3; ++i) {
+            add_vertex(t.corners[i], t.points[i], (1u << i) | (1u << (i + 2) % 3));
+        }
+        pieces_.push_back({0, 1, 2});
+        edge_tail_ = {0, 1, 2};
+    }
+
+    /// Adds a point on the edge from corner `edge` to the next. Points on
+    /// an edge go in order from its start.
+    void add_on_edge(int edge, std::uint32_t id, const Point& p) {
+        if (find(id) != none) {
+            return;
+        }
+        const std::uint32_t v = add_vertex(id, p, 1u << edge);
+        split_edge(edge_tail_[edge], static_cast<std::uint32_t>((edge + 1) % 3), v);
+        edge_tail_[edge] = v;
+    }
+
+    void add_inside(std::uint32_t id, const Point& p) {
+        if (find(id) != none) {
+            return;
+        }
+        const std::uint32_t v = add_vertex(id, p, 0);
+        for (std::size_t t = 0; t < pieces_.size(); ++t) {
+            const std::array<std::uint32_t, 3> c = pieces_[t];
+            std::array<int, 3> o;
+            for (int i = 0; i < 3; ++i) {
+                o[i] = orient(c[(i + 1) % 3], c[(i + 2) % 3], v);
+            }
+            if (o[0] < 0 || o[1] < 0 || o[2] < 0) {
+                continue;
+            }
+            const int zeros = (o[0] == 0) + (o[1] == 0) + (o[2] == 0);
+            if (zeros == 0) {
+                pieces_[t] = {c[0], c[1], v};
+                pieces_.push_back({c[1], c[2], v});
+                pieces_.push_back({c[2], c[0], v});
+            } else if (zeros == 1) {
+                const int i = o[0] == 0 ? 0 : o[1] == 0 ? 1 : 2;
+                split_inside_edge(c[(i + 1) % 3], c[(i + 2) % 3], v);
+            } else {
+                alias(v, c[o[0] != 0 ? 0 : o[1] != 0 ? 1 : 2]);
+            }
+            return;
+        }
+        // Rounded to just outside the triangle: onto the nearest boundary
+        // edge it is beyond.
+        for (const std::array<std::uint32_t, 3>& c : pieces_) {
+            for (int i = 0; i < 3; ++i) {
+                const std::uint32_t from = c[i];
+                const std::uint32_t to = c[(i + 1) % 3];
+                if (orient(from, to, v) < 0 && !find_piece(to, from)) {
+                    split_inside_edge(from, to, v);
+                    return;
+                }
+            }
+        }
+        alias(v, dropped);
+    }
+
+    /// Makes the segment between the points `from` and `to` an edge,
+    /// flipping the edges across it.
+    void constrain(std::uint32_t from_id, std::uint32_t to_id) {
+        const std::uint32_t from = resolve(find(from_id));
+        const std::uint32_t to = resolve(find(to_id));
+        if (from != none && to != none && from != to) {
+            constrain_local(from, to, 0);
+        }
+    }
+
+    /// Points added inside that ended up on an edge of the triangle, as the
+    /// edge and the point's id. The triangle across the edge needs them too.
+    std::vector<std::pair<int, std::uint32_t>> strays() const {
+        std::vector<std::pair<int, std::uint32_t>> out;
+        for (const std::uint32_t v : strays_) {
+            out.emplace_back(std::countr_zero(edges_[v]), ids_[v]);
+        }
+        return out;
+    }
+
+    /// Appends the pieces, as triangles of global vertex ids.
+    void emit(std::vector<std::uint32_t>& out) const {
+        for (const std::array<std::uint32_t, 3>& c : pieces_) {
+            for (const std::uint32_t v : c) {
+                out.push_back(ids_[v]);
+            }
+        }
+    }
+
+private:
+    static constexpr std::uint32_t none = Mesh::invalid;
+    /// Aliased to by a point that fits nowhere.
+    static constexpr std::uint32_t dropped = none - 1;
+
+    /// `edges` has bit k set for a point on the edge from corner k.
+    std::uint32_t add_vertex(std::uint32_t id, const Point& p, unsigned edges) {
+        ids_.push_back(id);
+        xy_.push_back({p[x_], p[y_]});
+        aliases_.push_back(none);
+        edges_.push_back(static_cast<std::uint8_t>(edges));
+        return static_cast<std::uint32_t>(ids_.size() - 1);
+    }
+
+    /// split_edge() for a point added inside, noting it if the edge turns
+    /// out to be on the triangle's boundary.
+    void split_inside_edge(std::uint32_t a, std::uint32_t b, std::uint32_t v) {
+        if (!find_piece(b, a)) {
+            edges_[v] = edges_[a] & edges_[b];
+            if (edges_[v] != 0) {
+                strays_.push_back(v);
+            }
+        }
+        split_edge(a, b, v);
+    }
+
+    std::uint32_t find(std::uint32_t id) const noexcept {
+        const auto it = std::find(ids_.begin(), ids_.end(), id);
+        return it == ids_.end() ? none : static_cast<std::uint32_t>(it - ids_.begin());
+    }
+
+    /// A point that landed on an existing vertex stands for it.
+    void alias(std::uint32_t v, std::uint32_t to) noexcept { aliases_[v] = to; }
+    std::uint32_t resolve(std::uint32_t v) const noexcept {
+        if (v == none || aliases_[v] == none) {
+            return v;
+        }
+        return aliases_[v] == dropped ? none : aliases_[v];
+    }
+
+    int orient(std::uint32_t a, std::uint32_t b, std::uint32_t c) const {
+        return orient2d(xy_[a], xy_[b], xy_[c]);
+    }
+
+    /// The piece with the directed edge from -> to, and where in it.
+    bool find_piece(std::uint32_t from, std::uint32_t to, std::size_t* piece = nullptr,
+                    int* at = nullptr) const noexcept {
+        for (std::size_t t = 0; t < pieces_.size(); ++t) {
+            for (int i = 0; i < 3; ++i) {
+                if (pieces_[t][i] == from && pieces_[t][(i + 1) % 3] == to) {
+                    if (piece != nullptr) {
+                        *piece = t;
+                        *at = i;
+                    }
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /// Splits the pieces on either side of edge a-b at `v`.
+    void split_edge(std::uint32_t a, std::uint32_t b, std::uint32_t v) {
+        for (const auto& [from, to] : {std::pair(a, b), std::pair(b, a)}) {
+            std::size_t t = 0;
+            int i = 0;
+            if (find_piece(from, to, &t, &i)) {
+                const std::uint32_t opposite = pieces_[t][(i + 2) % 3];
+                pieces_[t] = {from, v, opposite};
+                pieces_.push_back({v, to, opposite});
+            }
+        }
+    }
+
+    bool is_constraint(std::uint32_t a, std::uint32_t b) const noexcept {
+        return std::find(constraints_.begin(), constraints_.end(), edge_key(a, b)) !=
+               constraints_.end();
+    }
+
+    void constrain_local(std::uint32_t from, std::uint32_t to, int depth) {
+        // Flips are bounded in exact arithmetic; the cap guards against
+        // rounded points that make two cuts cross.
+        const std::size_t max_flips = 4 * pieces_.size() * pieces_.size() + 16;
+        for (std::size_t flip = 0; flip < max_flips; ++flip) {
+            if (find_piece(from, to) || find_piece(to, from)) {
+                constraints_.push_back(edge_key(from, to));
+                return;
+            }
+            // A vertex on the segment splits it in two.
+            for (std::uint32_t v = 0; v < xy_.size(); ++v) {
+                if (v == from || v == to || aliases_[v] != none || orient(from, to, v) != 0) {
+                    continue;
+                }
+                const Xy& p = xy_[from];
+                const Xy& q = xy_[to];
+                const Xy& w = xy_[v];
+                const double along = (w[0] - p[0]) * (q[0] - p[0]) + (w[1] - p[1]) * (q[1] - p[1]);
+                const double back = (w[0] - q[0]) * (p[0] - q[0]) + (w[1] - q[1]) * (p[1] - q[1]);
+                if (along > 0 && back > 0 && depth < 8) {
+                    constrain_local(from, v, depth + 1);
+                    constrain_local(v, to, depth + 1);
+                    return;
+                }
+            }
+            if (!flip_crossing(from, to)) {
+                return;
+            }
+        }
+    }
+
+    /// Flips one edge crossing from-to whose quadrilateral is convex.
+    bool flip_crossing(std::uint32_t from, std::uint32_t to) {
+        for (std::size_t t = 0; t < pieces_.size(); ++t) {
+            for (int i = 0; i < 3; ++i) {
+                const std::uint32_t a = pieces_[t][i];
+                const std::uint32_t b = pieces_[t][(i + 1) % 3];
+                if (is_constraint(a, b) || orient(from, to, a) * orient(from, to, b) >= 0 ||
+                    orient(a, b, from) * orient(a, b, to) >= 0) {
+                    continue;
+                }
+                std::size_t u = 0;
+                int j = 0;
+                if (!find_piece(b, a, &u, &j)) {
+                    continue;
+                }
+                const std::uint32_t c = pieces_[t][(i + 2) % 3];
+                const std::uint32_t d = pieces_[u][(j + 2) % 3];
+                if (orient(c, d, a) * orient(c, d, b) >= 0) {
+                    continue; // not convex
+                }
+                pieces_[t] = {a, d, c};
+                pieces_[u] = {d, b, c};
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int x_ = 0;
+    int y_ = 1;
+    std::vector<std::uint32_t> ids_;
+    std::vector<Xy> xy_;
+    std::vector<std::uint32_t> aliases_;
+    std::vector<std::uint8_t> edges_;
+    std::vector<std::uint32_t> strays_;
+    std::vector<std::array<std::uint32_t, 3>> pieces_;
+    std::vector<std::uint64_t> constraints_;
+    std::array<std::uint32_t, 3> edge_tail_{};
+};
+
+/// One of the two meshes, with its pieces once cut.
+struct Side {
+    const Mesh* mesh = nullptr;
+    const Bvh* bvh = nullptr;
+    /// Added to its vertex ids in the combined vertex list.
+    std::uint32_t offset = 0;
+    /// Segments by triangle, in compressed rows.
+    std::vector<std::uint32_t> offsets;
+    std::vector<std::uint32_t> segments;
+    /// The triangles after cutting, over the combined vertex list.
+    Mesh pieces;
+    /// Whether each piece lies inside the other mesh.
+    std::vector<std::uint8_t> inside;
+};
+
+void group_segments(Side& side, const std::vector<Segment>& segments, bool by_b) {
+    const std::size_t faces = side.mesh->face_count();
+    side.offsets.assign(faces + 1, 0);
+    for (const Segment& s : segments) {
+        ++side.offsets[(by_b ? s.b : s.a) + 1];
+    }
+    for (std::size_t f = 0; f < faces; ++f) {
+        side.offsets[f + 1] += side.offsets[f];
+    }
+    side.segments.resize(segments.size());
+    std::vector<std::uint32_t> fill(side.offsets.begin(), side.offsets.end() - 1);
+    for (std::size_t i = 0; i < segments.size(); ++i) {
+        side.segments[fill[by_b ? segments[i].b : segments[i].a]++] =
+            static_cast<std::uint32_t>(i);
+    }
+}
+
+/// A point on an edge of one side, by the edge_key() of its vertex ids.
+struct EdgePoint {
+    std::uint64_t edge = 0;
+    std::uint32_t id = 0;
+
+    friend auto operator<=>(const EdgePoint&, const EdgePoint&) = default;
+};
+
+/// Cuts the triangles of `side` (0 for a, 1 for b) along their segments.
+/// Vertices are renamed to their `canonical` ids.
+void cut_side(Side& side, std::uint32_t index, const std::vector<Segment>& segments,
+              const std::vector<std::uint32_t>& canonical, const Buffer& positions,
+              ThreadPool* pool) {
+    const Mesh& mesh = *side.mesh;
+    const std::size_t faces = mesh.face_count();
+    const std::span<const double> p = positions.view<double>();
+    const auto point = [&](std::uint32_t v) { return Point{p[3 * v], p[3 * v + 1], p[3 * v + 2]}; };
+
+    // Re-triangulates face f with the ends of its segments and `extra`
+    // points on its edges.
+    const auto retriangulate = [&](std::size_t f, std::span<const EdgePoint> extra,
+                                   std::vector<std::uint32_t>& out,
+                                   std::vector<EdgePoint>* strays) {
+        Triangle t;
+        for (int k = 0; k < 3; ++k) {
+            t.corners[k] = canonical[mesh.corners()[3 * f + k] + side.offset];
+            t.points[k] = point(t.corners[k]);
+        }
+        // Points on the edges go in order along each.
+        std::array<std::vector<std::pair<double, std::uint32_t>>, 3> on_edge;
+        const auto add_on_edge = [&](int k, std::uint32_t id) {
+            const Point d = sub(t.points[(k + 1) % 3], t.points[k]);
+            on_edge[k].emplace_back(dot(sub(point(id), t.points[k]), d), id);
+        };
+        std::vector<std::uint32_t> inside;
+        for (std::uint32_t s = side.offsets[f]; s < side.offsets[f + 1]; ++s) {
+            const Segment& segment = segments[side.segments[s]];
+            for (int e = 0; e < 2; ++e) {
+                const Crossing& c = segment.ends[e];
+                if (c.side != index) {
+                    inside.push_back(segment.ids[e]);
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    if (edge_key(mesh.corners()[3 * f + k], mesh.corners()[3 * f + (k + 1) % 3]) ==
+                        c.edge) {
+                        add_on_edge(k, segment.ids[e]);
+                    }
+                }
+            }
+        }
+        for (const EdgePoint& x : extra) {
+            for (int k = 0; k < 3; ++k) {
+                if (edge_key(t.corners[k], t.corners[(k + 1) % 3]) == x.edge) {
+                    add_on_edge(k, x.id);
+                }
+            }
+        }
+
+        Retriangulation r(t);
+        for (int k = 0; k < 3; ++k) {
+            std::sort(on_edge[k].begin(), on_edge[k].end());
+            for (const auto& [along, id] : on_edge[k]) {
+                r.add_on_edge(k, id, point(id));
+            }
+        }
+        for (const std::uint32_t id : inside) {
+            r.add_inside(id, point(id));
+        }
+        for (std::uint32_t s = side.offsets[f]; s < side.offsets[f + 1]; ++s) {
+            const Segment& segment = segments[side.segments[s]];
+            r.constrain(segment.ids[0], segment.ids[1]);
+        }
+        r.emit(out);
+        if (strays != nullptr) {
+            for (const auto& [k, id] : r.strays()) {
+                strays->push_back({edge_key(t.corners[k], t.corners[(k + 1) % 3]), id});
+            }
+        }
+    };
+
+    std::vector<std::vector<std::uint32_t>> cuts(faces);
+    std::vector<std::vector<EdgePoint>> strays(faces);
+    parallel_for(pool, faces, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t f = begin; f < end; ++f) {
+            if (side.offsets[f] != side.offsets[f + 1]) {
+                retriangulate(f, {}, cuts[f], &strays[f]);
+            }
+        }
+    });
+
+    // A point of the other mesh can land exactly on an edge, which only one
+    // of the triangles on the edge is cut at. Both are re-cut with it, as a
+    // point on the edge, so that no vertex sits in the middle of an edge.
+    std::vector<EdgePoint> on_edges;
+    for (const std::vector<EdgePoint>& s : strays) {
+        on_edges.insert(on_edges.end(), s.begin(), s.end());
+    }
+    if (!on_edges.empty()) {
+        std::sort(on_edges.begin(), on_edges.end());
+        on_edges.erase(std::unique(on_edges.begin(), on_edges.end()), on_edges.end());
+        parallel_for(pool, faces, grain, [&](std::size_t begin, std::size_t end) {
+            std::vector<EdgePoint> extra;
+            for (std::size_t f = begin; f < end; ++f) {
+                extra.clear();
+                for (int k = 0; k < 3; ++k) {
+                    const std::uint64_t edge =
+                        edge_key(canonical[mesh.corners()[3 * f + k] + side.offset],
+                                 canonical[mesh.corners()[3 * f + (k + 1) % 3] + side.offset]);
+                    const auto first = std::lower_bound(on_edges.begin(), on_edges.end(),
+                                                        EdgePoint{edge, 0});
+                    for (auto it = first; it != on_edges.end() && it->edge == edge; ++it) {
+                        extra.push_back(*it);
+                    }
+                }
+                if (!extra.empty()) {
+                    cuts[f].clear();
+                    retriangulate(f, extra, cuts[f], nullptr);
+                }
+            }
+        });
+    }
+
+    std::vector<std::uint32_t> pieces;
+    pieces.reserve(faces * 3 + segments.size() * 12);
+    for (std::size_t f = 0; f < faces; ++f) {
+        if (cuts[f].empty()) {
+            for (int k = 0; k < 3; ++k) {
+                pieces.push_back(canonical[mesh.corners()[3 * f + k] + side.offset]);
+            }
+        } else {
+            pieces.insert(pieces.end(), cuts[f].begin(), cuts[f].end());
+        }
+    }
+    side.pieces = Mesh::from_triangles(positions, Buffer::adopt(std::move(pieces), 3), pool);
+}
+
+/// Rays for parity tests, along directions unlikely to graze edges of
+/// axis-aligned or gridded meshes. The majority of three decides.
+constexpr std::array<Point, 3> parity_rays = {{{0.8017, 0.3292, 0.4989},
+                                               {-0.2741, 0.8803, 0.3871},
+                                               {0.4211, -0.5317, -0.7348}}};
+
+bool inside_by_parity(const Bvh& other, const Point& p) {
+    int odd = 0;
+    for (const Point& d : parity_rays) {
+        odd += static_cast<int>(other.crossings(p, d) % 2);
+    }
+    return odd >= 2;
+}
+
+/// Decides which pieces of `side` are inside the other mesh: next to a cut
+/// by its direction, elsewhere by flooding across uncut edges, and regions
+/// no cut reaches by parity.
+void classify(Side& side, std::uint32_t index, const std::vector<std::uint64_t>& cuts,
+              const Bvh& other, ThreadPool* pool) {
+    const Mesh& pieces = side.pieces;
+    const std::size_t faces = pieces.face_count();
+    const auto is_cut = [&](std::uint32_t from, std::uint32_t to) {
+        return std::binary_search(cuts.begin(), cuts.end(), directed_key(from, to));
+    };
+
+    std::vector<std::uint32_t> region(faces, Mesh::invalid);
+    // Per region: votes for inside and outside, and a piece to test.
+    std::vector<std::array<std::uint32_t, 3>> regions;
+    std::vector<std::uint32_t> queue;
+    for (std::uint32_t seed = 0; seed < faces; ++seed) {
+        if (region[seed] != Mesh::invalid) {
+            continue;
+        }
+        const auto r = static_cast<std::uint32_t>(regions.size());
+        std::array<std::uint32_t, 3> votes = {0, 0, seed};
+        region[seed] = r;
+        queue.assign(1, seed);
+        while (!queue.empty()) {
+            const std::uint32_t f = queue.back();
+            queue.pop_back();
+            for (std::uint32_t h = 3 * f; h < 3 * f + 3; ++h) {
+                const std::uint32_t from = pieces.origin(h);
+                const std::uint32_t to = pieces.target(h);
+                // a is inside b to the left of a cut, b inside a to the right.
+                const bool forward = is_cut(from, to);
+                const bool backward = is_cut(to, from);
+                if (forward || backward) {
+                    ++votes[forward == (index == 0) ? 0 : 1];
+                    continue;
+                }
+                const std::uint32_t twin = pieces.twin(h);
+                if (twin != Mesh::invalid && region[Mesh::face(twin)] == Mesh::invalid) {
+                    region[Mesh::face(twin)] = r;
+                    queue.push_back(Mesh::face(twin));
+                }
+            }
+        }
+        regions.push_back(votes);
+    }
+
+    std::vector<std::uint8_t> inside(regions.size());
+    parallel_for(pool, regions.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t r = begin; r < end; ++r) {
+            const std::array<std::uint32_t, 3>& votes = regions[r];
+            if (votes[0] != votes[1]) {
+                inside[r] = votes[0] > votes[1] ? 1 : 0;
+                continue;
+            }
+            Point centroid{};
+            for (std::uint32_t h = 3 * votes[2]; h < 3 * votes[2] + 3; ++h) {
+                const Point p = position(pieces, pieces.origin(h));
+                for (int i = 0; i < 3; ++i) {
+                    centroid[i] += p[i] / 3;
+                }
+            }
+            inside[r] = inside_by_parity(other, centroid) ? 1 : 0;
+        }
+    });
+    side.inside.resize(faces);
+    for (std::size_t f = 0; f < faces; ++f) {
+        side.inside[f] = inside[region[f]];
+    }
+}
+
+/// A triangle's vertices in increasing order and which way it faces.
+struct FacingKey {
+    std::array<std::uint32_t, 3> sorted{};
+    bool odd = false;
+    std::uint32_t triangle = 0;
+
+    friend auto operator<=>(const FacingKey&, const FacingKey&) = default;
+};
+
+/// Removes pairs of triangles on the same three vertices facing opposite
+/// ways: the two sides of a sheet of no volume, left where the meshes share
+/// a plane and the perturbation separates them by an infinitesimal gap.
+void drop_opposite_pairs(std::vector<std::uint32_t>& triangles) {
+    std::vector<FacingKey> keys(triangles.size() / 3);
+    for (std::size_t t = 0; t < keys.size(); ++t) {
+        std::array<std::uint32_t, 3> c{triangles[3 * t], triangles[3 * t + 1],
+                                       triangles[3 * t + 2]};
+        // With the smallest vertex first, the other two are in increasing
+        // order for one facing and decreasing for the other.
+        std::rotate(c.begin(), std::min_element(c.begin(), c.end()), c.end());
+        const bool odd = c[1] > c[2];
+        if (odd) {
+            std::swap(c[1], c[2]);
+        }
+        keys[t] = {c, odd, static_cast<std::uint32_t>(t)};
+    }
+    std::sort(keys.begin(), keys.end());
+    std::vector<char> dropped(keys.size(), 0);
+    for (std::size_t i = 0; i < keys.size();) {
+        std::size_t even = i;
+        std::size_t j = i;
+        for (; j < keys.size() && keys[j].sorted == keys[i].sorted; ++j) {
+            even += keys[j].odd ? 0 : 1;
+        }
+        // [i, even) face one way and [even, j) the other.
+        for (std::size_t k = 0; k < std::min(even - i, j - even); ++k) {
+            dropped[keys[i + k].triangle] = 1;
+            dropped[keys[even + k].triangle] = 1;
+        }
+        i = j;
+    }
+    std::size_t out = 0;
+    for (std::size_t t = 0; t < dropped.size(); ++t) {
+        if (dropped[t] == 0) {
+            std::copy_n(triangles.begin() + 3 * t, 3, triangles.begin() + 3 * out);
+            ++out;
+        }
+    }
+    triangles.resize(3 * out);
+}
+
+} // namespace
+
+const char* to_string(BooleanOperation operation) noexcept {
+    switch (operation) {
+    case BooleanOperation::Union: return "union";
+    case BooleanOperation::Intersection: return "intersection";
+    case BooleanOperation::Difference: return "difference";
+    }
+    return "?";
+}
+
+Mesh mesh_boolean(const Mesh& a, const Mesh& b, BooleanOperation operation, ThreadPool* pool) {
+    if (a.vertex_count() + b.vertex_count() >= Mesh::invalid / 2) {
+        throw Error("too many vertices for a mesh boolean");
+    }
+    const Bvh bvh_a = Bvh::build(a, pool);
+    const Bvh bvh_b = Bvh::build(b, pool);
+
+    // Candidate pairs: triangles whose boxes touch, with a margin for
+    // rounding in the distance the traversal computes.
+    double extent = 0;
+    for (const Mesh* m : {&a, &b}) {
+        for (const double x : m->positions()) {
+            extent = std::max(extent, std::abs(x));
+        }
+    }
+    const std::vector<Bvh::Overlap> candidates = bvh_a.overlaps(bvh_b, extent * 1e-9, pool);
+
+    std::vector<Segment> found(candidates.size());
+    std::vector<std::uint8_t> cuts(candidates.size());
+    parallel_for(pool, candidates.size(), grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            cuts[i] = cut(a, candidates[i].first, b, candidates[i].second, found[i]) ? 1 : 0;
+        }
+    });
+    std::vector<Segment> segments;
+    for (std::size_t i = 0; i < found.size(); ++i) {
+        if (cuts[i] != 0) {
+            segments.push_back(found[i]);
+        }
+    }
+
+    // Number the crossings after both meshes' vertices. Each crossing of an
+    // edge is found once per triangle on the edge, at the same point.
+    std::vector<Crossing> crossings;
+    crossings.reserve(segments.size() * 2);
+    for (const Segment& s : segments) {
+        crossings.insert(crossings.end(), s.ends.begin(), s.ends.end());
+    }
+    const auto by_key = [](const Crossing& x, const Crossing& y) { return x.key() < y.key(); };
+    std::sort(crossings.begin(), crossings.end(), by_key);
+    crossings.erase(std::unique(crossings.begin(), crossings.end(),
+                                [](const Crossing& x, const Crossing& y) {
+                                    return x.key() == y.key();
+                                }),
+                    crossings.end());
+    const auto first_crossing = static_cast<std::uint32_t>(a.vertex_count() + b.vertex_count());
+    parallel_for(pool, segments.size(), grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            for (int e = 0; e < 2; ++e) {
+                const auto it = std::lower_bound(crossings.begin(), crossings.end(),
+                                                 segments[i].ends[e], by_key);
+                segments[i].ids[e] =
+                    first_crossing + static_cast<std::uint32_t>(it - crossings.begin());
+            }
+        }
+    });
+
+    std::vector<double> all(3 * (first_crossing + crossings.size()));
+    std::copy(a.positions().begin(), a.positions().end(), all.begin());
+    std::copy(b.positions().begin(), b.positions().end(), all.begin() + 3 * a.vertex_count());
+    for (std::size_t i = 0; i < crossings.size(); ++i) {
+        std::copy_n(crossings[i].point.data(), 3, all.data() + 3 * (first_crossing + i));
+    }
+    const Buffer positions = Buffer::adopt(std::move(all), 3);
+
+    // Points distinct only under the perturbation, such as a crossing on a
+    // vertex or two crossings where an edge meets an edge, are given the same
+    // position by edge_crosses(). They cannot be told apart in the plane of a
+    // cut triangle, so they are merged into the lowest id. So are vertices
+    // of b on vertices of a, cut or not, so that the sheets where the meshes
+    // coincide have the same vertices on both sides and can be dropped; a
+    // mesh's own coincident vertices are left apart.
+    std::vector<std::uint32_t> canonical(positions.tuples());
+    for (std::uint32_t v = 0; v < canonical.size(); ++v) {
+        canonical[v] = v;
+    }
+    {
+        const std::span<const double> p = positions.view<double>();
+        const auto at = [&](std::uint32_t v) {
+            return std::tie(p[3 * v], p[3 * v + 1], p[3 * v + 2]);
+        };
+        std::vector<std::uint32_t> order = canonical;
+        std::sort(order.begin(), order.end(), [&](std::uint32_t x, std::uint32_t y) {
+            return std::tuple_cat(at(x), std::tie(x)) < std::tuple_cat(at(y), std::tie(y));
+        });
+        const auto b_first = static_cast<std::uint32_t>(a.vertex_count());
+        const auto mesh_of = [&](std::uint32_t v) {
+            return v < b_first ? 0 : v < first_crossing ? 1 : 2;
+        };
+        for (std::size_t i = 1, head = 0; i < order.size(); ++i) {
+            if (at(order[i]) != at(order[head])) {
+                head = i;
+            } else if (mesh_of(order[i]) == 2 || mesh_of(order[i]) != mesh_of(order[head])) {
+                canonical[order[i]] = order[head];
+            }
+        }
+    }
+    std::vector<std::uint64_t> cut_edges;
+    for (Segment& s : segments) {
+        s.ids = {canonical[s.ids[0]], canonical[s.ids[1]]};
+        if (s.ids[0] != s.ids[1]) {
+            cut_edges.push_back(directed_key(s.ids[0], s.ids[1]));
+        }
+    }
+    std::sort(cut_edges.begin(), cut_edges.end());
+
+    std::array<Side, 2> sides;
+    sides[0].mesh = &a;
+    sides[0].bvh = &bvh_a;
+    sides[1].mesh = &b;
+    sides[1].bvh = &bvh_b;
+    sides[1].offset = static_cast<std::uint32_t>(a.vertex_count());
+    for (std::uint32_t s = 0; s < 2; ++s) {
+        group_segments(sides[s], segments, s == 1);
+        cut_side(sides[s], s, segments, canonical, positions, pool);
+        classify(sides[s], s, cut_edges, *sides[1 - s].bvh, pool);
+    }
+
+    // Which pieces to keep, and whether to turn them over.
+    const bool keep_inside_a = operation == BooleanOperation::Intersection;
+    const bool keep_inside_b = operation != BooleanOperation::Union;
+    const bool flip_b = operation == BooleanOperation::Difference;
+    std::vector<std::uint32_t> triangles;
+    for (std::uint32_t s = 0; s < 2; ++s) {
+        const Side& side = sides[s];
+        const bool keep_inside = s == 0 ? keep_inside_a : keep_inside_b;
+        for (std::size_t f = 0; f < side.inside.size(); ++f) {
+            if ((side.inside[f] != 0) != keep_inside) {
+                continue;
+            }
+            const std::uint32_t* c = side.pieces.corners().data() + 3 * f;
+            if (s == 1 && flip_b) {
+                triangles.insert(triangles.end(), {c[0], c[2], c[1]});
+            } else {
+                triangles.insert(triangles.end(), c, c + 3);
+            }
+        }
+    }
+
+    drop_opposite_pairs(triangles);
+
+    // Drop the vertices no piece kept.
+    const std::span<const double> p = positions.view<double>();
+    std::vector<std::uint32_t> remap(p.size() / 3, Mesh::invalid);
+    std::vector<double> kept;
+    for (std::uint32_t& v : triangles) {
+        if (remap[v] == Mesh::invalid) {
+            remap[v] = static_cast<std::uint32_t>(kept.size() / 3);
+            kept.insert(kept.end(), p.begin() + 3 * v, p.begin() + 3 * v + 3);
+        }
+        v = remap[v];
+    }
+    return Mesh::from_triangles(Buffer::adopt(std::move(kept), 3),
+                                Buffer::adopt(std::move(triangles), 3), pool);
+}
+
+} // namespace rebelflow
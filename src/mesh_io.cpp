@@ -0,0 +1,1504 @@
+#include "rebelflow/mesh_io.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/mapped_file.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace rebelflow {
+
+namespace {
+
+/// Text is parsed in blocks of about this many bytes, each ending with a
+/// whole line.
+constexpr std::size_t block_bytes = std::size_t{1} << 20;
+/// Records per parallel range when decoding binary records and per block
+/// when formatting them.
+constexpr std::size_t grain = 16384;
+
+[[noreturn]] void malformed(const std::string& path, const std::string& what) {
+    throw FormatError(path + ": " + what);
+}
+
+/// Reports an error at `at`, by its line in `text`.
+[[noreturn]] void malformed(const std::string& path, std::string_view text, const char* at,
+                            const std::string& what) {
+    const auto line = 1 + std::count(text.data(), at, '\n');
+    throw FormatError(path + ":" + std::to_string(line) + ": " + what);
+}
+
+// ---------------------------------------------------------------------------
+// Text
+
+/// Offsets cutting `text` into blocks of whole lines, from 0 to text.size().
+std::vector<std::size_t> line_blocks(std::string_view text) {
+    std::vector<std::size_t> bounds{0};
+    while (bounds.back() < text.size()) {
+        std::size_t next = bounds.back() + block_bytes;
+        if (next >= text.size()) {
+            next = text.size();
+        } else {
+            const std::size_t newline = text.find('\n', next);
+            next = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        bounds.push_back(next);
+    }
+    return bounds;
+}
+
+/// Calls `fn(begin, end)` for each line in [begin, end), without the line
+/// break.
+template <typename Fn>
+void for_each_line(const char* begin, const char* end, Fn&& fn) {
+    while (begin < end) {
+        const auto* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        const char* stop = newline == nullptr ? end : newline;
+        fn(begin, stop > begin && stop[-1] == '\r' ? stop - 1 : stop);
+        begin = newline == nullptr ? end : newline + 1;
+    }
+}
+
+/// The whitespace-separated fields of one line.
+class Fields {
+public:
+    Fields(const char* begin, const char* end) noexcept : p_(begin), end_(end) {}
+
+    bool done() noexcept {
+        skip_space();
+        return p_ == end_;
+    }
+
+    std::string_view next() noexcept {
+        skip_space();
+        const char* start = p_;
+        while (p_ != end_ && *p_ != ' ' && *p_ != '\t') {
+            ++p_;
+        }
+        return {start, static_cast<std::size_t>(p_ - start)};
+    }
+
+    /// A field that is a number, or false.
+    template <typename T>
+    bool number(T& out) noexcept {
+        std::string_view field = next();
+        if (!field.empty() && field.front() == '+') {
+            field.remove_prefix(1);
+        }
+        const auto [stop, error] = std::from_chars(field.data(), field.data() + field.size(), out);
+        return error == std::errc{} && stop == field.data() + field.size();
+    }
+
+private:
+    void skip_space() noexcept {
+        while (p_ != end_ && (*p_ == ' ' || *p_ == '\t')) {
+            ++p_;
+        }
+    }
+
+    const char* p_;
+    const char* end_;
+};
+
+/// Exclusive prefix sums of `counts`, in place; returns the total.
+std::size_t prefix_sums(std::vector<std::size_t>& counts) {
+    std::size_t total = 0;
+    for (std::size_t& c : counts) {
+        total += std::exchange(c, total);
+    }
+    return total;
+}
+
+Buffer allocate_positions(std::size_t vertices) {
+    return Buffer::allocate(ElementType::F64, vertices * 3, 3);
+}
+
+Buffer allocate_triangles(std::size_t triangles) {
+    return Buffer::allocate(ElementType::U32, triangles * 3, 3);
+}
+
+/// Fans polygons into triangles as their vertices come in.
+class Fan {
+public:
+    explicit Fan(std::uint32_t* out) noexcept : out_(out) {}
+
+    void add(std::uint32_t v) noexcept {
+        if (count_ >= 2) {
+            *out_++ = first_;
+            *out_++ = last_;
+            *out_++ = v;
+        } else if (count_ == 0) {
+            first_ = v;
+        }
+        last_ = v;
+        ++count_;
+    }
+
+    void restart() noexcept { count_ = 0; }
+
+private:
+    std::uint32_t* out_;
+    std::uint32_t first_ = 0;
+    std::uint32_t last_ = 0;
+    std::size_t count_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// STL
+
+constexpr std::size_t stl_header = 84;
+constexpr std::size_t stl_record = 50;
+
+/// Vertices of a soup are merged in this many groups, by a hash of their
+/// position, each group sorted on its own.
+constexpr std::size_t merge_buckets = 1024;
+
+/// The bits of a position, with -0 taken for 0, so that equal positions
+/// have equal keys.
+using PositionKey = std::array<std::uint64_t, 3>;
+
+PositionKey position_key(const double* p) noexcept {
+    PositionKey key;
+    for (int k = 0; k < 3; ++k) {
+        key[k] = p[k] == 0 ? 0 : std::bit_cast<std::uint64_t>(p[k]);
+    }
+    return key;
+}
+
+/// A triangle soup, three vertices per triangle, with the vertices at equal
+/// positions merged into the first of them and the triangles that collapse
+/// dropped. weld() with no tolerance does the same, but its grid suits
+/// small tolerances rather than none: here vertices are grouped by a hash
+/// of their position and each group sorted in parallel.
+Mesh merge_soup(const Buffer& soup, ThreadPool* pool) {
+    const std::span<const double> p = soup.view<double>();
+    const std::size_t vertices = p.size() / 3;
+
+    std::vector<std::uint32_t> bucket(vertices);
+    parallel_for(pool, vertices, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            const PositionKey key = position_key(p.data() + 3 * v);
+            std::uint64_t h = key[0] * 0x9e3779b97f4a7c15ull;
+            h = (h ^ (h >> 29) ^ key[1]) * 0xbf58476d1ce4e5b9ull;
+            h = (h ^ (h >> 32) ^ key[2]) * 0x94d049bb133111ebull;
+            bucket[v] = static_cast<std::uint32_t>((h ^ (h >> 31)) % merge_buckets);
+        }
+    });
+    std::vector<std::size_t> first(merge_buckets + 1);
+    for (const std::uint32_t b : bucket) {
+        ++first[b];
+    }
+    prefix_sums(first);
+    std::vector<std::uint32_t> order(vertices);
+    {
+        std::vector<std::size_t> next(first.begin(), first.end() - 1);
+        for (std::size_t v = 0; v < vertices; ++v) {
+            order[next[bucket[v]]++] = static_cast<std::uint32_t>(v);
+        }
+    }
+
+    // Within a bucket equal positions sort together, lowest vertex first.
+    std::vector<std::uint32_t> merged(vertices);
+    parallel_for(pool, merge_buckets, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            const auto from = order.begin() + static_cast<std::ptrdiff_t>(first[b]);
+            const auto to = order.begin() + static_cast<std::ptrdiff_t>(first[b + 1]);
+            std::sort(from, to, [&](std::uint32_t x, std::uint32_t y) {
+                const PositionKey kx = position_key(p.data() + 3 * x);
+                const PositionKey ky = position_key(p.data() + 3 * y);
+                return kx != ky ? kx < ky : x < y;
+            });
+            for (auto it = from; it != to;) {
+                const PositionKey key = position_key(p.data() + 3 * *it);
+                const std::uint32_t kept = *it;
+                for (; it != to && position_key(p.data() + 3 * *it) == key; ++it) {
+                    merged[*it] = kept;
+                }
+            }
+        }
+    });
+
+    std::vector<std::uint32_t> index(vertices);
+    std::size_t kept = 0;
+    for (std::size_t v = 0; v < vertices; ++v) {
+        if (merged[v] == v) {
+            index[v] = static_cast<std::uint32_t>(kept++);
+        }
+    }
+    Buffer positions = allocate_positions(kept);
+    const std::span<double> out = positions.mutate<double>();
+    parallel_for(pool, vertices, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t v = begin; v < end; ++v) {
+            if (merged[v] == v) {
+                std::copy_n(p.begin() + 3 * v, 3, out.begin() + 3 * index[v]);
+            }
+        }
+    });
+    std::vector<std::uint32_t> corners;
+    corners.reserve(vertices);
+    for (std::size_t v = 0; v < vertices; v += 3) {
+        const std::uint32_t a = index[merged[v]];
+        const std::uint32_t b = index[merged[v + 1]];
+        const std::uint32_t c = index[merged[v + 2]];
+        if (a != b && b != c && c != a) {
+            corners.insert(corners.end(), {a, b, c});
+        }
+    }
+    return Mesh::from_triangles(positions, Buffer::adopt(std::move(corners), 3), pool);
+}
+
+Mesh read_binary_stl(const std::string& path, std::span<const std::byte> bytes,
+                     ThreadPool* pool) {
+    std::uint32_t triangles = 0;
+    std::memcpy(&triangles, bytes.data() + 80, sizeof triangles);
+    if (std::uint64_t{triangles} * 3 > Mesh::invalid) {
+        malformed(path, "too many triangles");
+    }
+    // Records are 50 bytes: a normal, three vertices, all f32, and two bytes
+    // of attributes. Each vertex is read straight from where it lies.
+    Buffer positions = allocate_positions(std::size_t{triangles} * 3);
+    const std::span<double> p = positions.mutate<double>();
+    parallel_for(pool, triangles, grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t t = begin; t < end; ++t) {
+            std::array<float, 9> v;
+            std::memcpy(v.data(), bytes.data() + stl_header + t * stl_record + 12, sizeof v);
+            std::copy(v.begin(), v.end(), p.begin() + 9 * t);
+        }
+    });
+    return merge_soup(positions, pool);
+}
+
+Mesh read_ascii_stl(const std::string& path, std::string_view text, ThreadPool* pool) {
+    const std::vector<std::size_t> bounds = line_blocks(text);
+    const std::size_t blocks = bounds.size() - 1;
+    const auto lines = [&](std::size_t b, auto&& fn) {
+        for_each_line(text.data() + bounds[b], text.data() + bounds[b + 1], fn);
+    };
+    std::vector<std::size_t> first(blocks);
+    parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            lines(b, [&](const char* line, const char* stop) {
+                first[b] += Fields(line, stop).next() == "vertex" ? 1 : 0;
+            });
+        }
+    });
+    const std::size_t vertices = prefix_sums(first);
+    if (vertices % 3 != 0 || vertices > Mesh::invalid) {
+        malformed(path, "facets must have three vertices each");
+    }
+
+    Buffer positions = allocate_positions(vertices);
+    const std::span<double> p = positions.mutate<double>();
+    parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            double* out = p.data() + 3 * first[b];
+            lines(b, [&](const char* line, const char* stop) {
+                Fields fields(line, stop);
+                if (fields.next() != "vertex") {
+                    return;
+                }
+                if (!fields.number(out[0]) || !fields.number(out[1]) || !fields.number(out[2])) {
+                    malformed(path, text, line, "bad vertex");
+                }
+                out += 3;
+            });
+        }
+    });
+    return merge_soup(positions, pool);
+}
+
+Mesh read_stl(const std::string& path, std::string_view text, ThreadPool* pool) {
+    // Binary files may start with "solid" too, so the size decides.
+    if (text.size() >= stl_header) {
+        std::uint32_t triangles = 0;
+        std::memcpy(&triangles, text.data() + 80, sizeof triangles);
+        if (text.size() == stl_header + std::uint64_t{triangles} * stl_record) {
+            return read_binary_stl(path, std::as_bytes(std::span(text)), pool);
+        }
+    }
+    Fields fields(text.data(), text.data() + std::min<std::size_t>(text.size(), 64));
+    if (fields.next() != "solid") {
+        malformed(path, "neither binary nor ASCII STL");
+    }
+    return read_ascii_stl(path, text, pool);
+}
+
+// ---------------------------------------------------------------------------
+// OBJ
+
+struct ObjCounts {
+    std::size_t vertices = 0;
+    std::size_t triangles = 0;
+};
+
+/// The vertex a face field refers to: the index before any '/', 1-based or
+/// negative relative to the `defined` vertices so far.
+bool obj_vertex(std::string_view field, std::size_t defined, std::size_t vertices,
+                std::uint32_t& out) {
+    const char* stop = field.data() + field.size();
+    std::int64_t index = 0;
+    const auto [end, error] = std::from_chars(field.data(), stop, index);
+    if (error != std::errc{} || (end != stop && *end != '/') || index == 0) {
+        return false;
+    }
+    const std::int64_t v = index > 0 ? index - 1 : static_cast<std::int64_t>(defined) + index;
+    if (v < 0 || static_cast<std::size_t>(v) >= vertices) {
+        return false;
+    }
+    out = static_cast<std::uint32_t>(v);
+    return true;
+}
+
+Mesh read_obj(const std::string& path, std::string_view text, ThreadPool* pool) {
+    const std::vector<std::size_t> bounds = line_blocks(text);
+    const std::size_t blocks = bounds.size() - 1;
+    const auto lines = [&](std::size_t b, auto&& fn) {
+        for_each_line(text.data() + bounds[b], text.data() + bounds[b + 1], fn);
+    };
+
+    // Pass one counts the vertices and triangles of each block, so that
+    // pass two can decode every block into place.
+    std::vector<std::size_t> first_vertex(blocks);
+    std::vector<std::size_t> first_triangle(blocks);
+    parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            ObjCounts counts;
+            lines(b, [&](const char* line, const char* stop) {
+                Fields fields(line, stop);
+                const std::string_view keyword = fields.next();
+                if (keyword == "v") {
+                    ++counts.vertices;
+                } else if (keyword == "f") {
+                    std::size_t corners = 0;
+                    while (!fields.done()) {
+                        fields.next();
+                        ++corners;
+                    }
+                    if (corners < 3) {
+                        malformed(path, text, line, "faces need three vertices");
+                    }
+                    counts.triangles += corners - 2;
+                }
+            });
+            first_vertex[b] = counts.vertices;
+            first_triangle[b] = counts.triangles;
+        }
+    });
+    const std::size_t vertices = prefix_sums(first_vertex);
+    const std::size_t triangles = prefix_sums(first_triangle);
+    if (vertices > Mesh::invalid || triangles * 3 > Mesh::invalid) {
+        malformed(path, "too many elements");
+    }
+
+    Buffer positions = allocate_positions(vertices);
+    Buffer corners = allocate_triangles(triangles);
+    const std::span<double> p = positions.mutate<double>();
+    const std::span<std::uint32_t> c = corners.mutate<std::uint32_t>();
+    parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            std::size_t defined = first_vertex[b];
+            Fan fan(c.data() + 3 * first_triangle[b]);
+            lines(b, [&](const char* line, const char* stop) {
+                Fields fields(line, stop);
+                const std::string_view keyword = fields.next();
+                if (keyword == "v") {
+                    double* out = p.data() + 3 * defined++;
+                    if (!fields.number(out[0]) || !fields.number(out[1]) ||
+                        !fields.number(out[2])) {
+                        malformed(path, text, line, "bad vertex");
+                    }
+                } else if (keyword == "f") {
+                    fan.restart();
+                    while (!fields.done()) {
+                        std::uint32_t v = 0;
+                        if (!obj_vertex(fields.next(), defined, vertices, v)) {
+                            malformed(path, text, line, "bad vertex reference");
+                        }
+                        fan.add(v);
+                    }
+                }
+            });
+        }
+    });
+    return Mesh::from_triangles(positions, corners, pool);
+}
+
+// ---------------------------------------------------------------------------
+// PLY
+
+enum class PlyType : std::uint8_t { I8, U8, I16, U16, I32, U32, F32, F64 };
+
+bool ply_type(std::string_view name, PlyType& out) noexcept {
+    static constexpr std::pair<std::string_view, PlyType> names[] = {
+        {"char", PlyType::I8},    {"int8", PlyType::I8},     {"uchar", PlyType::U8},
+        {"uint8", PlyType::U8},   {"short", PlyType::I16},   {"int16", PlyType::I16},
+        {"ushort", PlyType::U16}, {"uint16", PlyType::U16},  {"int", PlyType::I32},
+        {"int32", PlyType::I32},  {"uint", PlyType::U32},    {"uint32", PlyType::U32},
+        {"float", PlyType::F32},  {"float32", PlyType::F32}, {"double", PlyType::F64},
+        {"float64", PlyType::F64}};
+    for (const auto& [n, type] : names) {
+        if (n == name) {
+            out = type;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::size_t size_of(PlyType type) noexcept {
+    static constexpr std::size_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+    return sizes[static_cast<int>(type)];
+}
+
+template <typename T>
+T load(const std::byte* p, bool swap) noexcept {
+    std::array<std::byte, sizeof(T)> bytes;
+    std::memcpy(bytes.data(), p, sizeof(T));
+    if (swap) {
+        std::reverse(bytes.begin(), bytes.end());
+    }
+    return std::bit_cast<T>(bytes);
+}
+
+double load(PlyType type, const std::byte* p, bool swap) noexcept {
+    switch (type) {
+    case PlyType::I8: return load<std::int8_t>(p, swap);
+    case PlyType::U8: return load<std::uint8_t>(p, swap);
+    case PlyType::I16: return load<std::int16_t>(p, swap);
+    case PlyType::U16: return load<std::uint16_t>(p, swap);
+    case PlyType::I32: return load<std::int32_t>(p, swap);
+    case PlyType::U32: return load<std::uint32_t>(p, swap);
+    case PlyType::F32: return load<float>(p, swap);
+    case PlyType::F64: return load<double>(p, swap);
+    }
+    return 0;
+}
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::F32;
+    /// For lists, the type of the count before the items.
+    bool list = false;
+    PlyType count_type = PlyType::U8;
+};
+
+struct PlyElement {
+    std::string name;
+    std::size_t count = 0;
+    std::vector<PlyProperty> properties;
+
+    /// Bytes per binary record, 0 if lists make it vary.
+    std::size_t fixed_size() const noexcept {
+        std::size_t size = 0;
+        for (const PlyProperty& p : properties) {
+            if (p.list) {
+                return 0;
+            }
+            size += size_of(p.type);
+        }
+        return size;
+    }
+
+    /// The property called `name`, or -1.
+    int find(std::string_view name) const noexcept {
+        for (std::size_t i = 0; i < properties.size(); ++i) {
+            if (properties[i].name == name) {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+};
+
+enum class PlyEncoding : std::uint8_t { Ascii, LittleEndian, BigEndian };
+
+struct PlyHeader {
+    PlyEncoding encoding = PlyEncoding::Ascii;
+    std::vector<PlyElement> elements;
+    /// Where the records start.
+    std::size_t body = 0;
+};
+
+PlyHeader read_ply_header(const std::string& path, std::string_view text) {
+    PlyHeader header;
+    bool format = false;
+    std::size_t number = 0;
+    const char* p = text.data();
+    const char* const end = text.data() + text.size();
+    while (true) {
+        if (p == end) {
+            malformed(path, "no end_header");
+        }
+        const auto* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        const char* line = p;
+        const char* stop = newline == nullptr ? end : newline;
+        p = newline == nullptr ? end : newline + 1;
+        Fields fields(line, stop > line && stop[-1] == '\r' ? stop - 1 : stop);
+        const std::string_view keyword = fields.next();
+        if (number++ == 0) {
+            if (keyword != "ply") {
+                malformed(path, "not a PLY file");
+            }
+        } else if (keyword == "format") {
+            const std::string_view encoding = fields.next();
+            if (encoding == "ascii") {
+                header.encoding = PlyEncoding::Ascii;
+            } else if (encoding == "binary_little_endian") {
+                header.encoding = PlyEncoding::LittleEndian;
+            } else if (encoding == "binary_big_endian") {
+                header.encoding = PlyEncoding::BigEndian;
+            } else {
+                malformed(path, text, line, "unknown format");
+            }
+            format = true;
+        } else if (keyword == "element") {
+            PlyElement element;
+            element.name = fields.next();
+            if (element.name.empty() || !fields.number(element.count)) {
+                malformed(path, text, line, "bad element");
+            }
+            header.elements.push_back(std::move(element));
+        } else if (keyword == "property") {
+            PlyProperty property;
+            std::string_view type = fields.next();
+            if (type == "list") {
+                property.list = true;
+                if (!ply_type(fields.next(), property.count_type)) {
+                    malformed(path, text, line, "bad list count type");
+                }
+                type = fields.next();
+            }
+            property.name = fields.next();
+            if (!ply_type(type, property.type) || property.name.empty() ||
+                header.elements.empty()) {
+                malformed(path, text, line, "bad property");
+            }
+            header.elements.back().properties.push_back(std::move(property));
+        } else if (keyword == "end_header") {
+            break;
+        } else if (keyword != "comment" && keyword != "obj_info" && !keyword.empty()) {
+            malformed(path, text, line, "unknown header line");
+        }
+    }
+    if (!format) {
+        malformed(path, "no format line");
+    }
+    header.body = static_cast<std::size_t>(p - text.data());
+    return header;
+}
+
+/// The vertex and face elements and the properties read from them.
+struct PlyLayout {
+    int vertex = -1;
+    int face = -1;
+    std::array<int, 3> xyz{-1, -1, -1};
+    int indices = -1;
+};
+
+PlyLayout ply_layout(const std::string& path, const PlyHeader& header) {
+    PlyLayout layout;
+    for (std::size_t e = 0; e < header.elements.size(); ++e) {
+        const PlyElement& element = header.elements[e];
+        if (element.name == "vertex") {
+            layout.vertex = static_cast<int>(e);
+            static constexpr std::string_view axes[] = {"x", "y", "z"};
+            for (int k = 0; k < 3; ++k) {
+                layout.xyz[k] = element.find(axes[k]);
+                if (layout.xyz[k] < 0 || element.properties[layout.xyz[k]].list) {
+                    malformed(path, "vertices need x, y and z");
+                }
+            }
+        } else if (element.name == "face") {
+            layout.face = static_cast<int>(e);
+            layout.indices = element.find("vertex_indices");
+            if (layout.indices < 0) {
+                layout.indices = element.find("vertex_index");
+            }
+            if (layout.indices < 0 || !element.properties[layout.indices].list) {
+                malformed(path, "faces need a vertex_indices list");
+            }
+        }
+    }
+    if (layout.vertex < 0) {
+        malformed(path, "no vertex element");
+    }
+    if (header.elements[layout.vertex].count > Mesh::invalid) {
+        malformed(path, "too many vertices");
+    }
+    return layout;
+}
+
+/// The size of `property` in the binary record data at `p`.
+std::size_t ply_property_size(const PlyProperty& property, const std::byte* p, bool swap) {
+    if (!property.list) {
+        return size_of(property.type);
+    }
+    const auto count = static_cast<std::size_t>(load(property.count_type, p, swap));
+    return size_of(property.count_type) + count * size_of(property.type);
+}
+
+/// The size of the binary record at `p`, or 0 if it runs past `end`.
+std::size_t ply_record_size(const PlyElement& element, const std::byte* p, const std::byte* end,
+                            bool swap) noexcept {
+    std::size_t size = 0;
+    for (const PlyProperty& property : element.properties) {
+        if (property.list) {
+            const std::size_t count_size = size_of(property.count_type);
+            if (end - p < static_cast<std::ptrdiff_t>(size + count_size)) {
+                return 0;
+            }
+            const double count = load(property.count_type, p + size, swap);
+            if (!(count >= 0)) {
+                return 0;
+            }
+            size += count_size + static_cast<std::size_t>(count) * size_of(property.type);
+        } else {
+            size += size_of(property.type);
+        }
+        if (end - p < static_cast<std::ptrdiff_t>(size)) {
+            return 0;
+        }
+    }
+    return size;
+}
+
+Mesh read_binary_ply(const std::string& path, std::span<const std::byte> bytes,
+                     const PlyHeader& header, ThreadPool* pool) {
+    const bool swap = (header.encoding == PlyEncoding::BigEndian) !=
+                      (std::endian::native == std::endian::big);
+    const PlyLayout layout = ply_layout(path, header);
+    const std::size_t vertices = header.elements[layout.vertex].count;
+    const std::byte* const end = bytes.data() + bytes.size();
+    const std::byte* at = bytes.data() + header.body;
+    const auto truncated = [&] { malformed(path, "truncated"); };
+
+    Buffer positions = allocate_positions(vertices);
+    Buffer corners = allocate_triangles(0);
+    for (std::size_t e = 0; e < header.elements.size(); ++e) {
+        const PlyElement& element = header.elements[e];
+        const std::size_t fixed = element.fixed_size();
+        const auto remaining = static_cast<std::size_t>(end - at);
+        if (static_cast<int>(e) == layout.vertex) {
+            if (fixed == 0) {
+                malformed(path, "lists in vertices are not supported");
+            }
+            if (remaining / fixed < element.count) {
+                truncated();
+            }
+            // Fixed-size records: each vertex is decoded where it lies.
+            std::array<std::size_t, 3> offsets{};
+            std::array<PlyType, 3> types{};
+            for (int k = 0; k < 3; ++k) {
+                for (int i = 0; i < layout.xyz[k]; ++i) {
+                    offsets[k] += size_of(element.properties[i].type);
+                }
+                types[k] = element.properties[layout.xyz[k]].type;
+            }
+            const std::span<double> p = positions.mutate<double>();
+            parallel_for(pool, element.count, grain, [&](std::size_t begin, std::size_t stop) {
+                for (std::size_t v = begin; v < stop; ++v) {
+                    const std::byte* record = at + v * fixed;
+                    for (int k = 0; k < 3; ++k) {
+                        p[3 * v + k] = load(types[k], record + offsets[k], swap);
+                    }
+                }
+            });
+            at += element.count * fixed;
+        } else if (static_cast<int>(e) == layout.face) {
+            const PlyProperty& list = element.properties[layout.indices];
+            std::size_t before = 0;
+            std::size_t after = 0;
+            bool other_lists = false;
+            for (std::size_t i = 0; i < element.properties.size(); ++i) {
+                const PlyProperty& property = element.properties[i];
+                other_lists |= property.list && static_cast<int>(i) != layout.indices;
+                (static_cast<int>(i) < layout.indices ? before : after) +=
+                    property.list ? 0 : size_of(property.type);
+            }
+            const std::size_t count_size = size_of(list.count_type);
+            const std::size_t index_size = size_of(list.type);
+
+            // The start of each record and, in `first`, of its triangles. If
+            // the faces are all triangles the records have a fixed stride and
+            // neither needs storing; otherwise one sequential walk finds them.
+            const std::size_t triangle_stride = before + count_size + 3 * index_size + after;
+            bool triangles_only = !other_lists && remaining / triangle_stride >= element.count;
+            if (triangles_only) {
+                std::atomic<bool> found{false};
+                parallel_for(pool, element.count, grain, [&](std::size_t begin, std::size_t stop) {
+                    for (std::size_t f = begin; f < stop && !found.load(std::memory_order_relaxed);
+                         ++f) {
+                        if (load(list.count_type, at + f * triangle_stride + before, swap) != 3) {
+                            found.store(true, std::memory_order_relaxed);
+                        }
+                    }
+                });
+                triangles_only = !found.load();
+            }
+            std::vector<std::size_t> starts;
+            std::vector<std::size_t> first;
+            std::size_t triangles = element.count;
+            if (!triangles_only) {
+                starts.resize(element.count + 1);
+                first.resize(element.count);
+                std::size_t offset = 0;
+                for (std::size_t f = 0; f < element.count; ++f) {
+                    const std::size_t size = ply_record_size(element, at + offset, end, swap);
+                    if (size == 0) {
+                        truncated();
+                    }
+                    starts[f] = offset;
+                    std::size_t before_list = 0;
+                    for (int i = 0; i < layout.indices; ++i) {
+                        before_list += ply_property_size(element.properties[i],
+                                                         at + offset + before_list, swap);
+                    }
+                    const auto n = static_cast<std::size_t>(
+                        load(list.count_type, at + offset + before_list, swap));
+                    first[f] = n >= 3 ? n - 2 : 0;
+                    offset += size;
+                }
+                starts[element.count] = offset;
+                triangles = prefix_sums(first);
+            }
+            if (triangles * 3 > Mesh::invalid) {
+                malformed(path, "too many triangles");
+            }
+
+            corners = allocate_triangles(triangles);
+            const std::span<std::uint32_t> c = corners.mutate<std::uint32_t>();
+            std::atomic<bool> out_of_range{false};
+            parallel_for(pool, element.count, grain, [&](std::size_t begin, std::size_t stop) {
+                for (std::size_t f = begin; f < stop; ++f) {
+                    const std::byte* record = at;
+                    std::uint32_t* out = c.data();
+                    if (triangles_only) {
+                        record += f * triangle_stride;
+                        out += 3 * f;
+                    } else {
+                        record += starts[f];
+                        out += 3 * first[f];
+                        for (int i = 0; i < layout.indices; ++i) {
+                            record += ply_property_size(element.properties[i], record, swap);
+                        }
+                    }
+                    const auto n = static_cast<std::size_t>(load(list.count_type, record, swap));
+                    record += count_size;
+                    Fan fan(out);
+                    for (std::size_t i = 0; i < n; ++i) {
+                        const double v = load(list.type, record + i * index_size, swap);
+                        if (!(v >= 0 && v < static_cast<double>(vertices))) {
+                            out_of_range.store(true, std::memory_order_relaxed);
+                            return;
+                        }
+                        fan.add(static_cast<std::uint32_t>(v));
+                    }
+                }
+            });
+            if (out_of_range.load()) {
+                malformed(path, "vertex index out of range");
+            }
+            at += triangles_only ? element.count * triangle_stride : starts[element.count];
+        } else if (fixed != 0) {
+            if (remaining / fixed < element.count) {
+                truncated();
+            }
+            at += element.count * fixed;
+        } else {
+            for (std::size_t i = 0; i < element.count; ++i) {
+                const std::size_t size = ply_record_size(element, at, end, swap);
+                if (size == 0) {
+                    truncated();
+                }
+                at += size;
+            }
+        }
+    }
+    return Mesh::from_triangles(positions, corners, pool);
+}
+
+/// Reads the fields of one ASCII PLY record, calling `scalar(i, value)` for
+/// each scalar property and `item(i, value)` for each item of a list.
+/// Returns false if the line is short or has something other than numbers.
+template <typename Scalar, typename Item>
+bool ply_ascii_record(const PlyElement& element, Fields& fields, Scalar&& scalar, Item&& item) {
+    for (std::size_t i = 0; i < element.properties.size(); ++i) {
+        double value = 0;
+        if (!fields.number(value)) {
+            return false;
+        }
+        if (!element.properties[i].list) {
+            scalar(i, value);
+            continue;
+        }
+        if (!(value >= 0)) {
+            return false;
+        }
+        for (auto n = static_cast<std::size_t>(value); n > 0; --n) {
+            double v = 0;
+            if (!fields.number(v)) {
+                return false;
+            }
+            item(i, v);
+        }
+    }
+    return true;
+}
+
+Mesh read_ascii_ply(const std::string& path, std::string_view text, const PlyHeader& header,
+                    ThreadPool* pool) {
+    const PlyLayout layout = ply_layout(path, header);
+    const std::size_t vertices = header.elements[layout.vertex].count;
+    const std::string_view body = text.substr(header.body);
+    const std::vector<std::size_t> bounds = line_blocks(body);
+    const std::size_t blocks = bounds.size() - 1;
+    const auto lines = [&](std::size_t b, auto&& fn) {
+        for_each_line(body.data() + bounds[b], body.data() + bounds[b + 1], fn);
+    };
+
+    // Each element takes the lines after the previous one's. The lines of
+    // every block are counted first, to place the blocks among them.
+    std::vector<std::size_t> first_line(blocks);
+    parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            lines(b, [&](const char*, const char*) { ++first_line[b]; });
+        }
+    });
+    const std::size_t total_lines = prefix_sums(first_line);
+    std::vector<std::size_t> element_line{0};
+    for (const PlyElement& element : header.elements) {
+        element_line.push_back(element_line.back() + element.count);
+    }
+    if (total_lines < element_line.back()) {
+        malformed(path, "truncated");
+    }
+    const auto in = [&](int e, std::size_t line) {
+        return e >= 0 && line >= element_line[e] && line < element_line[e + 1];
+    };
+    const auto record = [&](int e, const char* line, const char* stop, auto&& scalar,
+                            auto&& item) {
+        Fields fields(line, stop);
+        if (!ply_ascii_record(header.elements[e], fields, scalar, item)) {
+            malformed(path, text, line, "bad " + header.elements[e].name);
+        }
+    };
+    const auto ignore = [](std::size_t, double) {};
+
+    // Then the triangles of each block, and then everything is decoded into
+    // place.
+    std::vector<std::size_t> first_triangle(blocks);
+    parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            std::size_t line_number = first_line[b];
+            lines(b, [&](const char* line, const char* stop) {
+                if (in(layout.face, line_number++)) {
+                    std::size_t n = 0;
+                    record(layout.face, line, stop, ignore, [&](std::size_t i, double) {
+                        n += static_cast<int>(i) == layout.indices ? 1 : 0;
+                    });
+                    first_triangle[b] += n >= 3 ? n - 2 : 0;
+                }
+            });
+        }
+    });
+    const std::size_t triangles = prefix_sums(first_triangle);
+    if (triangles * 3 > Mesh::invalid) {
+        malformed(path, "too many triangles");
+    }
+
+    Buffer positions = allocate_positions(vertices);
+    Buffer corners = allocate_triangles(triangles);
+    const std::span<double> p = positions.mutate<double>();
+    const std::span<std::uint32_t> c = corners.mutate<std::uint32_t>();
+    parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t b = begin; b < end; ++b) {
+            std::size_t line_number = first_line[b];
+            Fan fan(c.data() + 3 * first_triangle[b]);
+            lines(b, [&](const char* line, const char* stop) {
+                const std::size_t number = line_number++;
+                if (in(layout.vertex, number)) {
+                    double* out = p.data() + 3 * (number - element_line[layout.vertex]);
+                    record(
+                        layout.vertex, line, stop,
+                        [&](std::size_t i, double value) {
+                            for (int k = 0; k < 3; ++k) {
+                                if (static_cast<int>(i) == layout.xyz[k]) {
+                                    out[k] = value;
+                                }
+                            }
+                        },
+                        ignore);
+                } else if (in(layout.face, number)) {
+                    fan.restart();
+                    record(layout.face, line, stop, ignore, [&](std::size_t i, double v) {
+                        if (static_cast<int>(i) != layout.indices) {
+                            return;
+                        }
+                        if (!(v >= 0 && v < static_cast<double>(vertices))) {
+                            malformed(path, text, line, "vertex index out of range");
+                        }
+                        fan.add(static_cast<std::uint32_t>(v));
+                    });
+                }
+            });
+        }
+    });
+    return Mesh::from_triangles(positions, corners, pool);
+}
+
+Mesh read_ply(const std::string& path, std::string_view text, ThreadPool* pool) {
+    const PlyHeader header = read_ply_header(path, text);
+    if (header.encoding == PlyEncoding::Ascii) {
+        return read_ascii_ply(path, text, header, pool);
+    }
+    return read_binary_ply(path, std::as_bytes(std::span(text)), header, pool);
+}
+
+// ---------------------------------------------------------------------------
+// Writing
+
+/// Data handed to writev: formatted blocks, and spans of the mesh itself.
+class Output {
+public:
+    /// Adds `records` records, formatted in parallel by `fn(first, last,
+    /// block)` a block at a time.
+    template <typename Fn>
+    void format(std::size_t records, ThreadPool* pool, Fn&& fn) {
+        const std::size_t blocks = (records + grain - 1) / grain;
+        const std::size_t base = blocks_.size();
+        blocks_.resize(base + blocks);
+        parallel_for(pool, blocks, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t b = begin; b < end; ++b) {
+                fn(b * grain, std::min(records, (b + 1) * grain), blocks_[base + b]);
+            }
+        });
+        for (std::size_t b = 0; b < blocks; ++b) {
+            parts_.push_back({base + b, {}});
+        }
+    }
+
+    void text(std::string s) {
+        blocks_.push_back(std::move(s));
+        parts_.push_back({blocks_.size() - 1, {}});
+    }
+
+    /// Adds bytes that stay alive until write().
+    void span(std::span<const std::byte> bytes) { parts_.push_back({none, bytes}); }
+
+    /// Writes everything to a temporary file, renamed to `path` once
+    /// complete. Returns the size.
+    std::uint64_t write(const std::string& path) const;
+
+private:
+    static constexpr std::size_t none = ~std::size_t{0};
+
+    struct Part {
+        std::size_t block;
+        std::span<const std::byte> bytes;
+    };
+
+    std::vector<std::string> blocks_;
+    std::vector<Part> parts_;
+};
+
+std::uint64_t Output::write(const std::string& path) const {
+    std::vector<iovec> io;
+    std::uint64_t size = 0;
+    for (const Part& part : parts_) {
+        std::span<const std::byte> bytes = part.bytes;
+        if (part.block != none) {
+            bytes = std::as_bytes(std::span(blocks_[part.block]));
+        }
+        if (!bytes.empty()) {
+            io.push_back({const_cast<std::byte*>(bytes.data()), bytes.size()});
+            size += bytes.size();
+        }
+    }
+
+    // A fresh name next to `path`, so that concurrent writers never share a
+    // temporary and the rename stays within one file system.
+    std::string temp = path + ".XXXXXX";
+    const int fd = ::mkostemp(temp.data(), O_CLOEXEC);
+    if (fd < 0) {
+        throw IoError("cannot create a temporary file for '" + path + "': " +
+                      std::strerror(errno));
+    }
+    const auto fail = [&](const char* what) {
+        const int error = errno;
+        ::close(fd);
+        std::remove(temp.c_str());
+        throw IoError(what + (" '" + path + "': ") + std::strerror(error));
+    };
+    // writev takes at most IOV_MAX parts and may stop short of the end.
+    for (std::size_t i = 0; i < io.size();) {
+        const int n = static_cast<int>(std::min<std::size_t>(io.size() - i, IOV_MAX));
+        const ssize_t written = ::writev(fd, io.data() + i, n);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fail("cannot write");
+        }
+        auto left = static_cast<std::size_t>(written);
+        while (i < io.size() && left >= io[i].iov_len) {
+            left -= io[i].iov_len;
+            ++i;
+        }
+        if (left > 0) {
+            io[i].iov_base = static_cast<std::byte*>(io[i].iov_base) + left;
+            io[i].iov_len -= left;
+        }
+    }
+    // mkostemp creates the file private to its owner.
+    if (::fchmod(fd, 0644) != 0) {
+        fail("cannot set the mode of");
+    }
+    if (::fsync(fd) != 0) {
+        fail("cannot sync");
+    }
+    if (::close(fd) != 0) {
+        std::remove(temp.c_str());
+        throw IoError("cannot write '" + path + "': " + std::strerror(errno));
+    }
+    if (std::rename(temp.c_str(), path.c_str()) != 0) {
+        const int error = errno;
+        std::remove(temp.c_str());
+        throw IoError("cannot replace '" + path + "': " + std::strerror(error));
+    }
+    return size;
+}
+
+void append(std::string& out, double value) {
+    char text[32];
+    const auto result = std::to_chars(text, text + sizeof text, value);
+    out.append(text, result.ptr);
+}
+
+void append(std::string& out, std::uint64_t value) {
+    char text[24];
+    const auto result = std::to_chars(text, text + sizeof text, value);
+    out.append(text, result.ptr);
+}
+
+template <typename T>
+void append_binary(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof value);
+}
+
+/// The unit normal of triangle f, or zero if it is degenerate.
+std::array<double, 3> face_normal(const Mesh& mesh, std::size_t f) {
+    const std::span<const double> p = mesh.positions();
+    const std::uint32_t* c = mesh.corners().data() + 3 * f;
+    std::array<double, 3> u;
+    std::array<double, 3> v;
+    for (int k = 0; k < 3; ++k) {
+        u[k] = p[3 * c[1] + k] - p[3 * c[0] + k];
+        v[k] = p[3 * c[2] + k] - p[3 * c[0] + k];
+    }
+    std::array<double, 3> n{u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+                            u[0] * v[1] - u[1] * v[0]};
+    const double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+    for (double& x : n) {
+        x = length > 0 ? x / length : 0.0;
+    }
+    return n;
+}
+
+void write_stl(const Mesh& mesh, bool binary, ThreadPool* pool, Output& out) {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> c = mesh.corners();
+    if (binary) {
+        if (mesh.face_count() > std::numeric_limits<std::uint32_t>::max()) {
+            throw Error("too many triangles for binary STL");
+        }
+        // The header must not start with "solid", or readers take it for
+        // ASCII.
+        std::string header(80, '\0');
+        header.replace(0, 16, "rebelflow binary");
+        append_binary(header, static_cast<std::uint32_t>(mesh.face_count()));
+        out.text(std::move(header));
+        out.format(mesh.face_count(), pool, [&](std::size_t begin, std::size_t end,
+                                                std::string& block) {
+            block.reserve((end - begin) * stl_record);
+            for (std::size_t f = begin; f < end; ++f) {
+                std::array<float, 12> record;
+                const std::array<double, 3> n = face_normal(mesh, f);
+                for (int k = 0; k < 3; ++k) {
+                    record[k] = static_cast<float>(n[k]);
+                    for (int i = 0; i < 3; ++i) {
+                        record[3 + 3 * i + k] = static_cast<float>(p[3 * c[3 * f + i] + k]);
+                    }
+                }
+                append_binary(block, record);
+                append_binary(block, std::uint16_t{0});
+            }
+        });
+        return;
+    }
+    out.text("solid rebelflow\n");
+    out.format(mesh.face_count(), pool, [&](std::size_t begin, std::size_t end,
+                                            std::string& block) {
+        for (std::size_t f = begin; f < end; ++f) {
+            const std::array<double, 3> n = face_normal(mesh, f);
+            block += "facet normal ";
+            for (int k = 0; k < 3; ++k) {
+                append(block, n[k]);
+                block += k < 2 ? ' ' : '\n';
+            }
+            block += " outer loop\n";
+            for (int i = 0; i < 3; ++i) {
+                block += "  vertex ";
+                for (int k = 0; k < 3; ++k) {
+                    append(block, p[3 * c[3 * f + i] + k]);
+                    block += k < 2 ? ' ' : '\n';
+                }
+            }
+            block += " endloop\nendfacet\n";
+        }
+    });
+    out.text("endsolid rebelflow\n");
+}
+
+void write_obj(const Mesh& mesh, ThreadPool* pool, Output& out) {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> c = mesh.corners();
+    out.format(mesh.vertex_count(), pool, [&](std::size_t begin, std::size_t end,
+                                              std::string& block) {
+        for (std::size_t v = begin; v < end; ++v) {
+            block += 'v';
+            for (int k = 0; k < 3; ++k) {
+                block += ' ';
+                append(block, p[3 * v + k]);
+            }
+            block += '\n';
+        }
+    });
+    out.format(mesh.face_count(), pool, [&](std::size_t begin, std::size_t end,
+                                            std::string& block) {
+        for (std::size_t f = begin; f < end; ++f) {
+            block += 'f';
+            for (int k = 0; k < 3; ++k) {
+                block += ' ';
+                append(block, std::uint64_t{c[3 * f + k]} + 1);
+            }
+            block += '\n';
+        }
+    });
+}
+
+void write_ply(const Mesh& mesh, bool binary, ThreadPool* pool, Output& out) {
+    std::string header = "ply\nformat ";
+    header += binary ? "binary_little_endian" : "ascii";
+    header += " 1.0\nelement vertex ";
+    append(header, std::uint64_t{mesh.vertex_count()});
+    header += "\nproperty double x\nproperty double y\nproperty double z\nelement face ";
+    append(header, std::uint64_t{mesh.face_count()});
+    header += "\nproperty list uchar uint vertex_indices\nend_header\n";
+    out.text(std::move(header));
+
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> c = mesh.corners();
+    if (binary) {
+        // The vertex records are the positions as stored.
+        out.span(std::as_bytes(p));
+        out.format(mesh.face_count(), pool, [&](std::size_t begin, std::size_t end,
+                                                std::string& block) {
+            block.reserve((end - begin) * 13);
+            for (std::size_t f = begin; f < end; ++f) {
+                append_binary(block, std::uint8_t{3});
+                append_binary(block, std::array<std::uint32_t, 3>{c[3 * f], c[3 * f + 1],
+                                                                  c[3 * f + 2]});
+            }
+        });
+        return;
+    }
+    out.format(mesh.vertex_count(), pool, [&](std::size_t begin, std::size_t end,
+                                              std::string& block) {
+        for (std::size_t v = begin; v < end; ++v) {
+            for (int k = 0; k < 3; ++k) {
+                append(block, p[3 * v + k]);
+                block += k < 2 ? ' ' : '\n';
+            }
+        }
+    });
+    out.format(mesh.face_count(), pool, [&](std::size_t begin, std::size_t end,
+                                            std::string& block) {
+        for (std::size_t f = begin; f < end; ++f) {
+            block += '3';
+            for (int k = 0; k < 3; ++k) {
+                block += ' ';
+                append(block, std::uint64_t{c[3 * f + k]});
+            }
+            block += '\n';
+        }
+    });
+}
+
+} // namespace
+
+const char* to_string(MeshFormat format) noexcept {
+    switch (format) {
+    case MeshFormat::Stl: return "stl";
+    case MeshFormat::Obj: return "obj";
+    case MeshFormat::Ply: return "ply";
+    }
+    return "?";
+}
+
+MeshFormat mesh_format_of(const std::string& path) {
+    const std::size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    for (const MeshFormat format : {MeshFormat::Stl, MeshFormat::Obj, MeshFormat::Ply}) {
+        if (extension == to_string(format)) {
+            return format;
+        }
+    }
+    throw Error("unknown mesh file type '" + path + "': expected .stl, .obj or .ply");
+}
+
+Mesh read_mesh(const std::string& path, ThreadPool* pool) {
+    const MeshFormat format = mesh_format_of(path);
+    const MappedFile file = MappedFile::open(path);
+    const std::string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+    switch (format) {
+    case MeshFormat::Stl: return read_stl(path, text, pool);
+    case MeshFormat::Obj: return read_obj(path, text, pool);
+    case MeshFormat::Ply: return read_ply(path, text, pool);
+    }
+    return Mesh();
+}
+
+std::uint64_t write_mesh(const Mesh& mesh, const std::string& path, bool binary,
+                         ThreadPool* pool) {
+    Output out;
+    switch (mesh_format_of(path)) {
+    case MeshFormat::Stl: write_stl(mesh, binary, pool, out); break;
+    case MeshFormat::Obj: write_obj(mesh, pool, out); break;
+    case MeshFormat::Ply: write_ply(mesh, binary, pool, out); break;
+    }
+    return out.write(path);
+}
+
+// ---------------------------------------------------------------------------
+// Streaming points
+
+struct PointReader::State {
+    enum class Kind : std::uint8_t { BinaryStl, BinaryPly, Lines };
+
+    std::string path;
+    MappedFile file;
+    std::string_view text;
+    Kind kind = Kind::Lines;
+
+    // Binary formats: points read so far out of `total`, each at `first` +
+    // its index * `stride`, then the x, y and z `offsets`.
+    std::size_t next = 0;
+    std::size_t total = 0;
+    std::size_t first = 0;
+    std::size_t stride = 0;
+    std::array<std::size_t, 3> offsets{};
+    std::array<PlyType, 3> types{PlyType::F32, PlyType::F32, PlyType::F32};
+    bool swap = false;
+
+    // Text formats: where the next line starts, and the keyword of point
+    // lines ("vertex" for STL, "v" for OBJ). ASCII PLY has no keyword; its
+    // vertex lines are the `total` ones from `cursor` on, read by `element`.
+    std::size_t cursor = 0;
+    std::string_view keyword;
+    const PlyElement* element = nullptr;
+    PlyHeader header;
+    PlyLayout layout;
+};
+
+PointReader::PointReader(const std::string& path) : state_(std::make_unique<State>()) {
+    State& s = *state_;
+    const MeshFormat format = mesh_format_of(path);
+    s.path = path;
+    s.file = MappedFile::open(path);
+    s.file.advise_sequential();
+    s.text = {reinterpret_cast<const char*>(s.file.data()), s.file.size()};
+    const std::string_view text = s.text;
+
+    switch (format) {
+    case MeshFormat::Stl:
+        if (text.size() >= stl_header) {
+            std::uint32_t triangles = 0;
+            std::memcpy(&triangles, text.data() + 80, sizeof triangles);
+            if (text.size() == stl_header + std::uint64_t{triangles} * stl_record) {
+                // Three corners per 50-byte record, after its normal.
+                s.kind = State::Kind::BinaryStl;
+                s.total = std::size_t{triangles} * 3;
+                return;
+            }
+        }
+        if (Fields(text.data(), text.data() + std::min<std::size_t>(text.size(), 64)).next() !=
+            "solid") {
+            malformed(path, "neither binary nor ASCII STL");
+        }
+        s.keyword = "vertex";
+        return;
+    case MeshFormat::Obj:
+        s.keyword = "v";
+        return;
+    case MeshFormat::Ply: break;
+    }
+
+    s.header = read_ply_header(path, text);
+    s.layout = ply_layout(path, s.header);
+    const PlyElement& vertex = s.header.elements[s.layout.vertex];
+    s.total = vertex.count;
+    if (s.header.encoding == PlyEncoding::Ascii) {
+        // Skip the lines of the elements before the vertices.
+        s.cursor = s.header.body;
+        s.element = &vertex;
+        for (int e = 0; e < s.layout.vertex; ++e) {
+            for (std::size_t i = 0; i < s.header.elements[e].count; ++i) {
+                const std::size_t newline = text.find('\n', s.cursor);
+                if (newline == std::string_view::npos) {
+                    malformed(path, "truncated");
+                }
+                s.cursor = newline + 1;
+            }
+        }
+        return;
+    }
+
+    s.kind = State::Kind::BinaryPly;
+    s.swap = (s.header.encoding == PlyEncoding::BigEndian) !=
+             (std::endian::native == std::endian::big);
+    const std::byte* const begin = s.file.data();
+    const std::byte* const end = begin + s.file.size();
+    const std::byte* at = begin + s.header.body;
+    for (int e = 0; e < s.layout.vertex; ++e) {
+        const PlyElement& element = s.header.elements[e];
+        for (std::size_t i = 0; i < element.count; ++i) {
+            const std::size_t size = ply_record_size(element, at, end, s.swap);
+            if (size == 0) {
+                malformed(path, "truncated");
+            }
+            at += size;
+        }
+    }
+    s.stride = vertex.fixed_size();
+    if (s.stride == 0) {
+        malformed(path, "lists in vertices are not supported");
+    }
+    if (static_cast<std::size_t>(end - at) / s.stride < vertex.count) {
+        malformed(path, "truncated");
+    }
+    s.first = static_cast<std::size_t>(at - begin);
+    for (int k = 0; k < 3; ++k) {
+        for (int i = 0; i < s.layout.xyz[k]; ++i) {
+            s.offsets[k] += size_of(vertex.properties[i].type);
+        }
+        s.types[k] = vertex.properties[s.layout.xyz[k]].type;
+    }
+}
+
+PointReader::~PointReader() = default;
+PointReader::PointReader(PointReader&&) noexcept = default;
+PointReader& PointReader::operator=(PointReader&&) noexcept = default;
+
+bool PointReader::next(std::size_t max_points, Buffer& points) {
+    State& s = *state_;
+    max_points = std::max<std::size_t>(max_points, 1);
+
+    if (s.kind != State::Kind::Lines) {
+        const std::size_t n = std::min(max_points, s.total - s.next);
+        if (n == 0) {
+            return false;
+        }
+        Buffer chunk = allocate_positions(n);
+        const std::span<double> p = chunk.mutate<double>();
+        const std::byte* const bytes = s.file.data();
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::size_t point = s.next + i;
+            if (s.kind == State::Kind::BinaryStl) {
+                std::array<float, 3> v;
+                std::memcpy(v.data(),
+                            bytes + stl_header + point / 3 * stl_record + 12 + point % 3 * 12,
+                            sizeof v);
+                std::copy(v.begin(), v.end(), p.begin() + 3 * i);
+            } else {
+                const std::byte* record = bytes + s.first + point * s.stride;
+                for (int k = 0; k < 3; ++k) {
+                    p[3 * i + k] = load(s.types[k], record + s.offsets[k], s.swap);
+                }
+            }
+        }
+        s.next += n;
+        points = std::move(chunk);
+        return true;
+    }
+
+    const std::string_view text = s.text;
+    std::vector<double> p;
+    p.reserve(3 * std::min<std::size_t>(max_points, grain));
+    const auto ignore = [](std::size_t, double) {};
+    while (p.size() < 3 * max_points && s.cursor < text.size()) {
+        if (s.element != nullptr && s.next == s.total) {
+            break;
+        }
+        const char* line = text.data() + s.cursor;
+        const std::size_t newline = text.find('\n', s.cursor);
+        const std::size_t stop_at = newline == std::string_view::npos ? text.size() : newline;
+        s.cursor = newline == std::string_view::npos ? text.size() : newline + 1;
+        const char* stop = text.data() + stop_at;
+        if (stop > line && stop[-1] == '\r') {
+            --stop;
+        }
+        Fields fields(line, stop);
+        std::array<double, 3> xyz{};
+        if (s.element != nullptr) {
+            const auto scalar = [&](std::size_t i, double value) {
+                for (int k = 0; k < 3; ++k) {
+                    if (static_cast<int>(i) == s.layout.xyz[k]) {
+                        xyz[k] = value;
+                    }
+                }
+            };
+            if (!ply_ascii_record(*s.element, fields, scalar, ignore)) {
+                malformed(s.path, text, line, "bad vertex");
+            }
+            ++s.next;
+        } else if (fields.next() == s.keyword) {
+            if (!fields.number(xyz[0]) || !fields.number(xyz[1]) || !fields.number(xyz[2])) {
+                malformed(s.path, text, line, "bad vertex");
+            }
+        } else {
+            continue;
+        }
+        p.insert(p.end(), xyz.begin(), xyz.end());
+    }
+    if (s.element != nullptr && s.next < s.total && s.cursor >= text.size() && p.empty()) {
+        malformed(s.path, "truncated");
+    }
+    if (p.empty()) {
+        return false;
+    }
+    points = Buffer::adopt(std::move(p), 3);
+    return true;
+}
+
+} // namespace rebelflow
@@ -0,0 +1,277 @@
+#include "rebelflow/node.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+template <typename Spec>
+int index_of(const std::vector<Spec>& specs, std::string_view name) noexcept {
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        if (specs[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+template <typename Out, typename In>
+void convert(std::span<const In> in, std::span<Out> out) noexcept {
+    for (std::size_t i = 0; i < out.size(); ++i) {
+        out[i] = static_cast<Out>(in[i]);
+    }
+}
+
+/// Converts a numeric column to Out, in `arena` unless it already has that
+/// element type.
+template <typename Out>
+std::span<const Out> column_as(const Buffer& column, Arena& arena) {
+    if (column.element_type() == element_type_v<Out>) {
+        return column.view<Out>();
+    }
+    std::span<Out> out = arena.allocate_array<Out>(column.size());
+    switch (column.element_type()) {
+    case ElementType::U8: convert(column.view<std::uint8_t>(), out); break;
+    case ElementType::I32: convert(column.view<std::int32_t>(), out); break;
+    case ElementType::U32: convert(column.view<std::uint32_t>(), out); break;
+    case ElementType::I64: convert(column.view<std::int64_t>(), out); break;
+    case ElementType::F32: convert(column.view<float>(), out); break;
+    case ElementType::F64: convert(column.view<double>(), out); break;
+    }
+    return out;
+}
+
+template <typename T>
+std::span<const T> broadcast(T value, std::size_t rows, Arena& arena) {
+    std::span<T> out = arena.allocate_array<T>(rows);
+    std::fill(out.begin(), out.end(), value);
+    return out;
+}
+
+template <typename T>
+std::span<T> allocate_column(Value& slot, std::size_t rows) {
+    Buffer column = Buffer::allocate(element_type_v<T>, rows);
+    // The storage outlives the move into `slot`, so the span stays valid.
+    std::span<T> out = column.mutate<T>();
+    slot = std::move(column);
+    return out;
+}
+
+/// Whole-data-set compute for a source: all chunks, concatenated.
+ComputeFn drain_source(OpenSourceFn open) {
+    return [open = std::move(open)](NodeContext& ctx) {
+        std::unique_ptr<ChunkSource> source = open(ctx);
+        std::vector<Value> chunks;
+        Value chunk;
+        while (source->next(chunk)) {
+            chunks.push_back(std::move(chunk));
+            chunk = Value{};
+        }
+        if (chunks.size() == 1) {
+            ctx.set_output(0, std::move(chunks[0]));
+            return;
+        }
+        std::vector<Buffer> parts;
+        parts.reserve(chunks.size());
+        for (const Value& c : chunks) {
+            parts.push_back(c.as_buffer());
+        }
+        ctx.set_output(0, Buffer::concat(parts));
+    };
+}
+
+/// Whole-data-set compute for a sink: the first input as the only chunk.
+ComputeFn single_chunk_sink(OpenSinkFn open) {
+    return [open = std::move(open)](NodeContext& ctx) {
+        std::unique_ptr<ChunkSink> sink = open(ctx);
+        sink->consume(ctx.input(0));
+        sink->finish(ctx);
+    };
+}
+
+} // namespace
+
+std::span<const double> BatchContext::floats(std::size_t i) const {
+    if (!is_column(i)) {
+        return broadcast(input(i).as_float(), rows_, *arena_);
+    }
+    return column_as<double>(input(i).as_buffer(), *arena_);
+}
+
+std::span<const std::int64_t> BatchContext::ints(std::size_t i) const {
+    if (!is_column(i)) {
+        return broadcast(input(i).as_int(), rows_, *arena_);
+    }
+    return column_as<std::int64_t>(input(i).as_buffer(), *arena_);
+}
+
+std::span<double> BatchContext::output_floats(std::size_t i) {
+    return allocate_column<double>(outputs_[i], rows_);
+}
+
+std::span<std::int64_t> BatchContext::output_ints(std::size_t i) {
+    return allocate_column<std::int64_t>(outputs_[i], rows_);
+}
+
+int NodeType::input_index(std::string_view port) const noexcept {
+    return index_of(inputs, port);
+}
+
+int NodeType::output_index(std::string_view port) const noexcept {
+    return index_of(outputs, port);
+}
+
+int NodeType::param_index(std::string_view param) const noexcept {
+    return index_of(params, param);
+}
+
+/// A type registered with add_deferred() and not looked up yet.
+struct NodeRegistry::Deferred {
+    std::string name;
+    std::function<NodeType()> make;
+    std::once_flag once;
+    std::shared_ptr<const NodeType> type;
+};
+
+namespace {
+
+/// Fills in derived compute functions and checks `type` is complete.
+std::shared_ptr<const NodeType> finish(NodeType type) {
+    if (type.name.empty()) {
+        throw GraphError("node type must have a name");
+    }
+    if (!type.compute && type.kernel) {
+        type.compute = type.kernel;
+    }
+    if (!type.compute && type.open_source) {
+        type.compute = drain_source(type.open_source);
+    }
+    if (!type.compute && type.open_sink) {
+        type.compute = single_chunk_sink(type.open_sink);
+    }
+    if (type.open_source && type.outputs.empty()) {
+        throw GraphError("source node type '" + type.name + "' has no output to stream");
+    }
+    if (type.open_sink && type.inputs.empty()) {
+        throw GraphError("sink node type '" + type.name + "' has no input to consume");
+    }
+    if (!type.compute) {
+        throw GraphError("node type '" + type.name + "' has no compute function");
+    }
+    return std::make_shared<const NodeType>(std::move(type));
+}
+
+/// Deferred types being built by this thread, innermost last.
+thread_local std::vector<const void*> building;
+
+} // namespace
+
+NodeRegistry::NodeRegistry(NodeRegistry&& other) noexcept
+    : types_(std::move(other.types_)), deferred_(std::move(other.deferred_)) {}
+
+NodeRegistry& NodeRegistry::operator=(NodeRegistry&& other) noexcept {
+    types_ = std::move(other.types_);
+    deferred_ = std::move(other.deferred_);
+    return *this;
+}
+
+NodeRegistry::~NodeRegistry() = default;
+
+std::shared_ptr<const NodeType> NodeRegistry::add(NodeType type) {
+    auto shared = finish(std::move(type));
+    std::lock_guard lock(mutex_);
+    if (deferred_.count(shared->name) != 0) {
+        throw GraphError("node type '" + shared->name + "' is already registered");
+    }
+    auto [it, inserted] = types_.emplace(shared->name, shared);
+    if (!inserted) {
+        throw GraphError("node type '" + shared->name + "' is already registered");
+    }
+    return it->second;
+}
+
+void NodeRegistry::add_deferred(std::string name, std::function<NodeType()> make) {
+    if (name.empty()) {
+        throw GraphError("node type must have a name");
+    }
+    std::lock_guard lock(mutex_);
+    if (types_.count(name) != 0 || deferred_.count(name) != 0) {
+        throw GraphError("node type '" + name + "' is already registered");
+    }
+    auto entry = std::make_shared<Deferred>();
+    entry->name = name;
+    entry->make = std::move(make);
+    deferred_.emplace(std::move(name), std::move(entry));
+}
+
+std::shared_ptr<const NodeType> NodeRegistry::find(std::string_view name) const {
+    std::shared_ptr<Deferred> entry;
+    {
+        std::lock_guard lock(mutex_);
+        const std::string key(name);
+        if (auto it = types_.find(key); it != types_.end()) {
+            return it->second;
+        }
+        auto it = deferred_.find(key);
+        if (it == deferred_.end()) {
+            return nullptr;
+        }
+        entry = it->second;
+    }
+
+    // Built outside the lock: make() usually looks up other types. A type
+    // that needs itself would wait on its own once_flag forever.
+    if (std::find(building.begin(), building.end(), entry.get()) != building.end()) {
+        throw GraphError("node type '" + entry->name + "' is defined in terms of itself");
+    }
+    building.push_back(entry.get());
+    try {
+        std::call_once(entry->once, [&] {
+            NodeType type = entry->make();
+            type.name = entry->name;
+            entry->type = finish(std::move(type));
+        });
+    } catch (...) {
+        building.pop_back();
+        throw;
+    }
+    building.pop_back();
+
+    std::lock_guard lock(mutex_);
+    types_.emplace(entry->name, entry->type);
+    return entry->type;
+}
+
+std::shared_ptr<const NodeType> NodeRegistry::get(std::string_view name) const {
+    auto type = find(name);
+    if (!type) {
+        throw GraphError("unknown node type '" + std::string(name) + "'");
+    }
+    return type;
+}
+
+bool NodeRegistry::contains(std::string_view name) const {
+    std::lock_guard lock(mutex_);
+    const std::string key(name);
+    return types_.count(key) != 0 || deferred_.count(key) != 0;
+}
+
+std::vector<std::string> NodeRegistry::names() const {
+    std::lock_guard lock(mutex_);
+    std::vector<std::string> out;
+    out.reserve(types_.size() + deferred_.size());
+    for (const auto& [name, type] : types_) {
+        out.push_back(name);
+    }
+    for (const auto& [name, entry] : deferred_) {
+        if (types_.count(name) == 0) {
+            out.push_back(name);
+        }
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+} // namespace rebelflow
@@ -0,0 +1,179 @@
+#include "rebelflow/nodes/builtin.hpp"
+
+#include "rebelflow/script.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace rebelflow {
+
+namespace {
+
+template <double (*Op)(double, double)>
+NodeType binary_float_node(const char* name, const char* expression) {
+    NodeType type;
+    type.name = name;
+    type.inputs = {{"a", DataType::Float, 0.0}, {"b", DataType::Float, 0.0}};
+    type.outputs = {{"result", DataType::Float}};
+    type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, Op(ctx.input(0).as_float(), ctx.input(1).as_float()));
+    };
+    type.batch_kernel = [](BatchContext& ctx) {
+        const std::span<const double> a = ctx.floats(0);
+        const std::span<const double> b = ctx.floats(1);
+        const std::span<double> out = ctx.output_floats(0);
+        for (std::size_t i = 0; i < out.size(); ++i) {
+            out[i] = Op(a[i], b[i]);
+        }
+    };
+    auto script = std::make_shared<const Script>(Script::compile(expression, {"a", "b"}));
+    type.expression = [script](std::span<const Value>) { return script; };
+    return type;
+}
+
+double add(double a, double b) { return a + b; }
+double subtract(double a, double b) { return a - b; }
+double multiply(double a, double b) { return a * b; }
+double divide(double a, double b) { return a / b; }
+double min(double a, double b) { return std::min(a, b); }
+double max(double a, double b) { return std::max(a, b); }
+
+template <typename T>
+void scale_in_place(Buffer& buffer, double factor) {
+    for (T& v : buffer.mutate<T>()) {
+        v = static_cast<T>(v * factor);
+    }
+}
+
+template <typename T>
+double sum_of(const Buffer& buffer) {
+    double total = 0.0;
+    for (T v : buffer.view<T>()) {
+        total += static_cast<double>(v);
+    }
+    return total;
+}
+
+void require_float_buffer(const Buffer& buffer) {
+    if (buffer.element_type() != ElementType::F32 && buffer.element_type() != ElementType::F64) {
+        throw TypeError(std::string("expected a f32 or f64 buffer, got ") +
+                        to_string(buffer.element_type()));
+    }
+}
+
+Buffer range_values(std::size_t first, std::size_t count) {
+    Buffer values = Buffer::allocate(ElementType::F64, count);
+    std::span<double> out = values.mutate<double>();
+    for (std::size_t i = 0; i < count; ++i) {
+        out[i] = static_cast<double>(first + i);
+    }
+    return values;
+}
+
+std::size_t non_negative(const Value& v) {
+    return static_cast<std::size_t>(std::max<std::int64_t>(v.as_int(), 0));
+}
+
+/// Streams 0 .. count - 1 in chunks of `chunk_size` elements.
+class RangeSource final : public ChunkSource {
+public:
+    RangeSource(std::size_t count, std::size_t chunk_size)
+        : count_(count), chunk_size_(std::max<std::size_t>(chunk_size, 1)) {}
+
+    bool next(Value& chunk) override {
+        if (next_ >= count_) {
+            return false;
+        }
+        const std::size_t n = std::min(chunk_size_, count_ - next_);
+        chunk = range_values(next_, n);
+        next_ += n;
+        return true;
+    }
+
+private:
+    std::size_t count_;
+    std::size_t chunk_size_;
+    std::size_t next_ = 0;
+};
+
+class SumSink final : public ChunkSink {
+public:
+    void consume(const Value& chunk) override {
+        const Buffer& values = chunk.as_buffer();
+        require_float_buffer(values);
+        total_ += values.element_type() == ElementType::F32 ? sum_of<float>(values)
+                                                            : sum_of<double>(values);
+    }
+
+    void finish(NodeContext& ctx) override { ctx.set_output(0, total_); }
+
+private:
+    double total_ = 0.0;
+};
+
+} // namespace
+
+void register_builtin_nodes(NodeRegistry& registry) {
+    NodeType constant;
+    constant.name = "Constant";
+    constant.outputs = {{"value", DataType::Any}};
+    constant.params = {{"value", 0.0}};
+    constant.kernel = [](NodeContext& ctx) { ctx.set_output(0, ctx.param(0)); };
+    registry.add(std::move(constant));
+
+    registry.add(binary_float_node<add>("Add", "a + b"));
+    registry.add(binary_float_node<subtract>("Subtract", "a - b"));
+    registry.add(binary_float_node<multiply>("Multiply", "a * b"));
+    registry.add(binary_float_node<divide>("Divide", "a / b"));
+    registry.add(binary_float_node<min>("Min", "min(a, b)"));
+    registry.add(binary_float_node<max>("Max", "max(a, b)"));
+
+    NodeType range;
+    range.name = "Range";
+    range.outputs = {{"values", DataType::Buffer}};
+    range.params = {{"count", 0}, {"chunk_size", 65536}};
+    range.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, range_values(0, non_negative(ctx.param(0))));
+    };
+    range.open_source = [](NodeContext& ctx) -> std::unique_ptr<ChunkSource> {
+        return std::make_unique<RangeSource>(non_negative(ctx.param(0)),
+                                             non_negative(ctx.param(1)));
+    };
+    registry.add(std::move(range));
+
+    NodeType scale;
+    scale.name = "Scale";
+    scale.inputs = {{"values", DataType::Buffer}, {"factor", DataType::Float, 1.0}};
+    scale.outputs = {{"values", DataType::Buffer}};
+    scale.kernel = [](NodeContext& ctx) {
+        // Copy-on-write: the input stays shared with every other consumer and
+        // the elements are copied once, by mutate().
+        Buffer values = ctx.input(0).as_buffer();
+        require_float_buffer(values);
+        const double factor = ctx.input(1).as_float();
+        if (values.element_type() == ElementType::F32) {
+            scale_in_place<float>(values, factor);
+        } else {
+            scale_in_place<double>(values, factor);
+        }
+        ctx.set_output(0, std::move(values));
+    };
+    registry.add(std::move(scale));
+
+    NodeType sum;
+    sum.name = "Sum";
+    sum.inputs = {{"values", DataType::Buffer}};
+    sum.outputs = {{"sum", DataType::Float}};
+    sum.kernel = [](NodeContext& ctx) {
+        const Buffer& values = ctx.input(0).as_buffer();
+        require_float_buffer(values);
+        ctx.set_output(0, values.element_type() == ElementType::F32 ? sum_of<float>(values)
+                                                                    : sum_of<double>(values));
+    };
+    sum.open_sink = [](NodeContext&) -> std::unique_ptr<ChunkSink> {
+        return std::make_unique<SumSink>();
+    };
+    registry.add(std::move(sum));
+}
+
+} // namespace rebelflow
@@ -0,0 +1,280 @@
+#include "rebelflow/nodes/loop.hpp"
+
+#include "rebelflow/script.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace rebelflow {
+
+namespace {
+
+/// Item `i` of a collection; slices share the collection's storage.
+Value item_at(const Buffer& items, std::size_t i) {
+    if (items.components() != 1) {
+        return items.slice(i * items.components(), items.components());
+    }
+    switch (items.element_type()) {
+    case ElementType::U8: return std::int64_t{items.view<std::uint8_t>()[i]};
+    case ElementType::I32: return std::int64_t{items.view<std::int32_t>()[i]};
+    case ElementType::U32: return std::int64_t{items.view<std::uint32_t>()[i]};
+    case ElementType::I64: return items.view<std::int64_t>()[i];
+    case ElementType::F32: return static_cast<double>(items.view<float>()[i]);
+    case ElementType::F64: return items.view<double>()[i];
+    }
+    return {};
+}
+
+const Buffer& collection(const NodeContext& ctx) {
+    const Value& items = ctx.input(0);
+    if (items.type() != DataType::Buffer) {
+        throw TypeError(std::string("items must be a buffer, got ") + to_string(items.type()));
+    }
+    return items.as_buffer();
+}
+
+std::size_t grain_of(const Value& v) {
+    return static_cast<std::size_t>(std::max<std::int64_t>(v.as_int(), 1));
+}
+
+/// Per-item results gathered into one f64 buffer. The first result fixes the
+/// shape: a number per item, or a 3-vector per item. store() may be called
+/// concurrently for distinct items.
+class Column {
+public:
+    Column(std::size_t count, const Value& first) {
+        components_ = is_vector(first) ? 3 : 1;
+        buffer_ = Buffer::allocate(ElementType::F64, count * components_, components_);
+        data_ = buffer_.mutate<double>();
+        store(0, first);
+    }
+
+    void store(std::size_t i, const Value& v) {
+        if (components_ == 1 && (v.type() == DataType::Float || v.type() == DataType::Int ||
+                                 v.type() == DataType::Bool)) {
+            data_[i] = v.type() == DataType::Bool ? (v.as_bool() ? 1.0 : 0.0) : v.as_float();
+            return;
+        }
+        if (components_ == 3 && is_vector(v)) {
+            const Buffer& b = v.as_buffer();
+            for (std::size_t k = 0; k < 3; ++k) {
+                data_[i * 3 + k] = b.element_type() == ElementType::F64
+                                       ? b.view<double>()[k]
+                                       : static_cast<double>(b.view<float>()[k]);
+            }
+            return;
+        }
+        throw TypeError("item " + std::to_string(i) + " produced " + v.to_string() +
+                        (components_ == 1 ? ", expected a number" : ", expected a 3-vector"));
+    }
+
+    Buffer take() { return std::move(buffer_); }
+
+private:
+    static bool is_vector(const Value& v) {
+        if (v.type() != DataType::Buffer) {
+            return false;
+        }
+        const Buffer& b = v.as_buffer();
+        return b.size() == 3 &&
+               (b.element_type() == ElementType::F64 || b.element_type() == ElementType::F32);
+    }
+
+    std::size_t components_ = 1;
+    Buffer buffer_;
+    std::span<double> data_;
+};
+
+void map_items(NodeContext& ctx) {
+    const Script& script = ctx.state<Script>();
+    const Buffer& items = collection(ctx);
+    const std::size_t count = items.tuples();
+    if (count == 0) {
+        ctx.set_output(0, Buffer::allocate(ElementType::F64, 0));
+        return;
+    }
+    auto evaluate = [&](std::size_t i) {
+        const Value item = item_at(items, i);
+        const Value index = static_cast<std::int64_t>(i);
+        const Value* inputs[] = {&item, &index, &ctx.input(1), &ctx.input(2)};
+        return script.run(inputs);
+    };
+
+    Column out(count, evaluate(0));
+    parallel_for(ctx.pool(), count - 1, grain_of(ctx.param(1)),
+                 [&](std::size_t begin, std::size_t end) {
+                     for (std::size_t i = begin + 1; i < end + 1; ++i) {
+                         out.store(i, evaluate(i));
+                     }
+                 });
+    ctx.set_output(0, out.take());
+}
+
+void reduce_items(NodeContext& ctx) {
+    const Script& script = ctx.state<Script>();
+    const Buffer& items = collection(ctx);
+    const Value& initial = ctx.input(1);
+    const std::size_t count = items.tuples();
+    auto combine = [&](const Value& a, const Value& b) {
+        const Value* inputs[] = {&a, &b};
+        return script.run(inputs);
+    };
+    auto fold = [&](std::size_t begin, std::size_t end) {
+        Value acc = item_at(items, begin);
+        for (std::size_t i = begin + 1; i < end; ++i) {
+            acc = combine(acc, item_at(items, i));
+        }
+        return acc;
+    };
+
+    if (count == 0) {
+        ctx.set_output(0, initial);
+        return;
+    }
+    if (!ctx.param(1).as_bool()) {
+        Value acc = initial.is_null() ? item_at(items, 0) : combine(initial, item_at(items, 0));
+        for (std::size_t i = 1; i < count; ++i) {
+            acc = combine(acc, item_at(items, i));
+        }
+        ctx.set_output(0, std::move(acc));
+        return;
+    }
+
+    // Associative: reduce ranges in parallel, then combine neighbouring
+    // partial results pairwise, halving their number at every level. Order
+    // is preserved, so the combiner need not be commutative.
+    const std::size_t workers = ctx.pool() != nullptr ? ctx.pool()->size() : 1;
+    const std::size_t grain = grain_of(ctx.param(2));
+    const std::size_t ranges =
+        std::clamp<std::size_t>(count / grain, 1, std::max<std::size_t>(workers * 4, 1));
+    const std::size_t size = (count + ranges - 1) / ranges;
+    std::vector<Value> partial((count + size - 1) / size);
+    parallel_for(ctx.pool(), partial.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t r = begin; r < end; ++r) {
+            partial[r] = fold(r * size, std::min(count, (r + 1) * size));
+        }
+    });
+    while (partial.size() > 1) {
+        std::vector<Value> next((partial.size() + 1) / 2);
+        parallel_for(ctx.pool(), partial.size() / 2, 1, [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; ++k) {
+                next[k] = combine(partial[2 * k], partial[2 * k + 1]);
+            }
+        });
+        if (partial.size() % 2 != 0) {
+            next.back() = std::move(partial.back());
+        }
+        partial = std::move(next);
+    }
+    ctx.set_output(0, initial.is_null() ? std::move(partial[0]) : combine(initial, partial[0]));
+}
+
+} // namespace
+
+void register_loop_nodes(NodeRegistry& registry) {
+    NodeType map;
+    map.name = "Map";
+    map.inputs = {{"items", DataType::Buffer}, {"a", DataType::Any, 0.0}, {"b", DataType::Any, 0.0}};
+    map.outputs = {{"result", DataType::Buffer}};
+    map.params = {{"code", std::string("x")}, {"grain", std::int64_t{1024}}};
+    map.prepare = [](std::span<const Value> params) {
+        return std::make_shared<const Script>(
+            Script::compile(params[0].as_string(), {"x", "i", "a", "b"}));
+    };
+    map.compute = map_items;
+    registry.add(std::move(map));
+
+    NodeType reduce;
+    reduce.name = "Reduce";
+    reduce.inputs = {{"items", DataType::Buffer}, {"initial", DataType::Any}};
+    reduce.outputs = {{"result", DataType::Any}};
+    reduce.params = {{"code", std::string("a + b")},
+                     {"associative", true},
+                     {"grain", std::int64_t{1024}}};
+    reduce.prepare = [](std::span<const Value> params) {
+        return std::make_shared<const Script>(Script::compile(params[0].as_string(), {"a", "b"}));
+    };
+    reduce.compute = reduce_items;
+    registry.add(std::move(reduce));
+}
+
+NodeType for_each_type(std::string name, std::shared_ptr<const NodeType> body, std::size_t grain) {
+    if (!body || body->inputs.empty() || body->outputs.empty()) {
+        throw GraphError("for-each body of '" + name + "' needs an input and an output");
+    }
+    NodeType type;
+    type.name = std::move(name);
+    type.inputs = body->inputs;
+    type.inputs[0] = {"items", DataType::Buffer, {}};
+    for (const PortSpec& port : body->outputs) {
+        type.outputs.push_back({port.name, DataType::Buffer, {}});
+    }
+    type.params = body->params;
+    type.prepare = body->prepare;
+    type.pure = body->pure;
+    type.version = body->version;
+    grain = std::max<std::size_t>(grain, 1);
+
+    type.compute = [body, grain](NodeContext& ctx) {
+        const Buffer& items = collection(ctx);
+        const std::size_t count = items.tuples();
+        const std::size_t ports = ctx.output_count();
+        if (count == 0) {
+            for (std::size_t o = 0; o < ports; ++o) {
+                ctx.set_output(o, Buffer::allocate(ElementType::F64, 0));
+            }
+            return;
+        }
+
+        // Runs item `i` into `outputs`: its inputs are the item followed by
+        // the node's other inputs.
+        auto run_item = [&](std::size_t i, std::vector<const Value*>& inputs,
+                            std::vector<Value>& outputs, Arena& arena) {
+            const Value item = item_at(items, i);
+            inputs[0] = &item;
+            std::fill(outputs.begin(), outputs.end(), Value{});
+            NodeContext item_ctx = ctx.with(inputs, outputs, arena);
+            try {
+                body->compute(item_ctx);
+            } catch (const std::exception& e) {
+                arena.reset();
+                throw Error("item " + std::to_string(i) + ": " + e.what());
+            }
+            arena.reset();
+        };
+        auto node_inputs = [&] {
+            return std::vector<const Value*>(ctx.inputs().begin(), ctx.inputs().end());
+        };
+
+        // Items get arenas of their own: the node's arena belongs to the
+        // calling worker and is accounted per node.
+        std::vector<const Value*> inputs = node_inputs();
+        std::vector<Value> outputs(ports);
+        Arena arena(4 * 1024);
+        run_item(0, inputs, outputs, arena);
+        std::vector<Column> columns;
+        columns.reserve(ports);
+        for (std::size_t o = 0; o < ports; ++o) {
+            columns.emplace_back(count, outputs[o]);
+        }
+
+        parallel_for(ctx.pool(), count - 1, grain, [&](std::size_t begin, std::size_t end) {
+            std::vector<const Value*> range_inputs = node_inputs();
+            std::vector<Value> range_outputs(ports);
+            Arena arena(4 * 1024);
+            for (std::size_t i = begin + 1; i < end + 1; ++i) {
+                run_item(i, range_inputs, range_outputs, arena);
+                for (std::size_t o = 0; o < ports; ++o) {
+                    columns[o].store(i, range_outputs[o]);
+                }
+            }
+        });
+        for (std::size_t o = 0; o < ports; ++o) {
+            ctx.set_output(o, columns[o].take());
+        }
+    };
+    return type;
+}
+
+} // namespace rebelflow
@@ -0,0 +1,471 @@
+#include "rebelflow/nodes/mesh.hpp"
+
+#include "rebelflow/brep.hpp"
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/mesh_boolean.hpp"
+#include "rebelflow/mesh_io.hpp"
+#include "rebelflow/step.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace rebelflow {
+
+namespace {
+
+constexpr double infinity = std::numeric_limits<double>::infinity();
+constexpr double nan = std::numeric_limits<double>::quiet_NaN();
+
+/// Queries per parallel_for range.
+constexpr std::size_t query_grain = 1024;
+
+std::size_t non_negative(const Value& v) {
+    return static_cast<std::size_t>(std::max<std::int64_t>(v.as_int(), 0));
+}
+
+/// xyz triples as f64, shared if they already are.
+Buffer points_of(const Buffer& points, const char* what) {
+    if (points.size() % 3 != 0) {
+        throw TypeError(std::string(what) + " come in xyz triples, got " +
+                        std::to_string(points.size()) + " elements");
+    }
+    if (points.element_type() == ElementType::F64) {
+        return points;
+    }
+    if (points.element_type() == ElementType::F32) {
+        const std::span<const float> in = points.view<float>();
+        return Buffer::adopt(std::vector<double>(in.begin(), in.end()), 3);
+    }
+    throw TypeError(std::string(what) + " must be f32 or f64, got " +
+                    to_string(points.element_type()));
+}
+
+/// Streams the points of a mesh file (PointReader), `chunk_size` at a time.
+class PointSource final : public ChunkSource {
+public:
+    PointSource(const std::string& path, std::size_t chunk_size)
+        : reader_(path), chunk_size_(chunk_size) {}
+
+    bool next(Value& chunk) override {
+        Buffer points;
+        if (!reader_.next(chunk_size_, points)) {
+            return false;
+        }
+        chunk = std::move(points);
+        return true;
+    }
+
+private:
+    PointReader reader_;
+    std::size_t chunk_size_;
+};
+
+/// Bounding box and count of the points seen so far.
+class PointBounds {
+public:
+    void add(const Buffer& points) {
+        const Buffer xyz = points_of(points, "points");
+        const std::span<const double> p = xyz.view<double>();
+        for (std::size_t i = 0; i < p.size(); i += 3) {
+            for (std::size_t k = 0; k < 3; ++k) {
+                low_[k] = std::min(low_[k], p[i + k]);
+                high_[k] = std::max(high_[k], p[i + k]);
+            }
+        }
+        count_ += p.size() / 3;
+    }
+
+    void set_outputs(NodeContext& ctx) const {
+        ctx.set_output(0, Buffer::copy_of(std::span<const double>(low_), 3));
+        ctx.set_output(1, Buffer::copy_of(std::span<const double>(high_), 3));
+        ctx.set_output(2, static_cast<std::int64_t>(count_));
+    }
+
+private:
+    std::array<double, 3> low_{infinity, infinity, infinity};
+    std::array<double, 3> high_{-infinity, -infinity, -infinity};
+    std::size_t count_ = 0;
+};
+
+class BoundsSink final : public ChunkSink {
+public:
+    void consume(const Value& chunk) override { bounds_.add(chunk.as_buffer()); }
+    void finish(NodeContext& ctx) override { bounds_.set_outputs(ctx); }
+
+private:
+    PointBounds bounds_;
+};
+
+Bvh::Point point_at(std::span<const double> xyz, std::size_t i) noexcept {
+    return {xyz[3 * i], xyz[3 * i + 1], xyz[3 * i + 2]};
+}
+
+/// Casts one ray per origin, along the matching direction or, if there is
+/// just one, all along the same.
+void raycast(NodeContext& ctx) {
+    const Bvh& bvh = ctx.input(0).as_bvh();
+    const Buffer origins = points_of(ctx.input(1).as_buffer(), "ray origins");
+    const Buffer directions = points_of(ctx.input(2).as_buffer(), "ray directions");
+    const std::size_t count = origins.size() / 3;
+    if (directions.size() != 3 && directions.size() != origins.size()) {
+        throw TypeError("expected one ray direction or one per origin, got " +
+                        std::to_string(directions.size() / 3) + " for " +
+                        std::to_string(count) + " origins");
+    }
+    const double max_distance = ctx.param(0).as_float();
+    const std::span<const double> o = origins.view<double>();
+    const std::span<const double> d = directions.view<double>();
+    const bool shared = directions.size() == 3;
+
+    Buffer distances = Buffer::allocate(ElementType::F64, count);
+    Buffer triangles = Buffer::allocate(ElementType::I32, count);
+    Buffer points = Buffer::allocate(ElementType::F64, count * 3, 3);
+    const std::span<double> dist = distances.mutate<double>();
+    const std::span<std::int32_t> tri = triangles.mutate<std::int32_t>();
+    const std::span<double> hit = points.mutate<double>();
+    parallel_for(ctx.pool(), count, query_grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const Bvh::Point origin = point_at(o, i);
+            const Bvh::Point direction = point_at(d, shared ? 0 : i);
+            const Bvh::RayHit h = bvh.raycast(origin, direction, max_distance);
+            dist[i] = h.distance;
+            tri[i] = h.hit() ? static_cast<std::int32_t>(h.triangle) : -1;
+            for (int k = 0; k < 3; ++k) {
+                hit[3 * i + k] = h.hit() ? origin[k] + direction[k] * h.distance : nan;
+            }
+        }
+    });
+    ctx.set_output(0, std::move(distances));
+    ctx.set_output(1, std::move(triangles));
+    ctx.set_output(2, std::move(points));
+}
+
+void closest_points(NodeContext& ctx) {
+    const Bvh& bvh = ctx.input(0).as_bvh();
+    const Buffer queries = points_of(ctx.input(1).as_buffer(), "query points");
+    const std::size_t count = queries.size() / 3;
+    const double max_distance = ctx.param(0).as_float();
+    const std::span<const double> q = queries.view<double>();
+
+    Buffer points = Buffer::allocate(ElementType::F64, count * 3, 3);
+    Buffer distances = Buffer::allocate(ElementType::F64, count);
+    Buffer triangles = Buffer::allocate(ElementType::I32, count);
+    const std::span<double> near = points.mutate<double>();
+    const std::span<double> dist = distances.mutate<double>();
+    const std::span<std::int32_t> tri = triangles.mutate<std::int32_t>();
+    parallel_for(ctx.pool(), count, query_grain, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            const Bvh::Nearest n = bvh.closest_point(point_at(q, i), max_distance);
+            const bool found = n.triangle != Mesh::invalid;
+            for (int k = 0; k < 3; ++k) {
+                near[3 * i + k] = found ? n.point[k] : nan;
+            }
+            dist[i] = n.distance;
+            tri[i] = found ? static_cast<std::int32_t>(n.triangle) : -1;
+        }
+    });
+    ctx.set_output(0, std::move(points));
+    ctx.set_output(1, std::move(distances));
+    ctx.set_output(2, std::move(triangles));
+}
+
+/// Close pairs between `a` and `b`, or within `a` if `b` is not connected.
+void overlaps(NodeContext& ctx) {
+    const Bvh& a = ctx.input(0).as_bvh();
+    const double tolerance = ctx.param(0).as_float();
+    const std::vector<Bvh::Overlap> found =
+        ctx.input(1).is_null() ? a.self_overlaps(tolerance, ctx.pool())
+                               : a.overlaps(ctx.input(1).as_bvh(), tolerance, ctx.pool());
+    std::vector<std::uint32_t> pairs(found.size() * 2);
+    std::vector<double> distances(found.size());
+    for (std::size_t i = 0; i < found.size(); ++i) {
+        pairs[2 * i] = found[i].first;
+        pairs[2 * i + 1] = found[i].second;
+        distances[i] = found[i].distance;
+    }
+    ctx.set_output(0, Buffer::adopt(std::move(pairs), 2));
+    ctx.set_output(1, Buffer::adopt(std::move(distances)));
+}
+
+Mesh grid(double size_x, double size_y, std::size_t nx, std::size_t ny, ThreadPool* pool) {
+    nx = std::max<std::size_t>(nx, 1);
+    ny = std::max<std::size_t>(ny, 1);
+    if ((nx + 1) * (ny + 1) >= Mesh::invalid || nx * ny * 6 >= Mesh::invalid) {
+        throw Error("grid too large for 32-bit indices");
+    }
+    const std::size_t row = nx + 1;
+    Buffer positions = Buffer::allocate(ElementType::F64, row * (ny + 1) * 3, 3);
+    const std::span<double> p = positions.mutate<double>();
+    parallel_for(pool, ny + 1, 64, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t j = begin; j < end; ++j) {
+            const double y = size_y * (static_cast<double>(j) / static_cast<double>(ny) - 0.5);
+            for (std::size_t i = 0; i <= nx; ++i) {
+                double* v = p.data() + 3 * (j * row + i);
+                v[0] = size_x * (static_cast<double>(i) / static_cast<double>(nx) - 0.5);
+                v[1] = y;
+                v[2] = 0.0;
+            }
+        }
+    });
+    Buffer triangles = Buffer::allocate(ElementType::U32, nx * ny * 6, 3);
+    const std::span<std::uint32_t> t = triangles.mutate<std::uint32_t>();
+    parallel_for(pool, ny, 64, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t j = begin; j < end; ++j) {
+            for (std::size_t i = 0; i < nx; ++i) {
+                const auto a = static_cast<std::uint32_t>(j * row + i);
+                const auto b = static_cast<std::uint32_t>(a + 1);
+                const auto c = static_cast<std::uint32_t>(a + row + 1);
+                const auto d = static_cast<std::uint32_t>(a + row);
+                std::uint32_t* out = t.data() + 6 * (j * nx + i);
+                out[0] = a, out[1] = b, out[2] = c;
+                out[3] = a, out[4] = c, out[5] = d;
+            }
+        }
+    });
+    return Mesh::from_triangles(positions, triangles, pool);
+}
+
+/// One body by `name` or, without one, by index; every body for index -1.
+void tessellate_node(NodeContext& ctx) {
+    const Brep& brep = ctx.input(0).as_brep();
+    const std::string& name = ctx.param(1).as_string();
+    const double tolerance = ctx.param(2).as_float();
+    if (!name.empty()) {
+        const std::uint32_t body = brep.find_body(name);
+        if (body == Brep::invalid) {
+            throw Error("no body called '" + name + "'");
+        }
+        ctx.set_output(0, brep.tessellate(body, tolerance, ctx.pool()));
+    } else if (ctx.param(0).as_int() < 0) {
+        ctx.set_output(0, brep.tessellate_all(tolerance, ctx.pool()));
+    } else {
+        ctx.set_output(0, brep.tessellate(static_cast<std::size_t>(ctx.param(0).as_int()),
+                                          tolerance, ctx.pool()));
+    }
+}
+
+template <BooleanOperation Operation>
+NodeType boolean_node(const char* name) {
+    NodeType type;
+    type.name = name;
+    type.inputs = {{"a", DataType::Mesh}, {"b", DataType::Mesh}};
+    type.outputs = {{"mesh", DataType::Mesh}};
+    type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, mesh_boolean(ctx.input(0).as_mesh(), ctx.input(1).as_mesh(), Operation,
+                                       ctx.pool()));
+    };
+    return type;
+}
+
+} // namespace
+
+void register_mesh_nodes(NodeRegistry& registry) {
+    NodeType from_arrays;
+    from_arrays.name = "MeshFromArrays";
+    from_arrays.inputs = {{"positions", DataType::Buffer}, {"triangles", DataType::Buffer}};
+    from_arrays.outputs = {{"mesh", DataType::Mesh}};
+    from_arrays.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, Mesh::from_triangles(ctx.input(0).as_buffer(),
+                                               ctx.input(1).as_buffer(), ctx.pool()));
+    };
+    registry.add(std::move(from_arrays));
+
+    NodeType arrays;
+    arrays.name = "MeshArrays";
+    arrays.inputs = {{"mesh", DataType::Mesh}};
+    arrays.outputs = {{"positions", DataType::Buffer}, {"triangles", DataType::Buffer}};
+    arrays.kernel = [](NodeContext& ctx) {
+        const Mesh::Arrays& m = ctx.input(0).as_mesh().arrays();
+        ctx.set_output(0, m.positions);
+        ctx.set_output(1, m.corners);
+    };
+    registry.add(std::move(arrays));
+
+    NodeType grid_type;
+    grid_type.name = "Grid";
+    grid_type.outputs = {{"mesh", DataType::Mesh}};
+    grid_type.params = {{"size_x", 1.0},
+                        {"size_y", 1.0},
+                        {"divisions_x", std::int64_t{10}},
+                        {"divisions_y", std::int64_t{10}}};
+    grid_type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, grid(ctx.param(0).as_float(), ctx.param(1).as_float(),
+                               non_negative(ctx.param(2)), non_negative(ctx.param(3)),
+                               ctx.pool()));
+    };
+    registry.add(std::move(grid_type));
+
+    NodeType weld_type;
+    weld_type.name = "Weld";
+    weld_type.inputs = {{"mesh", DataType::Mesh}};
+    weld_type.outputs = {{"mesh", DataType::Mesh}};
+    weld_type.params = {{"tolerance", 1e-6}};
+    weld_type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, weld(ctx.input(0).as_mesh(), ctx.param(0).as_float(), ctx.pool()));
+    };
+    registry.add(std::move(weld_type));
+
+    NodeType smooth_type;
+    smooth_type.name = "Smooth";
+    smooth_type.inputs = {{"mesh", DataType::Mesh}};
+    smooth_type.outputs = {{"mesh", DataType::Mesh}};
+    smooth_type.params = {{"iterations", std::int64_t{1}},
+                          {"factor", 0.5},
+                          {"keep_boundary", true}};
+    smooth_type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, smooth(ctx.input(0).as_mesh(), non_negative(ctx.param(0)),
+                                 ctx.param(1).as_float(), ctx.param(2).as_bool(), ctx.pool()));
+    };
+    registry.add(std::move(smooth_type));
+
+    NodeType normals;
+    normals.name = "Normals";
+    normals.inputs = {{"mesh", DataType::Mesh}};
+    normals.outputs = {{"mesh", DataType::Mesh}};
+    normals.params = {{"name", std::string("normal")}};
+    normals.kernel = [](NodeContext& ctx) {
+        const Mesh& mesh = ctx.input(0).as_mesh();
+        ctx.set_output(0, mesh.with_attribute({ctx.param(0).as_string(), MeshDomain::Vertex,
+                                               vertex_normals(mesh, ctx.pool())}));
+    };
+    registry.add(std::move(normals));
+
+    NodeType subdivide_type;
+    subdivide_type.name = "Subdivide";
+    subdivide_type.inputs = {{"mesh", DataType::Mesh}};
+    subdivide_type.outputs = {{"mesh", DataType::Mesh}};
+    subdivide_type.params = {{"levels", std::int64_t{1}}};
+    subdivide_type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, subdivide(ctx.input(0).as_mesh(), non_negative(ctx.param(0)),
+                                    ctx.pool()));
+    };
+    registry.add(std::move(subdivide_type));
+
+    NodeType build_bvh;
+    build_bvh.name = "BuildBvh";
+    build_bvh.inputs = {{"mesh", DataType::Mesh}};
+    build_bvh.outputs = {{"bvh", DataType::Bvh}};
+    build_bvh.params = {{"max_leaf_size", std::int64_t{4}}};
+    build_bvh.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, Bvh::build(ctx.input(0).as_mesh(), ctx.pool(),
+                                     non_negative(ctx.param(0))));
+    };
+    registry.add(std::move(build_bvh));
+
+    NodeType raycast_type;
+    raycast_type.name = "Raycast";
+    raycast_type.inputs = {{"bvh", DataType::Bvh},
+                           {"origins", DataType::Buffer},
+                           {"directions", DataType::Buffer}};
+    raycast_type.outputs = {{"distance", DataType::Buffer},
+                            {"triangle", DataType::Buffer},
+                            {"point", DataType::Buffer}};
+    raycast_type.params = {{"max_distance", infinity}};
+    raycast_type.kernel = raycast;
+    registry.add(std::move(raycast_type));
+
+    NodeType closest_point;
+    closest_point.name = "ClosestPoint";
+    closest_point.inputs = {{"bvh", DataType::Bvh}, {"points", DataType::Buffer}};
+    closest_point.outputs = {{"point", DataType::Buffer},
+                             {"distance", DataType::Buffer},
+                             {"triangle", DataType::Buffer}};
+    closest_point.params = {{"max_distance", infinity}};
+    closest_point.kernel = closest_points;
+    registry.add(std::move(closest_point));
+
+    NodeType overlaps_type;
+    overlaps_type.name = "Overlaps";
+    overlaps_type.inputs = {{"a", DataType::Bvh}, {"b", DataType::Bvh}};
+    overlaps_type.outputs = {{"pairs", DataType::Buffer}, {"distance", DataType::Buffer}};
+    overlaps_type.params = {{"tolerance", 0.0}};
+    overlaps_type.kernel = overlaps;
+    registry.add(std::move(overlaps_type));
+
+    NodeType tessellate_type;
+    tessellate_type.name = "Tessellate";
+    tessellate_type.inputs = {{"brep", DataType::Brep}};
+    tessellate_type.outputs = {{"mesh", DataType::Mesh}};
+    tessellate_type.params = {{"body", std::int64_t{-1}},
+                              {"name", std::string()},
+                              {"tolerance", 0.01}};
+    tessellate_type.kernel = tessellate_node;
+    registry.add(std::move(tessellate_type));
+
+    registry.add(boolean_node<BooleanOperation::Union>("Union"));
+    registry.add(boolean_node<BooleanOperation::Intersection>("Intersection"));
+    registry.add(boolean_node<BooleanOperation::Difference>("Difference"));
+
+    NodeType read_type;
+    read_type.name = "ReadMesh";
+    read_type.outputs = {{"mesh", DataType::Mesh}};
+    read_type.params = {{"path", std::string()}};
+    read_type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, read_mesh(ctx.param(0).as_string(), ctx.pool()));
+    };
+    read_type.pure = false;
+    registry.add(std::move(read_type));
+
+    NodeType read_points_type;
+    read_points_type.name = "ReadPoints";
+    read_points_type.outputs = {{"points", DataType::Buffer}};
+    read_points_type.params = {{"path", std::string()}, {"chunk_size", 65536}};
+    read_points_type.kernel = [](NodeContext& ctx) {
+        PointReader reader(ctx.param(0).as_string());
+        Buffer points = Buffer::allocate(ElementType::F64, 0, 3);
+        reader.next(std::numeric_limits<std::size_t>::max(), points);
+        ctx.set_output(0, std::move(points));
+    };
+    read_points_type.open_source = [](NodeContext& ctx) -> std::unique_ptr<ChunkSource> {
+        return std::make_unique<PointSource>(ctx.param(0).as_string(),
+                                             non_negative(ctx.param(1)));
+    };
+    read_points_type.pure = false;
+    registry.add(std::move(read_points_type));
+
+    NodeType bounds_type;
+    bounds_type.name = "Bounds";
+    bounds_type.inputs = {{"points", DataType::Buffer}};
+    bounds_type.outputs = {{"min", DataType::Buffer},
+                           {"max", DataType::Buffer},
+                           {"count", DataType::Int}};
+    bounds_type.kernel = [](NodeContext& ctx) {
+        PointBounds bounds;
+        bounds.add(ctx.input(0).as_buffer());
+        bounds.set_outputs(ctx);
+    };
+    bounds_type.open_sink = [](NodeContext&) -> std::unique_ptr<ChunkSink> {
+        return std::make_unique<BoundsSink>();
+    };
+    registry.add(std::move(bounds_type));
+
+    NodeType read_step_type;
+    read_step_type.name = "ReadStep";
+    read_step_type.outputs = {{"brep", DataType::Brep}};
+    read_step_type.params = {{"path", std::string()}};
+    read_step_type.kernel = [](NodeContext& ctx) {
+        ctx.set_output(0, read_step(ctx.param(0).as_string(), ctx.pool()));
+    };
+    read_step_type.pure = false;
+    registry.add(std::move(read_step_type));
+
+    NodeType write_type;
+    write_type.name = "WriteMesh";
+    write_type.inputs = {{"mesh", DataType::Mesh}};
+    write_type.outputs = {{"bytes", DataType::Int}};
+    write_type.params = {{"path", std::string()}, {"binary", true}};
+    write_type.kernel = [](NodeContext& ctx) {
+        const std::uint64_t bytes = write_mesh(ctx.input(0).as_mesh(), ctx.param(0).as_string(),
+                                               ctx.param(1).as_bool(), ctx.pool());
+        ctx.set_output(0, static_cast<std::int64_t>(bytes));
+    };
+    write_type.pure = false;
+    registry.add(std::move(write_type));
+}
+
+} // namespace rebelflow
@@ -0,0 +1,28 @@
+#include "rebelflow/nodes/script.hpp"
+
+#include "rebelflow/script.hpp"
+
+#include <memory>
+
+namespace rebelflow {
+
+void register_script_nodes(NodeRegistry& registry) {
+    NodeType script;
+    script.name = "Script";
+    script.inputs = {{"a", DataType::Any, 0.0},
+                     {"b", DataType::Any, 0.0},
+                     {"c", DataType::Any, 0.0},
+                     {"d", DataType::Any, 0.0}};
+    script.outputs = {{"result", DataType::Any}};
+    script.params = {{"code", std::string("0")}};
+    script.expression = [](std::span<const Value> params) {
+        return std::make_shared<const Script>(Script::compile(params[0].as_string()));
+    };
+    script.prepare = script.expression;
+    script.compute = [](NodeContext& ctx) {
+        ctx.set_output(0, ctx.state<Script>().run(ctx.inputs()));
+    };
+    registry.add(std::move(script));
+}
+
+} // namespace rebelflow
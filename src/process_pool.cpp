@@ -0,0 +1,725 @@
+#include "rebelflow/process_pool.hpp"
+
+#include "rebelflow/arena.hpp"
+#include "rebelflow/brep.hpp"
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/serialize.hpp"
+#include "rebelflow/shared_memory.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <dirent.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace rebelflow {
+
+namespace {
+
+// Workers talk to the pool over SOCK_SEQPACKET socket pairs, one packet per
+// message. A packet is a framing byte and either the message body or, for
+// bodies too large for one packet, its size with the body in a shared
+// segment passed as the last descriptor. Values are encoded with
+// write_value(), except non-empty buffers, which refer to a byte range of
+// one of the packet's segments.
+//
+//     request   u32 node, string type, u32 count, params, u32 count, inputs
+//     reply     u8 status: Ok, u32 count, outputs
+//                          Failed, u8 error kind, string message
+//                          Crashed, u32 signal
+
+enum class Framing : std::uint8_t { Inline, Spilled };
+enum class Status : std::uint8_t { Ok, Failed, Crashed };
+enum class Wire : std::uint8_t { Encoded, Shared, SharedMesh, SharedBvh, SharedBrep };
+
+/// SCM_RIGHTS carries at most 253 descriptors; one is kept for a spill.
+constexpr std::size_t max_segments = 252;
+constexpr std::size_t packet_limit = 48 * 1024;
+
+[[noreturn]] void fail(const std::string& what) {
+    throw IoError("process pool: " + what + ": " + std::strerror(errno));
+}
+
+/// Sends one packet with `fds` attached. Returns false if the peer is gone.
+bool send_packet(int socket, std::span<const std::byte> body, std::span<const int> fds) {
+    iovec iov{const_cast<std::byte*>(body.data()), body.size()};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    std::vector<char> control;
+    if (!fds.empty()) {
+        control.resize(CMSG_SPACE(fds.size_bytes()));
+        msg.msg_control = control.data();
+        msg.msg_controllen = control.size();
+        cmsghdr* header = CMSG_FIRSTHDR(&msg);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(fds.size_bytes());
+        std::memcpy(CMSG_DATA(header), fds.data(), fds.size_bytes());
+    }
+    for (;;) {
+        if (::sendmsg(socket, &msg, MSG_NOSIGNAL) >= 0) {
+            return true;
+        }
+        if (errno == EPIPE || errno == ECONNRESET) {
+            return false;
+        }
+        if (errno != EINTR) {
+            fail("cannot send to worker");
+        }
+    }
+}
+
+/// Receives one packet; received descriptors are appended to `fds`, which
+/// the caller then owns. Returns false when the peer has gone.
+bool receive_packet(int socket, std::vector<std::byte>& body, std::vector<int>& fds) {
+    body.resize(packet_limit + 64);
+    iovec iov{body.data(), body.size()};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int) * (max_segments + 1))];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof control;
+    ssize_t n;
+    while ((n = ::recvmsg(socket, &msg, MSG_CMSG_CLOEXEC)) < 0) {
+        if (errno == ECONNRESET) {
+            return false;
+        }
+        if (errno != EINTR) {
+            fail("cannot receive from worker");
+        }
+    }
+    for (cmsghdr* h = CMSG_FIRSTHDR(&msg); h != nullptr; h = CMSG_NXTHDR(&msg, h)) {
+        if (h->cmsg_level == SOL_SOCKET && h->cmsg_type == SCM_RIGHTS) {
+            const std::size_t count = (h->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            const auto* data = reinterpret_cast<const int*>(CMSG_DATA(h));
+            fds.insert(fds.end(), data, data + count);
+        }
+    }
+    if (n == 0 && fds.empty()) {
+        return false;
+    }
+    if ((msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0) {
+        for (const int fd : fds) {
+            ::close(fd);
+        }
+        throw FormatError("process pool: oversized packet");
+    }
+    body.resize(static_cast<std::size_t>(n));
+    return true;
+}
+
+/// A message being built, with the segments its buffers refer to. Buffers
+/// outside shared memory are copied into `staging`.
+class Message {
+public:
+    explicit Message(SharedArena& staging) noexcept : staging_(staging) {}
+
+    ByteWriter& body() noexcept { return body_; }
+
+    void value(const Value& v) {
+        if (v.type() == DataType::Buffer && !v.as_buffer().empty()) {
+            body_.write_u8(static_cast<std::uint8_t>(Wire::Shared));
+            shared(v.as_buffer());
+            return;
+        }
+        // Meshes, hierarchies and breps go as references to each of their
+        // arrays.
+        if (v.type() == DataType::Mesh && !v.as_mesh().empty()) {
+            body_.write_u8(static_cast<std::uint8_t>(Wire::SharedMesh));
+            shared(v.as_mesh());
+            return;
+        }
+        if (v.type() == DataType::Bvh && v.as_bvh().node_count() != 0) {
+            const Bvh::Arrays& b = v.as_bvh().arrays();
+            body_.write_u8(static_cast<std::uint8_t>(Wire::SharedBvh));
+            shared(b.mesh);
+            shared(b.bounds);
+            shared(b.links);
+            shared(b.triangles);
+            return;
+        }
+        if (v.type() == DataType::Brep && v.as_brep().body_count() != 0) {
+            const Brep::Arrays& b = v.as_brep().arrays();
+            body_.write_u8(static_cast<std::uint8_t>(Wire::SharedBrep));
+            for (const Buffer* buffer : {&b.bodies, &b.transforms, &b.names, &b.shapes, &b.faces,
+                                         &b.loops, &b.edge_uses, &b.edges, &b.vertices, &b.surfaces,
+                                         &b.curves, &b.parameters}) {
+                shared_or_empty(*buffer);
+            }
+            return;
+        }
+        body_.write_u8(static_cast<std::uint8_t>(Wire::Encoded));
+        write_value(body_, v);
+    }
+
+    /// Seals the staging arena and sends the message. Returns false if the
+    /// peer is gone.
+    bool send(int socket) {
+        staging_.seal();
+        std::vector<int> fds;
+        for (const auto& segment : segments_) {
+            fds.push_back(segment->fd());
+        }
+        std::byte framing[9] = {static_cast<std::byte>(Framing::Inline)};
+        if (body_.size() <= packet_limit) {
+            std::vector<std::byte> packet(body_.size() + 1);
+            packet[0] = framing[0];
+            std::memcpy(packet.data() + 1, body_.bytes().data(), body_.size());
+            return send_packet(socket, packet, fds);
+        }
+        const auto spill = SharedSegment::create(body_.size());
+        std::memcpy(spill->data(), body_.bytes().data(), body_.size());
+        fds.push_back(spill->fd());
+        framing[0] = static_cast<std::byte>(Framing::Spilled);
+        const std::uint64_t size = body_.size();
+        std::memcpy(framing + 1, &size, sizeof size);
+        return send_packet(socket, framing, fds);
+    }
+
+private:
+    void shared(const Buffer& b) {
+        SharedSegment::Location at = SharedSegment::find(b.bytes(), b.size_bytes());
+        if (!at.segment) {
+            const std::shared_ptr<std::byte> copy = staging_.allocate(b.size_bytes());
+            std::memcpy(copy.get(), b.bytes(), b.size_bytes());
+            at = SharedSegment::find(copy.get(), b.size_bytes());
+        }
+        body_.write_u32(slot(std::move(at.segment)));
+        body_.write_u64(at.offset);
+        body_.write_u64(b.size());
+        body_.write_u8(static_cast<std::uint8_t>(b.element_type()));
+        body_.write_u32(b.components());
+    }
+
+    void shared_or_empty(const Buffer& b) {
+        body_.write_u8(b.empty() ? 0 : 1);
+        if (b.empty()) {
+            body_.write_u8(static_cast<std::uint8_t>(b.element_type()));
+            body_.write_u32(b.components());
+        } else {
+            shared(b);
+        }
+    }
+
+    void shared(const Mesh& mesh) {
+        const Mesh::Arrays& m = mesh.arrays();
+        for (const Buffer* b : {&m.positions, &m.corners, &m.twins, &m.vertex_halfedges}) {
+            shared_or_empty(*b);
+        }
+        body_.write_u32(static_cast<std::uint32_t>(m.attributes.size()));
+        for (const MeshAttribute& a : m.attributes) {
+            body_.write_string(a.name);
+            body_.write_u8(static_cast<std::uint8_t>(a.domain));
+            shared_or_empty(a.data);
+        }
+    }
+
+    std::uint32_t slot(std::shared_ptr<const SharedSegment> segment) {
+        const auto it = std::find(segments_.begin(), segments_.end(), segment);
+        if (it != segments_.end()) {
+            return static_cast<std::uint32_t>(it - segments_.begin());
+        }
+        if (segments_.size() == max_segments) {
+            throw Error("process pool: a node's values span more than " +
+                        std::to_string(max_segments) + " shared segments");
+        }
+        segments_.push_back(std::move(segment));
+        return static_cast<std::uint32_t>(segments_.size() - 1);
+    }
+
+    SharedArena& staging_;
+    ByteWriter body_;
+    std::vector<std::shared_ptr<const SharedSegment>> segments_;
+};
+
+/// A received message: its body and the segments it refers to, mapped.
+class Received {
+public:
+    /// Returns false when the peer has gone.
+    bool receive(int socket) {
+        std::vector<int> fds;
+        if (!receive_packet(socket, packet_, fds)) {
+            return false;
+        }
+        segments_.clear();
+        for (const int fd : fds) {
+            segments_.push_back(SharedSegment::attach(fd));
+        }
+        if (packet_.empty()) {
+            throw FormatError("process pool: empty packet");
+        }
+        if (packet_[0] == static_cast<std::byte>(Framing::Spilled)) {
+            std::uint64_t size = 0;
+            if (packet_.size() != 1 + sizeof size || segments_.empty()) {
+                throw FormatError("process pool: bad spilled packet");
+            }
+            std::memcpy(&size, packet_.data() + 1, sizeof size);
+            spill_ = std::move(segments_.back());
+            segments_.pop_back();
+            if (size > spill_->size()) {
+                throw FormatError("process pool: truncated spilled packet");
+            }
+            body_ = {spill_->data(), static_cast<std::size_t>(size)};
+        } else {
+            spill_.reset();
+            body_ = std::span<const std::byte>(packet_).subspan(1);
+        }
+        return true;
+    }
+
+    ByteReader reader() const { return ByteReader(body_, spill_); }
+
+    Value value(ByteReader& in) const {
+        const auto wire = static_cast<Wire>(in.read_u8());
+        if (wire == Wire::Encoded) {
+            return read_value(in);
+        }
+        if (wire == Wire::Shared) {
+            return shared(in);
+        }
+        if (wire == Wire::SharedMesh) {
+            return shared_mesh(in);
+        }
+        if (wire == Wire::SharedBrep) {
+            Brep::Arrays b;
+            for (Buffer* buffer : {&b.bodies, &b.transforms, &b.names, &b.shapes, &b.faces,
+                                   &b.loops, &b.edge_uses, &b.edges, &b.vertices, &b.surfaces,
+                                   &b.curves, &b.parameters}) {
+                *buffer = shared_or_empty(in);
+            }
+            return Brep::from_arrays(std::move(b));
+        }
+        Bvh::Arrays b;
+        b.mesh = shared_mesh(in);
+        b.bounds = shared(in);
+        b.links = shared(in);
+        b.triangles = shared(in);
+        return Bvh::from_arrays(std::move(b));
+    }
+
+private:
+    Buffer shared(ByteReader& in) const {
+        const std::uint32_t slot = in.read_u32();
+        const std::uint64_t offset = in.read_u64();
+        const std::uint64_t count = in.read_u64();
+        const std::uint8_t type = in.read_u8();
+        const std::uint32_t components = in.read_u32();
+        if (slot >= segments_.size() || type > static_cast<std::uint8_t>(ElementType::F64)) {
+            throw FormatError("process pool: bad buffer reference");
+        }
+        const auto& segment = segments_[slot];
+        const auto element = static_cast<ElementType>(type);
+        if (offset > segment->size() ||
+            count > (segment->size() - offset) / element_size(element)) {
+            throw FormatError("process pool: buffer reference out of range");
+        }
+        return Buffer::wrap(element, segment->data() + offset, count, segment, components);
+    }
+
+    Buffer shared_or_empty(ByteReader& in) const {
+        if (in.read_u8() != 0) {
+            return shared(in);
+        }
+        const std::uint8_t type = in.read_u8();
+        const std::uint32_t components = in.read_u32();
+        if (type > static_cast<std::uint8_t>(ElementType::F64) || components == 0) {
+            throw FormatError("process pool: bad buffer reference");
+        }
+        return Buffer::allocate(static_cast<ElementType>(type), 0, components);
+    }
+
+    Mesh shared_mesh(ByteReader& in) const {
+        Mesh::Arrays m;
+        for (Buffer* b : {&m.positions, &m.corners, &m.twins, &m.vertex_halfedges}) {
+            *b = shared_or_empty(in);
+        }
+        const std::uint32_t count = in.read_u32();
+        for (std::uint32_t i = 0; i < count; ++i) {
+            MeshAttribute a;
+            a.name = in.read_string();
+            a.domain = static_cast<MeshDomain>(in.read_u8());
+            a.data = shared_or_empty(in);
+            m.attributes.push_back(std::move(a));
+        }
+        return Mesh::from_arrays(std::move(m));
+    }
+
+    std::vector<std::byte> packet_;
+    std::vector<std::shared_ptr<const SharedSegment>> segments_;
+    std::shared_ptr<const SharedSegment> spill_;
+    std::span<const std::byte> body_;
+};
+
+// ---------------------------------------------------------------------------
+// Worker side
+
+int crash_socket = -1;
+
+/// Reports a fatal signal to the pool, then dies of it as usual.
+void on_crash(int signal) {
+    unsigned char packet[6] = {static_cast<unsigned char>(Framing::Inline),
+                               static_cast<unsigned char>(Status::Crashed)};
+    const auto number = static_cast<std::uint32_t>(signal);
+    std::memcpy(packet + 2, &number, sizeof number);
+    [[maybe_unused]] const ssize_t sent = ::send(crash_socket, packet, sizeof packet, MSG_NOSIGNAL);
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+}
+
+/// Evaluates one request into `reply`.
+void serve(const NodeRegistry& registry,
+           const Received& request,
+           Message& reply,
+           SharedArena& results,
+           Arena& arena,
+           std::unordered_map<Digest, std::shared_ptr<const void>>& states) {
+    ByteReader in = request.reader();
+    const NodeId node = in.read_u32();
+    const std::shared_ptr<const NodeType> type = registry.get(in.read_string());
+    std::vector<Value> params(in.read_u32());
+    for (Value& param : params) {
+        param = request.value(in);
+    }
+    std::vector<Value> input_values(in.read_u32());
+    std::vector<const Value*> inputs;
+    for (Value& input : input_values) {
+        input = request.value(in);
+        inputs.push_back(&input);
+    }
+    if (inputs.size() != type->inputs.size() || params.size() != type->params.size()) {
+        throw GraphError("worker's " + type->name + " has different ports or parameters");
+    }
+
+    // Prepared states are kept per distinct parameter set: the same node
+    // usually comes back to the same worker with the same parameters.
+    std::shared_ptr<const void> state;
+    if (type->prepare) {
+        Hasher h;
+        h.update(type->name);
+        for (const Value& param : params) {
+            hash_value(h, param);
+        }
+        const Digest key = h.digest();
+        if (states.size() >= 256 && !states.contains(key)) {
+            states.clear();
+        }
+        std::shared_ptr<const void>& slot = states[key];
+        if (!slot) {
+            slot = type->prepare(params);
+        }
+        state = slot;
+    }
+
+    std::vector<Value> outputs(type->outputs.size());
+    {
+        // Buffers the node allocates land in shared memory directly.
+        const ScopedBufferAllocator scope(results);
+        NodeContext ctx(node, inputs, params, outputs, arena, state.get());
+        type->compute(ctx);
+    }
+    reply.body().write_u8(static_cast<std::uint8_t>(Status::Ok));
+    reply.body().write_u32(static_cast<std::uint32_t>(outputs.size()));
+    for (const Value& output : outputs) {
+        reply.value(output);
+    }
+}
+
+[[noreturn]] void worker_main(const NodeRegistry& registry, int socket) {
+    std::signal(SIGCHLD, SIG_DFL);
+    crash_socket = socket;
+    for (const int signal : {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT}) {
+        std::signal(signal, on_crash);
+    }
+
+    Arena arena(64 * 1024);
+    std::unordered_map<Digest, std::shared_ptr<const void>> states;
+    Received request;
+    for (;;) {
+        try {
+            if (!request.receive(socket)) {
+                ::_exit(0);
+            }
+        } catch (const std::exception&) {
+            ::_exit(1);
+        }
+        SharedArena results;
+        std::optional<Message> reply(std::in_place, results);
+        try {
+            serve(registry, request, *reply, results, arena, states);
+        } catch (const std::exception& e) {
+            reply.emplace(results);
+            reply->body().write_u8(static_cast<std::uint8_t>(Status::Failed));
+            reply->body().write_u8(static_cast<std::uint8_t>(error_kind(e)));
+            reply->body().write_string(e.what());
+        }
+        arena.reset();
+        try {
+            if (!reply->send(socket)) {
+                ::_exit(0);
+            }
+        } catch (const std::exception&) {
+            ::_exit(1);
+        }
+    }
+}
+
+/// Closes every descriptor but stdio and `keep`, so the launcher does not
+/// hold on to the files (and locks) of the process it was forked from.
+void close_other_fds(int keep) {
+#ifdef __linux__
+    if (DIR* dir = ::opendir("/proc/self/fd")) {
+        std::vector<int> fds;
+        while (const dirent* entry = ::readdir(dir)) {
+            const int fd = std::atoi(entry->d_name);
+            if (fd > 2 && fd != keep && fd != ::dirfd(dir)) {
+                fds.push_back(fd);
+            }
+        }
+        ::closedir(dir);
+        for (const int fd : fds) {
+            ::close(fd);
+        }
+        return;
+    }
+#endif
+    const long limit = std::min(::sysconf(_SC_OPEN_MAX), 65536L);
+    for (int fd = 3; fd < limit; ++fd) {
+        if (fd != keep) {
+            ::close(fd);
+        }
+    }
+}
+
+/// The launcher: forks a worker per request byte and sends back its pid and
+/// socket. Single-threaded, so forking from it is always safe.
+[[noreturn]] void launcher_main(const NodeRegistry& registry, int socket) {
+    close_other_fds(socket);
+    std::signal(SIGCHLD, SIG_IGN); // workers are reaped automatically
+    for (;;) {
+        std::uint8_t request = 0;
+        const ssize_t n = ::recv(socket, &request, 1, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            ::_exit(0);
+        }
+        int pair[2] = {-1, -1};
+        pid_t pid = -1;
+        if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) == 0) {
+            pid = ::fork();
+            if (pid == 0) {
+                ::close(socket);
+                ::close(pair[0]);
+                worker_main(registry, pair[1]);
+            }
+            ::close(pair[1]);
+        }
+        const std::int32_t reply = pid;
+        const std::span<const std::byte> body(reinterpret_cast<const std::byte*>(&reply),
+                                              sizeof reply);
+        bool sent = false;
+        try {
+            sent = send_packet(socket, body,
+                               pid > 0 ? std::span<const int>(pair, 1) : std::span<const int>());
+        } catch (const std::exception&) {
+        }
+        if (pair[0] >= 0) {
+            ::close(pair[0]);
+        }
+        if (!sent) {
+            ::_exit(0);
+        }
+    }
+}
+
+} // namespace
+
+ProcessPool::ProcessPool(const NodeRegistry& registry, unsigned processes) {
+    if (processes == 0) {
+        processes = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int pair[2];
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) != 0) {
+        fail("cannot create socket");
+    }
+    zygote_pid_ = ::fork();
+    if (zygote_pid_ < 0) {
+        ::close(pair[0]);
+        ::close(pair[1]);
+        fail("cannot fork the worker launcher");
+    }
+    if (zygote_pid_ == 0) {
+        ::close(pair[0]);
+        launcher_main(registry, pair[1]);
+    }
+    ::close(pair[1]);
+    zygote_socket_ = pair[0];
+
+    workers_.resize(processes);
+    for (std::size_t i = 0; i < workers_.size(); ++i) {
+        idle_.push_back(i);
+    }
+    try {
+        for (Worker& worker : workers_) {
+            worker = spawn();
+        }
+    } catch (...) {
+        shutdown();
+        throw;
+    }
+}
+
+ProcessPool::~ProcessPool() {
+    shutdown();
+}
+
+void ProcessPool::shutdown() noexcept {
+    for (Worker& worker : workers_) {
+        if (worker.socket >= 0) {
+            ::close(worker.socket);
+            worker.socket = -1;
+        }
+    }
+    if (zygote_socket_ >= 0) {
+        ::close(zygote_socket_);
+        zygote_socket_ = -1;
+    }
+    if (zygote_pid_ > 0) {
+        while (::waitpid(zygote_pid_, nullptr, 0) < 0 && errno == EINTR) {
+        }
+        zygote_pid_ = -1;
+    }
+}
+
+ProcessPool::Worker ProcessPool::spawn() {
+    std::lock_guard lock(spawn_mutex_);
+    const std::uint8_t request = 1;
+    if (::send(zygote_socket_, &request, 1, MSG_NOSIGNAL) != 1) {
+        fail("cannot reach the worker launcher");
+    }
+    std::vector<std::byte> body;
+    std::vector<int> fds;
+    if (!receive_packet(zygote_socket_, body, fds)) {
+        throw IoError("process pool: the worker launcher has exited");
+    }
+    std::int32_t pid = -1;
+    if (body.size() == sizeof pid) {
+        std::memcpy(&pid, body.data(), sizeof pid);
+    }
+    if (pid <= 0 || fds.size() != 1) {
+        for (const int fd : fds) {
+            ::close(fd);
+        }
+        throw IoError("process pool: cannot start a worker process");
+    }
+    return {fds[0], static_cast<pid_t>(pid)};
+}
+
+std::size_t ProcessPool::acquire() {
+    std::size_t index;
+    {
+        std::unique_lock lock(mutex_);
+        available_.wait(lock, [&] { return !idle_.empty(); });
+        index = idle_.back();
+        idle_.pop_back();
+    }
+    if (workers_[index].socket < 0) {
+        try {
+            workers_[index] = spawn();
+        } catch (...) {
+            release(index, false);
+            throw;
+        }
+        restarts_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return index;
+}
+
+void ProcessPool::release(std::size_t index, bool dead) {
+    if (dead && workers_[index].socket >= 0) {
+        ::close(workers_[index].socket);
+        workers_[index].socket = -1;
+    }
+    {
+        std::lock_guard lock(mutex_);
+        idle_.push_back(index);
+    }
+    available_.notify_one();
+}
+
+void ProcessPool::run(const NodeType& type,
+                      NodeId node,
+                      std::span<const Value* const> inputs,
+                      std::span<const Value> params,
+                      std::span<Value> outputs) {
+    SharedArena staging;
+    Message request(staging);
+    request.body().write_u32(node);
+    request.body().write_string(type.name);
+    request.body().write_u32(static_cast<std::uint32_t>(params.size()));
+    for (const Value& param : params) {
+        request.value(param);
+    }
+    request.body().write_u32(static_cast<std::uint32_t>(inputs.size()));
+    for (const Value* input : inputs) {
+        request.value(*input);
+    }
+
+    const std::size_t index = acquire();
+    const Worker worker = workers_[index];
+    Received reply;
+    bool failed = false;
+    ErrorKind kind = ErrorKind::Error;
+    std::string failure;
+    try {
+        if (!request.send(worker.socket) || !reply.receive(worker.socket)) {
+            throw Error("worker process " + std::to_string(worker.pid) +
+                        " exited while running the node");
+        }
+        ByteReader in = reply.reader();
+        const auto status = static_cast<Status>(in.read_u8());
+        if (status == Status::Crashed) {
+            const auto signal = static_cast<int>(in.read_u32());
+            throw Error("worker process " + std::to_string(worker.pid) + " crashed: " +
+                        ::strsignal(signal));
+        }
+        if (status == Status::Failed) {
+            failed = true;
+            kind = static_cast<ErrorKind>(in.read_u8());
+            failure = in.read_string();
+        } else if (status == Status::Ok && in.read_u32() == outputs.size()) {
+            for (Value& output : outputs) {
+                output = reply.value(in);
+            }
+        } else {
+            throw FormatError("process pool: bad reply from worker process " +
+                              std::to_string(worker.pid));
+        }
+    } catch (...) {
+        // A dead, crashed or garbled worker is retired; the next acquire()
+        // of its slot starts a fresh one.
+        release(index, true);
+        throw;
+    }
+    // Errors the node raised leave the worker usable.
+    release(index, false);
+    if (failed) {
+        throw_error(kind, failure);
+    }
+}
+
+} // namespace rebelflow
@@ -0,0 +1,166 @@
+#include "rebelflow/profiler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <set>
+
+#include <time.h>
+
+namespace rebelflow {
+
+namespace {
+
+void write_json_string(std::ostream& out, const std::string& s) {
+    out << '"';
+    for (const char c : s) {
+        switch (c) {
+        case '"': out << "\\\""; break;
+        case '\\': out << "\\\\"; break;
+        case '\n': out << "\\n"; break;
+        case '\t': out << "\\t"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof escaped, "\\u%04x", c);
+                out << escaped;
+            } else {
+                out << c;
+            }
+        }
+    }
+    out << '"';
+}
+
+/// Trace timestamps are in microseconds; keep nanosecond resolution.
+void write_us(std::ostream& out, std::chrono::nanoseconds t) {
+    char text[32];
+    std::snprintf(text, sizeof text, "%.3f", static_cast<double>(t.count()) / 1000.0);
+    out << text;
+}
+
+} // namespace
+
+const char* to_string(CacheOutcome outcome) noexcept {
+    switch (outcome) {
+    case CacheOutcome::None: return "none";
+    case CacheOutcome::Hit: return "hit";
+    case CacheOutcome::Miss: return "miss";
+    }
+    return "?";
+}
+
+std::chrono::nanoseconds thread_cpu_time() noexcept {
+    timespec ts{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+}
+
+Profiler::Profiler() : epoch_(std::chrono::steady_clock::now()) {}
+
+std::chrono::nanoseconds Profiler::now() const noexcept {
+    return std::chrono::steady_clock::now() - epoch_;
+}
+
+void Profiler::clear() {
+    std::lock_guard lock(mutex_);
+    nodes_.clear();
+    runs_.clear();
+}
+
+void Profiler::record_run(const RunProfile& run, std::vector<NodeProfile> nodes) {
+    std::sort(nodes.begin(), nodes.end(),
+              [](const NodeProfile& a, const NodeProfile& b) { return a.start < b.start; });
+    std::lock_guard lock(mutex_);
+    runs_.push_back(run);
+    if (nodes_.empty()) {
+        nodes_ = std::move(nodes);
+    } else {
+        // Runs of one executor do not overlap, but several executors may
+        // share a profiler.
+        const auto middle = static_cast<std::ptrdiff_t>(nodes_.size());
+        nodes_.insert(nodes_.end(), std::make_move_iterator(nodes.begin()),
+                      std::make_move_iterator(nodes.end()));
+        std::inplace_merge(nodes_.begin(), nodes_.begin() + middle, nodes_.end(),
+                           [](const NodeProfile& a, const NodeProfile& b) {
+                               return a.start < b.start;
+                           });
+    }
+}
+
+std::vector<NodeProfile> Profiler::nodes() const {
+    std::lock_guard lock(mutex_);
+    return nodes_;
+}
+
+std::vector<RunProfile> Profiler::runs() const {
+    std::lock_guard lock(mutex_);
+    return runs_;
+}
+
+void Profiler::write_chrome_trace(std::ostream& out) const {
+    std::lock_guard lock(mutex_);
+
+    std::set<std::uint32_t> callers;
+    std::set<std::uint32_t> threads;
+    for (const RunProfile& run : runs_) {
+        callers.insert(run.caller_thread);
+        threads.insert(run.caller_thread);
+    }
+    for (const NodeProfile& node : nodes_) {
+        threads.insert(node.thread);
+    }
+
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    out << R"({"name":"process_name","ph":"M","pid":1,"tid":0,"args":{"name":"rebelflow"}})";
+    for (std::uint32_t tid : threads) {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\""
+            << (callers.count(tid) ? "caller" : "worker " + std::to_string(tid)) << "\"}}";
+        out << ",\n{\"name\":\"thread_sort_index\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"sort_index\":" << tid << "}}";
+    }
+    for (const RunProfile& run : runs_) {
+        out << ",\n{\"name\":\"run\",\"cat\":\"run\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+            << run.caller_thread << ",\"ts\":";
+        write_us(out, run.start);
+        out << ",\"dur\":";
+        write_us(out, run.wall);
+        out << ",\"args\":{\"nodes\":" << run.nodes
+            << ",\"failed\":" << (run.failed ? "true" : "false") << "}}";
+    }
+    for (const NodeProfile& node : nodes_) {
+        out << ",\n{\"name\":";
+        write_json_string(out, node.type ? node.type->name : std::string("?"));
+        out << ",\"cat\":\"" << (node.cache == CacheOutcome::Hit ? "cache" : "node")
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << node.thread << ",\"ts\":";
+        write_us(out, node.start);
+        out << ",\"dur\":";
+        write_us(out, node.wall);
+        out << ",\"args\":{\"node\":" << node.node << ",\"cpu_us\":";
+        write_us(out, node.cpu);
+        out << ",\"queue_wait_us\":";
+        write_us(out, node.queue_wait);
+        out << ",\"bytes_allocated\":" << node.bytes_allocated << ",\"cache\":\""
+            << to_string(node.cache) << "\",\"failed\":" << (node.failed ? "true" : "false")
+            << "}}";
+    }
+    out << "\n]}\n";
+}
+
+void Profiler::save_chrome_trace(const std::string& path) const {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw IoError("cannot create '" + path + "': " + std::strerror(errno));
+    }
+    write_chrome_trace(out);
+    out.flush();
+    if (!out) {
+        throw IoError("cannot write '" + path + "'");
+    }
+}
+
+} // namespace rebelflow
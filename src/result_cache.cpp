@@ -0,0 +1,283 @@
+#include "rebelflow/result_cache.hpp"
+
+#include "rebelflow/error.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace rebelflow {
+
+namespace {
+
+constexpr std::uint64_t cache_magic = 0x31454843414346'52ull; // "RFCACHE1"
+constexpr std::uint32_t cache_format = 1;
+constexpr std::uint64_t min_capacity = 64 * 1024;
+
+} // namespace
+
+struct ResultCache::Header {
+    std::uint64_t magic;
+    std::uint32_t format;
+    std::uint32_t slot_count;
+    std::uint64_t file_size;
+    std::uint64_t data_offset;
+    std::uint64_t clock;
+    std::uint64_t reserved[3];
+};
+
+/// One table entry. `offset == 0` marks a free slot; it is written last when
+/// an entry is stored so a torn write never publishes half an entry.
+struct ResultCache::Slot {
+    Digest key;
+    std::uint64_t offset;
+    std::uint64_t size;
+    std::uint64_t last_use;
+};
+
+ResultCache::ResultCache(const std::string& path, std::uint64_t capacity_bytes) {
+    static_assert(sizeof(Header) == 64);
+    if (capacity_bytes < min_capacity) {
+        throw Error("result cache capacity must be at least " + std::to_string(min_capacity) +
+                    " bytes");
+    }
+
+    // The lock is taken before the file is sized or read, so a process asking
+    // for another capacity cannot resize a cache that is in use.
+    bool resized = false;
+    file_ = MappedFile::open_locked(path, capacity_bytes, resized);
+
+    const Header& h = header();
+    if (resized || h.magic != cache_magic || h.format != cache_format ||
+        h.file_size != capacity_bytes) {
+        initialize();
+    }
+    load_index();
+}
+
+ResultCache::~ResultCache() {
+    // Closing the file releases the lock. Write-back is best effort here;
+    // callers that need it to succeed use flush().
+    try {
+        file_.sync();
+    } catch (const IoError&) {
+    }
+}
+
+ResultCache::Header& ResultCache::header() noexcept {
+    return *reinterpret_cast<Header*>(file_.data());
+}
+
+ResultCache::Slot* ResultCache::slots() noexcept {
+    return reinterpret_cast<Slot*>(file_.data() + sizeof(Header));
+}
+
+void ResultCache::initialize() {
+    // Roughly one slot per 2 KiB of capacity: slot overhead stays near 2%.
+    const std::uint64_t capacity = file_.size();
+    const auto slot_count = static_cast<std::uint32_t>(
+        std::clamp<std::uint64_t>(capacity / 2048, 16, std::uint64_t{1} << 22));
+    const std::uint64_t table_end = sizeof(Header) + std::uint64_t{slot_count} * sizeof(Slot);
+
+    std::memset(file_.data(), 0, table_end);
+    Header& h = header();
+    h.magic = cache_magic;
+    h.format = cache_format;
+    h.slot_count = slot_count;
+    h.file_size = capacity;
+    h.data_offset = (table_end + 63) & ~std::uint64_t{63};
+    h.clock = 0;
+}
+
+void ResultCache::load_index() {
+    index_.clear();
+    extents_.clear();
+    lru_.clear();
+    free_slots_.clear();
+    bytes_used_ = 0;
+
+    // A table or data area that does not fit the file can only be damage; it
+    // is treated like a bad magic number.
+    const std::uint64_t end = file_.size();
+    const auto table_fits = [&] {
+        const Header& h = header();
+        const std::uint64_t table_end = sizeof(Header) + std::uint64_t{h.slot_count} * sizeof(Slot);
+        return table_end <= h.data_offset && h.data_offset <= end;
+    };
+    if (!table_fits()) {
+        initialize();
+    }
+
+    Header& h = header();
+    data_begin_ = h.data_offset;
+    Slot* table = slots();
+    for (std::uint32_t i = h.slot_count; i-- > 0;) {
+        Slot& s = table[i];
+        const bool in_range = s.offset >= data_begin_ && s.size <= end &&
+                              s.offset <= end - s.size;
+        if (s.offset == 0 || !in_range || index_.count(s.key) != 0) {
+            s.offset = 0;
+            free_slots_.push_back(i);
+            continue;
+        }
+        // Drop entries that overlap a neighbour; they can only come from a
+        // crash in the middle of compaction.
+        auto next = extents_.lower_bound(s.offset);
+        const bool overlaps =
+            (next != extents_.end() && next->first < s.offset + s.size) ||
+            (next != extents_.begin() &&
+             std::prev(next)->first + table[std::prev(next)->second].size > s.offset);
+        if (overlaps) {
+            s.offset = 0;
+            free_slots_.push_back(i);
+            continue;
+        }
+        index_.emplace(s.key, i);
+        extents_.emplace(s.offset, i);
+        lru_.emplace(s.last_use, i);
+        bytes_used_ += s.size;
+    }
+}
+
+void ResultCache::touch(std::uint32_t slot) {
+    Slot& s = slots()[slot];
+    lru_.erase({s.last_use, slot});
+    s.last_use = ++header().clock;
+    lru_.emplace(s.last_use, slot);
+}
+
+void ResultCache::release(std::uint32_t slot) {
+    Slot& s = slots()[slot];
+    index_.erase(s.key);
+    extents_.erase(s.offset);
+    lru_.erase({s.last_use, slot});
+    bytes_used_ -= s.size;
+    s.offset = 0;
+    free_slots_.push_back(slot);
+}
+
+void ResultCache::evict_lru() {
+    release(lru_.begin()->second);
+    ++stats_.evictions;
+}
+
+bool ResultCache::find_gap(std::uint64_t size, std::uint64_t& offset) const {
+    const Slot* table = const_cast<ResultCache*>(this)->slots();
+    const std::uint64_t end = file_.size();
+
+    // Fast path: append after the last entry.
+    std::uint64_t tail = data_begin_;
+    if (!extents_.empty()) {
+        const auto& [last_offset, last_slot] = *extents_.rbegin();
+        tail = last_offset + table[last_slot].size;
+    }
+    if (end - tail >= size) {
+        offset = tail;
+        return true;
+    }
+
+    std::uint64_t cursor = data_begin_;
+    for (const auto& [entry_offset, slot] : extents_) {
+        if (entry_offset - cursor >= size) {
+            offset = cursor;
+            return true;
+        }
+        cursor = entry_offset + table[slot].size;
+    }
+    return false;
+}
+
+void ResultCache::compact() {
+    Slot* table = slots();
+    std::uint64_t cursor = data_begin_;
+    std::map<std::uint64_t, std::uint32_t> moved;
+    for (const auto& [offset, slot] : extents_) {
+        Slot& s = table[slot];
+        if (offset != cursor) {
+            std::memmove(file_.data() + cursor, file_.data() + offset, s.size);
+            s.offset = cursor;
+        }
+        moved.emplace(cursor, slot);
+        cursor += s.size;
+    }
+    extents_ = std::move(moved);
+}
+
+bool ResultCache::get(const Digest& key, std::vector<std::byte>& out) {
+    std::lock_guard lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return false;
+    }
+    const Slot& s = slots()[it->second];
+    out.assign(file_.data() + s.offset, file_.data() + s.offset + s.size);
+    touch(it->second);
+    ++stats_.hits;
+    return true;
+}
+
+bool ResultCache::contains(const Digest& key) const {
+    std::lock_guard lock(mutex_);
+    return index_.count(key) != 0;
+}
+
+void ResultCache::put(const Digest& key, std::span<const std::byte> data) {
+    std::lock_guard lock(mutex_);
+    if (auto it = index_.find(key); it != index_.end()) {
+        touch(it->second);
+        return;
+    }
+    const std::uint64_t size = data.size();
+    const std::uint64_t region = file_.size() - data_begin_;
+    if (size == 0 || size > region / 2) {
+        return;
+    }
+
+    if (free_slots_.empty()) {
+        evict_lru();
+    }
+    std::uint64_t offset = 0;
+    while (!find_gap(size, offset)) {
+        if (region - bytes_used_ < size) {
+            evict_lru();
+        } else {
+            compact();
+        }
+    }
+
+    const std::uint32_t slot = free_slots_.back();
+    free_slots_.pop_back();
+    std::memcpy(file_.data() + offset, data.data(), size);
+    Slot& s = slots()[slot];
+    s.key = key;
+    s.size = size;
+    s.last_use = ++header().clock;
+    s.offset = offset;
+
+    index_.emplace(key, slot);
+    extents_.emplace(offset, slot);
+    lru_.emplace(s.last_use, slot);
+    bytes_used_ += size;
+    ++stats_.insertions;
+}
+
+void ResultCache::clear() {
+    std::lock_guard lock(mutex_);
+    initialize();
+    load_index();
+}
+
+void ResultCache::flush() {
+    std::lock_guard lock(mutex_);
+    file_.sync(true);
+}
+
+ResultCacheStats ResultCache::stats() const {
+    std::lock_guard lock(mutex_);
+    ResultCacheStats out = stats_;
+    out.entries = index_.size();
+    out.bytes_used = bytes_used_;
+    return out;
+}
+
+} // namespace rebelflow
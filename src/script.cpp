@@ -0,0 +1,1376 @@
+#include "rebelflow/script.hpp"
+
+#include "rebelflow/error.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <mutex>
+#include <numbers>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Source: tokens and syntax tree
+
+enum class Tok : std::uint8_t {
+    End, Newline, Number, Name,
+    Plus, Minus, Star, Slash, Percent, Caret,
+    LParen, RParen, Comma, Dot, Question, Colon, Semicolon,
+    Assign, Eq, Ne, Lt, Le, Gt, Ge, AndAnd, OrOr, Bang,
+};
+
+struct Token {
+    Tok kind = Tok::End;
+    std::string_view text;
+    double number = 0.0;
+    std::uint32_t line = 1;
+    std::uint32_t column = 1;
+};
+
+/// Line 0 marks nodes that have no source position, e.g. folded-in constants.
+[[noreturn]] void fail_at(std::uint32_t line, std::uint32_t column, const std::string& what,
+                          std::size_t part = 0) {
+    if (line == 0) {
+        throw ScriptError(what, part);
+    }
+    throw ScriptError("line " + std::to_string(line) + ", column " + std::to_string(column) +
+                          ": " + what,
+                      part);
+}
+
+bool is_name_start(char c) noexcept {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+bool is_digit(char c) noexcept { return c >= '0' && c <= '9'; }
+
+/// A newline after one of these continues the statement.
+bool continues_line(Tok kind) noexcept {
+    switch (kind) {
+    case Tok::Number:
+    case Tok::Name:
+    case Tok::RParen: return false;
+    default: return true;
+    }
+}
+
+std::vector<Token> tokenize(std::string_view src) {
+    std::vector<Token> tokens;
+    std::uint32_t line = 1;
+    std::size_t line_start = 0;
+    int depth = 0;
+    std::size_t i = 0;
+    auto push = [&](Tok kind, std::size_t begin, std::size_t length) {
+        Token t;
+        t.kind = kind;
+        t.text = src.substr(begin, length);
+        t.line = line;
+        t.column = static_cast<std::uint32_t>(begin - line_start + 1);
+        tokens.push_back(t);
+    };
+    while (i < src.size()) {
+        const char c = src[i];
+        const char next = i + 1 < src.size() ? src[i + 1] : '\0';
+        if (c == '\n') {
+            if (depth == 0 && !tokens.empty() && !continues_line(tokens.back().kind)) {
+                push(Tok::Newline, i, 1);
+            }
+            ++i;
+            ++line;
+            line_start = i;
+            continue;
+        }
+        if (c == ' ' || c == '\t' || c == '\r') {
+            ++i;
+            continue;
+        }
+        if (c == '/' && next == '/') {
+            while (i < src.size() && src[i] != '\n') {
+                ++i;
+            }
+            continue;
+        }
+        if (is_digit(c) || (c == '.' && is_digit(next))) {
+            const std::size_t begin = i;
+            while (i < src.size() && (is_digit(src[i]) || src[i] == '.')) {
+                ++i;
+            }
+            if (i < src.size() && (src[i] == 'e' || src[i] == 'E')) {
+                ++i;
+                if (i < src.size() && (src[i] == '+' || src[i] == '-')) {
+                    ++i;
+                }
+                while (i < src.size() && is_digit(src[i])) {
+                    ++i;
+                }
+            }
+            push(Tok::Number, begin, i - begin);
+            Token& t = tokens.back();
+            const auto [end, ec] = std::from_chars(t.text.data(), t.text.data() + t.text.size(),
+                                                   t.number);
+            if (ec != std::errc() || end != t.text.data() + t.text.size()) {
+                fail_at(t.line, t.column, "malformed number '" + std::string(t.text) + "'");
+            }
+            continue;
+        }
+        if (is_name_start(c)) {
+            const std::size_t begin = i;
+            while (i < src.size() && (is_name_start(src[i]) || is_digit(src[i]))) {
+                ++i;
+            }
+            push(Tok::Name, begin, i - begin);
+            continue;
+        }
+
+        Tok kind = Tok::End;
+        std::size_t length = 1;
+        switch (c) {
+        case '+': kind = Tok::Plus; break;
+        case '-': kind = Tok::Minus; break;
+        case '*': kind = Tok::Star; break;
+        case '/': kind = Tok::Slash; break;
+        case '%': kind = Tok::Percent; break;
+        case '^': kind = Tok::Caret; break;
+        case '(': kind = Tok::LParen; ++depth; break;
+        case ')': kind = Tok::RParen; depth = std::max(depth - 1, 0); break;
+        case ',': kind = Tok::Comma; break;
+        case '.': kind = Tok::Dot; break;
+        case '?': kind = Tok::Question; break;
+        case ':': kind = Tok::Colon; break;
+        case ';': kind = Tok::Semicolon; break;
+        case '=':
+            kind = next == '=' ? Tok::Eq : Tok::Assign;
+            length = next == '=' ? 2 : 1;
+            break;
+        case '!':
+            kind = next == '=' ? Tok::Ne : Tok::Bang;
+            length = next == '=' ? 2 : 1;
+            break;
+        case '<':
+            kind = next == '=' ? Tok::Le : Tok::Lt;
+            length = next == '=' ? 2 : 1;
+            break;
+        case '>':
+            kind = next == '=' ? Tok::Ge : Tok::Gt;
+            length = next == '=' ? 2 : 1;
+            break;
+        case '&':
+            if (next == '&') {
+                kind = Tok::AndAnd;
+                length = 2;
+            }
+            break;
+        case '|':
+            if (next == '|') {
+                kind = Tok::OrOr;
+                length = 2;
+            }
+            break;
+        default: break;
+        }
+        if (kind == Tok::End) {
+            fail_at(line, static_cast<std::uint32_t>(i - line_start + 1),
+                    std::string("unexpected character '") + c + "'");
+        }
+        push(kind, i, length);
+        i += length;
+    }
+    push(Tok::End, src.size(), 0);
+    return tokens;
+}
+
+enum class Fn : std::uint8_t {
+    Abs, Sqrt, Exp, Log, Sin, Cos, Tan, Asin, Acos, Atan, Floor, Ceil, Round,
+    Atan2, Pow, Min, Max, Clamp, Lerp, Vec, Dot, Cross, Length, Normalize,
+};
+
+struct FnInfo {
+    std::string_view name;
+    Fn fn;
+    std::uint8_t arity;
+};
+
+constexpr std::array<FnInfo, 24> functions = {{
+    {"abs", Fn::Abs, 1},     {"sqrt", Fn::Sqrt, 1},   {"exp", Fn::Exp, 1},
+    {"log", Fn::Log, 1},     {"sin", Fn::Sin, 1},     {"cos", Fn::Cos, 1},
+    {"tan", Fn::Tan, 1},     {"asin", Fn::Asin, 1},   {"acos", Fn::Acos, 1},
+    {"atan", Fn::Atan, 1},   {"floor", Fn::Floor, 1}, {"ceil", Fn::Ceil, 1},
+    {"round", Fn::Round, 1}, {"atan2", Fn::Atan2, 2}, {"pow", Fn::Pow, 2},
+    {"min", Fn::Min, 2},     {"max", Fn::Max, 2},     {"clamp", Fn::Clamp, 3},
+    {"lerp", Fn::Lerp, 3},   {"vec", Fn::Vec, 3},     {"dot", Fn::Dot, 2},
+    {"cross", Fn::Cross, 2}, {"length", Fn::Length, 1}, {"normalize", Fn::Normalize, 1},
+}};
+
+enum class Kind : std::uint8_t { Number, Input, Unary, Binary, Ternary, Call, Member };
+
+/// IR node. Assigned names refer to the node of their expression, and equal
+/// expressions are the same node (see IrBuilder), so the tree is a DAG and
+/// shared subexpressions are generated once.
+struct Node {
+    Kind kind = Kind::Number;
+    Tok op = Tok::End;    // Unary, Binary
+    Fn fn = Fn::Abs;      // Call
+    std::uint8_t arg_count = 0;
+    std::uint32_t args[3] = {0, 0, 0}; // operand nodes; Input: index; Member: component
+    double number = 0.0;
+    std::uint32_t line = 0;
+    std::uint32_t column = 0;
+    std::uint32_t part = 0; // Script::fuse(): the script the node came from
+};
+
+std::string_view function_name(Fn fn) noexcept {
+    for (const FnInfo& f : functions) {
+        if (f.fn == fn) {
+            return f.name;
+        }
+    }
+    return "?";
+}
+
+// ---------------------------------------------------------------------------
+// Bytecode
+
+struct Vec3 {
+    double x, y, z;
+};
+
+/// Opcodes. Registers live in two banks: numbers (N) and vectors (V); the
+/// comment gives the bank of dst <- a, b, c.
+enum class Op : std::uint8_t {
+    Add, Sub, Mul, Div, Mod, Pow,       // N <- N, N
+    Lt, Le, Gt, Ge, Eq, Ne, And, Or,    // N <- N, N; 1 or 0
+    Neg, Not,                           // N <- N
+    Abs, Sqrt, Exp, Log, Sin, Cos, Tan, // N <- N
+    Asin, Acos, Atan, Floor, Ceil, Round,
+    Atan2, Min, Max,                    // N <- N, N
+    Clamp, Lerp, Select,                // N <- N, N, N
+    VAdd, VSub, VMul, VDiv, VMin, VMax, // V <- V, V (componentwise)
+    VScale, VDivScalar,                 // V <- V, N
+    VNeg, VNormalize,                   // V <- V
+    VCross,                             // V <- V, V
+    VLerp,                              // V <- V, V, N
+    VSelect,                            // V <- N, V, V
+    VMake,                              // V <- N, N, N
+    VDot,                               // N <- V, V
+    VLength,                            // N <- V
+    VGet,                               // N <- V; b is the component
+};
+
+constexpr const char* op_names[] = {
+    "add", "sub", "mul", "div", "mod", "pow", "lt", "le", "gt", "ge", "eq", "ne", "and", "or",
+    "neg", "not", "abs", "sqrt", "exp", "log", "sin", "cos", "tan", "asin", "acos", "atan",
+    "floor", "ceil", "round", "atan2", "min", "max", "clamp", "lerp", "select",
+    "vadd", "vsub", "vmul", "vdiv", "vmin", "vmax", "vscale", "vdivs", "vneg", "vnormalize",
+    "vcross", "vlerp", "vselect", "vmake", "vdot", "vlength", "vget",
+};
+static_assert(std::size(op_names) == static_cast<std::size_t>(Op::VGet) + 1);
+
+struct Instr {
+    Op op;
+    std::uint16_t dst, a, b, c;
+};
+
+struct Reg {
+    bool vec = false;
+    std::uint16_t index = 0;
+};
+
+/// One typed specialization of a script.
+struct Chunk {
+    std::vector<Instr> code;
+    /// Preloaded into number registers 0 .. constants.size() - 1.
+    std::vector<double> constants;
+    /// Input index -> register, per bank.
+    std::vector<std::pair<std::uint16_t, std::uint16_t>> num_loads;
+    std::vector<std::pair<std::uint16_t, std::uint16_t>> vec_loads;
+    std::uint32_t num_registers = 0;
+    std::uint32_t vec_registers = 0;
+    std::vector<Reg> results;
+};
+
+double truth(bool b) noexcept { return b ? 1.0 : 0.0; }
+
+Vec3 normalize(const Vec3& v) noexcept {
+    const double len = std::sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+    if (len == 0.0) {
+        return {0.0, 0.0, 0.0};
+    }
+    return {v.x / len, v.y / len, v.z / len};
+}
+
+/// The interpreter loop: straight-line code over unboxed registers.
+void execute(std::span<const Instr> code, double* n, Vec3* v) noexcept {
+    for (const Instr& i : code) {
+        switch (i.op) {
+        case Op::Add: n[i.dst] = n[i.a] + n[i.b]; break;
+        case Op::Sub: n[i.dst] = n[i.a] - n[i.b]; break;
+        case Op::Mul: n[i.dst] = n[i.a] * n[i.b]; break;
+        case Op::Div: n[i.dst] = n[i.a] / n[i.b]; break;
+        case Op::Mod: n[i.dst] = std::fmod(n[i.a], n[i.b]); break;
+        case Op::Pow: n[i.dst] = std::pow(n[i.a], n[i.b]); break;
+        case Op::Lt: n[i.dst] = truth(n[i.a] < n[i.b]); break;
+        case Op::Le: n[i.dst] = truth(n[i.a] <= n[i.b]); break;
+        case Op::Gt: n[i.dst] = truth(n[i.a] > n[i.b]); break;
+        case Op::Ge: n[i.dst] = truth(n[i.a] >= n[i.b]); break;
+        case Op::Eq: n[i.dst] = truth(n[i.a] == n[i.b]); break;
+        case Op::Ne: n[i.dst] = truth(n[i.a] != n[i.b]); break;
+        case Op::And: n[i.dst] = truth(n[i.a] != 0.0 && n[i.b] != 0.0); break;
+        case Op::Or: n[i.dst] = truth(n[i.a] != 0.0 || n[i.b] != 0.0); break;
+        case Op::Neg: n[i.dst] = -n[i.a]; break;
+        case Op::Not: n[i.dst] = truth(n[i.a] == 0.0); break;
+        case Op::Abs: n[i.dst] = std::abs(n[i.a]); break;
+        case Op::Sqrt: n[i.dst] = std::sqrt(n[i.a]); break;
+        case Op::Exp: n[i.dst] = std::exp(n[i.a]); break;
+        case Op::Log: n[i.dst] = std::log(n[i.a]); break;
+        case Op::Sin: n[i.dst] = std::sin(n[i.a]); break;
+        case Op::Cos: n[i.dst] = std::cos(n[i.a]); break;
+        case Op::Tan: n[i.dst] = std::tan(n[i.a]); break;
+        case Op::Asin: n[i.dst] = std::asin(n[i.a]); break;
+        case Op::Acos: n[i.dst] = std::acos(n[i.a]); break;
+        case Op::Atan: n[i.dst] = std::atan(n[i.a]); break;
+        case Op::Floor: n[i.dst] = std::floor(n[i.a]); break;
+        case Op::Ceil: n[i.dst] = std::ceil(n[i.a]); break;
+        case Op::Round: n[i.dst] = std::round(n[i.a]); break;
+        case Op::Atan2: n[i.dst] = std::atan2(n[i.a], n[i.b]); break;
+        case Op::Min: n[i.dst] = std::min(n[i.a], n[i.b]); break;
+        case Op::Max: n[i.dst] = std::max(n[i.a], n[i.b]); break;
+        case Op::Clamp: n[i.dst] = std::min(std::max(n[i.a], n[i.b]), n[i.c]); break;
+        case Op::Lerp: n[i.dst] = n[i.a] + (n[i.b] - n[i.a]) * n[i.c]; break;
+        case Op::Select: n[i.dst] = n[i.a] != 0.0 ? n[i.b] : n[i.c]; break;
+        case Op::VAdd:
+            v[i.dst] = {v[i.a].x + v[i.b].x, v[i.a].y + v[i.b].y, v[i.a].z + v[i.b].z};
+            break;
+        case Op::VSub:
+            v[i.dst] = {v[i.a].x - v[i.b].x, v[i.a].y - v[i.b].y, v[i.a].z - v[i.b].z};
+            break;
+        case Op::VMul:
+            v[i.dst] = {v[i.a].x * v[i.b].x, v[i.a].y * v[i.b].y, v[i.a].z * v[i.b].z};
+            break;
+        case Op::VDiv:
+            v[i.dst] = {v[i.a].x / v[i.b].x, v[i.a].y / v[i.b].y, v[i.a].z / v[i.b].z};
+            break;
+        case Op::VMin:
+            v[i.dst] = {std::min(v[i.a].x, v[i.b].x), std::min(v[i.a].y, v[i.b].y),
+                        std::min(v[i.a].z, v[i.b].z)};
+            break;
+        case Op::VMax:
+            v[i.dst] = {std::max(v[i.a].x, v[i.b].x), std::max(v[i.a].y, v[i.b].y),
+                        std::max(v[i.a].z, v[i.b].z)};
+            break;
+        case Op::VScale:
+            v[i.dst] = {v[i.a].x * n[i.b], v[i.a].y * n[i.b], v[i.a].z * n[i.b]};
+            break;
+        case Op::VDivScalar:
+            v[i.dst] = {v[i.a].x / n[i.b], v[i.a].y / n[i.b], v[i.a].z / n[i.b]};
+            break;
+        case Op::VNeg: v[i.dst] = {-v[i.a].x, -v[i.a].y, -v[i.a].z}; break;
+        case Op::VNormalize: v[i.dst] = normalize(v[i.a]); break;
+        case Op::VCross: {
+            const Vec3 a = v[i.a];
+            const Vec3 b = v[i.b];
+            v[i.dst] = {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+            break;
+        }
+        case Op::VLerp: {
+            const double t = n[i.c];
+            v[i.dst] = {v[i.a].x + (v[i.b].x - v[i.a].x) * t,
+                        v[i.a].y + (v[i.b].y - v[i.a].y) * t,
+                        v[i.a].z + (v[i.b].z - v[i.a].z) * t};
+            break;
+        }
+        case Op::VSelect: v[i.dst] = n[i.a] != 0.0 ? v[i.b] : v[i.c]; break;
+        case Op::VMake: v[i.dst] = {n[i.a], n[i.b], n[i.c]}; break;
+        case Op::VDot:
+            n[i.dst] = v[i.a].x * v[i.b].x + v[i.a].y * v[i.b].y + v[i.a].z * v[i.b].z;
+            break;
+        case Op::VLength:
+            n[i.dst] = std::sqrt(v[i.a].x * v[i.a].x + v[i.a].y * v[i.a].y +
+                                 v[i.a].z * v[i.a].z);
+            break;
+        case Op::VGet: {
+            const Vec3& a = v[i.a];
+            n[i.dst] = i.b == 0 ? a.x : i.b == 1 ? a.y : a.z;
+            break;
+        }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// IR: the syntax tree, hash-consed and folded as it is built
+
+/// The number opcode for `node` when every operand is a number; none for
+/// operations that only exist on vectors.
+std::optional<Op> numeric_op(const Node& node) noexcept {
+    switch (node.kind) {
+    case Kind::Unary: return node.op == Tok::Minus ? Op::Neg : Op::Not;
+    case Kind::Ternary: return Op::Select;
+    case Kind::Binary:
+        switch (node.op) {
+        case Tok::Plus: return Op::Add;
+        case Tok::Minus: return Op::Sub;
+        case Tok::Star: return Op::Mul;
+        case Tok::Slash: return Op::Div;
+        case Tok::Percent: return Op::Mod;
+        case Tok::Lt: return Op::Lt;
+        case Tok::Le: return Op::Le;
+        case Tok::Gt: return Op::Gt;
+        case Tok::Ge: return Op::Ge;
+        case Tok::Eq: return Op::Eq;
+        case Tok::Ne: return Op::Ne;
+        case Tok::AndAnd: return Op::And;
+        case Tok::OrOr: return Op::Or;
+        default: return std::nullopt;
+        }
+    case Kind::Call:
+        switch (node.fn) {
+        case Fn::Abs: return Op::Abs;
+        case Fn::Sqrt: return Op::Sqrt;
+        case Fn::Exp: return Op::Exp;
+        case Fn::Log: return Op::Log;
+        case Fn::Sin: return Op::Sin;
+        case Fn::Cos: return Op::Cos;
+        case Fn::Tan: return Op::Tan;
+        case Fn::Asin: return Op::Asin;
+        case Fn::Acos: return Op::Acos;
+        case Fn::Atan: return Op::Atan;
+        case Fn::Floor: return Op::Floor;
+        case Fn::Ceil: return Op::Ceil;
+        case Fn::Round: return Op::Round;
+        case Fn::Atan2: return Op::Atan2;
+        case Fn::Pow: return Op::Pow;
+        case Fn::Min: return Op::Min;
+        case Fn::Max: return Op::Max;
+        case Fn::Clamp: return Op::Clamp;
+        case Fn::Lerp: return Op::Lerp;
+        default: return std::nullopt;
+        }
+    default: return std::nullopt;
+    }
+}
+
+bool is_commutative(const Node& node) noexcept {
+    if (node.kind == Kind::Binary) {
+        switch (node.op) {
+        case Tok::Plus:
+        case Tok::Star:
+        case Tok::Eq:
+        case Tok::Ne:
+        case Tok::AndAnd:
+        case Tok::OrOr: return true;
+        default: return false;
+        }
+    }
+    return node.kind == Kind::Call &&
+           (node.fn == Fn::Min || node.fn == Fn::Max || node.fn == Fn::Dot);
+}
+
+/// Owns the IR nodes. intern() folds operations whose operands are all
+/// constants and returns the existing node for an expression already built,
+/// with commutative operands put in a canonical order first, so equal
+/// subexpressions share one node wherever they were written. Operands always
+/// precede their users in the node list.
+class IrBuilder {
+public:
+    std::uint32_t intern(Node node) {
+        const auto is_number = [&](std::uint32_t id) { return nodes_[id].kind == Kind::Number; };
+        if (node.kind == Kind::Ternary && is_number(node.args[0])) {
+            return nodes_[node.args[0]].number != 0.0 ? node.args[1] : node.args[2];
+        }
+        if (node.kind == Kind::Member) {
+            const Node& v = nodes_[node.args[0]];
+            if (v.kind == Kind::Call && v.fn == Fn::Vec) {
+                return v.args[node.args[1]];
+            }
+        }
+        if (node.kind != Kind::Number && node.kind != Kind::Input && node.kind != Kind::Member &&
+            std::all_of(node.args, node.args + node.arg_count, is_number)) {
+            if (const std::optional<Op> code = numeric_op(node)) {
+                double n[4] = {0.0, 0.0, 0.0, 0.0};
+                for (std::uint8_t i = 0; i < node.arg_count; ++i) {
+                    n[i] = nodes_[node.args[i]].number;
+                }
+                const Instr instr{*code, 3, 0, 1, 2};
+                execute({&instr, 1}, n, nullptr);
+                Node folded;
+                folded.number = n[3];
+                folded.line = node.line;
+                folded.column = node.column;
+                folded.part = node.part;
+                node = folded;
+            }
+        }
+        if (is_commutative(node) && node.args[0] > node.args[1]) {
+            std::swap(node.args[0], node.args[1]);
+        }
+
+        const Key key = key_of(node);
+        if (auto it = index_.find(key); it != index_.end()) {
+            return it->second;
+        }
+        const auto id = static_cast<std::uint32_t>(nodes_.size());
+        nodes_.push_back(node);
+        index_.emplace(key, id);
+        return id;
+    }
+
+    const Node& node(std::uint32_t id) const { return nodes_[id]; }
+    std::vector<Node> take() { return std::move(nodes_); }
+
+private:
+    using Key = std::array<std::uint64_t, 4>;
+
+    struct KeyHash {
+        std::size_t operator()(const Key& k) const noexcept {
+            std::uint64_t h = 0;
+            for (std::uint64_t v : k) {
+                h = (h ^ v) * 0x9e3779b97f4a7c15ull;
+                h ^= h >> 29;
+            }
+            return static_cast<std::size_t>(h);
+        }
+    };
+
+    static Key key_of(const Node& node) noexcept {
+        return {static_cast<std::uint64_t>(node.kind) |
+                    static_cast<std::uint64_t>(node.op) << 8 |
+                    static_cast<std::uint64_t>(node.fn) << 16 |
+                    static_cast<std::uint64_t>(node.arg_count) << 24,
+                node.args[0] | static_cast<std::uint64_t>(node.args[1]) << 32, node.args[2],
+                std::bit_cast<std::uint64_t>(node.number)};
+    }
+
+    std::vector<Node> nodes_;
+    std::unordered_map<Key, std::uint32_t, KeyHash> index_;
+};
+
+class Parser {
+public:
+    Parser(std::vector<Token> tokens, const std::vector<std::string>& inputs, IrBuilder& ir)
+        : tokens_(std::move(tokens)), inputs_(inputs), ir_(ir) {}
+
+    /// Parses every statement; returns the node of the result.
+    std::uint32_t parse_script() {
+        std::optional<std::uint32_t> result;
+        while (true) {
+            while (peek().kind == Tok::Newline || peek().kind == Tok::Semicolon) {
+                ++pos_;
+            }
+            if (peek().kind == Tok::End) {
+                break;
+            }
+            result = statement();
+            const Token& t = peek();
+            if (t.kind != Tok::Newline && t.kind != Tok::Semicolon && t.kind != Tok::End) {
+                unexpected(t);
+            }
+        }
+        if (!result) {
+            throw ScriptError("script is empty");
+        }
+        return *result;
+    }
+
+private:
+    const Token& peek(std::size_t ahead = 0) const {
+        return tokens_[std::min(pos_ + ahead, tokens_.size() - 1)];
+    }
+    const Token& advance() { return tokens_[pos_++]; }
+    bool accept(Tok kind) {
+        if (peek().kind != kind) {
+            return false;
+        }
+        ++pos_;
+        return true;
+    }
+    void expect(Tok kind, const char* what) {
+        if (!accept(kind)) {
+            const Token& t = peek();
+            fail_at(t.line, t.column, std::string("expected ") + what);
+        }
+    }
+    [[noreturn]] void unexpected(const Token& t) const {
+        fail_at(t.line, t.column,
+                t.kind == Tok::End ? std::string("unexpected end of script")
+                                   : "unexpected '" + std::string(t.text) + "'");
+    }
+
+    std::uint32_t add(Node node, const Token& at) {
+        node.line = at.line;
+        node.column = at.column;
+        return ir_.intern(node);
+    }
+
+    std::uint32_t statement() {
+        if (peek().kind == Tok::Name && peek().text == "let") {
+            ++pos_;
+            if (peek().kind != Tok::Name) {
+                unexpected(peek());
+            }
+        }
+        if (peek().kind == Tok::Name && peek(1).kind == Tok::Assign) {
+            const std::string name(advance().text);
+            ++pos_;
+            const std::uint32_t value = expression();
+            locals_[name] = value;
+            return value;
+        }
+        return expression();
+    }
+
+    std::uint32_t expression() {
+        const std::uint32_t cond = binary(0);
+        if (peek().kind != Tok::Question) {
+            return cond;
+        }
+        const Token& at = advance();
+        const std::uint32_t yes = expression();
+        expect(Tok::Colon, "':'");
+        const std::uint32_t no = expression();
+        Node node;
+        node.kind = Kind::Ternary;
+        node.arg_count = 3;
+        node.args[0] = cond;
+        node.args[1] = yes;
+        node.args[2] = no;
+        return add(node, at);
+    }
+
+    /// Binding power of a left-associative binary operator; 0 if `kind` is none.
+    static int precedence(Tok kind) noexcept {
+        switch (kind) {
+        case Tok::OrOr: return 1;
+        case Tok::AndAnd: return 2;
+        case Tok::Eq:
+        case Tok::Ne: return 3;
+        case Tok::Lt:
+        case Tok::Le:
+        case Tok::Gt:
+        case Tok::Ge: return 4;
+        case Tok::Plus:
+        case Tok::Minus: return 5;
+        case Tok::Star:
+        case Tok::Slash:
+        case Tok::Percent: return 6;
+        default: return 0;
+        }
+    }
+
+    std::uint32_t binary(int min_precedence) {
+        std::uint32_t lhs = unary();
+        while (true) {
+            const int p = precedence(peek().kind);
+            if (p == 0 || p <= min_precedence) {
+                return lhs;
+            }
+            const Token& at = advance();
+            const std::uint32_t rhs = binary(p);
+            Node node;
+            node.kind = Kind::Binary;
+            node.op = at.kind;
+            node.arg_count = 2;
+            node.args[0] = lhs;
+            node.args[1] = rhs;
+            lhs = add(node, at);
+        }
+    }
+
+    std::uint32_t unary() {
+        if (peek().kind == Tok::Minus || peek().kind == Tok::Bang) {
+            const Token& at = advance();
+            const std::uint32_t operand = unary();
+            Node node;
+            node.kind = Kind::Unary;
+            node.op = at.kind;
+            node.arg_count = 1;
+            node.args[0] = operand;
+            return add(node, at);
+        }
+        if (peek().kind == Tok::Plus) {
+            ++pos_;
+            return unary();
+        }
+        return power();
+    }
+
+    std::uint32_t power() {
+        const std::uint32_t base = postfix();
+        if (peek().kind != Tok::Caret) {
+            return base;
+        }
+        const Token& at = advance();
+        const std::uint32_t exponent = unary(); // right-associative
+        Node node;
+        node.kind = Kind::Call;
+        node.fn = Fn::Pow;
+        node.arg_count = 2;
+        node.args[0] = base;
+        node.args[1] = exponent;
+        return add(node, at);
+    }
+
+    std::uint32_t postfix() {
+        std::uint32_t value = primary();
+        while (peek().kind == Tok::Dot) {
+            const Token& at = advance();
+            const Token& field = peek();
+            std::uint32_t component = 3;
+            if (field.kind == Tok::Name && field.text.size() == 1) {
+                component = field.text[0] == 'x' ? 0 : field.text[0] == 'y' ? 1
+                                                     : field.text[0] == 'z' ? 2 : 3;
+            }
+            if (component == 3) {
+                fail_at(field.line, field.column, "expected x, y or z after '.'");
+            }
+            ++pos_;
+            Node node;
+            node.kind = Kind::Member;
+            node.arg_count = 1;
+            node.args[0] = value;
+            node.args[1] = component;
+            value = add(node, at);
+        }
+        return value;
+    }
+
+    std::uint32_t number(double v, const Token& at) {
+        Node node;
+        node.kind = Kind::Number;
+        node.number = v;
+        return add(node, at);
+    }
+
+    std::uint32_t primary() {
+        const Token& t = advance();
+        switch (t.kind) {
+        case Tok::Number: return number(t.number, t);
+        case Tok::LParen: {
+            const std::uint32_t inner = expression();
+            expect(Tok::RParen, "')'");
+            return inner;
+        }
+        case Tok::Name: break;
+        default: unexpected(t);
+        }
+
+        if (peek().kind == Tok::LParen) {
+            return call(t);
+        }
+        const std::string name(t.text);
+        if (auto it = locals_.find(name); it != locals_.end()) {
+            return it->second;
+        }
+        for (std::size_t i = 0; i < inputs_.size(); ++i) {
+            if (inputs_[i] == name) {
+                Node node;
+                node.kind = Kind::Input;
+                node.args[0] = static_cast<std::uint32_t>(i);
+                return add(node, t);
+            }
+        }
+        if (name == "pi") {
+            return number(std::numbers::pi, t);
+        }
+        if (name == "true" || name == "false") {
+            return number(name == "true" ? 1.0 : 0.0, t);
+        }
+        fail_at(t.line, t.column, "unknown name '" + name + "'");
+    }
+
+    std::uint32_t call(const Token& name) {
+        const FnInfo* info = nullptr;
+        for (const FnInfo& f : functions) {
+            if (f.name == name.text) {
+                info = &f;
+            }
+        }
+        if (info == nullptr) {
+            fail_at(name.line, name.column, "unknown function '" + std::string(name.text) + "'");
+        }
+        expect(Tok::LParen, "'('");
+        Node node;
+        node.kind = Kind::Call;
+        node.fn = info->fn;
+        if (peek().kind != Tok::RParen) {
+            do {
+                if (node.arg_count == info->arity) {
+                    node.arg_count = 4; // reported below
+                    break;
+                }
+                node.args[node.arg_count++] = expression();
+            } while (accept(Tok::Comma));
+        }
+        if (node.arg_count != info->arity) {
+            fail_at(name.line, name.column,
+                    std::string(info->name) + " takes " + std::to_string(info->arity) +
+                        (info->arity == 1 ? " argument" : " arguments"));
+        }
+        expect(Tok::RParen, "')'");
+        return add(node, name);
+    }
+
+    std::vector<Token> tokens_;
+    std::size_t pos_ = 0;
+    const std::vector<std::string>& inputs_;
+    IrBuilder& ir_;
+    std::unordered_map<std::string, std::uint32_t> locals_;
+};
+
+const char* kind_name(bool vec) noexcept { return vec ? "a vector" : "a number"; }
+
+const char* operator_text(Tok op) noexcept {
+    switch (op) {
+    case Tok::Plus: return "+";
+    case Tok::Minus: return "-";
+    case Tok::Star: return "*";
+    case Tok::Slash: return "/";
+    case Tok::Percent: return "%";
+    case Tok::Eq: return "==";
+    case Tok::Ne: return "!=";
+    case Tok::Lt: return "<";
+    case Tok::Le: return "<=";
+    case Tok::Gt: return ">";
+    case Tok::Ge: return ">=";
+    case Tok::AndAnd: return "&&";
+    case Tok::OrOr: return "||";
+    case Tok::Bang: return "!";
+    default: return "?";
+    }
+}
+
+/// Type-checks the tree for one input signature and emits its bytecode.
+class Generator {
+public:
+    Generator(const std::vector<Node>& nodes, unsigned vector_inputs)
+        : nodes_(nodes), vector_inputs_(vector_inputs), memo_(nodes.size()) {}
+
+    Chunk generate(std::span<const std::uint32_t> results) {
+        // Constants, then inputs, take the lowest registers so a run can load
+        // them with plain copies. Both are unique nodes in the IR.
+        std::vector<std::uint8_t> seen(nodes_.size(), 0);
+        std::vector<std::uint32_t> leaves;
+        for (std::uint32_t result : results) {
+            collect_leaves(result, seen, leaves);
+        }
+        for (std::uint32_t id : leaves) {
+            if (nodes_[id].kind == Kind::Number) {
+                memo_[id] = new_register(false);
+                chunk_.constants.push_back(nodes_[id].number);
+            }
+        }
+        for (std::uint32_t id : leaves) {
+            if (nodes_[id].kind == Kind::Input) {
+                const std::uint32_t input = nodes_[id].args[0];
+                const bool vec = ((vector_inputs_ >> input) & 1u) != 0;
+                memo_[id] = new_register(vec);
+                (vec ? chunk_.vec_loads : chunk_.num_loads)
+                    .emplace_back(static_cast<std::uint16_t>(input), memo_[id]->index);
+            }
+        }
+        for (std::uint32_t result : results) {
+            chunk_.results.push_back(emit(result));
+        }
+        chunk_.num_registers = next_num_;
+        chunk_.vec_registers = next_vec_;
+        return std::move(chunk_);
+    }
+
+private:
+    void collect_leaves(std::uint32_t id, std::vector<std::uint8_t>& seen,
+                        std::vector<std::uint32_t>& leaves) {
+        if (seen[id]) {
+            return;
+        }
+        seen[id] = 1;
+        const Node& node = nodes_[id];
+        if (node.kind == Kind::Number || node.kind == Kind::Input) {
+            leaves.push_back(id);
+            return;
+        }
+        for (std::uint8_t i = 0; i < node.arg_count; ++i) {
+            collect_leaves(node.args[i], seen, leaves);
+        }
+    }
+
+    Reg new_register(bool vec) {
+        std::uint32_t& next = vec ? next_vec_ : next_num_;
+        if (next > 0xffff) {
+            throw ScriptError("script needs too many registers");
+        }
+        return {vec, static_cast<std::uint16_t>(next++)};
+    }
+
+    [[noreturn]] void fail(const Node& node, const std::string& what) const {
+        fail_at(node.line, node.column, what, node.part);
+    }
+
+    Reg op(Op code, bool vec_result, Reg a, Reg b = {}, Reg c = {}) {
+        const Reg dst = new_register(vec_result);
+        chunk_.code.push_back({code, dst.index, a.index, b.index, c.index});
+        return dst;
+    }
+
+    void require_numbers(const Node& node, std::initializer_list<Reg> regs, const char* what) {
+        for (const Reg& r : regs) {
+            if (r.vec) {
+                fail(node, std::string(what) + " needs numbers, got a vector");
+            }
+        }
+    }
+
+    void require_vectors(const Node& node, std::initializer_list<Reg> regs, const char* what) {
+        for (const Reg& r : regs) {
+            if (!r.vec) {
+                fail(node, std::string(what) + " needs vectors, got a number");
+            }
+        }
+    }
+
+    Reg emit(std::uint32_t id) {
+        if (memo_[id]) {
+            return *memo_[id];
+        }
+        const Node& node = nodes_[id];
+        Reg args[3];
+        for (std::uint8_t i = 0; i < node.arg_count; ++i) {
+            args[i] = emit(node.args[i]);
+        }
+        const Reg r = emit_node(node, args);
+        memo_[id] = r;
+        return r;
+    }
+
+    Reg emit_node(const Node& node, const Reg* args) {
+        const Reg a = args[0];
+        const Reg b = args[1];
+        const Reg c = args[2];
+        switch (node.kind) {
+        case Kind::Number:
+        case Kind::Input: break; // collected up front
+        case Kind::Member:
+            if (!a.vec) {
+                fail(node, "'.' needs a vector, got a number");
+            }
+            return op(Op::VGet, false, a, Reg{false, static_cast<std::uint16_t>(node.args[1])});
+        case Kind::Unary:
+            if (node.op == Tok::Minus) {
+                return a.vec ? op(Op::VNeg, true, a) : op(Op::Neg, false, a);
+            }
+            require_numbers(node, {a}, "'!'");
+            return op(Op::Not, false, a);
+        case Kind::Ternary:
+            require_numbers(node, {a}, "the condition of '?:'");
+            if (b.vec != c.vec) {
+                fail(node, std::string("the branches of '?:' are ") + kind_name(b.vec) +
+                               " and " + kind_name(c.vec));
+            }
+            return b.vec ? op(Op::VSelect, true, a, b, c) : op(Op::Select, false, a, b, c);
+        case Kind::Binary: return emit_binary(node, a, b);
+        case Kind::Call: return emit_call(node, a, b, c);
+        }
+        fail(node, "internal error: unknown node");
+    }
+
+    Reg emit_binary(const Node& node, Reg a, Reg b) {
+        if (!a.vec && !b.vec) {
+            if (const std::optional<Op> code = numeric_op(node)) {
+                return op(*code, false, a, b);
+            }
+        } else if (a.vec && b.vec) {
+            switch (node.op) {
+            case Tok::Plus: return op(Op::VAdd, true, a, b);
+            case Tok::Minus: return op(Op::VSub, true, a, b);
+            case Tok::Star: return op(Op::VMul, true, a, b);
+            case Tok::Slash: return op(Op::VDiv, true, a, b);
+            default: break;
+            }
+        } else if (node.op == Tok::Star) {
+            return a.vec ? op(Op::VScale, true, a, b) : op(Op::VScale, true, b, a);
+        } else if (node.op == Tok::Slash && a.vec) {
+            return op(Op::VDivScalar, true, a, b);
+        }
+        fail(node, std::string("cannot apply '") + operator_text(node.op) + "' to " +
+                       kind_name(a.vec) + " and " + kind_name(b.vec));
+    }
+
+    Reg emit_call(const Node& node, Reg a, Reg b, Reg c) {
+        const std::string name(function_name(node.fn));
+        switch (node.fn) {
+        case Fn::Min:
+        case Fn::Max:
+            if (a.vec && b.vec) {
+                return op(node.fn == Fn::Min ? Op::VMin : Op::VMax, true, a, b);
+            }
+            break;
+        case Fn::Lerp:
+            if (a.vec && b.vec) {
+                require_numbers(node, {c}, "the weight of lerp");
+                return op(Op::VLerp, true, a, b, c);
+            }
+            break;
+        case Fn::Vec: require_numbers(node, {a, b, c}, "vec"); return op(Op::VMake, true, a, b, c);
+        case Fn::Dot: require_vectors(node, {a, b}, "dot"); return op(Op::VDot, false, a, b);
+        case Fn::Cross: require_vectors(node, {a, b}, "cross"); return op(Op::VCross, true, a, b);
+        case Fn::Length: require_vectors(node, {a}, "length"); return op(Op::VLength, false, a);
+        case Fn::Normalize:
+            require_vectors(node, {a}, "normalize");
+            return op(Op::VNormalize, true, a);
+        default: break;
+        }
+        // Everything else is a function of numbers.
+        const Reg args[3] = {a, b, c};
+        for (std::uint8_t i = 0; i < node.arg_count; ++i) {
+            require_numbers(node, {args[i]}, name.c_str());
+        }
+        return op(*numeric_op(node), false, a, b, c);
+    }
+
+    const std::vector<Node>& nodes_;
+    const unsigned vector_inputs_;
+    std::vector<std::optional<Reg>> memo_;
+    std::uint32_t next_num_ = 0;
+    std::uint32_t next_vec_ = 0;
+    Chunk chunk_;
+};
+
+/// Register file on the stack for typical scripts, on the heap beyond.
+template <typename T, std::size_t Inline>
+class Registers {
+public:
+    explicit Registers(std::size_t n) {
+        if (n > Inline) {
+            heap_.resize(n);
+        }
+    }
+    T* data() noexcept { return heap_.empty() ? inline_.data() : heap_.data(); }
+
+private:
+    std::array<T, Inline> inline_;
+    std::vector<T> heap_;
+};
+
+} // namespace
+
+struct Script::State {
+    std::vector<std::string> inputs;
+    std::vector<Node> nodes;
+    std::vector<std::uint32_t> results;
+    unsigned used_inputs = 0; // bit per input
+
+    /// Specializations by vector-input mask, generated on first use. Lookups
+    /// are lock-free; generation takes the mutex.
+    std::unique_ptr<std::atomic<const Chunk*>[]> chunks;
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Chunk>> owned;
+
+    /// Finishes a state whose nodes and results are set.
+    void seal() {
+        std::vector<std::uint8_t> reachable(nodes.size(), 0);
+        std::vector<std::uint32_t> pending = results;
+        while (!pending.empty()) {
+            const std::uint32_t id = pending.back();
+            pending.pop_back();
+            if (reachable[id]) {
+                continue;
+            }
+            reachable[id] = 1;
+            const Node& node = nodes[id];
+            if (node.kind == Kind::Input) {
+                used_inputs |= 1u << node.args[0];
+            } else if (node.kind != Kind::Number) {
+                pending.insert(pending.end(), node.args, node.args + node.arg_count);
+            }
+        }
+        chunks = std::make_unique<std::atomic<const Chunk*>[]>(std::size_t{1} << inputs.size());
+    }
+
+    const Chunk& specialization(unsigned vector_inputs) {
+        if (const Chunk* chunk = chunks[vector_inputs].load(std::memory_order_acquire)) {
+            return *chunk;
+        }
+        std::lock_guard lock(mutex);
+        if (const Chunk* chunk = chunks[vector_inputs].load(std::memory_order_relaxed)) {
+            return *chunk;
+        }
+        owned.push_back(
+            std::make_unique<Chunk>(Generator(nodes, vector_inputs).generate(results)));
+        chunks[vector_inputs].store(owned.back().get(), std::memory_order_release);
+        return *owned.back();
+    }
+};
+
+namespace {
+
+void check_input_count(std::size_t count) {
+    if (count > Script::max_inputs) {
+        throw ScriptError("a script takes at most " + std::to_string(Script::max_inputs) +
+                          " inputs");
+    }
+}
+
+/// The IR for a constant input value: a number, or vec() of three numbers.
+std::uint32_t constant_node(IrBuilder& ir, const Value& value, std::uint32_t part) {
+    Node number;
+    number.part = part;
+    switch (value.type()) {
+    case DataType::Bool: number.number = value.as_bool() ? 1.0 : 0.0; return ir.intern(number);
+    case DataType::Int:
+    case DataType::Float: number.number = value.as_float(); return ir.intern(number);
+    case DataType::Buffer: {
+        const Buffer& b = value.as_buffer();
+        if (b.size() != 3 || (b.element_type() != ElementType::F32 &&
+                              b.element_type() != ElementType::F64)) {
+            break;
+        }
+        Node vec;
+        vec.kind = Kind::Call;
+        vec.fn = Fn::Vec;
+        vec.arg_count = 3;
+        vec.part = part;
+        for (std::size_t i = 0; i < 3; ++i) {
+            number.number = b.element_type() == ElementType::F64
+                                ? b.view<double>()[i]
+                                : static_cast<double>(b.view<float>()[i]);
+            vec.args[i] = ir.intern(number);
+        }
+        return ir.intern(vec);
+    }
+    default: break;
+    }
+    throw TypeError(std::string("cannot use a ") + to_string(value.type()) +
+                    " as a script constant");
+}
+
+} // namespace
+
+Script::Script(std::unique_ptr<State> state) noexcept : state_(std::move(state)) {}
+Script::Script(Script&&) noexcept = default;
+Script& Script::operator=(Script&&) noexcept = default;
+Script::~Script() = default;
+
+Script Script::compile(std::string_view source, std::vector<std::string> input_names) {
+    check_input_count(input_names.size());
+    auto state = std::make_unique<State>();
+    state->inputs = std::move(input_names);
+    IrBuilder ir;
+    Parser parser(tokenize(source), state->inputs, ir);
+    state->results.push_back(parser.parse_script());
+    state->nodes = ir.take();
+    state->seal();
+    return Script(std::move(state));
+}
+
+Script Script::fuse(std::span<const Script* const> parts,
+                    std::span<const std::vector<ScriptSource>> sources,
+                    std::vector<std::string> input_names) {
+    check_input_count(input_names.size());
+    if (sources.size() != parts.size()) {
+        throw ScriptError("fuse needs one source list per part");
+    }
+    auto state = std::make_unique<State>();
+    state->inputs = std::move(input_names);
+    IrBuilder ir;
+    for (std::size_t p = 0; p < parts.size(); ++p) {
+        const State& part = *parts[p]->state_;
+        const std::vector<ScriptSource>& from = sources[p];
+        if (from.size() != part.inputs.size()) {
+            throw ScriptError("part " + std::to_string(p) + " takes " +
+                                  std::to_string(part.inputs.size()) + " inputs, got " +
+                                  std::to_string(from.size()) + " sources",
+                              p);
+        }
+        const auto part_index = static_cast<std::uint32_t>(p);
+        // Re-intern the part's nodes in order (operands come first), with its
+        // inputs replaced by what they are bound to.
+        std::vector<std::uint32_t> renamed(part.nodes.size());
+        for (std::size_t id = 0; id < part.nodes.size(); ++id) {
+            Node node = part.nodes[id];
+            node.part = part_index;
+            if (node.kind == Kind::Input) {
+                const ScriptSource& source = from[node.args[0]];
+                switch (source.kind) {
+                case ScriptSource::Kind::Input:
+                    if (source.index >= state->inputs.size()) {
+                        throw ScriptError("part " + std::to_string(p) + " reads input " +
+                                              std::to_string(source.index) + " of " +
+                                              std::to_string(state->inputs.size()),
+                                          p);
+                    }
+                    node.args[0] = source.index;
+                    renamed[id] = ir.intern(node);
+                    break;
+                case ScriptSource::Kind::Result:
+                    if (source.index >= p) {
+                        throw ScriptError("part " + std::to_string(p) +
+                                              " reads the result of a later part",
+                                          p);
+                    }
+                    renamed[id] = state->results[source.index];
+                    break;
+                case ScriptSource::Kind::Constant:
+                    renamed[id] = constant_node(ir, source.constant, part_index);
+                    break;
+                }
+                continue;
+            }
+            for (std::uint8_t i = 0; i < node.arg_count; ++i) {
+                node.args[i] = renamed[node.args[i]];
+            }
+            renamed[id] = ir.intern(node);
+        }
+        state->results.push_back(renamed[part.results.front()]);
+    }
+    state->nodes = ir.take();
+    state->seal();
+    return Script(std::move(state));
+}
+
+const std::vector<std::string>& Script::input_names() const noexcept {
+    return state_->inputs;
+}
+
+bool Script::uses_input(std::size_t index) const noexcept {
+    return index < state_->inputs.size() && ((state_->used_inputs >> index) & 1u) != 0;
+}
+
+std::size_t Script::result_count() const noexcept {
+    return state_->results.size();
+}
+
+Value Script::run(std::span<const Value* const> inputs) const {
+    Value result;
+    run_all(inputs, {&result, 1});
+    return result;
+}
+
+void Script::run_all(std::span<const Value* const> inputs, std::span<Value> results) const {
+    State& s = *state_;
+    if (inputs.size() != s.inputs.size()) {
+        throw TypeError("script expects " + std::to_string(s.inputs.size()) + " inputs, got " +
+                        std::to_string(inputs.size()));
+    }
+
+    double numbers[max_inputs];
+    Vec3 vectors[max_inputs];
+    unsigned vector_inputs = 0;
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        if (((s.used_inputs >> i) & 1u) == 0) {
+            continue;
+        }
+        const Value& v = *inputs[i];
+        switch (v.type()) {
+        case DataType::Bool: numbers[i] = v.as_bool() ? 1.0 : 0.0; continue;
+        case DataType::Int:
+        case DataType::Float: numbers[i] = v.as_float(); continue;
+        case DataType::Buffer: {
+            const Buffer& b = v.as_buffer();
+            if (b.size() == 3 && b.element_type() == ElementType::F64) {
+                const std::span<const double> e = b.view<double>();
+                vectors[i] = {e[0], e[1], e[2]};
+                vector_inputs |= 1u << i;
+                continue;
+            }
+            if (b.size() == 3 && b.element_type() == ElementType::F32) {
+                const std::span<const float> e = b.view<float>();
+                vectors[i] = {e[0], e[1], e[2]};
+                vector_inputs |= 1u << i;
+                continue;
+            }
+            break;
+        }
+        default: break;
+        }
+        throw TypeError("script input '" + s.inputs[i] +
+                        "' must be a number or a 3-element float buffer, got " +
+                        to_string(v.type()));
+    }
+
+    const Chunk& chunk = s.specialization(vector_inputs);
+    Registers<double, 32> n(chunk.num_registers);
+    Registers<Vec3, 8> v(chunk.vec_registers);
+    std::copy(chunk.constants.begin(), chunk.constants.end(), n.data());
+    for (const auto& [input, reg] : chunk.num_loads) {
+        n.data()[reg] = numbers[input];
+    }
+    for (const auto& [input, reg] : chunk.vec_loads) {
+        v.data()[reg] = vectors[input];
+    }
+    execute(chunk.code, n.data(), v.data());
+
+    const std::size_t count = std::min(results.size(), chunk.results.size());
+    for (std::size_t i = 0; i < count; ++i) {
+        const Reg r = chunk.results[i];
+        if (!r.vec) {
+            results[i] = n.data()[r.index];
+            continue;
+        }
+        const Vec3& e = v.data()[r.index];
+        Buffer out = Buffer::allocate(ElementType::F64, 3, 3);
+        const std::span<double> d = out.mutate<double>();
+        d[0] = e.x;
+        d[1] = e.y;
+        d[2] = e.z;
+        results[i] = std::move(out);
+    }
+}
+
+std::string Script::disassemble(unsigned vector_inputs) const {
+    const Chunk& chunk =
+        state_->specialization(vector_inputs & ((1u << state_->inputs.size()) - 1));
+    std::ostringstream out;
+    for (std::size_t i = 0; i < chunk.constants.size(); ++i) {
+        out << "n" << i << " = " << chunk.constants[i] << '\n';
+    }
+    for (const auto& [input, reg] : chunk.num_loads) {
+        out << "n" << reg << " = " << state_->inputs[input] << '\n';
+    }
+    for (const auto& [input, reg] : chunk.vec_loads) {
+        out << "v" << reg << " = " << state_->inputs[input] << '\n';
+    }
+    for (const Instr& i : chunk.code) {
+        const Op op = i.op;
+        const bool vec_dst = (op >= Op::VAdd && op <= Op::VMake);
+        const bool vec_a = op >= Op::VAdd && op != Op::VSelect && op != Op::VMake;
+        const bool vec_b = (op >= Op::VAdd && op <= Op::VMax) || op == Op::VCross ||
+                           op == Op::VLerp || op == Op::VSelect || op == Op::VDot;
+        const bool vec_c = op == Op::VSelect;
+        const int arity = op == Op::VGet ? 1
+                          : (op >= Op::Clamp && op <= Op::Select) || op == Op::VLerp ||
+                                  op == Op::VSelect || op == Op::VMake
+                              ? 3
+                          : (op >= Op::Neg && op <= Op::Round) || op == Op::VNeg ||
+                                  op == Op::VNormalize || op == Op::VLength
+                              ? 1
+                              : 2;
+        out << (vec_dst ? 'v' : 'n') << i.dst << " = " << op_names[static_cast<std::size_t>(op)]
+            << ' ' << (vec_a ? 'v' : 'n') << i.a;
+        if (op == Op::VGet) {
+            out << ' ' << "xyz"[i.b];
+        }
+        if (arity >= 2) {
+            out << ", " << (vec_b ? 'v' : 'n') << i.b;
+        }
+        if (arity >= 3) {
+            out << ", " << (vec_c ? 'v' : 'n') << i.c;
+        }
+        out << '\n';
+    }
+    for (const Reg& r : chunk.results) {
+        out << "return " << (r.vec ? 'v' : 'n') << r.index << '\n';
+    }
+    return out.str();
+}
+
+} // namespace rebelflow
@@ -0,0 +1,203 @@
+#include "rebelflow/serialize.hpp"
+
+#include "rebelflow/brep.hpp"
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/mesh.hpp"
+
+namespace rebelflow {
+
+void ByteWriter::write_string(std::string_view s) {
+    write_u32(static_cast<std::uint32_t>(s.size()));
+    write(s.data(), s.size());
+}
+
+void ByteWriter::align(std::size_t alignment) {
+    static constexpr std::byte zeros[64] = {};
+    const std::size_t pad = (alignment - bytes_.size() % alignment) % alignment;
+    write(zeros, pad);
+}
+
+void ByteReader::align(std::size_t alignment) {
+    read_span((alignment - pos_ % alignment) % alignment);
+}
+
+void ByteReader::read(void* out, std::size_t size) {
+    std::memcpy(out, read_span(size).data(), size);
+}
+
+std::span<const std::byte> ByteReader::read_span(std::size_t size) {
+    if (size > remaining()) {
+        throw FormatError("unexpected end of data: need " + std::to_string(size) + " bytes, have " +
+                          std::to_string(remaining()));
+    }
+    auto out = bytes_.subspan(pos_, size);
+    pos_ += size;
+    return out;
+}
+
+std::string ByteReader::read_string() {
+    const std::uint32_t size = read_u32();
+    auto bytes = read_span(size);
+    return std::string(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+namespace {
+
+void write_buffer(ByteWriter& out, const Buffer& b) {
+    out.write_u8(static_cast<std::uint8_t>(b.element_type()));
+    out.write_u32(b.components());
+    out.write_u64(b.size());
+    out.align(8);
+    out.write(b.bytes(), b.size_bytes());
+}
+
+void write_mesh(ByteWriter& out, const Mesh& mesh) {
+    const Mesh::Arrays& m = mesh.arrays();
+    write_buffer(out, m.positions);
+    write_buffer(out, m.corners);
+    write_buffer(out, m.twins);
+    write_buffer(out, m.vertex_halfedges);
+    out.write_u32(static_cast<std::uint32_t>(m.attributes.size()));
+    for (const MeshAttribute& a : m.attributes) {
+        out.write_string(a.name);
+        out.write_u8(static_cast<std::uint8_t>(a.domain));
+        write_buffer(out, a.data);
+    }
+}
+
+} // namespace
+
+void write_value(ByteWriter& out, const Value& value) {
+    out.write_u8(static_cast<std::uint8_t>(value.type()));
+    switch (value.type()) {
+    case DataType::Bool: out.write_u8(value.as_bool() ? 1 : 0); break;
+    case DataType::Int: out.write_pod(value.as_int()); break;
+    case DataType::Float: out.write_f64(value.as_float()); break;
+    case DataType::String: out.write_string(value.as_string()); break;
+    case DataType::Buffer: write_buffer(out, value.as_buffer()); break;
+    case DataType::Mesh: write_mesh(out, value.as_mesh()); break;
+    case DataType::Bvh: {
+        const Bvh::Arrays& b = value.as_bvh().arrays();
+        write_mesh(out, b.mesh);
+        write_buffer(out, b.bounds);
+        write_buffer(out, b.links);
+        write_buffer(out, b.triangles);
+        break;
+    }
+    case DataType::Brep: {
+        const Brep::Arrays& b = value.as_brep().arrays();
+        for (const Buffer* buffer : {&b.bodies, &b.transforms, &b.names, &b.shapes, &b.faces,
+                                     &b.loops, &b.edge_uses, &b.edges, &b.vertices, &b.surfaces,
+                                     &b.curves, &b.parameters}) {
+            write_buffer(out, *buffer);
+        }
+        break;
+    }
+    default: break;
+    }
+}
+
+namespace {
+
+Buffer read_buffer(ByteReader& in) {
+    const std::uint8_t raw_type = in.read_u8();
+    if (raw_type > static_cast<std::uint8_t>(ElementType::F64)) {
+        throw FormatError("unknown buffer element type " + std::to_string(raw_type));
+    }
+    const auto type = static_cast<ElementType>(raw_type);
+    const std::uint32_t components = in.read_u32();
+    const std::uint64_t count = in.read_u64();
+    if (components == 0 || count % components != 0 ||
+        count > in.remaining() / element_size(type)) {
+        throw FormatError("corrupt buffer header");
+    }
+    in.align(8);
+    const std::span<const std::byte> bytes = in.read_span(count * element_size(type));
+    const bool aligned =
+        reinterpret_cast<std::uintptr_t>(bytes.data()) % element_size(type) == 0;
+    if (in.owner() && aligned) {
+        return Buffer::wrap(type, bytes.data(), count, in.owner(), components);
+    }
+    Buffer b = Buffer::allocate(type, count, components);
+    std::memcpy(b.mutate_bytes().data(), bytes.data(), bytes.size());
+    return b;
+}
+
+Mesh read_mesh(ByteReader& in) {
+    Mesh::Arrays m;
+    m.positions = read_buffer(in);
+    m.corners = read_buffer(in);
+    m.twins = read_buffer(in);
+    m.vertex_halfedges = read_buffer(in);
+    const std::uint32_t count = in.read_u32();
+    for (std::uint32_t i = 0; i < count; ++i) {
+        MeshAttribute a;
+        a.name = in.read_string();
+        const std::uint8_t domain = in.read_u8();
+        if (domain > static_cast<std::uint8_t>(MeshDomain::Corner)) {
+            throw FormatError("unknown mesh attribute domain " + std::to_string(domain));
+        }
+        a.domain = static_cast<MeshDomain>(domain);
+        a.data = read_buffer(in);
+        m.attributes.push_back(std::move(a));
+    }
+    return Mesh::from_arrays(std::move(m));
+}
+
+Bvh read_bvh(ByteReader& in) {
+    Bvh::Arrays b;
+    b.mesh = read_mesh(in);
+    b.bounds = read_buffer(in);
+    b.links = read_buffer(in);
+    b.triangles = read_buffer(in);
+    return Bvh::from_arrays(std::move(b));
+}
+
+Brep read_brep(ByteReader& in) {
+    Brep::Arrays b;
+    for (Buffer* buffer : {&b.bodies, &b.transforms, &b.names, &b.shapes, &b.faces,
+                           &b.loops, &b.edge_uses, &b.edges, &b.vertices, &b.surfaces,
+                           &b.curves, &b.parameters}) {
+        *buffer = read_buffer(in);
+    }
+    return Brep::from_arrays(std::move(b));
+}
+
+} // namespace
+
+Value read_value(ByteReader& in) {
+    const auto type = static_cast<DataType>(in.read_u8());
+    switch (type) {
+    case DataType::None: return Value{};
+    case DataType::Bool: return Value(in.read_u8() != 0);
+    case DataType::Int: return Value(in.read_pod<std::int64_t>());
+    case DataType::Float: return Value(in.read_f64());
+    case DataType::String: return Value(in.read_string());
+    case DataType::Buffer: return Value(read_buffer(in));
+    case DataType::Mesh: return Value(read_mesh(in));
+    case DataType::Bvh: return Value(read_bvh(in));
+    case DataType::Brep: return Value(read_brep(in));
+    default: throw FormatError("unknown value tag " + std::to_string(static_cast<int>(type)));
+    }
+}
+
+void hash_value(Hasher& hasher, const Value& value) {
+    hasher.update(static_cast<std::uint64_t>(value.type()));
+    switch (value.type()) {
+    case DataType::Bool: hasher.update(std::uint64_t{value.as_bool()}); break;
+    case DataType::Int: hasher.update(static_cast<std::uint64_t>(value.as_int())); break;
+    case DataType::Float: {
+        const double v = value.as_float();
+        hasher.update(&v, sizeof v);
+        break;
+    }
+    case DataType::String: hasher.update(value.as_string()); break;
+    case DataType::Buffer: hasher.update(value.as_buffer().content_digest()); break;
+    case DataType::Mesh: hasher.update(value.as_mesh().content_digest()); break;
+    case DataType::Bvh: hasher.update(value.as_bvh().content_digest()); break;
+    case DataType::Brep: hasher.update(value.as_brep().content_digest()); break;
+    default: break;
+    }
+}
+
+} // namespace rebelflow
@@ -0,0 +1,195 @@
+#include "rebelflow/shared_memory.hpp"
+
+#include "rebelflow/error.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace rebelflow {
+
+namespace {
+
+[[noreturn]] void fail(const char* what) {
+    throw IoError(std::string("shared memory: ") + what + ": " + std::strerror(errno));
+}
+
+/// Live segments by mapping address, for SharedSegment::find().
+struct SegmentIndex {
+    std::mutex mutex;
+    std::map<const std::byte*, std::weak_ptr<const SharedSegment>> segments;
+};
+
+SegmentIndex& segment_index() {
+    static SegmentIndex index;
+    return index;
+}
+
+int create_fd() {
+#ifdef __linux__
+    const int fd = ::memfd_create("rebelflow", MFD_CLOEXEC);
+#else
+    static std::atomic<unsigned> counter{0};
+    const std::string name = "/rebelflow-" + std::to_string(::getpid()) + "-" +
+                             std::to_string(counter.fetch_add(1));
+    const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) {
+        ::shm_unlink(name.c_str());
+    }
+#endif
+    if (fd < 0) {
+        fail("cannot create segment");
+    }
+    return fd;
+}
+
+std::shared_ptr<SharedSegment> indexed(std::shared_ptr<SharedSegment> segment) {
+    if (segment->data() != nullptr) {
+        SegmentIndex& index = segment_index();
+        std::lock_guard lock(index.mutex);
+        index.segments[segment->data()] = segment;
+    }
+    return segment;
+}
+
+constexpr std::size_t arena_alignment = 64;
+
+/// Faults in the pages of [data, data + bytes) with one call. Buffers are
+/// written right after allocation, and a page fault per page of a shared
+/// mapping costs several times the writing.
+void populate(std::byte* data, std::size_t bytes) noexcept {
+#ifdef MADV_POPULATE_WRITE
+    static const auto page = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    const auto begin = reinterpret_cast<std::uintptr_t>(data) & ~(page - 1);
+    const auto end = reinterpret_cast<std::uintptr_t>(data) + bytes;
+    if (end - begin >= 16 * page) {
+        ::madvise(reinterpret_cast<void*>(begin), end - begin, MADV_POPULATE_WRITE);
+    }
+#else
+    (void)data;
+    (void)bytes;
+#endif
+}
+
+} // namespace
+
+SharedSegment::SharedSegment(int fd, std::byte* data, std::size_t size) noexcept
+    : fd_(fd), data_(data), mapped_(size), size_(size) {}
+
+std::shared_ptr<SharedSegment> SharedSegment::create(std::size_t size) {
+    const int fd = create_fd();
+    if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        fail("cannot size segment");
+    }
+    void* data = size > 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                          : nullptr;
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        fail("cannot map segment");
+    }
+#ifdef MADV_HUGEPAGE
+    if (size >= (std::size_t{2} << 20)) {
+        ::madvise(data, size, MADV_HUGEPAGE); // honoured where shmem THP is "advise"
+    }
+#endif
+    return indexed(std::shared_ptr<SharedSegment>(
+        new SharedSegment(fd, static_cast<std::byte*>(data), size)));
+}
+
+std::shared_ptr<SharedSegment> SharedSegment::attach(int fd) {
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        fail("cannot stat received segment");
+    }
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void* data = size > 0 ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                          : nullptr;
+    if (data == MAP_FAILED) {
+        ::close(fd);
+        fail("cannot map received segment");
+    }
+    return indexed(std::shared_ptr<SharedSegment>(
+        new SharedSegment(fd, static_cast<std::byte*>(data), size)));
+}
+
+SharedSegment::~SharedSegment() {
+    if (data_ != nullptr) {
+        {
+            SegmentIndex& index = segment_index();
+            std::lock_guard lock(index.mutex);
+            index.segments.erase(data_);
+        }
+        ::munmap(data_, mapped_);
+    }
+    ::close(fd_);
+}
+
+void SharedSegment::truncate(std::size_t size) {
+    if (size >= size_) {
+        return;
+    }
+    if (::ftruncate(fd_, static_cast<off_t>(size)) != 0) {
+        fail("cannot shrink segment");
+    }
+    size_ = size;
+}
+
+SharedSegment::Location SharedSegment::find(const void* data, std::size_t bytes) {
+    const auto* p = static_cast<const std::byte*>(data);
+    SegmentIndex& index = segment_index();
+    std::lock_guard lock(index.mutex);
+    auto it = index.segments.upper_bound(p);
+    if (p == nullptr || it == index.segments.begin()) {
+        return {};
+    }
+    --it;
+    std::shared_ptr<const SharedSegment> segment = it->second.lock();
+    if (!segment || p + bytes > segment->data() + segment->size()) {
+        return {};
+    }
+    const auto offset = static_cast<std::size_t>(p - segment->data());
+    return {std::move(segment), offset};
+}
+
+SharedArena::~SharedArena() {
+    try {
+        seal();
+    } catch (const IoError&) {
+        // Only the unused tail stays reserved.
+    }
+}
+
+std::shared_ptr<std::byte> SharedArena::allocate(std::size_t bytes) {
+    std::size_t at = (used_ + arena_alignment - 1) & ~(arena_alignment - 1);
+    if (!current_ || at + bytes > current_->size()) {
+        seal();
+        current_ = SharedSegment::create(std::max(reserve_, bytes));
+        at = 0;
+    }
+    used_ = at + bytes;
+    std::byte* data = current_->data() + at;
+    populate(data, bytes);
+    return {current_, data};
+}
+
+void SharedArena::seal() {
+    if (current_) {
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        current_->truncate((used_ + page - 1) / page * page);
+        current_.reset();
+    }
+    used_ = 0;
+}
+
+} // namespace rebelflow
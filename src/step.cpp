@@ -0,0 +1,1342 @@
+#include "rebelflow/step.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/mapped_file.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <map>
+#include <numbers>
+#include <span>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace rebelflow {
+
+namespace {
+
+using Vec3 = std::array<double, 3>;
+/// A rigid transform, 3 x 4 row by row.
+using Matrix = std::array<double, 12>;
+using SurfaceKind = Brep::SurfaceKind;
+using CurveKind = Brep::CurveKind;
+
+constexpr std::uint32_t invalid = Brep::invalid;
+constexpr Matrix identity = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+/// Lists nest at most this deep.
+constexpr int max_depth = 64;
+
+bool is_space(char c) noexcept {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_name(char c) noexcept {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+           c == '_' || c == '-';
+}
+
+/// How messages name an entity instance.
+std::string entity(std::uint64_t id) {
+    std::string name = "#";
+    name += std::to_string(id);
+    return name;
+}
+
+/// Skips white space and comments.
+const char* skip_space(const char* p, const char* end) noexcept {
+    while (p != end) {
+        if (is_space(*p)) {
+            ++p;
+        } else if (*p == '/' && p + 1 != end && p[1] == '*') {
+            const std::string_view rest(p + 2, static_cast<std::size_t>(end - p - 2));
+            const std::size_t close = rest.find("*/");
+            p = close == std::string_view::npos ? end : p + 2 + close + 2;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+/// Past the string starting at `p`, a quote; quotes inside are doubled.
+const char* skip_string(const char* p, const char* end) noexcept {
+    const char quote = *p++;
+    while (p != end) {
+        if (*p++ == quote) {
+            if (p == end || *p != quote) {
+                return p;
+            }
+            ++p;
+        }
+    }
+    return end;
+}
+
+/// Past the parenthesized group starting at `p`.
+const char* skip_group(const char* p, const char* end) noexcept {
+    int depth = 0;
+    while (p != end) {
+        if (*p == '\'' || *p == '"') {
+            p = skip_string(p, end);
+            continue;
+        }
+        if (*p == '(') {
+            ++depth;
+        } else if (*p == ')' && --depth == 0) {
+            return p + 1;
+        }
+        ++p;
+    }
+    return end;
+}
+
+struct Record {
+    std::uint64_t id = 0;
+    /// The entity type, empty for a complex entity ...
+    std::string_view type;
+    /// ... and its parameters in parentheses, or the parenthesized list of
+    /// the complex entity's parts.
+    std::string_view body;
+};
+
+/// A parameter of a record. Lists and typed values point at their elements
+/// in the Args that holds them.
+struct Param {
+    enum class Kind : std::uint8_t { Unset, Derived, Ref, Number, String, Enum, List, Typed };
+
+    Kind kind = Kind::Unset;
+    double number = 0;
+    std::uint64_t ref = 0;
+    /// String contents (quotes doubled), enumeration value, or type name.
+    std::string_view text;
+    std::uint32_t first = 0;
+    std::uint32_t count = 0;
+};
+
+class Step;
+
+/// The parsed parameters of one record or part of one.
+class Args {
+public:
+    Args(const Step& step, const Record& record, std::string_view body);
+
+    std::size_t size() const noexcept { return params_[0].count; }
+    const Param& operator[](std::size_t i) const;
+
+    std::span<const Param> list(const Param& p) const;
+    double number(const Param& p) const;
+    std::uint64_t ref(const Param& p) const;
+    bool flag(const Param& p) const;
+    std::string string(const Param& p) const;
+    bool is_unset(std::size_t i) const noexcept {
+        return i >= size() || params_[params_[0].first + i].kind == Param::Kind::Unset ||
+               params_[params_[0].first + i].kind == Param::Kind::Derived;
+    }
+
+    [[noreturn]] void malformed(const std::string& what) const;
+
+private:
+    Param parse_list(const char*& p, const char* end, int depth);
+    Param parse_item(const char*& p, const char* end, int depth);
+
+    const Step& step_;
+    const Record& record_;
+    std::vector<Param> params_;
+};
+
+/// The records of a STEP file's data section, by id.
+class Step {
+public:
+    Step(const std::string& path, std::string_view text, ThreadPool* pool)
+        : path_(path), text_(text) {
+        // Statements end at semicolons outside strings and comments; that
+        // takes one pass in order. Each is then parsed on its own.
+        std::vector<std::string_view> statements;
+        const char* p = text.data();
+        const char* end = p + text.size();
+        const char* start = p;
+        while (p != end) {
+            const char c = *p;
+            if (c == '\'' || c == '"') {
+                p = skip_string(p, end);
+            } else if (c == '/' && p + 1 != end && p[1] == '*') {
+                p = skip_space(p, end);
+            } else if (c == ';') {
+                const char* s = skip_space(start, p);
+                if (s != p && *s == '#') {
+                    statements.emplace_back(s, static_cast<std::size_t>(p - s));
+                }
+                start = ++p;
+            } else {
+                ++p;
+            }
+        }
+        records_.resize(statements.size());
+        parallel_for(pool, statements.size(), 4096, [&](std::size_t begin, std::size_t stop) {
+            for (std::size_t i = begin; i < stop; ++i) {
+                records_[i] = parse_record(statements[i]);
+            }
+        });
+        if (!std::is_sorted(records_.begin(), records_.end(), by_id)) {
+            std::sort(records_.begin(), records_.end(), by_id);
+        }
+        for (std::size_t i = 1; i < records_.size(); ++i) {
+            if (records_[i].id == records_[i - 1].id) {
+                malformed(records_[i], entity(records_[i].id) + " defined twice");
+            }
+        }
+    }
+
+    const std::vector<Record>& records() const noexcept { return records_; }
+
+    const Record* find(std::uint64_t id) const noexcept {
+        const auto it = std::lower_bound(records_.begin(), records_.end(), id,
+                                         [](const Record& r, std::uint64_t i) { return r.id < i; });
+        return it != records_.end() && it->id == id ? &*it : nullptr;
+    }
+
+    const Record& get(const Record& from, std::uint64_t id) const {
+        const Record* r = find(id);
+        if (r == nullptr) {
+            malformed(from, entity(id) + " is not defined");
+        }
+        return *r;
+    }
+
+    /// Whether `record` is of `type` or, if complex, has a part of it.
+    bool is(const Record& record, std::string_view type) const {
+        return record.type.empty() ? !part(record, type).empty() : record.type == type;
+    }
+
+    /// The parameters of a simple record.
+    Args args(const Record& record) const { return Args(*this, record, record.body); }
+
+    /// The parameters of `type`: the record's own if it is of that type,
+    /// else those of its part of that type.
+    Args args(const Record& record, std::string_view type) const {
+        if (!record.type.empty()) {
+            if (record.type != type) {
+                malformed(record, "expected " + std::string(type) + ", not " +
+                                      std::string(record.type));
+            }
+            return args(record);
+        }
+        const std::string_view body = part(record, type);
+        if (body.empty()) {
+            malformed(record, "expected " + std::string(type));
+        }
+        return Args(*this, record, body);
+    }
+
+    /// The parenthesized parameters of a complex record's part, or empty.
+    std::string_view part(const Record& record, std::string_view type) const {
+        const char* p = record.body.data() + 1;
+        const char* end = record.body.data() + record.body.size() - 1;
+        while (true) {
+            p = skip_space(p, end);
+            const char* name = p;
+            while (p != end && is_name(*p)) {
+                ++p;
+            }
+            if (p == name) {
+                return {};
+            }
+            const std::string_view found(name, static_cast<std::size_t>(p - name));
+            p = skip_space(p, end);
+            if (p == end || *p != '(') {
+                return {};
+            }
+            const char* close = skip_group(p, end);
+            if (found == type) {
+                return {p, static_cast<std::size_t>(close - p)};
+            }
+            p = close;
+        }
+    }
+
+    [[noreturn]] void malformed(const Record& record, const std::string& what) const {
+        const char* at = record.body.data() != nullptr ? record.body.data() : text_.data();
+        const auto line = 1 + std::count(text_.data(), at, '\n');
+        throw FormatError(path_ + ":" + std::to_string(line) + ": " + what);
+    }
+
+private:
+    static bool by_id(const Record& a, const Record& b) noexcept { return a.id < b.id; }
+
+    /// `#id = TYPE(...)` or `#id = (A(...) B(...))`.
+    Record parse_record(std::string_view s) const {
+        Record r;
+        const char* p = s.data() + 1;
+        const char* end = s.data() + s.size();
+        r.body = {s.data(), 0};
+        const auto [stop, error] = std::from_chars(p, end, r.id);
+        p = skip_space(stop, end);
+        if (error != std::errc{} || p == end || *p != '=') {
+            malformed(r, "malformed entity instance");
+        }
+        p = skip_space(p + 1, end);
+        const char* type = p;
+        while (p != end && is_name(*p)) {
+            ++p;
+        }
+        r.type = {type, static_cast<std::size_t>(p - type)};
+        p = skip_space(p, end);
+        if (p == end || *p != '(') {
+            malformed(r, entity(r.id) + " has no parameters");
+        }
+        const char* close = skip_group(p, end);
+        r.body = {p, static_cast<std::size_t>(close - p)};
+        if (r.body.back() != ')' || skip_space(close, end) != end) {
+            malformed(r, entity(r.id) + " is malformed");
+        }
+        return r;
+    }
+
+    const std::string& path_;
+    std::string_view text_;
+    std::vector<Record> records_;
+};
+
+Args::Args(const Step& step, const Record& record, std::string_view body)
+    : step_(step), record_(record) {
+    params_.emplace_back();
+    const char* p = body.data() + 1;
+    params_[0] = parse_list(p, body.data() + body.size(), 0);
+}
+
+void Args::malformed(const std::string& what) const {
+    const std::string type = record_.type.empty() ? "complex entity" : std::string(record_.type);
+    step_.malformed(record_, entity(record_.id) + " (" + type + "): " + what);
+}
+
+const Param& Args::operator[](std::size_t i) const {
+    if (i >= size()) {
+        malformed("expected at least " + std::to_string(i + 1) + " parameters");
+    }
+    return params_[params_[0].first + i];
+}
+
+std::span<const Param> Args::list(const Param& p) const {
+    if (p.kind != Param::Kind::List) {
+        malformed("expected a list");
+    }
+    return {params_.data() + p.first, p.count};
+}
+
+double Args::number(const Param& p) const {
+    if (p.kind == Param::Kind::Typed && p.count == 1) {
+        return number(params_[p.first]);
+    }
+    if (p.kind != Param::Kind::Number) {
+        malformed("expected a number");
+    }
+    return p.number;
+}
+
+std::uint64_t Args::ref(const Param& p) const {
+    if (p.kind != Param::Kind::Ref) {
+        malformed("expected an entity reference");
+    }
+    return p.ref;
+}
+
+bool Args::flag(const Param& p) const {
+    if (p.kind != Param::Kind::Enum || (p.text != "T" && p.text != "F")) {
+        malformed("expected .T. or .F.");
+    }
+    return p.text == "T";
+}
+
+std::string Args::string(const Param& p) const {
+    std::string out;
+    if (p.kind == Param::Kind::String) {
+        for (std::size_t i = 0; i < p.text.size(); ++i) {
+            out += p.text[i];
+            i += p.text[i] == '\'' ? 1 : 0;
+        }
+    }
+    return out;
+}
+
+Param Args::parse_list(const char*& p, const char* end, int depth) {
+    if (depth > max_depth) {
+        malformed("lists nested too deep");
+    }
+    std::vector<Param> items;
+    p = skip_space(p, end);
+    if (p != end && *p == ')') {
+        ++p;
+    } else {
+        while (true) {
+            items.push_back(parse_item(p, end, depth));
+            p = skip_space(p, end);
+            if (p != end && *p == ',') {
+                ++p;
+                continue;
+            }
+            if (p != end && *p == ')') {
+                ++p;
+                break;
+            }
+            malformed("expected ',' or ')'");
+        }
+    }
+    Param list;
+    list.kind = Param::Kind::List;
+    list.first = static_cast<std::uint32_t>(params_.size());
+    list.count = static_cast<std::uint32_t>(items.size());
+    params_.insert(params_.end(), items.begin(), items.end());
+    return list;
+}
+
+Param Args::parse_item(const char*& p, const char* end, int depth) {
+    p = skip_space(p, end);
+    Param item;
+    if (p == end) {
+        malformed("unexpected end of parameters");
+    }
+    const char c = *p;
+    if (c == '#') {
+        item.kind = Param::Kind::Ref;
+        const auto [stop, error] = std::from_chars(p + 1, end, item.ref);
+        if (error != std::errc{}) {
+            malformed("malformed reference");
+        }
+        p = stop;
+    } else if (c == '$' || c == '*') {
+        item.kind = c == '$' ? Param::Kind::Unset : Param::Kind::Derived;
+        ++p;
+    } else if (c == '\'' || c == '"') {
+        const char* stop = skip_string(p, end);
+        item.kind = Param::Kind::String;
+        item.text = {p + 1, static_cast<std::size_t>(std::max<std::ptrdiff_t>(stop - p - 2, 0))};
+        p = stop;
+    } else if (c == '.') {
+        const char* stop = std::find(p + 1, end, '.');
+        if (stop == end) {
+            malformed("unterminated enumeration");
+        }
+        item.kind = Param::Kind::Enum;
+        item.text = {p + 1, static_cast<std::size_t>(stop - p - 1)};
+        p = stop + 1;
+    } else if (c == '(') {
+        ++p;
+        item = parse_list(p, end, depth + 1);
+    } else if (c == '-' || c == '+' || (c >= '0' && c <= '9')) {
+        const char* start = c == '+' ? p + 1 : p;
+        const auto [stop, error] = std::from_chars(start, end, item.number);
+        if (error != std::errc{}) {
+            malformed("malformed number");
+        }
+        item.kind = Param::Kind::Number;
+        p = stop;
+    } else if (is_name(c)) {
+        const char* name = p;
+        while (p != end && is_name(*p)) {
+            ++p;
+        }
+        item.text = {name, static_cast<std::size_t>(p - name)};
+        p = skip_space(p, end);
+        if (p == end || *p != '(') {
+            malformed("expected '(' after " + std::string(item.text));
+        }
+        ++p;
+        const Param inner = parse_list(p, end, depth + 1);
+        item.kind = Param::Kind::Typed;
+        item.first = inner.first;
+        item.count = inner.count;
+    } else {
+        malformed(std::string("unexpected '") + c + "'");
+    }
+    return item;
+}
+
+Vec3 normalized(Vec3 v) noexcept {
+    const double length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0) {
+        v = {v[0] / length, v[1] / length, v[2] / length};
+    }
+    return v;
+}
+
+Vec3 cross(const Vec3& a, const Vec3& b) noexcept {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+Matrix multiply(const Matrix& a, const Matrix& b) noexcept {
+    Matrix m{};
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 4; ++c) {
+            m[4 * r + c] = a[4 * r] * b[c] + a[4 * r + 1] * b[4 + c] + a[4 * r + 2] * b[8 + c] +
+                           (c == 3 ? a[4 * r + 3] : 0);
+        }
+    }
+    return m;
+}
+
+/// The inverse of a rigid transform.
+Matrix inverse(const Matrix& a) noexcept {
+    Matrix m{};
+    for (int r = 0; r < 3; ++r) {
+        for (int c = 0; c < 3; ++c) {
+            m[4 * r + c] = a[4 * c + r];
+        }
+        m[4 * r + 3] = -(a[r] * a[3] + a[4 + r] * a[7] + a[8 + r] * a[11]);
+    }
+    return m;
+}
+
+/// Geometry, topology and the shapes built from them, read out of a Step.
+class Reader {
+public:
+    Reader(const Step& step) : step_(step) {
+        // Plane angles are radians unless a unit says degrees.
+        for (const Record& r : step.records()) {
+            if (r.type.empty() && !step.part(r, "PLANE_ANGLE_UNIT").empty() &&
+                !step.part(r, "CONVERSION_BASED_UNIT").empty()) {
+                const Args args = step.args(r, "CONVERSION_BASED_UNIT");
+                std::string name = args.string(args[0]);
+                std::transform(name.begin(), name.end(), name.begin(),
+                               [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+                if (name == "DEGREE" || name == "DEGREES") {
+                    angle_scale_ = std::numbers::pi / 180;
+                }
+            }
+        }
+    }
+
+    const Step& step() const noexcept { return step_; }
+
+    Vec3 point(const Record& from, std::uint64_t id) const {
+        const Record& r = step_.get(from, id);
+        const bool direction = r.type == "DIRECTION";
+        const Args args = step_.args(r, direction ? "DIRECTION" : "CARTESIAN_POINT");
+        const std::span<const Param> xyz = args.list(args[1]);
+        if (xyz.empty() || xyz.size() > 3) {
+            args.malformed("expected 1 to 3 coordinates");
+        }
+        Vec3 p{0, 0, 0};
+        for (std::size_t i = 0; i < xyz.size(); ++i) {
+            p[i] = args.number(xyz[i]);
+        }
+        return p;
+    }
+
+    /// An AXIS2_PLACEMENT_3D as origin and x, y, z axes.
+    std::array<double, 12> frame(const Record& from, std::uint64_t id) const {
+        const Record& r = step_.get(from, id);
+        const Args args = step_.args(r, "AXIS2_PLACEMENT_3D");
+        const Vec3 origin = point(r, args.ref(args[1]));
+        const Vec3 z = args.is_unset(2) ? Vec3{0, 0, 1} : normalized(point(r, args.ref(args[2])));
+        Vec3 reference = args.is_unset(3) ? Vec3{1, 0, 0} : point(r, args.ref(args[3]));
+        double along = reference[0] * z[0] + reference[1] * z[1] + reference[2] * z[2];
+        if (std::abs(along) > 0.999999 * std::sqrt(reference[0] * reference[0] +
+                                                   reference[1] * reference[1] +
+                                                   reference[2] * reference[2])) {
+            reference = std::abs(z[0]) < 0.9 ? Vec3{1, 0, 0} : Vec3{0, 1, 0};
+            along = reference[0] * z[0] + reference[1] * z[1] + reference[2] * z[2];
+        }
+        const Vec3 x = normalized({reference[0] - along * z[0], reference[1] - along * z[1],
+                                   reference[2] - along * z[2]});
+        const Vec3 y = cross(z, x);
+        return {origin[0], origin[1], origin[2], x[0], x[1], x[2],
+                y[0],      y[1],      y[2],      z[0], z[1], z[2]};
+    }
+
+    /// A frame as the transform from its coordinates to its parent's.
+    Matrix placement(const Record& from, std::uint64_t id) const {
+        const Record& r = step_.get(from, id);
+        if (!step_.is(r, "AXIS2_PLACEMENT_3D")) {
+            return identity;
+        }
+        const std::array<double, 12> f = frame(from, id);
+        return {f[3], f[6], f[9], f[0], f[4], f[7], f[10], f[1], f[5], f[8], f[11], f[2]};
+    }
+
+    double angle(double a) const noexcept { return a * angle_scale_; }
+
+private:
+    const Step& step_;
+    double angle_scale_ = 1;
+};
+
+/// One shape's topology and geometry, indices local to it.
+struct Shape {
+    std::uint64_t entity = 0;
+    std::vector<std::uint32_t> faces;
+    std::vector<std::uint32_t> loops;
+    std::vector<std::uint32_t> uses;
+    std::vector<std::uint32_t> edges;
+    std::vector<double> vertices;
+    std::vector<std::uint32_t> surfaces;
+    std::vector<std::uint32_t> curves;
+    std::vector<double> parameters;
+};
+
+/// Decodes the shells of one solid or sheet into a Shape.
+class ShapeDecoder {
+public:
+    ShapeDecoder(const Reader& reader, Shape& shape)
+        : reader_(reader), step_(reader.step()), shape_(shape) {}
+
+    void run(const Record& body) {
+        if (step_.is(body, "SHELL_BASED_SURFACE_MODEL")) {
+            const Args args = step_.args(body, "SHELL_BASED_SURFACE_MODEL");
+            for (const Param& shell : args.list(args[1])) {
+                this->shell(body, args.ref(shell), false);
+            }
+            return;
+        }
+        const bool voids = step_.is(body, "BREP_WITH_VOIDS");
+        const Args args = step_.args(body, voids ? "BREP_WITH_VOIDS"
+                                                 : step_.is(body, "FACETED_BREP")
+                                                       ? "FACETED_BREP"
+                                                       : "MANIFOLD_SOLID_BREP");
+        shell(body, args.ref(args[1]), false);
+        if (voids) {
+            for (const Param& shell : args.list(args[2])) {
+                this->shell(body, args.ref(shell), false);
+            }
+        }
+    }
+
+private:
+    void shell(const Record& from, std::uint64_t id, bool flip) {
+        const Record& r = step_.get(from, id);
+        if (r.type == "ORIENTED_CLOSED_SHELL" || r.type == "ORIENTED_OPEN_SHELL") {
+            const Args args = step_.args(r);
+            shell(r, args.ref(args[2]), flip != !args.flag(args[3]));
+            return;
+        }
+        if (r.type != "CLOSED_SHELL" && r.type != "OPEN_SHELL") {
+            step_.malformed(r, entity(id) + " is not a shell");
+        }
+        const Args args = step_.args(r);
+        for (const Param& face : args.list(args[1])) {
+            this->face(r, args.ref(face), flip);
+        }
+    }
+
+    void face(const Record& from, std::uint64_t id, bool flip) {
+        const Record& r = step_.get(from, id);
+        if (r.type == "ORIENTED_FACE") {
+            const Args args = step_.args(r);
+            face(r, args.ref(args[2]), flip != !args.flag(args[3]));
+            return;
+        }
+        const bool advanced = r.type == "ADVANCED_FACE" || r.type == "FACE_SURFACE";
+        if (!advanced && r.type != "FACE") {
+            step_.malformed(r, entity(id) + " is not a face");
+        }
+        const Args args = step_.args(r);
+        // A face is on its surface's normal side unless it says otherwise;
+        // flipped, its loops turn the other way too.
+        bool sense = (advanced ? args.flag(args[3]) : true) != flip;
+        std::uint32_t surface = advanced ? this->surface(r, args.ref(args[2])) : invalid;
+        const auto first_loop = static_cast<std::uint32_t>(shape_.loops.size() / 3);
+        for (const Param& bound : args.list(args[1])) {
+            const Record& b = step_.get(r, args.ref(bound));
+            if (b.type != "FACE_BOUND" && b.type != "FACE_OUTER_BOUND") {
+                step_.malformed(b, entity(b.id) + " is not a face bound");
+            }
+            const Args bound_args = step_.args(b);
+            loop(b, bound_args.ref(bound_args[1]), bound_args.flag(bound_args[2]) == !flip,
+                 b.type == "FACE_OUTER_BOUND");
+        }
+        const auto loops = static_cast<std::uint32_t>(shape_.loops.size() / 3) - first_loop;
+        if (surface == invalid) {
+            surface = plane(first_loop, loops);
+            sense = true;
+        }
+        shape_.faces.insert(shape_.faces.end(),
+                            {surface, first_loop, loops, static_cast<std::uint32_t>(sense)});
+    }
+
+    void loop(const Record& from, std::uint64_t id, bool forward, bool outer) {
+        const Record& r = step_.get(from, id);
+        const auto first = static_cast<std::uint32_t>(shape_.uses.size());
+        const Args args = step_.args(r);
+        if (r.type == "EDGE_LOOP") {
+            for (const Param& p : args.list(args[1])) {
+                const Record& oriented = step_.get(r, args.ref(p));
+                const Args o = step_.args(oriented, "ORIENTED_EDGE");
+                const std::uint32_t e = edge(oriented, o.ref(o[3]));
+                shape_.uses.push_back(2 * e + (o.flag(o[4]) ? 0 : 1));
+            }
+        } else if (r.type == "POLY_LOOP") {
+            const std::span<const Param> points = args.list(args[1]);
+            for (std::size_t i = 0; i < points.size(); ++i) {
+                const std::uint64_t a = args.ref(points[i]);
+                const std::uint64_t b = args.ref(points[(i + 1) % points.size()]);
+                shape_.uses.push_back(segment(r, a, b));
+            }
+        } else if (r.type == "VERTEX_LOOP") {
+            return;
+        } else {
+            step_.malformed(r, entity(id) + " is not a loop");
+        }
+        if (!forward) {
+            std::reverse(shape_.uses.begin() + first, shape_.uses.end());
+            for (auto it = shape_.uses.begin() + first; it != shape_.uses.end(); ++it) {
+                *it ^= 1;
+            }
+        }
+        shape_.loops.insert(shape_.loops.end(),
+                            {first, static_cast<std::uint32_t>(shape_.uses.size()) - first,
+                             static_cast<std::uint32_t>(outer)});
+    }
+
+    std::uint32_t edge(const Record& from, std::uint64_t id) {
+        const auto [it, added] = edges_.try_emplace(id, invalid);
+        if (!added) {
+            return it->second;
+        }
+        const Record& r = step_.get(from, id);
+        const Args args = step_.args(r, "EDGE_CURVE");
+        const std::uint32_t start = vertex(r, args.ref(args[1]));
+        const std::uint32_t end = vertex(r, args.ref(args[2]));
+        const std::uint32_t c = curve(r, args.ref(args[3]));
+        it->second = static_cast<std::uint32_t>(shape_.edges.size() / 4);
+        shape_.edges.insert(shape_.edges.end(),
+                            {c, start, end, static_cast<std::uint32_t>(args.flag(args[4]))});
+        return it->second;
+    }
+
+    /// The use of the straight edge between two points of a POLY_LOOP,
+    /// shared with the neighbouring face that runs it the other way.
+    std::uint32_t segment(const Record& from, std::uint64_t a, std::uint64_t b) {
+        if (const auto it = segments_.find({b, a}); it != segments_.end()) {
+            return 2 * it->second + 1;
+        }
+        const auto [it, added] = segments_.try_emplace({a, b}, invalid);
+        if (added) {
+            const std::uint32_t start = point_vertex(from, a);
+            const std::uint32_t end = point_vertex(from, b);
+            const auto c = static_cast<std::uint32_t>(shape_.curves.size() / 2);
+            shape_.curves.insert(shape_.curves.end(),
+                                 {static_cast<std::uint32_t>(CurveKind::Unsupported), 0});
+            it->second = static_cast<std::uint32_t>(shape_.edges.size() / 4);
+            shape_.edges.insert(shape_.edges.end(), {c, start, end, 1});
+        }
+        return 2 * it->second;
+    }
+
+    std::uint32_t vertex(const Record& from, std::uint64_t id) {
+        const Record& r = step_.get(from, id);
+        const Args args = step_.args(r, "VERTEX_POINT");
+        return point_vertex(r, args.ref(args[1]));
+    }
+
+    std::uint32_t point_vertex(const Record& from, std::uint64_t id) {
+        const auto [it, added] = vertices_.try_emplace(id, invalid);
+        if (added) {
+            const Vec3 p = reader_.point(from, id);
+            it->second = static_cast<std::uint32_t>(shape_.vertices.size() / 3);
+            shape_.vertices.insert(shape_.vertices.end(), p.begin(), p.end());
+        }
+        return it->second;
+    }
+
+    std::uint32_t add_parameters(std::span<const double> values) {
+        const auto offset = static_cast<std::uint32_t>(shape_.parameters.size());
+        shape_.parameters.insert(shape_.parameters.end(), values.begin(), values.end());
+        return offset;
+    }
+
+    /// The plane of a face given by its loops alone, facing the way its
+    /// first loop turns (Newell's normal).
+    std::uint32_t plane(std::uint32_t first_loop, std::uint32_t loops) {
+        Vec3 normal{0, 0, 0};
+        Vec3 origin{0, 0, 0};
+        if (loops > 0) {
+            const std::uint32_t first = shape_.loops[3 * first_loop];
+            const std::uint32_t count = shape_.loops[3 * first_loop + 1];
+            const auto start = [&](std::uint32_t use) {
+                const std::uint32_t e = shape_.uses[first + use] / 2;
+                const std::uint32_t v = shape_.edges[4 * e + 1 + (shape_.uses[first + use] & 1)];
+                return Vec3{shape_.vertices[3 * v], shape_.vertices[3 * v + 1],
+                            shape_.vertices[3 * v + 2]};
+            };
+            for (std::uint32_t i = 0; i < count; ++i) {
+                const Vec3 a = start(i);
+                const Vec3 b = start((i + 1) % count);
+                normal = {normal[0] + (a[1] - b[1]) * (a[2] + b[2]),
+                          normal[1] + (a[2] - b[2]) * (a[0] + b[0]),
+                          normal[2] + (a[0] - b[0]) * (a[1] + b[1])};
+            }
+            origin = count > 0 ? start(0) : origin;
+        }
+        const Vec3 z = normalized(normal);
+        SurfaceKind kind = SurfaceKind::Unsupported;
+        std::uint32_t offset = 0;
+        if (z != Vec3{0, 0, 0}) {
+            const Vec3 other = std::abs(z[0]) < 0.9 ? Vec3{1, 0, 0} : Vec3{0, 1, 0};
+            const Vec3 x = normalized(cross(other, z));
+            const Vec3 y = cross(z, x);
+            kind = SurfaceKind::Plane;
+            offset = add_parameters(std::array{origin[0], origin[1], origin[2], x[0], x[1], x[2],
+                                               y[0], y[1], y[2], z[0], z[1], z[2]});
+        }
+        shape_.surfaces.insert(shape_.surfaces.end(), {static_cast<std::uint32_t>(kind), offset});
+        return static_cast<std::uint32_t>(shape_.surfaces.size() / 2 - 1);
+    }
+
+    std::uint32_t surface(const Record& from, std::uint64_t id) {
+        const auto [it, added] = surfaces_.try_emplace(id, invalid);
+        if (!added) {
+            return it->second;
+        }
+        const Record& r = step_.get(from, id);
+        std::vector<double> p;
+        SurfaceKind kind = SurfaceKind::Unsupported;
+        const auto frame_and = [&](const Args& args, std::initializer_list<double> extra) {
+            const std::array<double, 12> f = reader_.frame(r, args.ref(args[1]));
+            p.assign(f.begin(), f.end());
+            p.insert(p.end(), extra);
+        };
+        if (r.type == "PLANE") {
+            const Args args = step_.args(r);
+            kind = SurfaceKind::Plane;
+            frame_and(args, {});
+        } else if (r.type == "CYLINDRICAL_SURFACE") {
+            const Args args = step_.args(r);
+            kind = SurfaceKind::Cylinder;
+            frame_and(args, {args.number(args[2])});
+        } else if (r.type == "CONICAL_SURFACE") {
+            const Args args = step_.args(r);
+            kind = SurfaceKind::Cone;
+            frame_and(args, {args.number(args[2]), reader_.angle(args.number(args[3]))});
+        } else if (r.type == "SPHERICAL_SURFACE") {
+            const Args args = step_.args(r);
+            kind = SurfaceKind::Sphere;
+            frame_and(args, {args.number(args[2])});
+        } else if (r.type == "TOROIDAL_SURFACE") {
+            const Args args = step_.args(r);
+            kind = SurfaceKind::Torus;
+            frame_and(args, {args.number(args[2]), args.number(args[3])});
+        } else if (step_.is(r, "B_SPLINE_SURFACE_WITH_KNOTS")) {
+            kind = SurfaceKind::BSpline;
+            spline_surface(r, p);
+        }
+        it->second = static_cast<std::uint32_t>(shape_.surfaces.size() / 2);
+        shape_.surfaces.insert(shape_.surfaces.end(),
+                               {static_cast<std::uint32_t>(kind),
+                                kind == SurfaceKind::Unsupported ? 0 : add_parameters(p)});
+        return it->second;
+    }
+
+    /// `count` knots from multiplicities and distinct values.
+    std::vector<double> knots(const Args& args, const Param& multiplicities, const Param& values,
+                              std::size_t count) const {
+        const std::span<const Param> m = args.list(multiplicities);
+        const std::span<const Param> k = args.list(values);
+        if (m.size() != k.size()) {
+            args.malformed("knot multiplicities and knots differ in number");
+        }
+        std::vector<double> out;
+        for (std::size_t i = 0; i < m.size(); ++i) {
+            const double times = args.number(m[i]);
+            if (!(times >= 1) || out.size() + static_cast<std::size_t>(times) > count) {
+                args.malformed("knot multiplicities do not match the control points");
+            }
+            out.insert(out.end(), static_cast<std::size_t>(times), args.number(k[i]));
+        }
+        if (out.size() != count) {
+            args.malformed("knot multiplicities do not match the control points");
+        }
+        return out;
+    }
+
+    /// Degrees and control points from B_SPLINE_SURFACE (the simple
+    /// entity's parameters from 1, the complex part's from 0), knots from
+    /// B_SPLINE_SURFACE_WITH_KNOTS and weights, if rational, from
+    /// RATIONAL_B_SPLINE_SURFACE.
+    void spline_surface(const Record& r, std::vector<double>& p) {
+        const bool simple = !r.type.empty();
+        const Args base = simple ? step_.args(r) : step_.args(r, "B_SPLINE_SURFACE");
+        const std::size_t o = simple ? 1 : 0;
+        const double du = base.number(base[o]);
+        const double dv = base.number(base[o + 1]);
+        const std::span<const Param> rows = base.list(base[o + 2]);
+        const std::size_t nu = rows.size();
+        const std::size_t nv = nu > 0 ? base.list(rows[0]).size() : 0;
+        if (!(du >= 1 && dv >= 1) || nu < du + 1 || nv < dv + 1) {
+            base.malformed("too few control points for the degree");
+        }
+        const Args with_knots =
+            simple ? step_.args(r) : step_.args(r, "B_SPLINE_SURFACE_WITH_KNOTS");
+        const std::size_t k = simple ? 8 : 0;
+        const auto udegree = static_cast<std::size_t>(du);
+        const auto vdegree = static_cast<std::size_t>(dv);
+        const std::vector<double> uk =
+            knots(with_knots, with_knots[k], with_knots[k + 2], nu + udegree + 1);
+        const std::vector<double> vk =
+            knots(with_knots, with_knots[k + 1], with_knots[k + 3], nv + vdegree + 1);
+        std::vector<double> weights;
+        if (!simple && !step_.part(r, "RATIONAL_B_SPLINE_SURFACE").empty()) {
+            const Args rational = step_.args(r, "RATIONAL_B_SPLINE_SURFACE");
+            for (const Param& row : rational.list(rational[0])) {
+                for (const Param& w : rational.list(row)) {
+                    weights.push_back(rational.number(w));
+                }
+            }
+            if (weights.size() != nu * nv) {
+                rational.malformed("one weight per control point expected");
+            }
+        }
+        p = {du, dv, static_cast<double>(nu), static_cast<double>(nv)};
+        p.insert(p.end(), uk.begin(), uk.end());
+        p.insert(p.end(), vk.begin(), vk.end());
+        for (std::size_t i = 0; i < nu; ++i) {
+            const std::span<const Param> row = base.list(rows[i]);
+            if (row.size() != nv) {
+                base.malformed("control point rows differ in length");
+            }
+            for (std::size_t j = 0; j < nv; ++j) {
+                const Vec3 q = reader_.point(r, base.ref(row[j]));
+                p.insert(p.end(), {q[0], q[1], q[2], weights.empty() ? 1.0 : weights[i * nv + j]});
+            }
+        }
+    }
+
+    std::uint32_t curve(const Record& from, std::uint64_t id) {
+        const auto [it, added] = curves_.try_emplace(id, invalid);
+        if (!added) {
+            return it->second;
+        }
+        const Record* r = &step_.get(from, id);
+        // The 3D curve of a surface curve, and the basis of a trimmed one:
+        // the edge's vertices bound it.
+        for (int depth = 0; depth < max_depth; ++depth) {
+            if (r->type == "SURFACE_CURVE" || r->type == "SEAM_CURVE" ||
+                r->type == "INTERSECTION_CURVE" || r->type == "TRIMMED_CURVE") {
+                const Args args = step_.args(*r);
+                r = &step_.get(*r, args.ref(args[1]));
+            } else {
+                break;
+            }
+        }
+        std::vector<double> p;
+        CurveKind kind = CurveKind::Unsupported;
+        if (r->type == "LINE") {
+            const Args args = step_.args(*r);
+            const Vec3 origin = reader_.point(*r, args.ref(args[1]));
+            const Record& v = step_.get(*r, args.ref(args[2]));
+            const Args vector = step_.args(v, "VECTOR");
+            const Vec3 d = normalized(reader_.point(v, vector.ref(vector[1])));
+            kind = CurveKind::Line;
+            p = {origin[0], origin[1], origin[2], d[0], d[1], d[2]};
+        } else if (r->type == "CIRCLE" || r->type == "ELLIPSE") {
+            const Args args = step_.args(*r);
+            const Record& placement = step_.get(*r, args.ref(args[1]));
+            if (step_.is(placement, "AXIS2_PLACEMENT_3D")) {
+                const std::array<double, 12> f = reader_.frame(*r, placement.id);
+                kind = r->type == "CIRCLE" ? CurveKind::Circle : CurveKind::Ellipse;
+                p.assign(f.begin(), f.end());
+                p.push_back(args.number(args[2]));
+                if (kind == CurveKind::Ellipse) {
+                    p.push_back(args.number(args[3]));
+                }
+            }
+        } else if (r->type == "POLYLINE") {
+            const Args args = step_.args(*r);
+            const std::span<const Param> points = args.list(args[1]);
+            if (points.size() >= 2) {
+                kind = CurveKind::BSpline;
+                const std::size_t n = points.size();
+                p = {1, static_cast<double>(n), 0};
+                for (std::size_t i = 0; i < n; ++i) {
+                    p.push_back(static_cast<double>(i));
+                }
+                p.push_back(static_cast<double>(n - 1));
+                for (const Param& point : points) {
+                    const Vec3 q = reader_.point(*r, args.ref(point));
+                    p.insert(p.end(), {q[0], q[1], q[2], 1});
+                }
+            }
+        } else if (step_.is(*r, "B_SPLINE_CURVE_WITH_KNOTS")) {
+            kind = CurveKind::BSpline;
+            spline_curve(*r, p);
+        }
+        it->second = static_cast<std::uint32_t>(shape_.curves.size() / 2);
+        shape_.curves.insert(shape_.curves.end(),
+                             {static_cast<std::uint32_t>(kind),
+                              kind == CurveKind::Unsupported ? 0 : add_parameters(p)});
+        return it->second;
+    }
+
+    void spline_curve(const Record& r, std::vector<double>& p) {
+        const bool simple = !r.type.empty();
+        const Args base = simple ? step_.args(r) : step_.args(r, "B_SPLINE_CURVE");
+        const std::size_t o = simple ? 1 : 0;
+        const double degree = base.number(base[o]);
+        const std::span<const Param> points = base.list(base[o + 1]);
+        const std::size_t n = points.size();
+        if (!(degree >= 1) || n < degree + 1) {
+            base.malformed("too few control points for the degree");
+        }
+        const Args with_knots =
+            simple ? step_.args(r) : step_.args(r, "B_SPLINE_CURVE_WITH_KNOTS");
+        const std::size_t k = simple ? 6 : 0;
+        const std::vector<double> kv = knots(with_knots, with_knots[k], with_knots[k + 1],
+                                             n + static_cast<std::size_t>(degree) + 1);
+        std::vector<double> weights;
+        if (!simple && !step_.part(r, "RATIONAL_B_SPLINE_CURVE").empty()) {
+            const Args rational = step_.args(r, "RATIONAL_B_SPLINE_CURVE");
+            for (const Param& w : rational.list(rational[0])) {
+                weights.push_back(rational.number(w));
+            }
+            if (weights.size() != n) {
+                rational.malformed("one weight per control point expected");
+            }
+        }
+        p = {degree, static_cast<double>(n)};
+        p.insert(p.end(), kv.begin(), kv.end());
+        for (std::size_t i = 0; i < n; ++i) {
+            const Vec3 q = reader_.point(r, base.ref(points[i]));
+            p.insert(p.end(), {q[0], q[1], q[2], weights.empty() ? 1.0 : weights[i]});
+        }
+    }
+
+    const Reader& reader_;
+    const Step& step_;
+    Shape& shape_;
+    std::unordered_map<std::uint64_t, std::uint32_t> edges_;
+    std::unordered_map<std::uint64_t, std::uint32_t> vertices_;
+    std::unordered_map<std::uint64_t, std::uint32_t> surfaces_;
+    std::unordered_map<std::uint64_t, std::uint32_t> curves_;
+    std::map<std::pair<std::uint64_t, std::uint64_t>, std::uint32_t> segments_;
+};
+
+/// The representations of the file, the placements between them, and the
+/// product names they carry.
+class Assembly {
+public:
+    explicit Assembly(const Reader& reader) : reader_(reader), step_(reader.step()) {
+        const std::vector<Record>& records = step_.records();
+        for (const Record& r : records) {
+            if (is_representation(r)) {
+                const Args args = step_.args(r);
+                if (args.size() < 2 || args[1].kind != Param::Kind::List) {
+                    continue;
+                }
+                const auto rep = static_cast<std::uint32_t>(reps_.size());
+                reps_.emplace(r.id, rep);
+                for (const Param& item : args.list(args[1])) {
+                    if (item.kind == Param::Kind::Ref) {
+                        items_.emplace(item.ref, rep);
+                    }
+                }
+            }
+        }
+        parent_.resize(reps_.size());
+        for (std::uint32_t i = 0; i < parent_.size(); ++i) {
+            parent_[i] = i;
+        }
+        // Relationships without a transformation make one representation
+        // of two.
+        for (const Record& r : records) {
+            if (r.type == "SHAPE_REPRESENTATION_RELATIONSHIP" ||
+                r.type == "REPRESENTATION_RELATIONSHIP") {
+                const Args args = step_.args(r);
+                const std::uint32_t a = rep(args.ref(args[2]));
+                const std::uint32_t b = rep(args.ref(args[3]));
+                if (a != invalid && b != invalid) {
+                    parent_[find(a)] = find(b);
+                }
+            }
+        }
+        placements_.resize(reps_.size());
+        names_.resize(reps_.size());
+        for (const Record& r : records) {
+            if (r.type.empty() &&
+                !step_.part(r, "REPRESENTATION_RELATIONSHIP_WITH_TRANSFORMATION").empty()) {
+                place_by_relationship(r);
+            } else if (r.type == "MAPPED_ITEM") {
+                place_by_mapped_item(r);
+            } else if (r.type == "SHAPE_DEFINITION_REPRESENTATION") {
+                name_by_product(r);
+            }
+        }
+    }
+
+    /// The representation group holding `item`, or `invalid`.
+    std::uint32_t group_of(std::uint64_t item) {
+        const auto it = items_.find(item);
+        return it == items_.end() ? invalid : find(it->second);
+    }
+
+    const std::string& name(std::uint32_t group) const { return names_[group]; }
+
+    /// Where a group is placed in the model: once for every path from it up
+    /// to a group placed nowhere.
+    const std::vector<Matrix>& instances(std::uint32_t group) {
+        const auto [it, added] = instances_.try_emplace(group);
+        if (!added) {
+            return it->second;
+        }
+        std::vector<Matrix> out;
+        if (placements_[group].empty() || visiting_.size() > 256 ||
+            std::find(visiting_.begin(), visiting_.end(), group) != visiting_.end()) {
+            out.push_back(identity);
+        } else {
+            visiting_.push_back(group);
+            for (const auto& [parent, transform] : std::vector(placements_[group])) {
+                for (const Matrix& m : std::vector(instances(parent))) {
+                    out.push_back(multiply(m, transform));
+                }
+            }
+            visiting_.pop_back();
+        }
+        auto& slot = instances_[group];
+        slot = std::move(out);
+        return slot;
+    }
+
+private:
+    bool is_representation(const Record& r) const {
+        const std::string_view t = r.type;
+        return t.size() >= 14 && t.substr(t.size() - 14) == "REPRESENTATION" &&
+               t.find("DEFINITION_REPRESENTATION") == std::string_view::npos &&
+               t.find("RELATIONSHIP") == std::string_view::npos;
+    }
+
+    std::uint32_t rep(std::uint64_t id) const {
+        const auto it = reps_.find(id);
+        return it == reps_.end() ? invalid : it->second;
+    }
+
+    std::uint32_t find(std::uint32_t r) {
+        while (parent_[r] != r) {
+            parent_[r] = parent_[parent_[r]];
+            r = parent_[r];
+        }
+        return r;
+    }
+
+    /// A child representation placed in a parent by the frames of an item
+    /// defined transformation, the one in the child mapped onto the other.
+    void place_by_relationship(const Record& r) {
+        const Args relation = step_.args(r, "REPRESENTATION_RELATIONSHIP");
+        const Args with = step_.args(r, "REPRESENTATION_RELATIONSHIP_WITH_TRANSFORMATION");
+        const std::uint32_t child = rep(relation.ref(relation[2]));
+        const std::uint32_t parent = rep(relation.ref(relation[3]));
+        const Record& t = step_.get(r, with.ref(with[0]));
+        if (child == invalid || parent == invalid || t.type != "ITEM_DEFINED_TRANSFORMATION") {
+            return;
+        }
+        const Args items = step_.args(t);
+        std::uint64_t origin = items.ref(items[2]);
+        std::uint64_t target = items.ref(items[3]);
+        if (group_of(origin) != find(child) && group_of(target) == find(child)) {
+            std::swap(origin, target);
+        }
+        const Matrix from = inverse(reader_.placement(t, origin));
+        add_placement(child, parent, multiply(reader_.placement(t, target), from));
+    }
+
+    void place_by_mapped_item(const Record& r) {
+        const std::uint32_t parent = group_of(r.id);
+        const Args args = step_.args(r);
+        const Record& map = step_.get(r, args.ref(args[1]));
+        const Args map_args = step_.args(map, "REPRESENTATION_MAP");
+        const std::uint32_t child = rep(map_args.ref(map_args[1]));
+        if (parent == invalid || child == invalid) {
+            return;
+        }
+        add_placement(child, parent,
+                      multiply(reader_.placement(r, args.ref(args[2])),
+                               inverse(reader_.placement(map, map_args.ref(map_args[0])))));
+    }
+
+    void add_placement(std::uint32_t child, std::uint32_t parent, const Matrix& transform) {
+        const std::uint32_t c = find(child);
+        const std::uint32_t p = find(parent);
+        if (c != p) {
+            placements_[c].emplace_back(p, transform);
+        }
+    }
+
+    /// SHAPE_DEFINITION_REPRESENTATION -> PRODUCT_DEFINITION_SHAPE ->
+    /// PRODUCT_DEFINITION -> its formation -> PRODUCT.
+    void name_by_product(const Record& r) {
+        const Args args = step_.args(r);
+        const std::uint32_t used = rep(args.ref(args[1]));
+        if (used == invalid || args[0].kind != Param::Kind::Ref) {
+            return;
+        }
+        const Record* shape = step_.find(args[0].ref);
+        if (shape == nullptr || shape->type != "PRODUCT_DEFINITION_SHAPE") {
+            return;
+        }
+        const Args shape_args = step_.args(*shape);
+        const Record* definition = shape_args[2].kind == Param::Kind::Ref
+                                       ? step_.find(shape_args[2].ref)
+                                       : nullptr;
+        if (definition == nullptr || definition->type.rfind("PRODUCT_DEFINITION", 0) != 0) {
+            return;
+        }
+        const Args definition_args = step_.args(*definition);
+        const Record* formation = definition_args[2].kind == Param::Kind::Ref
+                                      ? step_.find(definition_args[2].ref)
+                                      : nullptr;
+        if (formation == nullptr) {
+            return;
+        }
+        const Args formation_args = step_.args(*formation);
+        const Record* product = formation_args[2].kind == Param::Kind::Ref
+                                    ? step_.find(formation_args[2].ref)
+                                    : nullptr;
+        if (product == nullptr || product->type != "PRODUCT") {
+            return;
+        }
+        const Args product_args = step_.args(*product);
+        std::string name = product_args.string(product_args[1]);
+        if (name.empty()) {
+            name = product_args.string(product_args[0]);
+        }
+        std::string& slot = names_[find(used)];
+        if (slot.empty()) {
+            slot = std::move(name);
+        }
+    }
+
+    const Reader& reader_;
+    const Step& step_;
+    /// Representations by entity, and the one holding each item.
+    std::unordered_map<std::uint64_t, std::uint32_t> reps_;
+    std::unordered_map<std::uint64_t, std::uint32_t> items_;
+    std::vector<std::uint32_t> parent_;
+    std::vector<std::vector<std::pair<std::uint32_t, Matrix>>> placements_;
+    std::vector<std::string> names_;
+    std::unordered_map<std::uint32_t, std::vector<Matrix>> instances_;
+    std::vector<std::uint32_t> visiting_;
+};
+
+} // namespace
+
+Brep read_step(const std::string& path, ThreadPool* pool) {
+    const MappedFile file = MappedFile::open(path);
+    const std::string_view text(reinterpret_cast<const char*>(file.data()), file.size());
+    const Step step(path, text, pool);
+    const Reader reader(step);
+
+    std::vector<const Record*> bodies;
+    for (const Record& r : step.records()) {
+        if (r.type == "MANIFOLD_SOLID_BREP" || r.type == "FACETED_BREP" ||
+            r.type == "BREP_WITH_VOIDS" || r.type == "SHELL_BASED_SURFACE_MODEL" ||
+            (r.type.empty() && (!step.part(r, "MANIFOLD_SOLID_BREP").empty() ||
+                                !step.part(r, "BREP_WITH_VOIDS").empty()))) {
+            bodies.push_back(&r);
+        }
+    }
+    std::vector<Shape> shapes(bodies.size());
+    parallel_for(pool, bodies.size(), 1, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; ++i) {
+            shapes[i].entity = bodies[i]->id;
+            ShapeDecoder(reader, shapes[i]).run(*bodies[i]);
+        }
+    });
+
+    Assembly assembly(reader);
+    std::vector<std::uint32_t> body_rows;
+    std::vector<double> transforms;
+    std::string names;
+    std::vector<std::uint32_t> shape_rows;
+    std::vector<std::uint32_t> faces, loops, uses, edges, surfaces, curves;
+    std::vector<double> vertices, parameters;
+    for (std::size_t s = 0; s < shapes.size(); ++s) {
+        const Shape& shape = shapes[s];
+        const auto base = [](const auto& v, std::size_t width) {
+            return static_cast<std::uint32_t>(v.size() / width);
+        };
+        const std::uint32_t face_base = base(faces, 4);
+        const std::uint32_t loop_base = base(loops, 3);
+        const std::uint32_t use_base = base(uses, 1);
+        const std::uint32_t edge_base = base(edges, 4);
+        const std::uint32_t vertex_base = base(vertices, 3);
+        const std::uint32_t surface_base = base(surfaces, 2);
+        const std::uint32_t curve_base = base(curves, 2);
+        const std::uint32_t parameter_base = base(parameters, 1);
+        shape_rows.insert(shape_rows.end(),
+                          {face_base, static_cast<std::uint32_t>(shape.faces.size() / 4)});
+        for (std::size_t i = 0; i < shape.faces.size(); i += 4) {
+            faces.insert(faces.end(), {shape.faces[i] + surface_base,
+                                       shape.faces[i + 1] + loop_base, shape.faces[i + 2],
+                                       shape.faces[i + 3]});
+        }
+        for (std::size_t i = 0; i < shape.loops.size(); i += 3) {
+            loops.insert(loops.end(),
+                         {shape.loops[i] + use_base, shape.loops[i + 1], shape.loops[i + 2]});
+        }
+        for (const std::uint32_t use : shape.uses) {
+            uses.push_back(use + 2 * edge_base);
+        }
+        for (std::size_t i = 0; i < shape.edges.size(); i += 4) {
+            edges.insert(edges.end(), {shape.edges[i] + curve_base,
+                                       shape.edges[i + 1] + vertex_base,
+                                       shape.edges[i + 2] + vertex_base, shape.edges[i + 3]});
+        }
+        vertices.insert(vertices.end(), shape.vertices.begin(), shape.vertices.end());
+        for (std::size_t i = 0; i < shape.surfaces.size(); i += 2) {
+            surfaces.insert(surfaces.end(),
+                            {shape.surfaces[i], shape.surfaces[i + 1] + parameter_base});
+        }
+        for (std::size_t i = 0; i < shape.curves.size(); i += 2) {
+            curves.insert(curves.end(), {shape.curves[i], shape.curves[i + 1] + parameter_base});
+        }
+        parameters.insert(parameters.end(), shape.parameters.begin(), shape.parameters.end());
+        if (parameters.size() >= invalid || uses.size() >= invalid / 2) {
+            throw FormatError(path + ": too many entities");
+        }
+
+        // One body for each place the shape's representation goes.
+        const std::uint32_t group = assembly.group_of(shape.entity);
+        std::string name = group != invalid ? assembly.name(group) : std::string();
+        if (name.empty()) {
+            const Args args = step.args(*bodies[s], bodies[s]->type.empty()
+                                                        ? "REPRESENTATION_ITEM"
+                                                        : bodies[s]->type);
+            name = args.string(args[0]);
+        }
+        if (name.empty()) {
+            name = entity(shape.entity);
+        }
+        const std::vector<Matrix> single = {identity};
+        for (const Matrix& m : group != invalid ? assembly.instances(group) : single) {
+            body_rows.insert(body_rows.end(), {static_cast<std::uint32_t>(s),
+                                               static_cast<std::uint32_t>(names.size()),
+                                               static_cast<std::uint32_t>(name.size())});
+            transforms.insert(transforms.end(), m.begin(), m.end());
+            names += name;
+        }
+    }
+
+    Brep::Arrays arrays;
+    arrays.bodies = Buffer::adopt(std::move(body_rows), 3);
+    arrays.transforms = Buffer::adopt(std::move(transforms), 12);
+    arrays.names = Buffer::copy_of(
+        std::span(reinterpret_cast<const std::uint8_t*>(names.data()), names.size()));
+    arrays.shapes = Buffer::adopt(std::move(shape_rows), 2);
+    arrays.faces = Buffer::adopt(std::move(faces), 4);
+    arrays.loops = Buffer::adopt(std::move(loops), 3);
+    arrays.edge_uses = Buffer::adopt(std::move(uses));
+    arrays.edges = Buffer::adopt(std::move(edges), 4);
+    arrays.vertices = Buffer::adopt(std::move(vertices), 3);
+    arrays.surfaces = Buffer::adopt(std::move(surfaces), 2);
+    arrays.curves = Buffer::adopt(std::move(curves), 2);
+    arrays.parameters = Buffer::adopt(std::move(parameters));
+    try {
+        return Brep::from_arrays(std::move(arrays));
+    } catch (const FormatError& e) {
+        throw FormatError(path + ": " + e.what());
+    }
+}
+
+} // namespace rebelflow
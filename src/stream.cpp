@@ -0,0 +1,461 @@
+#include "rebelflow/stream.hpp"
+
+#include "rebelflow/arena.hpp"
+#include "rebelflow/bounded_queue.hpp"
+#include "rebelflow/node.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+
+namespace rebelflow {
+
+namespace {
+
+enum class Phase : std::uint8_t { Before, Source, PerChunk, Sink, After };
+
+/// One chunk on its way through the pipeline: the source's chunk on the way
+/// to the workers, then the values feeding each sink.
+struct ChunkItem {
+    std::uint64_t seq = 0;
+    std::vector<Value> values;
+};
+
+/// One per-chunk node. Inputs are `in_count` entries of the input table.
+struct Step {
+    NodeId node;
+    const NodeType* type;
+    std::span<const Value> params;
+    std::uint32_t in_begin, in_count;
+    std::uint32_t out_begin, out_count;
+    const void* state;
+};
+
+/// A per-chunk input: a value fixed for the whole run, or a worker slot.
+struct InputRef {
+    const Value* fixed;
+    std::uint32_t slot;
+};
+
+/// Counts chunks between the source and the sinks. acquire() blocks while
+/// `limit` are outstanding; the sink releases one per consumed chunk.
+class Credits {
+public:
+    explicit Credits(std::size_t limit) : limit_(std::max<std::size_t>(limit, 1)) {}
+
+    /// Returns false once cancelled.
+    bool acquire() {
+        std::unique_lock lock(mutex_);
+        cv_.wait(lock, [&] { return cancelled_ || in_use_ < limit_; });
+        if (cancelled_) {
+            return false;
+        }
+        peak_ = std::max(peak_, ++in_use_);
+        return true;
+    }
+
+    void release() {
+        {
+            std::lock_guard lock(mutex_);
+            --in_use_;
+        }
+        cv_.notify_one();
+    }
+
+    void cancel() {
+        {
+            std::lock_guard lock(mutex_);
+            cancelled_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    std::size_t peak() const {
+        std::lock_guard lock(mutex_);
+        return peak_;
+    }
+
+private:
+    const std::size_t limit_;
+    mutable std::mutex mutex_;
+    std::condition_variable cv_;
+    std::size_t in_use_ = 0;
+    std::size_t peak_ = 0;
+    bool cancelled_ = false;
+};
+
+/// Keeps the first failure of any pipeline thread, attributed to a node.
+class FirstError {
+public:
+    /// Call from inside a catch block.
+    void capture(NodeId node, const std::string& type) {
+        try {
+            rethrow_as_execution_error(node, type);
+        } catch (...) {
+            std::lock_guard lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+
+    void rethrow_if_set() {
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::exception_ptr error_;
+};
+
+const Value none{};
+
+/// Input pointers for a node evaluated once. Streamed inputs (whose producer
+/// keeps no outputs) and unconnected ones resolve to `none` and the port
+/// default respectively.
+std::vector<const Value*> gather_inputs(const Graph& graph,
+                                        NodeId id,
+                                        const std::vector<std::vector<Value>>& outputs) {
+    const NodeType& type = graph.type(id);
+    const std::span<const PortRef> sources = graph.input_sources(id);
+    std::vector<const Value*> inputs(sources.size());
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        const PortRef& src = sources[i];
+        if (!src.valid()) {
+            inputs[i] = &type.inputs[i].default_value;
+        } else if (outputs[src.node].empty()) {
+            inputs[i] = &none;
+        } else {
+            inputs[i] = &outputs[src.node][src.port];
+        }
+    }
+    return inputs;
+}
+
+} // namespace
+
+StreamExecutor::StreamExecutor(StreamOptions options) : options_(options) {}
+
+StreamStats StreamExecutor::run(const Graph& graph) {
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<NodeId>& order = graph.topological_order();
+    outputs_.assign(graph.id_bound(), {});
+
+    // Phases, in topological order so producers are classified first.
+    NodeId source = invalid_node;
+    for (NodeId id : order) {
+        if (graph.type(id).open_source) {
+            if (source != invalid_node) {
+                throw GraphError("streaming needs exactly one source node; found nodes " +
+                                 std::to_string(source) + " and " + std::to_string(id));
+            }
+            source = id;
+        }
+    }
+    if (source == invalid_node) {
+        throw GraphError("streaming needs a source node");
+    }
+
+    std::vector<Phase> phase(graph.id_bound(), Phase::Before);
+    std::vector<NodeId> sinks;
+    std::vector<std::uint32_t> sink_port(graph.id_bound(), 0);
+    for (NodeId id : order) {
+        if (id == source) {
+            phase[id] = Phase::Source;
+            continue;
+        }
+        const NodeType& type = graph.type(id);
+        const std::span<const PortRef> sources = graph.input_sources(id);
+        std::size_t streamed = 0;
+        bool after = false;
+        for (std::uint32_t i = 0; i < sources.size(); ++i) {
+            if (!sources[i].valid()) {
+                continue;
+            }
+            const Phase p = phase[sources[i].node];
+            if (p == Phase::Source || p == Phase::PerChunk) {
+                ++streamed;
+                sink_port[id] = i;
+            } else if (p == Phase::Sink || p == Phase::After) {
+                after = true;
+            }
+        }
+        if (streamed == 0) {
+            phase[id] = after ? Phase::After : Phase::Before;
+        } else if (after) {
+            throw GraphError("node " + std::to_string(id) + " (" + type.name +
+                             ") mixes streamed inputs with results of the finished stream");
+        } else if (type.open_sink) {
+            if (streamed > 1) {
+                throw GraphError("sink node " + std::to_string(id) + " (" + type.name +
+                                 ") has more than one streamed input");
+            }
+            phase[id] = Phase::Sink;
+            sinks.push_back(id);
+        } else {
+            phase[id] = Phase::PerChunk;
+        }
+    }
+
+    // Prepared once for the whole stream and shared by every worker.
+    std::vector<std::shared_ptr<const void>> states(graph.id_bound());
+    for (NodeId id : order) {
+        const NodeType& type = graph.type(id);
+        if (type.prepare) {
+            try {
+                states[id] = type.prepare(graph.params(id));
+            } catch (...) {
+                rethrow_as_execution_error(id, type.name);
+            }
+        }
+    }
+
+    Arena arena;
+    auto evaluate = [&](NodeId id) {
+        const NodeType& type = graph.type(id);
+        outputs_[id].assign(type.outputs.size(), Value{});
+        const std::vector<const Value*> inputs = gather_inputs(graph, id, outputs_);
+        NodeContext ctx(id, inputs, graph.params(id), outputs_[id], arena, states[id].get());
+        try {
+            type.compute(ctx);
+        } catch (...) {
+            rethrow_as_execution_error(id, type.name);
+        }
+    };
+
+    for (NodeId id : order) {
+        if (phase[id] == Phase::Before) {
+            evaluate(id);
+        }
+    }
+
+    // Open the source and the sinks with their once-evaluated inputs.
+    std::unique_ptr<ChunkSource> reader;
+    {
+        const NodeType& type = graph.type(source);
+        const std::vector<const Value*> inputs = gather_inputs(graph, source, outputs_);
+        std::vector<Value> unused(type.outputs.size());
+        NodeContext ctx(source, inputs, graph.params(source), unused, arena,
+                        states[source].get());
+        try {
+            reader = type.open_source(ctx);
+        } catch (...) {
+            rethrow_as_execution_error(source, type.name);
+        }
+    }
+    std::vector<std::unique_ptr<ChunkSink>> writers;
+    for (NodeId id : sinks) {
+        const NodeType& type = graph.type(id);
+        outputs_[id].assign(type.outputs.size(), Value{});
+        const std::vector<const Value*> inputs = gather_inputs(graph, id, outputs_);
+        NodeContext ctx(id, inputs, graph.params(id), outputs_[id], arena, states[id].get());
+        try {
+            writers.push_back(type.open_sink(ctx));
+        } catch (...) {
+            rethrow_as_execution_error(id, type.name);
+        }
+    }
+
+    // Per-chunk program. Slot 0 holds the chunk; each per-chunk node owns a
+    // run of slots for its outputs. Before-phase values are referenced in
+    // place: outputs_ is not resized again during the run.
+    std::vector<Step> steps;
+    std::vector<InputRef> refs;
+    std::vector<std::uint32_t> slot_begin(graph.id_bound(), 0);
+    std::uint32_t slot_count = 1;
+    auto resolve = [&](const PortRef& src, const Value& fallback) -> InputRef {
+        if (!src.valid()) {
+            return {&fallback, 0};
+        }
+        switch (phase[src.node]) {
+        case Phase::Source: return src.port == 0 ? InputRef{nullptr, 0} : InputRef{&none, 0};
+        case Phase::PerChunk: return {nullptr, slot_begin[src.node] + src.port};
+        default: return {&outputs_[src.node][src.port], 0};
+        }
+    };
+    for (NodeId id : order) {
+        if (phase[id] != Phase::PerChunk) {
+            continue;
+        }
+        const NodeType& type = graph.type(id);
+        const std::span<const PortRef> sources = graph.input_sources(id);
+        Step step{id, &type, graph.params(id),
+                  static_cast<std::uint32_t>(refs.size()), static_cast<std::uint32_t>(sources.size()),
+                  slot_count, static_cast<std::uint32_t>(type.outputs.size()),
+                  states[id].get()};
+        for (std::size_t i = 0; i < sources.size(); ++i) {
+            refs.push_back(resolve(sources[i], type.inputs[i].default_value));
+        }
+        slot_begin[id] = slot_count;
+        slot_count += step.out_count;
+        steps.push_back(step);
+    }
+    std::vector<InputRef> sink_refs;
+    for (NodeId id : sinks) {
+        const PortRef& src = graph.input_sources(id)[sink_port[id]];
+        sink_refs.push_back(resolve(src, none));
+    }
+
+    // Pipeline: source thread -> workers -> sinks on this thread.
+    const std::size_t in_flight = std::max<std::size_t>(options_.max_in_flight, 1);
+    const unsigned worker_count = options_.workers != 0
+                                      ? options_.workers
+                                      : std::max(1u, std::thread::hardware_concurrency());
+    Credits credits(in_flight);
+    BoundedQueue<ChunkItem> work(in_flight);
+    BoundedQueue<ChunkItem> done(in_flight);
+    FirstError error;
+    auto cancel = [&] {
+        credits.cancel();
+        work.close();
+        done.close();
+    };
+
+    auto produce = [&] {
+        try {
+            for (std::uint64_t seq = 0; credits.acquire(); ++seq) {
+                ChunkItem item{seq, std::vector<Value>(1)};
+                if (!reader->next(item.values[0]) || !work.push(std::move(item))) {
+                    break;
+                }
+            }
+        } catch (...) {
+            error.capture(source, graph.type(source).name);
+            cancel();
+        }
+        work.close();
+    };
+
+    std::atomic<unsigned> live_workers{worker_count};
+    auto transform = [&] {
+        std::vector<Value> slots(slot_count);
+        std::vector<const Value*> inputs(refs.size());
+        for (std::size_t i = 0; i < refs.size(); ++i) {
+            inputs[i] = refs[i].fixed != nullptr ? refs[i].fixed : &slots[refs[i].slot];
+        }
+        Arena scratch;
+        const Step* current = nullptr;
+        try {
+            while (std::optional<ChunkItem> item = work.pop()) {
+                slots[0] = std::move(item->values[0]);
+                for (const Step& step : steps) {
+                    current = &step;
+                    std::span<Value> outs(slots.data() + step.out_begin, step.out_count);
+                    std::fill(outs.begin(), outs.end(), Value{});
+                    NodeContext ctx(step.node, {inputs.data() + step.in_begin, step.in_count},
+                                    step.params, outs, scratch, step.state);
+                    step.type->compute(ctx);
+                }
+                current = nullptr;
+                ChunkItem out{item->seq, {}};
+                out.values.reserve(sink_refs.size());
+                for (const InputRef& ref : sink_refs) {
+                    out.values.push_back(ref.fixed != nullptr ? *ref.fixed : slots[ref.slot]);
+                }
+                // Drop this chunk's intermediates now rather than when the
+                // next chunk overwrites them.
+                std::fill(slots.begin(), slots.end(), Value{});
+                scratch.reset();
+                if (!done.push(std::move(out))) {
+                    break;
+                }
+            }
+        } catch (...) {
+            if (current != nullptr) {
+                error.capture(current->node, current->type->name);
+            } else {
+                error.capture(source, graph.type(source).name);
+            }
+            cancel();
+        }
+        if (live_workers.fetch_sub(1) == 1) {
+            done.close();
+        }
+    };
+
+    std::size_t chunks = 0;
+    std::vector<std::jthread> threads;
+    try {
+        threads.reserve(worker_count + 1);
+        threads.emplace_back(produce);
+        for (unsigned i = 0; i < worker_count; ++i) {
+            threads.emplace_back(transform);
+        }
+    } catch (...) {
+        // Could not start every thread: stop the ones that did. Destroying
+        // a jthread joins it.
+        cancel();
+        threads.clear();
+        throw;
+    }
+
+    std::map<std::uint64_t, std::vector<Value>> reorder;
+    std::uint64_t next_seq = 0;
+    std::size_t current_sink = 0;
+    try {
+        while (std::optional<ChunkItem> item = done.pop()) {
+            reorder.emplace(item->seq, std::move(item->values));
+            for (auto it = reorder.find(next_seq); it != reorder.end();
+                 it = reorder.find(next_seq)) {
+                for (current_sink = 0; current_sink < writers.size(); ++current_sink) {
+                    writers[current_sink]->consume(it->second[current_sink]);
+                }
+                reorder.erase(it);
+                ++next_seq;
+                ++chunks;
+                credits.release();
+            }
+        }
+    } catch (...) {
+        const NodeId failed = current_sink < sinks.size() ? sinks[current_sink] : source;
+        error.capture(failed, graph.type(failed).name);
+        cancel();
+    }
+    threads.clear();
+    error.rethrow_if_set();
+
+    for (std::size_t i = 0; i < sinks.size(); ++i) {
+        const NodeId id = sinks[i];
+        const NodeType& type = graph.type(id);
+        const std::vector<const Value*> inputs = gather_inputs(graph, id, outputs_);
+        NodeContext ctx(id, inputs, graph.params(id), outputs_[id], arena, states[id].get());
+        try {
+            writers[i]->finish(ctx);
+        } catch (...) {
+            rethrow_as_execution_error(id, type.name);
+        }
+    }
+    for (NodeId id : order) {
+        if (phase[id] == Phase::After) {
+            evaluate(id);
+        }
+    }
+
+    StreamStats stats;
+    stats.chunks = chunks;
+    stats.peak_in_flight = credits.peak();
+    stats.wall_time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    return stats;
+}
+
+const Value& StreamExecutor::output(PortRef port) const {
+    if (port.node >= outputs_.size() || port.port >= outputs_[port.node].size()) {
+        throw GraphError("node " + std::to_string(port.node) +
+                         " has no output from the last streamed run on port " +
+                         std::to_string(port.port));
+    }
+    return outputs_[port.node][port.port];
+}
+
+} // namespace rebelflow
@@ -0,0 +1,356 @@
+#include "rebelflow/subgraph.hpp"
+
+#include "rebelflow/hash.hpp"
+#include "rebelflow/serialize.hpp"
+
+#include <algorithm>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace rebelflow {
+
+namespace {
+
+constexpr std::string_view input_type_name = "SubgraphInput";
+constexpr std::string_view output_type_name = "SubgraphOutput";
+constexpr std::size_t name_param = 0;
+constexpr std::size_t value_param = 1;
+
+/// State shared by every instance of one sub-graph type.
+class Macro {
+public:
+    Macro(std::shared_ptr<const Graph> body,
+          std::vector<NodeId> inputs,
+          std::vector<NodeId> outputs,
+          const SubgraphOptions& options,
+          bool memoize)
+        : body_(std::move(body)),
+          inputs_(std::move(inputs)),
+          outputs_(std::move(outputs)),
+          options_(options),
+          memoize_(memoize && options.memo_entries > 0) {
+        options_.plan.outputs.clear();
+        for (NodeId id : outputs_) {
+            options_.plan.outputs.push_back({id, 0});
+        }
+    }
+
+    void compute(NodeContext& ctx) {
+        Digest key;
+        if (memoize_) {
+            Hasher h;
+            for (const Value* input : ctx.inputs()) {
+                hash_value(h, *input);
+            }
+            key = h.digest();
+            if (recall(key, ctx)) {
+                return;
+            }
+        }
+
+        std::unique_ptr<CompiledPlan> plan = acquire();
+        try {
+            for (std::size_t i = 0; i < inputs_.size(); ++i) {
+                plan->set_param(inputs_[i], value_param, ctx.input(i));
+            }
+            plan->run();
+        } catch (const ExecutionError& e) {
+            // Report the body node inside the instance's own error.
+            release(std::move(plan));
+            throw Error(std::string("in sub-graph: ") + e.what());
+        } catch (...) {
+            release(std::move(plan));
+            throw;
+        }
+        for (std::size_t o = 0; o < outputs_.size(); ++o) {
+            ctx.set_output(o, plan->output({outputs_[o], 0}));
+        }
+        release(std::move(plan));
+
+        if (memoize_) {
+            remember(key, ctx.outputs());
+        }
+    }
+
+private:
+    using Memo = std::list<std::pair<Digest, std::vector<Value>>>;
+
+    std::unique_ptr<CompiledPlan> acquire() {
+        std::lock_guard lock(mutex_);
+        if (!idle_.empty()) {
+            std::unique_ptr<CompiledPlan> plan = std::move(idle_.back());
+            idle_.pop_back();
+            return plan;
+        }
+        if (!plan_) {
+            // First evaluation of any instance. A failure leaves plan_ empty,
+            // so the next evaluation reports it again.
+            plan_ = CompiledPlan::compile(*body_, options_.plan);
+        }
+        return std::make_unique<CompiledPlan>(plan_->fork());
+    }
+
+    void release(std::unique_ptr<CompiledPlan> plan) {
+        std::lock_guard lock(mutex_);
+        idle_.push_back(std::move(plan));
+    }
+
+    bool recall(const Digest& key, NodeContext& ctx) {
+        std::lock_guard lock(mutex_);
+        auto it = memo_index_.find(key);
+        if (it == memo_index_.end()) {
+            return false;
+        }
+        memo_.splice(memo_.begin(), memo_, it->second);
+        const std::vector<Value>& values = it->second->second;
+        std::copy(values.begin(), values.end(), ctx.outputs().begin());
+        return true;
+    }
+
+    void remember(const Digest& key, std::span<const Value> outputs) {
+        std::lock_guard lock(mutex_);
+        if (memo_index_.count(key) != 0) {
+            return; // another thread got there first
+        }
+        memo_.emplace_front(key, std::vector<Value>(outputs.begin(), outputs.end()));
+        memo_index_.emplace(key, memo_.begin());
+        if (memo_.size() > options_.memo_entries) {
+            memo_index_.erase(memo_.back().first);
+            memo_.pop_back();
+        }
+    }
+
+    const std::shared_ptr<const Graph> body_;
+    const std::vector<NodeId> inputs_;
+    const std::vector<NodeId> outputs_;
+    SubgraphOptions options_;
+    const bool memoize_;
+
+    std::mutex mutex_;
+    std::optional<CompiledPlan> plan_;
+    std::vector<std::unique_ptr<CompiledPlan>> idle_;
+    Memo memo_; // most recently used first
+    std::unordered_map<Digest, Memo::iterator> memo_index_;
+};
+
+/// Digest of everything in `body` that affects results.
+Digest body_digest(const Graph& body) {
+    Hasher h;
+    for (NodeId id : body.topological_order()) {
+        const NodeType& type = body.type(id);
+        h.update(std::uint64_t{id}).update(type.name).update(std::uint64_t{type.version});
+        for (const Value& param : body.params(id)) {
+            hash_value(h, param);
+        }
+        for (const PortRef& src : body.input_sources(id)) {
+            h.update(std::uint64_t{src.node}).update(std::uint64_t{src.port});
+        }
+    }
+    return h.digest();
+}
+
+/// `base`, or `base` with a numeric suffix if that is taken.
+std::string unique_name(std::unordered_set<std::string>& taken, const std::string& base) {
+    std::string name = base;
+    for (int i = 2; !taken.insert(name).second; ++i) {
+        name = base + std::to_string(i);
+    }
+    return name;
+}
+
+} // namespace
+
+void register_subgraph_nodes(NodeRegistry& registry) {
+    NodeType input;
+    input.name = std::string(input_type_name);
+    input.outputs = {{"value", DataType::Any}};
+    input.params = {{"name", std::string("in")}, {"value", 0.0}};
+    input.compute = [](NodeContext& ctx) { ctx.set_output(0, ctx.param(value_param)); };
+    // Its value comes from the enclosing instance: never fold or cache it as
+    // a constant.
+    input.pure = false;
+    registry.add(std::move(input));
+
+    NodeType output;
+    output.name = std::string(output_type_name);
+    output.inputs = {{"value", DataType::Any, 0.0}};
+    output.outputs = {{"value", DataType::Any}};
+    output.params = {{"name", std::string("out")}};
+    output.compute = [](NodeContext& ctx) { ctx.set_output(0, ctx.input(0)); };
+    registry.add(std::move(output));
+}
+
+NodeType subgraph_type(std::string name,
+                       std::shared_ptr<const Graph> body,
+                       const SubgraphOptions& options) {
+    if (!body) {
+        throw GraphError("sub-graph '" + name + "' has no body");
+    }
+    body->validate();
+
+    NodeType type;
+    type.name = std::move(name);
+    std::vector<NodeId> inputs;
+    std::vector<NodeId> outputs;
+    std::unordered_set<std::string> input_names;
+    std::unordered_set<std::string> output_names;
+    bool pure = true;
+    for (NodeId id : body->nodes()) {
+        const NodeType& node_type = body->type(id);
+        if (node_type.name == input_type_name) {
+            const std::string& port = body->params(id)[name_param].as_string();
+            if (!input_names.insert(port).second) {
+                throw GraphError("sub-graph '" + type.name + "' has two inputs named '" + port +
+                                 "'");
+            }
+            type.inputs.push_back({port, DataType::Any, body->params(id)[value_param]});
+            inputs.push_back(id);
+        } else if (node_type.name == output_type_name) {
+            const std::string& port = body->params(id)[name_param].as_string();
+            if (!output_names.insert(port).second) {
+                throw GraphError("sub-graph '" + type.name + "' has two outputs named '" +
+                                 port + "'");
+            }
+            const PortRef src = body->input_sources(id)[0];
+            type.outputs.push_back(
+                {port, src.valid() ? body->type(src.node).outputs[src.port].type : DataType::Any});
+            outputs.push_back(id);
+        } else {
+            pure &= node_type.pure;
+        }
+    }
+    if (outputs.empty()) {
+        throw GraphError("sub-graph '" + type.name + "' has no " +
+                         std::string(output_type_name) + " node");
+    }
+
+    const Digest digest = body_digest(*body);
+    type.version = static_cast<std::uint32_t>(digest.lo ^ (digest.lo >> 32));
+    type.pure = pure;
+    auto macro = std::make_shared<Macro>(std::move(body), std::move(inputs), std::move(outputs),
+                                         options, pure);
+    type.compute = [macro](NodeContext& ctx) { macro->compute(ctx); };
+    return type;
+}
+
+CollapseResult collapse(Graph& graph,
+                        std::span<const NodeId> nodes,
+                        NodeRegistry& registry,
+                        std::string type_name,
+                        const SubgraphOptions& options) {
+    if (nodes.empty()) {
+        throw GraphError("nothing to collapse");
+    }
+    const std::shared_ptr<const NodeType> input_type = registry.get(input_type_name);
+    const std::shared_ptr<const NodeType> output_type = registry.get(output_type_name);
+
+    std::vector<std::uint8_t> inside(graph.id_bound(), 0);
+    for (NodeId id : nodes) {
+        if (!graph.contains(id)) {
+            throw GraphError("no node with id " + std::to_string(id));
+        }
+        if (inside[id]) {
+            throw GraphError("node " + std::to_string(id) + " is listed twice");
+        }
+        inside[id] = 1;
+    }
+
+    // The group must be convex: no path may leave it and come back, or the
+    // instance would feed itself.
+    const std::vector<NodeId>& order = graph.topological_order();
+    std::vector<std::uint8_t> below(graph.id_bound(), 0); // outside, downstream of the group
+    for (NodeId id : order) {
+        for (const PortRef& src : graph.input_sources(id)) {
+            if (!src.valid() || !(inside[src.node] || below[src.node])) {
+                continue;
+            }
+            if (inside[id] && below[src.node]) {
+                throw GraphError("collapsing these nodes would create a cycle through node " +
+                                 std::to_string(src.node));
+            }
+            if (!inside[id]) {
+                below[id] = 1;
+            }
+        }
+    }
+
+    // Body: copies of the group's nodes and inner edges, in topological order.
+    auto body = std::make_shared<Graph>();
+    std::unordered_map<NodeId, NodeId> copy_of;
+    for (NodeId id : order) {
+        if (!inside[id]) {
+            continue;
+        }
+        const NodeId copy = body->add_node(graph.type_ptr(id));
+        const std::span<const Value> params = graph.params(id);
+        for (std::size_t p = 0; p < params.size(); ++p) {
+            body->set_param(copy, p, params[p]);
+        }
+        copy_of.emplace(id, copy);
+    }
+
+    std::vector<PortRef> outer_inputs;  // per instance input: the outside output
+    std::vector<NodeId> input_nodes;    // per instance input: its SubgraphInput
+    std::vector<PortRef> outer_outputs; // per instance output: the inside output
+    std::vector<std::pair<std::uint32_t, PortRef>> outgoing; // instance output -> outside input
+    std::unordered_set<std::string> input_names;
+    std::unordered_set<std::string> output_names;
+    for (NodeId id : order) {
+        const std::span<const PortRef> sources = graph.input_sources(id);
+        for (std::uint32_t port = 0; port < sources.size(); ++port) {
+            const PortRef& src = sources[port];
+            if (!src.valid()) {
+                continue;
+            }
+            if (inside[id] && inside[src.node]) {
+                body->connect({copy_of.at(src.node), src.port}, {copy_of.at(id), port});
+            } else if (inside[id]) {
+                auto at = std::find(outer_inputs.begin(), outer_inputs.end(), src);
+                if (at == outer_inputs.end()) {
+                    const NodeId placeholder = body->add_node(input_type);
+                    body->set_param(placeholder, name_param,
+                                    unique_name(input_names, graph.type(id).inputs[port].name));
+                    outer_inputs.push_back(src);
+                    input_nodes.push_back(placeholder);
+                    at = outer_inputs.end() - 1;
+                }
+                body->connect({input_nodes[static_cast<std::size_t>(at - outer_inputs.begin())], 0},
+                              {copy_of.at(id), port});
+            } else if (inside[src.node]) {
+                auto at = std::find(outer_outputs.begin(), outer_outputs.end(), src);
+                if (at == outer_outputs.end()) {
+                    const NodeId placeholder = body->add_node(output_type);
+                    body->set_param(
+                        placeholder, name_param,
+                        unique_name(output_names, graph.type(src.node).outputs[src.port].name));
+                    body->connect({copy_of.at(src.node), src.port}, {placeholder, 0});
+                    outer_outputs.push_back(src);
+                    at = outer_outputs.end() - 1;
+                }
+                outgoing.emplace_back(static_cast<std::uint32_t>(at - outer_outputs.begin()),
+                                      PortRef{id, port});
+            }
+        }
+    }
+
+    CollapseResult result;
+    result.type = registry.add(subgraph_type(std::move(type_name), body, options));
+    result.node = graph.add_node(result.type);
+    for (NodeId id : nodes) {
+        graph.remove_node(id);
+    }
+    for (std::uint32_t i = 0; i < outer_inputs.size(); ++i) {
+        graph.connect(outer_inputs[i], {result.node, i});
+    }
+    for (const auto& [port, to] : outgoing) {
+        graph.connect({result.node, port}, to);
+    }
+    return result;
+}
+
+} // namespace rebelflow
@@ -0,0 +1,221 @@
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace rebelflow {
+
+namespace {
+
+// Identifies the pool and queue owned by the current thread, if any.
+thread_local const ThreadPool* tls_pool = nullptr;
+thread_local int tls_index = -1;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    queues_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    workers_.reserve(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        workers_.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(sleep_mutex_);
+        stopping_.store(true);
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_) {
+        t.join();
+    }
+}
+
+int ThreadPool::current_worker() const noexcept {
+    return tls_pool == this ? tls_index : -1;
+}
+
+void ThreadPool::submit(Task task) {
+    const int self = current_worker();
+    WorkQueue& queue = self >= 0 ? *queues_[static_cast<unsigned>(self)] : injector_;
+    {
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    // Pairs with the sleepers_ increment in worker_loop(): either the sleeper
+    // sees the new task in its predicate or we see the sleeper and notify.
+    queued_.fetch_add(1);
+    if (sleepers_.load() > 0) {
+        std::lock_guard lock(sleep_mutex_);
+        wake_.notify_one();
+    }
+}
+
+bool ThreadPool::pop_task(int self, Task& out) {
+    if (self >= 0) {
+        WorkQueue& own = *queues_[static_cast<unsigned>(self)];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty()) {
+            out = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    {
+        std::lock_guard lock(injector_.mutex);
+        if (!injector_.tasks.empty()) {
+            out = std::move(injector_.tasks.front());
+            injector_.tasks.pop_front();
+            return true;
+        }
+    }
+    return steal_task(self >= 0 ? static_cast<unsigned>(self) + 1 : 0, out);
+}
+
+bool ThreadPool::steal_task(unsigned start, Task& out) {
+    const auto n = static_cast<unsigned>(queues_.size());
+    for (unsigned k = 0; k < n; ++k) {
+        WorkQueue& victim = *queues_[(start + k) % n];
+        std::unique_lock lock(victim.mutex, std::try_to_lock);
+        if (lock && !victim.tasks.empty()) {
+            out = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::run_one() {
+    if (queued_.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    Task task;
+    if (!pop_task(current_worker(), task)) {
+        return false;
+    }
+    queued_.fetch_sub(1);
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop(unsigned index) {
+    tls_pool = this;
+    tls_index = static_cast<int>(index);
+
+    Task task;
+    for (;;) {
+        if (queued_.load() > 0 && pop_task(static_cast<int>(index), task)) {
+            queued_.fetch_sub(1);
+            task();
+            task = nullptr;
+            continue;
+        }
+        std::unique_lock lock(sleep_mutex_);
+        sleepers_.fetch_add(1);
+        wake_.wait(lock, [this] { return stopping_.load() || queued_.load() > 0; });
+        sleepers_.fetch_sub(1);
+        if (stopping_.load() && queued_.load() == 0) {
+            return;
+        }
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    // Tasks reference this group; never let it die under them.
+    while (outstanding_.load() != 0) {
+        if (!pool_.run_one()) {
+            std::this_thread::yield();
+        }
+    }
+    std::lock_guard lock(mutex_);
+}
+
+void TaskGroup::run(Task task) {
+    outstanding_.fetch_add(1);
+    pool_.submit([this, task = std::move(task)] {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+        finish_one();
+    });
+}
+
+void TaskGroup::finish_one() noexcept {
+    // Decrement under the lock so a waiter that observes zero cannot tear the
+    // group down while we still touch it.
+    std::lock_guard lock(mutex_);
+    if (outstanding_.fetch_sub(1) == 1) {
+        done_.notify_all();
+    }
+}
+
+void TaskGroup::wait() {
+    if (pool_.current_worker() >= 0) {
+        while (outstanding_.load() != 0) {
+            if (!pool_.run_one()) {
+                std::this_thread::yield();
+            }
+        }
+    } else {
+        std::unique_lock lock(mutex_);
+        done_.wait(lock, [this] { return outstanding_.load() == 0; });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard lock(mutex_);
+        error = std::exchange(error_, nullptr);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void parallel_for(ThreadPool* pool,
+                  std::size_t count,
+                  std::size_t grain,
+                  const std::function<void(std::size_t begin, std::size_t end)>& body) {
+    if (count == 0) {
+        return;
+    }
+    // A few ranges per worker balance uneven items without flooding the
+    // deques.
+    const std::size_t workers = pool != nullptr ? pool->size() : 1;
+    const std::size_t size =
+        std::max({grain, std::size_t{1}, (count + workers * 4 - 1) / (workers * 4)});
+    if (pool == nullptr || workers <= 1 || size >= count) {
+        body(0, count);
+        return;
+    }
+    TaskGroup group(*pool);
+    for (std::size_t begin = size; begin < count; begin += size) {
+        const std::size_t end = std::min(begin + size, count);
+        group.run([&body, begin, end] { body(begin, end); });
+    }
+    // The first range runs here rather than waiting idle.
+    std::exception_ptr error;
+    try {
+        body(0, size);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    group.wait();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace rebelflow
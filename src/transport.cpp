@@ -0,0 +1,343 @@
+#include "rebelflow/transport.hpp"
+
+#include "rebelflow/error.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace rebelflow {
+
+namespace {
+
+[[noreturn]] void fail(const std::string& what, const std::string& address) {
+    throw IoError(what + " '" + address + "': " + std::strerror(errno));
+}
+
+/// Messages larger than this are refused rather than allocated, so a bad
+/// peer cannot make the receiver reserve arbitrary amounts of memory.
+constexpr std::uint64_t max_message = std::uint64_t{1} << 30;
+
+struct Address {
+    bool unix_socket = false;
+    std::string path; // unix
+    std::string host; // tcp
+    std::string port; // tcp
+};
+
+Address parse_address(const std::string& address) {
+    Address a;
+    if (address.starts_with("unix:")) {
+        a.unix_socket = true;
+        a.path = address.substr(5);
+        if (a.path.empty() || a.path.size() >= sizeof(sockaddr_un::sun_path)) {
+            throw IoError("bad UNIX socket path in '" + address + "'");
+        }
+        return a;
+    }
+    const std::size_t colon = address.rfind(':');
+    if (!address.starts_with("tcp:") || colon < 4) {
+        throw IoError("bad address '" + address + "': expected unix:PATH or tcp:HOST:PORT");
+    }
+    a.host = address.substr(4, colon - 4);
+    a.port = address.substr(colon + 1);
+    return a;
+}
+
+sockaddr_un unix_address(const std::string& path) {
+    sockaddr_un sa{};
+    sa.sun_family = AF_UNIX;
+    std::memcpy(sa.sun_path, path.c_str(), path.size() + 1);
+    return sa;
+}
+
+/// Resolved TCP addresses, freed on destruction.
+struct Resolved {
+    addrinfo* list = nullptr;
+
+    Resolved(const Address& a, const std::string& address) {
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        // No AI_PASSIVE: an empty host resolves to loopback for listeners
+        // too, so serving every interface takes an explicit host.
+        const int rc = ::getaddrinfo(a.host.empty() ? nullptr : a.host.c_str(), a.port.c_str(),
+                                     &hints, &list);
+        if (rc != 0) {
+            throw IoError("cannot resolve '" + address + "': " + ::gai_strerror(rc));
+        }
+    }
+    ~Resolved() { ::freeaddrinfo(list); }
+
+    Resolved(const Resolved&) = delete;
+    Resolved& operator=(const Resolved&) = delete;
+};
+
+/// Removes the UNIX socket at `path` if nothing accepts on it any more, e.g.
+/// after a crash. Other files are left for bind() to fail on; a socket in use
+/// throws.
+void remove_stale_socket(const std::string& path, const std::string& address) {
+    struct stat st {};
+    if (::lstat(path.c_str(), &st) != 0 || !S_ISSOCK(st.st_mode)) {
+        return;
+    }
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        fail("cannot create socket for", address);
+    }
+    const sockaddr_un sa = unix_address(path);
+    const bool live = ::connect(fd, reinterpret_cast<const sockaddr*>(&sa), sizeof sa) == 0;
+    const int error = errno;
+    ::close(fd);
+    if (live) {
+        throw IoError("cannot bind '" + address + "': another process is listening on it");
+    }
+    if (error == ECONNREFUSED) {
+        ::unlink(path.c_str());
+    }
+}
+
+void set_no_delay(int fd) noexcept {
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof one);
+}
+
+} // namespace
+
+Connection::~Connection() {
+    close();
+}
+
+Connection::Connection(Connection&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)), sent_(other.sent_), received_(other.received_) {}
+
+Connection& Connection::operator=(Connection&& other) noexcept {
+    if (this != &other) {
+        close();
+        fd_ = std::exchange(other.fd_, -1);
+        sent_ = other.sent_;
+        received_ = other.received_;
+    }
+    return *this;
+}
+
+void Connection::close() noexcept {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+Connection Connection::connect(const std::string& address) {
+    const Address a = parse_address(address);
+    if (a.unix_socket) {
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        const sockaddr_un sa = unix_address(a.path);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&sa), sizeof sa) != 0) {
+            const int saved = errno;
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            errno = saved;
+            fail("cannot connect to", address);
+        }
+        return Connection(fd);
+    }
+    const Resolved resolved(a, address);
+    for (const addrinfo* ai = resolved.list; ai != nullptr; ai = ai->ai_next) {
+        const int fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) {
+            set_no_delay(fd);
+            return Connection(fd);
+        }
+        const int saved = errno;
+        ::close(fd);
+        errno = saved;
+    }
+    fail("cannot connect to", address);
+}
+
+void Connection::send(std::span<const std::byte> message) {
+    const std::uint64_t size = message.size();
+    if (size > max_message) {
+        throw IoError("message of " + std::to_string(size) + " bytes is too large to send");
+    }
+    iovec iov[2] = {{const_cast<std::uint64_t*>(&size), sizeof size},
+                    {const_cast<std::byte*>(message.data()), message.size()}};
+    msghdr msg{};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 2;
+    std::size_t left = sizeof size + message.size();
+    while (left > 0) {
+        const ssize_t n = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw IoError(std::string("connection lost while sending: ") + std::strerror(errno));
+        }
+        left -= static_cast<std::size_t>(n);
+        sent_ += static_cast<std::size_t>(n);
+        // Skip what went out, across the two pieces.
+        std::size_t done = static_cast<std::size_t>(n);
+        while (msg.msg_iovlen > 0 && done >= msg.msg_iov->iov_len) {
+            done -= msg.msg_iov->iov_len;
+            ++msg.msg_iov;
+            --msg.msg_iovlen;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = static_cast<char*>(msg.msg_iov->iov_base) + done;
+            msg.msg_iov->iov_len -= done;
+        }
+    }
+}
+
+bool Connection::receive(std::vector<std::byte>& message) {
+    // Returns the bytes read; fewer than `size` only at end of stream.
+    auto read_fully = [&](void* out, std::size_t size) {
+        std::size_t got = 0;
+        while (got < size) {
+            const ssize_t n = ::recv(fd_, static_cast<char*>(out) + got, size - got, 0);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw IoError(std::string("connection lost while receiving: ") +
+                              std::strerror(errno));
+            }
+            if (n == 0) {
+                break;
+            }
+            got += static_cast<std::size_t>(n);
+        }
+        received_ += got;
+        return got;
+    };
+
+    std::uint64_t size = 0;
+    const std::size_t got = read_fully(&size, sizeof size);
+    if (got == 0) {
+        return false;
+    }
+    if (got != sizeof size || size > max_message) {
+        throw FormatError("bad message header");
+    }
+    message.resize(static_cast<std::size_t>(size));
+    if (read_fully(message.data(), message.size()) != message.size()) {
+        throw IoError("connection closed in the middle of a message");
+    }
+    return true;
+}
+
+Listener::~Listener() {
+    close();
+}
+
+Listener::Listener(Listener&& other) noexcept
+    : fd_(std::exchange(other.fd_, -1)),
+      address_(std::move(other.address_)),
+      unix_path_(std::move(other.unix_path_)) {}
+
+Listener& Listener::operator=(Listener&& other) noexcept {
+    if (this != &other) {
+        close();
+        fd_ = std::exchange(other.fd_, -1);
+        address_ = std::move(other.address_);
+        unix_path_ = std::move(other.unix_path_);
+    }
+    return *this;
+}
+
+void Listener::close() noexcept {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (!unix_path_.empty()) {
+        ::unlink(unix_path_.c_str());
+        unix_path_.clear();
+    }
+}
+
+Listener Listener::bind(const std::string& address) {
+    const Address a = parse_address(address);
+    Listener listener;
+    if (a.unix_socket) {
+        listener.fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener.fd_ < 0) {
+            fail("cannot create socket for", address);
+        }
+        remove_stale_socket(a.path, address);
+        const sockaddr_un sa = unix_address(a.path);
+        if (::bind(listener.fd_, reinterpret_cast<const sockaddr*>(&sa), sizeof sa) != 0) {
+            fail("cannot bind", address);
+        }
+        listener.unix_path_ = a.path;
+        listener.address_ = address;
+    } else {
+        const Resolved resolved(a, address);
+        const addrinfo* ai = resolved.list;
+        listener.fd_ = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (listener.fd_ < 0) {
+            fail("cannot create socket for", address);
+        }
+        const int one = 1;
+        ::setsockopt(listener.fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof one);
+        if (::bind(listener.fd_, ai->ai_addr, ai->ai_addrlen) != 0) {
+            fail("cannot bind", address);
+        }
+        sockaddr_storage bound{};
+        socklen_t length = sizeof bound;
+        ::getsockname(listener.fd_, reinterpret_cast<sockaddr*>(&bound), &length);
+        const std::uint16_t port =
+            ntohs(bound.ss_family == AF_INET6
+                      ? reinterpret_cast<const sockaddr_in6*>(&bound)->sin6_port
+                      : reinterpret_cast<const sockaddr_in*>(&bound)->sin_port);
+        listener.address_ = "tcp:" + a.host + ":" + std::to_string(port);
+    }
+    if (::listen(listener.fd_, SOMAXCONN) != 0) {
+        fail("cannot listen on", address);
+    }
+    return listener;
+}
+
+Connection Listener::accept() {
+    for (;;) {
+        const int fd = ::accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd >= 0) {
+            if (unix_path_.empty()) {
+                set_no_delay(fd);
+            }
+            return Connection(fd);
+        }
+        if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        }
+        if (errno == EINVAL || errno == EBADF) {
+            return {}; // shut down
+        }
+        fail("cannot accept on", address_);
+    }
+}
+
+void Listener::shutdown() noexcept {
+    if (fd_ >= 0) {
+        ::shutdown(fd_, SHUT_RDWR);
+    }
+}
+
+} // namespace rebelflow
@@ -0,0 +1,185 @@
+#include "rebelflow/value.hpp"
+
+#include "rebelflow/brep.hpp"
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/mesh.hpp"
+
+#include <charconv>
+#include <type_traits>
+
+namespace rebelflow {
+
+const char* to_string(DataType type) noexcept {
+    switch (type) {
+    case DataType::Any: return "any";
+    case DataType::None: return "none";
+    case DataType::Bool: return "bool";
+    case DataType::Int: return "int";
+    case DataType::Float: return "float";
+    case DataType::String: return "string";
+    case DataType::Buffer: return "buffer";
+    case DataType::Mesh: return "mesh";
+    case DataType::Bvh: return "bvh";
+    case DataType::Brep: return "brep";
+    }
+    return "?";
+}
+
+bool is_convertible(DataType from, DataType to) noexcept {
+    if (from == to || from == DataType::Any || to == DataType::Any) {
+        return true;
+    }
+    return from == DataType::Int && to == DataType::Float;
+}
+
+Value::Value(Mesh v) : data_(std::make_shared<const Mesh>(std::move(v))) {}
+Value::Value(Bvh v) : data_(std::make_shared<const Bvh>(std::move(v))) {}
+Value::Value(Brep v) : data_(std::make_shared<const Brep>(std::move(v))) {}
+
+DataType Value::type() const noexcept {
+    switch (data_.index()) {
+    case 1: return DataType::Bool;
+    case 2: return DataType::Int;
+    case 3: return DataType::Float;
+    case 4: return DataType::String;
+    case 5: return DataType::Buffer;
+    case 6: return DataType::Mesh;
+    case 7: return DataType::Bvh;
+    case 8: return DataType::Brep;
+    default: return DataType::None;
+    }
+}
+
+namespace {
+
+[[noreturn]] void type_mismatch(DataType want, DataType have) {
+    throw TypeError(std::string("expected ") + to_string(want) + ", got " + to_string(have));
+}
+
+} // namespace
+
+bool Value::as_bool() const {
+    if (const bool* v = std::get_if<bool>(&data_)) {
+        return *v;
+    }
+    type_mismatch(DataType::Bool, type());
+}
+
+std::int64_t Value::as_int() const {
+    if (const std::int64_t* v = std::get_if<std::int64_t>(&data_)) {
+        return *v;
+    }
+    if (const bool* v = std::get_if<bool>(&data_)) {
+        return *v ? 1 : 0;
+    }
+    type_mismatch(DataType::Int, type());
+}
+
+double Value::as_float() const {
+    if (const double* v = std::get_if<double>(&data_)) {
+        return *v;
+    }
+    if (const std::int64_t* v = std::get_if<std::int64_t>(&data_)) {
+        return static_cast<double>(*v);
+    }
+    type_mismatch(DataType::Float, type());
+}
+
+const std::string& Value::as_string() const {
+    if (const std::string* v = std::get_if<std::string>(&data_)) {
+        return *v;
+    }
+    type_mismatch(DataType::String, type());
+}
+
+const Buffer& Value::as_buffer() const {
+    if (const Buffer* v = std::get_if<Buffer>(&data_)) {
+        return *v;
+    }
+    type_mismatch(DataType::Buffer, type());
+}
+
+const Mesh& Value::as_mesh() const {
+    if (const auto* v = std::get_if<std::shared_ptr<const Mesh>>(&data_)) {
+        return **v;
+    }
+    type_mismatch(DataType::Mesh, type());
+}
+
+const Bvh& Value::as_bvh() const {
+    if (const auto* v = std::get_if<std::shared_ptr<const Bvh>>(&data_)) {
+        return **v;
+    }
+    type_mismatch(DataType::Bvh, type());
+}
+
+const Brep& Value::as_brep() const {
+    if (const auto* v = std::get_if<std::shared_ptr<const Brep>>(&data_)) {
+        return **v;
+    }
+    type_mismatch(DataType::Brep, type());
+}
+
+bool operator==(const Value& a, const Value& b) {
+    if (a.data_.index() != b.data_.index()) {
+        return false;
+    }
+    return std::visit(
+        [&b]<typename T>(const T& x) {
+            const T& y = std::get<T>(b.data_);
+            if constexpr (std::is_same_v<T, std::shared_ptr<const Mesh>> ||
+                          std::is_same_v<T, std::shared_ptr<const Bvh>> ||
+                          std::is_same_v<T, std::shared_ptr<const Brep>>) {
+                return x == y || *x == *y;
+            } else {
+                return x == y;
+            }
+        },
+        a.data_);
+}
+
+std::string Value::to_string() const {
+    switch (type()) {
+    case DataType::Bool: return as_bool() ? "true" : "false";
+    case DataType::Int: return std::to_string(as_int());
+    case DataType::Float: {
+        char buf[32];
+        auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), as_float());
+        return ec == std::errc{} ? std::string(buf, end) : std::string("nan");
+    }
+    case DataType::String: return as_string();
+    case DataType::Buffer: {
+        const Buffer& b = as_buffer();
+        std::string out = "buffer<";
+        out += rebelflow::to_string(b.element_type());
+        if (b.components() > 1) {
+            out += 'x';
+            out += std::to_string(b.components());
+        }
+        out += ">[";
+        out += std::to_string(b.tuples());
+        out += ']';
+        return out;
+    }
+    case DataType::Mesh: {
+        const Mesh& m = as_mesh();
+        return "mesh[" + std::to_string(m.vertex_count()) + " vertices, " +
+               std::to_string(m.face_count()) + " triangles]";
+    }
+    case DataType::Bvh: {
+        const Bvh& b = as_bvh();
+        return "bvh[" + std::to_string(b.mesh().face_count()) + " triangles, " +
+               std::to_string(b.node_count()) + " nodes]";
+    }
+    case DataType::Brep: {
+        const Brep& b = as_brep();
+        return "brep[" + std::to_string(b.body_count()) + " bodies, " +
+               std::to_string(b.shape_count()) + " shapes, " + std::to_string(b.face_count()) +
+               " faces]";
+    }
+    default: return "null";
+    }
+}
+
+} // namespace rebelflow
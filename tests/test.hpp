@@ -0,0 +1,72 @@
+#pragma once
+
+// Checks shared by the tests in this directory. Each test is a program whose
+// main() runs its checks and returns finish(): status 1 if any failed.
+
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+#include <unistd.h>
+
+namespace rebelflow::test {
+
+inline int failures = 0;
+
+inline void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::fprintf(stderr, "FAIL %s\n", what.c_str());
+        ++failures;
+    }
+}
+
+/// Checks that `fn` throws an `E`; returns its message, or "" if it did not.
+template <typename E, typename Fn>
+std::string check_throws(Fn&& fn, const std::string& what) {
+    try {
+        fn();
+    } catch (const E& e) {
+        return e.what();
+    } catch (const std::exception& e) {
+        check(false, what + ": threw the wrong exception: " + e.what());
+        return "";
+    }
+    check(false, what + ": did not throw");
+    return "";
+}
+
+/// A directory of its own under the system temporary directory, removed
+/// with everything in it on destruction.
+class TempDir {
+public:
+    explicit TempDir(const std::string& test)
+        : path_(std::filesystem::temp_directory_path() /
+                ("rebelflow-" + test + "-" + std::to_string(::getpid()))) {
+        std::filesystem::create_directories(path_);
+    }
+    ~TempDir() {
+        std::error_code ignored;
+        std::filesystem::remove_all(path_, ignored);
+    }
+
+    TempDir(const TempDir&) = delete;
+    TempDir& operator=(const TempDir&) = delete;
+
+    std::string path(const std::string& name) const { return (path_ / name).string(); }
+
+private:
+    std::filesystem::path path_;
+};
+
+inline int finish(const char* test) {
+    if (failures != 0) {
+        std::fprintf(stderr, "%d %s checks failed\n", failures, test);
+        return 1;
+    }
+    std::printf("all %s checks passed\n", test);
+    return 0;
+}
+
+} // namespace rebelflow::test
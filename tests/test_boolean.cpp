@@ -0,0 +1,197 @@
+// Mesh booleans on degenerate input: an icosphere whose edges lie in the
+// faces of a box, identical meshes and touching boxes, each way round. Every
+// result must be closed, and its volume must match the expected one or, where
+// that is not known in closed form, agree with the other operations:
+// union + intersection = a + b and difference = a - intersection. Exits with
+// status 1 if any check fails.
+
+#include "test.hpp"
+
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/mesh_boolean.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using rebelflow::BooleanOperation;
+using rebelflow::Buffer;
+using rebelflow::Mesh;
+using rebelflow::test::check;
+
+/// A unit icosahedron subdivided `levels` times, pushed out to the sphere of
+/// `radius`. Its vertices and edges include the great circles in the three
+/// coordinate planes.
+Mesh make_sphere(std::size_t levels, double radius) {
+    const double g = (1 + std::sqrt(5.0)) / 2;
+    std::vector<double> p = {-1, g, 0,  1, g, 0,  -1, -g, 0,  1, -g, 0,
+                             0, -1, g,  0, 1, g,  0, -1, -g,  0, 1, -g,
+                             g, 0, -1,  g, 0, 1,  -g, 0, -1,  -g, 0, 1};
+    std::vector<std::uint32_t> t = {0, 11, 5, 0, 5, 1,  0, 1, 7,   0, 7, 10, 0, 10, 11,
+                                    1, 5, 9,  5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+                                    3, 9, 4,  3, 4, 2,  3, 2, 6,   3, 6, 8,  3, 8, 9,
+                                    4, 9, 5,  2, 4, 11, 6, 2, 10,  8, 6, 7,  9, 8, 1};
+    const Mesh mesh = subdivide(
+        Mesh::from_triangles(Buffer::adopt(std::move(p), 3), Buffer::adopt(std::move(t), 3)),
+        levels);
+    std::vector<double> q(mesh.positions().begin(), mesh.positions().end());
+    for (std::size_t i = 0; i < q.size(); i += 3) {
+        const double length = std::sqrt(q[i] * q[i] + q[i + 1] * q[i + 1] + q[i + 2] * q[i + 2]);
+        for (std::size_t k = 0; k < 3; ++k) {
+            q[i + k] = q[i + k] / length * radius;
+        }
+    }
+    return mesh.with_positions(Buffer::adopt(std::move(q), 3));
+}
+
+/// The box from `low` to `high`, as 12 triangles facing out.
+Mesh make_box(const std::array<double, 3>& low, const std::array<double, 3>& high) {
+    std::vector<double> p;
+    for (int i = 0; i < 8; ++i) {
+        p.insert(p.end(), {i & 1 ? high[0] : low[0], i & 2 ? high[1] : low[1],
+                           i & 4 ? high[2] : low[2]});
+    }
+    std::vector<std::uint32_t> t = {0, 2, 3, 0, 3, 1, 4, 5, 7, 4, 7, 6, 0, 1, 5, 0, 5, 4,
+                                    2, 6, 7, 2, 7, 3, 0, 4, 6, 0, 6, 2, 1, 3, 7, 1, 7, 5};
+    return Mesh::from_triangles(Buffer::adopt(std::move(p), 3), Buffer::adopt(std::move(t), 3));
+}
+
+/// Half-edges with no opposite half-edge on the same two vertices.
+std::size_t open_edges(const Mesh& mesh) {
+    std::map<std::pair<std::uint32_t, std::uint32_t>, long> balance;
+    const std::span<const std::uint32_t> c = mesh.corners();
+    for (std::size_t h = 0; h < c.size(); ++h) {
+        const std::uint32_t u = c[h];
+        const std::uint32_t v = c[h - h % 3 + (h + 1) % 3];
+        balance[{std::min(u, v), std::max(u, v)}] += u < v ? 1 : -1;
+    }
+    std::size_t open = 0;
+    for (const auto& [edge, count] : balance) {
+        open += static_cast<std::size_t>(std::abs(count));
+    }
+    return open;
+}
+
+/// Enclosed volume, by the divergence theorem.
+double volume(const Mesh& mesh) {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> c = mesh.corners();
+    double sum = 0;
+    for (std::size_t h = 0; h < c.size(); h += 3) {
+        const double* a = p.data() + 3 * c[h];
+        const double* b = p.data() + 3 * c[h + 1];
+        const double* d = p.data() + 3 * c[h + 2];
+        sum += a[0] * (b[1] * d[2] - b[2] * d[1]) + a[1] * (b[2] * d[0] - b[0] * d[2]) +
+               a[2] * (b[0] * d[1] - b[1] * d[0]);
+    }
+    return sum / 6;
+}
+
+bool near(double x, double y) {
+    return std::abs(x - y) <= 1e-9 * std::max(1.0, std::abs(y));
+}
+
+struct Results {
+    double union_volume = 0;
+    double intersection_volume = 0;
+    double difference_volume = 0;
+    std::size_t difference_faces = 0;
+};
+
+/// Runs the three operations on a and b, checks each result is closed and
+/// the volumes agree with one another.
+Results run(const std::string& name, const Mesh& a, const Mesh& b) {
+    Results r;
+    for (const BooleanOperation operation :
+         {BooleanOperation::Union, BooleanOperation::Intersection, BooleanOperation::Difference}) {
+        const Mesh result = mesh_boolean(a, b, operation);
+        const std::string what = name + " " + to_string(operation);
+        const std::size_t open = open_edges(result);
+        check(open == 0, what + ": " + std::to_string(open) + " open edges");
+        const double v = volume(result);
+        switch (operation) {
+        case BooleanOperation::Union: r.union_volume = v; break;
+        case BooleanOperation::Intersection: r.intersection_volume = v; break;
+        case BooleanOperation::Difference:
+            r.difference_volume = v;
+            r.difference_faces = result.face_count();
+            break;
+        }
+    }
+    const double va = volume(a);
+    const double vb = volume(b);
+    check(near(r.union_volume + r.intersection_volume, va + vb),
+          name + ": union and intersection volumes do not add up");
+    check(near(r.difference_volume, va - r.intersection_volume),
+          name + ": difference volume is not a minus the intersection");
+    return r;
+}
+
+/// run() both ways round, checking the volumes of the operations that are
+/// symmetric agree.
+Results run_both(const std::string& name, const Mesh& a, const Mesh& b) {
+    const Results forward = run(name, a, b);
+    const Results backward = run(name + " reversed", b, a);
+    check(near(forward.union_volume, backward.union_volume), name + ": union depends on order");
+    check(near(forward.intersection_volume, backward.intersection_volume),
+          name + ": intersection depends on order");
+    return forward;
+}
+
+void expect_volume(double actual, double expected, const std::string& what) {
+    check(near(actual, expected),
+          what + ": volume " + std::to_string(actual) + ", expected " + std::to_string(expected));
+}
+
+} // namespace
+
+int main() {
+    // The sphere's great circles lie in the box's faces. The sphere is
+    // symmetric in the coordinate planes, so the box holds an eighth of it.
+    for (const std::size_t levels : {2, 3}) {
+        const Mesh sphere = make_sphere(levels, 1.0);
+        const double v = volume(sphere);
+        const std::string name = "sphere/" + std::to_string(levels) + " box";
+        const Results r = run_both(name, sphere, make_box({0, 0, 0}, {2, 2, 2}));
+        expect_volume(r.intersection_volume, v / 8, name + " intersection");
+        expect_volume(r.union_volume, 8 + v - v / 8, name + " union");
+        expect_volume(r.difference_volume, v - v / 8, name + " difference");
+
+        // The same box moved off the circles cuts the sphere generically.
+        const double d = 0.0137;
+        run_both(name + " moved", sphere, make_box({d, d, d}, {2 + d, 2 + d, 2 + d}));
+        // Touching the sphere at six vertices from outside.
+        const Results tangent =
+            run_both(name + " tangent", sphere, make_box({-1, -1, -1}, {1, 1, 1}));
+        expect_volume(tangent.intersection_volume, v, name + " tangent intersection");
+    }
+
+    // Identical meshes: the difference is empty, union and intersection are
+    // the mesh itself.
+    const Mesh box = make_box({0, 0, 0}, {2, 2, 2});
+    const Mesh sphere = make_sphere(3, 1.0);
+    for (const Mesh* mesh : {&box, &sphere}) {
+        const std::string name = mesh == &box ? "same box" : "same sphere";
+        const Results r = run(name, *mesh, *mesh);
+        check(r.difference_faces == 0,
+              name + " difference: " + std::to_string(r.difference_faces) + " faces");
+        expect_volume(r.union_volume, volume(*mesh), name + " union");
+        expect_volume(r.intersection_volume, volume(*mesh), name + " intersection");
+    }
+
+    // Boxes sharing a face, and overlapping by half with four faces in
+    // common planes.
+    const Results touching = run_both("touching boxes", box, make_box({2, 0, 0}, {4, 2, 2}));
+    expect_volume(touching.union_volume, 16, "touching boxes union");
+    expect_volume(touching.intersection_volume, 0, "touching boxes intersection");
+    const Results half = run_both("half-overlapping boxes", box, make_box({1, 0, 0}, {3, 2, 2}));
+    expect_volume(half.intersection_volume, 4, "half-overlapping boxes intersection");
+
+    return rebelflow::test::finish("boolean");
+}
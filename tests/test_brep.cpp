@@ -0,0 +1,286 @@
+// STEP import and tessellation: a plate with a hole, placed twice, reads
+// back as two bodies of one shape whose meshes are closed, within tolerance
+// of the plate and placed by their transforms. The tessellation cache snaps
+// nearby tolerances to one mesh and keeps only a few meshes per shape.
+
+#include "test.hpp"
+
+#include "rebelflow/brep.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/step.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <numbers>
+#include <string>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+constexpr double size = 10;
+constexpr double radius = 2.5;
+constexpr double spacing = 20;
+
+/// Numbers entities as they are added.
+class StepWriter {
+public:
+    int add(const std::string& entity) {
+        text_ += ref(++last_) + "=" + entity + ";\n";
+        return last_;
+    }
+    static std::string ref(int id) {
+        std::string out = "#";
+        out += std::to_string(id);
+        return out;
+    }
+
+    int point(double x, double y, double z) {
+        char buf[96];
+        std::snprintf(buf, sizeof buf, "CARTESIAN_POINT('',(%.6g,%.6g,%.6g))", x, y, z);
+        return add(buf);
+    }
+    int direction(double x, double y, double z) {
+        char buf[96];
+        std::snprintf(buf, sizeof buf, "DIRECTION('',(%.6g,%.6g,%.6g))", x, y, z);
+        return add(buf);
+    }
+    /// A frame at (x, y, z) whose z is axis `normal` and x axis `reference`.
+    int axis(double x, double y, double z, int normal = 2, int reference = 0) {
+        const int o = point(x, y, z);
+        const int d = direction(normal == 0, normal == 1, normal == 2);
+        const int a = direction(reference == 0, reference == 1, reference == 2);
+        return add("AXIS2_PLACEMENT_3D(''," + ref(o) + "," + ref(d) + "," + ref(a) + ")");
+    }
+
+    std::string text() const {
+        return "ISO-10303-21;\nHEADER;\nFILE_DESCRIPTION((''),'2;1');\n"
+               "FILE_NAME('','',(''),(''),'','','');\nFILE_SCHEMA(('AUTOMOTIVE_DESIGN'));\n"
+               "ENDSEC;\nDATA;\n" +
+               text_ + "ENDSEC;\nEND-ISO-10303-21;\n";
+    }
+
+private:
+    std::string text_;
+    int last_ = 0;
+};
+
+/// A `size` x `size` x 1 plate with a hole of `radius` through its middle;
+/// returns its MANIFOLD_SOLID_BREP.
+int add_plate(StepWriter& w) {
+    double p[8][3];
+    int v[8];
+    for (int i = 0; i < 8; ++i) {
+        p[i][0] = size * (i & 1);
+        p[i][1] = size * (i >> 1 & 1);
+        p[i][2] = i >> 2 & 1;
+        v[i] = w.add("VERTEX_POINT(''," + w.ref(w.point(p[i][0], p[i][1], p[i][2])) + ")");
+    }
+    int edge[8][8] = {};
+    const auto use = [&](int a, int b) {
+        if (edge[b][a] != 0) {
+            return w.add("ORIENTED_EDGE('',*,*," + w.ref(edge[b][a]) + ",.F.)");
+        }
+        const double d[3] = {p[b][0] - p[a][0], p[b][1] - p[a][1], p[b][2] - p[a][2]};
+        const double length = std::abs(d[0]) + std::abs(d[1]) + std::abs(d[2]);
+        const int direction = w.direction(d[0] / length, d[1] / length, d[2] / length);
+        const int vector = w.add("VECTOR(''," + w.ref(direction) + "," + std::to_string(length) +
+                                 ")");
+        const int line = w.add("LINE(''," + w.ref(w.point(p[a][0], p[a][1], p[a][2])) + "," +
+                               w.ref(vector) + ")");
+        edge[a][b] = w.add("EDGE_CURVE(''," + w.ref(v[a]) + "," + w.ref(v[b]) + "," +
+                           w.ref(line) + ",.T.)");
+        return w.add("ORIENTED_EDGE('',*,*," + w.ref(edge[a][b]) + ",.T.)");
+    };
+    const double c = size / 2;
+    int hole[2];
+    for (int z = 0; z < 2; ++z) {
+        const int vertex = w.add("VERTEX_POINT(''," + w.ref(w.point(c + radius, c, z)) + ")");
+        const int circle = w.add("CIRCLE(''," + w.ref(w.axis(c, c, z)) + "," +
+                                 std::to_string(radius) + ")");
+        hole[z] = w.add("EDGE_CURVE(''," + w.ref(vertex) + "," + w.ref(vertex) + "," +
+                        w.ref(circle) + ",.T.)");
+    }
+    // Corners counterclockwise seen from outside, the outward axis, and the
+    // axis the first side runs along.
+    struct Side {
+        int corners[4];
+        int normal;
+        double sign;
+        int reference;
+    };
+    const Side sides[6] = {{{0, 2, 3, 1}, 2, -1, 1}, {{4, 5, 7, 6}, 2, 1, 0},
+                           {{0, 1, 5, 4}, 1, -1, 0}, {{2, 6, 7, 3}, 1, 1, 2},
+                           {{0, 4, 6, 2}, 0, -1, 2}, {{1, 3, 7, 5}, 0, 1, 1}};
+    std::string faces;
+    for (const Side& s : sides) {
+        std::string uses;
+        for (int k = 0; k < 4; ++k) {
+            uses += k > 0 ? "," : "";
+            uses += w.ref(use(s.corners[k], s.corners[(k + 1) % 4]));
+        }
+        std::string bounds =
+            w.ref(w.add("FACE_OUTER_BOUND(''," + w.ref(w.add("EDGE_LOOP('',(" + uses + "))")) +
+                        ",.T.)"));
+        if (s.normal == 2) {
+            const int z = s.sign > 0 ? 1 : 0;
+            const int hole_use = w.add("ORIENTED_EDGE('',*,*," + w.ref(hole[z]) + "," +
+                                       (z == 0 ? ".T." : ".F.") + ")");
+            const int loop = w.add("EDGE_LOOP('',(" + w.ref(hole_use) + "))");
+            bounds += ",";
+            bounds += w.ref(w.add("FACE_BOUND(''," + w.ref(loop) + ",.T.)"));
+        }
+        const double* o = p[s.corners[0]];
+        const int plane = w.add("PLANE(''," +
+                                w.ref(w.axis(o[0], o[1], o[2], s.normal, s.reference)) + ")");
+        faces += faces.empty() ? "" : ",";
+        faces += w.ref(w.add("ADVANCED_FACE('',(" + bounds + ")," + w.ref(plane) + "," +
+                             (s.sign > 0 ? ".T." : ".F.") + ")"));
+    }
+    const int down = w.add("ORIENTED_EDGE('',*,*," + w.ref(hole[0]) + ",.F.)");
+    const int up = w.add("ORIENTED_EDGE('',*,*," + w.ref(hole[1]) + ",.T.)");
+    const int cylinder = w.add("CYLINDRICAL_SURFACE(''," + w.ref(w.axis(c, c, 0)) + "," +
+                               std::to_string(radius) + ")");
+    const int bottom =
+        w.add("FACE_BOUND(''," + w.ref(w.add("EDGE_LOOP('',(" + w.ref(down) + "))")) + ",.T.)");
+    const int top =
+        w.add("FACE_BOUND(''," + w.ref(w.add("EDGE_LOOP('',(" + w.ref(up) + "))")) + ",.T.)");
+    faces += "," + w.ref(w.add("ADVANCED_FACE('',(" + w.ref(bottom) + "," + w.ref(top) + ")," +
+                               w.ref(cylinder) + ",.F.)"));
+    const int shell = w.add("CLOSED_SHELL('',(" + faces + "))");
+    return w.add("MANIFOLD_SOLID_BREP('plate'," + w.ref(shell) + ")");
+}
+
+/// The plate, mapped twice into the root representation `spacing` apart
+/// along x.
+std::string make_model() {
+    StepWriter w;
+    const int context = w.add("GEOMETRIC_REPRESENTATION_CONTEXT('','',3)");
+    const int solid = add_plate(w);
+    const int origin = w.axis(0, 0, 0);
+    const int part = w.add("ADVANCED_BREP_SHAPE_REPRESENTATION('',(" + w.ref(solid) + "," +
+                           w.ref(origin) + ")," + w.ref(context) + ")");
+    const int map = w.add("REPRESENTATION_MAP(" + w.ref(origin) + "," + w.ref(part) + ")");
+    std::string items;
+    for (int k = 0; k < 2; ++k) {
+        items += items.empty() ? "" : ",";
+        items += w.ref(w.add("MAPPED_ITEM(''," + w.ref(map) + "," +
+                             w.ref(w.axis(spacing * k, 0, 0)) + ")"));
+    }
+    w.add("SHAPE_REPRESENTATION('',(" + items + ")," + w.ref(context) + ")");
+    return w.text();
+}
+
+/// Volume enclosed by a closed mesh.
+double volume(const Mesh& mesh) {
+    const std::span<const double> p = mesh.positions();
+    double sum = 0;
+    for (std::uint32_t f = 0; f < mesh.face_count(); ++f) {
+        const double* a = &p[3 * mesh.origin(3 * f)];
+        const double* b = &p[3 * mesh.origin(3 * f + 1)];
+        const double* c = &p[3 * mesh.origin(3 * f + 2)];
+        sum += a[0] * (b[1] * c[2] - b[2] * c[1]) - a[1] * (b[0] * c[2] - b[2] * c[0]) +
+               a[2] * (b[0] * c[1] - b[1] * c[0]);
+    }
+    return sum / 6;
+}
+
+bool closed(const Mesh& mesh) {
+    for (std::uint32_t h = 0; h < mesh.halfedge_count(); ++h) {
+        if (mesh.is_boundary(h)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_tessellate(const Brep& model, ThreadPool& pool) {
+    check(model.body_count() == 2 && model.shape_count() == 1,
+          "tessellate: " + std::to_string(model.body_count()) + " bodies of " +
+              std::to_string(model.shape_count()) + " shapes");
+    const double tolerance = 0.01;
+    const Mesh first = model.tessellate(0, tolerance, &pool);
+    check(first.face_count() > 0 && closed(first), "tessellate: open mesh");
+
+    // The hole is inscribed, so the volume only grows, by at most the
+    // chordal deviation around the hole.
+    const double exact = size * size - std::numbers::pi * radius * radius;
+    const double v = volume(first);
+    check(v >= exact - 1e-9 && v - exact <= 2 * std::numbers::pi * radius * tolerance,
+          "tessellate: volume " + std::to_string(v) + ", expected " + std::to_string(exact));
+    bool inside = true;
+    const std::span<const double> p = first.positions();
+    for (std::size_t i = 0; inside && i < p.size(); i += 3) {
+        const double dx = p[i] - size / 2;
+        const double dy = p[i + 1] - size / 2;
+        inside = p[i] >= -1e-9 && p[i] <= size + 1e-9 && p[i + 2] >= -1e-9 &&
+                 p[i + 2] <= 1 + 1e-9 && std::hypot(dx, dy) >= radius - tolerance;
+    }
+    check(inside, "tessellate: a vertex lies off the plate");
+
+    // The second body is the same triangles, moved.
+    const Mesh second = model.tessellate(1, tolerance, &pool);
+    bool moved = second.vertex_count() == first.vertex_count();
+    for (std::size_t i = 0; moved && i < p.size(); ++i) {
+        moved = std::abs(second.positions()[i] - p[i] - (i % 3 == 0 ? spacing : 0)) < 1e-9;
+    }
+    check(moved, "tessellate: second body not placed by its transform");
+
+    const Mesh all = model.tessellate_all(tolerance, &pool);
+    check(all.face_count() == 2 * first.face_count() && closed(all), "tessellate: all bodies");
+    check(std::abs(volume(all) - 2 * v) < 1e-6, "tessellate: all bodies' volume");
+
+    const Mesh finer = model.tessellate(0, tolerance / 10, &pool);
+    check(finer.face_count() > first.face_count(), "tessellate: finer tolerance, no more faces");
+
+    check_throws<Error>([&] { model.tessellate(0, 0); }, "tessellate: zero tolerance");
+    check_throws<Error>([&] { model.tessellate(0, -1); }, "tessellate: negative tolerance");
+    check(!model.is_tessellated(0, -1), "tessellate: negative tolerance cached");
+}
+
+void test_cache(const std::string& path, ThreadPool& pool) {
+    const Brep model = read_step(path, &pool);
+    check(!model.is_tessellated(0, 0.01), "cache: a fresh model has meshes");
+    const Mesh mesh = model.tessellate(0, 0.01, &pool);
+    check(model.is_tessellated(0, 0.01) && model.is_tessellated(1, 0.01),
+          "cache: bodies of one shape share its mesh");
+    // Within one step of 2^(1/8), the same mesh serves.
+    check(model.is_tessellated(0, 0.0101), "cache: nearby tolerance not snapped");
+    check(model.tessellate(0, 0.0101, &pool).content_digest() == mesh.content_digest(),
+          "cache: nearby tolerance tessellated again");
+    check(!model.is_tessellated(0, 0.009), "cache: a finer step served by a coarser mesh");
+
+    // Copies share the cache; each shape keeps its four most recent meshes.
+    const Brep copy = model;
+    const double tolerances[] = {0.32, 0.16, 0.08, 0.04, 0.02};
+    for (const double tolerance : tolerances) {
+        copy.tessellate(0, tolerance, &pool);
+    }
+    check(!model.is_tessellated(0, 0.01), "cache: the oldest mesh was kept");
+    for (const double tolerance : tolerances) {
+        check(model.is_tessellated(0, tolerance) == (tolerance != 0.32),
+              "cache: mesh at " + std::to_string(tolerance));
+    }
+    // Using a mesh makes it recent.
+    model.tessellate(0, 0.16, &pool);
+    model.tessellate(0, 0.01, &pool);
+    check(model.is_tessellated(0, 0.16) && !model.is_tessellated(0, 0.08),
+          "cache: least recently used mesh kept");
+}
+
+} // namespace
+
+int main() {
+    const test::TempDir dir("brep");
+    const std::string path = dir.path("plates.step");
+    std::ofstream(path, std::ios::binary) << make_model();
+    ThreadPool pool(4);
+    test_tessellate(read_step(path, &pool), pool);
+    test_cache(path, pool);
+    check_throws<Error>([&] { read_step(dir.path("missing.step")); }, "missing file");
+    return test::finish("brep");
+}
@@ -0,0 +1,171 @@
+// Buffer: copies, slices and fan-out edges share storage; mutate() copies
+// only storage that is shared or not owned; allocations are aligned and go
+// to the thread's allocator; digests and equality follow the contents.
+
+#include "test.hpp"
+
+#include "rebelflow/buffer.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+void test_sharing() {
+    Buffer a = Buffer::allocate(ElementType::F64, 1000, 4);
+    check(reinterpret_cast<std::uintptr_t>(a.bytes()) % 64 == 0, "sharing: not aligned");
+    check(a.size() == 1000 && a.tuples() == 250 && a.size_bytes() == 8000, "sharing: shape");
+    std::span<double> values = a.mutate<double>();
+    std::iota(values.begin(), values.end(), 0.0);
+
+    // The sole owner edits in place.
+    const std::byte* before = a.bytes();
+    a.mutate<double>()[0] = -1;
+    check(a.bytes() == before && a.unique(), "sharing: unique buffer copied on mutate");
+
+    // A copy shares; writing through either copies first.
+    Buffer b = a;
+    check(b.shares_storage_with(a) && !a.unique(), "sharing: copy did not share");
+    b.mutate<double>()[1] = 42;
+    check(!b.shares_storage_with(a) && a.view<double>()[1] == 1 && b.view<double>()[1] == 42,
+          "sharing: copy-on-write");
+    check(a.bytes() == before, "sharing: the original moved");
+
+    // Slices share the parent's storage and copy only themselves on write.
+    Buffer slice = a.slice(100, 48);
+    check(slice.shares_storage_with(a) && slice.view<double>()[0] == 100, "sharing: slice");
+    slice.mutate<double>()[0] = 7;
+    check(slice.size() == 48 && slice.view<double>()[0] == 7 && a.view<double>()[100] == 100,
+          "sharing: slice write reached the parent");
+    check_throws<Error>([&] { a.slice(992, 16); }, "sharing: slice past the end");
+    check_throws<Error>([&] { a.slice(2, 4); }, "sharing: slice of part of a tuple");
+
+    // Adopted vectors keep their elements where they are.
+    std::vector<std::int32_t> v(100, 5);
+    const std::int32_t* data = v.data();
+    const Buffer adopted = Buffer::adopt(std::move(v));
+    check(adopted.view<std::int32_t>().data() == data, "sharing: adopt copied");
+    check_throws<TypeError>([&] { adopted.view<double>(); }, "sharing: view of the wrong type");
+
+    // Wrapped memory is never written.
+    std::vector<float> external(10, 1.0f);
+    Buffer wrapped = Buffer::wrap(ElementType::F32, external.data(), external.size(), nullptr);
+    wrapped.mutate<float>()[0] = 2;
+    check(external[0] == 1 && wrapped.view<float>()[0] == 2, "sharing: wrapped memory written");
+}
+
+void test_concat_and_digest() {
+    const std::vector<double> x = {1, 2, 3, 4, 5, 6};
+    const Buffer whole = Buffer::copy_of(std::span<const double>(x), 3);
+    const Buffer parts[] = {whole.slice(0, 3), whole.slice(3, 3)};
+    const Buffer joined = Buffer::concat(parts);
+    check(joined == whole && joined.components() == 3, "concat: contents");
+    check(Buffer::concat(std::span(parts, 1)).shares_storage_with(whole),
+          "concat: a single part was copied");
+    const Buffer mismatched[] = {whole, Buffer::allocate(ElementType::F32, 3, 3)};
+    check_throws<TypeError>([&] { Buffer::concat(mismatched); }, "concat: mixed types");
+
+    // Digests depend on contents and shape, not on storage.
+    check(joined.content_digest() == whole.content_digest(), "digest: equal contents");
+    check(whole.slice(0, 3).content_digest() == Buffer::copy_of(std::span(x).first(3), 3)
+                                                    .content_digest(),
+          "digest: slice");
+    check(Buffer::copy_of(std::span<const double>(x), 2).content_digest() !=
+              whole.content_digest(),
+          "digest: components ignored");
+    Buffer edited = whole;
+    edited.mutate<double>()[5] = 0;
+    check(edited.content_digest() != whole.content_digest() && !(edited == whole),
+          "digest: edit not seen");
+}
+
+/// Hands out heap blocks and counts them.
+class CountingAllocator final : public BufferAllocator {
+public:
+    std::shared_ptr<std::byte> allocate(std::size_t bytes) override {
+        ++calls;
+        const std::size_t rounded = (bytes + 63) / 64 * 64;
+        return std::shared_ptr<std::byte>(static_cast<std::byte*>(std::aligned_alloc(64, rounded)),
+                                          [](std::byte* p) { std::free(p); });
+    }
+    int calls = 0;
+};
+
+void test_allocator() {
+    CountingAllocator outer;
+    CountingAllocator inner;
+    const std::uint64_t start = buffer_bytes_allocated();
+    {
+        const ScopedBufferAllocator scope(outer);
+        Buffer::allocate(ElementType::U8, 100);
+        {
+            const ScopedBufferAllocator nested(inner);
+            Buffer::allocate(ElementType::U8, 100);
+        }
+        Buffer::allocate(ElementType::U8, 100);
+    }
+    Buffer::allocate(ElementType::U8, 100);
+    check(outer.calls == 2 && inner.calls == 1, "allocator: scopes");
+    check(buffer_bytes_allocated() - start >= 400, "allocator: bytes not counted");
+}
+
+void test_fan_out() {
+    // Range feeds two consumers; both see its buffer, not copies of it.
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    const Buffer* seen[2] = {};
+    for (int k = 0; k < 2; ++k) {
+        NodeType peek;
+        peek.name = "Peek" + std::to_string(k);
+        peek.inputs = {{"values", DataType::Buffer}};
+        peek.outputs = {{"values", DataType::Buffer}};
+        peek.compute = [&seen, k](NodeContext& ctx) {
+            seen[k] = &ctx.input(0).as_buffer();
+            ctx.set_output(0, ctx.input(0));
+        };
+        registry.add(std::move(peek));
+    }
+    Graph graph;
+    const NodeId range = graph.add_node(registry, "Range");
+    graph.set_param(range, "count", std::int64_t{100000});
+    const NodeId p0 = graph.add_node(registry, "Peek0");
+    const NodeId p1 = graph.add_node(registry, "Peek1");
+    const NodeId scale = graph.add_node(registry, "Scale");
+    const NodeId factor = graph.add_node(registry, "Constant");
+    graph.set_param(factor, "value", 2.0);
+    graph.connect({factor, 0}, {scale, 1});
+    graph.connect({range, 0}, {p0, 0});
+    graph.connect({range, 0}, {p1, 0});
+    graph.connect({p0, 0}, {scale, 0});
+    Executor executor(2);
+    executor.run(graph);
+    const Buffer& produced = executor.output(range).as_buffer();
+    check(executor.output(p0).as_buffer().shares_storage_with(produced) &&
+              executor.output(p1).as_buffer().shares_storage_with(produced),
+          "fan-out: consumers got copies");
+    check(seen[0] != nullptr && seen[1] != nullptr, "fan-out: consumers did not run");
+    // Scale writes, so it copies and the shared buffer is untouched.
+    const Buffer& scaled = executor.output(scale).as_buffer();
+    check(!scaled.shares_storage_with(produced) && produced.view<double>()[10] == 10 &&
+              scaled.view<double>()[10] == 20,
+          "fan-out: a writer changed a shared buffer");
+}
+
+} // namespace
+
+int main() {
+    test_sharing();
+    test_concat_and_digest();
+    test_allocator();
+    test_fan_out();
+    return test::finish("buffer");
+}
@@ -0,0 +1,338 @@
+// Bvh: ray, closest point and overlap queries agree with brute force over
+// every triangle, the hierarchy is the same however many threads build it,
+// and the query nodes reuse one hierarchy across edits to their queries.
+
+#include "test.hpp"
+
+#include "rebelflow/bvh.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/mesh.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+using Point = Bvh::Point;
+
+constexpr double inf = std::numeric_limits<double>::infinity();
+
+Point sub(const Point& a, const Point& b) {
+    return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+double dot(const Point& a, const Point& b) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+Point cross(const Point& a, const Point& b) {
+    return {a[1] * b[2] - a[2] * b[1], a[2] * b[0] - a[0] * b[2], a[0] * b[1] - a[1] * b[0]};
+}
+
+Point lerp3(const Point& a, const Point& b, const Point& c, double u, double v) {
+    Point p;
+    for (int k = 0; k < 3; ++k) {
+        p[k] = a[k] + u * (b[k] - a[k]) + v * (c[k] - a[k]);
+    }
+    return p;
+}
+
+std::array<Point, 3> corners(const Mesh& mesh, std::uint32_t f) {
+    const std::span<const double> p = mesh.positions();
+    const std::span<const std::uint32_t> c = mesh.arrays().corners.view<std::uint32_t>();
+    std::array<Point, 3> t;
+    for (int k = 0; k < 3; ++k) {
+        const std::uint32_t v = c[3 * f + k];
+        t[k] = {p[3 * v], p[3 * v + 1], p[3 * v + 2]};
+    }
+    return t;
+}
+
+/// Distance along the ray to triangle `t`, or infinity.
+double ray_triangle(const Point& origin, const Point& direction, const std::array<Point, 3>& t) {
+    const Point e1 = sub(t[1], t[0]);
+    const Point e2 = sub(t[2], t[0]);
+    const Point p = cross(direction, e2);
+    const double det = dot(e1, p);
+    if (det == 0) {
+        return inf;
+    }
+    const Point s = sub(origin, t[0]);
+    const double u = dot(s, p) / det;
+    const Point q = cross(s, e1);
+    const double v = dot(direction, q) / det;
+    const double d = dot(e2, q) / det;
+    return u >= 0 && v >= 0 && u + v <= 1 && d >= 0 ? d : inf;
+}
+
+/// The point of triangle `t` nearest to `x`, by a dense sweep of its
+/// barycentric coordinates refined around the best sample.
+Point near_on_triangle(const Point& x, const std::array<Point, 3>& t) {
+    double best_u = 0;
+    double best_v = 0;
+    double best = inf;
+    double step = 1.0 / 64;
+    double u0 = 0;
+    double v0 = 0;
+    double span = 1;
+    for (int round = 0; round < 6; ++round) {
+        for (double u = std::max(0.0, u0 - span); u <= std::min(1.0, u0 + span) + 1e-15;
+             u += step) {
+            for (double v = std::max(0.0, v0 - span); u + v <= 1 + 1e-15 && v <= v0 + span;
+                 v += step) {
+                const Point d = sub(lerp3(t[0], t[1], t[2], u, std::min(v, 1 - u)), x);
+                if (dot(d, d) < best) {
+                    best = dot(d, d);
+                    best_u = u;
+                    best_v = std::min(v, 1 - u);
+                }
+            }
+        }
+        u0 = best_u;
+        v0 = best_v;
+        span = 2 * step;
+        step /= 16;
+    }
+    return lerp3(t[0], t[1], t[2], best_u, best_v);
+}
+
+/// `count` small random triangles in the unit cube.
+Mesh soup(std::size_t count, std::uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> where(0, 1);
+    std::uniform_real_distribution<double> offset(-0.04, 0.04);
+    std::vector<double> positions;
+    std::vector<std::uint32_t> triangles;
+    for (std::size_t f = 0; f < count; ++f) {
+        const Point c = {where(random), where(random), where(random)};
+        for (int k = 0; k < 3; ++k) {
+            triangles.push_back(static_cast<std::uint32_t>(triangles.size()));
+            for (int a = 0; a < 3; ++a) {
+                positions.push_back(c[a] + offset(random));
+            }
+        }
+    }
+    return Mesh::from_triangles(Buffer::adopt(std::move(positions), 3),
+                                Buffer::adopt(std::move(triangles), 3));
+}
+
+/// The closed unit cube at the origin.
+Mesh cube() {
+    std::vector<double> positions;
+    for (int v = 0; v < 8; ++v) {
+        positions.insert(positions.end(), {static_cast<double>(v & 1),
+                                           static_cast<double>((v >> 1) & 1),
+                                           static_cast<double>(v >> 2)});
+    }
+    std::vector<std::uint32_t> triangles = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+                                            0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+                                            0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+    return Mesh::from_triangles(Buffer::adopt(std::move(positions), 3),
+                                Buffer::adopt(std::move(triangles), 3));
+}
+
+void test_build() {
+    const Mesh mesh = soup(5000, 1);
+    ThreadPool pool(4);
+    const Bvh serial = Bvh::build(mesh);
+    const Bvh parallel = Bvh::build(mesh, &pool);
+    check(serial == parallel && serial.content_digest() == parallel.content_digest(),
+          "build: depends on the threads");
+    check(Bvh::build(mesh, nullptr, 1).node_count() > serial.node_count(), "build: leaf size");
+
+    // Every triangle is in exactly one leaf.
+    const std::span<const std::uint32_t> tris = serial.arrays().triangles.view<std::uint32_t>();
+    std::vector<std::uint32_t> sorted(tris.begin(), tris.end());
+    std::sort(sorted.begin(), sorted.end());
+    bool all = sorted.size() == mesh.face_count();
+    for (std::uint32_t i = 0; all && i < sorted.size(); ++i) {
+        all = sorted[i] == i;
+    }
+    check(all, "build: triangles not a permutation");
+
+    const Bvh copy = Bvh::from_arrays(serial.arrays());
+    check(copy == serial, "build: from_arrays");
+    Bvh::Arrays bad = serial.arrays();
+    bad.links = Buffer::allocate(ElementType::U32, 4, 2);
+    check_throws<FormatError>([&] { Bvh::from_arrays(bad); }, "build: inconsistent arrays");
+    check(Bvh().node_count() == 0 && !Bvh().raycast({0, 0, 0}, {1, 0, 0}).hit(),
+          "build: empty hierarchy");
+}
+
+void test_raycast() {
+    const Mesh mesh = soup(3000, 2);
+    const Bvh bvh = Bvh::build(mesh);
+    std::mt19937 random(3);
+    std::uniform_real_distribution<double> where(-0.2, 1.2);
+    std::normal_distribution<double> axis;
+    int wrong = 0;
+    int hits = 0;
+    for (int r = 0; r < 500; ++r) {
+        const Point origin = {where(random), where(random), where(random)};
+        const Point direction = {axis(random), axis(random), axis(random)};
+        double expected = inf;
+        std::uint32_t triangle = Mesh::invalid;
+        for (std::uint32_t f = 0; f < mesh.face_count(); ++f) {
+            const double d = ray_triangle(origin, direction, corners(mesh, f));
+            if (d < expected) {
+                expected = d;
+                triangle = f;
+            }
+        }
+        const Bvh::RayHit hit = bvh.raycast(origin, direction);
+        hits += hit.hit() ? 1 : 0;
+        const bool same = hit.triangle == triangle &&
+                          (triangle == Mesh::invalid || std::abs(hit.distance - expected) < 1e-9);
+        // Where the hit is, u and v say.
+        const std::array<Point, 3> t = corners(mesh, hit.hit() ? hit.triangle : 0);
+        const Point at = lerp3(t[0], t[1], t[2], hit.u, hit.v);
+        const Point along = {origin[0] + hit.distance * direction[0],
+                             origin[1] + hit.distance * direction[1],
+                             origin[2] + hit.distance * direction[2]};
+        const bool placed = !hit.hit() || dot(sub(at, along), sub(at, along)) < 1e-18;
+        wrong += same && placed ? 0 : 1;
+
+        // A shorter reach misses what lies beyond it.
+        if (hit.hit() && bvh.raycast(origin, direction, expected * 0.999).hit()) {
+            ++wrong;
+        }
+    }
+    check(wrong == 0 && hits > 50, "raycast: " + std::to_string(wrong) + " wrong of 500, " +
+                                       std::to_string(hits) + " hits");
+
+    // Crossings tell inside from outside for a closed mesh.
+    const Bvh box = Bvh::build(cube());
+    check(box.crossings({0.5, 0.4, 0.3}, {0.3, 0.2, 1}) == 1 &&
+              box.crossings({1.5, 0.4, 0.3}, {-1, 0.1, 0.05}) == 2 &&
+              box.crossings({1.5, 0.4, 0.3}, {1, 0.1, 0.05}) == 0,
+          "raycast: crossings");
+}
+
+void test_closest_point() {
+    const Mesh mesh = soup(400, 4);
+    const Bvh bvh = Bvh::build(mesh);
+    std::mt19937 random(5);
+    std::uniform_real_distribution<double> where(-0.5, 1.5);
+    int wrong = 0;
+    for (int q = 0; q < 200; ++q) {
+        const Point x = {where(random), where(random), where(random)};
+        double expected = inf;
+        for (std::uint32_t f = 0; f < mesh.face_count(); ++f) {
+            const Point p = near_on_triangle(x, corners(mesh, f));
+            expected = std::min(expected, std::sqrt(dot(sub(p, x), sub(p, x))));
+        }
+        const Bvh::Nearest n = bvh.closest_point(x);
+        const Point d = sub(n.point, x);
+        const bool consistent = std::abs(std::sqrt(dot(d, d)) - n.distance) < 1e-9;
+        wrong += consistent && std::abs(n.distance - expected) < 1e-7 ? 0 : 1;
+        if (bvh.closest_point(x, expected * 0.99).triangle != Mesh::invalid) {
+            ++wrong;
+        }
+    }
+    check(wrong == 0, "closest point: " + std::to_string(wrong) + " wrong of 200");
+}
+
+/// Triangles in the z = `z` plane, one per cell of an `n` by `n` grid of
+/// spacing 1.
+Mesh tiles(int n, double z) {
+    std::vector<double> positions;
+    std::vector<std::uint32_t> triangles;
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            const std::uint32_t base = static_cast<std::uint32_t>(positions.size() / 3);
+            positions.insert(positions.end(), {i + 0.0, j + 0.0, z, i + 0.5, j + 0.0, z,
+                                               i + 0.0, j + 0.5, z});
+            triangles.insert(triangles.end(), {base, base + 1, base + 2});
+        }
+    }
+    return Mesh::from_triangles(Buffer::adopt(std::move(positions), 3),
+                                Buffer::adopt(std::move(triangles), 3));
+}
+
+void test_overlaps() {
+    ThreadPool pool(4);
+    const Bvh a = Bvh::build(tiles(30, 0));
+    const Bvh b = Bvh::build(tiles(30, 0.1));
+
+    // Each tile is 0.1 from its twin and at least 0.5 from the others.
+    const std::vector<Bvh::Overlap> near = a.overlaps(b, 0.2, &pool);
+    bool twins = near.size() == 900;
+    for (std::size_t k = 0; twins && k < near.size(); ++k) {
+        twins = near[k].first == k && near[k].second == k &&
+                std::abs(near[k].distance - 0.1) < 1e-9;
+    }
+    check(twins, "overlaps: " + std::to_string(near.size()) + " pairs");
+    check(a.overlaps(b, 0.05).empty(), "overlaps: pairs beyond the tolerance");
+    const std::vector<Bvh::Overlap> serial = a.overlaps(b, 0.2);
+    check(std::equal(serial.begin(), serial.end(), near.begin(), near.end(),
+                     [](const Bvh::Overlap& x, const Bvh::Overlap& y) {
+                         return x.first == y.first && x.second == y.second &&
+                                x.distance == y.distance;
+                     }),
+          "overlaps: depends on the threads");
+
+    // Within one mesh: tiles 0.5 apart in x and y, and diagonally farther.
+    check(a.self_overlaps(0.4).empty(), "self overlaps: beyond the tolerance");
+    const std::vector<Bvh::Overlap> within = a.self_overlaps(0.5, &pool);
+    check(within.size() == 2 * 30 * 29 &&
+              std::all_of(within.begin(), within.end(),
+                          [](const Bvh::Overlap& o) { return o.first < o.second; }),
+          "self overlaps: " + std::to_string(within.size()) + " pairs");
+    // Neighbours sharing a vertex are left out.
+    check(Bvh::build(cube()).self_overlaps(0).empty(), "self overlaps: neighbours");
+}
+
+void test_nodes() {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    register_mesh_nodes(registry);
+    Graph graph;
+    const NodeId grid = graph.add_node(registry, "Grid");
+    const NodeId build = graph.add_node(registry, "BuildBvh");
+    const NodeId origins = graph.add_node(registry, "Constant");
+    const double o[] = {0, 0, 1, 100, 0, 1};
+    graph.set_param(origins, "value", Buffer::copy_of(std::span<const double>(o), 3));
+    const NodeId direction = graph.add_node(registry, "Constant");
+    const double down[] = {0, 0, -1};
+    graph.set_param(direction, "value", Buffer::copy_of(std::span<const double>(down), 3));
+    const NodeId ray = graph.add_node(registry, "Raycast");
+    graph.connect({grid, 0}, {build, 0});
+    graph.connect({build, 0}, {ray, 0});
+    graph.connect({origins, 0}, {ray, 1});
+    graph.connect({direction, 0}, {ray, 2});
+    Executor executor(2);
+    executor.run(graph);
+    const Buffer& distance = executor.output(ray, 0).as_buffer();
+    const Buffer& triangle = executor.output(ray, 1).as_buffer();
+    check(distance.view<double>()[0] == 1 && std::isinf(distance.view<double>()[1]) &&
+              triangle.view<std::int32_t>()[0] >= 0 && triangle.view<std::int32_t>()[1] == -1,
+          "nodes: raycast hit and miss");
+
+    // Moving the rays reuses the hierarchy.
+    const double moved[] = {0.1, 0.1, 2, 100, 0, 1};
+    graph.set_param(origins, "value", Buffer::copy_of(std::span<const double>(moved), 3));
+    const RunStats stats = executor.run(graph);
+    check(stats.executed == std::vector<NodeId>{origins, ray} &&
+              executor.output(ray, 0).as_buffer().view<double>()[0] == 2,
+          "nodes: hierarchy rebuilt for new rays");
+}
+
+} // namespace
+
+int main() {
+    test_build();
+    test_raycast();
+    test_closest_point();
+    test_overlaps();
+    test_nodes();
+    return test::finish("bvh");
+}
@@ -0,0 +1,106 @@
+// CostModel: estimates average their samples, survive a save and load
+// whatever the type names hold, saves replace the file whole and malformed
+// files leave the estimates alone.
+
+#include "test.hpp"
+
+#include "rebelflow/cost_model.hpp"
+#include "rebelflow/error.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+using std::chrono::nanoseconds;
+
+void test_estimates() {
+    CostModel model(nanoseconds(500));
+    check(model.estimate("Unseen") == nanoseconds(500), "estimates: default cost");
+    model.record("Add", nanoseconds(100));
+    check(model.estimate("Add") == nanoseconds(100), "estimates: first sample");
+    model.record("Add", nanoseconds(300));
+    check(model.estimate("Add") == nanoseconds(200), "estimates: mean of two");
+    check(model.size() == 1, "estimates: size");
+    model.clear();
+    check(model.size() == 0 && model.estimate("Add") == nanoseconds(500), "estimates: clear");
+}
+
+void test_round_trip(const test::TempDir& dir) {
+    const std::vector<std::string> names = {
+        "Add", "with\ttab", "with\nnewline", "back\\slash", "\\t literally", "cr\r", "\\",
+        "sub/graph name"};
+    CostModel model;
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        model.record(names[i], nanoseconds(1000 * (i + 1)));
+    }
+    const std::string path = dir.path("costs.tsv");
+    model.save(path);
+
+    // One line per type, however odd its name.
+    std::ifstream in(path);
+    std::size_t lines = 0;
+    for (std::string line; std::getline(in, line);) {
+        ++lines;
+    }
+    check(lines == names.size(), "round trip: " + std::to_string(lines) + " lines");
+
+    CostModel loaded;
+    loaded.record("Kept", nanoseconds(7));
+    loaded.record("Add", nanoseconds(5));
+    loaded.load(path);
+    check(loaded.size() == names.size() + 1, "round trip: size " + std::to_string(loaded.size()));
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        check(loaded.estimate(names[i]) == nanoseconds(1000 * (i + 1)),
+              "round trip: estimate of type " + std::to_string(i));
+    }
+    check(loaded.estimate("Kept") == nanoseconds(7), "round trip: loading dropped a type");
+
+    // Saving again replaces the file and leaves no temporary behind.
+    CostModel small;
+    small.record("Only", nanoseconds(1));
+    small.save(path);
+    CostModel reread;
+    reread.load(path);
+    check(reread.size() == 1, "round trip: old entries survived a save");
+    std::size_t files = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir.path(""))) {
+        files += entry.path().filename().string().starts_with("costs.tsv");
+    }
+    check(files == 1, "round trip: temporaries left behind");
+
+    check_throws<IoError>([&] { small.save(dir.path("missing/costs.tsv")); },
+                          "round trip: missing directory");
+    check_throws<IoError>([&] { reread.load(dir.path("missing.tsv")); },
+                          "round trip: missing file");
+}
+
+void test_malformed(const test::TempDir& dir) {
+    for (const std::string& text :
+         {std::string("Add\t100\n"), std::string("\t100\t1\n"), std::string("Add\tx\t1\n"),
+          std::string("Add\t-5\t1\n"), std::string("bad\\q\t100\t1\n"),
+          std::string("cut\\\t100\t1\n")}) {
+        const std::string path = dir.path("bad.tsv");
+        std::ofstream(path) << "Good\t10\t1\n" << text;
+        CostModel model;
+        const std::string message =
+            check_throws<FormatError>([&] { model.load(path); }, "malformed: '" + text + "'");
+        check(message.find(":2:") != std::string::npos, "malformed: line in '" + message + "'");
+        check(model.size() == 0, "malformed: partial load");
+    }
+}
+
+} // namespace
+
+int main() {
+    const test::TempDir dir("cost_model");
+    test_estimates();
+    test_round_trip(dir);
+    test_malformed(dir);
+    return test::finish("cost_model");
+}
@@ -0,0 +1,247 @@
+// Distributed evaluation: messages cross connections intact, partitions
+// cover every node evenly, a graph spread over workers gives the executor's
+// results, workers reuse what they hold and fetch only what crosses
+// partitions, and node failures come back as ExecutionError.
+
+#include "test.hpp"
+
+#include "rebelflow/distributed.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+std::vector<std::byte> message(std::size_t size, int seed) {
+    std::vector<std::byte> data(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<std::byte>((i * 7 + seed) & 0xff);
+    }
+    return data;
+}
+
+void test_transport(const test::TempDir& dir) {
+    for (const std::string& address : {"unix:" + dir.path("echo.sock"), std::string("tcp::0")}) {
+        Listener listener = Listener::bind(address);
+        check(address[0] == 'u' || !listener.address().ends_with(":0"),
+              "transport: no port chosen in " + listener.address());
+        std::thread echo([&] {
+            Connection peer = listener.accept();
+            std::vector<std::byte> in;
+            while (peer.receive(in)) {
+                peer.send(in);
+            }
+        });
+        Connection client = Connection::connect(listener.address());
+        bool same = true;
+        for (const std::size_t size : {std::size_t{0}, std::size_t{1}, std::size_t{5000000}}) {
+            const std::vector<std::byte> out = message(size, static_cast<int>(size));
+            client.send(out);
+            std::vector<std::byte> in;
+            same = same && client.receive(in) && in == out;
+        }
+        check(same, "transport: echo over " + address);
+        check(client.bytes_sent() > 5000000 && client.bytes_received() == client.bytes_sent(),
+              "transport: byte counts");
+        client.close();
+        echo.join();
+    }
+
+    // A socket path held by another file is not replaced.
+    const std::string file = dir.path("taken.sock");
+    std::ofstream(file) << "keep";
+    check_throws<IoError>([&] { Listener::bind("unix:" + file); }, "transport: file replaced");
+    check(std::ifstream(file).get() == 'k', "transport: file changed");
+    check_throws<IoError>([&] { Connection::connect("unix:" + dir.path("none.sock")); },
+                          "transport: nothing listening");
+    check_throws<IoError>([&] { Connection::connect("carrier-pigeon:home"); },
+                          "transport: unknown scheme");
+
+    // shutdown() releases a waiting accept().
+    Listener listener = Listener::bind("unix:" + dir.path("quiet.sock"));
+    std::thread waiter([&] { check(!listener.accept().is_open(), "transport: accepted"); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    listener.shutdown();
+    waiter.join();
+}
+
+/// In-process workers, each serving on a UNIX socket of its own.
+class Workers {
+public:
+    Workers(const NodeRegistry& registry, const test::TempDir& dir, int count) {
+        for (int i = 0; i < count; ++i) {
+            std::string path = "unix:";
+            path += dir.path("worker" + std::to_string(i) + ".sock");
+            workers_.push_back(std::make_unique<DistributedWorker>(registry));
+            listeners_.push_back(std::make_unique<Listener>(Listener::bind(path)));
+            addresses.push_back(listeners_.back()->address());
+            threads_.emplace_back([this, i] { workers_[i]->serve(*listeners_[i]); });
+        }
+    }
+    ~Workers() {
+        for (auto& listener : listeners_) {
+            listener->shutdown();
+        }
+        for (std::thread& thread : threads_) {
+            thread.join();
+        }
+    }
+
+    DistributedWorker::Stats stats(int i) const { return workers_[i]->stats(); }
+
+    std::vector<std::string> addresses;
+
+private:
+    std::vector<std::unique_ptr<DistributedWorker>> workers_;
+    std::vector<std::unique_ptr<Listener>> listeners_;
+    std::vector<std::thread> threads_;
+};
+
+/// Four branches of Range -> Scale -> Sum over a shared factor, and a total.
+struct Branches {
+    Graph graph;
+    NodeId factor;
+    std::vector<NodeId> ranges;
+    std::vector<NodeId> sums;
+    NodeId total;
+
+    explicit Branches(const NodeRegistry& registry) {
+        factor = graph.add_node(registry, "Constant");
+        graph.set_param(factor, "value", 0.5);
+        total = graph.add_node(registry, "Constant");
+        for (int i = 0; i < 4; ++i) {
+            const NodeId range = graph.add_node(registry, "Range");
+            graph.set_param(range, "count", std::int64_t{1000 * (i + 1)});
+            const NodeId scale = graph.add_node(registry, "Scale");
+            const NodeId sum = graph.add_node(registry, "Sum");
+            graph.connect({range, 0}, {scale, 0});
+            graph.connect({factor, 0}, {scale, 1});
+            graph.connect({scale, 0}, {sum, 0});
+            const NodeId add = graph.add_node(registry, "Add");
+            graph.connect({total, 0}, {add, 0});
+            graph.connect({sum, 0}, {add, 1});
+            total = add;
+            ranges.push_back(range);
+            sums.push_back(sum);
+        }
+    }
+};
+
+void test_partition() {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    const Branches g(registry);
+    const std::vector<std::uint32_t> parts = partition_graph(g.graph, 3);
+    std::vector<int> sizes(3, 0);
+    for (const NodeId id : g.graph.nodes()) {
+        ++sizes.at(parts.at(id));
+    }
+    check(*std::min_element(sizes.begin(), sizes.end()) >= 5 &&
+              *std::max_element(sizes.begin(), sizes.end()) <= 7,
+          "partition: uneven groups");
+    const std::vector<std::uint32_t> one = partition_graph(g.graph, 1);
+    check(std::all_of(one.begin(), one.end(), [](std::uint32_t p) { return p == 0; }),
+          "partition: one group");
+}
+
+void test_run(const test::TempDir& dir) {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    NodeType fail;
+    fail.name = "Fail";
+    fail.inputs = {{"x", DataType::Float}};
+    fail.outputs = {{"y", DataType::Float}};
+    fail.compute = [](NodeContext& ctx) {
+        if (ctx.input(0).as_float() < 0) {
+            throw std::runtime_error("negative input");
+        }
+        ctx.set_output(0, ctx.input(0));
+    };
+    registry.add(std::move(fail));
+
+    Branches g(registry);
+    Executor local(2);
+    local.run(g.graph);
+
+    const Workers workers(registry, dir, 3);
+    DistributedExecutor remote(workers.addresses);
+    check(remote.worker_count() == 3, "run: workers");
+    DistributedStats stats = remote.run(g.graph);
+    check(stats.nodes == g.graph.node_count() && stats.worker_hits == 0, "run: first run");
+    bool same = true;
+    for (const NodeId id : g.graph.nodes()) {
+        same = same && remote.output(id) == local.output(id);
+    }
+    check(same, "run: results differ from the executor's");
+
+    // Nothing changed: every node is a worker hit and nothing is sent.
+    stats = remote.run(g.graph);
+    check(stats.worker_hits == stats.nodes && stats.values_sent == 0,
+          "run: " + std::to_string(stats.worker_hits) + " hits on an unchanged graph");
+
+    // An edit recomputes only its cone.
+    std::size_t computed = 0;
+    for (int i = 0; i < 3; ++i) {
+        computed += workers.stats(i).computed;
+    }
+    g.graph.set_param(g.ranges[2], "count", std::int64_t{10});
+    remote.run(g.graph);
+    std::size_t after = 0;
+    for (int i = 0; i < 3; ++i) {
+        after += workers.stats(i).computed;
+    }
+    local.run(g.graph);
+    // Range, Scale and Sum of the branch, and the two Adds after it.
+    check(after - computed == 5 && remote.output(g.total) == local.output(g.total),
+          "run: edit recomputed " + std::to_string(after - computed) + " nodes");
+
+    // Splitting every edge across workers ships values, but only once.
+    std::vector<std::uint32_t> alternate(g.graph.id_bound());
+    for (NodeId id = 0; id < alternate.size(); ++id) {
+        alternate[id] = id % 3;
+    }
+    g.graph.set_param(g.factor, "value", 0.25);
+    local.run(g.graph);
+    stats = remote.run(g.graph, alternate);
+    check(stats.values_sent > 0 && remote.output(g.total) == local.output(g.total),
+          "run: alternating assignment");
+    stats = remote.run(g.graph, alternate);
+    check(stats.values_sent == 0 && stats.worker_hits == stats.nodes,
+          "run: values sent again");
+
+    // Failures name the node; the next run after a fix succeeds.
+    const NodeId negative = g.graph.add_node(registry, "Constant");
+    g.graph.set_param(negative, "value", -1.0);
+    const NodeId failing = g.graph.add_node(registry, "Fail");
+    g.graph.connect({negative, 0}, {failing, 0});
+    const std::string failure =
+        check_throws<ExecutionError>([&] { remote.run(g.graph); }, "run: failing node");
+    check(failure.find("negative input") != std::string::npos,
+          "run: message '" + failure + "'");
+    g.graph.set_param(negative, "value", 1.0);
+    remote.run(g.graph);
+    check(remote.output(failing).as_float() == 1, "run: after failure");
+    check_throws<GraphError>([&] { remote.output(failing, 4); }, "run: unknown port");
+}
+
+} // namespace
+
+int main() {
+    const test::TempDir dir("distributed");
+    test_transport(dir);
+    test_partition();
+    test_run(dir);
+    return test::finish("distributed");
+}
@@ -0,0 +1,232 @@
+// Expression fusion: scripts fold constants, share equal subexpressions and
+// drop unused statements; Script::fuse() does the same across parts; and a
+// compiled plan runs a cluster of expression nodes as one fused script
+// with the same outputs as the executor, before and after parameter edits.
+
+#include "test.hpp"
+
+#include "rebelflow/compiled_plan.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/script.hpp"
+#include "rebelflow/script.hpp"
+
+#include <atomic>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+/// Instructions in `code` whose operation is `op`.
+int count_op(const std::string& code, const std::string& op) {
+    int count = 0;
+    const std::string needle = " = " + op + " ";
+    for (std::size_t at = code.find(needle); at != std::string::npos;
+         at = code.find(needle, at + 1)) {
+        ++count;
+    }
+    return count;
+}
+
+void test_folding() {
+    const std::string folded = Script::compile("a + 2 * 3 - (4 - 1)").disassemble();
+    check(count_op(folded, "mul") == 0 && count_op(folded, "add") + count_op(folded, "sub") == 2,
+          "folding: constants not folded:\n" + folded);
+
+    const std::string shared = Script::compile("sin(a) * sin(a) + cos(a) * sin(a)").disassemble();
+    check(count_op(shared, "sin") == 1 && count_op(shared, "cos") == 1,
+          "folding: equal subexpressions not shared:\n" + shared);
+
+    // Assigned names are evaluated once; statements the result does not use
+    // are dropped, and so are the inputs only they read.
+    const Script dropped = Script::compile("let s = sqrt(a)\nlet t = exp(b)\ns + s");
+    const std::string code = dropped.disassemble();
+    check(count_op(code, "sqrt") == 1 && count_op(code, "exp") == 0,
+          "folding: unused statement kept:\n" + code);
+    check(dropped.uses_input(0) && !dropped.uses_input(1), "folding: uses_input");
+
+    // Vector specializations fold too.
+    const std::string vector = Script::compile("a * (1 + 1) + vec(1, 2, 3) * 0").disassemble(1);
+    check(count_op(vector, "add") == 0, "folding: vector specialization:\n" + vector);
+}
+
+void test_fuse() {
+    // Each part needs a source per input, so parts name only what they use.
+    const Script twice = Script::compile("a * 2", {"a"});
+    const Script plus = Script::compile("a + b", {"a", "b"});
+    const Script wave = Script::compile("sin(a) + b", {"a", "b"});
+    const Script dot = Script::compile("dot(a, b)", {"a", "b"});
+
+    // Part 1 adds a constant to part 0's result; each part has a result.
+    {
+        const Script* parts[] = {&twice, &plus};
+        const std::vector<ScriptSource> sources[] = {
+            {ScriptSource::input(0)},
+            {ScriptSource::result(0), ScriptSource::constant_value(3.0)}};
+        const Script fused = Script::fuse(parts, sources, {"x"});
+        check(fused.result_count() == 2, "fuse: result count");
+        const Value x = 5.0;
+        const Value* inputs[] = {&x};
+        Value results[2];
+        fused.run_all(inputs, results);
+        check(results[0].as_float() == 10 && results[1].as_float() == 13, "fuse: results");
+        check(fused.run(inputs).as_float() == 10, "fuse: run() is the first result");
+    }
+
+    // Constants fold through part boundaries.
+    {
+        const Script* parts[] = {&twice, &plus};
+        const std::vector<ScriptSource> sources[] = {
+            {ScriptSource::constant_value(4.0)},
+            {ScriptSource::result(0), ScriptSource::input(0)}};
+        const std::string code = Script::fuse(parts, sources, {"x"}).disassemble();
+        check(count_op(code, "mul") == 0 && count_op(code, "add") == 1,
+              "fuse: constant not folded across parts:\n" + code);
+    }
+
+    // A subexpression two parts compute is evaluated once.
+    {
+        const Script* parts[] = {&wave, &wave};
+        const std::vector<ScriptSource> sources[] = {
+            {ScriptSource::input(0), ScriptSource::input(1)},
+            {ScriptSource::input(0), ScriptSource::constant_value(1.0)}};
+        const Script fused = Script::fuse(parts, sources, {"x", "y"});
+        const std::string code = fused.disassemble();
+        check(count_op(code, "sin") == 1, "fuse: shared subexpression repeated:\n" + code);
+        const Value x = 0.5;
+        const Value y = 2.0;
+        const Value* inputs[] = {&x, &y};
+        Value results[2];
+        fused.run_all(inputs, results);
+        check(results[0].as_float() == std::sin(0.5) + 2 &&
+                  results[1].as_float() == std::sin(0.5) + 1,
+              "fuse: shared subexpression results");
+    }
+
+    // Errors, here from specializing for two numbers, name the part at fault.
+    {
+        const Script* parts[] = {&twice, &dot};
+        const std::vector<ScriptSource> sources[] = {
+            {ScriptSource::input(0)}, {ScriptSource::result(0), ScriptSource::input(0)}};
+        const Script fused = Script::fuse(parts, sources, {"x"});
+        const Value x = 1.0;
+        const Value* inputs[] = {&x};
+        std::size_t part = 0;
+        check_throws<ScriptError>(
+            [&] {
+                try {
+                    fused.run(inputs);
+                } catch (const ScriptError& e) {
+                    part = e.part();
+                    throw;
+                }
+            },
+            "fuse: dot of numbers");
+        check(part == 1, "fuse: error part " + std::to_string(part));
+        const std::vector<ScriptSource> text[] = {
+            {ScriptSource::constant_value(std::string("2"))},
+            {ScriptSource::result(0), ScriptSource::input(0)}};
+        check_throws<TypeError>([&] { Script::fuse(parts, text, {"x"}); },
+                                "fuse: string constant");
+    }
+}
+
+/// x, y: Constants; s = x + y; m = s * s; r = Script "a - b" (m, x);
+/// p: pure node emitting a 3-vector Buffer, counting its runs;
+/// l = Script "length(a) + b" (p, r).
+struct Cluster {
+    Graph graph;
+    NodeId x, y, s, m, r, p, l;
+
+    explicit Cluster(const NodeRegistry& registry) {
+        x = graph.add_node(registry, "Constant");
+        graph.set_param(x, "value", 2.0);
+        y = graph.add_node(registry, "Constant");
+        graph.set_param(y, "value", 3.0);
+        s = graph.add_node(registry, "Add");
+        m = graph.add_node(registry, "Multiply");
+        r = graph.add_node(registry, "Script");
+        graph.set_param(r, "code", std::string("a - b"));
+        p = graph.add_node(registry, "Point");
+        l = graph.add_node(registry, "Script");
+        graph.set_param(l, "code", std::string("length(a) + b"));
+        graph.connect({x, 0}, {s, 0});
+        graph.connect({y, 0}, {s, 1});
+        graph.connect({s, 0}, {m, 0});
+        graph.connect({s, 0}, {m, 1});
+        graph.connect({m, 0}, {r, 0});
+        graph.connect({x, 0}, {r, 1});
+        graph.connect({p, 0}, {l, 0});
+        graph.connect({r, 0}, {l, 1});
+    }
+};
+
+void test_plan() {
+    std::atomic<int> points{0};
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    register_script_nodes(registry);
+    NodeType point;
+    point.name = "Point";
+    point.outputs = {{"point", DataType::Buffer}};
+    point.compute = [&points](NodeContext& ctx) {
+        ++points;
+        const double v[] = {3, 4, 0};
+        ctx.set_output(0, Buffer::copy_of(std::span<const double>(v), 3));
+    };
+    registry.add(std::move(point));
+    Cluster g(registry);
+
+    Executor executor(2);
+    executor.run(g.graph);
+    check(executor.output(g.l).as_float() == 5 + 23, "plan: executor result");
+    points = 0;
+
+    // One cluster; Buffer outputs are never run to be folded.
+    CompiledPlan plan = CompiledPlan::compile(g.graph);
+    check(plan.fusion_count() == 1, "plan: " + std::to_string(plan.fusion_count()) + " clusters");
+    check(points == 0, "plan: a buffer generator ran at compile time");
+    plan.run();
+    check(points == 1, "plan: generator runs");
+    bool same = true;
+    for (const NodeId node : g.graph.nodes()) {
+        same = same && (node == g.p || executor.output(node) == plan.output(node));
+    }
+    check(same, "plan: member outputs differ from the executor's");
+
+    // Editing a folded constant or a member's code rebuilds the cluster.
+    plan.set_param(g.x, "value", 1.0);
+    plan.run();
+    check(plan.output(g.s).as_float() == 4 && plan.output(g.l).as_float() == 5 + 15,
+          "plan: folded constant edit");
+    plan.set_param(g.r, "code", Value(std::string("a + b")));
+    plan.run();
+    check(plan.output(g.l).as_float() == 5 + 17, "plan: member code edit");
+    check_throws<ExecutionError>([&] { plan.set_param(g.r, "code", Value(std::string("a +"))); },
+                                 "plan: bad code");
+    plan.run();
+    check(plan.output(g.l).as_float() == 5 + 17, "plan: bad code replaced the old");
+
+    // Unfused plans agree.
+    PlanOptions options;
+    options.fuse_expressions = false;
+    CompiledPlan unfused = CompiledPlan::compile(g.graph, options);
+    unfused.run();
+    check(unfused.fusion_count() == 0 && unfused.output(g.l) == executor.output(g.l),
+          "plan: unfused result");
+}
+
+} // namespace
+
+int main() {
+    test_folding();
+    test_fuse();
+    test_plan();
+    return test::finish("fusion");
+}
@@ -0,0 +1,235 @@
+// Graph files: graphs and every kind of parameter round-trip, open() reads
+// only the directory and each graph is decoded the first time it is asked
+// for, once however many threads ask, and bad files are rejected with the
+// right error at the right time.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/graph_file.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+/// A node with a parameter of every kind, and one whose type the reader
+/// will not know.
+void register_test_nodes(NodeRegistry& registry, bool with_gone) {
+    register_builtin_nodes(registry);
+    NodeType params;
+    params.name = "Params";
+    params.outputs = {{"out", DataType::Int}};
+    params.params = {{"flag", false},
+                     {"count", std::int64_t{0}},
+                     {"weight", 0.0},
+                     {"label", std::string()},
+                     {"data", Buffer()}};
+    params.compute = [](NodeContext& ctx) { ctx.set_output(0, ctx.param(1)); };
+    registry.add(std::move(params));
+    if (with_gone) {
+        NodeType gone;
+        gone.name = "Gone";
+        gone.outputs = {{"out", DataType::Int}};
+        gone.compute = [](NodeContext& ctx) { ctx.set_output(0, std::int64_t{0}); };
+        registry.add(std::move(gone));
+    }
+}
+
+/// Range(count) -> Scale(by a constant) -> Sum.
+Graph make_main(const NodeRegistry& registry) {
+    Graph graph;
+    const NodeId range = graph.add_node(registry, "Range");
+    graph.set_param(range, "count", std::int64_t{100});
+    const NodeId factor = graph.add_node(registry, "Constant");
+    graph.set_param(factor, "value", 3.0);
+    const NodeId scale = graph.add_node(registry, "Scale");
+    const NodeId sum = graph.add_node(registry, "Sum");
+    graph.connect(range, "values", scale, "values");
+    graph.connect({factor, 0}, {scale, 1});
+    graph.connect({scale, 0}, {sum, 0});
+    return graph;
+}
+
+Graph make_chain(const NodeRegistry& registry, int length) {
+    Graph graph;
+    NodeId previous = graph.add_node(registry, "Constant");
+    graph.set_param(previous, "value", 1.0);
+    for (int i = 0; i < length; ++i) {
+        const NodeId add = graph.add_node(registry, "Add");
+        graph.connect({previous, 0}, {add, 0});
+        graph.connect({previous, 0}, {add, 1});
+        previous = add;
+    }
+    return graph;
+}
+
+void test_round_trip(const test::TempDir& dir) {
+    NodeRegistry registry;
+    register_test_nodes(registry, true);
+
+    Graph params;
+    const NodeId p = params.add_node(registry, "Params");
+    const std::vector<double> data = {1.5, 2.5, 3.5, 4.5, 5.5, 6.5};
+    params.set_param(p, "flag", true);
+    params.set_param(p, "count", std::int64_t{-7});
+    params.set_param(p, "weight", 0.125);
+    params.set_param(p, "label", std::string("tab\there, ünïcode"));
+    params.set_param(p, "data", Buffer::copy_of(std::span<const double>(data), 3));
+    // A removed node leaves a hole in the ids; the file renumbers densely.
+    params.remove_node(params.add_node(registry, "Params"));
+    params.add_node(registry, "Params");
+
+    Graph broken;
+    broken.add_node(registry, "Gone");
+
+    GraphFileWriter writer;
+    writer.add("main", make_main(registry));
+    writer.add("params", params);
+    writer.add("chain", make_chain(registry, 20000));
+    writer.add("broken", broken);
+    check_throws<GraphError>([&] { writer.add("main", params); }, "round trip: duplicate name");
+    const std::string path = dir.path("graphs.rfg");
+    writer.save(path);
+
+    // The reader does not know `Gone`; only asking for `broken` says so.
+    NodeRegistry reader;
+    register_test_nodes(reader, false);
+    const GraphFile file = GraphFile::open(path, reader);
+    check(file.graph_count() == 4 &&
+              file.names() == std::vector<std::string>{"broken", "chain", "main", "params"},
+          "round trip: names");
+    check(file.contains("chain") && !file.contains("other"), "round trip: contains");
+    check(file.node_count("chain") == 20001 && file.node_count("params") == 2,
+          "round trip: node counts");
+    for (const std::string& name : file.names()) {
+        check(!file.is_loaded(name), "round trip: " + name + " decoded by open()");
+    }
+
+    const std::shared_ptr<const Graph> loaded = file.graph("params");
+    check(file.is_loaded("params") && !file.is_loaded("chain") && !file.is_loaded("main"),
+          "round trip: asking for one graph decoded others");
+    check(file.graph("params") == loaded, "round trip: decoded twice");
+    const NodeId q = loaded->nodes().front();
+    check(loaded->node_count() == 2 && loaded->param(q, "flag").as_bool() &&
+              loaded->param(q, "count").as_int() == -7 &&
+              loaded->param(q, "weight").as_float() == 0.125 &&
+              loaded->param(q, "label").as_string() == "tab\there, ünïcode",
+          "round trip: scalar parameters");
+    const Buffer& buffer = loaded->param(q, "data").as_buffer();
+    check(buffer.components() == 3 && buffer == params.param(p, "data").as_buffer(),
+          "round trip: buffer parameter");
+
+    Executor executor(2);
+    executor.run(*file.graph("main"));
+    const std::vector<NodeId> order = file.graph("main")->topological_order();
+    check(executor.output(order.back()).as_float() == 3 * 4950, "round trip: main evaluates");
+
+    const std::string message =
+        check_throws<GraphError>([&] { file.graph("broken"); }, "round trip: unknown type");
+    check(message.find("Gone") != std::string::npos, "round trip: message '" + message + "'");
+    check_throws<GraphError>([&] { file.graph("other"); }, "round trip: unknown graph");
+    check_throws<GraphError>([&] { file.node_count("other"); }, "round trip: unknown count");
+
+    // Buffer parameters keep the mapping alive after the file is gone.
+    Buffer kept;
+    {
+        const GraphFile scoped = GraphFile::open(path, reader);
+        kept = scoped.graph("params")->param(q, "data").as_buffer();
+    }
+    check(kept.view<double>()[5] == 6.5, "round trip: buffer outlived its file");
+
+    // Saving over a mapped file leaves its readers with the old contents.
+    GraphFileWriter replacement;
+    replacement.add("main", make_chain(reader, 3));
+    replacement.save(path);
+    check(file.node_count("chain") == 20001 && file.graph("chain")->node_count() == 20001,
+          "round trip: replaced file changed an open reader");
+    check(GraphFile::open(path, reader).names() == std::vector<std::string>{"main"},
+          "round trip: replacement not visible to new readers");
+    check(load_graph(path, reader).node_count() == 4, "round trip: load_graph");
+}
+
+std::string graph_name(int g) {
+    std::string name = "g";
+    name += std::to_string(g);
+    return name;
+}
+
+void test_concurrent_decode(const test::TempDir& dir) {
+    NodeRegistry registry;
+    register_test_nodes(registry, false);
+    GraphFileWriter writer;
+    for (int g = 0; g < 8; ++g) {
+        writer.add(graph_name(g), make_chain(registry, 2000 + g));
+    }
+    const std::string path = dir.path("concurrent.rfg");
+    writer.save(path);
+    const GraphFile file = GraphFile::open(path, registry);
+
+    // Every thread asks for every graph; each graph is decoded once and all
+    // threads get the same one.
+    std::vector<std::vector<const Graph*>> seen(8);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            for (int g = 0; g < 8; ++g) {
+                seen[t].push_back(file.graph(graph_name((g + t) % 8)).get());
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    bool same = true;
+    for (int t = 0; t < 8; ++t) {
+        for (int g = 0; g < 8; ++g) {
+            same = same && seen[t][g] == file.graph(graph_name((g + t) % 8)).get();
+        }
+    }
+    check(same, "concurrent: threads got different copies");
+    check(file.graph(graph_name(5))->node_count() == 2006, "concurrent: wrong graph");
+}
+
+void test_bad_files(const test::TempDir& dir) {
+    NodeRegistry registry;
+    register_test_nodes(registry, false);
+    check_throws<IoError>([&] { GraphFile::open(dir.path("missing.rfg"), registry); },
+                          "bad files: missing");
+    const std::string text = dir.path("text.rfg");
+    std::ofstream(text) << "not a graph file, but long enough to hold a header and more\n";
+    check_throws<FormatError>([&] { GraphFile::open(text, registry); }, "bad files: foreign");
+
+    // A graph file cut short fails in open(), not later.
+    GraphFileWriter writer;
+    writer.add("main", make_chain(registry, 100));
+    const std::string whole = dir.path("whole.rfg");
+    writer.save(whole);
+    const auto size = std::filesystem::file_size(whole);
+    for (const auto keep : {std::uintmax_t{8}, size / 2, size - 1}) {
+        const std::string cut = dir.path("cut.rfg");
+        std::filesystem::copy_file(whole, cut, std::filesystem::copy_options::overwrite_existing);
+        std::filesystem::resize_file(cut, keep);
+        std::string what = "bad files: cut to ";
+        what += std::to_string(keep);
+        check_throws<FormatError>([&] { GraphFile::open(cut, registry); }, what);
+    }
+}
+
+} // namespace
+
+int main() {
+    const test::TempDir dir("graph_file");
+    test_round_trip(dir);
+    test_concurrent_decode(dir);
+    test_bad_files(dir);
+    return test::finish("graph_file");
+}
@@ -0,0 +1,218 @@
+// Incremental evaluation: a run recomputes exactly the nodes that changed
+// and their downstream cone, reuses every other node's outputs, and after a
+// failure recomputes what did not complete.
+
+#include "test.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+/// Computations of each node, by id.
+struct Counts {
+    std::vector<std::atomic<int>> runs = std::vector<std::atomic<int>>(64);
+    std::atomic<bool> fail{false};
+
+    std::vector<int> take() {
+        std::vector<int> out;
+        for (std::atomic<int>& r : runs) {
+            out.push_back(r.exchange(0));
+        }
+        return out;
+    }
+};
+
+/// `Source` emits its `value`; `Step` adds 1 to its input and fails while
+/// `fail` is set.
+NodeRegistry make_registry(Counts& counts) {
+    NodeRegistry registry;
+    NodeType source;
+    source.name = "Source";
+    source.outputs = {{"out", DataType::Float}};
+    source.params = {{"value", 0.0}};
+    source.compute = [&counts](NodeContext& ctx) {
+        ++counts.runs[ctx.node()];
+        ctx.set_output(0, ctx.param(0));
+    };
+    registry.add(std::move(source));
+
+    NodeType step;
+    step.name = "Step";
+    step.inputs = {{"in", DataType::Float}};
+    step.outputs = {{"out", DataType::Float}};
+    step.compute = [&counts](NodeContext& ctx) {
+        ++counts.runs[ctx.node()];
+        if (counts.fail) {
+            throw std::runtime_error("step failed");
+        }
+        ctx.set_output(0, ctx.input(0).as_float() + 1);
+    };
+    registry.add(std::move(step));
+    return registry;
+}
+
+/// a -> b -> c, and d -> e beside it.
+struct Chains {
+    Graph graph;
+    NodeId a, b, c, d, e;
+
+    explicit Chains(const NodeRegistry& registry) {
+        a = graph.add_node(registry, "Source");
+        b = graph.add_node(registry, "Step");
+        c = graph.add_node(registry, "Step");
+        d = graph.add_node(registry, "Source");
+        e = graph.add_node(registry, "Step");
+        graph.connect({a, 0}, {b, 0});
+        graph.connect({b, 0}, {c, 0});
+        graph.connect({d, 0}, {e, 0});
+        graph.set_param(d, "value", 10.0);
+    }
+};
+
+bool ran(const std::vector<int>& runs, std::initializer_list<NodeId> nodes, std::size_t bound) {
+    for (NodeId id = 0; id < bound; ++id) {
+        const bool expected = std::find(nodes.begin(), nodes.end(), id) != nodes.end();
+        if (runs[id] != (expected ? 1 : 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_reuse() {
+    Counts counts;
+    const NodeRegistry registry = make_registry(counts);
+    Chains g(registry);
+    Executor executor(4);
+    const NodeId bound = g.graph.id_bound();
+
+    RunStats stats = executor.run(g.graph);
+    check(ran(counts.take(), {g.a, g.b, g.c, g.d, g.e}, bound), "reuse: first run");
+    check(stats.executed.size() == 5 && stats.nodes_reused == 0, "reuse: first run stats");
+    check(executor.output(g.c).as_float() == 2 && executor.output(g.e).as_float() == 11,
+          "reuse: first outputs");
+
+    // Nothing changed: nothing runs.
+    stats = executor.run(g.graph);
+    check(ran(counts.take(), {}, bound) && stats.executed.empty() && stats.nodes_reused == 5,
+          "reuse: unchanged graph recomputed");
+
+    // A parameter edit recomputes its cone, in topological order.
+    g.graph.set_param(g.a, "value", 5.0);
+    stats = executor.run(g.graph);
+    check(ran(counts.take(), {g.a, g.b, g.c}, bound), "reuse: parameter edit");
+    check(stats.executed == std::vector<NodeId>{g.a, g.b, g.c}, "reuse: executed order");
+    check(stats.nodes_reused == 2, "reuse: " + std::to_string(stats.nodes_reused) + " reused");
+    check(executor.output(g.c).as_float() == 7 && executor.output(g.e).as_float() == 11,
+          "reuse: outputs after edit");
+
+    // Touching a node, or re-wiring its input, dirties it like an edit.
+    g.graph.touch(g.b);
+    executor.run(g.graph);
+    check(ran(counts.take(), {g.b, g.c}, bound), "reuse: touch");
+    g.graph.connect({g.d, 0}, {g.c, 0});
+    executor.run(g.graph);
+    check(ran(counts.take(), {g.c}, bound), "reuse: re-wiring");
+    check(executor.output(g.c).as_float() == 11, "reuse: re-wired output");
+
+    // invalidate() drops a node's outputs and its cone's; invalidate_all()
+    // everything.
+    executor.invalidate(g.d);
+    executor.run(g.graph);
+    check(ran(counts.take(), {g.d, g.e, g.c}, bound), "reuse: invalidate");
+    executor.invalidate_all();
+    executor.run(g.graph);
+    check(ran(counts.take(), {g.a, g.b, g.c, g.d, g.e}, bound), "reuse: invalidate_all");
+
+    // A new node runs alone; a removed one is forgotten.
+    const NodeId f = g.graph.add_node(registry, "Step");
+    g.graph.connect({g.e, 0}, {f, 0});
+    executor.run(g.graph);
+    check(ran(counts.take(), {f}, g.graph.id_bound()), "reuse: added node");
+    check(executor.output(f).as_float() == 12, "reuse: added node output");
+    g.graph.remove_node(f);
+    stats = executor.run(g.graph);
+    check(stats.executed.empty(), "reuse: removing a leaf recomputed others");
+    check_throws<GraphError>([&] { executor.output(f); }, "reuse: removed node output");
+}
+
+void test_failure() {
+    Counts counts;
+    const NodeRegistry registry = make_registry(counts);
+    Chains g(registry);
+    Executor executor(4);
+    executor.run(g.graph);
+    counts.take();
+
+    g.graph.set_param(g.a, "value", 1.0);
+    g.graph.set_param(g.d, "value", 2.0);
+    counts.fail = true;
+    check_throws<ExecutionError>([&] { executor.run(g.graph); }, "failure: run");
+    const std::vector<int> failed = counts.take();
+    check_throws<GraphError>([&] { executor.output(g.c); }, "failure: stale output readable");
+
+    // The failed nodes and those cancelled after them stay dirty; what
+    // completed is kept. Which source ran before the failure cancelled the
+    // rest depends on the workers.
+    counts.fail = false;
+    executor.run(g.graph);
+    const std::vector<int> runs = counts.take();
+    check(runs[g.a] + failed[g.a] == 1 && runs[g.d] + failed[g.d] == 1,
+          "failure: a source completed before the failure was recomputed");
+    check(runs[g.b] == 1 && runs[g.c] == 1 && runs[g.e] == 1,
+          "failure: the failed cone was not recomputed");
+    check(executor.output(g.c).as_float() == 3 && executor.output(g.e).as_float() == 3,
+          "failure: outputs after retry");
+}
+
+void test_builtin_chain() {
+    // A long chain of built-in nodes: editing the head recomputes all of it,
+    // editing the middle only the rest.
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    Graph graph;
+    const NodeId head = graph.add_node(registry, "Constant");
+    graph.set_param(head, "value", 1.0);
+    const NodeId one = graph.add_node(registry, "Constant");
+    graph.set_param(one, "value", 1.0);
+    std::vector<NodeId> chain;
+    NodeId previous = head;
+    for (int i = 0; i < 1000; ++i) {
+        const NodeId add = graph.add_node(registry, "Add");
+        graph.connect({previous, 0}, {add, 0});
+        graph.connect({one, 0}, {add, 1});
+        chain.push_back(add);
+        previous = add;
+    }
+    Executor executor(4);
+    check(executor.run(graph).executed.size() == 1002, "chain: first run");
+    check(executor.output(previous).as_float() == 1001, "chain: sum");
+
+    graph.set_param(head, "value", 2.0);
+    check(executor.run(graph).executed.size() == 1001, "chain: head edit");
+    check(executor.output(previous).as_float() == 1002, "chain: sum after head edit");
+
+    graph.touch(chain[899]);
+    const RunStats stats = executor.run(graph);
+    check(stats.executed.size() == 101 && stats.executed.front() == chain[899],
+          "chain: middle touched, " + std::to_string(stats.executed.size()) + " ran");
+}
+
+} // namespace
+
+int main() {
+    test_reuse();
+    test_failure();
+    test_builtin_chain();
+    return test::finish("incremental");
+}
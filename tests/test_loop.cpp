@@ -0,0 +1,233 @@
+// Collections: parallel_for() covers every index once, Map and for-each
+// nodes produce per-item results in item order over numbers and vectors,
+// Reduce combines in order whether or not it runs as a tree, and failures
+// name the item at fault.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/loop.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+void test_parallel_for() {
+    ThreadPool pool(4);
+    for (ThreadPool* p : {&pool, static_cast<ThreadPool*>(nullptr)}) {
+        for (const std::size_t count : {std::size_t{0}, std::size_t{1}, std::size_t{10007}}) {
+            std::vector<std::atomic<int>> hits(count);
+            std::atomic<bool> small{false};
+            parallel_for(p, count, 100, [&](std::size_t begin, std::size_t end) {
+                small = small || (end - begin < 100 && end != count);
+                for (std::size_t i = begin; i < end; ++i) {
+                    ++hits[i];
+                }
+            });
+            bool once = true;
+            for (const std::atomic<int>& h : hits) {
+                once = once && h == 1;
+            }
+            std::string what = "parallel_for: ";
+            what += std::to_string(count);
+            what += p != nullptr ? " with a pool" : " inline";
+            check(once && !small, what);
+        }
+    }
+    check_throws<std::runtime_error>(
+        [&] {
+            parallel_for(&pool, 1000, 10, [](std::size_t begin, std::size_t) {
+                if (begin >= 500) {
+                    throw std::runtime_error("range failed");
+                }
+            });
+        },
+        "parallel_for: exception");
+}
+
+NodeRegistry make_registry() {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    register_loop_nodes(registry);
+    return registry;
+}
+
+/// A 3-component collection of `count` vectors (i, 2i, 0).
+Buffer vectors(std::size_t count) {
+    std::vector<double> v;
+    for (std::size_t i = 0; i < count; ++i) {
+        const double x = static_cast<double>(i);
+        v.insert(v.end(), {x, 2 * x, 0.0});
+    }
+    return Buffer::copy_of(std::span<const double>(v), 3);
+}
+
+void test_map() {
+    const NodeRegistry registry = make_registry();
+    Graph graph;
+    const NodeId range = graph.add_node(registry, "Range");
+    graph.set_param(range, "count", std::int64_t{10000});
+    const NodeId two = graph.add_node(registry, "Constant");
+    graph.set_param(two, "value", 2.0);
+    const NodeId map = graph.add_node(registry, "Map");
+    graph.set_param(map, "code", std::string("x * a + i"));
+    graph.set_param(map, "grain", std::int64_t{64});
+    graph.connect({range, 0}, {map, 0});
+    graph.connect({two, 0}, {map, 1});
+    Executor executor(4);
+    executor.run(graph);
+    const Buffer numbers = executor.output(map).as_buffer();
+    bool right = numbers.size() == 10000 && numbers.components() == 1;
+    for (std::size_t i = 0; right && i < 10000; ++i) {
+        right = numbers.view<double>()[i] == 3.0 * i;
+    }
+    check(right, "map: numbers");
+
+    // Vector items in, numbers or vectors out.
+    const NodeId points = graph.add_node(registry, "Constant");
+    graph.set_param(points, "value", vectors(1000));
+    graph.connect({points, 0}, {map, 0});
+    graph.set_param(map, "code", std::string("x * a"));
+    executor.run(graph);
+    const Buffer scaled = executor.output(map).as_buffer();
+    check(scaled.components() == 3 && scaled.size() == 3000 &&
+              scaled.view<double>()[2997] == 1998 && scaled.view<double>()[2998] == 3996,
+          "map: vectors");
+    graph.set_param(map, "code", std::string("x.y"));
+    executor.run(graph);
+    check(executor.output(map).as_buffer().components() == 1 &&
+              executor.output(map).as_buffer().view<double>()[999] == 1998,
+          "map: vector items, number results");
+
+    // Empty collections map to empty buffers; items must be a buffer, and
+    // every item must give the same kind of result.
+    graph.set_param(points, "value", Buffer::allocate(ElementType::F64, 0, 3));
+    executor.run(graph);
+    check(executor.output(map).as_buffer().size() == 0, "map: empty collection");
+    graph.set_param(points, "value", 1.0);
+    check_throws<ExecutionError>([&] { executor.run(graph); }, "map: number as items");
+    graph.connect({range, 0}, {map, 0});
+    graph.set_param(map, "code", std::string("i < 5000 ? x : vec(x, x, x)"));
+    check_throws<ExecutionError>([&] { executor.run(graph); }, "map: mixed results");
+}
+
+double reduce(Executor& executor, Graph& graph, NodeId node, const std::string& code,
+              bool associative) {
+    graph.set_param(node, "code", code);
+    graph.set_param(node, "associative", associative);
+    executor.run(graph);
+    return executor.output(node).as_float();
+}
+
+void test_reduce() {
+    const NodeRegistry registry = make_registry();
+    Graph graph;
+    const NodeId range = graph.add_node(registry, "Range");
+    graph.set_param(range, "count", std::int64_t{100000});
+    const NodeId node = graph.add_node(registry, "Reduce");
+    graph.set_param(node, "grain", std::int64_t{100});
+    graph.connect({range, 0}, {node, 0});
+    Executor executor(4);
+
+    // Sums are exact here, so tree and left-to-right agree bit for bit.
+    const double sum = 99999.0 * 100000 / 2;
+    check(reduce(executor, graph, node, "a + b", true) == sum &&
+              reduce(executor, graph, node, "a + b", false) == sum,
+          "reduce: sum");
+    check(reduce(executor, graph, node, "max(a, b)", true) == 99999, "reduce: max");
+    // Associative but not commutative: keeps the last item only in order.
+    check(reduce(executor, graph, node, "b", true) == 99999, "reduce: tree order");
+    check(reduce(executor, graph, node, "a", true) == 0, "reduce: tree order, first");
+
+    // The initial value goes in front.
+    const NodeId initial = graph.add_node(registry, "Constant");
+    graph.set_param(initial, "value", 1e10);
+    graph.connect({initial, 0}, {node, 1});
+    check(reduce(executor, graph, node, "a - b", false) == 1e10 - sum, "reduce: initial");
+    check(reduce(executor, graph, node, "a", true) == 1e10, "reduce: initial in tree");
+    graph.set_param(range, "count", std::int64_t{0});
+    check(reduce(executor, graph, node, "a + b", true) == 1e10, "reduce: empty collection");
+
+    // Vector items reduce to a vector.
+    const NodeId points = graph.add_node(registry, "Constant");
+    graph.set_param(points, "value", vectors(5000));
+    graph.connect({points, 0}, {node, 0});
+    graph.disconnect({node, 1});
+    graph.set_param(node, "code", std::string("a + b"));
+    executor.run(graph);
+    const Buffer total = executor.output(node).as_buffer();
+    check(total.size() == 3 && total.view<double>()[1] == 4999.0 * 5000, "reduce: vectors");
+}
+
+void test_for_each() {
+    NodeRegistry registry = make_registry();
+    // out = x * k + offset, failing for x == 17.
+    NodeType affine;
+    affine.name = "Affine";
+    affine.inputs = {{"x", DataType::Float}, {"k", DataType::Float, 1.0}};
+    affine.outputs = {{"out", DataType::Float}, {"twice", DataType::Any}};
+    affine.params = {{"offset", 0.0}};
+    affine.compute = [](NodeContext& ctx) {
+        const double x = ctx.input(0).as_float();
+        if (x == 17) {
+            throw std::runtime_error("seventeen");
+        }
+        ctx.set_output(0, x * ctx.input(1).as_float() + ctx.param(0).as_float());
+        ctx.set_output(1, 2 * x);
+    };
+    const std::shared_ptr<const NodeType> body = registry.add(std::move(affine));
+    const std::shared_ptr<const NodeType> each =
+        registry.add(for_each_type("EachAffine", body, 16));
+    check(each->inputs[0].name == "items" && each->inputs[1].name == "k" &&
+              each->outputs.size() == 2 && each->params.size() == 1,
+          "for-each: ports");
+
+    Graph graph;
+    const NodeId range = graph.add_node(registry, "Range");
+    graph.set_param(range, "count", std::int64_t{17});
+    const NodeId k = graph.add_node(registry, "Constant");
+    graph.set_param(k, "value", 3.0);
+    const NodeId node = graph.add_node(registry, "EachAffine");
+    graph.set_param(node, "offset", 0.5);
+    graph.connect({range, 0}, {node, 0});
+    graph.connect({k, 0}, {node, 1});
+    Executor executor(4);
+    executor.run(graph);
+    const Buffer out = executor.output(node, 0).as_buffer();
+    const Buffer twice = executor.output(node, 1).as_buffer();
+    check(out.size() == 17 && out.view<double>()[16] == 48.5 && twice.view<double>()[16] == 32,
+          "for-each: outputs");
+
+    graph.set_param(range, "count", std::int64_t{1000});
+    const std::string message =
+        check_throws<ExecutionError>([&] { executor.run(graph); }, "for-each: failing item");
+    check(message.find("item 17") != std::string::npos &&
+              message.find("seventeen") != std::string::npos,
+          "for-each: message '" + message + "'");
+
+    NodeType source;
+    source.name = "NoInputs";
+    source.outputs = {{"out", DataType::Float}};
+    check_throws<GraphError>(
+        [&] { for_each_type("EachSource", std::make_shared<const NodeType>(source)); },
+        "for-each: body without inputs");
+}
+
+} // namespace
+
+int main() {
+    test_parallel_for();
+    test_map();
+    test_reduce();
+    test_for_each();
+    return test::finish("loop");
+}
@@ -0,0 +1,159 @@
+// Mesh files: every format reads back the mesh it was written from, writes
+// replace files whole through a temporary of their own, so that writers of
+// the same path never collide and leave nothing behind, and malformed files
+// are rejected.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/mesh_io.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+/// A `nx` x `ny` grid, lifted so that every vertex differs.
+Mesh grid(std::uint32_t nx, std::uint32_t ny) {
+    std::vector<double> p;
+    std::vector<std::uint32_t> t;
+    for (std::uint32_t y = 0; y < ny; ++y) {
+        for (std::uint32_t x = 0; x < nx; ++x) {
+            p.insert(p.end(), {x * 0.5, y * 0.25, std::sin(x * 0.1 + y * 0.2)});
+            if (x + 1 < nx && y + 1 < ny) {
+                const std::uint32_t v = y * nx + x;
+                t.insert(t.end(), {v, v + 1, v + nx + 1, v, v + nx + 1, v + nx});
+            }
+        }
+    }
+    return Mesh::from_triangles(Buffer::adopt(std::move(p), 3), Buffer::adopt(std::move(t), 3));
+}
+
+bool close(double a, double b, double tolerance) {
+    return std::abs(a - b) <= tolerance * (1 + std::abs(b));
+}
+
+/// Whether the faces of `a` and `b` have the same corner positions, face by
+/// face, whatever the vertex numbering.
+bool same_geometry(const Mesh& a, const Mesh& b, double tolerance) {
+    if (a.face_count() != b.face_count()) {
+        return false;
+    }
+    for (std::uint32_t h = 0; h < a.halfedge_count(); ++h) {
+        for (std::uint32_t k = 0; k < 3; ++k) {
+            if (!close(a.positions()[a.origin(h) * 3 + k], b.positions()[b.origin(h) * 3 + k],
+                       tolerance)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void test_round_trip(const test::TempDir& dir) {
+    const Mesh mesh = grid(60, 40);
+    ThreadPool pool(4);
+    for (const auto& [name, binary] : std::vector<std::pair<std::string, bool>>{
+             {"grid.ply", true}, {"grid_text.ply", false}, {"grid.obj", false},
+             {"grid.stl", true}, {"grid_text.stl", false}}) {
+        const std::string path = dir.path(name);
+        const std::uint64_t size = write_mesh(mesh, path, binary, &pool);
+        check(size == std::filesystem::file_size(path), name + ": reported size");
+
+        const Mesh back = read_mesh(path, &pool);
+        check(back.vertex_count() == mesh.vertex_count(),
+              name + ": " + std::to_string(back.vertex_count()) + " vertices");
+        // Binary STL stores single precision; the rest round-trip exactly.
+        const bool single = binary && name.ends_with(".stl");
+        check(same_geometry(back, mesh, single ? 1e-6 : 0), name + ": geometry differs");
+        if (!name.ends_with(".stl")) {
+            check(std::equal(back.corners().begin(), back.corners().end(),
+                             mesh.corners().begin(), mesh.corners().end()),
+                  name + ": faces renumbered");
+        }
+        // Reading without a pool gives the same mesh.
+        check(read_mesh(path).content_digest() == back.content_digest(),
+              name + ": serial and parallel reads differ");
+    }
+}
+
+void test_replace(const test::TempDir& dir) {
+    const std::string path = dir.path("replace.ply");
+    write_mesh(grid(60, 40), path);
+    const Mesh small = grid(3, 3);
+    write_mesh(small, path);
+    check(read_mesh(path).face_count() == small.face_count(), "replace: old contents remain");
+
+    struct stat info {};
+    check(::stat(path.c_str(), &info) == 0 && (info.st_mode & 0777) == 0644,
+          "replace: the file is not readable by others");
+
+    // Writers of the same path each use a temporary of their own, so every
+    // write succeeds and the file is one of theirs, whole.
+    std::vector<std::thread> writers;
+    std::vector<int> failed(8, 0);
+    for (std::uint32_t i = 0; i < failed.size(); ++i) {
+        writers.emplace_back([&, i] {
+            try {
+                for (int n = 0; n < 10; ++n) {
+                    write_mesh(grid(20 + i, 20), path);
+                }
+            } catch (const IoError&) {
+                failed[i] = 1;
+            }
+        });
+    }
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    check(std::count(failed.begin(), failed.end(), 1) == 0, "replace: a concurrent write failed");
+    const Mesh last = read_mesh(path);
+    check(last.vertex_count() % 20 == 0 && last.vertex_count() >= 400 &&
+              last.vertex_count() < 560,
+          "replace: torn file");
+
+    std::size_t files = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir.path(""))) {
+        files += entry.path().filename().string().starts_with("replace.ply");
+    }
+    check(files == 1, "replace: " + std::to_string(files - 1) + " temporaries left behind");
+
+    // A directory that does not exist fails before anything is written.
+    check_throws<IoError>([&] { write_mesh(small, dir.path("missing/grid.ply")); },
+                          "replace: missing directory");
+}
+
+void test_malformed(const test::TempDir& dir) {
+    const auto write_text = [&](const std::string& name, const std::string& text) {
+        std::ofstream(dir.path(name)) << text;
+        return dir.path(name);
+    };
+    const std::string obj = write_text("bad.obj", "v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 9\n");
+    check_throws<FormatError>([&] { read_mesh(obj); }, "malformed: face index out of range");
+    const std::string ply = write_text("bad.ply", "ply\nformat ascii 1.0\nelement vertex 3\n");
+    check_throws<FormatError>([&] { read_mesh(ply); }, "malformed: truncated ply header");
+    check_throws<IoError>([&] { read_mesh(dir.path("missing.stl")); }, "malformed: missing file");
+    check_throws<Error>([&] { mesh_format_of("grid.off"); }, "malformed: unknown extension");
+}
+
+} // namespace
+
+int main() {
+    const test::TempDir dir("mesh_io");
+    test_round_trip(dir);
+    test_replace(dir);
+    test_malformed(dir);
+    return test::finish("mesh_io");
+}
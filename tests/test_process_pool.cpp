@@ -0,0 +1,176 @@
+// Process pool: isolated nodes run in other processes with their inputs,
+// parameters and buffers intact, errors come back as the error they were, and
+// a worker that crashes or exits fails only its node, names the signal or
+// exit, and is replaced for the next one.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/process_pool.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <numeric>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+enum class Fate : std::int64_t { Ok, Throw, Abort, Kill };
+
+/// Isolated test nodes:
+/// - `Pid`: its process id.
+/// - `Fill`: `count` doubles 0, 1, 2, ... and `label` repeated twice.
+/// - `Total`: the sum of a buffer, after meeting its `fate`.
+void register_test_nodes(NodeRegistry& registry) {
+    register_builtin_nodes(registry);
+    NodeType pid;
+    pid.name = "Pid";
+    pid.outputs = {{"pid", DataType::Int}};
+    pid.compute = [](NodeContext& ctx) { ctx.set_output(0, std::int64_t{::getpid()}); };
+    pid.pure = false;
+    pid.isolated = true;
+    registry.add(std::move(pid));
+
+    NodeType fill;
+    fill.name = "Fill";
+    fill.outputs = {{"values", DataType::Buffer}, {"label", DataType::String}};
+    fill.params = {{"count", std::int64_t{0}}, {"label", std::string()}};
+    fill.compute = [](NodeContext& ctx) {
+        Buffer out = Buffer::allocate(ElementType::F64, ctx.param(0).as_int());
+        std::span<double> values = out.mutate<double>();
+        std::iota(values.begin(), values.end(), 0.0);
+        ctx.set_output(0, std::move(out));
+        ctx.set_output(1, ctx.param(1).as_string() + ctx.param(1).as_string());
+    };
+    fill.isolated = true;
+    registry.add(std::move(fill));
+
+    NodeType total;
+    total.name = "Total";
+    total.inputs = {{"values", DataType::Buffer}, {"fate", DataType::Int, std::int64_t{0}}};
+    total.outputs = {{"sum", DataType::Float}};
+    total.compute = [](NodeContext& ctx) {
+        switch (static_cast<Fate>(ctx.input(1).as_int())) {
+        case Fate::Ok: break;
+        case Fate::Throw: throw TypeError("total of the wrong thing");
+        case Fate::Abort: std::abort();
+        case Fate::Kill: std::raise(SIGKILL); break;
+        }
+        const std::span<const double> values = ctx.input(0).as_buffer().view<double>();
+        ctx.set_output(0, std::accumulate(values.begin(), values.end(), 0.0));
+    };
+    total.isolated = true;
+    registry.add(std::move(total));
+}
+
+/// Runs `Total` directly on the pool.
+double total(ProcessPool& pool, const NodeRegistry& registry, const Buffer& values, Fate fate) {
+    const Value in = values;
+    const Value how = static_cast<std::int64_t>(fate);
+    const Value* inputs[] = {&in, &how};
+    Value out;
+    pool.run(*registry.get("Total"), 0, inputs, {}, std::span(&out, 1));
+    return out.as_float();
+}
+
+void test_direct(ProcessPool& pool, const NodeRegistry& registry) {
+    const std::vector<double> x = {1, 2, 3.5};
+    const Buffer values = Buffer::copy_of(std::span<const double>(x));
+    check(total(pool, registry, values, Fate::Ok) == 6.5, "direct: result");
+
+    // Node errors keep their type and leave the worker running.
+    const std::size_t restarts = pool.restarts();
+    const std::string message = check_throws<TypeError>(
+        [&] { total(pool, registry, values, Fate::Throw); }, "direct: thrown error");
+    check(message.find("wrong thing") != std::string::npos, "direct: message '" + message + "'");
+    check(pool.restarts() == restarts, "direct: a node error restarted its worker");
+
+    // Crashes and exits fail the node, and the worker is replaced.
+    const std::string crash = check_throws<Error>(
+        [&] { total(pool, registry, values, Fate::Abort); }, "direct: abort");
+    check(crash.find("crashed") != std::string::npos && crash.find("Abort") != std::string::npos,
+          "direct: crash message '" + crash + "'");
+    const std::string killed = check_throws<Error>(
+        [&] { total(pool, registry, values, Fate::Kill); }, "direct: killed");
+    check(killed.find("exited") != std::string::npos, "direct: kill message '" + killed + "'");
+    bool all = true;
+    for (unsigned i = 0; i < 2 * pool.size(); ++i) {
+        all = all && total(pool, registry, values, Fate::Ok) == 6.5;
+    }
+    check(all && pool.restarts() == restarts + 2,
+          "direct: " + std::to_string(pool.restarts() - restarts) + " restarts");
+}
+
+void test_executor(ProcessPool& pool, const NodeRegistry& registry) {
+    Graph graph;
+    const NodeId pid = graph.add_node(registry, "Pid");
+    const NodeId fill = graph.add_node(registry, "Fill");
+    graph.set_param(fill, "count", std::int64_t{1000000});
+    graph.set_param(fill, "label", std::string("ab"));
+    const NodeId range = graph.add_node(registry, "Range");
+    graph.set_param(range, "count", std::int64_t{1000});
+    const NodeId fate = graph.add_node(registry, "Constant");
+    graph.set_param(fate, "value", std::int64_t{0});
+    // Several totals of each buffer: shared-memory output to another
+    // worker, and a local buffer copied in.
+    std::vector<NodeId> of_fill;
+    std::vector<NodeId> of_range;
+    for (int i = 0; i < 4; ++i) {
+        of_fill.push_back(graph.add_node(registry, "Total"));
+        graph.connect({fill, 0}, {of_fill.back(), 0});
+        of_range.push_back(graph.add_node(registry, "Total"));
+        graph.connect({range, 0}, {of_range.back(), 0});
+        graph.connect({fate, 0}, {of_range.back(), 1});
+    }
+
+    Executor executor(4);
+    executor.set_process_pool(&pool);
+    executor.run(graph);
+    check(executor.output(pid).as_int() != ::getpid(), "executor: node ran in this process");
+    check(executor.output(fill, 1).as_string() == "abab", "executor: string output");
+    const Buffer& filled = executor.output(fill).as_buffer();
+    check(filled.size() == 1000000 && filled.view<double>()[999999] == 999999,
+          "executor: buffer output");
+    bool sums = true;
+    for (int i = 0; i < 4; ++i) {
+        sums = sums && executor.output(of_fill[i]).as_float() == 999999.0 * 1000000 / 2 &&
+               executor.output(of_range[i]).as_float() == 999.0 * 1000 / 2;
+    }
+    check(sums, "executor: sums");
+
+    // A crash fails the run with the node named; fixing it recovers.
+    graph.set_param(fate, "value", static_cast<std::int64_t>(Fate::Abort));
+    const std::string message =
+        check_throws<ExecutionError>([&] { executor.run(graph); }, "executor: crash");
+    check(message.find("Total") != std::string::npos &&
+              message.find("crashed") != std::string::npos,
+          "executor: message '" + message + "'");
+    graph.set_param(fate, "value", std::int64_t{0});
+    executor.run(graph);
+    check(executor.output(of_range[3]).as_float() == 999.0 * 1000 / 2, "executor: after crash");
+}
+
+} // namespace
+
+int main() {
+    // The crash tests abort workers; keep them from writing core files.
+    const rlimit no_core = {0, 0};
+    ::setrlimit(RLIMIT_CORE, &no_core);
+
+    // The pool forks before any thread starts.
+    NodeRegistry registry;
+    register_test_nodes(registry);
+    ProcessPool pool(registry, 2);
+    test_direct(pool, registry);
+    test_executor(pool, registry);
+    return test::finish("process_pool");
+}
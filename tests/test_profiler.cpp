@@ -0,0 +1,131 @@
+// Profiler: every node execution is recorded with the bytes it allocated,
+// arena scratch and Buffers alike; a node that throws is recorded and
+// flagged, its run marked failed; the Chrome trace carries both.
+
+#include "test.hpp"
+
+#include "rebelflow/executor.hpp"
+#include "rebelflow/profiler.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+struct Fixture {
+    NodeRegistry registry;
+    Graph graph;
+    NodeId alloc = invalid_node;
+    NodeId scratch = invalid_node;
+    NodeId fail = invalid_node;
+
+    Fixture() {
+        // 8000 f64 of Buffer storage, the node's output.
+        NodeType alloc_type;
+        alloc_type.name = "Alloc";
+        alloc_type.outputs = {{"values", DataType::Buffer}};
+        alloc_type.compute = [](NodeContext& ctx) {
+            ctx.set_output(0, Buffer::allocate(ElementType::F64, 8000));
+        };
+        // 4000 f64 of arena scratch and nothing kept.
+        NodeType scratch_type;
+        scratch_type.name = "Scratch";
+        scratch_type.inputs = {{"values", DataType::Buffer}};
+        scratch_type.outputs = {{"count", DataType::Int}};
+        scratch_type.compute = [](NodeContext& ctx) {
+            std::span<double> tmp = ctx.arena().allocate_array<double>(4000);
+            std::fill(tmp.begin(), tmp.end(), 1.0);
+            ctx.set_output(0, static_cast<std::int64_t>(ctx.input(0).as_buffer().size()));
+        };
+        // Allocates, then throws when its `fail` parameter is set.
+        NodeType fail_type;
+        fail_type.name = "Fail";
+        fail_type.inputs = {{"count", DataType::Int}};
+        fail_type.outputs = {{"out", DataType::Int}};
+        fail_type.params = {{"fail", false}};
+        fail_type.compute = [](NodeContext& ctx) {
+            const Buffer kept = Buffer::allocate(ElementType::U8, 1000);
+            if (ctx.param(0).as_bool()) {
+                throw std::runtime_error("node failed on purpose");
+            }
+            ctx.set_output(0, ctx.input(0));
+        };
+
+        alloc = graph.add_node(registry.add(std::move(alloc_type)));
+        scratch = graph.add_node(registry.add(std::move(scratch_type)));
+        fail = graph.add_node(registry.add(std::move(fail_type)));
+        graph.connect({alloc, 0}, {scratch, 0});
+        graph.connect({scratch, 0}, {fail, 0});
+    }
+};
+
+const NodeProfile* find(const std::vector<NodeProfile>& nodes, NodeId id) {
+    const auto it = std::find_if(nodes.begin(), nodes.end(),
+                                 [&](const NodeProfile& p) { return p.node == id; });
+    return it == nodes.end() ? nullptr : &*it;
+}
+
+void test_bytes() {
+    Fixture f;
+    Profiler profiler;
+    Executor executor(2);
+    executor.set_profiler(&profiler);
+    executor.run(f.graph);
+
+    const std::vector<NodeProfile> nodes = profiler.nodes();
+    check(nodes.size() == 3, "bytes: " + std::to_string(nodes.size()) + " records");
+    const NodeProfile* alloc = find(nodes, f.alloc);
+    const NodeProfile* scratch = find(nodes, f.scratch);
+    const NodeProfile* fail = find(nodes, f.fail);
+    if (alloc == nullptr || scratch == nullptr || fail == nullptr) {
+        check(false, "bytes: a node was not recorded");
+        return;
+    }
+    check(alloc->bytes_allocated >= 8000 * sizeof(double) &&
+              alloc->bytes_allocated < 9000 * sizeof(double),
+          "bytes: buffer allocation counted as " + std::to_string(alloc->bytes_allocated));
+    check(scratch->bytes_allocated >= 4000 * sizeof(double) &&
+              scratch->bytes_allocated < 5000 * sizeof(double),
+          "bytes: arena scratch counted as " + std::to_string(scratch->bytes_allocated));
+    check(fail->bytes_allocated >= 1000 && !fail->failed, "bytes: passing node");
+    check(!profiler.runs().empty() && !profiler.runs().back().failed, "bytes: run marked failed");
+}
+
+void test_failure() {
+    Fixture f;
+    f.graph.set_param(f.fail, "fail", true);
+    Profiler profiler;
+    Executor executor(2);
+    executor.set_profiler(&profiler);
+    check_throws<ExecutionError>([&] { executor.run(f.graph); }, "failure");
+
+    const std::vector<NodeProfile> nodes = profiler.nodes();
+    const NodeProfile* fail = find(nodes, f.fail);
+    check(fail != nullptr, "failure: the failing node was not recorded");
+    if (fail != nullptr) {
+        check(fail->failed, "failure: record not flagged");
+        check(fail->bytes_allocated >= 1000, "failure: allocation before the throw lost");
+        check(fail->type && fail->type->name == "Fail", "failure: type");
+    }
+    const NodeProfile* alloc = find(nodes, f.alloc);
+    check(alloc != nullptr && !alloc->failed, "failure: upstream node flagged");
+    check(profiler.runs().size() == 1 && profiler.runs()[0].failed, "failure: run not failed");
+
+    std::ostringstream trace;
+    profiler.write_chrome_trace(trace);
+    check(trace.str().find("\"failed\":true") != std::string::npos,
+          "failure: trace does not show the failure");
+}
+
+} // namespace
+
+int main() {
+    test_bytes();
+    test_failure();
+    return test::finish("profiler");
+}
@@ -0,0 +1,157 @@
+// Pull evaluation: pull() runs only the dirty nodes the requested outputs
+// depend on and counts the rest as skipped, nodes it leaves stale are
+// recomputed by the next run() that needs them, and a compiled plan limited
+// to some outputs compiles only their cone.
+
+#include "test.hpp"
+
+#include "rebelflow/compiled_plan.hpp"
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+/// Computations of each node, by id.
+struct Counts {
+    std::vector<std::atomic<int>> runs = std::vector<std::atomic<int>>(16);
+
+    std::vector<NodeId> take() {
+        std::vector<NodeId> out;
+        for (NodeId id = 0; id < runs.size(); ++id) {
+            if (runs[id].exchange(0) != 0) {
+                out.push_back(id);
+            }
+        }
+        return out;
+    }
+};
+
+/// `Source` emits its `value`; `Step` adds 1 to its input.
+NodeRegistry make_registry(Counts& counts) {
+    NodeRegistry registry;
+    NodeType source;
+    source.name = "Source";
+    source.outputs = {{"out", DataType::Float}};
+    source.params = {{"value", 0.0}};
+    source.compute = [&counts](NodeContext& ctx) {
+        ++counts.runs[ctx.node()];
+        ctx.set_output(0, ctx.param(0));
+    };
+    registry.add(std::move(source));
+
+    NodeType step;
+    step.name = "Step";
+    step.inputs = {{"in", DataType::Float}};
+    step.outputs = {{"out", DataType::Float}};
+    step.compute = [&counts](NodeContext& ctx) {
+        ++counts.runs[ctx.node()];
+        ctx.set_output(0, ctx.input(0).as_float() + 1);
+    };
+    registry.add(std::move(step));
+    return registry;
+}
+
+/// a feeds b -> c and d -> e; f stands alone.
+struct Fork {
+    Graph graph;
+    NodeId a, b, c, d, e, f;
+
+    explicit Fork(const NodeRegistry& registry) {
+        a = graph.add_node(registry, "Source");
+        b = graph.add_node(registry, "Step");
+        c = graph.add_node(registry, "Step");
+        d = graph.add_node(registry, "Step");
+        e = graph.add_node(registry, "Step");
+        f = graph.add_node(registry, "Source");
+        graph.connect({a, 0}, {b, 0});
+        graph.connect({b, 0}, {c, 0});
+        graph.connect({a, 0}, {d, 0});
+        graph.connect({d, 0}, {e, 0});
+    }
+};
+
+void test_upstream() {
+    Counts counts;
+    const Fork g(make_registry(counts));
+    const NodeId c[] = {g.c};
+    check(g.graph.upstream(c) == std::vector<NodeId>{g.a, g.b, g.c}, "upstream: one target");
+    const NodeId both[] = {g.e, g.b};
+    const std::vector<NodeId> cone = g.graph.upstream(both);
+    check(cone.size() == 4 && cone.front() == g.a &&
+              std::find(cone.begin(), cone.end(), g.c) == cone.end(),
+          "upstream: two targets");
+    const NodeId unknown[] = {99};
+    check_throws<GraphError>([&] { g.graph.upstream(unknown); }, "upstream: unknown node");
+}
+
+void test_pull() {
+    Counts counts;
+    const NodeRegistry registry = make_registry(counts);
+    Fork g(registry);
+    Executor executor(4);
+
+    // Only c's cone runs; the others are skipped and have no outputs.
+    const PortRef c[] = {{g.c, 0}};
+    RunStats stats = executor.pull(g.graph, c);
+    check(counts.take() == std::vector<NodeId>{g.a, g.b, g.c}, "pull: cone");
+    check(stats.nodes_skipped == 3, "pull: " + std::to_string(stats.nodes_skipped) + " skipped");
+    check(executor.output(g.c).as_float() == 2, "pull: output");
+    check_throws<GraphError>([&] { executor.output(g.e); }, "pull: skipped node has outputs");
+
+    // Pulling again computes nothing; pulling e runs only what is missing.
+    executor.pull(g.graph, c);
+    check(counts.take().empty(), "pull: up-to-date cone recomputed");
+    const PortRef e[] = {{g.e, 0}};
+    executor.pull(g.graph, e);
+    check(counts.take() == std::vector<NodeId>{g.d, g.e}, "pull: second branch");
+
+    // An edit upstream of both branches: pulling one leaves the other stale,
+    // and the next run() brings it, and only it, up to date.
+    g.graph.set_param(g.a, "value", 10.0);
+    executor.pull(g.graph, c);
+    check(counts.take() == std::vector<NodeId>{g.a, g.b, g.c}, "pull: after edit");
+    check_throws<GraphError>([&] { executor.output(g.e); }, "pull: stale output readable");
+    stats = executor.run(g.graph);
+    check(counts.take() == std::vector<NodeId>{g.d, g.e, g.f} && stats.nodes_skipped == 0,
+          "pull: run after pull");
+    check(executor.output(g.e).as_float() == 12 && executor.output(g.c).as_float() == 12,
+          "pull: outputs after run");
+
+    const PortRef unknown[] = {{99, 0}};
+    check_throws<GraphError>([&] { executor.pull(g.graph, unknown); }, "pull: unknown node");
+}
+
+void test_plan() {
+    Counts counts;
+    const Fork g(make_registry(counts));
+    PlanOptions options;
+    options.outputs = {{g.c, 0}};
+    CompiledPlan plan = CompiledPlan::compile(g.graph, options);
+    check(plan.instruction_count() == 3, "plan: " + std::to_string(plan.instruction_count()) +
+                                             " instructions");
+    plan.run();
+    check(counts.take() == std::vector<NodeId>{g.a, g.b, g.c}, "plan: cone");
+    check(plan.output(g.c).as_float() == 2, "plan: output");
+    check_throws<GraphError>([&] { plan.output(g.e); }, "plan: node outside the cone");
+
+    options.outputs = {{g.c, 3}};
+    check_throws<GraphError>([&] { CompiledPlan::compile(g.graph, options); },
+                             "plan: unknown output port");
+}
+
+} // namespace
+
+int main() {
+    test_upstream();
+    test_pull();
+    test_plan();
+    return test::finish("pull");
+}
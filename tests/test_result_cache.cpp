@@ -0,0 +1,220 @@
+// ResultCache: entries survive closing and reopening the file, a foreign or
+// resized file starts over, one process at a time holds the file, least
+// recently used entries make room for new ones, and an executor with a
+// cache loads what an earlier one computed.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/result_cache.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+constexpr std::uint64_t capacity = 1 << 20;
+
+Digest key(std::uint64_t n) {
+    return Hasher().update(n).digest();
+}
+
+std::vector<std::byte> payload(std::uint64_t n, std::size_t size) {
+    std::vector<std::byte> data(size);
+    for (std::size_t i = 0; i < size; ++i) {
+        data[i] = static_cast<std::byte>((n * 131 + i) & 0xff);
+    }
+    return data;
+}
+
+bool holds(ResultCache& cache, std::uint64_t n, std::size_t size) {
+    std::vector<std::byte> out;
+    return cache.get(key(n), out) && out == payload(n, size);
+}
+
+void test_persistence(const test::TempDir& dir) {
+    const std::string path = dir.path("persist.cache");
+    {
+        ResultCache cache(path, capacity);
+        for (std::uint64_t n = 0; n < 50; ++n) {
+            cache.put(key(n), payload(n, 1000 + n));
+        }
+        check(cache.stats().entries == 50, "persistence: entries");
+        check(holds(cache, 7, 1007), "persistence: get");
+        std::vector<std::byte> out;
+        check(!cache.get(key(999), out), "persistence: unknown key found");
+    }
+    {
+        ResultCache cache(path, capacity);
+        bool all = cache.stats().entries == 50;
+        for (std::uint64_t n = 0; all && n < 50; ++n) {
+            all = holds(cache, n, 1000 + n);
+        }
+        check(all, "persistence: entries lost on reopening");
+        cache.clear();
+        check(cache.stats().entries == 0 && !cache.contains(key(1)), "persistence: clear");
+    }
+    {
+        ResultCache cache(path, capacity);
+        check(cache.stats().entries == 0, "persistence: clear not persisted");
+        cache.put(key(1), payload(1, 10));
+    }
+
+    // A different size or a foreign file starts empty, never fails.
+    {
+        ResultCache cache(path, 2 * capacity);
+        check(cache.capacity() == 2 * capacity && cache.stats().entries == 0,
+              "persistence: resized file kept its entries");
+    }
+    const std::string foreign = dir.path("foreign.cache");
+    std::ofstream(foreign, std::ios::binary) << std::string(capacity, 'x');
+    {
+        ResultCache cache(foreign, capacity);
+        check(cache.stats().entries == 0, "persistence: foreign file read as entries");
+        cache.put(key(2), payload(2, 100));
+        check(holds(cache, 2, 100), "persistence: reinitialized file unusable");
+    }
+    check_throws<Error>([&] { ResultCache(dir.path("tiny.cache"), 1024); },
+                        "persistence: tiny capacity");
+}
+
+void test_locking(const test::TempDir& dir) {
+    const std::string path = dir.path("locked.cache");
+    {
+        ResultCache cache(path, capacity);
+        cache.put(key(3), payload(3, 300));
+
+        // A second holder, in this process or another, is refused and does
+        // not disturb the file.
+        const std::string message = check_throws<IoError>(
+            [&] { ResultCache(path, capacity); }, "locking: second open in process");
+        check(message.find("in use") != std::string::npos, "locking: message '" + message + "'");
+        check_throws<IoError>([&] { ResultCache(path, 2 * capacity); },
+                              "locking: second open with another size");
+        const pid_t child = ::fork();
+        if (child == 0) {
+            try {
+                ResultCache other(path, capacity);
+                ::_exit(0);
+            } catch (const IoError&) {
+                ::_exit(3);
+            }
+        }
+        int status = 0;
+        ::waitpid(child, &status, 0);
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 3,
+              "locking: another process opened a held cache");
+        check(holds(cache, 3, 300) && cache.capacity() == capacity,
+              "locking: refused opener disturbed the file");
+    }
+    // Released on destruction.
+    ResultCache cache(path, capacity);
+    check(holds(cache, 3, 300), "locking: entry lost after release");
+}
+
+void test_eviction(const test::TempDir& dir) {
+    ResultCache cache(dir.path("lru.cache"), 256 * 1024);
+    const std::size_t size = 16 * 1024;
+    cache.put(key(0), payload(0, size));
+    for (std::uint64_t n = 1; n < 64; ++n) {
+        // Key 0 stays the most recently used throughout.
+        check(holds(cache, 0, size), "eviction: recently used entry evicted at " +
+                                         std::to_string(n));
+        cache.put(key(n), payload(n, size));
+    }
+    const ResultCacheStats stats = cache.stats();
+    check(stats.evictions > 0 && stats.bytes_used <= 256 * 1024, "eviction: nothing evicted");
+    check(!cache.contains(key(1)) && cache.contains(key(63)), "eviction: not least recent first");
+
+    // Too large for the cache: not stored, nothing evicted.
+    const std::uint64_t before = cache.stats().entries;
+    cache.put(key(100), payload(100, 200 * 1024));
+    check(!cache.contains(key(100)) && cache.stats().entries == before, "eviction: huge entry");
+
+    // Mixed sizes fragment the data region; compaction keeps everything
+    // readable.
+    bool intact = true;
+    for (std::uint64_t n = 200; n < 600; ++n) {
+        const std::size_t s = 100 + (n * 7919) % 20000;
+        cache.put(key(n), payload(n, s));
+        intact = intact && holds(cache, n, s);
+    }
+    check(intact, "eviction: entry corrupted by compaction");
+}
+
+void test_executor(const test::TempDir& dir) {
+    std::atomic<int> computed{0};
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    NodeType count_type;
+    count_type.name = "CountedScale";
+    count_type.inputs = {{"values", DataType::Buffer}};
+    count_type.outputs = {{"values", DataType::Buffer}};
+    count_type.compute = [&computed](NodeContext& ctx) {
+        ++computed;
+        Buffer out = ctx.input(0).as_buffer();
+        for (double& x : out.mutate<double>()) {
+            x *= 2;
+        }
+        ctx.set_output(0, std::move(out));
+    };
+    registry.add(std::move(count_type));
+
+    Graph graph;
+    const NodeId range = graph.add_node(registry, "Range");
+    graph.set_param(range, "count", std::int64_t{1000});
+    const NodeId scale = graph.add_node(registry, "CountedScale");
+    const NodeId sum = graph.add_node(registry, "Sum");
+    graph.connect({range, 0}, {scale, 0});
+    graph.connect({scale, 0}, {sum, 0});
+
+    const std::string path = dir.path("executor.cache");
+    {
+        ResultCache cache(path, capacity);
+        Executor executor(2);
+        executor.set_result_cache(&cache);
+        const RunStats stats = executor.run(graph);
+        check(stats.cache_hits == 0 && computed == 1, "executor: first run");
+        check(executor.output(sum).as_float() == 999000, "executor: first sum");
+    }
+    {
+        // A fresh executor, in what could be a later session, loads all of it.
+        ResultCache cache(path, capacity);
+        Executor executor(2);
+        executor.set_result_cache(&cache);
+        const RunStats stats = executor.run(graph);
+        check(stats.cache_hits == 3 && computed == 1,
+              "executor: " + std::to_string(stats.cache_hits) + " hits after reopening");
+        check(executor.output(sum).as_float() == 999000, "executor: loaded sum");
+
+        // A parameter edit misses from the edit on, and is stored too.
+        graph.set_param(range, "count", std::int64_t{10});
+        executor.run(graph);
+        check(computed == 2 && executor.output(sum).as_float() == 90, "executor: edited run");
+        graph.set_param(range, "count", std::int64_t{1000});
+        const RunStats back = executor.run(graph);
+        check(back.cache_hits == 3 && computed == 2, "executor: edit undone not served");
+    }
+}
+
+} // namespace
+
+int main() {
+    const test::TempDir dir("result_cache");
+    test_persistence(dir);
+    test_locking(dir);
+    test_eviction(dir);
+    test_executor(dir);
+    return test::finish("result_cache");
+}
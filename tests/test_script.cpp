@@ -0,0 +1,203 @@
+// Scripts: expressions evaluate like the equivalent C++ over numbers and
+// vectors of every input kind, errors name their line and column, one
+// compiled script runs from many threads at once, and Script nodes compile
+// their code once and report bad code on the node.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/script.hpp"
+#include "rebelflow/script.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+Value vec(double x, double y, double z) {
+    const double v[] = {x, y, z};
+    return Buffer::copy_of(std::span<const double>(v), 3);
+}
+
+double run_number(const Script& script, Value a, Value b = 0.0, Value c = 0.0) {
+    const Value d = 0.0;
+    const Value* inputs[] = {&a, &b, &c, &d};
+    return script.run(inputs).as_float();
+}
+
+std::vector<double> run_vector(const Script& script, Value a, Value b = 0.0) {
+    const Value c = 0.0;
+    const Value d = 0.0;
+    const Value* inputs[] = {&a, &b, &c, &d};
+    const Buffer result = script.run(inputs).as_buffer();
+    return {result.view<double>().begin(), result.view<double>().end()};
+}
+
+bool near(double x, double y) {
+    return std::abs(x - y) <= 1e-12 * (1 + std::abs(y));
+}
+
+void test_numbers() {
+    struct Case {
+        const char* source;
+        double a;
+        double b;
+        double expected;
+    };
+    const double a = 0.7;
+    const double b = -2.5;
+    const Case cases[] = {
+        {"a + b * 2", a, b, a + b * 2},
+        {"(a + b) * 2", a, b, (a + b) * 2},
+        {"a - b - 1", a, b, a - b - 1},
+        {"a / b", a, b, a / b},
+        {"7 % 3 + a", a, b, 1 + a},
+        {"-a + -b", a, b, -a - b},
+        {"2 ^ 10", a, b, 1024},
+        {"sqrt(abs(b)) + exp(a) + log(a)", a, b, std::sqrt(2.5) + std::exp(a) + std::log(a)},
+        {"sin(a) + cos(b) + tan(a)", a, b, std::sin(a) + std::cos(b) + std::tan(a)},
+        {"asin(a) + acos(a) + atan(b) + atan2(a, b)", a, b,
+         std::asin(a) + std::acos(a) + std::atan(b) + std::atan2(a, b)},
+        {"floor(b) + ceil(b) + round(a)", a, b, -3 + -2 + 1},
+        {"pow(a, 3) + min(a, b) + max(a, b)", a, b, std::pow(a, 3) + b + a},
+        {"clamp(b, -1, 1) + lerp(a, b, 0.25)", a, b, -1 + (a + (b - a) * 0.25)},
+        {"a < b ? 10 : 20", a, b, 20},
+        {"a > b && b < 0 || false", a, b, 1},
+        {"!(a == a) + (a != b)", a, b, 1},
+        {"pi * 2", a, b, 2 * std::numbers::pi},
+        {"let d = b - a\nlet e = d * d; e + d", a, b, (b - a) * (b - a) + (b - a)},
+    };
+    for (const Case& c : cases) {
+        const Script script = Script::compile(c.source);
+        const double got = run_number(script, c.a, c.b);
+        check(near(got, c.expected), std::string(c.source) + ": " + std::to_string(got) +
+                                         ", expected " + std::to_string(c.expected));
+    }
+
+    // Inputs may be bools, ints or floats.
+    const Script sum = Script::compile("a + b + c");
+    check(run_number(sum, true, std::int64_t{40}, 1.5) == 42.5, "numbers: mixed input kinds");
+    check_throws<TypeError>([&] { run_number(sum, std::string("text")); },
+                            "numbers: string input");
+}
+
+void test_vectors() {
+    const Script cross = Script::compile("cross(a, b)");
+    check(run_vector(cross, vec(1, 0, 0), vec(0, 1, 0)) == std::vector<double>{0, 0, 1},
+          "vectors: cross");
+    const Script dot = Script::compile("dot(a, b) + length(a) + a.y");
+    check(near(run_number(dot, vec(1, 2, 2), vec(3, 0, -1)), 1 + 3 + 2), "vectors: dot");
+    const Script mixed = Script::compile("normalize(a) * b + vec(1, 2, 3)");
+    const std::vector<double> m = run_vector(mixed, vec(0, 0, 5), 2.0);
+    check(near(m[0], 1) && near(m[1], 2) && near(m[2], 5), "vectors: scale and add");
+
+    // f32 buffers are vectors too; a number and a vector specialize apart.
+    const float f[] = {3, 4, 0};
+    const Script length = Script::compile("length(a * 2)");
+    check(run_number(length, Buffer::copy_of(std::span<const float>(f), 3)) == 10,
+          "vectors: f32 input");
+    const Script any = Script::compile("a * 2");
+    check(run_number(any, 1.5) == 3 && run_vector(any, vec(1, 2, 3)) ==
+                                           std::vector<double>{2, 4, 6},
+          "vectors: one script, both kinds");
+    check_throws<ScriptError>([&] { run_number(dot, 1.0, 2.0); }, "vectors: dot of numbers");
+    check_throws<TypeError>(
+        [&] { run_number(any, Buffer::copy_of(std::span<const float>(f).first(2))); },
+        "vectors: two-element buffer");
+}
+
+void test_errors() {
+    struct Case {
+        const char* source;
+        const char* position;
+        const char* what;
+    };
+    const Case cases[] = {
+        {"1 +", "line 1, column 4", "end of script"},
+        {"a +\n foo(1)", "line 2, column 2", "foo"},
+        {"x + 1", "line 1, column 1", "x"},
+        {"a\nlet b = (a", "line 2", ""},
+        {"min(a)", "line 1", "min"},
+    };
+    for (const Case& c : cases) {
+        const std::string message = check_throws<ScriptError>(
+            [&] { Script::compile(c.source); }, std::string("errors: ") + c.source);
+        check(message.find(c.position) != std::string::npos &&
+                  message.find(c.what) != std::string::npos,
+              std::string("errors: ") + c.source + ": '" + message + "'");
+    }
+    // Input names are the caller's; the defaults are then unknown.
+    const Script named = Script::compile("p * q", {"p", "q", "r"});
+    check(named.uses_input(0) && named.uses_input(1) && !named.uses_input(2),
+          "errors: uses_input");
+    check_throws<ScriptError>([] { Script::compile("a", {"p", "q"}); },
+                              "errors: default name with custom names");
+}
+
+void test_threads() {
+    const Script script = Script::compile("let s = sin(a) * b\ns * s + c");
+    std::vector<int> wrong(8, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < 2000; ++i) {
+                const double a = t + i * 0.001;
+                const double expected = std::sin(a) * t * std::sin(a) * t + i;
+                // Alternate kinds so specializations are made concurrently.
+                const Value c = i % 2 == 0 ? Value(static_cast<double>(i))
+                                           : Value(static_cast<std::int64_t>(i));
+                wrong[t] += near(run_number(script, a, static_cast<double>(t), c), expected) ? 0
+                                                                                             : 1;
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    check(std::count(wrong.begin(), wrong.end(), 0) == 8, "threads: wrong results");
+}
+
+void test_node() {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    register_script_nodes(registry);
+    Graph graph;
+    const NodeId a = graph.add_node(registry, "Constant");
+    graph.set_param(a, "value", 3.0);
+    const NodeId script = graph.add_node(registry, "Script");
+    graph.set_param(script, "code", std::string("a * a + b"));
+    graph.connect({a, 0}, {script, 0});
+    Executor executor(2);
+    executor.run(graph);
+    check(executor.output(script).as_float() == 9, "node: unconnected input not 0");
+
+    graph.set_param(script, "code", std::string("a +"));
+    const std::string message = check_throws<ExecutionError>([&] { executor.run(graph); },
+                                                             "node: bad code");
+    check(message.find("line 1") != std::string::npos, "node: message '" + message + "'");
+
+    graph.set_param(script, "code", std::string("vec(a, 0, 1)"));
+    executor.run(graph);
+    const Buffer out = executor.output(script).as_buffer();
+    check(out.size() == 3 && out.view<double>()[0] == 3, "node: vector result");
+}
+
+} // namespace
+
+int main() {
+    test_numbers();
+    test_vectors();
+    test_errors();
+    test_threads();
+    test_node();
+    return test::finish("script");
+}
@@ -0,0 +1,287 @@
+// StreamExecutor: chunks reach sinks in stream order however the workers
+// finish them, the source never runs more than max_in_flight chunks ahead of
+// the sinks, and a failure anywhere shuts the pipeline down with the failing
+// node's error. ReadPoints streams every point of a mesh file, in order.
+
+#include "test.hpp"
+
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/mesh_io.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/mesh.hpp"
+#include "rebelflow/stream.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+/// What the test nodes saw, shared with the test.
+struct Trace {
+    std::atomic<std::size_t> produced{0};
+    std::atomic<std::size_t> consumed{0};
+    /// Largest number of chunks the source had produced beyond those the
+    /// sink had finished, seen when a chunk reached the sink.
+    std::atomic<std::size_t> lead{0};
+    std::vector<std::int64_t> order;
+    std::int64_t fail_source_at = -1;
+    std::int64_t fail_worker_at = -1;
+    std::int64_t fail_sink_at = -1;
+    std::chrono::microseconds sink_delay{0};
+};
+
+/// Chunk number `seq` as a one-element buffer, `count` of them.
+class CountingSource final : public ChunkSource {
+public:
+    CountingSource(Trace& trace, std::int64_t count) : trace_(trace), count_(count) {}
+
+    bool next(Value& chunk) override {
+        if (next_ == count_) {
+            return false;
+        }
+        if (next_ == trace_.fail_source_at) {
+            throw std::runtime_error("source failed");
+        }
+        chunk = Buffer::copy_of(std::span<const std::int64_t>(&next_, 1));
+        ++next_;
+        ++trace_.produced;
+        return true;
+    }
+
+private:
+    Trace& trace_;
+    std::int64_t count_;
+    std::int64_t next_ = 0;
+};
+
+class OrderSink final : public ChunkSink {
+public:
+    explicit OrderSink(Trace& trace) : trace_(trace) {}
+
+    void consume(const Value& chunk) override {
+        const std::int64_t seq = chunk.as_buffer().view<std::int64_t>()[0];
+        if (seq == trace_.fail_sink_at) {
+            throw std::runtime_error("sink failed");
+        }
+        const std::size_t lead = trace_.produced - trace_.consumed;
+        trace_.lead = std::max<std::size_t>(trace_.lead, lead);
+        std::this_thread::sleep_for(trace_.sink_delay);
+        trace_.order.push_back(seq);
+        ++trace_.consumed;
+    }
+
+    void finish(NodeContext& ctx) override {
+        ctx.set_output(0, static_cast<std::int64_t>(trace_.order.size()));
+    }
+
+private:
+    Trace& trace_;
+};
+
+/// Counting -> Jitter -> Order. Jitter holds early chunks longest, so the
+/// workers finish them out of order.
+struct Pipeline {
+    Graph graph;
+    NodeId sink = invalid_node;
+};
+
+Pipeline make_pipeline(Trace& trace, std::int64_t count) {
+    NodeType source;
+    source.name = "Counting";
+    source.outputs = {{"seq", DataType::Buffer}};
+    source.open_source = [&trace, count](NodeContext&) -> std::unique_ptr<ChunkSource> {
+        return std::make_unique<CountingSource>(trace, count);
+    };
+    source.pure = false;
+
+    NodeType jitter;
+    jitter.name = "Jitter";
+    jitter.inputs = {{"seq", DataType::Buffer}};
+    jitter.outputs = {{"seq", DataType::Buffer}};
+    jitter.compute = [&trace](NodeContext& ctx) {
+        const std::int64_t seq = ctx.input(0).as_buffer().view<std::int64_t>()[0];
+        if (seq == trace.fail_worker_at) {
+            throw std::runtime_error("worker failed");
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200 * (3 - seq % 4)));
+        ctx.set_output(0, ctx.input(0));
+    };
+
+    NodeType sink;
+    sink.name = "Order";
+    sink.inputs = {{"seq", DataType::Buffer}};
+    sink.outputs = {{"count", DataType::Int}};
+    sink.open_sink = [&trace](NodeContext&) -> std::unique_ptr<ChunkSink> {
+        return std::make_unique<OrderSink>(trace);
+    };
+
+    NodeRegistry registry;
+    Pipeline p;
+    const NodeId s = p.graph.add_node(registry.add(std::move(source)));
+    const NodeId j = p.graph.add_node(registry.add(std::move(jitter)));
+    p.sink = p.graph.add_node(registry.add(std::move(sink)));
+    p.graph.connect({s, 0}, {j, 0});
+    p.graph.connect({j, 0}, {p.sink, 0});
+    return p;
+}
+
+void test_order() {
+    Trace trace;
+    Pipeline p = make_pipeline(trace, 200);
+    StreamExecutor executor({.max_in_flight = 16, .workers = 4});
+    const StreamStats stats = executor.run(p.graph);
+    check(stats.chunks == 200, "order: " + std::to_string(stats.chunks) + " chunks");
+    check(executor.output(p.sink).as_int() == 200, "order: sink output");
+    bool ordered = trace.order.size() == 200;
+    for (std::size_t i = 0; ordered && i < trace.order.size(); ++i) {
+        ordered = trace.order[i] == static_cast<std::int64_t>(i);
+    }
+    check(ordered, "order: chunks reached the sink out of stream order");
+}
+
+void test_backpressure() {
+    Trace trace;
+    trace.sink_delay = std::chrono::microseconds(500);
+    Pipeline p = make_pipeline(trace, 100);
+    const std::size_t limit = 3;
+    StreamExecutor executor({.max_in_flight = limit, .workers = 4});
+    const StreamStats stats = executor.run(p.graph);
+    check(stats.peak_in_flight <= limit,
+          "backpressure: peak " + std::to_string(stats.peak_in_flight) + " in flight");
+    check(trace.lead <= limit, "backpressure: the source ran " + std::to_string(trace.lead) +
+                                   " chunks ahead of a slow sink");
+    check(trace.order.size() == 100, "backpressure: every chunk arrived");
+}
+
+/// Runs a pipeline of 100000 chunks that fails early; the run must end
+/// promptly with the failing node's error, having produced few chunks, and
+/// the executor must then run again.
+void test_failure(const char* where, std::int64_t Trace::*fail_at, const std::string& type) {
+    Trace trace;
+    trace.*fail_at = 5;
+    Pipeline p = make_pipeline(trace, 100000);
+    StreamExecutor executor({.max_in_flight = 4, .workers = 4});
+    const auto started = std::chrono::steady_clock::now();
+    NodeId node = invalid_node;
+    std::string node_type;
+    const std::string message = check_throws<ExecutionError>(
+        [&] {
+            try {
+                executor.run(p.graph);
+            } catch (const ExecutionError& e) {
+                node = e.node();
+                node_type = e.node_type();
+                throw;
+            }
+        },
+        std::string(where) + " failure");
+    const auto elapsed = std::chrono::steady_clock::now() - started;
+    check(node_type == type, std::string(where) + " failure: reported by '" + node_type + "'");
+    check(message.find(std::string(where) + " failed") != std::string::npos,
+          std::string(where) + " failure: message '" + message + "'");
+    check(trace.produced < 100, std::string(where) + " failure: the source went on for " +
+                                    std::to_string(trace.produced) + " chunks");
+    check(elapsed < std::chrono::seconds(10), std::string(where) + " failure: slow shutdown");
+
+    Trace again;
+    Pipeline q = make_pipeline(again, 10);
+    check(executor.run(q.graph).chunks == 10, std::string(where) + " failure: no rerun");
+}
+
+/// ReadPoints -> Bounds over each format, chunk by chunk.
+void test_read_points(const test::TempDir& dir) {
+    // A 40 x 30 grid, lifted so that every point differs.
+    std::vector<double> p;
+    std::vector<std::uint32_t> t;
+    for (std::uint32_t y = 0; y < 30; ++y) {
+        for (std::uint32_t x = 0; x < 40; ++x) {
+            p.insert(p.end(), {x * 0.5, y * 0.25, std::sin(x * 0.1 + y * 0.2)});
+            if (x + 1 < 40 && y + 1 < 30) {
+                const std::uint32_t v = y * 40 + x;
+                t.insert(t.end(), {v, v + 1, v + 41, v, v + 41, v + 40});
+            }
+        }
+    }
+    const Mesh mesh =
+        Mesh::from_triangles(Buffer::adopt(std::move(p), 3), Buffer::adopt(std::move(t), 3));
+
+    NodeRegistry registry;
+    register_mesh_nodes(registry);
+    for (const auto& [name, binary] : std::vector<std::pair<std::string, bool>>{
+             {"grid.ply", true}, {"grid_text.ply", false}, {"grid.obj", false},
+             {"grid.stl", true}, {"grid_text.stl", false}}) {
+        const std::string path = dir.path(name);
+        write_mesh(mesh, path, binary);
+        const bool stl = name.ends_with(".stl");
+        const std::size_t expected = stl ? mesh.face_count() * 3 : mesh.vertex_count();
+
+        // The chunks put together are the file's points, in order.
+        PointReader reader(path);
+        std::vector<double> all;
+        std::size_t chunks = 0;
+        for (Buffer chunk; reader.next(100, chunk);) {
+            check(chunk.tuples() <= 100 && chunk.components() == 3, name + ": bad chunk");
+            all.insert(all.end(), chunk.view<double>().begin(), chunk.view<double>().end());
+            ++chunks;
+        }
+        check(all.size() == 3 * expected, name + ": " + std::to_string(all.size() / 3) +
+                                              " points, expected " + std::to_string(expected));
+        check(chunks == (expected + 99) / 100, name + ": " + std::to_string(chunks) + " chunks");
+        if (!stl) {
+            const std::span<const double> want = mesh.positions();
+            bool same = all.size() == want.size();
+            for (std::size_t i = 0; same && i < all.size(); ++i) {
+                same = std::abs(all[i] - want[i]) <= 1e-6 * (1 + std::abs(want[i]));
+            }
+            check(same, name + ": points differ from the mesh's");
+        }
+
+        Graph graph;
+        const NodeId read = graph.add_node(registry, "ReadPoints");
+        graph.set_param(read, "path", path);
+        graph.set_param(read, "chunk_size", std::int64_t{64});
+        const NodeId bounds = graph.add_node(registry, "Bounds");
+        graph.connect({read, 0}, {bounds, 0});
+        StreamExecutor executor({.max_in_flight = 2, .workers = 2});
+        const StreamStats stats = executor.run(graph);
+        check(stats.chunks == (expected + 63) / 64, name + ": streamed " +
+                                                        std::to_string(stats.chunks) + " chunks");
+        check(executor.output(bounds, 2).as_int() == static_cast<std::int64_t>(expected),
+              name + ": Bounds counted the wrong number of points");
+        const std::span<const double> low = executor.output(bounds, 0).as_buffer().view<double>();
+        const std::span<const double> high = executor.output(bounds, 1).as_buffer().view<double>();
+        check(low[0] == 0 && low[1] == 0 && std::abs(high[0] - 19.5) < 1e-6 &&
+                  std::abs(high[1] - 7.25) < 1e-6,
+              name + ": wrong bounds");
+    }
+
+    // A missing file fails in the source.
+    Graph graph;
+    const NodeId read = graph.add_node(registry, "ReadPoints");
+    graph.set_param(read, "path", dir.path("missing.ply"));
+    graph.connect({read, 0}, {graph.add_node(registry, "Bounds"), 0});
+    StreamExecutor executor;
+    check_throws<ExecutionError>([&] { executor.run(graph); }, "missing file");
+}
+
+} // namespace
+
+int main() {
+    const test::TempDir dir("stream");
+    test_order();
+    test_backpressure();
+    test_failure("source", &Trace::fail_source_at, "Counting");
+    test_failure("worker", &Trace::fail_worker_at, "Jitter");
+    test_failure("sink", &Trace::fail_sink_at, "Order");
+    test_read_points(dir);
+    return test::finish("stream");
+}
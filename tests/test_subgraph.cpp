@@ -0,0 +1,215 @@
+// Sub-graphs: a macro type's ports are its body's placeholders, instances
+// evaluate the body without running nodes no output needs, equal inputs are
+// computed once across instances, body errors surface on the instance, and
+// collapse() replaces a group of nodes without changing any result.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/subgraph.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+struct Counts {
+    std::atomic<int> squares{0};
+    std::atomic<int> dead{0};
+};
+
+/// `Square` squares its input, failing for negative ones; `Dead` counts its
+/// runs.
+NodeRegistry make_registry(Counts& counts) {
+    NodeRegistry registry;
+    register_builtin_nodes(registry);
+    register_subgraph_nodes(registry);
+    NodeType square;
+    square.name = "Square";
+    square.inputs = {{"x", DataType::Float}};
+    square.outputs = {{"y", DataType::Float}};
+    square.compute = [&counts](NodeContext& ctx) {
+        ++counts.squares;
+        const double x = ctx.input(0).as_float();
+        if (x < 0) {
+            throw std::runtime_error("negative input");
+        }
+        ctx.set_output(0, x * x);
+    };
+    registry.add(std::move(square));
+
+    NodeType dead;
+    dead.name = "Dead";
+    dead.inputs = {{"x", DataType::Float}};
+    dead.outputs = {{"y", DataType::Float}};
+    dead.compute = [&counts](NodeContext& ctx) {
+        ++counts.dead;
+        ctx.set_output(0, ctx.input(0));
+    };
+    registry.add(std::move(dead));
+    return registry;
+}
+
+/// out = x * x + y, with a Dead node beside it that no output reads.
+std::shared_ptr<Graph> make_body(const NodeRegistry& registry, double y_default) {
+    auto body = std::make_shared<Graph>();
+    const NodeId x = body->add_node(registry, "SubgraphInput");
+    body->set_param(x, "name", std::string("x"));
+    const NodeId y = body->add_node(registry, "SubgraphInput");
+    body->set_param(y, "name", std::string("y"));
+    body->set_param(y, "value", y_default);
+    const NodeId square = body->add_node(registry, "Square");
+    const NodeId add = body->add_node(registry, "Add");
+    const NodeId out = body->add_node(registry, "SubgraphOutput");
+    body->set_param(out, "name", std::string("out"));
+    const NodeId dead = body->add_node(registry, "Dead");
+    body->connect({x, 0}, {square, 0});
+    body->connect({square, 0}, {add, 0});
+    body->connect({y, 0}, {add, 1});
+    body->connect({add, 0}, {out, 0});
+    body->connect({x, 0}, {dead, 0});
+    return body;
+}
+
+void test_type() {
+    Counts counts;
+    NodeRegistry registry = make_registry(counts);
+    const NodeType type = subgraph_type("Macro", make_body(registry, 2.0));
+    check(type.inputs.size() == 2 && type.inputs[0].name == "x" && type.inputs[1].name == "y" &&
+              type.inputs[1].default_value.as_float() == 2,
+          "type: inputs");
+    check(type.outputs.size() == 1 && type.outputs[0].name == "out" &&
+              type.outputs[0].type == DataType::Float,
+          "type: outputs");
+    check(type.pure, "type: pure body, impure type");
+
+    // The version follows the body's contents.
+    check(subgraph_type("Macro", make_body(registry, 2.0)).version == type.version &&
+              subgraph_type("Macro", make_body(registry, 5.0)).version != type.version,
+          "type: version");
+
+    const std::shared_ptr<Graph> twice = make_body(registry, 2.0);
+    const NodeId again = twice->add_node(registry, "SubgraphInput");
+    twice->set_param(again, "name", std::string("x"));
+    check_throws<GraphError>([&] { subgraph_type("Twice", twice); }, "type: repeated port");
+    auto none = std::make_shared<Graph>();
+    none->add_node(registry, "SubgraphInput");
+    check_throws<GraphError>([&] { subgraph_type("None", none); }, "type: no output");
+    check_throws<GraphError>([&] { subgraph_type("Null", nullptr); }, "type: no body");
+}
+
+void test_instances() {
+    Counts counts;
+    NodeRegistry registry = make_registry(counts);
+    registry.add(subgraph_type("Macro", make_body(registry, 2.0)));
+
+    // 200 instances over 100 distinct inputs, and one using the default y.
+    Graph graph;
+    const NodeId y = graph.add_node(registry, "Constant");
+    graph.set_param(y, "value", 0.5);
+    std::vector<NodeId> instances;
+    for (int i = 0; i < 200; ++i) {
+        const NodeId x = graph.add_node(registry, "Constant");
+        graph.set_param(x, "value", static_cast<double>(i % 100));
+        const NodeId macro = graph.add_node(registry, "Macro");
+        graph.connect({x, 0}, {macro, 0});
+        graph.connect({y, 0}, {macro, 1});
+        instances.push_back(macro);
+    }
+    const NodeId defaulted = graph.add_node(registry, "Macro");
+
+    Executor executor(4);
+    executor.run(graph);
+    bool right = executor.output(defaulted).as_float() == 2;
+    for (int i = 0; i < 200; ++i) {
+        const double x = i % 100;
+        right = right && executor.output(instances[i]).as_float() == x * x + 0.5;
+    }
+    check(right, "instances: outputs");
+    check(counts.dead == 0, "instances: a node no output reads ran");
+    check(counts.squares <= 200 && counts.squares >= 101,
+          "instances: " + std::to_string(counts.squares) + " body evaluations");
+
+    // Recomputing every instance is served from the shared memo.
+    const int before = counts.squares;
+    executor.invalidate_all();
+    executor.run(graph);
+    check(counts.squares == before, "instances: equal inputs evaluated again");
+
+    // A failing body node is reported on the instance, naming the body node.
+    graph.set_param(y, "value", 1.5);
+    const NodeId negative = graph.add_node(registry, "Constant");
+    graph.set_param(negative, "value", -1.0);
+    graph.connect({negative, 0}, {instances[7], 0});
+    const std::string message =
+        check_throws<ExecutionError>([&] { executor.run(graph); }, "instances: body failure");
+    check(message.find("Square") != std::string::npos &&
+              message.find("negative input") != std::string::npos,
+          "instances: message '" + message + "'");
+    graph.set_param(negative, "value", 3.0);
+    executor.run(graph);
+    check(executor.output(instances[7]).as_float() == 10.5, "instances: after the failure");
+}
+
+void test_collapse() {
+    Counts counts;
+    NodeRegistry registry = make_registry(counts);
+
+    // a, b -> s = a + b -> m = s * b -> d = m - a; collapse s and m.
+    Graph graph;
+    const NodeId a = graph.add_node(registry, "Constant");
+    graph.set_param(a, "value", 3.0);
+    const NodeId b = graph.add_node(registry, "Constant");
+    graph.set_param(b, "value", 4.0);
+    const NodeId s = graph.add_node(registry, "Add");
+    const NodeId m = graph.add_node(registry, "Multiply");
+    const NodeId d = graph.add_node(registry, "Subtract");
+    graph.connect({a, 0}, {s, 0});
+    graph.connect({b, 0}, {s, 1});
+    graph.connect({s, 0}, {m, 0});
+    graph.connect({b, 0}, {m, 1});
+    graph.connect({m, 0}, {d, 0});
+    graph.connect({a, 0}, {d, 1});
+
+    // s and d without m: the path s -> m -> d leaves the group and returns.
+    const std::size_t nodes = graph.node_count();
+    const NodeId cyclic[] = {s, d};
+    check_throws<GraphError>([&] { collapse(graph, cyclic, registry, "Cyclic"); },
+                             "collapse: non-convex group");
+    const NodeId repeated[] = {s, s};
+    check_throws<GraphError>([&] { collapse(graph, repeated, registry, "Repeated"); },
+                             "collapse: repeated node");
+    check(graph.node_count() == nodes && !registry.contains("Cyclic"),
+          "collapse: a failed collapse changed the graph");
+
+    Executor executor(2);
+    executor.run(graph);
+    const double expected = executor.output(d).as_float();
+    const NodeId group[] = {s, m};
+    const CollapseResult result = collapse(graph, group, registry, "Group");
+    check(registry.contains("Group") && graph.node_count() == nodes - 1 &&
+              !graph.contains(s) && !graph.contains(m),
+          "collapse: nodes not replaced");
+    // Two distinct outside outputs feed the group; b feeds it twice.
+    check(result.type->inputs.size() == 2 && result.type->outputs.size() == 1,
+          "collapse: ports");
+    executor.run(graph);
+    check(executor.output(d).as_float() == expected && expected == 25,
+          "collapse: result changed");
+}
+
+} // namespace
+
+int main() {
+    test_type();
+    test_instances();
+    test_collapse();
+    return test::finish("subgraph");
+}
@@ -0,0 +1,128 @@
+// weld(): every vertex joins the first kept vertex within tolerance, as a
+// brute-force search finds it, whatever the scale of the positions and the
+// tolerance, including positions and tolerances whose grid cells would not
+// fit in an integer.
+
+#include "test.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/mesh.hpp"
+#include "rebelflow/thread_pool.hpp"
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using rebelflow::test::check;
+using rebelflow::test::check_throws;
+
+/// Disjoint triangles over `points`, three at a time.
+Mesh soup(std::vector<double> points) {
+    std::vector<std::uint32_t> triangles(points.size() / 3);
+    for (std::uint32_t i = 0; i < triangles.size(); ++i) {
+        triangles[i] = i;
+    }
+    return Mesh::from_triangles(Buffer::adopt(std::move(points), 3),
+                                Buffer::adopt(std::move(triangles), 3));
+}
+
+/// The vertex count weld() should leave: in vertex order, each vertex
+/// within `tolerance` of a kept one joins it, the rest are kept.
+std::size_t brute_force(const Mesh& mesh, double tolerance) {
+    const std::span<const double> p = mesh.positions();
+    std::vector<std::size_t> kept;
+    for (std::size_t v = 0; v < mesh.vertex_count(); ++v) {
+        bool joined = false;
+        for (std::size_t k = 0; k < kept.size() && !joined; ++k) {
+            double d2 = 0;
+            for (int a = 0; a < 3; ++a) {
+                const double d = p[3 * v + a] - p[3 * kept[k] + a];
+                d2 += d * d;
+            }
+            joined = d2 <= tolerance * tolerance;
+        }
+        if (!joined) {
+            kept.push_back(v);
+        }
+    }
+    return kept.size();
+}
+
+/// Clusters of nearby points around `scale`-sized offsets.
+std::vector<double> clusters(double scale, double spread, std::uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<double> centre(-1, 1);
+    std::uniform_real_distribution<double> jitter(-spread, spread);
+    std::vector<double> points;
+    for (int c = 0; c < 40; ++c) {
+        const double x = centre(random) * scale;
+        const double y = centre(random) * scale;
+        const double z = centre(random) * scale;
+        for (int i = 0; i < 6; ++i) {
+            points.insert(points.end(), {x + jitter(random) * std::abs(x) + jitter(random),
+                                         y + jitter(random) * std::abs(y), z});
+        }
+    }
+    return points;
+}
+
+void test_matches_brute_force() {
+    constexpr double max = std::numeric_limits<double>::max();
+    constexpr double denormal = std::numeric_limits<double>::denorm_min();
+    struct Case {
+        const char* name;
+        double scale;
+        double spread;
+        double tolerance;
+    };
+    const Case cases[] = {
+        {"unit", 1, 1e-3, 1e-3},
+        {"exact", 1, 0, 0},
+        {"huge positions", 1e300, 1e-3, 1e-3},
+        {"huge positions, no tolerance", 1e300, 0, 0},
+        {"huge positions and tolerance", 1e150, 1e-3, 1e148},
+        {"largest positions", max / 2, 1e-3, 1e-3},
+        {"tiny tolerance", 1e3, 1e-12, 1e-300},
+        {"denormal tolerance", 1, 1e-12, denormal},
+        {"largest tolerance", 1, 1e-3, max},
+        {"infinite tolerance", 1, 1e-3, std::numeric_limits<double>::infinity()},
+    };
+    ThreadPool pool(4);
+    std::uint32_t seed = 1;
+    for (const Case& c : cases) {
+        const Mesh mesh = soup(clusters(c.scale, c.spread, seed++));
+        const Mesh welded = weld(mesh, c.tolerance, &pool);
+        const std::size_t expected = brute_force(mesh, c.tolerance);
+        check(welded.vertex_count() == expected,
+              std::string(c.name) + ": " + std::to_string(welded.vertex_count()) +
+                  " vertices, expected " + std::to_string(expected));
+        check(weld(mesh, c.tolerance).vertex_count() == welded.vertex_count(),
+              std::string(c.name) + ": serial and parallel welds differ");
+    }
+}
+
+void test_edges() {
+    // Points either side of a cell boundary still merge.
+    const Mesh across = soup({0.008 - 1e-6, 0, 0, 0.008 + 1e-6, 0, 0, 1, 1, 1});
+    check(weld(across, 1e-3).vertex_count() == 2, "edges: points across a cell boundary");
+
+    // Non-finite positions are kept apart, never merged.
+    const double inf = std::numeric_limits<double>::infinity();
+    const Mesh odd = soup({inf, 0, 0, inf, 0, 0, std::nan(""), 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1});
+    check(weld(odd, 1e-3).vertex_count() == 5, "edges: non-finite positions");
+
+    check_throws<Error>([&] { weld(across, -1); }, "edges: negative tolerance");
+    check_throws<Error>([&] { weld(across, std::nan("")); }, "edges: NaN tolerance");
+}
+
+} // namespace
+
+int main() {
+    test_matches_brute_force();
+    test_edges();
+    return test::finish("weld");
+}
@@ -0,0 +1,327 @@
+#include "json.hpp"
+
+#include "rebelflow/error.hpp"
+#include "rebelflow/mesh.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+
+namespace rebelflow::tools {
+
+namespace {
+
+class Parser {
+public:
+    explicit Parser(std::string_view text) : text_(text) {}
+
+    Value value() {
+        skip_space();
+        const char c = peek();
+        if (c == '"') {
+            return string();
+        }
+        if (c == '[') {
+            return array();
+        }
+        if (c == '-' || (c >= '0' && c <= '9')) {
+            return number();
+        }
+        if (keyword("true")) {
+            return true;
+        }
+        if (keyword("false")) {
+            return false;
+        }
+        if (keyword("null")) {
+            return {};
+        }
+        fail(c == '{' ? "objects are only allowed at the top level" : "expected a value");
+    }
+
+    std::vector<std::pair<std::string, Value>> object() {
+        std::vector<std::pair<std::string, Value>> members;
+        expect('{');
+        skip_space();
+        if (consume('}')) {
+            return members;
+        }
+        do {
+            skip_space();
+            std::string key = string();
+            expect(':');
+            Value v = value();
+            members.emplace_back(std::move(key), std::move(v));
+            skip_space();
+        } while (consume(','));
+        expect('}');
+        return members;
+    }
+
+    void finish() {
+        skip_space();
+        if (pos_ != text_.size()) {
+            fail("trailing characters");
+        }
+    }
+
+private:
+    [[noreturn]] void fail(const std::string& what) const {
+        throw FormatError("JSON at offset " + std::to_string(pos_) + ": " + what);
+    }
+
+    char peek() const { return pos_ < text_.size() ? text_[pos_] : '\0'; }
+
+    void skip_space() {
+        while (pos_ < text_.size() && std::strchr(" \t\r\n", text_[pos_]) != nullptr) {
+            ++pos_;
+        }
+    }
+
+    bool consume(char c) {
+        skip_space();
+        if (peek() != c) {
+            return false;
+        }
+        ++pos_;
+        return true;
+    }
+
+    void expect(char c) {
+        if (!consume(c)) {
+            fail(std::string("expected '") + c + "'");
+        }
+    }
+
+    bool keyword(std::string_view word) {
+        if (text_.substr(pos_, word.size()) != word) {
+            return false;
+        }
+        pos_ += word.size();
+        return true;
+    }
+
+    std::string string() {
+        if (peek() != '"') {
+            fail("expected a string");
+        }
+        ++pos_;
+        std::string out;
+        while (pos_ < text_.size() && text_[pos_] != '"') {
+            char c = text_[pos_++];
+            if (c == '\\') {
+                if (pos_ >= text_.size()) {
+                    break;
+                }
+                switch (const char e = text_[pos_++]) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case 'r': c = '\r'; break;
+                case 'b': c = '\b'; break;
+                case 'f': c = '\f'; break;
+                case 'u': out += unicode_escape(); continue;
+                default: c = e; break;
+                }
+            }
+            out += c;
+        }
+        if (pos_ >= text_.size()) {
+            fail("unterminated string");
+        }
+        ++pos_;
+        return out;
+    }
+
+    /// The code point of a \uXXXX escape, as UTF-8. Surrogate pairs are not
+    /// combined; graph inputs are names and paths, not prose.
+    std::string unicode_escape() {
+        unsigned code = 0;
+        const auto [end, ec] =
+            std::from_chars(text_.data() + pos_, text_.data() + std::min(pos_ + 4, text_.size()),
+                            code, 16);
+        if (ec != std::errc{} || end != text_.data() + pos_ + 4) {
+            fail("bad \\u escape");
+        }
+        pos_ += 4;
+        std::string out;
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+        return out;
+    }
+
+    Value number() {
+        const char* begin = text_.data() + pos_;
+        const char* end = text_.data() + text_.size();
+        const char* p = begin + (*begin == '-' ? 1 : 0);
+        while (p != end && *p >= '0' && *p <= '9') {
+            ++p;
+        }
+        if (p == end || std::strchr(".eE", *p) == nullptr) {
+            std::int64_t i = 0;
+            const auto [last, ec] = std::from_chars(begin, p, i);
+            if (ec == std::errc{} && last == p) {
+                pos_ += static_cast<std::size_t>(p - begin);
+                return i;
+            }
+        }
+        double d = 0.0;
+        const auto [last, ec] = std::from_chars(begin, end, d);
+        if (ec != std::errc{}) {
+            fail("bad number");
+        }
+        pos_ += static_cast<std::size_t>(last - begin);
+        return d;
+    }
+
+    double element() {
+        skip_space();
+        const char c = peek();
+        if (c != '-' && !(c >= '0' && c <= '9')) {
+            fail("arrays hold numbers or arrays of numbers");
+        }
+        return number().as_float();
+    }
+
+    Value array() {
+        expect('[');
+        std::vector<double> data;
+        std::size_t components = 0; // 0: flat numbers, not known yet
+        bool nested = false;
+        skip_space();
+        if (consume(']')) {
+            return Buffer::allocate(ElementType::F64, 0);
+        }
+        std::size_t items = 0;
+        do {
+            skip_space();
+            if (items == 0) {
+                nested = peek() == '[';
+            }
+            if (nested) {
+                expect('[');
+                std::size_t n = 0;
+                do {
+                    data.push_back(element());
+                    ++n;
+                } while (consume(','));
+                expect(']');
+                if (components != 0 && n != components) {
+                    fail("inner arrays differ in length");
+                }
+                components = n;
+            } else {
+                data.push_back(element());
+            }
+            ++items;
+        } while (consume(','));
+        expect(']');
+        return Buffer::adopt(std::move(data), static_cast<std::uint32_t>(nested ? components : 1));
+    }
+
+    std::string_view text_;
+    std::size_t pos_ = 0;
+};
+
+template <typename T>
+void write_elements(std::string& out, const Buffer& b) {
+    const auto data = b.view<T>();
+    const std::size_t k = b.components();
+    out += '[';
+    for (std::size_t i = 0; i < data.size(); ++i) {
+        if (i != 0) {
+            out += ',';
+        }
+        if (k > 1 && i % k == 0) {
+            out += '[';
+        }
+        write_json_value(out, Value(data[i]));
+        if (k > 1 && i % k == k - 1) {
+            out += ']';
+        }
+    }
+    out += ']';
+}
+
+} // namespace
+
+Value parse_json_value(std::string_view text) {
+    Parser parser(text);
+    Value v = parser.value();
+    parser.finish();
+    return v;
+}
+
+std::vector<std::pair<std::string, Value>> parse_json_object(std::string_view text) {
+    Parser parser(text);
+    auto members = parser.object();
+    parser.finish();
+    return members;
+}
+
+void write_json_value(std::string& out, const Value& value) {
+    switch (value.type()) {
+    case DataType::String: write_json_string(out, value.as_string()); return;
+    case DataType::Float: {
+        const double d = value.as_float();
+        out += d == d && d - d == 0.0 ? value.to_string() : "null"; // no NaN/inf in JSON
+        return;
+    }
+    case DataType::Buffer: {
+        const Buffer& b = value.as_buffer();
+        switch (b.element_type()) {
+        case ElementType::U8: write_elements<std::uint8_t>(out, b); return;
+        case ElementType::I32: write_elements<std::int32_t>(out, b); return;
+        case ElementType::U32: write_elements<std::uint32_t>(out, b); return;
+        case ElementType::I64: write_elements<std::int64_t>(out, b); return;
+        case ElementType::F32: write_elements<float>(out, b); return;
+        case ElementType::F64: write_elements<double>(out, b); return;
+        }
+        return;
+    }
+    case DataType::Mesh: {
+        const Mesh::Arrays& m = value.as_mesh().arrays();
+        out += "{\"positions\":";
+        write_json_value(out, m.positions);
+        out += ",\"triangles\":";
+        write_json_value(out, m.corners);
+        out += '}';
+        return;
+    }
+    case DataType::Bvh: write_json_string(out, value.to_string()); return;
+    case DataType::Brep: write_json_string(out, value.to_string()); return;
+    default: out += value.to_string(); return;
+    }
+}
+
+void write_json_string(std::string& out, std::string_view text) {
+    out += '"';
+    for (const char c : text) {
+        switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\n': out += "\\n"; break;
+        case '\t': out += "\\t"; break;
+        case '\r': out += "\\r"; break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", static_cast<unsigned>(c));
+                out += buf;
+            } else {
+                out += c;
+            }
+        }
+    }
+    out += '"';
+}
+
+} // namespace rebelflow::tools
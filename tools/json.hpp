@@ -0,0 +1,32 @@
+#pragma once
+
+#include "rebelflow/value.hpp"
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace rebelflow::tools {
+
+/// The JSON subset rebelflow-run exchanges values in:
+///
+/// - numbers: integers without a fraction or exponent become Int, others Float
+/// - `true`, `false`, `null`, strings
+/// - an array of numbers: a 1-component f64 buffer
+/// - an array of equally long arrays of numbers: an f64 buffer with one tuple
+///   per inner array, e.g. `[[0,0,0],[1,0,0]]` is a list of 3-vectors
+///
+/// Throws FormatError, naming the offset, for anything else.
+Value parse_json_value(std::string_view text);
+
+/// A JSON object of values, in file order. Keys may repeat.
+std::vector<std::pair<std::string, Value>> parse_json_object(std::string_view text);
+
+/// Appends `value` as JSON. Buffers become arrays of numbers, or arrays of
+/// tuples when they have several components.
+void write_json_value(std::string& out, const Value& value);
+/// Appends `text` as a quoted JSON string.
+void write_json_string(std::string& out, std::string_view text);
+
+} // namespace rebelflow::tools
@@ -0,0 +1,49 @@
+#include "nodes.hpp"
+
+#include "rebelflow/nodes/builtin.hpp"
+#include "rebelflow/nodes/loop.hpp"
+#include "rebelflow/nodes/mesh.hpp"
+#include "rebelflow/nodes/script.hpp"
+#include "rebelflow/subgraph.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace rebelflow::tools {
+
+void register_standard_nodes(NodeRegistry& registry) {
+    register_builtin_nodes(registry);
+    register_script_nodes(registry);
+    register_loop_nodes(registry);
+    register_mesh_nodes(registry);
+    register_subgraph_nodes(registry);
+}
+
+void register_worker_nodes(NodeRegistry& registry, const std::vector<std::string>& allowed) {
+    NodeRegistry standard;
+    register_standard_nodes(standard);
+    for (const std::string& name : allowed) {
+        standard.get(name);
+    }
+    register_subgraph_nodes(registry);
+    for (const std::string& name : standard.names()) {
+        const std::shared_ptr<const NodeType> type = standard.get(name);
+        const bool listed = std::find(allowed.begin(), allowed.end(), name) != allowed.end();
+        if (!registry.contains(name) && (type->pure || listed)) {
+            registry.add(*type);
+        }
+    }
+}
+
+void register_bodies(std::shared_ptr<const GraphFile> file,
+                     NodeRegistry& registry,
+                     const std::string& selected) {
+    for (std::string& name : file->names()) {
+        if (name == selected || registry.contains(name)) {
+            continue;
+        }
+        registry.add_deferred(name, [file, name] { return subgraph_type(name, file->graph(name)); });
+    }
+}
+
+} // namespace rebelflow::tools
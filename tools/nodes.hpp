@@ -0,0 +1,30 @@
+#pragma once
+
+#include "rebelflow/graph_file.hpp"
+#include "rebelflow/node.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace rebelflow::tools {
+
+/// Registers every node type the library ships.
+void register_standard_nodes(NodeRegistry& registry);
+
+/// Registers the node types a worker serves to unauthenticated coordinators:
+/// the pure standard types, the sub-graph interface nodes, and the impure
+/// types named in `allowed`. The other impure types read or write files.
+/// Throws GraphError for names in `allowed` that are not standard types.
+void register_worker_nodes(NodeRegistry& registry, const std::vector<std::string>& allowed);
+
+/// Registers every graph in `file` other than `selected` as a sub-graph type
+/// named after it. Only the names are read here: a graph is decoded the first
+/// time its type is looked up, so bodies that are never instanced cost
+/// nothing. A graph that does not load, or is not a valid body, reports why
+/// when something looks it up.
+void register_bodies(std::shared_ptr<const GraphFile> file,
+                     NodeRegistry& registry,
+                     const std::string& selected);
+
+} // namespace rebelflow::tools
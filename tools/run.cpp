@@ -0,0 +1,430 @@
+// rebelflow-run [options] FILE
+//
+// Loads a graph from a graph file, binds its inputs, evaluates it and prints
+// its outputs as one JSON object on stdout. Meant for unattended batch use:
+// nothing but the library is linked, and timings go to stderr.
+//
+// Inputs are bound by KEY, which is either the name of a SubgraphInput node
+// (every such node with that name is set) or NODE.PARAM, a parameter of the
+// node with id NODE. Values are JSON (see json.hpp); a --set value that is
+// not valid JSON is taken as a string. Outputs are the graph's
+// SubgraphOutput nodes, by name; when there are none the whole graph runs and
+// `{}` is printed.
+//
+// Other graphs stored in the file are registered as sub-graph node types
+// named after the graph, so the selected graph can instance them. Only the
+// graphs it actually instances are decoded.
+//
+// With --workers the graph is evaluated by rebelflow-worker processes (see
+// worker.cpp) instead, which need the same file to know those types. With
+// --stream it is run as a pipeline over the chunks of its one streaming
+// source, e.g. ReadPoints, so data sets larger than memory go through a
+// bounded number of chunks at a time (see stream.hpp).
+//
+// Exit status: 0 on success, 1 if loading or evaluation failed, 2 on usage
+// errors.
+
+#include "json.hpp"
+#include "nodes.hpp"
+
+#include "rebelflow/distributed.hpp"
+#include "rebelflow/executor.hpp"
+#include "rebelflow/graph_file.hpp"
+#include "rebelflow/stream.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+using Clock = std::chrono::steady_clock;
+
+constexpr const char* usage_text =
+    "usage: rebelflow-run [options] FILE\n"
+    "  --graph NAME       graph to run (default \"main\")\n"
+    "  --set KEY=VALUE    bind an input; KEY is an input name or NODE.PARAM\n"
+    "  --inputs FILE      bind inputs from a JSON object of KEY: VALUE\n"
+    "  --output NAME      print only this output (repeatable)\n"
+    "  --threads N        worker threads (default: one per hardware thread)\n"
+    "  --repeat N         evaluate N times from scratch (default 1)\n"
+    "  --cache FILE       persistent result cache\n"
+    "  --cache-size MB    result cache capacity (default 256)\n"
+    "  --trace FILE       write a Chrome trace of the runs\n"
+    "  --costs FILE       node timings for critical-path scheduling, updated\n"
+    "                     after the run (created if missing)\n"
+    "  --workers ADDRS    evaluate on rebelflow-worker processes, comma-separated\n"
+    "                     unix:PATH or tcp:HOST:PORT addresses\n"
+    "  --stream           run as a pipeline over the chunks of the graph's source\n"
+    "  --in-flight N      chunks held at once with --stream (default 8)\n"
+    "  --quiet            no timings on stderr\n";
+
+struct Options {
+    std::string file;
+    std::string graph{main_graph_name};
+    std::vector<std::pair<std::string, Value>> bindings;
+    std::vector<std::string> outputs;
+    unsigned threads = 0;
+    std::size_t repeat = 1;
+    std::string cache;
+    std::uint64_t cache_mb = 256;
+    std::string trace;
+    std::string costs;
+    std::vector<std::string> workers;
+    bool stream = false;
+    std::size_t in_flight = 8;
+    bool quiet = false;
+};
+
+/// Thrown for command-line mistakes, which exit with status 2.
+struct UsageError {
+    std::string what;
+};
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+double ms(std::chrono::nanoseconds d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        throw IoError("cannot read " + path + ": " + std::strerror(errno));
+    }
+    return {std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+}
+
+template <typename T>
+T parse_count(const char* flag, const std::string& text) {
+    T value{};
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || end != text.data() + text.size()) {
+        throw UsageError{std::string(flag) + " expects a number, got '" + text + "'"};
+    }
+    return value;
+}
+
+Options parse_args(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw UsageError{arg + " expects an argument"};
+            }
+            return argv[++i];
+        };
+        if (arg == "--graph") {
+            opt.graph = next();
+        } else if (arg == "--set") {
+            const std::string binding = next();
+            const std::size_t eq = binding.find('=');
+            if (eq == std::string::npos || eq == 0) {
+                throw UsageError{"--set expects KEY=VALUE, got '" + binding + "'"};
+            }
+            const std::string text = binding.substr(eq + 1);
+            Value value;
+            try {
+                value = tools::parse_json_value(text);
+            } catch (const FormatError&) {
+                value = text;
+            }
+            opt.bindings.emplace_back(binding.substr(0, eq), std::move(value));
+        } else if (arg == "--inputs") {
+            // Read right away, so later --set options override the file.
+            for (auto& binding : tools::parse_json_object(read_file(next()))) {
+                opt.bindings.push_back(std::move(binding));
+            }
+        } else if (arg == "--output") {
+            opt.outputs.push_back(next());
+        } else if (arg == "--threads") {
+            opt.threads = parse_count<unsigned>("--threads", next());
+        } else if (arg == "--repeat") {
+            opt.repeat = std::max<std::size_t>(parse_count<std::size_t>("--repeat", next()), 1);
+        } else if (arg == "--cache") {
+            opt.cache = next();
+        } else if (arg == "--cache-size") {
+            opt.cache_mb = parse_count<std::uint64_t>("--cache-size", next());
+        } else if (arg == "--trace") {
+            opt.trace = next();
+        } else if (arg == "--costs") {
+            opt.costs = next();
+        } else if (arg == "--workers") {
+            const std::string list = next();
+            for (std::size_t begin = 0; begin <= list.size();) {
+                const std::size_t end = std::min(list.find(',', begin), list.size());
+                if (end > begin) {
+                    opt.workers.push_back(list.substr(begin, end - begin));
+                }
+                begin = end + 1;
+            }
+        } else if (arg == "--stream") {
+            opt.stream = true;
+        } else if (arg == "--in-flight") {
+            opt.in_flight =
+                std::max<std::size_t>(parse_count<std::size_t>("--in-flight", next()), 1);
+        } else if (arg == "--quiet") {
+            opt.quiet = true;
+        } else if (arg == "--help" || arg == "-h") {
+            std::fputs(usage_text, stdout);
+            std::exit(0);
+        } else if (arg.starts_with("-") || !opt.file.empty()) {
+            throw UsageError{"unexpected argument '" + arg + "'"};
+        } else {
+            opt.file = arg;
+        }
+    }
+    if (opt.file.empty()) {
+        throw UsageError{"no graph file given"};
+    }
+    return opt;
+}
+
+/// Applies one binding; throws UsageError for keys that match nothing.
+void bind(Graph& graph, const std::string& key, const Value& value) {
+    const std::size_t dot = key.find('.');
+    NodeId id = invalid_node;
+    if (dot != std::string::npos) {
+        const auto [end, ec] = std::from_chars(key.data(), key.data() + dot, id);
+        if (ec != std::errc{} || end != key.data() + dot) {
+            id = invalid_node;
+        }
+    }
+    if (id != invalid_node) {
+        if (!graph.contains(id)) {
+            throw UsageError{"no node " + std::to_string(id) + " for '" + key + "'"};
+        }
+        graph.set_param(id, std::string_view(key).substr(dot + 1), value);
+        return;
+    }
+    bool found = false;
+    for (const NodeId node : graph.nodes()) {
+        if (graph.type(node).name == "SubgraphInput" && graph.param(node, "name").as_string() == key) {
+            graph.set_param(node, "value", value);
+            found = true;
+        }
+    }
+    if (!found) {
+        throw UsageError{"the graph has no input named '" + key + "'"};
+    }
+}
+
+/// The SubgraphOutput nodes to print, by name, in id order.
+std::vector<std::pair<std::string, NodeId>> find_outputs(const Graph& graph,
+                                                         const std::vector<std::string>& wanted) {
+    std::vector<std::pair<std::string, NodeId>> outputs;
+    for (const NodeId node : graph.nodes()) {
+        if (graph.type(node).name != "SubgraphOutput") {
+            continue;
+        }
+        std::string name = graph.param(node, "name").as_string();
+        if (wanted.empty() || std::find(wanted.begin(), wanted.end(), name) != wanted.end()) {
+            outputs.emplace_back(std::move(name), node);
+        }
+    }
+    for (const std::string& name : wanted) {
+        if (std::none_of(outputs.begin(), outputs.end(),
+                         [&](const auto& o) { return o.first == name; })) {
+            throw UsageError{"the graph has no output named '" + name + "'"};
+        }
+    }
+    return outputs;
+}
+
+/// Prints the outputs as one JSON object, `value_of` giving each port's value.
+template <typename ValueOf>
+void print_outputs(const std::vector<std::pair<std::string, NodeId>>& outputs, ValueOf value_of) {
+    std::string out = "{";
+    for (std::size_t i = 0; i < outputs.size(); ++i) {
+        out += i == 0 ? "\n  " : ",\n  ";
+        tools::write_json_string(out, outputs[i].first);
+        out += ": ";
+        tools::write_json_value(out, value_of(PortRef{outputs[i].second, 0}));
+    }
+    out += outputs.empty() ? "}\n" : "\n}\n";
+    std::fwrite(out.data(), 1, out.size(), stdout);
+}
+
+/// Evaluates on remote workers; every node runs, as workers keep their own
+/// results and answer unchanged nodes from them.
+void run_distributed(const Options& opt,
+                     const Graph& graph,
+                     const std::vector<std::pair<std::string, NodeId>>& outputs,
+                     double load_ms,
+                     Clock::time_point started) {
+    if (!opt.cache.empty() || !opt.trace.empty() || !opt.costs.empty()) {
+        throw UsageError{"--cache, --trace and --costs do not apply to --workers"};
+    }
+    DistributedExecutor executor(opt.workers);
+    DistributedStats stats;
+    std::chrono::nanoseconds best = std::chrono::nanoseconds::max();
+    std::chrono::nanoseconds total{0};
+    for (std::size_t i = 0; i < opt.repeat; ++i) {
+        stats = executor.run(graph);
+        best = std::min(best, stats.wall_time);
+        total += stats.wall_time;
+    }
+    print_outputs(outputs, [&](PortRef port) { return executor.output(port); });
+
+    if (!opt.quiet) {
+        std::fprintf(stderr, "load   %9.3f ms  graph '%s', %zu nodes\n", load_ms,
+                     opt.graph.c_str(), graph.node_count());
+        std::fprintf(stderr,
+                     "run    %9.3f ms  %zu nodes, %zu reused by workers, %zu values sent, "
+                     "%zu workers\n",
+                     ms(best), stats.nodes, stats.worker_hits, stats.values_sent,
+                     executor.worker_count());
+        if (opt.repeat > 1) {
+            std::fprintf(stderr, "mean   %9.3f ms  over %zu runs\n",
+                         ms(total) / static_cast<double>(opt.repeat), opt.repeat);
+        }
+        std::fprintf(stderr, "total  %9.3f ms\n", ms_since(started));
+    }
+}
+
+/// Streams the graph's source through it; every run reads the source again.
+void run_streamed(const Options& opt,
+                  const Graph& graph,
+                  const std::vector<std::pair<std::string, NodeId>>& outputs,
+                  double load_ms,
+                  Clock::time_point started) {
+    if (!opt.cache.empty() || !opt.trace.empty() || !opt.costs.empty() || !opt.workers.empty()) {
+        throw UsageError{"--cache, --trace, --costs and --workers do not apply to --stream"};
+    }
+    StreamOptions options;
+    options.max_in_flight = opt.in_flight;
+    options.workers = opt.threads;
+    StreamExecutor executor(options);
+    StreamStats stats;
+    std::chrono::nanoseconds best = std::chrono::nanoseconds::max();
+    std::chrono::nanoseconds total{0};
+    for (std::size_t i = 0; i < opt.repeat; ++i) {
+        stats = executor.run(graph);
+        best = std::min(best, stats.wall_time);
+        total += stats.wall_time;
+    }
+    print_outputs(outputs, [&](PortRef port) { return executor.output(port); });
+
+    if (!opt.quiet) {
+        std::fprintf(stderr, "load   %9.3f ms  graph '%s', %zu nodes\n", load_ms,
+                     opt.graph.c_str(), graph.node_count());
+        std::fprintf(stderr, "run    %9.3f ms  %zu chunks, at most %zu in flight\n", ms(best),
+                     stats.chunks, stats.peak_in_flight);
+        if (opt.repeat > 1) {
+            std::fprintf(stderr, "mean   %9.3f ms  over %zu runs\n",
+                         ms(total) / static_cast<double>(opt.repeat), opt.repeat);
+        }
+        std::fprintf(stderr, "total  %9.3f ms\n", ms_since(started));
+    }
+}
+
+int run(const Options& opt, Clock::time_point started) {
+    NodeRegistry registry;
+    tools::register_standard_nodes(registry);
+
+    const Clock::time_point load_start = Clock::now();
+    const auto file = std::make_shared<const GraphFile>(GraphFile::open(opt.file, registry));
+    if (!file->contains(opt.graph)) {
+        throw UsageError{opt.file + " has no graph named '" + opt.graph + "'"};
+    }
+    tools::register_bodies(file, registry, opt.graph);
+    Graph graph = *file->graph(opt.graph);
+    for (const auto& [key, value] : opt.bindings) {
+        bind(graph, key, value);
+    }
+    const auto outputs = find_outputs(graph, opt.outputs);
+    std::vector<PortRef> ports;
+    for (const auto& output : outputs) {
+        ports.push_back({output.second, 0});
+    }
+    const double load_ms = ms_since(load_start);
+    if (opt.stream) {
+        run_streamed(opt, graph, outputs, load_ms, started);
+        return 0;
+    }
+    if (!opt.workers.empty()) {
+        run_distributed(opt, graph, outputs, load_ms, started);
+        return 0;
+    }
+
+    Executor executor(opt.threads);
+    std::optional<ResultCache> cache;
+    if (!opt.cache.empty()) {
+        cache.emplace(opt.cache, opt.cache_mb << 20);
+        executor.set_result_cache(&*cache);
+    }
+    Profiler profiler;
+    if (!opt.trace.empty()) {
+        executor.set_profiler(&profiler);
+    }
+    CostModel costs;
+    if (!opt.costs.empty()) {
+        if (std::filesystem::exists(opt.costs)) {
+            costs.load(opt.costs);
+        }
+        executor.set_cost_model(&costs);
+    }
+
+    RunStats stats;
+    std::chrono::nanoseconds best = std::chrono::nanoseconds::max();
+    std::chrono::nanoseconds total{0};
+    for (std::size_t i = 0; i < opt.repeat; ++i) {
+        executor.invalidate_all();
+        stats = ports.empty() ? executor.run(graph) : executor.pull(graph, ports);
+        best = std::min(best, stats.wall_time);
+        total += stats.wall_time;
+    }
+
+    print_outputs(outputs, [&](PortRef port) { return executor.output(port); });
+
+    if (!opt.trace.empty()) {
+        profiler.save_chrome_trace(opt.trace);
+    }
+    if (!opt.costs.empty()) {
+        costs.save(opt.costs);
+    }
+    if (!opt.quiet) {
+        std::fprintf(stderr, "load   %9.3f ms  graph '%s', %zu nodes\n", load_ms,
+                     opt.graph.c_str(), graph.node_count());
+        std::fprintf(stderr, "run    %9.3f ms  %zu executed, %zu cache hits, %zu skipped, %u threads\n",
+                     ms(best), stats.executed.size(), stats.cache_hits, stats.nodes_skipped,
+                     executor.pool().size());
+        if (opt.repeat > 1) {
+            std::fprintf(stderr, "mean   %9.3f ms  over %zu runs\n",
+                         ms(total) / static_cast<double>(opt.repeat), opt.repeat);
+        }
+        std::fprintf(stderr, "total  %9.3f ms\n", ms_since(started));
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const Clock::time_point started = Clock::now();
+    try {
+        return run(parse_args(argc, argv), started);
+    } catch (const UsageError& e) {
+        std::fprintf(stderr, "rebelflow-run: %s (see --help)\n", e.what.c_str());
+        return 2;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "rebelflow-run: %s\n", e.what());
+        return 1;
+    }
+}
@@ -0,0 +1,144 @@
+// rebelflow-worker [options] ADDRESS
+//
+// Serves distributed graph evaluation (see distributed.hpp) on ADDRESS,
+// `unix:PATH` or `tcp:HOST:PORT`. Coordinators such as `rebelflow-run
+// --workers` connect to it and send nodes to evaluate; the worker keeps
+// their results, so nodes and inputs it has seen before cost one round trip
+// and no data. SIGINT or SIGTERM stop it accepting connections; it exits
+// once its coordinators have disconnected, or at a second signal.
+//
+// Graphs in the files given with --graphs are registered as sub-graph node
+// types, as rebelflow-run does with the other graphs of its file.
+//
+// Coordinators are not authenticated. The worker therefore serves only the
+// pure node types unless --allow names an impure one (the file readers and
+// writers), and a `tcp::PORT` address listens on loopback only; give a host,
+// e.g. `tcp:0.0.0.0:PORT`, to serve other machines.
+//
+// Exit status: 0 after a signal, 1 on failure, 2 on usage errors.
+
+#include "nodes.hpp"
+
+#include "rebelflow/distributed.hpp"
+#include "rebelflow/graph_file.hpp"
+#include "rebelflow/transport.hpp"
+
+#include <charconv>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace rebelflow;
+
+constexpr const char* usage_text =
+    "usage: rebelflow-worker [options] ADDRESS\n"
+    "  ADDRESS            unix:PATH or tcp:HOST:PORT (port 0 picks one, no host\n"
+    "                     means loopback)\n"
+    "  --graphs FILE      register the graphs in FILE as node types (repeatable)\n"
+    "  --allow TYPE       also run impure node type TYPE, e.g. ReadMesh (repeatable)\n"
+    "  --store-size MB    memory for kept values (default 1024)\n"
+    "  --quiet            no messages on stderr\n";
+
+struct Options {
+    std::string address;
+    std::vector<std::string> graphs;
+    std::vector<std::string> allowed;
+    std::size_t store_mb = 1024;
+    bool quiet = false;
+};
+
+/// Thrown for command-line mistakes, which exit with status 2.
+struct UsageError {
+    std::string what;
+};
+
+Options parse_args(int argc, char** argv) {
+    Options opt;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        auto next = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw UsageError{arg + " expects an argument"};
+            }
+            return argv[++i];
+        };
+        if (arg == "--graphs") {
+            opt.graphs.push_back(next());
+        } else if (arg == "--allow") {
+            opt.allowed.push_back(next());
+        } else if (arg == "--store-size") {
+            const std::string text = next();
+            const auto [end, ec] =
+                std::from_chars(text.data(), text.data() + text.size(), opt.store_mb);
+            if (ec != std::errc{} || end != text.data() + text.size()) {
+                throw UsageError{"--store-size expects a number, got '" + text + "'"};
+            }
+        } else if (arg == "--quiet") {
+            opt.quiet = true;
+        } else if (arg == "--help" || arg == "-h") {
+            std::fputs(usage_text, stdout);
+            std::exit(0);
+        } else if (arg.starts_with("-") || !opt.address.empty()) {
+            throw UsageError{"unexpected argument '" + arg + "'"};
+        } else {
+            opt.address = arg;
+        }
+    }
+    if (opt.address.empty()) {
+        throw UsageError{"no address given"};
+    }
+    return opt;
+}
+
+Listener* listening = nullptr;
+
+extern "C" void on_signal(int signal) {
+    // Both are async-signal-safe.
+    std::signal(signal, SIG_DFL);
+    listening->shutdown();
+}
+
+int run(const Options& opt) {
+    NodeRegistry registry;
+    tools::register_worker_nodes(registry, opt.allowed);
+    for (const std::string& path : opt.graphs) {
+        tools::register_bodies(std::make_shared<const GraphFile>(GraphFile::open(path, registry)),
+                               registry, {});
+    }
+
+    DistributedWorker worker(registry, opt.store_mb << 20);
+    Listener listener = Listener::bind(opt.address);
+    listening = &listener;
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    if (!opt.quiet) {
+        std::fprintf(stderr, "rebelflow-worker: listening on %s\n", listener.address().c_str());
+    }
+    worker.serve(listener);
+
+    if (!opt.quiet) {
+        const DistributedWorker::Stats stats = worker.stats();
+        std::fprintf(stderr, "rebelflow-worker: %zu computed, %zu reused, %zu values received\n",
+                     stats.computed, stats.reused, stats.values_received);
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    try {
+        return run(parse_args(argc, argv));
+    } catch (const UsageError& e) {
+        std::fprintf(stderr, "rebelflow-worker: %s (see --help)\n", e.what.c_str());
+        return 2;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "rebelflow-worker: %s\n", e.what());
+        return 1;
+    }
+}